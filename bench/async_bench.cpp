@@ -0,0 +1,188 @@
+// Async scripts (VM tasks and script::AsyncIo): what a suspended task
+// costs, and what running I/O on the event loop saves the editor thread.
+//
+// sleep.tasks_ms is how long --tasks tasks that each await sleep(10) take
+// from start to last wakeup, on one thread; task.bytes is what one of them
+// holds while suspended, its GC heap allocations and its saved frame.
+// files.async_ms reads --files files of 64 KB through read_file() and
+// all(); files.blocking_ms reads them into script strings one after
+// another on the calling thread, and files.async.stall is the longest the loop thread was busy
+// at once meanwhile, which is what typing would wait for. exec.async_ms
+// and exec.blocking_ms run --procs `sleep 0.05` processes, all at once
+// through exec() and one at a time through std::system(). await.ready is
+// an await of a value that is not a pending task; await.suspend an await
+// of a fresh async call, which parks the caller, runs the callee and
+// resumes the caller.
+//
+//   bench_async [--tasks 10000] [--files 200] [--procs 20]
+
+#include "bench.h"
+
+#include "core/event_loop.h"
+#include "core/thread_pool.h"
+#include "script/async.h"
+#include "script/object.h"
+#include "script/vm.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+constexpr const char* kScript = R"(
+async fn nap() { await sleep(10) }
+async fn naps(n) {
+    let tasks = []
+    for i in 0..n { push(tasks, nap()) }
+    await all(tasks)
+}
+async fn read_all(paths) {
+    let tasks = []
+    for i, p in paths { push(tasks, read_file(p)) }
+    let total = 0
+    for i, text in await all(tasks) { total += len(text) }
+    return total
+}
+async fn run_all(n) {
+    let tasks = []
+    for i in 0..n { push(tasks, exec(["sleep", "0.05"])) }
+    await all(tasks)
+}
+async fn ready(n) {
+    let s = 0
+    for i in 0..n { s += await i }
+    return s
+}
+async fn one() { return 1 }
+async fn suspend(n) {
+    let s = 0
+    for i in 0..n { s += await one() }
+    return s
+}
+)";
+
+struct Runtime {
+    rebel::core::EventLoop loop;
+    rebel::core::ThreadPool pool{2};
+    rebel::script::VM vm;
+    rebel::script::AsyncIo io{vm, loop, pool};
+
+    Runtime() { vm.run(kScript, "async_bench"); }
+
+    rebel::script::Value call(const char* fn, const rebel::script::Value& arg) {
+        return io.run_until(vm.call(vm.global(fn), &arg, 1));
+    }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t tasks = rebel::bench::arg(argc, argv, "tasks", 10000);
+    const std::size_t files = rebel::bench::arg(argc, argv, "files", 200);
+    const std::size_t procs = rebel::bench::arg(argc, argv, "procs", 20);
+
+    Report report("async");
+    try {
+        {
+            Runtime rt;
+            const auto before = rt.vm.heap().stats().bytes_allocated;
+            Stopwatch t;
+            const rebel::script::Value n = rebel::script::Value::number(static_cast<double>(tasks));
+            const rebel::script::Value task = rt.vm.call(rt.vm.global("naps"), &n, 1);
+            rt.vm.run_tasks();  // every nap() is now suspended on its sleep
+            const double heap = static_cast<double>(rt.vm.heap().stats().bytes_allocated - before);
+            const double frame = rt.vm.global("nap").as_function()->registers * sizeof(rebel::script::Value);
+            rt.io.run_until(task);
+            report.metric("sleep.tasks_ms", t.elapsed_ms(), "ms");
+            report.metric("task.bytes", heap / static_cast<double>(tasks) + frame, "B");
+        }
+
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / "rebel_async_bench";
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+        std::vector<std::string> paths;
+        const std::string body(64 * 1024, 'x');
+        for (std::size_t n = 0; n < files; ++n) {
+            paths.push_back((root / ("file" + std::to_string(n) + ".txt")).string());
+            std::ofstream(paths.back(), std::ios::binary) << body;
+        }
+        {
+            Runtime rt;
+            const rebel::script::Value list = rt.vm.new_table(files, 0);
+            for (std::size_t n = 0; n < files; ++n) {
+                rt.vm.table_set(list.as_table(), rebel::script::Value::number(static_cast<double>(n)),
+                                rt.vm.new_string(paths[n]));
+            }
+            Stopwatch t;
+            const rebel::script::Value task = rt.vm.call(rt.vm.global("read_all"), &list, 1);
+            // run_until(), a step at a time, timing each.
+            double stall = 0;
+            task.as_task()->observed = true;
+            const rebel::script::VM::Handle pending(rt.vm, task);
+            while (pending.get().as_task()->state == rebel::script::Task::State::Pending) {
+                Stopwatch step;
+                rt.vm.run_tasks();
+                stall = std::max(stall, step.elapsed_ms());
+                if (pending.get().as_task()->state != rebel::script::Task::State::Pending) break;
+                step.restart();
+                rt.loop.run_once(std::chrono::milliseconds(0));
+                stall = std::max(stall, step.elapsed_ms());
+            }
+            report.metric("files.async_ms", t.elapsed_ms(), "ms");
+            report.metric("files.async.stall", stall, "ms");
+        }
+        {
+            rebel::script::VM vm;
+            Stopwatch t;
+            std::size_t total = 0;
+            for (const std::string& p : paths) {
+                std::ifstream in(p, std::ios::binary);
+                const std::string text(std::istreambuf_iterator<char>(in), {});
+                total += vm.new_string(text).as_string()->length;
+            }
+            rebel::bench::do_not_optimize(total);
+            report.metric("files.blocking_ms", t.elapsed_ms(), "ms");
+        }
+        std::filesystem::remove_all(root);
+
+        {
+            Runtime rt;
+            Stopwatch t;
+            rt.call("run_all", rebel::script::Value::number(static_cast<double>(procs)));
+            report.metric("exec.async_ms", t.elapsed_ms(), "ms");
+        }
+        {
+            Stopwatch t;
+            for (std::size_t n = 0; n < procs; ++n) {
+                if (std::system("sleep 0.05") != 0) break;
+            }
+            report.metric("exec.blocking_ms", t.elapsed_ms(), "ms");
+        }
+
+        {
+            constexpr double kAwaits = 200'000;
+            Runtime rt;
+            rt.call("ready", rebel::script::Value::number(1000));  // warm up, and compile
+            Stopwatch r;
+            rt.call("ready", rebel::script::Value::number(kAwaits));
+            report.metric("await.ready", r.elapsed_ns() / kAwaits, "ns");
+            rt.call("suspend", rebel::script::Value::number(1000));
+            Stopwatch s;
+            rt.call("suspend", rebel::script::Value::number(kAwaits));
+            report.metric("await.suspend", s.elapsed_ns() / kAwaits, "ns");
+        }
+    } catch (const rebel::script::ScriptError& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
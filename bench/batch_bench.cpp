@@ -0,0 +1,142 @@
+// Throughput of headless batch runs (app::run_batch) over a synthetic
+// corpus of --files C++-like files, with a rename codemod that changes
+// about half of them. Nothing is written back, so every run sees the same
+// corpus.
+//
+// naive.files_per_s compiles the script from source in a fresh VM for
+// each file, on one thread: the cost batch mode avoids by compiling once.
+// batch.1.files_per_s runs on one worker and batch.N.files_per_s on
+// --threads (default: one per core); the speedup between them is bounded
+// by the cores this runs on. file is the per-file latency of the N-thread
+// run, first_result how long the first result took to reach the caller.
+// vm.create is constructing one isolated VM.
+//
+//   bench_batch [--files 2000] [--threads 0] [--runs 3]
+
+#include "bench.h"
+
+#include "app/batch.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+constexpr const char* kCodemod = R"(
+let out = []
+let at = 0
+let hits = 0
+while true {
+    let i = find(text, "legacy_lookup(", at)
+    if i == nil { break }
+    push(out, sub(text, at, i))
+    push(out, "lookup_v2(")
+    at = i + 14
+    hits += 1
+}
+if hits == 0 { return nil }
+push(out, sub(text, at, len(text)))
+return join(out, "")
+)";
+
+std::vector<std::string> make_corpus(const std::filesystem::path& root, std::size_t files) {
+    std::filesystem::create_directories(root);
+    std::vector<std::string> paths;
+    for (std::size_t n = 0; n < files; ++n) {
+        const std::filesystem::path path = root / ("file" + std::to_string(n) + ".cpp");
+        std::ofstream out(path);
+        out << "#include \"table.h\"\n\nnamespace module" << n << " {\n\n";
+        for (int f = 0; f < 40; ++f) {
+            out << "int handler_" << f << "(const Table& table, int key) {\n";
+            if (n % 2 == 0 && f % 8 == 0) {
+                out << "    const int value = legacy_lookup(table, key + " << f << ");\n";
+            } else {
+                out << "    const int value = table.find(key + " << f << ");\n";
+            }
+            out << "    return value < 0 ? " << n << " : value * " << f + 1 << ";\n}\n\n";
+        }
+        out << "}  // namespace module" << n << "\n";
+        paths.push_back(path.string());
+    }
+    return paths;
+}
+
+double files_per_s(std::size_t files, double ns) { return static_cast<double>(files) / (ns / 1e9); }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t files = rebel::bench::arg(argc, argv, "files", 2000);
+    std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 3);
+    const std::filesystem::path root = std::filesystem::temp_directory_path() / "rebel_batch_bench";
+    std::filesystem::remove_all(root);
+    const std::vector<std::string> paths = make_corpus(root, files);
+
+    Report report("batch");
+    report.metric("threads", static_cast<double>(threads), "");
+
+    Samples create;
+    for (int i = 0; i < 200; ++i) {
+        Stopwatch t;
+        rebel::script::VM vm;
+        create.add(t.elapsed_ns());
+    }
+    report.latency("vm.create", create);
+
+    double naive = 0;
+    for (std::size_t r = 0; r < runs; ++r) {
+        Stopwatch t;
+        for (const std::string& path : paths) {
+            rebel::app::BatchScript script(kCodemod, "codemod.rbl");
+            rebel::bench::do_not_optimize(script.run(path).status);
+        }
+        const double rate = files_per_s(files, t.elapsed_ns());
+        if (rate > naive) naive = rate;
+    }
+    report.metric("naive.files_per_s", naive, "files/s");
+
+    const rebel::app::BatchScript script(kCodemod, "codemod.rbl");
+    report.metric("code.bytes", static_cast<double>(script.code_bytes()), "B");
+    std::size_t changed = 0;
+    for (const std::size_t workers : {std::size_t{1}, threads}) {
+        rebel::core::ThreadPool pool(workers);
+        double best = 0;
+        Samples file;
+        Samples first;
+        for (std::size_t r = 0; r < runs; ++r) {
+            Stopwatch t;
+            bool seen = false;
+            const rebel::app::BatchStats stats = rebel::app::run_batch(
+                script, paths, pool, [&](rebel::app::FileResult&& result) {
+                    if (!seen) first.add(t.elapsed_ns());
+                    seen = true;
+                    file.add(result.ms * 1e6);
+                    if (result.status == rebel::app::FileResult::Status::Failed) std::abort();
+                });
+            const double rate = files_per_s(stats.files, t.elapsed_ns());
+            if (rate > best) best = rate;
+            changed = stats.changed;
+        }
+        const std::string name = "batch." + std::to_string(workers);
+        report.metric(name + ".files_per_s", best, "files/s");
+        if (workers == threads) {
+            report.latency("file", file);
+            report.latency("first_result", first);
+        }
+        if (workers == threads && threads == 1) break;
+    }
+    report.metric("changed", static_cast<double>(changed), "files");
+    std::filesystem::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+// Minimal benchmark harness shared by every bench_* executable.
+//
+// Results are echoed to stdout and appended to bench_output.txt (see
+// bench/CMakeLists.txt) as `[suite] metric = value unit` lines, one block per
+// run, so successive runs can be diffed. Latency spans the code under test
+// records (core/trace.h) follow as `span.<name>.*` metrics.
+
+#include "core/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef REBEL_BENCH_OUTPUT
+#define REBEL_BENCH_OUTPUT "bench_output.txt"
+#endif
+
+namespace rebel::bench {
+
+using Clock = std::chrono::steady_clock;
+
+class Stopwatch {
+public:
+    Stopwatch() : start_(Clock::now()) {}
+
+    void restart() { start_ = Clock::now(); }
+    double elapsed_ns() const {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start_).count();
+    }
+    double elapsed_ms() const { return elapsed_ns() / 1e6; }
+
+private:
+    Clock::time_point start_;
+};
+
+/// Per-operation latency samples in nanoseconds.
+class Samples {
+public:
+    void reserve(std::size_t n) { ns_.reserve(n); }
+    void add(double ns) {
+        ns_.push_back(ns);
+        sorted_ = false;
+    }
+    std::size_t count() const { return ns_.size(); }
+
+    double percentile(double p) {
+        if (ns_.empty()) return 0;
+        if (!sorted_) {
+            std::sort(ns_.begin(), ns_.end());
+            sorted_ = true;
+        }
+        const auto rank = static_cast<std::size_t>(p / 100.0 * static_cast<double>(ns_.size() - 1));
+        return ns_[rank];
+    }
+    double mean() const {
+        double sum = 0;
+        for (double v : ns_) sum += v;
+        return ns_.empty() ? 0 : sum / static_cast<double>(ns_.size());
+    }
+
+private:
+    std::vector<double> ns_;
+    bool sorted_ = false;
+};
+
+/// Collects metrics for one suite and writes them out on destruction.
+class Report {
+public:
+    /// Starts the span histograms over, covering the whole run.
+    explicit Report(std::string suite) : suite_(std::move(suite)) {
+        core::trace::set_window(std::chrono::hours(24));
+        core::trace::reset();
+    }
+    Report(const Report&) = delete;
+    Report& operator=(const Report&) = delete;
+
+    ~Report() { flush(); }
+
+    void metric(const std::string& name, double value, const std::string& unit) {
+        char line[256];
+        std::snprintf(line, sizeof line, "[%s] %s = %.3f %s", suite_.c_str(), name.c_str(), value,
+                      unit.c_str());
+        std::puts(line);
+        lines_.emplace_back(line);
+    }
+
+    /// Emits `<name>.p50`, `<name>.p99` and `<name>.mean` in nanoseconds.
+    void latency(const std::string& name, Samples& samples) {
+        metric(name + ".p50", samples.percentile(50), "ns");
+        metric(name + ".p99", samples.percentile(99), "ns");
+        metric(name + ".mean", samples.mean(), "ns");
+    }
+
+    /// Emits `span.<name>.p50`, `.p99` (in nanoseconds) and `.count` for each
+    /// span recorded since the last call, or since the report began.
+    void spans() {
+        for (const core::trace::Latency& l : core::trace::latencies()) {
+            metric("span." + l.name + ".p50", l.p50_ns, "ns");
+            metric("span." + l.name + ".p99", l.p99_ns, "ns");
+            metric("span." + l.name + ".count", static_cast<double>(l.count), "");
+        }
+        core::trace::reset();
+    }
+
+    void flush() {
+        spans();
+        if (lines_.empty()) return;
+        const char* path = std::getenv("REBEL_BENCH_OUTPUT");
+        std::FILE* out = std::fopen(path && *path ? path : REBEL_BENCH_OUTPUT, "a");
+        if (!out) return;
+        const std::time_t now = std::time(nullptr);
+        char stamp[32];
+        std::strftime(stamp, sizeof stamp, "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+        std::fprintf(out, "# %s %s\n", suite_.c_str(), stamp);
+        for (const std::string& line : lines_) std::fprintf(out, "%s\n", line.c_str());
+        std::fclose(out);
+        lines_.clear();
+    }
+
+private:
+    std::string suite_;
+    std::vector<std::string> lines_;
+};
+
+/// Reads `--<name> <value>` from the command line, or returns `fallback`.
+inline std::uint64_t arg(int argc, char** argv, const char* name, std::uint64_t fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (argv[i][0] == '-' && argv[i][1] == '-' && std::strcmp(argv[i] + 2, name) == 0) {
+            return std::strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    return fallback;
+}
+
+/// Keeps the optimiser from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace rebel::bench
@@ -0,0 +1,212 @@
+// Loading script modules through the bytecode cache against compiling them.
+//
+// --modules generated modules of --functions functions each stand in for
+// the scripts a hook invocation loads. compile.total compiles all of them
+// into a fresh VM from source; cold.total does the same through an empty
+// cache, storing every entry; warm.total loads all of them from the cache
+// into a fresh VM. Each is p50 over --runs; compile.module and
+// load.module are per-module latencies. graph.compile and graph.load are
+// the same for a visual graph of --nodes nodes. evict.* loads every module
+// round-robin through a cache limited to half their size, so each load
+// misses and evicts: the worst case, not the usual one. It also checks
+// that an entry one cache stores is a hit for another on the same
+// directory that was already open.
+//
+//   bench_bytecode_cache [--modules 300] [--functions 20] [--runs 10] [--nodes 400]
+
+#include "bench.h"
+
+#include "script/bytecode_cache.h"
+#include "script/vm.h"
+#include "visual/graph_compiler.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::script::BytecodeCache;
+using rebel::script::VM;
+
+namespace {
+
+struct Module {
+    std::string name;
+    std::string source;
+};
+
+std::vector<Module> modules(std::size_t count, std::size_t functions) {
+    std::vector<Module> out;
+    for (std::size_t m = 0; m < count; ++m) {
+        const std::string mod = "hook" + std::to_string(m);
+        std::string source = "let " + mod + " = {name: \"" + mod + "\", handlers: {}}\n";
+        for (std::size_t f = 0; f < functions; ++f) {
+            const std::string name = mod + "_on" + std::to_string(f);
+            source += "fn " + name + "(event, text) {\n";
+            source += "    let hits = []\n";
+            source += "    for i in 0..len(text) {\n";
+            source += "        if find(text, \"" + std::to_string(f) + "\", i) == i { push(hits, i) }\n";
+            source += "        else if i % " + std::to_string(f + 2) + " == 0 { push(hits, -i) }\n";
+            source += "    }\n";
+            source += "    if len(hits) > 3 { return {event: event, hits: hits, module: \"" + mod + "\"} }\n";
+            source += "    return join(hits, \",\")\n";
+            source += "}\n";
+            source += mod + ".handlers[\"event" + std::to_string(f) + "\"] = " + name + "\n";
+        }
+        out.push_back({mod + ".rbl", std::move(source)});
+    }
+    return out;
+}
+
+// Layers of arithmetic over a few inputs with a pure call every so often,
+// like a generated shader or rules graph.
+rebel::visual::Graph graph(std::size_t nodes) {
+    using rebel::visual::NodeKind;
+    rebel::visual::Graph g;
+    std::vector<rebel::visual::NodeId> values{g.input("a"), g.input("b"), g.input("c")};
+    const NodeKind ops[] = {NodeKind::Add, NodeKind::Multiply, NodeKind::Subtract, NodeKind::Add};
+    while (g.size() < nodes) {
+        const std::size_t n = values.size();
+        if (n % 7 == 0) {
+            values.push_back(g.call("floor", {values[n - 1]}, true));
+        } else if (n % 5 == 0) {
+            values.push_back(g.constant(static_cast<double>(n)));
+        } else {
+            values.push_back(g.op(ops[n % 4], {values[n - 1], values[n / 2]}));
+        }
+    }
+    g.output("value", values.back());
+    return g;
+}
+
+std::uint64_t cache_bytes(const std::filesystem::path& dir) {
+    std::uint64_t bytes = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) bytes += entry.file_size();
+    return bytes;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t count = rebel::bench::arg(argc, argv, "modules", 300);
+    const std::size_t functions = rebel::bench::arg(argc, argv, "functions", 20);
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 10);
+    const std::size_t nodes = rebel::bench::arg(argc, argv, "nodes", 400);
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "rebel_bytecode_cache_bench";
+    std::filesystem::remove_all(dir);
+
+    const std::vector<Module> mods = modules(count, functions);
+    Report report("bytecode_cache");
+    std::size_t source_bytes = 0;
+    for (const Module& m : mods) source_bytes += m.source.size();
+    report.metric("modules.bytes", static_cast<double>(source_bytes), "B");
+
+    Samples compile_total;
+    Samples compile_module;
+    Samples cold_total;
+    Samples warm_total;
+    Samples load_module;
+    for (std::size_t r = 0; r < runs; ++r) {
+        VM vm;
+        Stopwatch total;
+        for (const Module& m : mods) {
+            Stopwatch t;
+            rebel::bench::do_not_optimize(vm.compile(m.source, m.name));
+            compile_module.add(t.elapsed_ns());
+        }
+        compile_total.add(total.elapsed_ns());
+    }
+    for (std::size_t r = 0; r < runs; ++r) {
+        std::filesystem::remove_all(dir);
+        BytecodeCache cache(dir.string());
+        VM vm;
+        Stopwatch total;
+        for (const Module& m : mods) rebel::bench::do_not_optimize(cache.compile(vm, m.source, m.name));
+        cold_total.add(total.elapsed_ns());
+    }
+    std::uint64_t hits = 0;
+    for (std::size_t r = 0; r < runs; ++r) {
+        BytecodeCache cache(dir.string());
+        VM vm;
+        Stopwatch total;
+        for (const Module& m : mods) {
+            Stopwatch t;
+            rebel::bench::do_not_optimize(cache.compile(vm, m.source, m.name));
+            load_module.add(t.elapsed_ns());
+        }
+        warm_total.add(total.elapsed_ns());
+        hits += cache.stats().hits;
+    }
+    report.metric("compile.total.p50", compile_total.percentile(50) / 1e6, "ms");
+    report.metric("cold.total.p50", cold_total.percentile(50) / 1e6, "ms");
+    report.metric("warm.total.p50", warm_total.percentile(50) / 1e6, "ms");
+    report.metric("warm.speedup", compile_total.percentile(50) / warm_total.percentile(50), "x");
+    report.metric("warm.hit_rate", 100.0 * static_cast<double>(hits) / static_cast<double>(runs * count), "%");
+    report.latency("compile.module", compile_module);
+    report.latency("load.module", load_module);
+    const std::uint64_t stored_bytes = cache_bytes(dir);
+    report.metric("cache.bytes", static_cast<double>(stored_bytes), "B");
+
+    {
+        // Two caches on one directory, as two processes would have: what
+        // one stores after both started is a hit for the other.
+        const std::filesystem::path shared = dir.string() + "_shared";
+        std::filesystem::remove_all(shared);
+        BytecodeCache writer(shared.string());
+        BytecodeCache reader(shared.string());
+        VM vm;
+        const Module& m = mods.front();
+        writer.compile(vm, m.source, m.name);
+        VM other;
+        const bool hit = reader.load(other, BytecodeCache::key(m.source), m.name) != nullptr;
+        std::filesystem::remove_all(shared);
+        if (!hit || reader.stats().entries != 1) {
+            std::cerr << "bytecode cache: an entry stored by another cache was missed\n";
+            return 1;
+        }
+    }
+
+    {
+        const rebel::visual::Graph g = graph(nodes);
+        BytecodeCache cache(dir.string());
+        Samples compile;
+        Samples load;
+        for (std::size_t r = 0; r < runs; ++r) {
+            VM vm;
+            Stopwatch t;
+            rebel::bench::do_not_optimize(rebel::visual::compile(vm, g));
+            compile.add(t.elapsed_ns());
+        }
+        for (std::size_t r = 0; r <= runs; ++r) {
+            VM vm;
+            Stopwatch t;
+            rebel::bench::do_not_optimize(rebel::visual::compile_cached(cache, vm, g));
+            if (r > 0) load.add(t.elapsed_ns());  // the first stores
+        }
+        report.latency("graph.compile", compile);
+        report.latency("graph.load", load);
+    }
+
+    {
+        std::filesystem::remove_all(dir);
+        BytecodeCache cache(dir.string(), stored_bytes / 2);
+        VM vm;
+        Samples evict;
+        for (std::size_t r = 0; r < 2; ++r) {
+            for (const Module& m : mods) {
+                Stopwatch t;
+                rebel::bench::do_not_optimize(cache.compile(vm, m.source, m.name));
+                if (r > 0) evict.add(t.elapsed_ns());
+            }
+        }
+        const BytecodeCache::Stats stats = cache.stats();
+        report.latency("evict.module", evict);
+        report.metric("evict.evictions", static_cast<double>(stats.evictions), "");
+        report.metric("evict.bytes", static_cast<double>(stats.bytes), "B");
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Collaborative editing (collab::Replica): memory, update size and merge
+// speed on a replayed editing session.
+//
+// The trace is synthetic but shaped like typing: bursts of keystrokes at a
+// cursor, backspaces, occasional jumps elsewhere, line deletions and
+// pastes, --ops edits in all over a --kb KiB source file. Each of --users
+// users replays its own share of it at its own cursors, flushing every
+// --batch edits and exchanging the updates.
+//
+// memory.ratio is the replica's memory (text plus run metadata) over the
+// text's size; memory.per_byte_ratio is the same for a CRDT holding one
+// item of the same size per byte ever inserted. local.ns is the cost of
+// one local edit, merge.ns of integrating one remote edit from an update,
+// update.bytes_per_edit the encoded size per edit. state.* is a whole
+// document sent to a joining replica and loaded there.
+//
+//   bench_collab [--kb 256] [--ops 200000] [--users 2] [--batch 32]
+
+#include "bench.h"
+
+#include "collab/replica.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Stopwatch;
+using rebel::collab::Replica;
+
+namespace {
+
+std::string synthetic_source(std::size_t bytes, std::mt19937_64& rng) {
+    static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz_(){};=+-*/ 0123456789";
+    std::uniform_int_distribution<int> line_length(0, 100);
+    std::uniform_int_distribution<std::size_t> pick(0, sizeof kAlphabet - 2);
+    std::string text;
+    while (text.size() < bytes) {
+        for (int n = line_length(rng); n > 0; --n) text.push_back(kAlphabet[pick(rng)]);
+        text.push_back('\n');
+    }
+    return text;
+}
+
+// One user editing: where their cursor is and what they do next.
+class Typist {
+public:
+    explicit Typist(std::uint64_t seed) : rng_(seed) {}
+
+    /// Makes one edit; returns the bytes it inserted.
+    std::size_t edit(Replica& replica) {
+        const std::size_t size = replica.text().size();
+        cursor_ = std::min(cursor_, size);
+        const unsigned roll = rng_() % 1000;
+        if (roll < 25 || size == 0) {
+            cursor_ = size ? rng_() % size : 0;  // click somewhere else
+            return 0;
+        }
+        if (roll < 180) {
+            if (cursor_ > 0) replica.erase(--cursor_, 1);  // backspace
+            return 0;
+        }
+        if (roll < 188) {
+            const std::size_t line = std::min<std::size_t>(20 + rng_() % 60, size - std::min(cursor_, size));
+            if (line > 0) replica.erase(cursor_, line);
+            return 0;
+        }
+        if (roll < 194) {
+            const std::string paste(100 + rng_() % 300, 'p');
+            replica.insert(cursor_, paste);
+            cursor_ += paste.size();
+            return paste.size();
+        }
+        static const char kKeys[] = "etaoinshrdlcumwfgypbvk     \n(){};=";
+        replica.insert(cursor_++, std::string_view(&kKeys[rng_() % (sizeof kKeys - 1)], 1));
+        return 1;
+    }
+
+private:
+    std::mt19937_64 rng_;
+    std::size_t cursor_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t kilobytes = rebel::bench::arg(argc, argv, "kb", 256);
+    const std::size_t ops = rebel::bench::arg(argc, argv, "ops", 200000);
+    const std::size_t users = std::max<std::size_t>(rebel::bench::arg(argc, argv, "users", 2), 1);
+    const std::size_t batch = std::max<std::size_t>(rebel::bench::arg(argc, argv, "batch", 32), 1);
+
+    Report report("collab");
+    std::mt19937_64 rng(7);
+    const std::string source = synthetic_source(kilobytes << 10, rng);
+
+    std::vector<std::unique_ptr<Replica>> replicas;
+    std::vector<Typist> typists;
+    for (std::size_t u = 0; u < users; ++u) {
+        replicas.push_back(std::make_unique<Replica>(static_cast<std::uint32_t>(u + 1), source));
+        typists.emplace_back(u + 1);
+    }
+
+    // Every user takes `batch` edits in turn, then the updates go round.
+    double local_ns = 0;
+    double merge_ns = 0;
+    std::size_t update_bytes = 0;
+    std::size_t inserted = source.size();
+    for (std::size_t done = 0; done < ops;) {
+        std::vector<std::string> updates;
+        for (std::size_t u = 0; u < users && done < ops; ++u) {
+            const std::size_t n = std::min(batch, ops - done);
+            Stopwatch t;
+            for (std::size_t i = 0; i < n; ++i) inserted += typists[u].edit(*replicas[u]);
+            updates.push_back(replicas[u]->flush());
+            local_ns += t.elapsed_ns();
+            done += n;
+            update_bytes += updates.back().size();
+        }
+        Stopwatch t;
+        for (std::size_t u = 0; u < updates.size(); ++u) {
+            for (std::size_t v = 0; v < users; ++v) {
+                if (v != u) replicas[v]->apply(updates[u]);
+            }
+        }
+        merge_ns += t.elapsed_ns();
+    }
+
+    const std::string text = replicas[0]->text().to_string();
+    for (const auto& replica : replicas) {
+        if (replica->text().to_string() != text || replica->has_pending()) {
+            std::cerr << "replicas diverged\n";
+            return 1;
+        }
+    }
+
+    const Replica::Stats stats = replicas[0]->stats();
+    const double size = static_cast<double>(std::max<std::size_t>(text.size(), 1));
+    report.metric("document.size", static_cast<double>(text.size()) / 1024, "KiB");
+    report.metric("runs", static_cast<double>(stats.runs), "");
+    report.metric("tombstones", static_cast<double>(stats.tombstones), "");
+    report.metric("deleted", static_cast<double>(stats.deleted_bytes) / 1024, "KiB");
+    report.metric("memory.ratio", (size + static_cast<double>(stats.metadata_bytes)) / size, "x");
+    // One run-sized item per byte ever inserted, not counting its text.
+    const double per_byte = static_cast<double>(stats.metadata_bytes) / static_cast<double>(std::max<std::size_t>(stats.runs, 1));
+    report.metric("memory.per_byte_ratio", (size + per_byte * static_cast<double>(inserted)) / size, "x");
+    report.metric("local.ns", local_ns / static_cast<double>(ops), "ns");
+    report.metric("merge.ns", merge_ns / static_cast<double>(ops * (users - 1) + (users == 1)), "ns");
+    report.metric("update.bytes_per_edit", static_cast<double>(update_bytes) / static_cast<double>(ops), "B");
+
+    Stopwatch encode;
+    const std::string state = replicas[0]->encode_state();
+    report.metric("state.encode_ms", encode.elapsed_ms(), "ms");
+    report.metric("state.ratio", static_cast<double>(state.size()) / size, "x");
+    Stopwatch load;
+    Replica joined(static_cast<std::uint32_t>(users + 1));
+    joined.apply(state);
+    report.metric("state.load_ms", load.elapsed_ms(), "ms");
+    if (joined.text().size() != text.size()) {
+        std::cerr << "state did not load\n";
+        return 1;
+    }
+    return 0;
+}
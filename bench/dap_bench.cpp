@@ -0,0 +1,186 @@
+// Remote debugging (dap::Server): what a client pays, in round trips and
+// bytes, to show a stop and to walk large values.
+//
+// stop.standard.* is the usual sequence after a stopped event, stackTrace,
+// scopes and the locals' variables; stop.inspect.* the one inspect request
+// that answers all three; stop.preview.* the stopped event with
+// stopPreview, which needs no request at all. Round trips count requests;
+// bytes count everything the server sends, events included.
+// page.first_us and page.last_us are a variables page of 100 fields at the
+// start and at the end of a table with --fields fields walked page by
+// page; page.jump_us a page at the end requested directly. snapshot.* is a
+// heapSnapshot of --records records, each a table with a nested array,
+// against expanding the same structure with variables requests
+// (expand.*).
+//
+//   bench_dap [--fields 1000000] [--records 10000]
+
+#include "bench.h"
+
+#include "dap/server.h"
+#include "lsp/json.h"
+#include "script/error.h"
+#include "script/vm.h"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+constexpr const char* kScript = R"(
+fn build(fields, records) {
+    let wide = {}
+    for i in 0..fields { wide["f" + str(i)] = i }
+    let list = []
+    for i in 0..records { push(list, {id: i, name: "record " + str(i), tags: ["a", "b", i]}) }
+    let depth = 3
+    let label = "stopped here"
+    return len(list)
+}
+)";
+
+// A client talking to a server in-process: the bench runs at the stop,
+// from the server's first read.
+class Client {
+public:
+    explicit Client(rebel::script::VM& vm)
+        : server_(vm, [this](std::string_view body) { output(body); }, [this] { return input(); }) {}
+
+    void at_stop(std::function<void()> fn) { at_stop_ = std::move(fn); }
+
+    // Sends a request and returns the response, counting the round trip.
+    rebel::lsp::json::Document request(const std::string& command, const std::string& args = "{}") {
+        ++trips;
+        server_.handle("{\"seq\":" + std::to_string(++seq_) + ",\"type\":\"request\",\"command\":\"" + command +
+                       "\",\"arguments\":" + args + "}");
+        return rebel::lsp::json::Document::parse(std::move(last_));
+    }
+
+    void reset() {
+        trips = 0;
+        bytes = 0;
+    }
+
+    std::size_t trips = 0;
+    std::size_t bytes = 0;
+    std::string stopped;  // the last stopped event
+
+private:
+    void output(std::string_view body) {
+        bytes += body.size();
+        if (body.find("\"event\":\"stopped\"") != std::string_view::npos) stopped = std::string(body);
+        last_ = std::string(body);
+    }
+    std::optional<std::string> input() {
+        if (at_stop_) {
+            std::function<void()> fn = std::move(at_stop_);
+            at_stop_ = nullptr;
+            fn();
+        }
+        return "{\"seq\":0,\"type\":\"request\",\"command\":\"continue\",\"arguments\":{}}";
+    }
+
+    rebel::dap::Server server_;
+    std::function<void()> at_stop_;
+    std::string last_;
+    std::int64_t seq_ = 0;
+};
+
+std::int64_t local_ref(const rebel::lsp::json::Document& variables, std::string_view name) {
+    for (const auto& v : variables.root()["body"]["variables"]) {
+        if (v["name"].as_string() == name) return v["variablesReference"].as_int();
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t fields = rebel::bench::arg(argc, argv, "fields", 1'000'000);
+    const std::size_t records = rebel::bench::arg(argc, argv, "records", 10'000);
+
+    Report report("dap");
+    try {
+        rebel::script::VM vm;
+        Client client(vm);
+        vm.run(kScript, "dap_bench");
+        client.request("initialize");
+        client.request("launch", "{\"stopPreview\":true}");
+        client.request("setBreakpoints", R"({"source":{"path":"dap_bench"},"breakpoints":[{"line":9}]})");
+
+        client.at_stop([&] {
+            const std::size_t preview = client.stopped.size();
+
+            client.reset();
+            client.request("stackTrace");
+            client.request("scopes", "{\"frameId\":1}");
+            const rebel::lsp::json::Document locals = client.request("variables", "{\"variablesReference\":1}");
+            report.metric("stop.standard.trips", static_cast<double>(client.trips), "");
+            report.metric("stop.standard.bytes", static_cast<double>(client.bytes), "B");
+            client.reset();
+            client.request("inspect");
+            report.metric("stop.inspect.trips", static_cast<double>(client.trips), "");
+            report.metric("stop.inspect.bytes", static_cast<double>(client.bytes), "B");
+            report.metric("stop.preview.trips", 0, "");
+            report.metric("stop.preview.bytes", static_cast<double>(preview), "B");
+
+            const std::string wide = std::to_string(local_ref(locals, "wide"));
+            const std::size_t pages = fields / rebel::dap::Server::kPageSize;
+            double first = 0;
+            double last = 0;
+            for (std::size_t page = 0; page < pages; ++page) {
+                Stopwatch t;
+                client.request("variables", "{\"variablesReference\":" + wide + ",\"start\":" +
+                                                std::to_string(page * rebel::dap::Server::kPageSize) + ",\"count\":100}");
+                if (page == 0) first = t.elapsed_ns();
+                if (page + 1 == pages) last = t.elapsed_ns();
+            }
+            report.metric("page.first_us", first / 1e3, "us");
+            report.metric("page.last_us", last / 1e3, "us");
+            client.request("evaluate", "{\"expression\":\"depth\"}");  // forgets where paging was
+            Stopwatch jump;
+            client.request("variables", "{\"variablesReference\":" + wide + ",\"start\":" +
+                                            std::to_string(fields - rebel::dap::Server::kPageSize) + ",\"count\":100}");
+            report.metric("page.jump_us", jump.elapsed_ns() / 1e3, "us");
+
+            // Everything under `list`, one variables request per table.
+            client.reset();
+            Stopwatch expand;
+            std::vector<std::int64_t> pending{local_ref(locals, "list")};
+            while (!pending.empty()) {
+                const std::int64_t ref = pending.back();
+                pending.pop_back();
+                const rebel::lsp::json::Document page = client.request(
+                    "variables", "{\"variablesReference\":" + std::to_string(ref) + ",\"count\":1000000000}");
+                for (const auto& v : page.root()["body"]["variables"]) {
+                    if (v["variablesReference"].as_int() > 0) pending.push_back(v["variablesReference"].as_int());
+                }
+            }
+            report.metric("expand.ms", expand.elapsed_ms(), "ms");
+            report.metric("expand.trips", static_cast<double>(client.trips), "");
+            report.metric("expand.bytes", static_cast<double>(client.bytes), "B");
+
+            client.reset();
+            Stopwatch snap;
+            const rebel::lsp::json::Document result = client.request("heapSnapshot", "{\"expression\":\"list\"}");
+            report.metric("snapshot.ms", snap.elapsed_ms(), "ms");
+            report.metric("snapshot.trips", static_cast<double>(client.trips), "");
+            report.metric("snapshot.bytes", static_cast<double>(client.bytes), "B");
+            report.metric("snapshot.binary_bytes", static_cast<double>(result.root()["body"]["bytes"].as_int()), "B");
+        });
+        const rebel::script::Value args[] = {rebel::script::Value::number(static_cast<double>(fields)),
+                                             rebel::script::Value::number(static_cast<double>(records))};
+        vm.call(vm.global("build"), args, 2);
+    } catch (const rebel::script::ScriptError& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
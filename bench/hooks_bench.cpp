@@ -0,0 +1,154 @@
+// Typing latency with a slow script hook, with and without time budgets
+// (app::HookRunner).
+//
+// Each scenario types --keys keystrokes into a fast hook and a slow one
+// (a loop of about --slow-ms ms) and, after each, polls once as the
+// editor's frame loop would. <scenario>.wait is the editor thread's time
+// per keystroke, fire() and poll() together. unbudgeted calls both
+// hooks straight on a VM, which is what a slow hook costs typing without
+// budgets; abort, suspend and background run them under each
+// OverrunPolicy with a --budget-us budget. A wait past the budget is the
+// watchdog's wakeup latency plus the distance to the next safepoint; on a
+// single core the background scenario's pool thread competes with the
+// editor thread for it too. suspend.slowdown is how much longer the slow
+// hook's calls ran in slices than in one go. fire.fast and call.fast are
+// one keystroke to the fast hook alone through the runner and as a plain
+// call: the fixed cost of a budget.
+//
+//   bench_hooks [--keys 200] [--budget-us 2000] [--slow-ms 20]
+
+#include "bench.h"
+
+#include "app/hooks.h"
+#include "script/vm.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+constexpr const char* kFast = R"(let typed = 0
+fn on_keystroke(key) { typed = typed + len(key) })";
+
+// `iterations` is set by the bench's natives.
+constexpr const char* kSlow = R"(fn on_keystroke(key) {
+    let s = 0
+    for i in 0..iterations { s = (s + i * 7) % 1000003 }
+    return s
+})";
+
+double iterations_for(double ms) {
+    rebel::script::VM vm;
+    vm.set_global("iterations", rebel::script::Value::number(1e6));
+    vm.run(kSlow, "slow");
+    const rebel::script::Value key = vm.new_string("a");
+    vm.call(vm.global("on_keystroke"), &key, 1);  // warm up, and compile
+    Stopwatch t;
+    vm.call(vm.global("on_keystroke"), &key, 1);
+    return 1e6 * ms / t.elapsed_ms();
+}
+
+struct Outcome {
+    Samples wait;
+    double slow_run_ms = 0;  // mean of the slow hook's finished calls
+};
+
+Outcome unbudgeted(std::size_t keys, double iterations) {
+    rebel::script::VM fast;
+    fast.run(kFast, "fast");
+    rebel::script::VM slow;
+    slow.set_global("iterations", rebel::script::Value::number(iterations));
+    slow.run(kSlow, "slow");
+    Outcome out;
+    Samples slow_ms;
+    for (std::size_t k = 0; k < keys; ++k) {
+        Stopwatch t;
+        const rebel::script::Value a = fast.new_string("a");
+        fast.call(fast.global("on_keystroke"), &a, 1);
+        const rebel::script::Value b = slow.new_string("a");
+        Stopwatch s;
+        slow.call(slow.global("on_keystroke"), &b, 1);
+        slow_ms.add(s.elapsed_ms());
+        out.wait.add(t.elapsed_ns());
+    }
+    out.slow_run_ms = slow_ms.mean();
+    return out;
+}
+
+Outcome budgeted(std::size_t keys, double iterations, rebel::app::HookOptions options,
+                 rebel::core::ThreadPool& pool) {
+    Outcome out;
+    Samples slow_ms;
+    rebel::app::HookRunner runner(
+        pool, [&](rebel::script::VM& vm) { vm.set_global("iterations", rebel::script::Value::number(iterations)); },
+        [&](const rebel::app::HookResult& r) {
+            if (r.hook == "slow" && r.status == rebel::app::HookResult::Status::Done) slow_ms.add(r.run_ms);
+        });
+    runner.add("fast", kFast);
+    runner.add("slow", kSlow, options);
+    for (std::size_t k = 0; k < keys; ++k) {
+        Stopwatch t;
+        runner.fire(rebel::app::HookEvent::Keystroke, {std::string("a")});
+        runner.poll();
+        out.wait.add(t.elapsed_ns());
+    }
+    while (runner.poll()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    out.slow_run_ms = slow_ms.mean();
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t keys = rebel::bench::arg(argc, argv, "keys", 200);
+    const auto budget = static_cast<double>(rebel::bench::arg(argc, argv, "budget-us", 2000));
+    const auto slow_ms = static_cast<double>(rebel::bench::arg(argc, argv, "slow-ms", 20));
+
+    Report report("hooks");
+    try {
+        const double iterations = iterations_for(slow_ms);
+        rebel::core::ThreadPool pool(1);
+
+        Outcome plain = unbudgeted(keys, iterations);
+        report.latency("unbudgeted.wait", plain.wait);
+
+        rebel::app::HookOptions options;
+        options.budget = std::chrono::microseconds(static_cast<std::int64_t>(budget));
+        options.limit = std::chrono::milliseconds(0);
+        for (const auto& [name, policy] : {std::pair{"abort", rebel::app::OverrunPolicy::Abort},
+                                           std::pair{"suspend", rebel::app::OverrunPolicy::Suspend},
+                                           std::pair{"background", rebel::app::OverrunPolicy::Background}}) {
+            options.policy = policy;
+            Outcome outcome = budgeted(keys, iterations, options, pool);
+            report.latency(std::string(name) + ".wait", outcome.wait);
+            if (policy == rebel::app::OverrunPolicy::Suspend) {
+                report.metric("suspend.slowdown", 100.0 * (outcome.slow_run_ms / plain.slow_run_ms - 1), "%");
+            }
+        }
+
+        // The fixed cost, with the slow hook out of the way.
+        constexpr std::size_t kCalls = 20'000;
+        rebel::app::HookRunner runner(pool);
+        runner.add("fast", kFast);
+        Stopwatch t;
+        for (std::size_t k = 0; k < kCalls; ++k) runner.fire(rebel::app::HookEvent::Keystroke, {std::string("a")});
+        report.metric("fire.fast", t.elapsed_ns() / kCalls, "ns");
+        rebel::script::VM vm;
+        vm.run(kFast, "fast");
+        Stopwatch c;
+        for (std::size_t k = 0; k < kCalls; ++k) {
+            const rebel::script::Value a = vm.new_string("a");
+            vm.call(vm.global("on_keystroke"), &a, 1);
+        }
+        report.metric("call.fast", c.elapsed_ns() / kCalls, "ns");
+    } catch (const rebel::script::ScriptError& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
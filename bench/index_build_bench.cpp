@@ -0,0 +1,179 @@
+// Workspace symbol indexing (index::update_index) over a synthetic
+// workspace of --files C++ and script files written to a temporary
+// directory.
+//
+// cold.ms builds the index with no previous one, on --threads workers
+// (0 = one per core); cold.files_per_s is its throughput. warm.ms re-runs
+// it with nothing changed, as on a restart. touch.ms runs after 1% of the
+// files had their mtime bumped with the same contents, edit.ms after 1%
+// were rewritten. index.bytes and index.bytes_per_file are the index file
+// size; open.us maps it, and lookup.p50/p99 time go-to-definition plus
+// find-references for random names. It also checks that open() refuses
+// an index with a corrupt record.
+//
+//   bench_index_build [--files 20000] [--threads 0] [--lookups 20000]
+
+#include "bench.h"
+
+#include "core/thread_pool.h"
+#include "index/symbol_index.h"
+#include "index/workspace_indexer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::index::IndexStats;
+using rebel::index::SymbolIndex;
+
+namespace {
+
+std::string cpp_file(std::size_t n, std::size_t salt, std::mt19937_64& rng) {
+    std::uniform_int_distribution<std::size_t> pick(0, 999);
+    std::string text = "#include <vector>\n#define MODULE_" + std::to_string(n) + "_VERSION " + std::to_string(salt) +
+                       "\n\nnamespace module" + std::to_string(n % 100) + " {\n\n";
+    text += "class Widget" + std::to_string(n) + " : public Base {\n  public:\n";
+    text += "    explicit Widget" + std::to_string(n) + "(int size);\n    int measure(const Layout& layout) const;\n};\n\n";
+    for (int f = 0; f < 12; ++f) {
+        const std::string name = "compute_" + std::to_string(n) + "_" + std::to_string(f);
+        text += "// Combines the inputs of " + name + ".\n";
+        text += "static int " + name + "(const std::vector<int>& values, int scale) {\n";
+        text += "    int total = 0;\n";
+        text += "    for (int v : values) total += helper_" + std::to_string(pick(rng)) + "(v) * scale;\n";
+        text += "    if (total > limit_" + std::to_string(pick(rng)) + ") return clamp(total, \"overflow\");\n";
+        text += "    return total + compute_" + std::to_string(pick(rng)) + "_" + std::to_string(f) + "(values, 2);\n";
+        text += "}\n\n";
+    }
+    text += "int Widget" + std::to_string(n) + "::measure(const Layout& layout) const {\n";
+    text += "    return layout.width() + padding_;\n}\n\n}  // namespace module" + std::to_string(n % 100) + "\n";
+    return text;
+}
+
+std::string script_file(std::size_t n, std::size_t salt, std::mt19937_64& rng) {
+    std::uniform_int_distribution<std::size_t> pick(0, 999);
+    std::string text = "// hook " + std::to_string(n) + " rev " + std::to_string(salt) + "\n";
+    for (int f = 0; f < 10; ++f) {
+        text += "fn on_event_" + std::to_string(n) + "_" + std::to_string(f) + "(editor, event) {\n";
+        text += "    let count = editor.lines()\n";
+        text += "    if count > 100 { return format_" + std::to_string(pick(rng)) + "(event) }\n";
+        text += "    return on_event_" + std::to_string(pick(rng)) + "_" + std::to_string(f) + "(editor, event)\n}\n\n";
+    }
+    return text;
+}
+
+std::string relative(std::size_t n) {
+    char path[96];
+    std::snprintf(path, sizeof path, "pkg%03zu/sub%02zu/file%06zu.%s", n % 400, n / 400 % 20, n,
+                  n % 5 == 0 ? "rbl" : n % 2 ? "cpp" : "h");
+    return path;
+}
+
+void write(const fs::path& root, std::size_t n, std::size_t salt, std::mt19937_64& rng) {
+    const fs::path path = root / relative(n);
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        << (n % 5 == 0 ? script_file(n, salt, rng) : cpp_file(n, salt, rng));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t files = rebel::bench::arg(argc, argv, "files", 20000);
+    const std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+    const std::size_t lookups = rebel::bench::arg(argc, argv, "lookups", 20000);
+
+    const fs::path root = fs::temp_directory_path() / "rebel_index_bench";
+    fs::remove_all(root);
+    std::mt19937_64 rng(5);
+    for (std::size_t n = 0; n < files; ++n) write(root, n, 0, rng);
+    const std::string index_path = (root / ".rebel-index").string();
+
+    Report report("index_build");
+    rebel::core::ThreadPool pool(threads);
+    report.metric("threads", static_cast<double>(pool.size()), "");
+
+    auto run = [&](const char* name) {
+        Stopwatch t;
+        const IndexStats stats = rebel::index::update_index(root.string(), index_path, pool);
+        const double ms = t.elapsed_ms();
+        report.metric(std::string(name) + ".ms", ms, "ms");
+        return std::make_pair(stats, ms);
+    };
+
+    const auto [cold, cold_ms] = run("cold");
+    report.metric("cold.files_per_s", static_cast<double>(cold.files) / cold_ms * 1000, "files/s");
+    report.metric("cold.scan.ms", cold.scan_ms, "ms");
+    report.metric("cold.index.ms", cold.index_ms, "ms");
+    report.metric("cold.write.ms", cold.write_ms, "ms");
+    report.metric("symbols", static_cast<double>(cold.symbols), "");
+    report.metric("index.bytes", static_cast<double>(cold.bytes), "B");
+    report.metric("index.bytes_per_file", static_cast<double>(cold.bytes) / static_cast<double>(cold.files), "B");
+
+    const IndexStats warm = run("warm").first;
+    report.metric("warm.reused", static_cast<double>(warm.reused), "files");
+
+    const auto later = fs::file_time_type::clock::now() + std::chrono::seconds(5);
+    for (std::size_t n = 0; n < files; n += 100) fs::last_write_time(root / relative(n), later);
+    const IndexStats touch = run("touch").first;
+    report.metric("touch.rehashed", static_cast<double>(touch.rehashed), "files");
+
+    for (std::size_t n = 50; n < files; n += 100) write(root, n, 1, rng);
+    const IndexStats edit = run("edit").first;
+    report.metric("edit.parsed", static_cast<double>(edit.parsed), "files");
+
+    Stopwatch t;
+    const auto index = SymbolIndex::open(index_path);
+    report.metric("open.us", t.elapsed_ns() / 1e3, "us");
+
+    Samples lookup;
+    std::uniform_int_distribution<std::size_t> pick(0, files - 1);
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < lookups; ++i) {
+        const std::size_t n = pick(rng);
+        const std::string name = n % 5 == 0 ? "on_event_" + std::to_string(n) + "_3" : "compute_" + std::to_string(n) + "_3";
+        t.restart();
+        const auto definitions = index->definitions(name);
+        const auto references = index->references(name);
+        lookup.add(t.elapsed_ns());
+        found += definitions.size() + references.size();
+    }
+    report.latency("lookup", lookup);
+    report.metric("lookup.hits", static_cast<double>(found) / static_cast<double>(lookups), "");
+
+    {
+        // A name pointing past the strings, as a damaged file might, is
+        // refused by open().
+        std::ifstream in(index_path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        rebel::index::format::Header h;
+        std::memcpy(&h, bytes.data(), sizeof h);
+        const std::uint32_t past = static_cast<std::uint32_t>(h.strings_bytes);
+        std::memcpy(&bytes[h.names + h.name_count / 2 * sizeof(rebel::index::format::NameRecord)], &past, sizeof past);
+        const std::string corrupt_path = index_path + ".corrupt";
+        std::ofstream(corrupt_path, std::ios::binary) << bytes;
+        bool refused = false;
+        try {
+            SymbolIndex::open(corrupt_path);
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+        if (!refused) {
+            std::fprintf(stderr, "index: a corrupt index opened\n");
+            return 1;
+        }
+    }
+
+    fs::remove_all(root);
+    return 0;
+}
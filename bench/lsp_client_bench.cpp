@@ -0,0 +1,331 @@
+// Language-server traffic (lsp::Client, lsp::json) against a stand-in for
+// a large server.
+//
+// json.* parses a completion list of --items items (a few MB, as big
+// servers send for an unqualified identifier) with json::Document:
+// throughput, and the arena the tree took. It also checks numbers past a
+// double's range and negative zeros.
+//
+// typing.* replays --keys keystrokes in bursts of five 8 ms apart, each
+// sending didChange and a completion request superseding the previous
+// one, against a server (this binary with --serve 1) that takes
+// --delay_us to answer a completion and publishes diagnostics for every
+// change. popup.* is the latency from request() to the parsed list
+// reaching its handler, for the completions that were not superseded;
+// request_call.* is the CPU time didChange and request() cost the typing
+// thread (wall time would count the other threads on a busy core as
+// well). superseded and
+// discarded count the stale requests cancelled and the late answers
+// dropped; parse.ms_per_mb is parse time on the reader thread.
+//
+//   bench_lsp_client [--items 20000] [--keys 200] [--delay_us 20000] [--diagnostics 500]
+
+#include "bench.h"
+
+#include "lsp/client.h"
+#include "lsp/json.h"
+#include "lsp/transport.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+namespace json = rebel::lsp::json;
+
+namespace {
+
+constexpr int kRequestCancelled = -32800;
+
+// CPU time of the calling thread; wall time where that is not available.
+double thread_ns() {
+#ifdef _WIN32
+    return std::chrono::duration<double, std::nano>(rebel::bench::Clock::now().time_since_epoch()).count();
+#else
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) * 1e9 + static_cast<double>(now.tv_nsec);
+#endif
+}
+
+std::string completion_list(std::size_t items) {
+    json::Writer out;
+    out.begin_object().key("isIncomplete").value(false).key("items").begin_array();
+    for (std::size_t n = 0; n < items; ++n) {
+        const std::string label = "member_" + std::to_string(n);
+        out.begin_object()
+            .key("label")
+            .value(label)
+            .key("kind")
+            .value(static_cast<int>(2 + n % 20))
+            .key("detail")
+            .value("std::vector<std::pair<int, std::string>> (const Key&, std::size_t) const")
+            .key("documentation")
+            .begin_object()
+            .key("kind")
+            .value("markdown")
+            .key("value")
+            .value(n % 4 == 0 ? "Returns the \"entry\" for `key`.\n\nSee also: find()" : "Returns the entry for `key`.")
+            .end_object()
+            .key("sortText")
+            .value(std::to_string(1000000 + n))
+            .key("textEdit")
+            .begin_object()
+            .key("range")
+            .raw(R"({"start":{"line":120,"character":8},"end":{"line":120,"character":11}})")
+            .key("newText")
+            .value(label)
+            .end_object()
+            .key("score")
+            .value(0.5 + static_cast<double>(n % 100) / 200)
+            .end_object();
+    }
+    out.end_array().end_object();
+    return out.take();
+}
+
+std::string diagnostics(std::size_t count) {
+    json::Writer out;
+    out.begin_object().key("uri").value("file:///workspace/src/main.cpp").key("diagnostics").begin_array();
+    for (std::size_t n = 0; n < count; ++n) {
+        out.begin_object()
+            .key("range")
+            .raw(R"({"start":{"line":)" + std::to_string(n) + R"(,"character":4},"end":{"line":)" +
+                 std::to_string(n) + R"(,"character":19}})")
+            .key("severity")
+            .value(static_cast<int>(1 + n % 4))
+            .key("source")
+            .value("clang")
+            .key("message")
+            .value("use of undeclared identifier 'value_" + std::to_string(n) + "'")
+            .end_object();
+    }
+    out.end_array().end_object();
+    return out.take();
+}
+
+// --- The stand-in server, on standard input and output. ---
+
+std::mutex out_mutex;
+
+void reply(const std::string& body) {
+    const std::string framed = rebel::lsp::frame(body);
+    std::lock_guard<std::mutex> lock(out_mutex);
+    std::fwrite(framed.data(), 1, framed.size(), stdout);
+    std::fflush(stdout);
+}
+
+std::string result(std::int64_t id, const std::string& result) {
+    return R"({"jsonrpc":"2.0","id":)" + std::to_string(id) + R"(,"result":)" + result + "}";
+}
+
+bool read_message(std::string& body) {
+    std::size_t length = 0;
+    char line[256];
+    for (;;) {
+        if (!std::fgets(line, sizeof line, stdin)) return false;
+        if (line[0] == '\r' || line[0] == '\n') break;
+        std::sscanf(line, "Content-Length: %zu", &length);
+    }
+    body.resize(length);
+    return std::fread(body.data(), 1, length, stdin) == length;
+}
+
+int serve(std::size_t items, std::chrono::microseconds delay, std::size_t diagnostic_count) {
+    const std::string list = completion_list(items);
+    const std::string published = R"({"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":)" +
+                                  diagnostics(diagnostic_count) + "}";
+
+    // Completions are worked on one at a time, each taking `delay` unless
+    // cancelled meanwhile, while messages keep arriving.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::int64_t> jobs;
+    std::set<std::int64_t> cancelled;
+    bool exiting = false;
+
+    std::thread worker([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [&] { return exiting || !jobs.empty(); });
+            if (exiting) return;
+            const std::int64_t id = jobs.front();
+            jobs.pop_front();
+            const auto due = std::chrono::steady_clock::now() + delay;
+            changed.wait_until(lock, due, [&] { return exiting || cancelled.count(id) > 0; });
+            if (exiting) return;
+            const bool stale = cancelled.erase(id) > 0;
+            lock.unlock();
+            if (stale) {
+                reply(R"({"jsonrpc":"2.0","id":)" + std::to_string(id) + R"(,"error":{"code":)" +
+                      std::to_string(kRequestCancelled) + R"(,"message":"cancelled"}})");
+            } else {
+                reply(result(id, list));
+            }
+            lock.lock();
+        }
+    });
+
+    std::string body;
+    while (read_message(body)) {
+        const json::Document message = json::Document::parse(std::move(body));
+        const json::Value& root = message.root();
+        const std::string_view method = root["method"].as_string();
+        const std::int64_t id = root["id"].as_int(-1);
+        if (method == "initialize") {
+            reply(result(id, R"({"capabilities":{"completionProvider":{},"textDocumentSync":2}})"));
+        } else if (method == "textDocument/completion") {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(id);
+            changed.notify_all();
+        } else if (method == "$/cancelRequest") {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled.insert(root["params"]["id"].as_int());
+            changed.notify_all();
+        } else if (method == "textDocument/didChange") {
+            reply(published);
+        } else if (method == "shutdown") {
+            reply(result(id, "null"));
+        } else if (method == "exit") {
+            break;
+        }
+        body.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exiting = true;
+        changed.notify_all();
+    }
+    worker.join();
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t items = rebel::bench::arg(argc, argv, "items", 20000);
+    const std::size_t keys = rebel::bench::arg(argc, argv, "keys", 200);
+    const auto delay = std::chrono::microseconds(rebel::bench::arg(argc, argv, "delay_us", 20000));
+    const std::size_t diagnostic_count = rebel::bench::arg(argc, argv, "diagnostics", 500);
+    if (rebel::bench::arg(argc, argv, "serve", 0) != 0) return serve(items, delay, diagnostic_count);
+
+    Report report("lsp_client");
+
+    {
+        const std::string text = completion_list(items);
+        constexpr int kRounds = 20;
+        std::size_t arena = 0;
+        std::size_t parsed = 0;
+        Stopwatch t;
+        for (int round = 0; round < kRounds; ++round) {
+            const json::Document document = json::Document::parse(text);
+            parsed += document.root()["items"].size();
+            arena = document.arena_bytes();
+        }
+        const double ns = t.elapsed_ns() / kRounds;
+        rebel::bench::do_not_optimize(parsed);
+        report.metric("json.bytes", static_cast<double>(text.size()), "B");
+        report.metric("json.parse.ms", ns / 1e6, "ms");
+        report.metric("json.parse.gbps", static_cast<double>(text.size()) / ns, "GB/s");
+        report.metric("json.arena_bytes", static_cast<double>(arena), "B");
+    }
+    {
+        // Numbers past a double's range, and negative zeros, keep their
+        // sign: underflow is zero and only overflow is infinite.
+        const json::Document document =
+            json::Document::parse("[1e-400, -1e-400, 0.1e-400, -0.0e-400, -0, -0.0, 1e400, -1e400]");
+        const double inf = std::numeric_limits<double>::infinity();
+        const double expected[] = {0.0, -0.0, 0.0, -0.0, -0.0, -0.0, inf, -inf};
+        bool right = document.root().size() == std::size(expected);
+        for (std::size_t k = 0; k < std::size(expected); ++k) {
+            const double parsed = document.root()[k].as_double(1);
+            right = right && parsed == expected[k] && std::signbit(parsed) == std::signbit(expected[k]);
+        }
+        if (!right) {
+            std::fprintf(stderr, "json: out-of-range numbers parsed wrong\n");
+            return 1;
+        }
+    }
+
+    rebel::lsp::Client client(rebel::lsp::Channel::spawn(
+        argv[0], {"--serve", "1", "--items", std::to_string(items), "--delay_us", std::to_string(delay.count()),
+                  "--diagnostics", std::to_string(diagnostic_count)}));
+    std::atomic<std::size_t> diagnostics_seen{0};
+    client.on_notification("textDocument/publishDiagnostics", [&](const json::Value& params) {
+        diagnostics_seen += params["diagnostics"].size();
+    });
+    client.request("initialize", R"({"processId":null,"rootUri":null,"capabilities":{}})")->wait();
+    client.notify("initialized", "{}");
+
+    std::mutex mutex;
+    Samples popup;
+    Samples call;
+    std::size_t shown_items = 0;
+    const std::string position =
+        R"({"textDocument":{"uri":"file:///workspace/src/main.cpp"},"position":{"line":120,"character":9}})";
+    std::shared_ptr<rebel::lsp::Request> last;
+    Stopwatch t;
+    for (std::size_t key = 0; key < keys; ++key) {
+        json::Writer change;
+        change.begin_object()
+            .key("textDocument")
+            .raw(R"({"uri":"file:///workspace/src/main.cpp","version":)" + std::to_string(key + 1) + "}")
+            .key("contentChanges")
+            .raw(R"([{"range":{"start":{"line":120,"character":8},"end":{"line":120,"character":8}},"text":"x"}])")
+            .end_object();
+
+        const auto sent = rebel::bench::Clock::now();
+        const double cpu = thread_ns();
+        client.notify("textDocument/didChange", change.str());
+        last = client.request(
+            "textDocument/completion", position,
+            [&, sent](const std::shared_ptr<const rebel::lsp::Response>& response) {
+                const double ns =
+                    std::chrono::duration<double, std::nano>(rebel::bench::Clock::now() - sent).count();
+                std::lock_guard<std::mutex> lock(mutex);
+                popup.add(ns);
+                shown_items += response->result()["items"].size();
+            },
+            "completion");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            call.add(thread_ns() - cpu);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(key % 5 == 4 ? 150 : 8));
+    }
+    last->wait();
+    const double typing_ms = t.elapsed_ms();
+    client.request("shutdown", "")->wait();
+    client.notify("exit", "");
+
+    const rebel::lsp::Client::Stats stats = client.stats();
+    std::lock_guard<std::mutex> lock(mutex);
+    report.metric("typing.ms", typing_ms, "ms");
+    report.metric("typing.completions", static_cast<double>(popup.count()), "");
+    report.latency("typing.popup", popup);
+    report.latency("typing.request_call", call);
+    report.metric("typing.superseded", static_cast<double>(stats.cancelled), "");
+    report.metric("typing.discarded", static_cast<double>(stats.discarded), "");
+    report.metric("typing.items_shown", static_cast<double>(shown_items), "");
+    report.metric("typing.diagnostics", static_cast<double>(diagnostics_seen.load()), "");
+    report.metric("typing.received_mb", static_cast<double>(stats.bytes_received) / 1e6, "MB");
+    report.metric("typing.parse.ms_per_mb", stats.parse_ms / (static_cast<double>(stats.bytes_received) / 1e6), "ms");
+    return 0;
+}
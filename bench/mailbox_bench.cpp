@@ -0,0 +1,230 @@
+// Cross-thread messaging (core::Mailbox over core::RingBuffer) against
+// the mutex-guarded deque with a condition variable it replaces.
+//
+// Three producers stand in for the debugger, the script VM and the
+// indexer; one consumer for the UI thread, which waits for messages and
+// drains whatever has arrived.
+//
+// flood.* has the producers post --messages 32-byte events between them
+// as fast as they can into a --capacity mailbox: msgs_per_s, and
+// wakeups_per_1k, how often the consumer had to be woken. post.p50/p99 is
+// the cost of one post (every 64th timed). burst.* paces the producers
+// instead: the debugger streams bursts of 256 events every 2 ms, the VM
+// posts 16 every millisecond and the indexer one every 5 ms, for
+// --burst_ms. latency.p50/p99 is post to pickup by the consumer (within
+// 25%, from the mailbox's own histogram) and wakeups_per_1k as above.
+// Each metric is reported for mailbox.* and mutex.*.
+//
+//   bench_mailbox [--messages 3000000] [--capacity 4096] [--burst_ms 2000]
+
+#include "bench.h"
+
+#include "core/mailbox.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::core::LatencyHistogram;
+using rebel::core::Mailbox;
+
+namespace {
+
+struct Event {
+    std::uint32_t source = 0;
+    std::uint32_t kind = 0;
+    std::uint64_t payload[3] = {};
+};
+
+std::uint64_t now_ns() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// The usual queue: every post takes the lock and signals.
+class MutexQueue {
+public:
+    bool post(Event event) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back({event, now_ns()});
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+    template <typename F>
+    std::size_t drain(F&& handle) {
+        std::deque<Entry> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch.swap(queue_);
+        }
+        const std::uint64_t now = now_ns();
+        for (Entry& entry : batch) {
+            latency_.add(now - entry.posted_ns);
+            handle(std::move(entry.event));
+        }
+        return batch.size();
+    }
+
+    bool wait(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!queue_.empty()) return true;
+        if (ready_.wait_for(lock, timeout, [this] { return !queue_.empty(); })) ++wakeups_;
+        return !queue_.empty();
+    }
+
+    std::uint64_t wakeups() const { return wakeups_; }
+    const LatencyHistogram& latency() const { return latency_; }
+
+private:
+    struct Entry {
+        Event event;
+        std::uint64_t posted_ns;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Entry> queue_;
+    std::uint64_t wakeups_ = 0;
+    LatencyHistogram latency_;
+};
+
+std::uint64_t wakeups(const Mailbox<Event>& mailbox) { return mailbox.stats().wakeups; }
+std::uint64_t wakeups(const MutexQueue& queue) { return queue.wakeups(); }
+LatencyHistogram latency(const Mailbox<Event>& mailbox) { return mailbox.stats().latency; }
+LatencyHistogram latency(const MutexQueue& queue) { return queue.latency(); }
+
+// Drains until `expected` events have arrived.
+template <typename Queue>
+std::uint64_t consume(Queue& queue, std::uint64_t expected) {
+    std::uint64_t received = 0;
+    std::uint64_t checksum = 0;
+    while (received < expected) {
+        queue.wait(std::chrono::milliseconds(5));
+        received += queue.drain([&](Event&& event) { checksum += event.payload[0]; });
+    }
+    return checksum;
+}
+
+template <typename Queue>
+void flood(Report& report, const std::string& name, Queue& queue, std::uint64_t messages) {
+    constexpr int kProducers = 3;
+    const std::uint64_t each = messages / kProducers;
+    std::vector<std::vector<double>> post(kProducers);
+    std::vector<std::thread> producers;
+    Stopwatch t;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            post[p].reserve(each / 64 + 1);
+            Event event;
+            event.source = static_cast<std::uint32_t>(p);
+            for (std::uint64_t n = 0; n < each; ++n) {
+                event.payload[0] = n;
+                if (n % 64 == 0) {
+                    Stopwatch one;
+                    queue.post(event);
+                    post[p].push_back(one.elapsed_ns());
+                } else {
+                    queue.post(event);
+                }
+            }
+        });
+    }
+    rebel::bench::do_not_optimize(consume(queue, each * kProducers));
+    const double ms = t.elapsed_ms();
+    for (std::thread& producer : producers) producer.join();
+
+    Samples all;
+    for (const std::vector<double>& samples : post) {
+        for (const double ns : samples) all.add(ns);
+    }
+    report.metric(name + ".flood.msgs_per_s", static_cast<double>(each * kProducers) / ms * 1e3, "msg/s");
+    report.metric(name + ".flood.wakeups_per_1k", static_cast<double>(wakeups(queue)) * 1e3 / (each * kProducers), "");
+    report.metric(name + ".post.p50", all.percentile(50), "ns");
+    report.metric(name + ".post.p99", all.percentile(99), "ns");
+}
+
+template <typename Queue>
+void burst(Report& report, const std::string& name, Queue& queue, std::chrono::milliseconds span) {
+    struct Source {
+        std::uint32_t id;
+        int per_tick;
+        std::chrono::microseconds period;
+    };
+    const Source sources[] = {{0, 256, std::chrono::microseconds(2000)},  // debugger events
+                              {1, 16, std::chrono::microseconds(1000)},   // script output
+                              {2, 1, std::chrono::microseconds(5000)}};   // indexer progress
+    std::atomic<std::uint64_t> posted{0};
+    std::atomic<bool> done{false};
+    std::vector<std::thread> producers;
+    const auto start = std::chrono::steady_clock::now();
+    for (const Source& source : sources) {
+        producers.emplace_back([&, source] {
+            Event event;
+            event.source = source.id;
+            for (auto tick = start; tick < start + span; tick += source.period) {
+                std::this_thread::sleep_until(tick);
+                for (int n = 0; n < source.per_tick; ++n) queue.post(event);
+                posted += static_cast<std::uint64_t>(source.per_tick);
+            }
+        });
+    }
+    std::uint64_t received = 0;
+    std::thread consumer([&] {
+        while (!done.load() || received < posted.load()) {
+            queue.wait(std::chrono::milliseconds(5));
+            received += queue.drain([](Event&&) {});
+        }
+    });
+    for (std::thread& producer : producers) producer.join();
+    done = true;
+    consumer.join();
+
+    const LatencyHistogram histogram = latency(queue);
+    report.metric(name + ".burst.messages", static_cast<double>(received), "");
+    report.metric(name + ".burst.wakeups_per_1k", static_cast<double>(wakeups(queue)) * 1e3 / received, "");
+    report.metric(name + ".latency.p50", histogram.percentile(50), "ns");
+    report.metric(name + ".latency.p99", histogram.percentile(99), "ns");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::uint64_t messages = rebel::bench::arg(argc, argv, "messages", 3000000);
+    const std::size_t capacity = rebel::bench::arg(argc, argv, "capacity", 4096);
+    const auto span = std::chrono::milliseconds(rebel::bench::arg(argc, argv, "burst_ms", 2000));
+
+    Report report("mailbox");
+    {
+        Mailbox<Event> mailbox(capacity);
+        flood(report, "mailbox", mailbox, messages);
+        const Mailbox<Event>::Stats stats = mailbox.stats();
+        report.metric("mailbox.flood.full_waits", static_cast<double>(stats.full_waits), "");
+        report.metric("mailbox.flood.max_depth", static_cast<double>(stats.max_depth), "");
+    }
+    {
+        MutexQueue queue;
+        flood(report, "mutex", queue, messages);
+    }
+    {
+        Mailbox<Event> mailbox(capacity);
+        burst(report, "mailbox", mailbox, span);
+    }
+    {
+        MutexQueue queue;
+        burst(report, "mutex", queue, span);
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Cost of recording a debugged run for reverse stepping (script::Recorder).
+//
+// <name>.overhead compares each standard workload on the interpreter with a
+// debugger attached, with and without a recorder; none of them calls a
+// recorded native, so this is the cost of the copy-on-write checks. The
+// clock workload times each frame of a loop with clock(), some tens of
+// thousands of calls a second, to show the log's size:
+// clock.bytes_per_result, and clock.mb_per_10min, the log a 10-minute run
+// at that call rate would write. checkpoint.mean is the added cost of a
+// stop on a line that changes a table, and step_back.<interval>.mean the
+// time from step_back() to the handler seeing the previous stop, with a
+// checkpoint at every stop or at every 8th (which re-runs up to 7).
+//
+//   bench_script_record [--runs 5]
+
+#include "bench.h"
+
+#include "script/debugger.h"
+#include "script/recorder.h"
+#include "script/vm.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#ifndef REBEL_BENCH_SCRIPTS
+#define REBEL_BENCH_SCRIPTS "bench/scripts"
+#endif
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+std::string read_script(const std::string& name) {
+    const std::string path = std::string(REBEL_BENCH_SCRIPTS) + "/" + name + ".rbl";
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// A frame loop: 10k frames of arithmetic, each timed with clock().
+const char* const kClockScript = R"(let frames = 10000
+let busy = 0
+let x = 0
+for frame in 0..frames {
+    let start = clock()
+    for i in 0..1000 { x = (x * 31 + i) % 1000003 }
+    busy += clock() - start
+}
+if busy < 0 { error("clock: went backwards") }
+)";
+
+// Line 5 runs 2000 times, changing one entry of a 1000-entry table each time.
+const char* const kStopScript = R"(let t = []
+for i in 0..1000 { t[i] = i }
+let sum = 0
+for i in 0..2000 {
+    t[i % 1000] = t[i % 1000] + 1
+    sum += t[i % 1000]
+}
+if sum < 2000 { error("stops: sum " + sum) }
+)";
+constexpr std::uint32_t kStopLine = 5;
+constexpr std::uint64_t kStops = 2000;
+
+std::string log_path() {
+    return (std::filesystem::temp_directory_path() / "rebel_bench_record.rblrec").string();
+}
+
+struct Mode {
+    bool record = false;
+    std::uint32_t line = 0;               // breakpoint, stopping every time
+    std::uint32_t checkpoint_interval = 1;
+    std::uint64_t back_from = 0;          // stop at which to start stepping back
+    std::uint64_t backs = 0;              // how many steps
+};
+
+struct Run {
+    double ns = 0;
+    rebel::script::Recorder::Stats stats;
+    Samples backs;  // step_back() to the next stop
+};
+
+Run run_once(const std::string& source, const char* name, const Mode& mode) {
+    rebel::script::VM vm;
+    vm.set_print_handler([](std::string_view) {});
+#ifdef REBEL_SCRIPT_JIT
+    // The recorder runs on the interpreter; compare like with like.
+    rebel::script::Jit::Config config = vm.jit().config();
+    config.enabled = false;
+    vm.jit().configure(config);
+#endif
+    rebel::script::Debugger debugger(vm);
+    std::optional<rebel::script::Recorder> recorder;
+    if (mode.record) {
+        rebel::script::RecorderOptions options;
+        options.path = log_path();
+        options.checkpoint_interval = mode.checkpoint_interval;
+        recorder.emplace(vm, debugger, options);
+    }
+    if (mode.line) debugger.set_breakpoint(name, mode.line);
+
+    Run run;
+    std::uint64_t stops = 0;
+    std::uint64_t backs = 0;
+    bool stepping = false;
+    Stopwatch back;
+    debugger.set_handler([&](const rebel::script::Debugger::Stop&) {
+        if (stepping) run.backs.add(back.elapsed_ns());
+        stepping = false;
+        ++stops;
+        if (!recorder || backs >= mode.backs || (backs == 0 && stops < mode.back_from)) return;
+        ++backs;
+        if (!recorder->step_back()) throw std::runtime_error("step_back failed");
+        stepping = true;
+        back.restart();
+    });
+    Stopwatch t;
+    vm.run(source, name);
+    run.ns = t.elapsed_ns();
+    if (recorder) {
+        recorder->flush();
+        run.stats = recorder->stats();
+    }
+    return run;
+}
+
+Samples time_runs(const std::string& source, const char* name, std::size_t runs, const Mode& mode,
+                  Run* last = nullptr) {
+    Samples samples;
+    for (std::size_t i = 0; i < runs; ++i) {
+        Run run = run_once(source, name, mode);
+        samples.add(run.ns);
+        if (last) *last = std::move(run);
+    }
+    return samples;
+}
+
+double overhead(Samples& base, Samples& with) {
+    const double b = base.percentile(50);
+    return b > 0 ? 100.0 * (with.percentile(50) - b) / b : 0.0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 5);
+
+    Report report("script_record");
+    try {
+        for (const char* name : {"fib", "nbody", "strings", "tables", "alloc"}) {
+            const std::string source = read_script(name);
+            Samples plain = time_runs(source, name, runs, Mode{});
+            Samples recorded = time_runs(source, name, runs, Mode{true});
+            report.metric(std::string(name) + ".record.p50", recorded.percentile(50) / 1e6, "ms");
+            report.metric(std::string(name) + ".overhead", overhead(plain, recorded), "%");
+        }
+
+        Samples plain = time_runs(kClockScript, "clock", runs, Mode{});
+        Run last;
+        Samples recorded = time_runs(kClockScript, "clock", runs, Mode{true}, &last);
+        report.metric("clock.record.p50", recorded.percentile(50) / 1e6, "ms");
+        report.metric("clock.overhead", overhead(plain, recorded), "%");
+        const double results = static_cast<double>(last.stats.results);
+        const double bytes = static_cast<double>(last.stats.bytes);
+        report.metric("clock.bytes_per_result", results > 0 ? bytes / results : 0.0, "B");
+        const double seconds = recorded.percentile(50) / 1e9;
+        report.metric("clock.mb_per_10min", seconds > 0 ? bytes / seconds * 600 / 1e6 : 0.0, "MB");
+
+        Samples stops = time_runs(kStopScript, "stops", runs, Mode{false, kStopLine});
+        Samples checkpoints = time_runs(kStopScript, "stops", runs, Mode{true, kStopLine}, &last);
+        report.metric("checkpoint.mean",
+                      (checkpoints.percentile(50) - stops.percentile(50)) / static_cast<double>(kStops) / 1e3, "us");
+        report.metric("checkpoint.tables_copied",
+                      static_cast<double>(last.stats.tables_copied) / static_cast<double>(last.stats.checkpoints), "");
+
+        for (std::uint32_t interval : {1u, 8u}) {
+            Samples backs;
+            for (std::size_t i = 0; i < runs; ++i) {
+                Run run = run_once(kStopScript, "stops", Mode{true, kStopLine, interval, kStops / 2, 50});
+                backs.add(run.backs.mean());
+            }
+            report.metric("step_back." + std::to_string(interval) + ".mean", backs.percentile(50) / 1e3, "us");
+        }
+    } catch (const rebel::script::ScriptError& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    std::filesystem::remove(log_path());
+    return 0;
+}
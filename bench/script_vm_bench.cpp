@@ -0,0 +1,128 @@
+// Interpreter throughput on standard workloads: recursive calls (fib),
+// float arithmetic with field access (nbody), string building (strings),
+// array/hash access (tables), allocation churn (alloc) and global access
+// while a native defines more globals (globals). Each script
+// checks its own result and raises an error if the VM computed something
+// different. Collector counters are reported from the last run of each.
+// Builds with the JIT also time each workload on the interpreter alone
+// (<name>.interp.p50) for comparison. <name>.debug.p50 runs with a
+// debugger attached and no breakpoints, which should cost nothing.
+// fib.cond.p50 adds a never-true conditional breakpoint on the line every
+// call runs (1.6M evaluations per run).
+//
+//   bench_script_vm [--runs 5]
+
+#include "bench.h"
+
+#include "script/debugger.h"
+#include "script/vm.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#ifndef REBEL_BENCH_SCRIPTS
+#define REBEL_BENCH_SCRIPTS "bench/scripts"
+#endif
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+std::string read_script(const std::string& name) {
+    const std::string path = std::string(REBEL_BENCH_SCRIPTS) + "/" + name + ".rbl";
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open " + path);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// define_globals(n): defines n new globals, as loading more source would.
+rebel::script::Value define_globals(rebel::script::VM& vm, rebel::script::NativeArgs args) {
+    static std::uint64_t next = 0;
+    for (int n = static_cast<int>(args[0].as_number()); n > 0; --n) {
+        vm.set_global("bench_global_" + std::to_string(next++), rebel::script::Value::number(0));
+    }
+    return {};
+}
+
+// Median wall time of `runs` fresh-VM runs; collector stats of the last.
+struct Mode {
+    bool jit = true;
+    bool debugger = false;
+    std::uint32_t line = 0;  // conditional breakpoint, with the debugger
+    const char* condition = "";
+};
+
+Samples time_runs(const std::string& source, const char* name, std::size_t runs, Mode mode,
+                  rebel::script::Heap::Stats& gc) {
+    Samples samples;
+    for (std::size_t run = 0; run < runs; ++run) {
+        // A fresh VM per run so the heap starts empty every time.
+        rebel::script::VM vm;
+        vm.set_print_handler([](std::string_view) {});
+        vm.define_native("define_globals", define_globals);
+#ifdef REBEL_SCRIPT_JIT
+        rebel::script::Jit::Config config = vm.jit().config();
+        config.enabled = mode.jit;
+        vm.jit().configure(config);
+#endif
+        std::optional<rebel::script::Debugger> debugger;
+        if (mode.debugger) debugger.emplace(vm);
+        if (mode.line) {
+            rebel::script::BreakpointOptions options;
+            options.condition = mode.condition;
+            debugger->set_breakpoint(name, mode.line, options);
+        }
+        Stopwatch t;
+        vm.run(source, name);
+        samples.add(t.elapsed_ns());
+        gc = vm.heap().stats();
+    }
+    return samples;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 5);
+
+    Report report("script_vm");
+    for (const char* name : {"fib", "nbody", "strings", "tables", "alloc", "globals"}) {
+        const std::string source = read_script(name);
+        rebel::script::Heap::Stats gc;
+        Samples samples;
+        try {
+            samples = time_runs(source, name, runs, Mode{}, gc);
+            rebel::script::Heap::Stats other_gc;
+#ifdef REBEL_SCRIPT_JIT
+            Samples interp = time_runs(source, name, runs, Mode{false, false}, other_gc);
+            report.metric(std::string(name) + ".interp.p50", interp.percentile(50) / 1e6, "ms");
+#endif
+            Samples debug = time_runs(source, name, runs, Mode{true, true}, other_gc);
+            report.metric(std::string(name) + ".debug.p50", debug.percentile(50) / 1e6, "ms");
+            if (std::string(name) == "fib") {
+                Samples cond = time_runs(source, name, runs, Mode{true, true, 3, "n < 0"}, other_gc);
+                report.metric("fib.cond.p50", cond.percentile(50) / 1e6, "ms");
+            }
+        } catch (const rebel::script::ScriptError& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        report.metric(std::string(name) + ".p50", samples.percentile(50) / 1e6, "ms");
+        report.metric(std::string(name) + ".min", samples.percentile(0) / 1e6, "ms");
+        report.metric(std::string(name) + ".gc.minor", static_cast<double>(gc.minor_collections), "");
+        report.metric(std::string(name) + ".gc.major", static_cast<double>(gc.major_collections), "");
+        report.metric(std::string(name) + ".gc.max_pause", static_cast<double>(gc.max_pause_ns) / 1e6, "ms");
+        const double allocated = static_cast<double>(gc.bytes_allocated);
+        report.metric(std::string(name) + ".gc.survival",
+                      allocated > 0 ? 100.0 * static_cast<double>(gc.bytes_promoted) / allocated : 0.0, "%");
+    }
+    return 0;
+}
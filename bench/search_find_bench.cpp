@@ -0,0 +1,170 @@
+// Find-in-file and find-in-workspace throughput (search::Query,
+// search::WorkspaceSearch) over synthetic C++ text.
+//
+// The buffer.* metrics search --mb of text in memory: newlines counted with
+// count_byte against std::count, a rare literal with the LiteralFinder
+// against std::string_view::find, the same literal ignoring case, and two
+// regexes, one with a required literal to skip ahead with and one without;
+// std_regex runs the first regex through std::regex on a 1 MB slice for
+// scale. The workspace.* metrics search --files files written to a
+// temporary directory on --threads workers (0 = one per core):
+// first_result.ms is when the first file's matches were published, and
+// cancel.us how long a cancelled search took to wind down.
+//
+//   bench_search_find [--mb 64] [--files 4000] [--threads 0]
+
+#include "bench.h"
+
+#include "core/thread_pool.h"
+#include "search/query.h"
+#include "search/regex.h"
+#include "search/scan.h"
+#include "search/workspace_search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using rebel::bench::Report;
+using rebel::bench::Stopwatch;
+using rebel::search::Query;
+using rebel::search::QueryOptions;
+
+namespace {
+
+std::string source(std::size_t n, std::mt19937_64& rng) {
+    std::uniform_int_distribution<std::size_t> pick(0, 9999);
+    std::string text = "#include <vector>\n\nnamespace module" + std::to_string(n % 100) + " {\n\n";
+    for (int f = 0; f < 24; ++f) {
+        const std::string name = "compute_" + std::to_string(pick(rng)) + "_" + std::to_string(f % 10);
+        text += "// Combines the inputs of " + name + " with the current Layout.\n";
+        text += "static int " + name + "(const std::vector<int>& values, int scale) {\n";
+        text += "    int total = 0;\n";
+        text += "    for (int v : values) total += helper_" + std::to_string(pick(rng) % 1000) + "(v) * scale;\n";
+        text += "    if (total > limit_" + std::to_string(pick(rng) % 1000) + ") return clamp(total, \"overflow\");\n";
+        text += "    return total;\n}\n\n";
+    }
+    return text + "}  // namespace module" + std::to_string(n % 100) + "\n";
+}
+
+double gb_per_s(std::size_t bytes, double ms) { return static_cast<double>(bytes) / ms / 1e6; }
+
+// Runs `query` over `text` and reports throughput and the match count.
+void time_query(Report& report, const std::string& name, const Query& query, std::string_view text) {
+    Stopwatch t;
+    std::size_t matches = 0;
+    for (auto m = query.find(text); m; m = query.find(text, m->offset + std::max<std::size_t>(m->length, 1))) {
+        ++matches;
+    }
+    const double ms = t.elapsed_ms();
+    report.metric("buffer." + name + ".gb_per_s", gb_per_s(text.size(), ms), "GB/s");
+    report.metric("buffer." + name + ".matches", static_cast<double>(matches), "");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t mb = rebel::bench::arg(argc, argv, "mb", 64);
+    const std::size_t files = rebel::bench::arg(argc, argv, "files", 4000);
+    const std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+
+    Report report("search_find");
+    report.metric(std::string("isa.") + rebel::search::isa_name(rebel::search::active_isa()), 1, "");
+
+    std::mt19937_64 rng(11);
+    std::string text;
+    for (std::size_t n = 0; text.size() < mb << 20; ++n) text += source(n, rng);
+
+    Stopwatch t;
+    std::size_t lines = rebel::search::count_byte(text, '\n');
+    report.metric("buffer.count_lines.gb_per_s", gb_per_s(text.size(), t.elapsed_ms()), "GB/s");
+    t.restart();
+    const auto baseline_lines = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    report.metric("buffer.count_lines.std.gb_per_s", gb_per_s(text.size(), t.elapsed_ms()), "GB/s");
+    rebel::bench::do_not_optimize(lines + baseline_lines);
+
+    const std::string rare = "compute_4242_2";
+    t.restart();
+    std::size_t found = 0;
+    for (std::size_t at = std::string_view(text).find(rare); at != std::string_view::npos;
+         at = std::string_view(text).find(rare, at + 1)) {
+        ++found;
+    }
+    report.metric("buffer.literal.std.gb_per_s", gb_per_s(text.size(), t.elapsed_ms()), "GB/s");
+    rebel::bench::do_not_optimize(found);
+    time_query(report, "literal", Query(rare), text);
+    time_query(report, "literal_nocase", Query("COMPUTE_4242_2", {false, true, false}), text);
+    time_query(report, "regex_literal", Query(R"(compute_42\d+_[0-2]\()", {true}), text);
+    time_query(report, "regex_dfa", Query(R"([a-z]+_[0-9]{4}_[0-9]\()", {true}), text);
+
+    {
+        const std::string slice = text.substr(0, 1 << 20);
+        const std::regex re(R"(compute_42\d+_[0-2]\()");
+        t.restart();
+        std::size_t count = 0;
+        for (std::sregex_iterator it(slice.begin(), slice.end(), re), end; it != end; ++it) ++count;
+        report.metric("buffer.std_regex.gb_per_s", gb_per_s(slice.size(), t.elapsed_ms()), "GB/s");
+        rebel::bench::do_not_optimize(count);
+    }
+    text.clear();
+    text.shrink_to_fit();
+
+    const fs::path root = fs::temp_directory_path() / "rebel_search_bench";
+    fs::remove_all(root);
+    std::size_t bytes = 0;
+    for (std::size_t n = 0; n < files; ++n) {
+        const fs::path path = root / ("pkg" + std::to_string(n % 50)) / ("file" + std::to_string(n) + ".cpp");
+        fs::create_directories(path.parent_path());
+        std::string contents;
+        for (int part = 0; part < 4; ++part) contents += source(n * 4 + static_cast<std::size_t>(part), rng);
+        bytes += contents.size();
+        std::ofstream(path, std::ios::binary) << contents;
+    }
+    report.metric("workspace.files", static_cast<double>(files), "");
+    report.metric("workspace.mb", static_cast<double>(bytes) / (1 << 20), "MB");
+
+    rebel::core::ThreadPool pool(threads);
+    rebel::search::WorkspaceSearch search(pool);
+    report.metric("threads", static_cast<double>(pool.size()), "");
+
+    auto run = [&](const std::string& name, const Query& pattern) {
+        auto query = std::make_shared<const Query>(pattern.pattern(), pattern.options());
+        Stopwatch clock;
+        std::atomic<double> first{-1};
+        auto job = search.start(root.string(), query, [&] {
+            double unset = -1;
+            first.compare_exchange_strong(unset, clock.elapsed_ms());
+        });
+        job->wait();
+        const double ms = clock.elapsed_ms();
+        const auto stats = job->stats();
+        report.metric("workspace." + name + ".ms", ms, "ms");
+        report.metric("workspace." + name + ".gb_per_s", gb_per_s(stats.bytes, ms), "GB/s");
+        report.metric("workspace." + name + ".first_result.ms", first.load(), "ms");
+        report.metric("workspace." + name + ".matches", static_cast<double>(stats.matches), "");
+    };
+    run("literal", Query("compute_4242_2"));  // first run also warms the page cache
+    run("literal", Query("compute_4242_2"));
+    run("regex", Query(R"(helper_\d+\(v\) \* scale)", {true}));
+
+    // Cancel as soon as the first results arrive, as typing another
+    // character into the search box would.
+    std::atomic<bool> started{false};
+    auto job = search.start(root.string(), std::make_shared<const Query>("total"), [&] { started = true; });
+    while (!started && !job->done()) std::this_thread::yield();
+    t.restart();
+    search.cancel();
+    job->wait();
+    report.metric("workspace.cancel.us", t.elapsed_ns() / 1e3, "us");
+    report.metric("workspace.cancel.files", static_cast<double>(job->stats().files), "");
+
+    fs::remove_all(root);
+    return 0;
+}
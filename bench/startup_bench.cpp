@@ -0,0 +1,183 @@
+// Launch cost of app::Environment: the script VM with a standard library
+// brought in by running it (script.prelude.run) or from the runtime image
+// (script.image.restore), and what each lazily started subsystem costs on
+// first use.
+//
+// The prelude stands in for a standard library plus plugins: --modules
+// chunks of --functions functions each, every module building an export
+// table, a keymap and some settings when it runs. prelude.* is its size.
+// launch.run is an Environment built with no image (the first launch,
+// which also writes the image), launch.image one restored from it, both
+// p50 over --runs in this process; image.* is the image. process.p50/p99
+// is a whole launch as the user sees it, fork and exec of this binary with
+// --launch 1 through to its exit. first_use.* is what the thread pool,
+// workspace search and symbol index (over --files generated source files)
+// cost the first time each is asked for, from the environment's trace.
+// Run with REBEL_STARTUP_TRACE=- to see every launch's phases.
+//
+//   bench_startup [--modules 40] [--functions 100] [--runs 20] [--files 200]
+
+#include "bench.h"
+
+#include "app/environment.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+
+namespace {
+
+std::vector<rebel::script::PreludeChunk> prelude(std::size_t modules, std::size_t functions) {
+    std::vector<rebel::script::PreludeChunk> chunks;
+    for (std::size_t m = 0; m < modules; ++m) {
+        const std::string mod = "mod" + std::to_string(m);
+        std::string source = "// " + mod + "\n";
+        source += "let " + mod + " = {name: \"" + mod + "\", version: " + std::to_string(m) +
+                  ", keys: {}, settings: {}}\n";
+        for (std::size_t f = 0; f < functions; ++f) {
+            const std::string name = mod + "_f" + std::to_string(f);
+            source += "fn " + name + "(text, count) {\n";
+            source += "    let out = []\n";
+            source += "    for i in 0..count {\n";
+            source += "        if find(text, \"" + std::to_string(f) + "\", i) != nil { push(out, sub(text, i, i + 4)) }\n";
+            source += "        else { push(out, str(i * " + std::to_string(f + 1) + " % 7)) }\n";
+            source += "    }\n";
+            source += "    if len(out) > " + std::to_string(f % 9 + 2) + " { return join(out, \", \") }\n";
+            source += "    return {kind: \"" + name + "\", items: out, size: len(out)}\n";
+            source += "}\n";
+            source += mod + "." + "f" + std::to_string(f) + " = " + name + "\n";
+        }
+        source += "for i in 0.." + std::to_string(functions) + " {\n";
+        source += "    " + mod + ".keys[\"<C-\" + str(i) + \">\"] = \"" + mod + "_f\" + str(i)\n";
+        source += "    " + mod + ".settings[\"option_\" + str(i)] = {default: i * 2, doc: \"Option \" + str(i)}\n";
+        source += "}\n";
+        chunks.push_back({mod + ".rbl", std::move(source)});
+    }
+    return chunks;
+}
+
+void make_workspace(const std::filesystem::path& root, std::size_t files) {
+    std::filesystem::create_directories(root / "src");
+    for (std::size_t n = 0; n < files; ++n) {
+        std::ofstream out(root / "src" / ("file" + std::to_string(n) + ".cpp"));
+        for (int f = 0; f < 20; ++f) {
+            out << "int function_" << n << "_" << f << "(int value) { return helper_" << f << "(value) + " << n
+                << "; }\n";
+        }
+    }
+}
+
+rebel::app::EnvironmentOptions options(const std::filesystem::path& root, std::size_t modules, std::size_t functions) {
+    rebel::app::EnvironmentOptions options;
+    options.workspace = (root / "workspace").string();
+    options.state_dir = (root / "state").string();
+    options.prelude = prelude(modules, functions);
+    options.plugin_metadata = R"({"plugins":[{"name":"example","version":"1.0"}]})";
+    options.natives = [](rebel::script::VM& vm) { vm.set_print_handler([](std::string_view) {}); };
+    return options;
+}
+
+double phase_ms(const rebel::core::StartupTrace& trace, const std::string& name) {
+    for (const rebel::core::StartupTrace::Phase& phase : trace.phases()) {
+        if (phase.name == name) return phase.duration_ms;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+// Wall time of one launch of this binary with `args`, in ns; -1 if it
+// could not be started or failed.
+double launch(const char* self, std::vector<std::string> args) {
+    std::vector<char*> argv{const_cast<char*>(self)};
+    for (std::string& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+    Stopwatch t;
+    pid_t pid;
+    if (posix_spawn(&pid, self, nullptr, nullptr, argv.data(), environ) != 0) return -1;
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return t.elapsed_ns();
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t modules = rebel::bench::arg(argc, argv, "modules", 40);
+    const std::size_t functions = rebel::bench::arg(argc, argv, "functions", 100);
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 20);
+    const std::size_t files = rebel::bench::arg(argc, argv, "files", 200);
+    const std::filesystem::path root = std::filesystem::temp_directory_path() / "rebel_startup_bench";
+
+    if (rebel::bench::arg(argc, argv, "launch", 0) != 0) {
+        rebel::app::Environment environment(options(root, modules, functions));
+        return environment.prelude_from_image() ? 0 : 1;
+    }
+
+    std::filesystem::remove_all(root);
+    make_workspace(root / "workspace", files);
+    const rebel::app::EnvironmentOptions base = options(root, modules, functions);
+    const std::string image_path = base.state_dir + "/runtime.img";
+
+    Report report("startup");
+    std::size_t prelude_bytes = 0;
+    for (const rebel::script::PreludeChunk& chunk : base.prelude) prelude_bytes += chunk.source.size();
+    report.metric("prelude.bytes", static_cast<double>(prelude_bytes), "B");
+    report.metric("prelude.functions", static_cast<double>(modules * functions), "");
+
+    Samples run;
+    Samples image;
+    Samples restore;
+    for (std::size_t r = 0; r < runs; ++r) {
+        std::filesystem::remove(image_path);
+        Stopwatch t;
+        rebel::app::Environment environment(base);
+        run.add(t.elapsed_ns());
+        if (environment.prelude_from_image()) return 1;
+    }
+    for (std::size_t r = 0; r < runs; ++r) {
+        Stopwatch t;
+        rebel::app::Environment environment(base);
+        image.add(t.elapsed_ns());
+        restore.add(phase_ms(environment.trace(), "script.image.restore") * 1e6);
+        if (!environment.prelude_from_image()) return 1;
+    }
+    report.metric("launch.run.p50", run.percentile(50) / 1e6, "ms");
+    report.metric("launch.image.p50", image.percentile(50) / 1e6, "ms");
+    report.metric("launch.image.restore.p50", restore.percentile(50) / 1e6, "ms");
+    report.metric("image.bytes", static_cast<double>(std::filesystem::file_size(image_path)), "B");
+
+#ifndef _WIN32
+    Samples process;
+    for (std::size_t r = 0; r < runs; ++r) {
+        const double ns = launch(argv[0], {"--launch", "1", "--modules", std::to_string(modules), "--functions",
+                                           std::to_string(functions)});
+        if (ns < 0) return 1;
+        process.add(ns);
+    }
+    report.latency("process", process);
+#endif
+
+    {
+        rebel::app::Environment environment(base);
+        environment.pool();
+        environment.search();
+        rebel::bench::do_not_optimize(environment.symbols()->symbol_count());
+        report.metric("first_use.thread_pool", phase_ms(environment.trace(), "init thread_pool"), "ms");
+        report.metric("first_use.search", phase_ms(environment.trace(), "init search"), "ms");
+        report.metric("first_use.symbol_index", phase_ms(environment.trace(), "init symbol_index"), "ms");
+    }
+    std::filesystem::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Edit-to-highlight latency: time from HighlightSession::update() on the
+// editing thread until the snapshot for that edit is published by the worker
+// pool, against re-lexing the whole document for every keystroke.
+//
+//   bench_syntax_highlight [--lines 50000] [--edits 5000] [--threads 0]
+
+#include "bench.h"
+
+#include "core/thread_pool.h"
+#include "syntax/highlight_session.h"
+#include "syntax/language.h"
+
+#include <random>
+#include <string>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::syntax::HighlightSession;
+using rebel::syntax::LineEdit;
+using rebel::text::Rope;
+
+namespace {
+
+std::string synthetic_cpp(std::size_t lines, std::mt19937_64& rng) {
+    static const char* const kLines[] = {
+        "#include <vector>",
+        "namespace demo {",
+        "/* block comment",
+        "   spanning lines */",
+        "static int counter_ = 0;  // trailing comment",
+        "std::vector<int> values{1, 2, 3, 0x1f, 4.5e-3};",
+        "for (int i = 0; i < limit; ++i) {",
+        "    total += compute(values[i], \"label\\n\");",
+        "}",
+        "if (flag && !other) return nullptr;",
+        "class Widget final : public Base {",
+        "  public:",
+        "    explicit Widget(const char* name) : name_(name) {}",
+        "};",
+        "}  // namespace demo",
+        "",
+    };
+    std::uniform_int_distribution<std::size_t> pick(0, std::size(kLines) - 1);
+    std::string text;
+    for (std::size_t i = 0; i < lines; ++i) {
+        text += kLines[pick(rng)];
+        text.push_back('\n');
+    }
+    return text;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t lines = rebel::bench::arg(argc, argv, "lines", 50000);
+    const std::size_t edits = rebel::bench::arg(argc, argv, "edits", 5000);
+    const std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+
+    Report report("syntax_highlight");
+    std::mt19937_64 rng(11);
+    Rope text(synthetic_cpp(lines, rng));
+    report.metric("document.lines", static_cast<double>(text.line_count()), "lines");
+
+    rebel::core::ThreadPool pool(threads);
+    report.metric("pool.threads", static_cast<double>(pool.size()), "threads");
+
+    Stopwatch initial_timer;
+    auto session = HighlightSession::create(pool, rebel::syntax::cpp_language(), text);
+    session->wait_for(0);
+    report.metric("initial_lex", initial_timer.elapsed_ms(), "ms");
+
+    // Mostly identifier characters, with the occasional newline or quote.
+    static const char* const kKeystrokes[] = {"a", "x", "_", "1", " ", "(", ")", ";", "\n", "\""};
+    std::uniform_int_distribution<std::size_t> pick_key(0, std::size(kKeystrokes) - 1);
+    Samples keystroke;
+    keystroke.reserve(edits);
+    for (std::size_t i = 0; i < edits; ++i) {
+        const std::size_t line = std::uniform_int_distribution<std::size_t>(0, text.line_count() - 1)(rng);
+        const std::size_t offset = text.line_start(line);
+        const std::string key = kKeystrokes[pick_key(rng)];
+
+        Stopwatch t;
+        const LineEdit edit = LineEdit::for_replace(text, offset, 0, key);
+        text.insert(offset, key);
+        const auto version = session->update(text, edit);
+        session->wait_for(version);
+        keystroke.add(t.elapsed_ns());
+    }
+    report.latency("edit_to_highlight", keystroke);
+
+    // Opening a block comment near the top invalidates everything up to the
+    // next "*/", which is the worst case for state convergence.
+    {
+        Stopwatch t;
+        const LineEdit edit = LineEdit::for_replace(text, 0, 0, "/*");
+        text.insert(0, "/*");
+        session->wait_for(session->update(text, edit));
+        report.metric("open_block_comment", t.elapsed_ns() / 1e3, "us");
+    }
+
+    const auto stats = session->stats();
+    report.metric("lines_lexed_per_pass", static_cast<double>(stats.lines_lexed) / static_cast<double>(stats.passes),
+                  "lines");
+
+    rebel::syntax::Highlighter full(rebel::syntax::cpp_language());
+    Samples relex;
+    for (int i = 0; i < 20; ++i) {
+        Stopwatch t;
+        full.reset(text);
+        relex.add(t.elapsed_ns());
+    }
+    report.latency("full_relex_baseline", relex);
+    return 0;
+}
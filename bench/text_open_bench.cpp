@@ -0,0 +1,119 @@
+// File-open benchmarks: time to first screen, background index completion and
+// first edit for a memory-mapped TextDocument, against reading the whole file
+// into memory before building a rope.
+//
+//   bench_text_open [--mb 1024] [--path /tmp/rebel_open_bench.txt]
+//
+// The page cache is dropped for the file before each open (posix_fadvise), so
+// the numbers approximate a cold open where the kernel honours the hint.
+
+#include "bench.h"
+
+#include "text/document.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using rebel::bench::Report;
+using rebel::bench::Stopwatch;
+using rebel::text::Rope;
+using rebel::text::TextDocument;
+
+namespace {
+
+constexpr std::size_t kScreenLines = 60;
+
+void write_trace_dump(const std::string& path, std::size_t bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::mt19937_64 rng(7);
+    std::string line;
+    std::size_t written = 0;
+    for (std::uint64_t seq = 0; written < bytes; ++seq) {
+        line = "ts=" + std::to_string(seq * 17) + " tid=" + std::to_string(rng() % 64) +
+               " event=span_" + std::to_string(rng() % 1000) + " dur_ns=" + std::to_string(rng() % 100000);
+        line.append(rng() % 40, '.');
+        line.push_back('\n');
+        out.write(line.data(), static_cast<std::streamsize>(line.size()));
+        written += line.size();
+    }
+}
+
+void drop_page_cache(const std::string& path) {
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+#else
+    (void)path;
+#endif
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t megabytes = rebel::bench::arg(argc, argv, "mb", 1024);
+    std::string path = "/tmp/rebel_open_bench.txt";
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--path") path = argv[i + 1];
+    }
+
+    Report report("text_open");
+    write_trace_dump(path, megabytes << 20);
+    report.metric("file.size", static_cast<double>(megabytes), "MiB");
+
+    {
+        drop_page_cache(path);
+        Stopwatch open_timer;
+        auto doc = TextDocument::open(path);
+        report.metric("mmap.open", open_timer.elapsed_ms(), "ms");
+        const auto screen = doc->lines(0, kScreenLines);
+        report.metric("mmap.first_paint", open_timer.elapsed_ms(), "ms");
+        rebel::bench::do_not_optimize(screen.size());
+
+        // Scrolling a little way down typically lands in the scanned prefix.
+        Stopwatch scroll_timer;
+        const auto page = doc->lines(10000, kScreenLines);
+        report.metric("mmap.scroll_to_line_10000", scroll_timer.elapsed_ms(), "ms");
+        rebel::bench::do_not_optimize(page.size());
+
+        Stopwatch rope_timer;
+        const Rope& rope = doc->rope();
+        report.metric("mmap.index_ready", open_timer.elapsed_ms(), "ms");
+        report.metric("mmap.rope_wait_and_build", rope_timer.elapsed_ms(), "ms");
+        report.metric("mmap.lines", static_cast<double>(rope.line_count()), "lines");
+
+        Stopwatch edit_timer;
+        doc->replace(doc->size() / 2, 0, "edited");
+        report.metric("mmap.first_edit", edit_timer.elapsed_ns() / 1e3, "us");
+
+        Stopwatch jump_timer;
+        const auto tail = doc->lines(doc->rope().line_count() - kScreenLines, kScreenLines);
+        report.metric("mmap.jump_to_end", jump_timer.elapsed_ns() / 1e3, "us");
+        rebel::bench::do_not_optimize(tail.size());
+    }
+
+    {
+        drop_page_cache(path);
+        Stopwatch eager_timer;
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        std::string text(static_cast<std::size_t>(in.tellg()), '\0');
+        in.seekg(0);
+        in.read(text.data(), static_cast<std::streamsize>(text.size()));
+        Rope rope(text);
+        const std::string first = rope.line(0);
+        report.metric("eager.first_paint", eager_timer.elapsed_ms(), "ms");
+        rebel::bench::do_not_optimize(first.size());
+    }
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Rope microbenchmarks: build, single-keystroke edits, block pastes and
+// line/position lookups on a large synthetic source file, with std::string
+// inserts on the same text as the contiguous-buffer baseline.
+//
+//   bench_text_rope [--mb 64] [--ops 200000]
+
+#include "bench.h"
+
+#include "text/rope.h"
+
+#include <random>
+#include <string>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::text::Rope;
+
+namespace {
+
+std::string synthetic_source(std::size_t bytes, std::mt19937_64& rng) {
+    static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz_(){};=+-*/ 0123456789";
+    std::uniform_int_distribution<int> line_length(0, 120);
+    std::uniform_int_distribution<std::size_t> pick(0, sizeof kAlphabet - 2);
+    std::string text;
+    text.reserve(bytes + 128);
+    while (text.size() < bytes) {
+        for (int n = line_length(rng); n > 0; --n) text.push_back(kAlphabet[pick(rng)]);
+        text.push_back('\n');
+    }
+    return text;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t megabytes = rebel::bench::arg(argc, argv, "mb", 64);
+    const std::size_t ops = rebel::bench::arg(argc, argv, "ops", 200000);
+
+    Report report("text_rope");
+    std::mt19937_64 rng(42);
+    const std::string source = synthetic_source(megabytes << 20, rng);
+    report.metric("document.size", static_cast<double>(source.size()) / (1 << 20), "MiB");
+
+    Stopwatch build_timer;
+    Rope rope(source);
+    report.metric("build", build_timer.elapsed_ms(), "ms");
+    report.metric("height", static_cast<double>(rope.height()), "levels");
+
+    auto random_offset = [&](std::size_t limit) {
+        return std::uniform_int_distribution<std::size_t>(0, limit)(rng);
+    };
+
+    Samples insert;
+    insert.reserve(ops);
+    for (std::size_t i = 0; i < ops; ++i) {
+        const std::size_t at = random_offset(rope.size());
+        Stopwatch t;
+        rope.insert(at, "x");
+        insert.add(t.elapsed_ns());
+    }
+    report.latency("insert_char", insert);
+
+    Samples erase;
+    erase.reserve(ops);
+    for (std::size_t i = 0; i < ops; ++i) {
+        const std::size_t at = random_offset(rope.size() - 1);
+        Stopwatch t;
+        rope.erase(at, 1);
+        erase.add(t.elapsed_ns());
+    }
+    report.latency("erase_char", erase);
+
+    const std::string block = synthetic_source(16 << 10, rng);
+    Samples paste;
+    for (std::size_t i = 0; i < ops / 100; ++i) {
+        const std::size_t at = random_offset(rope.size());
+        Stopwatch t;
+        rope.insert(at, block);
+        paste.add(t.elapsed_ns());
+    }
+    report.latency("paste_16k", paste);
+
+    Samples cut;
+    for (std::size_t i = 0; i < ops / 100; ++i) {
+        const std::size_t at = random_offset(rope.size() - block.size());
+        Stopwatch t;
+        rope.erase(at, block.size());
+        cut.add(t.elapsed_ns());
+    }
+    report.latency("erase_16k", cut);
+
+    Samples line_start;
+    line_start.reserve(ops);
+    std::size_t checksum = 0;
+    for (std::size_t i = 0; i < ops; ++i) {
+        const std::size_t line = random_offset(rope.line_count() - 1);
+        Stopwatch t;
+        checksum += rope.line_start(line);
+        line_start.add(t.elapsed_ns());
+    }
+    report.latency("line_start", line_start);
+
+    Samples position;
+    position.reserve(ops);
+    for (std::size_t i = 0; i < ops; ++i) {
+        const std::size_t at = random_offset(rope.size());
+        Stopwatch t;
+        checksum += rope.position_of(at).column;
+        position.add(t.elapsed_ns());
+    }
+    report.latency("position_of", position);
+    rebel::bench::do_not_optimize(checksum);
+
+    Stopwatch snapshot_timer;
+    Rope snapshot = rope;
+    snapshot.insert(snapshot.size() / 2, "y");
+    report.metric("snapshot_and_edit", snapshot_timer.elapsed_ns(), "ns");
+
+    // Contiguous baseline; far fewer iterations since each insert moves
+    // half the buffer on average.
+    std::string flat = source;
+    Samples flat_insert;
+    for (std::size_t i = 0; i < 200; ++i) {
+        const std::size_t at = random_offset(flat.size());
+        Stopwatch t;
+        flat.insert(at, 1, 'x');
+        flat_insert.add(t.elapsed_ns());
+    }
+    report.latency("std_string_insert_char", flat_insert);
+    return 0;
+}
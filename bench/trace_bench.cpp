@@ -0,0 +1,108 @@
+// Cost of latency tracing (core/trace.h) and the accuracy of its
+// percentiles.
+//
+// cost.enabled is the cost of one REBEL_TRACE_SCOPE span around nothing,
+// cost.disabled the same with trace::set_enabled(false), and
+// cost.threads.<n> with --threads threads (default: one per core) recording
+// into one probe at once: their histogram counters share cache lines, their
+// rings do not.
+// chrome.ms and chrome.bytes are exporting full rings on every thread that
+// traced. accuracy.p50/p99 compare the histogram's percentiles of
+// log-uniform durations against exact ones; bucketing bounds the error at
+// 6.25%.
+//
+//   bench_trace [--spans 5000000] [--threads 0]
+
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+namespace trace = rebel::core::trace;
+
+namespace {
+
+#ifdef REBEL_TRACING
+void traced(std::size_t spans) {
+    for (std::size_t i = 0; i < spans; ++i) {
+        REBEL_TRACE_SCOPE("bench.span");
+        rebel::bench::do_not_optimize(i);
+    }
+}
+
+double per_span_ns(std::size_t spans) {
+    Stopwatch t;
+    traced(spans);
+    return t.elapsed_ns() / static_cast<double>(spans);
+}
+
+trace::Probe synthetic("bench.synthetic");
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t spans = rebel::bench::arg(argc, argv, "spans", 5'000'000);
+    std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    Report report("trace");
+#ifdef REBEL_TRACING
+    trace::set_thread_name("bench");
+    traced(spans / 10);  // warm up
+    report.metric("cost.enabled", per_span_ns(spans), "ns");
+    trace::set_enabled(false);
+    report.metric("cost.disabled", per_span_ns(spans), "ns");
+    trace::set_enabled(true);
+
+    {
+        std::vector<double> each(threads);
+        std::vector<std::thread> workers;
+        for (std::size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] { each[t] = per_span_ns(spans / threads); });
+        }
+        for (std::thread& w : workers) w.join();
+        double mean = 0;
+        for (const double ns : each) mean += ns / static_cast<double>(threads);
+        report.metric("cost.threads." + std::to_string(threads), mean, "ns");
+    }
+
+    Samples export_ms;
+    std::size_t bytes = 0;
+    for (int i = 0; i < 5; ++i) {
+        Stopwatch t;
+        const std::string json = trace::chrome_json();
+        export_ms.add(t.elapsed_ms());
+        bytes = json.size();
+    }
+    report.metric("chrome.ms", export_ms.percentile(50), "ms");
+    report.metric("chrome.bytes", static_cast<double>(bytes), "B");
+
+    // Durations spread evenly over 100 ns .. 10 ms on a log scale.
+    trace::reset();
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> exponent(2, 7);
+    Samples exact;
+    const std::uint64_t base = trace::now_ns();
+    for (int i = 0; i < 200'000; ++i) {
+        const auto ns = static_cast<std::uint64_t>(std::pow(10.0, exponent(random)));
+        synthetic.record(base, base + ns);
+        exact.add(static_cast<double>(ns));
+    }
+    const trace::Latency latency = synthetic.latency();
+    report.metric("accuracy.p50", 100.0 * std::abs(latency.p50_ns / exact.percentile(50) - 1), "%");
+    report.metric("accuracy.p99", 100.0 * std::abs(latency.p99_ns / exact.percentile(99) - 1), "%");
+    trace::reset();
+#else
+    report.metric("compiled_out", 1, "");
+    (void)spans;
+    (void)threads;
+#endif
+    return 0;
+}
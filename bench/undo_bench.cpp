@@ -0,0 +1,149 @@
+// Undo history (text::UndoTree): undo and redo of a bulk edit, and memory
+// and restore times over a long editing session.
+//
+// bulk.* edits every line of a --lines line file through TextDocument, as
+// a script reformatting it would, and times undoing and redoing that as
+// one step. session.* replays --steps undo steps of typing at random
+// places, with a bulk edit every thousand, into a tree held to --budget
+// MiB; committing a step includes spilling older ones. resident_mib and
+// log_mib are what the tree keeps in memory and on disk, against
+// full_copies_mib for a copy of the text per step. The text is random, so
+// the log compresses far less than source code would. restore.* is going
+// back to random revisions, most of them spilled, each checked.
+//
+//   bench_undo [--lines 100000] [--steps 20000] [--budget 16]
+
+#include "bench.h"
+
+#include "core/hash.h"
+#include "text/document.h"
+#include "text/undo.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::text::Rope;
+using rebel::text::TextDocument;
+using rebel::text::UndoTree;
+
+namespace {
+
+std::string synthetic_source(std::size_t lines, std::mt19937_64& rng) {
+    static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz_(){};=+-*/ 0123456789";
+    std::uniform_int_distribution<int> line_length(0, 80);
+    std::uniform_int_distribution<std::size_t> pick(0, sizeof kAlphabet - 2);
+    std::string text;
+    for (std::size_t line = 0; line < lines; ++line) {
+        for (int n = line_length(rng); n > 0; --n) text.push_back(kAlphabet[pick(rng)]);
+        text.push_back('\n');
+    }
+    return text;
+}
+
+// Appends a comment to every line, last line first so offsets hold.
+template <typename Replace>
+void edit_every_line(const Rope& text, Replace replace) {
+    for (std::size_t line = text.newline_count(); line-- > 0;) replace(text.line_end(line), 0, " // ok");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t lines = rebel::bench::arg(argc, argv, "lines", 100000);
+    const std::size_t steps = rebel::bench::arg(argc, argv, "steps", 20000);
+    const std::size_t budget = rebel::bench::arg(argc, argv, "budget", 16);
+
+    Report report("undo");
+    std::mt19937_64 rng(11);
+    const std::string source = synthetic_source(lines, rng);
+
+    {
+        TextDocument doc{Rope(source)};
+        const Rope before = doc.rope();
+        Stopwatch edit;
+        edit_every_line(before, [&](std::size_t offset, std::size_t length, std::string_view text) {
+            doc.replace(offset, length, text);
+        });
+        doc.checkpoint();
+        report.metric("bulk.edit_ms", edit.elapsed_ms(), "ms");
+        const std::size_t edited = doc.size();
+        Stopwatch undo;
+        doc.undo();
+        report.metric("bulk.undo_us", undo.elapsed_ns() / 1e3, "us");
+        Stopwatch redo;
+        doc.redo();
+        report.metric("bulk.redo_us", redo.elapsed_ns() / 1e3, "us");
+        if (doc.size() != edited || !doc.undo() || doc.size() != source.size()) {
+            std::cerr << "bulk undo went wrong\n";
+            return 1;
+        }
+    }
+
+    UndoTree::Options options;
+    options.max_resident_bytes = budget << 20;
+    Rope text(source);
+    UndoTree tree(text, options);
+    // Hashes of a sample of revisions, to check them when restored.
+    std::unordered_map<UndoTree::Revision, std::uint64_t> hashes;
+    double full_copies = 0;
+    Samples commit;
+    commit.reserve(steps);
+    for (std::size_t step = 1; step <= steps; ++step) {
+        const auto replace = [&](std::size_t offset, std::size_t length, std::string_view inserted) {
+            text.replace(offset, length, inserted);
+            tree.record(offset, length, inserted.size());
+        };
+        if (step % 1000 == 0) {
+            edit_every_line(Rope(text), replace);
+        } else {
+            std::size_t at = rng() % (text.size() + 1);
+            for (std::size_t key = 0, keys = 5 + rng() % 20; key < keys; ++key) {
+                if (rng() % 6 == 0 && at > 0) {
+                    replace(--at, 1, {});
+                } else {
+                    replace(at++, 0, std::string_view(&"etaoin shrdlu;\n"[rng() % 15], 1));
+                }
+            }
+        }
+        Stopwatch t;
+        const UndoTree::Revision revision = tree.commit(text);
+        commit.add(t.elapsed_ns());
+        full_copies += static_cast<double>(text.size());
+        if (step % 97 == 0) hashes[revision] = rebel::core::hash64(text.to_string());
+        if (step % 500 == 0) {
+            for (int undo = rng() % 20; undo > 0; --undo) tree.undo();  // and branch from there
+            text = tree.text();
+        }
+    }
+    report.metric("session.commit_p50_us", commit.percentile(50) / 1e3, "us");
+    report.metric("session.commit_p99_us", commit.percentile(99) / 1e3, "us");
+
+    const UndoTree::Stats stats = tree.stats();
+    report.metric("session.revisions", static_cast<double>(stats.revisions), "");
+    report.metric("session.resident", static_cast<double>(stats.resident), "");
+    report.metric("session.resident_mib", static_cast<double>(stats.resident_bytes) / (1 << 20), "MiB");
+    report.metric("session.log_mib", static_cast<double>(stats.log_bytes) / (1 << 20), "MiB");
+    report.metric("session.log_compression",
+                  static_cast<double>(stats.log_raw_bytes) / static_cast<double>(std::max<std::uint64_t>(stats.log_bytes, 1)), "x");
+    report.metric("session.keyframes", static_cast<double>(stats.keyframes), "");
+    report.metric("session.full_copies_mib", full_copies / (1 << 20), "MiB");
+
+    Samples restore;
+    for (const auto& [revision, hash] : hashes) {
+        Stopwatch t;
+        tree.go_to(revision);
+        restore.add(t.elapsed_ns());
+        if (rebel::core::hash64(tree.text().to_string()) != hash) {
+            std::cerr << "revision " << revision << " restored wrong\n";
+            return 1;
+        }
+    }
+    report.metric("restore.p50_ms", restore.percentile(50) / 1e6, "ms");
+    report.metric("restore.p99_ms", restore.percentile(99) / 1e6, "ms");
+    return 0;
+}
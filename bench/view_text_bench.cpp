@@ -0,0 +1,247 @@
+// Frame preparation for the editor's text area on a 4K screen
+// (view::TextView), against rasterizing every visible glyph on the CPU
+// each frame.
+//
+// Two documents: a --lines line log file, highlighted, and a --minified MB
+// file that is one line. Scenarios, --frames frames each:
+//   wheel     scrolls three lines a frame down the log
+//   smooth    scrolls 7.5 pixels a frame (rows enter partially)
+//   page      jumps a screen a frame, so every frame is a full repaint
+//   type      types into a visible line and re-highlights it each frame
+//   full      repaints the whole screen each frame from shaped lines
+//   minified  scrolls the one-line file sideways, a full repaint a frame
+// frame.<scenario>.p50/p99 are the CPU time to build a frame's instance
+// arrays with the frame-time overlay on; glyphs.<scenario> the glyph
+// instances a frame carried. cpu_raster.frame.p50/p99 is blending the
+// glyphs of one full screen into a 3840x2160 RGBA framebuffer in software,
+// the work a full repaint would be without a GPU. fps.cpu = 1000 /
+// frame.wheel.p99. The rasterizer is synthetic (box glyphs), so glyph
+// rasterization itself, which happens once per glyph, is not timed, and
+// no GPU time is measured here.
+//
+//   bench_view_text [--lines 1000000] [--minified 16] [--frames 600]
+
+#include "bench.h"
+
+#include "syntax/highlighter.h"
+#include "syntax/language.h"
+#include "view/glyph_atlas.h"
+#include "view/text_view.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::syntax::Highlighter;
+using rebel::syntax::LineEdit;
+using rebel::text::Rope;
+using rebel::view::FontStyle;
+using rebel::view::GlyphAtlas;
+using rebel::view::GlyphBitmap;
+using rebel::view::TextFrame;
+using rebel::view::TextView;
+
+namespace {
+
+constexpr float kWidth = 3840;
+constexpr float kHeight = 2160;
+
+// A 9x18 monospace font of filled boxes, with a pattern per codepoint so
+// glyphs are not all alike.
+class BoxRasterizer : public rebel::view::Rasterizer {
+public:
+    GlyphBitmap rasterize(char32_t codepoint, FontStyle style) override {
+        GlyphBitmap g;
+        g.advance = 9;
+        if (codepoint == ' ') return g;
+        g.width = style == FontStyle::Bold ? 8 : 7;
+        g.height = 12;
+        g.left = 1;
+        g.top = 12;
+        g.coverage.resize(static_cast<std::size_t>(g.width) * g.height);
+        for (std::size_t i = 0; i < g.coverage.size(); ++i) {
+            g.coverage[i] = static_cast<std::uint8_t>((i * 37 + codepoint * 11) & 0xff);
+        }
+        return g;
+    }
+    float line_height() const override { return 18; }
+    float ascent() const override { return 14; }
+};
+
+std::string synthetic_log(std::size_t lines) {
+    static const char* const kLevels[] = {"INFO ", "DEBUG", "WARN ", "ERROR"};
+    static const char* const kMessages[] = {
+        "request completed status=200 bytes=18342 path=/api/v2/items?page=3&sort=desc",
+        "cache miss key=\"user:48213:profile\" fetching from upstream",
+        "slow query took 812 ms: SELECT id, name FROM accounts WHERE region = 'eu-west-1'",
+        "retrying connection to 10.0.3.17:5432 (attempt 2 of 5)",
+        "\tat com.example.service.Handler.process(Handler.java:212)",
+        "gc pause 4.2 ms heap 1843 MB / 4096 MB",
+    };
+    std::uint64_t state = 11;
+    std::string text;
+    char stamp[64];
+    for (std::size_t i = 0; i < lines; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        std::snprintf(stamp, sizeof stamp, "2026-10-15 12:%02zu:%02zu.%03zu [worker-%zu] ", i / 60000 % 60,
+                      i / 1000 % 60, i % 1000, static_cast<std::size_t>(state >> 60));
+        text += stamp;
+        text += kLevels[(state >> 40) % 4];
+        text += ' ';
+        text += kMessages[(state >> 33) % 6];
+        text += '\n';
+    }
+    return text;
+}
+
+std::string synthetic_minified(std::size_t bytes) {
+    static const char kPiece[] =
+        "function(e,t){var n=t||{};return e.map(function(r,i){return r.id===n.id?Object.assign({},r,{v:i}):r})},";
+    std::string text;
+    text.reserve(bytes);
+    while (text.size() < bytes) text += kPiece;
+    return text;
+}
+
+// Software text rendering of one full screen: the glyph coverage blended
+// into an RGBA framebuffer, glyph by glyph.
+void cpu_raster(const TextFrame& frame, const GlyphAtlas& atlas, std::vector<std::uint32_t>& target) {
+    const auto width = static_cast<std::size_t>(kWidth);
+    std::fill(target.begin(), target.end(), 0x1e2127ffu);
+    for (const auto& g : frame.glyphs) {
+        const auto x0 = static_cast<std::ptrdiff_t>(g.x);
+        const auto y0 = static_cast<std::ptrdiff_t>(g.y);
+        for (std::size_t row = 0; row < g.height; ++row) {
+            const std::ptrdiff_t y = y0 + static_cast<std::ptrdiff_t>(row);
+            if (y < 0 || y >= static_cast<std::ptrdiff_t>(kHeight)) continue;
+            const std::uint8_t* src = atlas.pixels() + (g.v + row) * atlas.width() + g.u;
+            for (std::size_t col = 0; col < g.width; ++col) {
+                const std::ptrdiff_t x = x0 + static_cast<std::ptrdiff_t>(col);
+                if (x < 0 || x >= static_cast<std::ptrdiff_t>(kWidth)) continue;
+                std::uint32_t& dst = target[static_cast<std::size_t>(y) * width + static_cast<std::size_t>(x)];
+                const std::uint32_t a = src[col];
+                std::uint32_t out = 0;
+                for (int shift = 8; shift < 32; shift += 8) {
+                    const std::uint32_t d = (dst >> shift) & 0xff;
+                    const std::uint32_t s = (g.rgba >> shift) & 0xff;
+                    out |= ((s * a + d * (255 - a)) / 255) << shift;
+                }
+                dst = out | 0xff;
+            }
+        }
+    }
+}
+
+struct Scenario {
+    Samples frame;
+    double glyphs = 0;
+};
+
+template <typename Step>
+void run(TextView& view, std::size_t frames, Scenario& out, Step step) {
+    for (std::size_t f = 0; f < frames; ++f) {
+        step(f);
+        Stopwatch t;
+        const TextFrame& frame = view.frame();
+        out.frame.add(t.elapsed_ns() / 1e6);
+        out.glyphs += static_cast<double>(frame.glyphs.size());
+        rebel::bench::do_not_optimize(frame.glyphs.data());
+    }
+    out.glyphs /= static_cast<double>(frames);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t lines = rebel::bench::arg(argc, argv, "lines", 1000000);
+    const std::size_t minified_mb = rebel::bench::arg(argc, argv, "minified", 16);
+    const std::size_t frames = rebel::bench::arg(argc, argv, "frames", 600);
+
+    Report report("view_text");
+    BoxRasterizer font;
+    GlyphAtlas atlas(font);
+
+    Rope log(synthetic_log(lines));
+    Highlighter highlighter(rebel::syntax::plain_language());
+    Stopwatch t;
+    highlighter.reset(log);
+    std::uint64_t version = 0;
+    report.metric("highlight.ms", t.elapsed_ms(), "ms");
+
+    TextView view(atlas);
+    view.resize(kWidth, kHeight);
+    view.set_overlay(true);
+    view.set_text(log);
+    view.set_highlight(highlighter.snapshot(version));
+    t.restart();
+    view.frame();
+    report.metric("first_frame.ms", t.elapsed_ms(), "ms");
+
+    const float lh = view.line_height();
+    Scenario wheel, smooth, page, type, minified, full;
+    double y = 0;
+    run(view, frames, wheel, [&](std::size_t) { view.scroll_to(0, y += 3 * lh); });
+    run(view, frames, smooth, [&](std::size_t) { view.scroll_to(0, y += 7.5); });
+    run(view, frames, page, [&](std::size_t) { view.scroll_to(0, y += kHeight); });
+
+    // Typing on the middle visible line, one character a frame.
+    const std::size_t line = static_cast<std::size_t>(y / lh) + 60;
+    run(view, frames, type, [&](std::size_t f) {
+        const std::size_t at = log.line_end(line);
+        const std::string ch(1, static_cast<char>('a' + f % 26));
+        const LineEdit edit = LineEdit::for_replace(log, at, 0, ch);
+        log.insert(at, ch);
+        highlighter.apply(log, edit);
+        view.edit(log, edit);
+        view.set_highlight(highlighter.snapshot(++version));
+    });
+    run(view, frames, full, [&](std::size_t) { view.damage_all(); });
+
+    std::vector<std::uint32_t> target(static_cast<std::size_t>(kWidth * kHeight));
+    Samples raster;
+    view.damage_all();
+    const TextFrame& screen = view.frame();
+    for (std::size_t f = 0; f < std::min<std::size_t>(frames, 60); ++f) {
+        t.restart();
+        cpu_raster(screen, atlas, target);
+        raster.add(t.elapsed_ns() / 1e6);
+        rebel::bench::do_not_optimize(target.data());
+    }
+
+    const TextView::Stats log_stats = view.stats();
+    Rope one_line(synthetic_minified(minified_mb << 20));
+    view.set_text(one_line);
+    view.set_highlight(nullptr);
+    t.restart();
+    view.frame();
+    report.metric("minified.first_frame.ms", t.elapsed_ms(), "ms");
+    double x = 0;
+    run(view, frames, minified, [&](std::size_t) { view.scroll_to(x += 90, 0); });
+
+    auto scenario = [&](const char* name, Scenario& s) {
+        report.metric(std::string("frame.") + name + ".p50", s.frame.percentile(50), "ms");
+        report.metric(std::string("frame.") + name + ".p99", s.frame.percentile(99), "ms");
+        report.metric(std::string("glyphs.") + name, s.glyphs, "");
+    };
+    scenario("wheel", wheel);
+    scenario("smooth", smooth);
+    scenario("page", page);
+    scenario("type", type);
+    scenario("full", full);
+    scenario("minified", minified);
+    report.metric("cpu_raster.frame.p50", raster.percentile(50), "ms");
+    report.metric("cpu_raster.frame.p99", raster.percentile(99), "ms");
+    report.metric("fps.cpu", 1000 / wheel.frame.percentile(99), "fps");
+    report.metric("rows.cached", 100.0 * static_cast<double>(log_stats.rows_cached) /
+                                     static_cast<double>(std::max<std::uint64_t>(log_stats.rows_drawn, 1)),
+                  "%");
+    report.metric("atlas.glyphs", static_cast<double>(atlas.size()), "");
+    report.metric("atlas.resets", static_cast<double>(view.stats().atlas_resets), "");
+    report.metric("minified.segments", static_cast<double>(view.stats().segments_shaped - log_stats.segments_shaped), "");
+    return 0;
+}
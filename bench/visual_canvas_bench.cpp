@@ -0,0 +1,184 @@
+// Frame preparation for a large visual-script canvas: culling through the
+// canvas quadtrees and batching into instanced draws (visual::Canvas),
+// versus a widget per node and per edge, each testing itself against the
+// viewport and issuing its own draws.
+//
+// The graph is synthetic: --nodes nodes in columns, each wired to one or
+// two nodes in the few columns before it. A camera path pans across it at
+// full size, zooms out until the whole graph is on screen, and zooms back
+// in, one --frames-long sweep. frame.p50/p99 are the CPU time to build a
+// frame's instance arrays; fps.cpu = 1000 / frame.p99 bounds the frame
+// rate this side of the GPU. draws.batched is the most instanced draws a
+// frame issued and draws.widgets the mean a frame of per-node widgets
+// would. build.ms is creating and laying out the canvas, move.us dragging
+// one node.
+//
+//   bench_visual_canvas [--nodes 50000] [--frames 600] [--runs 5]
+
+#include "bench.h"
+
+#include "visual/canvas.h"
+#include "visual/graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::visual::Canvas;
+using rebel::visual::DrawList;
+using rebel::visual::Graph;
+using rebel::visual::Node;
+using rebel::visual::NodeId;
+using rebel::visual::NodeKind;
+using rebel::visual::Rect;
+using rebel::visual::Viewport;
+
+namespace {
+
+constexpr std::size_t kRows = 200;
+constexpr float kColumnPitch = 260;
+constexpr float kRowPitch = 110;
+
+Graph generate(std::size_t nodes) {
+    std::uint64_t state = 7;
+    auto next = [&](std::uint64_t n) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % n;
+    };
+    Graph g;
+    for (std::size_t n = 0; n < nodes; ++n) {
+        if (n < kRows) {
+            g.input("in" + std::to_string(n));
+            continue;
+        }
+        // one to four columns back
+        auto earlier = [&] {
+            const auto back = static_cast<std::int64_t>(kRows / 2 + next(kRows * 3));
+            return static_cast<NodeId>(std::max<std::int64_t>(0, static_cast<std::int64_t>(n) - back));
+        };
+        const NodeId a = earlier();
+        if (n % 5 == 0) {
+            g.call("step", {a}, true);
+        } else {
+            const NodeId b = earlier();
+            g.op(next(2) ? NodeKind::Add : NodeKind::Multiply, {a, b});
+        }
+    }
+    return g;
+}
+
+void lay_out(Canvas& canvas, std::size_t nodes) {
+    for (NodeId n = 0; n < nodes; ++n) {
+        canvas.move(n, static_cast<float>(n / kRows) * kColumnPitch, static_cast<float>(n % kRows) * kRowPitch);
+    }
+}
+
+// Pan at zoom 1, zoom out to the whole graph, zoom back in.
+Viewport camera(std::size_t frame, std::size_t frames, float width, float height) {
+    Viewport view;
+    const float t = static_cast<float>(frame) / static_cast<float>(frames);
+    const float fit = std::min(view.width / width, view.height / height);
+    if (t < 0.5f) {
+        view.zoom = 1;
+        view.x = width * t * 2;
+        view.y = height / 2 + std::sin(t * 20) * height / 3;
+    } else {
+        const float u = std::sin((t - 0.5f) * 2 * 3.14159265f);  // 0 -> 1 -> 0
+        view.zoom = std::exp(std::log(fit) * u);
+        view.x = width / 2;
+        view.y = height / 2;
+    }
+    return view;
+}
+
+// The widget-per-node frame: every node and edge tests itself and draws
+// itself, a draw per quad and per curve.
+std::size_t widgets(const Canvas& canvas, const Graph& graph, const Viewport& view, DrawList& out) {
+    out.clear();
+    const Rect area = view.visible();
+    std::size_t draws = 0;
+    for (NodeId n = 0; n < graph.size(); ++n) {
+        const Node& node = graph.node(n);
+        const Rect to = canvas.bounds(n);
+        for (std::size_t port = 0; port < node.inputs.size(); ++port) {
+            const Rect from = canvas.bounds(node.inputs[port]);
+            const Rect hull{std::min(from.x1, to.x0) - 40, std::min(from.y0, to.y0), std::max(from.x1, to.x0) + 40,
+                            std::max(from.y1, to.y1)};
+            if (!hull.intersects(area)) continue;
+            out.edges.push_back({from.x1, from.y0, from.x1 + 40, from.y0, to.x0 - 40, to.y0, to.x0, to.y0, 0});
+            ++draws;
+        }
+        if (!to.intersects(area)) continue;
+        out.quads.push_back({to.x0, to.y0, to.x1 - to.x0, to.y1 - to.y0, 0});
+        out.quads.push_back({to.x0, to.y0, to.x1 - to.x0, Canvas::kHeaderHeight, 0});
+        draws += 2 + node.inputs.size() + 1;
+    }
+    return draws;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t nodes = rebel::bench::arg(argc, argv, "nodes", 50000);
+    const std::size_t frames = rebel::bench::arg(argc, argv, "frames", 600);
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 5);
+
+    const Graph graph = generate(nodes);
+    const float width = static_cast<float>((nodes + kRows - 1) / kRows) * kColumnPitch;
+    const float height = static_cast<float>(kRows) * kRowPitch;
+
+    Report report("visual_canvas");
+    Samples build;
+    Samples frame;
+    Samples widget_frame;
+    Samples move;
+    std::size_t max_batches = 0;
+    double widget_draws = 0;
+    double drawn = 0;
+    for (std::size_t run = 0; run < runs; ++run) {
+        Stopwatch t;
+        Canvas canvas(graph);
+        lay_out(canvas, nodes);
+        build.add(t.elapsed_ns() / 1e6);
+
+        DrawList list;
+        for (std::size_t f = 0; f < frames; ++f) {
+            const Viewport view = camera(f, frames, width, height);
+            t.restart();
+            drawn += static_cast<double>(canvas.draw(view, list));
+            frame.add(t.elapsed_ns() / 1e6);
+            max_batches = std::max(max_batches, list.batches.size());
+            rebel::bench::do_not_optimize(list.quads.data());
+
+            t.restart();
+            widget_draws += static_cast<double>(widgets(canvas, graph, view, list));
+            widget_frame.add(t.elapsed_ns() / 1e6);
+            rebel::bench::do_not_optimize(list.quads.data());
+        }
+
+        const NodeId dragged = static_cast<NodeId>(nodes / 2);
+        const Rect home = canvas.bounds(dragged);
+        t.restart();
+        for (int step = 0; step < 1000; ++step) {
+            canvas.move(dragged, home.x0 + static_cast<float>(step % 100), home.y0 + static_cast<float>(step % 37));
+        }
+        move.add(t.elapsed_ns() / 1e3 / 1000);
+    }
+    const double total_frames = static_cast<double>(frames * runs);
+    report.metric("build.ms", build.percentile(50), "ms");
+    report.metric("frame.p50", frame.percentile(50), "ms");
+    report.metric("frame.p99", frame.percentile(99), "ms");
+    report.metric("fps.cpu", 1000 / frame.percentile(99), "fps");
+    report.metric("widgets.frame.p50", widget_frame.percentile(50), "ms");
+    report.metric("widgets.frame.p99", widget_frame.percentile(99), "ms");
+    report.metric("draws.batched", static_cast<double>(max_batches), "");
+    report.metric("draws.widgets", widget_draws / total_frames, "");
+    report.metric("nodes.drawn", drawn / total_frames, "");
+    report.metric("move.us", move.percentile(50), "us");
+    return 0;
+}
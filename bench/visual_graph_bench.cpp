@@ -0,0 +1,379 @@
+// Visual-script graph throughput, compiled to bytecode versus interpreted
+// node by node. The interpreter is the design the compiler replaces: one
+// object per node with a virtual eval(), a heap-allocated box for the value
+// on every edge, and every node evaluated in node order, dead or not.
+//
+// The graphs are generated: layers of arithmetic, comparisons, selects,
+// pure floor() calls and calls to a small shared subgraph, with constant
+// subexpressions and dead branches mixed in, the shape of hand-built event
+// handlers. Each is run once per simulated event (<size>.interp.ns and
+// <size>.compiled.ns per event) and both must agree on every result;
+// <size>.speedup is their ratio and the remaining metrics are what the
+// compiler removed.
+//
+// The fan-out graph is a save handler: lint, format and index steps over
+// a buffer with no data between them, joined into one summary. It is run
+// serially as one compiled function (fanout.serial.ms) and with its
+// branches on a work-stealing pool (fanout.parallel.ms), which can only
+// win with as many cores as branches.
+//
+//   bench_visual_graph [--events 100000] [--runs 5] [--buffer 300000] [--threads 0]
+
+#include "bench.h"
+
+#include "script/error.h"
+#include "script/vm.h"
+#include "visual/graph.h"
+#include "visual/graph_compiler.h"
+#include "visual/parallel_graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::script::Value;
+using rebel::visual::Constant;
+using rebel::visual::Graph;
+using rebel::visual::NodeId;
+using rebel::visual::NodeKind;
+
+namespace {
+
+// --- the per-node interpreter ---------------------------------------------
+
+struct Box {
+    Value value;
+};
+using BoxPtr = std::unique_ptr<Box>;
+
+class Interpreter;
+
+class NodeEval {
+public:
+    virtual ~NodeEval() = default;
+    virtual BoxPtr eval(Interpreter& in, const std::vector<const Box*>& inputs) = 0;
+};
+
+class Interpreter {
+public:
+    Interpreter(rebel::script::VM& vm, const Graph& graph);
+    BoxPtr run(const std::vector<const Box*>& args);
+    rebel::script::VM& vm() { return vm_; }
+
+private:
+    rebel::script::VM& vm_;
+    const Graph& graph_;
+    std::vector<std::unique_ptr<NodeEval>> nodes_;
+};
+
+double number(const Box* box) {
+    if (!box->value.is_number()) throw std::runtime_error("interpreter: expected a number");
+    return box->value.as_number();
+}
+
+BoxPtr boxed(Value v) { return std::make_unique<Box>(Box{v}); }
+
+class ConstantEval : public NodeEval {
+public:
+    explicit ConstantEval(double d) : d_(d) {}
+    BoxPtr eval(Interpreter&, const std::vector<const Box*>&) override { return boxed(Value::number(d_)); }
+
+private:
+    double d_;
+};
+
+class ArgEval : public NodeEval {
+public:
+    explicit ArgEval(std::size_t index) : index_(index) {}
+    BoxPtr eval(Interpreter&, const std::vector<const Box*>& args) override { return boxed(args[index_]->value); }
+
+private:
+    std::size_t index_;
+};
+
+class ArithEval : public NodeEval {
+public:
+    explicit ArithEval(NodeKind kind) : kind_(kind) {}
+    BoxPtr eval(Interpreter&, const std::vector<const Box*>& in) override {
+        const double x = number(in[0]);
+        const double y = number(in[1]);
+        double r = 0;
+        switch (kind_) {
+            case NodeKind::Add: r = x + y; break;
+            case NodeKind::Subtract: r = x - y; break;
+            case NodeKind::Multiply: r = x * y; break;
+            case NodeKind::Divide: r = x / y; break;
+            case NodeKind::Modulo: r = rebel::script::floor_mod(x, y); break;
+            case NodeKind::Less: return boxed(Value::boolean(x < y));
+            default: throw std::runtime_error("interpreter: unsupported node");
+        }
+        return boxed(Value::number(r));
+    }
+
+private:
+    NodeKind kind_;
+};
+
+class SelectEval : public NodeEval {
+public:
+    BoxPtr eval(Interpreter&, const std::vector<const Box*>& in) override {
+        return boxed(in[0]->value.truthy() ? in[1]->value : in[2]->value);
+    }
+};
+
+class CallEval : public NodeEval {
+public:
+    explicit CallEval(std::string name) : name_(std::move(name)) {}
+    BoxPtr eval(Interpreter& interp, const std::vector<const Box*>& in) override {
+        std::vector<Value> args;
+        for (const Box* box : in) args.push_back(box->value);
+        return boxed(interp.vm().call(interp.vm().global(name_), args));
+    }
+
+private:
+    std::string name_;
+};
+
+class SubgraphEval : public NodeEval {
+public:
+    SubgraphEval(rebel::script::VM& vm, const Graph& graph) : graph_(vm, graph) {}
+    BoxPtr eval(Interpreter&, const std::vector<const Box*>& in) override { return graph_.run(in); }
+
+private:
+    Interpreter graph_;
+};
+
+Interpreter::Interpreter(rebel::script::VM& vm, const Graph& graph) : vm_(vm), graph_(graph) {
+    std::size_t args = 0;
+    for (const rebel::visual::Node& node : graph.nodes()) {
+        switch (node.kind) {
+            case NodeKind::Constant: nodes_.push_back(std::make_unique<ConstantEval>(std::get<double>(node.value))); break;
+            case NodeKind::Input: nodes_.push_back(std::make_unique<ArgEval>(args++)); break;
+            case NodeKind::Select: nodes_.push_back(std::make_unique<SelectEval>()); break;
+            case NodeKind::Call: nodes_.push_back(std::make_unique<CallEval>(node.name)); break;
+            case NodeKind::Subgraph: nodes_.push_back(std::make_unique<SubgraphEval>(vm, *node.graph)); break;
+            case NodeKind::Output: nodes_.push_back(nullptr); break;
+            default: nodes_.push_back(std::make_unique<ArithEval>(node.kind)); break;
+        }
+    }
+}
+
+// Every node in node order, which is a topological order for generated
+// graphs; returns the Output's value.
+BoxPtr Interpreter::run(const std::vector<const Box*>& args) {
+    std::vector<BoxPtr> values(nodes_.size());
+    std::vector<const Box*> inputs;
+    BoxPtr result;
+    for (std::size_t n = 0; n < nodes_.size(); ++n) {
+        const rebel::visual::Node& node = graph_.node(static_cast<NodeId>(n));
+        inputs.clear();
+        for (NodeId input : node.inputs) inputs.push_back(values[input].get());
+        if (node.kind == NodeKind::Output) {
+            result = boxed(inputs[0]->value);
+        } else {
+            values[n] = nodes_[n]->eval(*this, node.kind == NodeKind::Input ? args : inputs);
+        }
+    }
+    return result;
+}
+
+// --- graphs ---------------------------------------------------------------
+
+// lerp(a, b, t) = a + (b - a) * t
+std::shared_ptr<const Graph> lerp() {
+    auto g = std::make_shared<Graph>();
+    const NodeId a = g->input("a");
+    const NodeId b = g->input("b");
+    const NodeId t = g->input("t");
+    const NodeId span = g->op(NodeKind::Subtract, {b, a});
+    g->output("r", g->op(NodeKind::Add, {a, g->op(NodeKind::Multiply, {span, t})}));
+    return g;
+}
+
+Graph generate(std::size_t size, std::uint64_t seed) {
+    std::uint64_t state = seed;
+    auto next = [&](std::uint64_t n) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % n;
+    };
+    static const std::shared_ptr<const Graph> kLerp = lerp();
+
+    Graph g;
+    std::vector<NodeId> pool;
+    for (const char* name : {"column", "line", "length", "depth"}) pool.push_back(g.input(name));
+    auto recent = [&] { return pool[pool.size() - 1 - next(std::min<std::size_t>(pool.size(), 12))]; };
+    auto constant = [&] { return g.constant(static_cast<double>(1 + next(9))); };
+    while (g.size() < size) {
+        NodeId n;
+        switch (next(8)) {
+            case 0: n = g.op(NodeKind::Add, {recent(), recent()}); break;
+            case 1: n = g.op(NodeKind::Subtract, {recent(), constant()}); break;
+            case 2:  // scaled by a constant subexpression
+                n = g.op(NodeKind::Multiply, {recent(), g.op(NodeKind::Divide, {constant(), constant()})});
+                break;
+            case 3: n = g.op(NodeKind::Modulo, {recent(), g.constant(97.0)}); break;
+            case 4: {
+                const NodeId test = g.op(NodeKind::Less, {recent(), recent()});
+                n = g.op(NodeKind::Select, {test, recent(), recent()});
+                break;
+            }
+            case 5: n = g.subgraph(kLerp, {recent(), recent(), g.constant(0.25)}); break;
+            case 6: n = g.call("floor", {recent()}, true); break;
+            default:  // a debugging leftover that nothing reads
+                g.op(NodeKind::Multiply, {recent(), constant()});
+                continue;
+        }
+        pool.push_back(n);
+    }
+    const NodeId sum = g.op(NodeKind::Add, {pool[pool.size() - 1], pool[pool.size() - 2]});
+    g.output("score", g.op(NodeKind::Modulo, {sum, g.constant(1000003.0)}));
+    return g;
+}
+
+// Stand-ins for the steps of a save handler: each walks the buffer.
+const char* const kSteps = R"(
+fn step(seed, n) {
+    let h = seed;
+    let i = 0;
+    while i < n {
+        h = (h * 31 + i % 127) % 1000003;
+        i = i + 1;
+    }
+    return h;
+}
+fn lint(size) { return step(1, size); }
+fn format(size) { return step(2, size); }
+fn index(size) { return step(3, size); }
+fn spell(size) { return step(4, size); }
+)";
+
+// Four independent steps, the first two followed by a second pass each.
+Graph fanout() {
+    Graph g;
+    const NodeId size = g.input("size");
+    const NodeId lint = g.call("step", {g.call("lint", {size}, true), size}, true);
+    const NodeId format = g.call("step", {g.call("format", {size}, true), size}, true);
+    const NodeId index = g.call("index", {size}, true);
+    const NodeId spell = g.call("spell", {size}, true);
+    const NodeId sum = g.op(NodeKind::Add, {g.op(NodeKind::Add, {lint, format}), g.op(NodeKind::Add, {index, spell})});
+    g.output("summary", g.op(NodeKind::Modulo, {sum, g.constant(1000003.0)}));
+    return g;
+}
+
+bool same(const Value& a, const Value& b) {
+    if (!a.is_number() || !b.is_number()) return false;
+    const double x = a.as_number();
+    const double y = b.as_number();
+    return std::memcmp(&x, &y, sizeof x) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t events = rebel::bench::arg(argc, argv, "events", 100000);
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 5);
+
+    const std::size_t buffer = rebel::bench::arg(argc, argv, "buffer", 300000);
+    const std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+
+    Report report("visual_graph");
+    try {
+        for (std::size_t size : {64, 512}) {
+            rebel::script::VM vm;
+            const Graph graph = generate(size, size);
+            rebel::visual::GraphStats stats;
+            const Value fn = Value::object(rebel::visual::compile(vm, graph, "graph", &stats));
+            Interpreter interpreter(vm, graph);
+
+            auto event = [&](std::size_t e, Value* args) {
+                args[0] = Value::number(static_cast<double>(e % 120));
+                args[1] = Value::number(static_cast<double>(e / 120 % 5000));
+                args[2] = Value::number(static_cast<double>(e * 7 % 200));
+                args[3] = Value::number(static_cast<double>(e % 9));
+            };
+            Samples interp;
+            Samples compiled;
+            for (std::size_t run = 0; run < runs; ++run) {
+                Value args[4];
+                std::vector<Box> boxes(4);
+                std::vector<const Box*> inputs;
+                for (Box& box : boxes) inputs.push_back(&box);
+                // Check a sample of events against each other first.
+                for (std::size_t e = 0; e < events; e += 997) {
+                    event(e, args);
+                    for (int i = 0; i < 4; ++i) boxes[static_cast<std::size_t>(i)].value = args[i];
+                    if (!same(interpreter.run(inputs)->value, vm.call(fn, args, 4))) {
+                        std::cerr << "graph " << size << ": interpreted and compiled results differ\n";
+                        return 1;
+                    }
+                }
+
+                Stopwatch t;
+                for (std::size_t e = 0; e < events; ++e) {
+                    event(e, args);
+                    for (int i = 0; i < 4; ++i) boxes[static_cast<std::size_t>(i)].value = args[i];
+                    rebel::bench::do_not_optimize(interpreter.run(inputs)->value);
+                }
+                interp.add(t.elapsed_ns() / static_cast<double>(events));
+
+                t.restart();
+                for (std::size_t e = 0; e < events; ++e) {
+                    event(e, args);
+                    rebel::bench::do_not_optimize(vm.call(fn, args, 4));
+                }
+                compiled.add(t.elapsed_ns() / static_cast<double>(events));
+            }
+
+            const std::string name = std::to_string(size);
+            report.metric(name + ".interp.ns", interp.percentile(50), "ns");
+            report.metric(name + ".compiled.ns", compiled.percentile(50), "ns");
+            report.metric(name + ".speedup", interp.percentile(50) / compiled.percentile(50), "x");
+            report.metric(name + ".nodes", static_cast<double>(stats.nodes), "");
+            report.metric(name + ".dead", static_cast<double>(stats.dead), "");
+            report.metric(name + ".folded", static_cast<double>(stats.folded), "");
+            report.metric(name + ".inlined", static_cast<double>(stats.inlined), "");
+            report.metric(name + ".locals", static_cast<double>(stats.locals), "");
+            report.metric(name + ".registers", static_cast<double>(stats.registers), "");
+        }
+
+        const Graph graph = fanout();
+        rebel::script::VM vm;
+        vm.run(kSteps, "steps");
+        const Value fn = Value::object(rebel::visual::compile(vm, graph, "fanout"));
+        rebel::core::WorkStealingPool pool(threads);
+        rebel::visual::ParallelGraph parallel(graph, pool, [](rebel::script::VM& worker) { worker.run(kSteps, "steps"); });
+        const Value arg = Value::number(static_cast<double>(buffer));
+        const std::vector<Constant> args{static_cast<double>(buffer)};
+        if (std::get<double>(parallel.run(args)[0]) != vm.call(fn, &arg, 1).as_number()) {
+            std::cerr << "fanout: serial and parallel results differ\n";
+            return 1;
+        }
+        Samples serial;
+        Samples fanned;
+        for (std::size_t run = 0; run < runs; ++run) {
+            Stopwatch t;
+            rebel::bench::do_not_optimize(vm.call(fn, &arg, 1));
+            serial.add(t.elapsed_ns() / 1e6);
+            t.restart();
+            rebel::bench::do_not_optimize(parallel.run(args));
+            fanned.add(t.elapsed_ns() / 1e6);
+        }
+        report.metric("fanout.serial.ms", serial.percentile(50), "ms");
+        report.metric("fanout.parallel.ms", fanned.percentile(50), "ms");
+        report.metric("fanout.speedup", serial.percentile(50) / fanned.percentile(50), "x");
+        report.metric("fanout.tasks", static_cast<double>(parallel.tasks()), "");
+        report.metric("fanout.threads", static_cast<double>(pool.size()), "");
+    } catch (const rebel::script::ScriptError& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
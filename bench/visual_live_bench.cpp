@@ -0,0 +1,181 @@
+// Live preview of a large visual graph: the cost of one edit, re-running the
+// whole compiled graph (edit.full.us) versus bringing a visual::LiveGraph
+// up to date (edit.live.us).
+//
+// The graph is generated: layers of pure script calls that each walk a
+// little data, fed by a few inputs (the active file, the cursor line, the
+// theme and a handful of settings) and joined into a few outputs, with a
+// notify() effect on one of them. An edit moves the cursor most of the
+// time, switches between three open files now and then, and rarely touches
+// a setting. edit.executed is the mean number of nodes one edit runs (of
+// edit.cached cached nodes) and hit_rate the share of dirty nodes served
+// from their memo. Both evaluators must agree after every edit.
+//
+//   bench_visual_live [--nodes 400] [--edits 2000] [--runs 5]
+
+#include "bench.h"
+
+#include "script/error.h"
+#include "script/vm.h"
+#include "visual/graph.h"
+#include "visual/graph_compiler.h"
+#include "visual/live_graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using rebel::bench::Report;
+using rebel::bench::Samples;
+using rebel::bench::Stopwatch;
+using rebel::script::Value;
+using rebel::visual::Graph;
+using rebel::visual::NodeId;
+using rebel::visual::NodeKind;
+
+namespace {
+
+const char* const kPrelude = R"(
+fn mix(a, b, n) {
+    let h = a;
+    let i = 0;
+    while i < n {
+        h = (h * 31 + b + i) % 1000003;
+        i = i + 1;
+    }
+    return h;
+}
+fn measure(a) { return mix(a, 7, 40) % 1000; }
+fn notify(x) { return x; }
+)";
+
+constexpr std::size_t kInputs = 8;  // file, line, theme, then settings
+
+struct Random {
+    std::uint64_t state;
+    std::uint64_t next(std::uint64_t n) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % n;
+    }
+};
+
+// Each input feeds its own band of the graph, mostly: a node reads one
+// value of its band and now and then one of another band, so an input
+// reaches a part of the graph rather than all of it.
+Graph generate(std::size_t nodes, std::uint64_t seed) {
+    Random random{seed};
+    Graph g;
+    std::vector<std::vector<NodeId>> bands(kInputs);
+    const char* names[kInputs] = {"file", "line", "theme", "tabs", "wrap", "font", "ruler", "lint"};
+    for (std::size_t b = 0; b < kInputs; ++b) bands[b].push_back(g.input(names[b]));
+    for (std::size_t n = 0; n < nodes; ++n) {
+        std::vector<NodeId>& band = bands[random.next(kInputs)];
+        const NodeId a = band[band.size() - 1 - random.next(std::min<std::size_t>(band.size(), 6))];
+        NodeId b = g.constant(static_cast<double>(1 + random.next(50)));
+        if (random.next(8) == 0) {
+            const std::vector<NodeId>& other = bands[random.next(kInputs)];
+            b = other[random.next(other.size())];
+        }
+        const NodeId scaled = g.op(NodeKind::Modulo, {g.op(NodeKind::Add, {a, b}), g.constant(9973.0)});
+        band.push_back(random.next(4) == 0 ? g.call("measure", {scaled}, true)
+                                           : g.call("mix", {scaled, b, g.constant(60.0)}, true));
+    }
+    NodeId total = g.constant(0.0);
+    for (std::size_t b = 0; b < kInputs; ++b) {
+        const NodeId last = bands[b].back();
+        g.output(std::string(names[b]) + ".summary", last);
+        total = g.op(NodeKind::Add, {total, last});
+    }
+    g.call("notify", {total});
+    g.output("total", g.op(NodeKind::Modulo, {total, g.constant(1000003.0)}));
+    return g;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t nodes = rebel::bench::arg(argc, argv, "nodes", 400);
+    const std::size_t edits = rebel::bench::arg(argc, argv, "edits", 2000);
+    const std::size_t runs = rebel::bench::arg(argc, argv, "runs", 5);
+
+    Report report("visual_live");
+    try {
+        const Graph graph = generate(nodes, 42);
+        Samples full;
+        Samples live_us;
+        Samples executed;
+        Samples hit_rate;
+        std::size_t cached = 0;
+        for (std::size_t run = 0; run < runs; ++run) {
+            rebel::script::VM vm;
+            vm.run(kPrelude, "prelude");
+            const Value fn = Value::object(rebel::visual::compile(vm, graph, "graph"));
+            rebel::visual::LiveGraph live(vm, graph);
+            const rebel::script::String* total = vm.intern("total");
+
+            Value args[kInputs];
+            for (std::size_t i = 0; i < kInputs; ++i) {
+                args[i] = Value::number(static_cast<double>(i + 1));
+                live.set_input(i, args[i]);
+            }
+            live.evaluate();
+            live.reset_stats();
+            cached = live.cached();
+
+            Random random{run + 1};
+            std::size_t ran = 0;
+            double full_ns = 0;
+            double live_ns = 0;
+            for (std::size_t e = 0; e < edits; ++e) {
+                const std::uint64_t kind = random.next(100);
+                std::size_t input = 1;
+                double value = static_cast<double>(1 + random.next(2000));  // a cursor line
+                if (kind < 10) {
+                    input = 0;  // one of three open files
+                    value = static_cast<double>(1 + random.next(3));
+                } else if (kind < 13) {
+                    input = 2 + random.next(kInputs - 2);
+                    value = static_cast<double>(random.next(4));
+                }
+                args[input] = Value::number(value);
+
+                Stopwatch t;
+                const Value result = vm.call(fn, args, static_cast<int>(kInputs));
+                full_ns += t.elapsed_ns();
+                const double expected = result.as_table()->get_field(total).as_number();
+
+                t.restart();
+                live.set_input(input, args[input]);
+                ran += live.evaluate();
+                live_ns += t.elapsed_ns();
+
+                if (expected != live.output("total").as_number()) {
+                    std::cerr << "edit " << e << ": live and full results differ\n";
+                    return 1;
+                }
+            }
+            std::size_t hits = 0;
+            std::size_t misses = 0;
+            for (NodeId n = 0; n < graph.size(); ++n) {
+                hits += live.stats(n).hits;
+                misses += live.stats(n).misses;
+            }
+            full.add(full_ns / 1e3 / static_cast<double>(edits));
+            live_us.add(live_ns / 1e3 / static_cast<double>(edits));
+            executed.add(static_cast<double>(ran) / static_cast<double>(edits));
+            hit_rate.add(hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0);
+        }
+        report.metric("edit.full.us", full.percentile(50), "us");
+        report.metric("edit.live.us", live_us.percentile(50), "us");
+        report.metric("edit.speedup", full.percentile(50) / live_us.percentile(50), "x");
+        report.metric("edit.executed", executed.mean(), "");
+        report.metric("edit.cached", static_cast<double>(cached), "");
+        report.metric("hit_rate", hit_rate.mean() * 100, "%");
+    } catch (const rebel::script::ScriptError& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+// File watching under a branch-switch event storm (watch::Coalescer,
+// watch::FileWatcher), and what it saves the indexer downstream.
+//
+// replay.* feeds the Coalescer a recorded-shape storm: the inotify trace
+// of a checkout that rewrites --files files over --storm_ms (unlink,
+// create, close-write per file; every 50th directory replaced outright)
+// followed by one ordinary save. Time is simulated, so batches is exact;
+// callbacks.per_event is what three subscribers (indexer, highlighter,
+// script hooks) would receive with a callback per event, callbacks.batched
+// what they receive instead, and ns_per_event the coalescing cost.
+//
+// live.* does the same on disk: --files files under a temporary directory
+// are rewritten while a FileWatcher with three subscribers watches, along
+// with churn under .git that must not show up. start.ms is adding the
+// watches, settle.ms the time from the last write until every rewritten
+// path had been delivered. index.full.ms then re-indexes the workspace
+// after 20 files were edited by walking it, and index.changes.ms by
+// passing the watcher's batch to index::update_index instead.
+//
+//   bench_watch_storm [--files 30000] [--storm_ms 1500] [--threads 0]
+
+#include "bench.h"
+
+#include "core/thread_pool.h"
+#include "index/workspace_indexer.h"
+#include "watch/coalescer.h"
+#include "watch/file_watcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+using rebel::bench::Report;
+using rebel::bench::Stopwatch;
+using rebel::watch::ChangeBatch;
+using rebel::watch::ChangeKind;
+using rebel::watch::Coalescer;
+using rebel::watch::FileWatcher;
+
+namespace {
+
+constexpr std::size_t kPerDir = 100;
+constexpr int kSubscribers = 3;
+
+struct RecordedEvent {
+    std::chrono::microseconds at;
+    ChangeKind kind;
+    std::string path;
+};
+
+std::string relative(std::size_t n) {
+    char path[64];
+    std::snprintf(path, sizeof path, "pkg%03zu/file%06zu.cpp", n / kPerDir, n);
+    return path;
+}
+
+std::string dir_of(std::size_t n) { return relative(n).substr(0, 6); }
+
+// The shape of an inotify trace of `git checkout` on a large tree.
+std::vector<RecordedEvent> record_checkout(std::size_t files, std::chrono::milliseconds span) {
+    std::vector<RecordedEvent> events;
+    events.reserve(files * 3 + files / 50 + 1);
+    for (std::size_t n = 0; n < files; ++n) {
+        const bool replaced = n / kPerDir % 50 == 7;
+        if (replaced && n % kPerDir == 0) {
+            // The whole directory goes, files first, then comes back.
+            for (std::size_t m = n; m < std::min(files, n + kPerDir); ++m) {
+                events.push_back({{}, ChangeKind::Removed, relative(m)});
+            }
+            events.push_back({{}, ChangeKind::Removed, dir_of(n)});
+        }
+        if (!replaced) events.push_back({{}, ChangeKind::Removed, relative(n)});
+        events.push_back({{}, ChangeKind::Created, relative(n)});
+        events.push_back({{}, ChangeKind::Modified, relative(n)});
+    }
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        events[i].at = std::chrono::microseconds(std::chrono::microseconds(span).count() * static_cast<long long>(i) /
+                                                 static_cast<long long>(events.size()));
+    }
+    // The user saves a file half a second after the checkout.
+    events.push_back({std::chrono::microseconds(span) + std::chrono::milliseconds(500), ChangeKind::Modified,
+                      relative(0)});
+    return events;
+}
+
+void write_file(const fs::path& root, std::size_t n, std::size_t revision) {
+    std::ofstream(root / relative(n), std::ios::binary)
+        << "// revision " << revision << "\nint value_" << n << "() { return " << revision << "; }\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t files = rebel::bench::arg(argc, argv, "files", 30000);
+    const auto storm = std::chrono::milliseconds(rebel::bench::arg(argc, argv, "storm_ms", 1500));
+    const std::size_t threads = rebel::bench::arg(argc, argv, "threads", 0);
+
+    Report report("watch_storm");
+
+    {
+        const std::vector<RecordedEvent> events = record_checkout(files, storm);
+        Coalescer coalescer;
+        std::vector<ChangeBatch> batches;
+        const auto t0 = Coalescer::Clock::time_point();
+        Stopwatch t;
+        for (const RecordedEvent& event : events) {
+            const auto now = t0 + event.at;
+            if (coalescer.due() <= now) batches.push_back(coalescer.take());
+            coalescer.add(event.path, event.kind, now);
+        }
+        batches.push_back(coalescer.take());
+        const double ns = t.elapsed_ns();
+        std::size_t changes = 0;
+        for (const ChangeBatch& batch : batches) changes += batch.changes.size();
+        report.metric("replay.events", static_cast<double>(events.size()), "");
+        report.metric("replay.batches", static_cast<double>(batches.size()), "");
+        report.metric("replay.changes", static_cast<double>(changes), "");
+        report.metric("replay.callbacks.per_event", static_cast<double>(events.size() * kSubscribers), "");
+        report.metric("replay.callbacks.batched", static_cast<double>(batches.size() * kSubscribers), "");
+        report.metric("replay.ns_per_event", ns / static_cast<double>(events.size()), "ns");
+    }
+
+    const fs::path root = fs::temp_directory_path() / "rebel_watch_bench";
+    fs::remove_all(root);
+    for (std::size_t n = 0; n < files; ++n) {
+        if (n % kPerDir == 0) fs::create_directories(root / dir_of(n));
+        write_file(root, n, 0);
+    }
+    fs::create_directories(root / ".git" / "objects");
+    const std::string index_path = (fs::temp_directory_path() / "rebel_watch_bench.idx").string();
+    rebel::core::ThreadPool pool(threads);
+    rebel::index::update_index(root.string(), index_path, pool);
+
+    // Stand-ins for the three consumers: the indexer keeps the paths, the
+    // highlighter checks its open documents, script hooks count. Declared
+    // before the watcher, which delivers into them until it is destroyed.
+    std::mutex mutex;
+    std::condition_variable delivered;
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> pending_paths;
+    bool rescanned = false;
+    Stopwatch since_storm;
+    double settled = -1;
+    std::atomic<std::size_t> reopened{0};
+    std::atomic<std::size_t> hooks{0};
+
+    Stopwatch t;
+    FileWatcher watcher(root.string());
+    report.metric("live.start.ms", t.elapsed_ms(), "ms");
+    watcher.subscribe([&](const std::shared_ptr<const ChangeBatch>& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rescanned |= batch->rescan;
+        for (const auto& change : batch->changes) {
+            if (change.kind != ChangeKind::Removed) seen.insert(change.path);  // files, not replaced directories
+            pending_paths.push_back(change.path);
+        }
+        if (settled < 0 && (seen.size() >= files || rescanned)) settled = since_storm.elapsed_ms();
+        delivered.notify_all();
+    });
+    watcher.subscribe([&](const std::shared_ptr<const ChangeBatch>& batch) {
+        for (std::size_t n = 0; n < files; n += files / 50 + 1) reopened += batch->affects(relative(n)) ? 1 : 0;
+    });
+    watcher.subscribe([&](const std::shared_ptr<const ChangeBatch>& batch) { hooks += batch->changes.size(); });
+
+    t.restart();
+    for (std::size_t n = 0; n < files; ++n) {
+        if (n / kPerDir % 50 == 7 && n % kPerDir == 0) {
+            fs::remove_all(root / dir_of(n));
+            fs::create_directories(root / dir_of(n));
+        }
+        fs::remove(root / relative(n));
+        write_file(root, n, 1);
+        if (n % 30 == 0) std::ofstream(root / ".git" / "objects" / std::to_string(n), std::ios::binary) << n;
+    }
+    report.metric("live.storm.ms", t.elapsed_ms(), "ms");
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (settled < 0) since_storm.restart();
+        delivered.wait_for(lock, std::chrono::seconds(30), [&] { return settled >= 0; });
+        report.metric("live.settle.ms", settled, "ms");
+        report.metric("live.rescan", rescanned ? 1 : 0, "");
+        report.metric("live.delivered_paths", static_cast<double>(seen.size()), "");
+    }
+    const FileWatcher::Stats stats = watcher.stats();
+    report.metric("live.events", static_cast<double>(stats.events), "");
+    report.metric("live.batches", static_cast<double>(stats.batches), "");
+    report.metric("live.callbacks", static_cast<double>(stats.batches * kSubscribers), "");
+    rebel::bench::do_not_optimize(reopened.load() + hooks.load());
+
+    // Settle the index after the checkout, then edit a few files.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_paths.clear();
+    }
+    rebel::index::update_index(root.string(), index_path, pool);
+    const std::size_t before = watcher.stats().batches;
+    for (std::size_t n = 0; n < 20; ++n) write_file(root, n * (files / 20), 2);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        delivered.wait_for(lock, std::chrono::seconds(5), [&] { return watcher.stats().batches > before; });
+    }
+    std::vector<std::string> changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.swap(pending_paths);
+    }
+    t.restart();
+    const auto by_changes = rebel::index::update_index(root.string(), index_path, pool, changed);
+    report.metric("index.changes.ms", t.elapsed_ms(), "ms");
+    report.metric("index.changes.parsed", static_cast<double>(by_changes.parsed), "");
+    for (std::size_t n = 0; n < 20; ++n) write_file(root, n * (files / 20), 3);
+    t.restart();
+    const auto by_walk = rebel::index::update_index(root.string(), index_path, pool);
+    report.metric("index.full.ms", t.elapsed_ms(), "ms");
+    report.metric("index.full.parsed", static_cast<double>(by_walk.parsed), "");
+
+    fs::remove_all(root);
+    fs::remove(index_path);
+    return 0;
+}
@@ -0,0 +1,26 @@
+# Shared compile settings for every RebelCODE target.
+#
+# Targets link `rebel_options` privately so warnings are not forced onto
+# consumers of the public headers.
+
+add_library(rebel_options INTERFACE)
+
+if(MSVC)
+    target_compile_options(rebel_options INTERFACE /W4 /permissive-)
+else()
+    target_compile_options(rebel_options INTERFACE -Wall -Wextra -Wpedantic)
+endif()
+
+find_package(Threads REQUIRED)
+
+# rebel_add_library(<name> SOURCES ... [DEPS ...])
+#
+# Declares the static library `rebel_<name>` with `src/` as its public
+# include root, so headers are included as "<name>/header.h".
+function(rebel_add_library name)
+    cmake_parse_arguments(ARG "" "" "SOURCES;DEPS" ${ARGN})
+    add_library(rebel_${name} STATIC ${ARG_SOURCES})
+    add_library(rebel::${name} ALIAS rebel_${name})
+    target_include_directories(rebel_${name} PUBLIC ${PROJECT_SOURCE_DIR}/src)
+    target_link_libraries(rebel_${name} PUBLIC ${ARG_DEPS} PRIVATE rebel_options)
+endfunction()
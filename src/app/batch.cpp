@@ -0,0 +1,183 @@
+#include "app/batch.h"
+
+#include "core/mailbox.h"
+#include "core/mapped_file.h"
+#include "script/serialize.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace rebel::app {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Replaces `path` with `text` through a temporary file beside it, so an
+// interrupted run never leaves a file half written.
+void write_file(const std::string& path, std::string_view text) {
+    const std::string temp =
+        path + ".rebel-tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.flush();
+        if (!out) {
+            out.close();
+            std::error_code ignored;
+            std::filesystem::remove(temp, ignored);
+            throw std::system_error(std::make_error_code(std::errc::io_error), "write " + path);
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    if (error) {
+        std::error_code ignored;
+        std::filesystem::remove(temp, ignored);
+        throw std::system_error(error, "rename " + path);
+    }
+}
+
+}  // namespace
+
+BatchScript::BatchScript(std::string_view source, std::string chunk, Natives natives)
+    : chunk_(std::move(chunk)), natives_(std::move(natives)) {
+    script::VM vm;
+    if (natives_) natives_(vm);
+    script::Function* fn = vm.compile(source, chunk_);
+    script::serial::ObjectWriter objects(vm);
+    objects.add(script::Value::object(fn));
+    script::serial::Out out;
+    objects.write(out);
+    out.u32(objects.index(fn));
+    program_ = std::move(out.bytes());
+}
+
+FileResult BatchScript::run(const std::string& path, bool write) const {
+    const Clock::time_point start = Clock::now();
+    FileResult result;
+    result.path = path;
+    std::shared_ptr<const core::MappedFile> file;
+    try {
+        file = core::MappedFile::open(path);
+    } catch (const std::system_error& e) {
+        result.status = FileResult::Status::Failed;
+        result.error = e.what();
+        result.ms = ms_since(start);
+        return result;
+    }
+    result = run(std::move(result), file->view());
+    if (write && result.status == FileResult::Status::Changed) {
+        file.reset();  // not mapped while replaced
+        try {
+            write_file(path, result.text);
+            result.text.clear();
+            result.text.shrink_to_fit();
+        } catch (const std::system_error& e) {
+            result.status = FileResult::Status::Failed;
+            result.error = e.what();
+        }
+    }
+    result.ms = ms_since(start);
+    return result;
+}
+
+FileResult BatchScript::run(const std::string& path, std::string_view text) const {
+    const Clock::time_point start = Clock::now();
+    FileResult result;
+    result.path = path;
+    result = run(std::move(result), text);
+    result.ms = ms_since(start);
+    return result;
+}
+
+FileResult BatchScript::run(FileResult result, std::string_view text) const {
+    try {
+        script::VM vm;
+        vm.set_print_handler([&result](std::string_view line) {
+            result.output.append(line);
+            result.output.push_back('\n');
+        });
+        if (natives_) natives_(vm);
+        vm.set_global("path", vm.new_string(result.path));
+        vm.set_global("text", vm.new_string(text));
+        // Allocation does not collect, so the function stays put until the
+        // call, which roots it.
+        script::serial::In in(program_);
+        const script::serial::ObjectReader objects(vm, in, nullptr);
+        script::Function* fn = objects.function(in.u32());
+        const script::Value value = vm.call(script::Value::object(fn));
+        if (value.is_string()) {
+            if (value.as_string()->view() != text) {
+                result.status = FileResult::Status::Changed;
+                result.text = std::string(value.as_string()->view());
+            }
+        } else if (!value.is_nil()) {
+            result.status = FileResult::Status::Failed;
+            result.error = chunk_ + ": returned a " + script::type_name(value.type()) + ", not a string or nil";
+        }
+    } catch (const std::exception& e) {
+        result.status = FileResult::Status::Failed;
+        result.error = e.what();
+    }
+    return result;
+}
+
+BatchStats run_batch(const BatchScript& script, const std::vector<std::string>& files, core::ThreadPool& pool,
+                     const std::function<void(FileResult&&)>& on_result, const BatchOptions& options) {
+    const Clock::time_point start = Clock::now();
+    BatchStats stats;
+    if (files.empty()) return stats;
+
+    // Each worker takes the next file when it finishes one, so a few large
+    // files do not hold up a worker's share of the rest.
+    core::Mailbox<FileResult> results(options.queue);
+    std::atomic<std::size_t> next{0};
+    const std::size_t workers = std::min(std::max<std::size_t>(pool.size(), 1), files.size());
+    std::atomic<std::size_t> running{workers};
+    for (std::size_t w = 0; w < workers; ++w) {
+        pool.submit([&] {
+            for (std::size_t i; (i = next.fetch_add(1)) < files.size();) {
+                if (!results.post(script.run(files[i], options.write))) break;
+            }
+            if (running.fetch_sub(1) == 1) results.close();
+        });
+    }
+
+    std::exception_ptr error;
+    const auto handle = [&](FileResult&& result) {
+        if (error) return;
+        ++stats.files;
+        if (result.status == FileResult::Status::Changed) ++stats.changed;
+        if (result.status == FileResult::Status::Failed) ++stats.failed;
+        try {
+            on_result(std::move(result));
+        } catch (...) {
+            error = std::current_exception();
+            next.store(files.size());
+        }
+    };
+    // Closed only after the last post, so one drain after seeing it closed
+    // takes everything.
+    while (!results.closed()) {
+        results.drain(handle);
+        results.wait(std::chrono::milliseconds(50));
+    }
+    results.drain(handle);
+    stats.seconds = ms_since(start) / 1000;
+    if (error) std::rethrow_exception(error);
+    return stats;
+}
+
+}  // namespace rebel::app
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "script/vm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::app {
+
+/// What running a batch script on one file did.
+struct FileResult {
+    enum class Status : std::uint8_t { Unchanged, Changed, Failed };
+
+    std::string path;
+    Status status = Status::Unchanged;
+    std::string text;    // Changed: the new contents, unless written back
+    std::string output;  // what the script printed, a line per "\n"
+    std::string error;   // Failed: the script's error, or why the file could not be read or written
+    double ms = 0;       // reading, running and writing
+};
+
+/// A script compiled once to run on many files, each in a VM of its own.
+///
+/// The script runs as a chunk with the globals `path` and `text` set to the
+/// file's path and contents. Returning a string replaces the contents;
+/// returning nil or the same text leaves the file as it is, and anything
+/// else is an error. Nothing a run does is seen by the next: every file
+/// gets a fresh VM, prepared by `natives`.
+///
+/// The compiled code is kept as the serialized form runtime images use
+/// (script/serialize.h), immutable and shared by every thread: a run
+/// allocates the functions and interned constants straight from it, with
+/// no lexing, parsing or compiling. Heap objects cannot be shared between
+/// VMs themselves, since each VM's collector moves them.
+///
+/// run() is thread-safe, provided `natives` is.
+class BatchScript {
+public:
+    using Natives = std::function<void(script::VM&)>;
+
+    /// Throws script::CompileError.
+    BatchScript(std::string_view source, std::string chunk, Natives natives = {});
+
+    /// Runs the script on the file at `path`; when `write` is set, changed
+    /// text is written back (to a temporary file renamed over the original)
+    /// instead of returned.
+    FileResult run(const std::string& path, bool write = false) const;
+    /// Runs the script on `text` as if read from `path`.
+    FileResult run(const std::string& path, std::string_view text) const;
+
+    /// Size of the shared compiled code.
+    std::size_t code_bytes() const noexcept { return program_.size(); }
+
+private:
+    FileResult run(FileResult result, std::string_view text) const;
+
+    std::string chunk_;
+    Natives natives_;
+    std::string program_;  // serial objects, then the chunk's function index
+};
+
+struct BatchOptions {
+    /// Write changed files back rather than returning their text.
+    bool write = false;
+    /// Results finished but not yet handed to the caller; workers wait
+    /// when it is full.
+    std::size_t queue = 1024;
+};
+
+struct BatchStats {
+    std::size_t files = 0;
+    std::size_t changed = 0;
+    std::size_t failed = 0;
+    double seconds = 0;
+};
+
+/// Runs `script` on every file in `files` on `pool`'s workers, handing
+/// each result to `on_result` on the calling thread as soon as it is
+/// finished, in the order they finish. Returns once every file is done.
+///
+/// If `on_result` throws, files not yet started are skipped and the
+/// exception is rethrown once the workers stop.
+BatchStats run_batch(const BatchScript& script, const std::vector<std::string>& files, core::ThreadPool& pool,
+                     const std::function<void(FileResult&&)>& on_result, const BatchOptions& options = {});
+
+}  // namespace rebel::app
@@ -0,0 +1,110 @@
+#include "app/environment.h"
+
+#include "index/workspace_indexer.h"
+#include "lsp/json.h"
+#include "lsp/transport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace rebel::app {
+namespace {
+
+std::string state_dir(const EnvironmentOptions& options) {
+    return options.state_dir.empty() ? options.workspace + "/.rebel" : options.state_dir;
+}
+
+// The state directory, created if missing; an unwritable one only costs
+// the image and index their persistence.
+std::string ensure_state_dir(const EnvironmentOptions& options) {
+    const std::string dir = state_dir(options);
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    return dir;
+}
+
+}  // namespace
+
+Environment::Environment(EnvironmentOptions options)
+    : options_(std::move(options)),
+      pool_("thread_pool", [] { return std::make_unique<core::ThreadPool>(); }, &trace_),
+      search_("search", [this] { return std::make_unique<search::WorkspaceSearch>(pool()); }, &trace_),
+      symbols_("symbol_index",
+               [this] {
+                   const std::string path = ensure_state_dir(options_) + "/symbols.idx";
+                   auto symbols = std::make_unique<Symbols>();
+                   index::update_index(options_.workspace, path, pool());
+                   symbols->index = index::SymbolIndex::open(path);
+                   return symbols;
+               },
+               &trace_) {
+    {
+        const core::StartupTrace::Scope phase = trace_.phase("script.vm");
+        vm_ = std::make_unique<script::VM>();
+        if (options_.natives) options_.natives(*vm_);
+    }
+    {
+        const core::StartupTrace::Scope phase = trace_.phase("script.prelude");
+        from_image_ = script::open_prelude(*vm_, options_.prelude, ensure_state_dir(options_) + "/runtime.img",
+                                           options_.plugin_metadata, &plugin_metadata_, &trace_);
+    }
+    trace_.mark("ready");
+}
+
+Environment::~Environment() {
+    const char* path = std::getenv("REBEL_STARTUP_TRACE");
+    if (!path || !*path) return;
+    const std::string report = trace_.report();
+    if (std::string(path) == "-") {
+        std::fwrite(report.data(), 1, report.size(), stderr);
+    } else {
+        std::ofstream(path, std::ios::trunc) << report;
+    }
+}
+
+lsp::Client& Environment::language_server(const std::string& language) {
+    core::Lazy<lsp::Client>* server;
+    {
+        std::lock_guard<std::mutex> lock(servers_mutex_);
+        std::unique_ptr<core::Lazy<lsp::Client>>& slot = servers_[language];
+        if (!slot) {
+            if (!options_.language_servers.count(language)) {
+                servers_.erase(language);
+                throw std::out_of_range("no language server configured for " + language);
+            }
+            slot = std::make_unique<core::Lazy<lsp::Client>>(
+                "lsp " + language, [this, language] { return start_server(language); }, &trace_);
+        }
+        server = slot.get();
+    }
+    return server->get();
+}
+
+std::unique_ptr<lsp::Client> Environment::start_server(const std::string& language) {
+    const std::vector<std::string>& command = options_.language_servers.at(language);
+    if (command.empty()) throw std::out_of_range("empty language server command for " + language);
+    auto client = std::make_unique<lsp::Client>(
+        lsp::Channel::spawn(command[0], std::vector<std::string>(command.begin() + 1, command.end())));
+
+    std::error_code error;
+    const std::filesystem::path root = std::filesystem::absolute(options_.workspace, error);
+    lsp::json::Writer params;
+    params.begin_object()
+        .key("processId")
+        .raw("null")
+        .key("rootUri")
+        .value("file://" + root.generic_string())
+        .key("capabilities")
+        .raw("{}")
+        .end_object();
+    // The server may not be sent anything else before it has answered.
+    client->request("initialize", params.str())->wait();
+    client->notify("initialized", "{}");
+    return client;
+}
+
+}  // namespace rebel::app
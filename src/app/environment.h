@@ -0,0 +1,97 @@
+#pragma once
+
+#include "core/lazy.h"
+#include "core/startup_trace.h"
+#include "core/thread_pool.h"
+#include "index/symbol_index.h"
+#include "lsp/client.h"
+#include "script/image.h"
+#include "script/vm.h"
+#include "search/workspace_search.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rebel::app {
+
+struct EnvironmentOptions {
+    std::string workspace = ".";
+    /// Where the runtime image and the symbol index are kept; defaults to
+    /// `workspace`/.rebel, created when needed.
+    std::string state_dir;
+    /// Defines the host's natives; runs before the prelude.
+    std::function<void(script::VM&)> natives;
+    /// The script standard library and plugins, in load order.
+    std::vector<script::PreludeChunk> prelude;
+    /// Stored with the runtime image, for plugin manifests and the like.
+    std::string plugin_metadata;
+    /// Language server command lines (program, then arguments) by language id.
+    std::map<std::string, std::vector<std::string>> language_servers;
+};
+
+/// The editor's runtime: one script VM plus the subsystems around it.
+///
+/// Only the VM is ready when the constructor returns, with the prelude
+/// restored from a runtime image when one matches (see script/image.h) and
+/// run and imaged otherwise. Everything else starts the first time it is
+/// asked for: the thread pool, workspace search, the symbol index (brought
+/// up to date on first use) and each language server (started and
+/// initialized when a file of its language first needs it). A one-off edit
+/// therefore pays for none of them.
+///
+/// trace() records the launch phases and each lazy start. When the
+/// environment variable REBEL_STARTUP_TRACE names a file ("-" for standard
+/// error), the trace's report is written there on destruction.
+///
+/// vm() belongs to the thread that created the environment, like any VM;
+/// the lazy subsystems may be asked for from any thread.
+class Environment {
+public:
+    explicit Environment(EnvironmentOptions options);
+    ~Environment();
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
+
+    script::VM& vm() noexcept { return *vm_; }
+    /// Whether the prelude came from the runtime image.
+    bool prelude_from_image() const noexcept { return from_image_; }
+    /// Of the image used, or the options' for a fresh one.
+    const std::string& plugin_metadata() const noexcept { return plugin_metadata_; }
+
+    core::ThreadPool& pool() { return pool_.get(); }
+    search::WorkspaceSearch& search() { return search_.get(); }
+    /// The workspace's symbol index. Throws std::runtime_error if it can be
+    /// neither updated nor opened.
+    std::shared_ptr<const index::SymbolIndex> symbols() { return symbols_.get().index; }
+    /// The server for `language`, initialized. Throws std::out_of_range if
+    /// none is configured and std::system_error if it cannot be started.
+    lsp::Client& language_server(const std::string& language);
+
+    core::StartupTrace& trace() noexcept { return trace_; }
+    const EnvironmentOptions& options() const noexcept { return options_; }
+
+private:
+    struct Symbols {
+        std::shared_ptr<const index::SymbolIndex> index;
+    };
+
+    std::unique_ptr<lsp::Client> start_server(const std::string& language);
+
+    core::StartupTrace trace_;  // first, so it sees everything else start
+    EnvironmentOptions options_;
+    std::unique_ptr<script::VM> vm_;
+    bool from_image_ = false;
+    std::string plugin_metadata_;
+
+    core::Lazy<core::ThreadPool> pool_;
+    core::Lazy<search::WorkspaceSearch> search_;
+    core::Lazy<Symbols> symbols_;
+    std::mutex servers_mutex_;
+    std::map<std::string, std::unique_ptr<core::Lazy<lsp::Client>>> servers_;
+};
+
+}  // namespace rebel::app
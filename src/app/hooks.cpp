@@ -0,0 +1,346 @@
+#include "app/hooks.h"
+
+#include "core/trace.h"
+#include "script/error.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace rebel::app {
+namespace {
+
+constexpr std::size_t kEvents = static_cast<std::size_t>(HookEvent::Count);
+
+REBEL_TRACE_PROBE(overrun_probe, "hook.overrun");
+
+std::uint64_t to_ns(std::chrono::nanoseconds d) { return static_cast<std::uint64_t>(std::max<std::int64_t>(d.count(), 0)); }
+
+}  // namespace
+
+const char* event_name(HookEvent event) noexcept {
+    switch (event) {
+        case HookEvent::Keystroke: return "keystroke";
+        case HookEvent::Save: return "save";
+        case HookEvent::CursorMove: return "cursor_move";
+        case HookEvent::Count: break;
+    }
+    return "?";
+}
+
+// Preempts VMs at their deadlines. Sleeps until the earliest one; arming
+// only wakes it when the new deadline comes first.
+class HookRunner::Watchdog {
+public:
+    Watchdog() : thread_([this] { run(); }) {}
+    ~Watchdog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    /// Preempts `vm` with `what` at `deadline_ns` (trace::now_ns()) unless
+    /// disarmed first.
+    std::uint64_t arm(script::VM& vm, std::uint64_t deadline_ns, script::VM::Preempt what) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const std::uint64_t ticket = ++tickets_;
+        timers_.push_back({deadline_ns, ticket, &vm, what});
+        const bool sooner = deadline_ns < wake_at_;
+        lock.unlock();
+        if (sooner) wake_.notify_one();
+        return ticket;
+    }
+
+    /// Whether the timer went off; it cannot once this returns.
+    bool disarm(std::uint64_t ticket) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto it = std::find_if(timers_.begin(), timers_.end(), [&](const Timer& t) { return t.ticket == ticket; });
+        if (it == timers_.end()) return true;
+        timers_.erase(it);
+        return false;
+    }
+
+private:
+    struct Timer {
+        std::uint64_t deadline_ns;
+        std::uint64_t ticket;
+        script::VM* vm;
+        script::VM::Preempt what;
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            const std::uint64_t now = core::trace::now_ns();
+            wake_at_ = std::numeric_limits<std::uint64_t>::max();
+            for (auto it = timers_.begin(); it != timers_.end();) {
+                if (it->deadline_ns <= now) {
+                    it->vm->preempt(it->what);
+                    it = timers_.erase(it);
+                } else {
+                    wake_at_ = std::min(wake_at_, it->deadline_ns);
+                    ++it;
+                }
+            }
+            if (wake_at_ == std::numeric_limits<std::uint64_t>::max()) {
+                wake_.wait(lock);
+            } else {
+                const std::chrono::nanoseconds at(wake_at_);
+                wake_.wait_until(lock, std::chrono::steady_clock::time_point(
+                                           std::chrono::duration_cast<std::chrono::steady_clock::duration>(at)));
+            }
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Timer> timers_;
+    std::uint64_t tickets_ = 0;
+    std::uint64_t wake_at_ = std::numeric_limits<std::uint64_t>::max();
+    bool stopping_ = false;
+    std::thread thread_;  // last, so it starts with the rest ready
+};
+
+struct HookRunner::Hook {
+    enum class State : std::uint8_t { Idle, Suspended, Background };
+
+    std::string name;
+    HookOptions options;
+    std::unique_ptr<script::VM> vm;
+    script::VM::Handle handlers[kEvents];  // nil where the hook has none
+    State state = State::Idle;             // read and written by the editor thread only
+    std::deque<Call> queue;
+    HookStats stats;
+
+    // The call in progress. A background call owns these and the VM until
+    // it is handed back through finished_.
+    HookResult result;
+    std::uint64_t started_ns = 0;
+    std::uint64_t traced_ns = 0;  // REBEL_TRACE_NOW() at the start
+    std::uint64_t run_ns = 0;
+};
+
+HookRunner::HookRunner(core::ThreadPool& pool, Natives natives, ResultHandler on_result)
+    : pool_(pool),
+      natives_(std::move(natives)),
+      on_result_(std::move(on_result)),
+      watchdog_(std::make_unique<Watchdog>()) {}
+
+HookRunner::~HookRunner() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto& hook : hooks_) {
+        if (hook->state == Hook::State::Background) hook->vm->preempt(script::VM::Preempt::Abort);
+    }
+    background_done_.wait(lock, [this] { return in_background_ == 0; });
+}
+
+void HookRunner::add(std::string name, std::string_view source, HookOptions options) {
+    auto hook = std::make_unique<Hook>();
+    hook->vm = std::make_unique<script::VM>();
+    if (natives_) natives_(*hook->vm);
+    hook->vm->run(source, name);
+    for (std::size_t e = 0; e < kEvents; ++e) {
+        const script::Value fn = hook->vm->global(std::string("on_") + event_name(static_cast<HookEvent>(e)));
+        if (!fn.is_nil()) hook->handlers[e] = script::VM::Handle(*hook->vm, fn);
+    }
+    hook->stats.hook = name;
+    hook->name = std::move(name);
+    hook->options = options;
+    std::lock_guard<std::mutex> lock(mutex_);
+    hooks_.push_back(std::move(hook));
+}
+
+void HookRunner::fire(HookEvent event, std::vector<HookArg> args) {
+    REBEL_TRACE_SCOPE("hook.fire");
+    for (const auto& entry : hooks_) {
+        Hook& hook = *entry;
+        if (hook.handlers[static_cast<std::size_t>(event)].get().is_nil()) continue;
+        if (hook.state == Hook::State::Idle && hook.queue.empty()) {
+            start(hook, Call{event, args});
+        } else if (hook.queue.size() < hook.options.queue) {
+            hook.queue.push_back(Call{event, args});
+        } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++hook.stats.dropped;
+        }
+    }
+}
+
+bool HookRunner::poll() {
+    REBEL_TRACE_SCOPE("hook.poll");
+    std::vector<Hook*> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished.swap(finished_);
+    }
+    for (Hook* hook : finished) report(*hook);
+    for (const auto& entry : hooks_) {
+        Hook& hook = *entry;
+        if (hook.state == Hook::State::Suspended) {
+            run_slice(hook, nullptr);
+        } else if (hook.state == Hook::State::Idle && !hook.queue.empty()) {
+            Call call = std::move(hook.queue.front());
+            hook.queue.pop_front();
+            start(hook, std::move(call));
+        }
+    }
+    return busy();
+}
+
+bool HookRunner::busy() const noexcept {
+    return std::any_of(hooks_.begin(), hooks_.end(), [](const auto& hook) {
+        return hook->state != Hook::State::Idle || !hook->queue.empty();
+    });
+}
+
+std::vector<HookStats> HookRunner::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<HookStats> out;
+    out.reserve(hooks_.size());
+    for (const auto& hook : hooks_) out.push_back(hook->stats);
+    return out;
+}
+
+void HookRunner::start(Hook& hook, Call call) {
+    hook.result = HookResult{};
+    hook.result.hook = hook.name;
+    hook.result.event = call.event;
+    hook.result.slices = 0;
+    hook.started_ns = core::trace::now_ns();
+    hook.traced_ns = REBEL_TRACE_NOW();
+    hook.run_ns = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++hook.stats.calls;
+    }
+    run_slice(hook, &call);
+}
+
+// Runs the hook's call, from the start if `call` is given, for up to one
+// budget on the editor thread.
+void HookRunner::run_slice(Hook& hook, const Call* call) {
+    script::VM& vm = *hook.vm;
+    const std::uint64_t begin = core::trace::now_ns();
+    std::uint64_t deadline = begin + to_ns(hook.options.budget);
+    auto what = hook.options.policy == OverrunPolicy::Abort ? script::VM::Preempt::Abort : script::VM::Preempt::Suspend;
+    const std::uint64_t limit = to_ns(hook.options.limit);
+    if (limit > 0 && hook.started_ns + limit <= deadline) {
+        deadline = hook.started_ns + limit;
+        what = script::VM::Preempt::Abort;
+    }
+    const std::uint64_t ticket = watchdog_->arm(vm, deadline, what);
+
+    std::optional<script::Value> value;
+    HookResult::Status status = HookResult::Status::Done;
+    std::string error;
+    try {
+        if (call) {
+            std::vector<script::Value> args;
+            args.reserve(call->args.size());
+            for (const HookArg& arg : call->args) {
+                if (const double* number = std::get_if<double>(&arg)) {
+                    args.push_back(script::Value::number(*number));
+                } else {
+                    args.push_back(vm.new_string(std::get<std::string>(arg)));
+                }
+            }
+            value = vm.start(hook.handlers[static_cast<std::size_t>(call->event)].get(), args.data(),
+                             static_cast<int>(args.size()));
+        } else {
+            value = vm.resume();
+        }
+    } catch (const script::AbortError& e) {
+        status = HookResult::Status::Aborted;
+        error = e.what();
+    } catch (const std::exception& e) {
+        status = HookResult::Status::Failed;
+        error = e.what();
+    }
+    // A preemption that came too late for this call must not hit the next.
+    if (watchdog_->disarm(ticket)) vm.preempt(script::VM::Preempt::None);
+
+    const std::uint64_t ns = core::trace::now_ns() - begin;
+    hook.run_ns += ns;
+    ++hook.result.slices;
+    const bool overran = !value && status == HookResult::Status::Done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++hook.stats.slices;
+        hook.stats.max_slice_ms = std::max(hook.stats.max_slice_ms, static_cast<double>(ns) / 1e6);
+        if ((overran || status == HookResult::Status::Aborted) && !hook.result.overran) ++hook.stats.overruns;
+    }
+    if (overran || status == HookResult::Status::Aborted) hook.result.overran = true;
+    if (!overran) {
+        finish(hook, status, std::move(error));
+        report(hook);
+    } else if (hook.options.policy == OverrunPolicy::Background) {
+        to_background(hook);
+    } else {
+        hook.state = Hook::State::Suspended;
+    }
+}
+
+// Records how the call ended; on whichever thread ran it last.
+void HookRunner::finish(Hook& hook, HookResult::Status status, std::string error) {
+    HookResult& result = hook.result;
+    result.status = status;
+    result.error = std::move(error);
+    result.run_ms = static_cast<double>(hook.run_ns) / 1e6;
+    result.total_ms = static_cast<double>(core::trace::now_ns() - hook.started_ns) / 1e6;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status == HookResult::Status::Aborted) ++hook.stats.aborted;
+    if (status == HookResult::Status::Failed) ++hook.stats.failed;
+}
+
+void HookRunner::to_background(Hook& hook) {
+    hook.state = Hook::State::Background;
+    hook.result.background = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++hook.stats.background;
+        ++in_background_;
+    }
+    pool_.submit([this, &hook] {
+        script::VM& vm = *hook.vm;
+        const std::uint64_t begin = core::trace::now_ns();
+        const std::uint64_t limit = to_ns(hook.options.limit);
+        const std::uint64_t ticket =
+            limit > 0 ? watchdog_->arm(vm, hook.started_ns + limit, script::VM::Preempt::Abort) : 0;
+        HookResult::Status status = HookResult::Status::Done;
+        std::string error;
+        try {
+            while (!vm.resume()) {
+            }
+        } catch (const script::AbortError& e) {
+            status = HookResult::Status::Aborted;
+            error = e.what();
+        } catch (const std::exception& e) {
+            status = HookResult::Status::Failed;
+            error = e.what();
+        }
+        if (ticket && watchdog_->disarm(ticket)) vm.preempt(script::VM::Preempt::None);
+        hook.run_ns += core::trace::now_ns() - begin;
+        finish(hook, status, std::move(error));
+        // Notified with the lock held: the destructor may be waiting to
+        // destroy the condition variable.
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_.push_back(&hook);
+        --in_background_;
+        background_done_.notify_all();
+    });
+}
+
+// Hands a finished call's result over on the editor thread.
+void HookRunner::report(Hook& hook) {
+    hook.state = Hook::State::Idle;
+    if (hook.result.overran) REBEL_TRACE_RECORD(overrun_probe, hook.traced_ns);
+    if (on_result_) on_result_(hook.result);
+}
+
+}  // namespace rebel::app
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "script/vm.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace rebel::app {
+
+/// Editor events scripts can hook. A hook handles an event by defining a
+/// global function named on_<event_name()>.
+enum class HookEvent : std::uint8_t { Keystroke, Save, CursorMove, Count };
+
+/// "keystroke", "save" or "cursor_move".
+const char* event_name(HookEvent event) noexcept;
+
+/// An argument passed to a hook's handler.
+using HookArg = std::variant<double, std::string>;
+
+/// What happens to a hook call that runs past its budget.
+enum class OverrunPolicy : std::uint8_t {
+    Abort,       // stopped with an error
+    Suspend,     // parked, then run a budget at a time from HookRunner::poll()
+    Background,  // parked, then finished on a pool thread
+};
+
+struct HookOptions {
+    /// Time a call may run on the editor thread before its policy applies.
+    std::chrono::microseconds budget{2000};
+    OverrunPolicy policy = OverrunPolicy::Suspend;
+    /// Time after which a call is aborted whatever the policy, counted
+    /// from its start, parked time included; zero for no limit.
+    std::chrono::milliseconds limit{5000};
+    /// Events kept for a hook that is still busy with an earlier one;
+    /// more are dropped.
+    std::size_t queue = 16;
+};
+
+/// How one call of a hook ended.
+struct HookResult {
+    enum class Status : std::uint8_t { Done, Failed, Aborted };
+
+    std::string hook;
+    HookEvent event = HookEvent::Keystroke;
+    Status status = Status::Done;
+    std::string error;          // Failed or Aborted: the script error
+    bool overran = false;       // ran past its budget
+    bool background = false;    // finished on a pool thread
+    std::uint32_t slices = 1;   // runs on the editor thread
+    double run_ms = 0;          // running, on any thread
+    double total_ms = 0;        // from start to finish
+};
+
+/// Counts for one hook since it was added.
+struct HookStats {
+    std::string hook;
+    std::uint64_t calls = 0;
+    std::uint64_t overruns = 0;    // calls that went over budget
+    std::uint64_t slices = 0;      // editor-thread runs, first ones included
+    std::uint64_t background = 0;  // calls moved to a pool thread
+    std::uint64_t aborted = 0;
+    std::uint64_t failed = 0;
+    std::uint64_t dropped = 0;     // events that found the queue full
+    double max_slice_ms = 0;       // the longest the editor thread waited on it
+};
+
+/// Runs script hooks on editor events, each call within a time budget, so
+/// that one slow hook cannot stall typing.
+///
+/// Every hook lives in a VM of its own, prepared by `natives` and then
+/// loaded from its source. A call starts on the editor thread; when it has
+/// run for its budget a watchdog thread preempts it at its next safepoint
+/// (a call or loop back-edge, see VM::preempt()) and the hook's policy
+/// decides the rest. Aborted calls end with an error. Suspended calls keep
+/// their frames in the hook's VM and continue for one more budget on each
+/// poll(), so typing is delayed by at most a budget per busy hook. Calls
+/// moved to the background continue on a pool thread, which may then run
+/// them without interruption since the VM is the hook's alone; the
+/// natives must then be thread-safe. A hook busy with one call queues its
+/// next events.
+///
+/// Time spent in a native, or by a suspension waiting for a native to
+/// return, counts against the budget but cannot be cut short.
+///
+/// Overruns are reported through core/trace: fire() and poll() are traced
+/// as hook.fire and hook.poll, which is the editor thread's wait, and each
+/// call that overran as hook.overrun, from its start to its end. Every
+/// result, overruns included, also goes to `on_result` on the editor
+/// thread, and stats() counts them per hook.
+///
+/// All members but stats() belong to the editor thread.
+class HookRunner {
+public:
+    using Natives = std::function<void(script::VM&)>;
+    using ResultHandler = std::function<void(const HookResult&)>;
+
+    explicit HookRunner(core::ThreadPool& pool, Natives natives = {}, ResultHandler on_result = {});
+    /// Aborts calls running in the background and waits for them.
+    ~HookRunner();
+    HookRunner(const HookRunner&) = delete;
+    HookRunner& operator=(const HookRunner&) = delete;
+
+    /// Loads a hook by running `source` as a chunk named `name`. Throws
+    /// script::CompileError or script::RuntimeError; the chunk itself runs
+    /// without a budget.
+    void add(std::string name, std::string_view source, HookOptions options = {});
+
+    /// Calls every hook handling `event`, in the order they were added,
+    /// returning once each has finished or gone over budget.
+    void fire(HookEvent event, std::vector<HookArg> args = {});
+    /// Gives each suspended call one more budget, hands over calls finished
+    /// in the background and starts queued events. Returns whether any
+    /// hook is still busy.
+    bool poll();
+    bool busy() const noexcept;
+
+    std::vector<HookStats> stats() const;
+
+private:
+    class Watchdog;
+    struct Hook;
+    struct Call {
+        HookEvent event;
+        std::vector<HookArg> args;
+    };
+
+    void start(Hook& hook, Call call);
+    void run_slice(Hook& hook, const Call* call);
+    void finish(Hook& hook, HookResult::Status status, std::string error);
+    void to_background(Hook& hook);
+    void report(Hook& hook);
+
+    core::ThreadPool& pool_;
+    Natives natives_;
+    ResultHandler on_result_;
+    std::unique_ptr<Watchdog> watchdog_;
+    std::vector<std::unique_ptr<Hook>> hooks_;
+
+    mutable std::mutex mutex_;  // guards what follows and every hook's stats
+    std::condition_variable background_done_;
+    std::vector<Hook*> finished_;  // background calls over, for poll()
+    std::size_t in_background_ = 0;
+};
+
+}  // namespace rebel::app
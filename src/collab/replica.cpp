@@ -0,0 +1,517 @@
+#include "collab/replica.h"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace rebel::collab {
+namespace {
+
+// What Item::length holds.
+constexpr std::size_t kMaxRunLength = std::numeric_limits<std::int32_t>::max();
+
+// Orders run index entries by start clock.
+struct ByClock {
+    template <typename Entry>
+    bool operator()(std::uint64_t clock, const Entry& e) const { return clock < e.first; }
+    template <typename Entry>
+    bool operator()(const Entry& e, std::uint64_t clock) const { return e.first < clock; }
+};
+
+// Whether `b`, just after `a`, continues it: the bytes that follow in the
+// same client's typing, made between the same neighbours.
+template <typename Item>
+bool continues(const Item& a, const Item& b) {
+    return a.client == b.client && a.clock + a.length == b.clock && a.deleted == b.deleted &&
+           b.left() == Id{a.client, b.clock - 1} && b.right() == a.right() && a.length + std::size_t{b.length} <= kMaxRunLength;
+}
+
+// Makes room in `v` for one more element, growing it by an eighth rather
+// than doubling: blocks and index vectors live as long as the document,
+// and their spare capacity would otherwise be much of its metadata.
+template <typename T>
+void reserve_one(std::vector<T>& v) {
+    if (v.size() == v.capacity()) v.reserve(v.size() + v.size() / 8 + 1);
+}
+
+}  // namespace
+
+Replica::Replica(std::uint32_t client, std::string_view text) : client_(client), rope_(text) {
+    if (client == kInitialClient || client == Id::kNone) throw std::invalid_argument("reserved collab client id");
+    blocks_.push_back(std::make_unique<Block>());
+    rebuild_fenwick();
+    version_[client_] = 0;
+    for (std::uint64_t clock = 0; clock < text.size();) {
+        const auto length = static_cast<std::uint32_t>(std::min<std::uint64_t>(text.size() - clock, kMaxRunLength));
+        const Item item{kInitialClient, length, clock, clock ? Id{kInitialClient, clock - 1} : Id{}, Id{}, false};
+        blocks_.back()->visible += length;
+        fenwick_add(blocks_.size() - 1, length);
+        place(end(), item);
+        clock += length;
+        version_[kInitialClient] = clock;
+    }
+}
+
+Replica::~Replica() = default;
+
+Replica::Pos Replica::normalize(Pos p) const {
+    while (p.item == blocks_[p.block]->items.size() && p.block + 1 < blocks_.size()) {
+        ++p.block;
+        p.item = 0;
+    }
+    return p;
+}
+
+std::uint64_t Replica::clock(std::uint32_t client) const {
+    const auto it = version_.find(client);
+    return it == version_.end() ? 0 : it->second;
+}
+
+Replica::Pos Replica::find(const Id& id) const {
+    const RunIndex& runs = index_.at(id.client);
+    const auto it = std::prev(std::upper_bound(runs.begin(), runs.end(), id.clock, ByClock{}));
+    const Block& block = *it->second;
+    for (std::size_t i = 0; i < block.items.size(); ++i) {
+        if (block.items[i].clock == it->first && block.items[i].client == id.client) return {block.index, i};
+    }
+    throw std::logic_error("collab run index out of step");
+}
+
+std::pair<Replica::Pos, std::uint32_t> Replica::locate(std::size_t offset) const {
+    // Fenwick descent to the block holding the byte.
+    std::size_t block = 0;
+    std::size_t step = 1;
+    while (step * 2 <= blocks_.size()) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (block + step <= blocks_.size() && fenwick_[block + step] <= offset) {
+            block += step;
+            offset -= fenwick_[block];
+        }
+    }
+    const std::vector<Item>& items = blocks_[block]->items;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        if (items[i].deleted) continue;
+        if (offset < items[i].length) return {{block, i}, static_cast<std::uint32_t>(offset)};
+        offset -= items[i].length;
+    }
+    throw std::logic_error("collab block lengths out of step");
+}
+
+std::size_t Replica::offset_of(Pos p) const {
+    std::size_t offset = fenwick_prefix(p.block);
+    const std::vector<Item>& items = blocks_[p.block]->items;
+    for (std::size_t i = 0; i < p.item; ++i) {
+        if (!items[i].deleted) offset += items[i].length;
+    }
+    return offset;
+}
+
+Replica::Pos Replica::split(Pos p, std::uint32_t k, const Id& id) {
+    Item& first = at(p);
+    Item second = first;
+    second.clock += k;
+    second.length -= k;
+    second.set_left({first.client, second.clock - 1});
+    first.length = k;
+    place({p.block, p.item + 1}, second);  // the block's visible bytes are unchanged
+    return find(id);
+}
+
+Replica::Pos Replica::split_before(const Id& id) {
+    const Pos p = find(id);
+    const Item& item = at(p);
+    if (id.clock == item.clock) return p;
+    return split(p, static_cast<std::uint32_t>(id.clock - item.clock), id);
+}
+
+Replica::Pos Replica::split_after(const Id& id) {
+    const Pos p = find(id);
+    const Item& item = at(p);
+    const auto k = static_cast<std::uint32_t>(id.clock - item.clock + 1);
+    if (k == item.length) return p;
+    return split(p, k, id);
+}
+
+void Replica::place(Pos p, const Item& item) {
+    Block& block = *blocks_[p.block];
+    reserve_one(block.items);
+    block.items.insert(block.items.begin() + static_cast<std::ptrdiff_t>(p.item), item);
+    index_put(item, &block);
+    if (block.items.size() > kMaxRunsPerBlock) split_block(p.block);
+}
+
+void Replica::mark_deleted(Pos p) {
+    Item& item = at(p);
+    item.deleted = true;
+    blocks_[p.block]->visible -= item.length;
+    fenwick_add(p.block, 0 - std::size_t{item.length});
+}
+
+void Replica::merge_around(Pos p) {
+    Block& block = *blocks_[p.block];
+    std::vector<Item>& items = block.items;
+    const auto absorb = [&](std::size_t i) {
+        items[i].length += items[i + 1].length;
+        index_erase(items[i + 1]);
+        items.erase(items.begin() + static_cast<std::ptrdiff_t>(i + 1));
+    };
+    if (p.item + 1 < items.size() && continues(items[p.item], items[p.item + 1])) absorb(p.item);
+    if (p.item > 0 && continues(items[p.item - 1], items[p.item])) absorb(p.item - 1);
+}
+
+void Replica::split_block(std::size_t index) {
+    Block& full = *blocks_[index];
+    auto half = std::make_unique<Block>();
+    const auto middle = full.items.begin() + static_cast<std::ptrdiff_t>(full.items.size() / 2);
+    half->items.assign(middle, full.items.end());
+    full.items.erase(middle, full.items.end());
+    full.items.shrink_to_fit();
+    for (const Item& item : half->items) {
+        if (!item.deleted) half->visible += item.length;
+        index_put(item, half.get());
+    }
+    full.visible -= half->visible;
+    blocks_.insert(blocks_.begin() + static_cast<std::ptrdiff_t>(index + 1), std::move(half));
+    for (std::size_t i = index + 1; i < blocks_.size(); ++i) blocks_[i]->index = i;
+    rebuild_fenwick();
+}
+
+void Replica::index_put(const Item& item, Block* block) {
+    RunIndex& runs = index_[item.client];
+    const auto it = std::lower_bound(runs.begin(), runs.end(), item.clock, ByClock{});
+    if (it != runs.end() && it->first == item.clock) {
+        it->second = block;
+    } else {
+        const auto at = it - runs.begin();
+        reserve_one(runs);
+        runs.insert(runs.begin() + at, {item.clock, block});
+    }
+}
+
+void Replica::index_erase(const Item& item) {
+    RunIndex& runs = index_.at(item.client);
+    runs.erase(std::lower_bound(runs.begin(), runs.end(), item.clock, ByClock{}));
+}
+
+void Replica::insert(std::size_t offset, std::string_view text) {
+    if (offset > rope_.size()) throw std::out_of_range("collab insert past the end");
+    while (!text.empty()) {
+        const std::string_view piece = text.substr(0, kMaxRunLength);
+        Item item{client_, static_cast<std::uint32_t>(piece.size()), clock(client_), Id{}, Id{}, false};
+        // Right after the byte before `offset`, ahead of any tombstones that
+        // follow it, which makes whatever comes next the right origin.
+        std::optional<Pos> left;
+        if (offset > 0) {
+            const auto [p, k] = locate(offset - 1);
+            item.set_left({at(p).client, at(p).clock + k});
+            left = split_after(item.left());
+        }
+        const Pos following = left ? next(*left) : begin();
+        if (following != end()) item.set_right({at(following).client, at(following).clock});
+
+        const Pos p = left ? Pos{left->block, left->item + 1} : Pos{0, 0};
+        blocks_[p.block]->visible += item.length;
+        fenwick_add(p.block, item.length);
+        if (left && continues(at(*left), item)) {
+            at(*left).length += item.length;  // typing on
+        } else {
+            place(p, item);
+        }
+        rope_.insert(offset, piece);
+        version_[client_] = item.clock + item.length;
+        offset += piece.size();
+        text.remove_prefix(piece.size());
+    }
+}
+
+void Replica::erase(std::size_t offset, std::size_t length) {
+    if (offset > rope_.size() || length > rope_.size() - offset) throw std::out_of_range("collab erase past the end");
+    rope_.erase(offset, length);
+    while (length > 0) {
+        // The bytes now at `offset` in the sequence, one run at a time.
+        const auto [found, k] = locate(offset);
+        const Id id{at(found).client, at(found).clock + k};
+        Pos p = split_before(id);
+        const auto n = static_cast<std::uint32_t>(std::min<std::size_t>(length, at(p).length));
+        if (n < at(p).length) p = split(p, n, id);
+        mark_deleted(p);
+        merge_around(p);
+        if (!deleted_.empty() && deleted_.back().id.client == id.client &&
+            deleted_.back().id.clock + deleted_.back().length == id.clock) {
+            deleted_.back().length += n;
+        } else {
+            deleted_.push_back({id, n});
+        }
+        length -= n;
+    }
+}
+
+Run Replica::run_of(Pos p, std::uint64_t from) const {
+    const Item& item = at(p);
+    const std::uint64_t skip = from - item.clock;
+    Run run;
+    run.id = {item.client, from};
+    run.length = static_cast<std::uint32_t>(item.length - skip);
+    run.left = skip ? Id{item.client, from - 1} : item.left();
+    run.right = item.right();
+    run.deleted = item.deleted;
+    if (!item.deleted) run.text = rope_.substr(offset_of(p) + skip, run.length);
+    return run;
+}
+
+std::string Replica::flush() {
+    Update update;
+    const auto own = index_.find(client_);
+    if (own != index_.end() && flushed_ < clock(client_)) {
+        auto it = std::upper_bound(own->second.begin(), own->second.end(), flushed_, ByClock{});
+        if (it != own->second.begin()) --it;
+        for (; it != own->second.end(); ++it) {
+            const Pos p = find({client_, it->first});
+            if (it->first + at(p).length <= flushed_) continue;
+            update.runs.push_back(run_of(p, std::max(it->first, flushed_)));
+        }
+    }
+    // Deletes of runs just sent went out as tombstones.
+    for (DeleteRange range : deleted_) {
+        if (range.id.client == client_) {
+            if (range.id.clock >= flushed_) continue;
+            range.length = std::min(range.length, flushed_ - range.id.clock);
+        }
+        update.deletes.push_back(range);
+    }
+    flushed_ = clock(client_);
+    deleted_.clear();
+    if (update.runs.empty() && update.deletes.empty()) return {};
+    return encode(update);
+}
+
+std::string Replica::encode_state(const Version& since) const {
+    Update update;
+    std::vector<std::uint32_t> clients;
+    clients.reserve(index_.size());
+    for (const auto& entry : index_) clients.push_back(entry.first);
+    std::sort(clients.begin(), clients.end());
+    for (const std::uint32_t client : clients) {
+        const auto seen = since.find(client);
+        const std::uint64_t from = seen == since.end() ? 0 : seen->second;
+        for (const auto& [start, block] : index_.at(client)) {
+            const Pos p = find({client, start});
+            const Item& item = at(p);
+            const std::uint64_t end = start + item.length;
+            if (end > from) {
+                update.runs.push_back(run_of(p, std::max(start, from)));
+            } else if (item.deleted) {
+                // Seen, but perhaps not deleted yet where it was seen.
+                DeleteRange* last = update.deletes.empty() ? nullptr : &update.deletes.back();
+                if (last && last->id.client == client && last->id.clock + last->length == start) {
+                    last->length += item.length;
+                } else {
+                    update.deletes.push_back({{client, start}, item.length});
+                }
+            }
+        }
+    }
+    return encode(update);
+}
+
+void Replica::apply(std::string_view bytes) {
+    Update update = decode(bytes);
+    for (Run& run : update.runs) {
+        std::deque<Run>& queue = pending_runs_[run.id.client];
+        const auto later = std::upper_bound(queue.begin(), queue.end(), run.id.clock,
+                                            [](std::uint64_t clock, const Run& r) { return clock < r.id.clock; });
+        queue.insert(later, std::move(run));
+    }
+    pending_deletes_.insert(pending_deletes_.end(), update.deletes.begin(), update.deletes.end());
+    integrate_pending();
+}
+
+bool Replica::has_pending() const noexcept { return !pending_runs_.empty() || !pending_deletes_.empty(); }
+
+void Replica::integrate_pending() {
+    // Each client's runs in clock order. A run that waits on another
+    // client's runs takes those first, depth first, as Yjs does. A client
+    // waiting on one already on the stack, or waiting again with nothing
+    // integrated since it last waited, steps back so the one below can go
+    // on; one waiting on runs not here yet is stuck until they arrive.
+    struct Frame {
+        std::uint32_t client;
+        std::size_t progress = static_cast<std::size_t>(-1);  // when it last waited
+    };
+    std::vector<std::uint32_t> stuck;
+    const auto is_stuck = [&](std::uint32_t c) { return std::find(stuck.begin(), stuck.end(), c) != stuck.end(); };
+    std::size_t progress = 0;
+    std::size_t before;
+    do {
+        before = progress;
+        for (auto& start : pending_runs_) {
+            std::vector<Frame> stack{{start.first}};
+            while (!stack.empty()) {
+                Frame& frame = stack.back();
+                const auto queue = pending_runs_.find(frame.client);
+                if (queue == pending_runs_.end() || queue->second.empty() || is_stuck(frame.client)) {
+                    stack.pop_back();
+                    continue;
+                }
+                const std::uint32_t waits = integrate(queue->second.front());
+                if (waits == Id::kNone) {
+                    queue->second.pop_front();
+                    ++progress;
+                    continue;
+                }
+                const auto other = pending_runs_.find(waits);
+                if (waits == frame.client || other == pending_runs_.end() || other->second.empty() || is_stuck(waits)) {
+                    stuck.push_back(frame.client);
+                    stack.pop_back();
+                } else if (frame.progress == progress ||
+                           std::any_of(stack.begin(), stack.end(), [&](const Frame& f) { return f.client == waits; })) {
+                    stack.pop_back();
+                } else {
+                    frame.progress = progress;
+                    stack.push_back({waits});
+                }
+            }
+        }
+    } while (progress != before);
+    for (auto it = pending_runs_.begin(); it != pending_runs_.end();) {
+        it = it->second.empty() ? pending_runs_.erase(it) : std::next(it);
+    }
+    std::vector<DeleteRange> waiting;
+    for (DeleteRange& range : pending_deletes_) {
+        if (!delete_range(range)) waiting.push_back(range);
+    }
+    pending_deletes_ = std::move(waiting);
+}
+
+std::uint32_t Replica::integrate(Run& run) {
+    const std::uint32_t client = run.id.client;
+    const std::uint64_t known = clock(client);
+    if (run.id.clock > known) return client;
+    if (run.id.clock + run.length <= known) return Id::kNone;
+    if (run.id.clock < known) {
+        // Partly seen: keep the rest, which continues what was.
+        const std::uint64_t skip = known - run.id.clock;
+        run.id.clock = known;
+        run.length -= static_cast<std::uint32_t>(skip);
+        run.left = {client, known - 1};
+        if (!run.deleted) run.text.erase(0, skip);
+    }
+    if (!run.left.none() && run.left.clock >= clock(run.left.client)) return run.left.client;
+    if (!run.right.none() && run.right.clock >= clock(run.right.client)) return run.right.client;
+
+    if (!run.left.none()) split_after(run.left);
+    if (!run.right.none()) split_before(run.right);
+    std::optional<Pos> left;
+    if (!run.left.none()) left = find(run.left);
+    const Pos right = run.right.none() ? end() : find(run.right);
+
+    // YATA: among the runs between the origins, which the run's author had
+    // not seen, find the one to follow. `scanned` is every run passed, and
+    // those from `conflicts` on are the ones still in conflict.
+    struct Span {
+        std::uint32_t client;
+        std::uint64_t clock;
+        std::uint32_t length;
+    };
+    std::vector<Span> scanned;
+    std::size_t conflicts = 0;
+    for (Pos o = left ? next(*left) : begin(); o != right && o != end(); o = next(o)) {
+        const Item& item = at(o);
+        const Id origin = item.left();
+        scanned.push_back({item.client, item.clock, item.length});
+        if (origin == run.left) {
+            if (item.client < client) {
+                left = o;
+                conflicts = scanned.size();
+            } else if (item.right() == run.right) {
+                break;
+            }
+        } else if (!origin.none()) {
+            const auto span = std::find_if(scanned.begin(), scanned.end(), [&](const Span& s) {
+                return s.client == origin.client && origin.clock - s.clock < s.length;
+            });
+            if (span == scanned.end()) break;
+            if (static_cast<std::size_t>(span - scanned.begin()) < conflicts) {
+                left = o;
+                conflicts = scanned.size();
+            }
+        } else {
+            break;
+        }
+    }
+
+    const Pos p = left ? Pos{left->block, left->item + 1} : Pos{0, 0};
+    const std::size_t offset = run.deleted ? 0 : offset_of(p);
+    if (!run.deleted) {
+        blocks_[p.block]->visible += run.length;
+        fenwick_add(p.block, run.length);
+    }
+    place(p, {client, run.length, run.id.clock, run.left, run.right, run.deleted});
+    version_[client] = run.id.clock + run.length;
+    merge_around(find(run.id));
+    if (!run.deleted) {
+        rope_.insert(offset, run.text);
+        if (observer_) observer_(offset, 0, run.text);
+    }
+    return Id::kNone;
+}
+
+bool Replica::delete_range(DeleteRange& range) {
+    while (range.length > 0) {
+        if (range.id.clock >= clock(range.id.client)) return false;
+        const Pos found = find(range.id);
+        const std::uint64_t n = std::min(range.length, at(found).clock + at(found).length - range.id.clock);
+        if (!at(found).deleted) {
+            Pos p = split_before(range.id);
+            if (n < at(p).length) p = split(p, static_cast<std::uint32_t>(n), range.id);
+            const std::size_t offset = offset_of(p);
+            mark_deleted(p);
+            merge_around(p);
+            rope_.erase(offset, n);
+            if (observer_) observer_(offset, n, {});
+        }
+        range.id.clock += n;
+        range.length -= n;
+    }
+    return true;
+}
+
+Replica::Stats Replica::stats() const {
+    Stats stats;
+    for (const auto& block : blocks_) {
+        stats.runs += block->items.size();
+        stats.metadata_bytes += sizeof(Block) + sizeof block + block->items.capacity() * sizeof(Item);
+        for (const Item& item : block->items) {
+            if (!item.deleted) continue;
+            ++stats.tombstones;
+            stats.deleted_bytes += item.length;
+        }
+    }
+    for (const auto& entry : index_) stats.metadata_bytes += entry.second.capacity() * sizeof(RunIndex::value_type);
+    stats.metadata_bytes += fenwick_.capacity() * sizeof(std::size_t);
+    return stats;
+}
+
+void Replica::fenwick_add(std::size_t block, std::size_t delta) {
+    // Unsigned wraparound makes adding 0 - n subtract n.
+    for (std::size_t i = block + 1; i < fenwick_.size(); i += i & (0 - i)) fenwick_[i] += delta;
+}
+
+std::size_t Replica::fenwick_prefix(std::size_t block) const {
+    std::size_t sum = 0;
+    for (std::size_t i = block; i > 0; i -= i & (0 - i)) sum += fenwick_[i];
+    return sum;
+}
+
+void Replica::rebuild_fenwick() {
+    fenwick_.assign(blocks_.size() + 1, 0);
+    for (std::size_t i = 1; i < fenwick_.size(); ++i) {
+        fenwick_[i] += blocks_[i - 1]->visible;
+        const std::size_t parent = i + (i & (0 - i));
+        if (parent < fenwick_.size()) fenwick_[parent] += fenwick_[i];
+    }
+}
+
+}  // namespace rebel::collab
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "collab/update.h"
+#include "text/rope.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::collab {
+
+/// Bytes of each client integrated so far: every id below the clock.
+using Version = std::map<std::uint32_t, std::uint64_t>;
+
+/// One user's copy of a shared document: a sequence CRDT after YATA (the
+/// algorithm behind Yjs) whose replicas converge on the same text however
+/// their updates interleave, are duplicated or are delayed.
+///
+/// Every inserted byte has an Id, and the document is the sequence of all
+/// bytes ever inserted, deleted ones included as tombstones. Concurrent
+/// inserts at one place are ordered by the origins they were made between
+/// and then by client id, identically on every replica.
+///
+/// The sequence is held as runs, not bytes. Typing extends the run it
+/// continues, so a typed line is one run; a run split by an insert in its
+/// middle stays two. Runs hold no text: the visible text lives in a Rope,
+/// and a deleted run keeps only its ids and origins, merging back with
+/// deleted neighbours it was split from. Memory is therefore the text plus
+/// about 60 bytes per run (the run, its block's slack and its index
+/// entry), however much was deleted.
+///
+/// Runs sit in blocks of at most kMaxRunsPerBlock, with a Fenwick tree over
+/// the blocks' visible lengths; offsets and ids both resolve in O(log n)
+/// plus a scan of one block.
+///
+/// Not thread-safe.
+class Replica {
+public:
+    /// Client id of the document's initial text, the same on every replica.
+    static constexpr std::uint32_t kInitialClient = 0;
+    static constexpr std::size_t kMaxRunsPerBlock = 64;
+
+    /// Called for each change an applied update makes to the text.
+    using Observer = std::function<void(std::size_t offset, std::size_t erased, std::string_view inserted)>;
+
+    struct Stats {
+        std::size_t runs = 0;
+        std::size_t tombstones = 0;       // deleted runs
+        std::size_t deleted_bytes = 0;    // bytes those runs stand for
+        std::size_t metadata_bytes = 0;   // runs, blocks and the id index, estimated
+    };
+
+    /// A replica for `client`, which must be unique among the replicas of a
+    /// document and neither kInitialClient nor Id::kNone (else
+    /// std::invalid_argument). Replicas of one document must start from the
+    /// same `text`, or from nothing and an encode_state() of another.
+    explicit Replica(std::uint32_t client, std::string_view text = {});
+    ~Replica();
+    Replica(const Replica&) = delete;
+    Replica& operator=(const Replica&) = delete;
+
+    std::uint32_t client() const noexcept { return client_; }
+    const text::Rope& text() const noexcept { return rope_; }
+    void set_observer(Observer observer) { observer_ = std::move(observer); }
+
+    /// Local edits, at byte offsets of text(). Throw std::out_of_range.
+    void insert(std::size_t offset, std::string_view text);
+    void erase(std::size_t offset, std::size_t length);
+
+    /// The local edits since the last flush, as an update for the other
+    /// replicas; empty if there were none.
+    std::string flush();
+    /// Integrates an update from another replica, in any order relative to
+    /// others: what it depends on and has not arrived waits for it. Updates
+    /// seen before are harmless. Throws DecodeError, leaving the replica
+    /// unchanged.
+    void apply(std::string_view update);
+    /// Whether some applied updates wait on ones not yet applied.
+    bool has_pending() const noexcept;
+
+    Version version() const { return version_; }
+    /// Everything not covered by `since`, as one update: all of the
+    /// document for a new replica, or what a reconnecting one missed.
+    std::string encode_state(const Version& since = {}) const;
+
+    Stats stats() const;
+
+private:
+    // 40 bytes: the origins are kept as halves to save Id's padding, and
+    // `deleted` shares a word with `length`.
+    struct Item {
+        std::uint32_t client;
+        std::uint32_t length : 31;
+        std::uint32_t deleted : 1;
+        std::uint32_t left_client;
+        std::uint32_t right_client;
+        std::uint64_t clock;
+        std::uint64_t left_clock;
+        std::uint64_t right_clock;
+
+        Item(std::uint32_t client, std::uint32_t length, std::uint64_t clock, const Id& left, const Id& right, bool deleted)
+            : client(client), length(length), deleted(deleted), left_client(left.client), right_client(right.client),
+              clock(clock), left_clock(left.clock), right_clock(right.clock) {}
+
+        Id left() const noexcept { return {left_client, left_clock}; }
+        Id right() const noexcept { return {right_client, right_clock}; }
+        void set_left(const Id& id) noexcept { left_client = id.client, left_clock = id.clock; }
+        void set_right(const Id& id) noexcept { right_client = id.client, right_clock = id.clock; }
+    };
+    struct Block {
+        std::vector<Item> items;
+        std::size_t visible = 0;  // bytes of items not deleted
+        std::size_t index = 0;    // in blocks_
+    };
+    struct Pos {
+        std::size_t block;
+        std::size_t item;
+        friend bool operator==(const Pos& a, const Pos& b) { return a.block == b.block && a.item == b.item; }
+        friend bool operator!=(const Pos& a, const Pos& b) { return !(a == b); }
+    };
+
+    Item& at(Pos p) { return blocks_[p.block]->items[p.item]; }
+    const Item& at(Pos p) const { return blocks_[p.block]->items[p.item]; }
+    Pos normalize(Pos p) const;
+    Pos begin() const { return normalize({0, 0}); }
+    Pos end() const { return {blocks_.size() - 1, blocks_.back()->items.size()}; }
+    Pos next(Pos p) const { return normalize({p.block, p.item + 1}); }
+    std::uint64_t clock(std::uint32_t client) const;
+
+    /// The run holding `id`, which must have been integrated.
+    Pos find(const Id& id) const;
+    /// The run holding the visible byte at `offset`, and the byte's index
+    /// in it.
+    std::pair<Pos, std::uint32_t> locate(std::size_t offset) const;
+    std::size_t offset_of(Pos p) const;
+    /// Splits the run at `p` before its byte `k`; returns where `id` now is.
+    Pos split(Pos p, std::uint32_t k, const Id& id);
+    /// The run starting at `id`, split off what precedes it.
+    Pos split_before(const Id& id);
+    /// The run ending at `id`, split off what follows it.
+    Pos split_after(const Id& id);
+    /// Puts `item` at `p`. Callers count its visible bytes in first.
+    void place(Pos p, const Item& item);
+    void mark_deleted(Pos p);
+    /// Merges the run at `p` with its neighbours where they continue it.
+    void merge_around(Pos p);
+    void split_block(std::size_t block);
+    void index_put(const Item& item, Block* block);
+    void index_erase(const Item& item);
+
+    /// Integrates `run`, or returns the client whose runs it waits on
+    /// (Id::kNone once done, or if it was seen before).
+    std::uint32_t integrate(Run& run);
+    /// Deletes what it can of `range`, shrinking it; false if some of it
+    /// is still to arrive.
+    bool delete_range(DeleteRange& range);
+    void integrate_pending();
+    /// The run at `p` from its id `from` on, text included.
+    Run run_of(Pos p, std::uint64_t from) const;
+
+    void fenwick_add(std::size_t block, std::size_t delta);
+    std::size_t fenwick_prefix(std::size_t block) const;
+    void rebuild_fenwick();
+
+    std::uint32_t client_;
+    text::Rope rope_;
+    std::vector<std::unique_ptr<Block>> blocks_;  // never empty
+    std::vector<std::size_t> fenwick_;            // visible bytes by block, 1-based
+    // Start clock of every run of a client, to the block holding it, in
+    // clock order. A sorted vector rather than a map: a quarter of the
+    // memory, and most inserts land at or near the end.
+    using RunIndex = std::vector<std::pair<std::uint64_t, Block*>>;
+    std::unordered_map<std::uint32_t, RunIndex> index_;
+    Version version_;
+    std::uint64_t flushed_ = 0;  // own clock at the last flush
+    std::vector<DeleteRange> deleted_;  // local deletes since then
+    // Runs waiting on others, by client in clock order, and deletes
+    // waiting on runs.
+    std::map<std::uint32_t, std::deque<Run>> pending_runs_;
+    std::vector<DeleteRange> pending_deletes_;
+    Observer observer_;
+};
+
+}  // namespace rebel::collab
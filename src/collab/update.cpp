@@ -0,0 +1,151 @@
+#include "collab/update.h"
+
+namespace rebel::collab {
+namespace {
+
+constexpr std::string_view kMagic = "RCU1";
+
+enum Flags : std::uint8_t {
+    kContinues = 0x01,
+    kLeft = 0x02,
+    kLeftPrevious = 0x04,
+    kRight = 0x08,
+    kDeleted = 0x10,
+};
+
+void varint(std::string& out, std::uint64_t v) {
+    for (; v >= 0x80; v >>= 7) out.push_back(static_cast<char>(v | 0x80));
+    out.push_back(static_cast<char>(v));
+}
+
+void id(std::string& out, const Id& v) {
+    varint(out, v.client);
+    varint(out, v.clock);
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view bytes) : bytes_(bytes) {}
+
+    bool done() const noexcept { return pos_ == bytes_.size(); }
+
+    std::uint8_t u8() {
+        if (pos_ == bytes_.size()) throw DecodeError("update truncated");
+        return static_cast<std::uint8_t>(bytes_[pos_++]);
+    }
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const std::uint8_t byte = u8();
+            v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        throw DecodeError("varint too long");
+    }
+    std::uint32_t client() {
+        const std::uint64_t v = varint();
+        if (v >= Id::kNone) throw DecodeError("client id out of range");
+        return static_cast<std::uint32_t>(v);
+    }
+    Id id() {
+        Id v;
+        v.client = client();
+        v.clock = varint();
+        return v;
+    }
+    std::string_view bytes(std::size_t n) {
+        if (bytes_.size() - pos_ < n) throw DecodeError("update truncated");
+        const std::string_view v = bytes_.substr(pos_, n);
+        pos_ += n;
+        return v;
+    }
+
+private:
+    std::string_view bytes_;
+    std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::string encode(const Update& update) {
+    std::string out(kMagic);
+    varint(out, update.runs.size());
+    Id end;  // just past the previous run
+    for (const Run& run : update.runs) {
+        std::uint8_t flags = 0;
+        if (run.id == end) flags |= kContinues;
+        if (!run.left.none()) {
+            flags |= run.id.clock > 0 && run.left == Id{run.id.client, run.id.clock - 1} ? kLeft | kLeftPrevious : kLeft;
+        }
+        if (!run.right.none()) flags |= kRight;
+        if (run.deleted) flags |= kDeleted;
+        out.push_back(static_cast<char>(flags));
+        if (!(flags & kContinues)) id(out, run.id);
+        varint(out, run.length);
+        if ((flags & kLeft) && !(flags & kLeftPrevious)) id(out, run.left);
+        if (flags & kRight) id(out, run.right);
+        if (!run.deleted) out.append(run.text);
+        end = {run.id.client, run.id.clock + run.length};
+    }
+    varint(out, update.deletes.size());
+    for (const DeleteRange& range : update.deletes) {
+        id(out, range.id);
+        varint(out, range.length);
+    }
+    return out;
+}
+
+Update decode(std::string_view bytes) {
+    Reader in(bytes);
+    if (in.bytes(kMagic.size()) != kMagic) throw DecodeError("not an update");
+    Update update;
+    // Each run takes at least two bytes, so a count past that is a lie.
+    const std::uint64_t runs = in.varint();
+    if (runs > bytes.size() / 2) throw DecodeError("update truncated");
+    update.runs.reserve(runs);
+    Id end;
+    for (std::uint64_t n = 0; n < runs; ++n) {
+        Run run;
+        const std::uint8_t flags = in.u8();
+        if (flags & ~(kContinues | kLeft | kLeftPrevious | kRight | kDeleted)) throw DecodeError("unknown run flags");
+        if (flags & kContinues) {
+            if (end.none()) throw DecodeError("first run continues nothing");
+            run.id = end;
+        } else {
+            run.id = in.id();
+        }
+        const std::uint64_t length = in.varint();
+        if (length == 0 || length > std::numeric_limits<std::int32_t>::max() ||
+            run.id.clock > std::numeric_limits<std::uint64_t>::max() - length) {
+            throw DecodeError("bad run length");
+        }
+        run.length = static_cast<std::uint32_t>(length);
+        if (flags & kLeftPrevious) {
+            if (!(flags & kLeft) || run.id.clock == 0) throw DecodeError("bad left origin");
+            run.left = {run.id.client, run.id.clock - 1};
+        } else if (flags & kLeft) {
+            run.left = in.id();
+        }
+        if (flags & kRight) run.right = in.id();
+        run.deleted = flags & kDeleted;
+        if (!run.deleted) run.text = std::string(in.bytes(run.length));
+        end = {run.id.client, run.id.clock + run.length};
+        update.runs.push_back(std::move(run));
+    }
+    const std::uint64_t deletes = in.varint();
+    if (deletes > bytes.size() / 3) throw DecodeError("update truncated");
+    update.deletes.reserve(deletes);
+    for (std::uint64_t n = 0; n < deletes; ++n) {
+        DeleteRange range;
+        range.id = in.id();
+        range.length = in.varint();
+        if (range.length == 0 || range.id.clock > std::numeric_limits<std::uint64_t>::max() - range.length) {
+            throw DecodeError("bad delete range");
+        }
+        update.deletes.push_back(range);
+    }
+    if (!in.done()) throw DecodeError("trailing bytes after update");
+    return update;
+}
+
+}  // namespace rebel::collab
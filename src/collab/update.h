@@ -0,0 +1,79 @@
+#pragma once
+
+// Updates: the binary form in which replicas exchange edits.
+//
+//   update := "RCU1" runs:varint run* deletes:varint delete*
+//   run    := flags:u8 [client:varint clock:varint] length:varint
+//             [left:id] [right:id] [bytes]
+//   delete := client:varint clock:varint length:varint
+//   id     := client:varint clock:varint
+//
+// Run flags:
+//   0x01  continues the previous run's client at its end clock; no
+//         client or clock follows
+//   0x02  has a left origin
+//   0x04  the left origin is the byte before this run (client, clock - 1);
+//         no id follows
+//   0x08  has a right origin
+//   0x10  deleted: a tombstone, with no bytes
+//
+// Varints are LEB128. A run's bytes, `length` of them (1 to 2^31 - 1),
+// follow unless it is deleted. Typing a word is one run, and one a replica
+// has since deleted costs a few bytes whatever its length.
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::collab {
+
+/// A byte inserted by a replica: the replica's id, and the count of bytes
+/// it had inserted before this one.
+struct Id {
+    static constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t client = kNone;
+    std::uint64_t clock = 0;
+
+    bool none() const noexcept { return client == kNone; }
+    friend bool operator==(const Id& a, const Id& b) { return a.client == b.client && a.clock == b.clock; }
+    friend bool operator!=(const Id& a, const Id& b) { return !(a == b); }
+};
+
+/// Bytes inserted together: ids [id, id + length) of one client. `left`
+/// and `right` are the ids either side of the insertion when it was made;
+/// none at either end of the document.
+struct Run {
+    Id id;
+    std::uint32_t length = 0;
+    Id left;
+    Id right;
+    bool deleted = false;
+    std::string text;  // empty when deleted
+};
+
+/// Ids [id, id + length) deleted.
+struct DeleteRange {
+    Id id;
+    std::uint64_t length = 0;
+};
+
+struct Update {
+    std::vector<Run> runs;
+    std::vector<DeleteRange> deletes;
+};
+
+/// Thrown for bytes that are not a well-formed update.
+class DecodeError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+std::string encode(const Update& update);
+/// Throws DecodeError.
+Update decode(std::string_view bytes);
+
+}  // namespace rebel::collab
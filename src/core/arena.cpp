@@ -0,0 +1,63 @@
+#include "core/arena.h"
+
+namespace rebel::core {
+
+Arena::Arena(std::size_t chunk_bytes) : chunk_bytes_(chunk_bytes) {}
+
+void* Arena::allocate_slow(std::size_t bytes, std::size_t align) {
+    // Chunks kept by an earlier rewind() are reused before new ones are made.
+    while (current_ + 1 < chunks_.size()) {
+        Chunk& next = chunks_[++current_];
+        next.used = 0;
+        if (bytes <= next.size) {
+            next.used = bytes;
+            return next.data.get();
+        }
+    }
+    const std::size_t size = bytes > chunk_bytes_ ? bytes : chunk_bytes_;
+    Chunk chunk;
+    chunk.data.reset(new std::byte[size]);
+    chunk.size = size;
+    chunk.used = bytes;
+    if (!chunks_.empty() && chunks_[current_].used == 0 && current_ + 1 == chunks_.size()) {
+        // The current chunk is empty but too small: replace it.
+        chunks_[current_] = std::move(chunk);
+    } else {
+        chunks_.push_back(std::move(chunk));
+        current_ = chunks_.size() - 1;
+    }
+    (void)align;  // fresh chunks are aligned for any fundamental type
+    return chunks_[current_].data.get();
+}
+
+Arena::Marker Arena::mark() const noexcept {
+    if (chunks_.empty()) return {};
+    return {current_, chunks_[current_].used};
+}
+
+void Arena::rewind(Marker marker) noexcept {
+    if (chunks_.empty()) return;
+    current_ = marker.chunk;
+    chunks_[current_].used = marker.used;
+}
+
+void Arena::reset() noexcept {
+    if (chunks_.empty()) return;
+    chunks_.resize(1);
+    chunks_[0].used = 0;
+    current_ = 0;
+}
+
+std::size_t Arena::bytes_used() const noexcept {
+    std::size_t total = 0;
+    for_each_chunk([&](const std::byte*, std::size_t used) { total += used; });
+    return total;
+}
+
+std::size_t Arena::bytes_reserved() const noexcept {
+    std::size_t total = 0;
+    for (const Chunk& c : chunks_) total += c.size;
+    return total;
+}
+
+}  // namespace rebel::core
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace rebel::core {
+
+/// Region allocator: bump-pointer allocation out of large chunks, freed all
+/// at once by reset() or back to a marker by rewind().
+///
+/// Destructors are never run; objects placed in an arena must either be
+/// trivially destructible or be destroyed by their owner before the memory
+/// is reclaimed.
+class Arena {
+public:
+    /// Position to rewind() to, from mark().
+    struct Marker {
+        std::size_t chunk = 0;
+        std::size_t used = 0;
+    };
+
+    explicit Arena(std::size_t chunk_bytes = 64 << 10);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+
+    /// Never returns null; requests larger than a chunk get a chunk of
+    /// their own. `align` must be a power of two no larger than
+    /// alignof(std::max_align_t).
+    void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) {
+        if (current_ < chunks_.size()) {
+            Chunk& c = chunks_[current_];
+            const std::size_t offset = (c.used + align - 1) & ~(align - 1);
+            if (offset + bytes <= c.size) {
+                c.used = offset + bytes;
+                return c.data.get() + offset;
+            }
+        }
+        return allocate_slow(bytes, align);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    Marker mark() const noexcept;
+    /// Releases everything allocated since `marker`.
+    void rewind(Marker marker) noexcept;
+    /// Releases everything. Keeps the first chunk; frees the others.
+    void reset() noexcept;
+
+    /// Bytes handed out, including alignment padding.
+    std::size_t bytes_used() const noexcept;
+    std::size_t bytes_reserved() const noexcept;
+    std::size_t chunk_bytes() const noexcept { return chunk_bytes_; }
+
+    /// Visits the allocated prefix of each chunk in allocation order, so
+    /// callers that allocate back-to-back records can walk them.
+    template <typename F>
+    void for_each_chunk(F&& visit) const {
+        for (std::size_t i = 0; i <= current_ && i < chunks_.size(); ++i) {
+            visit(chunks_[i].data.get(), chunks_[i].used);
+        }
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size = 0;
+        std::size_t used = 0;
+    };
+
+    void* allocate_slow(std::size_t bytes, std::size_t align);
+
+    std::size_t chunk_bytes_;
+    std::vector<Chunk> chunks_;
+    std::size_t current_ = 0;
+};
+
+}  // namespace rebel::core
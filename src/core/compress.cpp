@@ -0,0 +1,148 @@
+#include "core/compress.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rebel::core {
+namespace {
+
+constexpr std::size_t kMinMatch = 4;
+constexpr std::size_t kMaxOffset = 0xffff;
+constexpr int kHashBits = 14;
+
+std::uint32_t load32(const char* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+std::uint32_t hash(std::uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+void length(std::string& out, std::size_t n) {
+    for (; n >= 255; n -= 255) out.push_back(static_cast<char>(255));
+    out.push_back(static_cast<char>(n));
+}
+
+void sequence(std::string& out, std::string_view literal, std::size_t offset, std::size_t match) {
+    const std::size_t extra = match ? match - kMinMatch : 0;
+    const auto nibble = [](std::size_t n) { return static_cast<unsigned>(n < 15 ? n : 15); };
+    out.push_back(static_cast<char>(nibble(literal.size()) << 4 | nibble(extra)));
+    if (literal.size() >= 15) length(out, literal.size() - 15);
+    out.append(literal);
+    if (!match) return;
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (extra >= 15) length(out, extra - 15);
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view bytes) : bytes_(bytes) {}
+
+    bool done() const noexcept { return pos_ == bytes_.size(); }
+    std::uint8_t u8() {
+        if (pos_ == bytes_.size()) throw CompressError("compressed block truncated");
+        return static_cast<std::uint8_t>(bytes_[pos_++]);
+    }
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const std::uint8_t byte = u8();
+            v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        throw CompressError("compressed block size too long");
+    }
+    std::size_t length(std::size_t nibble) {
+        if (nibble < 15) return nibble;
+        for (std::uint8_t byte = 255; byte == 255;) {
+            byte = u8();
+            nibble += byte;
+        }
+        return nibble;
+    }
+    std::string_view bytes(std::size_t n) {
+        if (bytes_.size() - pos_ < n) throw CompressError("compressed block truncated");
+        const std::string_view v = bytes_.substr(pos_, n);
+        pos_ += n;
+        return v;
+    }
+
+private:
+    std::string_view bytes_;
+    std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::string compress(std::string_view data) {
+    std::string out;
+    out.reserve(data.size() / 2 + 16);
+    std::uint64_t v = data.size();
+    for (; v >= 0x80; v >>= 7) out.push_back(static_cast<char>(v | 0x80));
+    out.push_back(static_cast<char>(v));
+
+    // Last position seen with each hash of four bytes, plus one.
+    std::vector<std::uint32_t> table(std::size_t{1} << kHashBits);
+    const char* base = data.data();
+    const std::size_t n = data.size();
+    std::size_t anchor = 0;
+    std::size_t pos = 0;
+    while (pos + kMinMatch <= n) {
+        const std::uint32_t word = load32(base + pos);
+        std::uint32_t& slot = table[hash(word)];
+        const std::size_t candidate = slot;
+        slot = static_cast<std::uint32_t>(pos + 1);
+        if (candidate == 0 || pos + 1 - candidate > kMaxOffset || load32(base + candidate - 1) != word) {
+            // Skip faster through text that keeps missing.
+            pos += 1 + ((pos - anchor) >> 6);
+            continue;
+        }
+        const std::size_t from = candidate - 1;
+        std::size_t match = kMinMatch;
+        while (pos + match < n && base[from + match] == base[pos + match]) ++match;
+        sequence(out, data.substr(anchor, pos - anchor), pos - from, match);
+        pos += match;
+        anchor = pos;
+    }
+    sequence(out, data.substr(anchor), 0, 0);
+    return out;
+}
+
+std::string decompress(std::string_view block) {
+    Reader in(block);
+    const std::uint64_t size = in.varint();
+    // No sequence expands past 255 bytes per input byte, so a larger size
+    // is a lie; don't reserve for it.
+    if (size / 255 > block.size()) throw CompressError("compressed block size out of range");
+    std::string out;
+    out.reserve(size);
+    while (!in.done()) {
+        const std::uint8_t token = in.u8();
+        out.append(in.bytes(in.length(token >> 4)));
+        if (out.size() > size) throw CompressError("compressed block overruns");
+        if (in.done()) {
+            if (token & 0x0f) throw CompressError("compressed block truncated");
+            break;
+        }
+        std::size_t offset = in.u8();
+        offset |= std::size_t{in.u8()} << 8;
+        const std::size_t match = in.length(token & 0x0f) + kMinMatch;
+        if (offset == 0 || offset > out.size()) throw CompressError("compressed match out of range");
+        if (match > size - out.size()) throw CompressError("compressed block overruns");
+        // A match overlapping the bytes it produces repeats them, so copy
+        // what there is so far and go again.
+        const std::size_t from = out.size() - offset;
+        for (std::size_t left = match; left > 0;) {
+            const std::size_t n = std::min(left, out.size() - from);
+            out.append(out, from, n);
+            left -= n;
+        }
+    }
+    if (out.size() != size) throw CompressError("compressed block has the wrong size");
+    return out;
+}
+
+}  // namespace rebel::core
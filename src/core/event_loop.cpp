@@ -0,0 +1,270 @@
+#include "core/event_loop.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+
+namespace rebel::core {
+
+namespace {
+
+[[noreturn]] void fail(const char* what) { throw std::system_error(errno, std::generic_category(), what); }
+
+}  // namespace
+
+#if defined(__linux__)
+
+// epoll, with an eventfd to wake it.
+class EventLoop::Backend {
+public:
+    Backend() {
+        epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ < 0) fail("epoll_create1");
+        wake_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_ < 0) {
+            const int error = errno;
+            ::close(epoll_);
+            throw std::system_error(error, std::generic_category(), "eventfd");
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wake_;
+        ::epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &ev);
+    }
+
+    ~Backend() {
+        ::close(wake_);
+        ::close(epoll_);
+    }
+
+    void set(int fd, std::uint32_t events, bool added) {
+        epoll_event ev{};
+        ev.events = (events & kReadable ? EPOLLIN : 0u) | (events & kWritable ? EPOLLOUT : 0u);
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_, added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) < 0) fail("epoll_ctl");
+    }
+
+    void remove(int fd) { ::epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr); }
+
+    void wait(int timeout_ms, std::vector<std::pair<int, std::uint32_t>>& ready) {
+        epoll_event events[64];
+        const int n = ::epoll_wait(epoll_, events, 64, timeout_ms);
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wake_) {
+                std::uint64_t count;
+                [[maybe_unused]] const auto ignored = ::read(wake_, &count, sizeof count);
+                continue;
+            }
+            const std::uint32_t e = events[i].events;
+            ready.emplace_back(fd, (e & EPOLLIN ? kReadable : 0u) | (e & EPOLLOUT ? kWritable : 0u) |
+                                       (e & (EPOLLERR | EPOLLHUP) ? kClosed : 0u));
+        }
+    }
+
+    void wake() {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const auto ignored = ::write(wake_, &one, sizeof one);
+    }
+
+private:
+    int epoll_ = -1;
+    int wake_ = -1;
+};
+
+#else
+
+// poll() over the watched descriptors, with a pipe to wake it.
+class EventLoop::Backend {
+public:
+    Backend() {
+        if (::pipe(wake_) < 0) fail("pipe");
+        for (const int fd : wake_) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    ~Backend() {
+        ::close(wake_[0]);
+        ::close(wake_[1]);
+    }
+
+    void set(int fd, std::uint32_t events, bool added) {
+        if (added) {
+            fds_.push_back({fd, 0, 0});
+        }
+        for (pollfd& p : fds_) {
+            if (p.fd == fd) {
+                p.events = static_cast<short>((events & kReadable ? POLLIN : 0) | (events & kWritable ? POLLOUT : 0));
+            }
+        }
+    }
+
+    void remove(int fd) {
+        fds_.erase(std::remove_if(fds_.begin(), fds_.end(), [fd](const pollfd& p) { return p.fd == fd; }),
+                   fds_.end());
+    }
+
+    void wait(int timeout_ms, std::vector<std::pair<int, std::uint32_t>>& ready) {
+        polled_ = fds_;
+        polled_.push_back({wake_[0], POLLIN, 0});
+        if (::poll(polled_.data(), static_cast<nfds_t>(polled_.size()), timeout_ms) <= 0) return;
+        for (const pollfd& p : polled_) {
+            if (!p.revents) continue;
+            if (p.fd == wake_[0]) {
+                char buffer[64];
+                while (::read(wake_[0], buffer, sizeof buffer) > 0) {
+                }
+                continue;
+            }
+            ready.emplace_back(p.fd, (p.revents & POLLIN ? kReadable : 0u) | (p.revents & POLLOUT ? kWritable : 0u) |
+                                         (p.revents & (POLLERR | POLLHUP | POLLNVAL) ? kClosed : 0u));
+        }
+    }
+
+    void wake() {
+        const char one = 1;
+        [[maybe_unused]] const auto ignored = ::write(wake_[1], &one, 1);
+    }
+
+private:
+    int wake_[2] = {-1, -1};
+    std::vector<pollfd> fds_;
+    std::vector<pollfd> polled_;
+};
+
+#endif
+
+EventLoop::EventLoop() : backend_(std::make_unique<Backend>()) {}
+
+EventLoop::~EventLoop() = default;
+
+void EventLoop::post(Callback fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(fn));
+    }
+    wake();
+}
+
+void EventLoop::release() noexcept {
+    if (holds_.fetch_sub(1, std::memory_order_acq_rel) == 1) wake();
+}
+
+void EventLoop::stop() {
+    stopping_.store(true, std::memory_order_relaxed);
+    wake();
+}
+
+void EventLoop::wake() { backend_->wake(); }
+
+EventLoop::TimerId EventLoop::add_timer(Clock::duration delay, Callback fn) {
+    const TimerId id = ++next_timer_;
+    timers_.emplace(id, std::move(fn));
+    due_.push({Clock::now() + delay, id});
+    return id;
+}
+
+bool EventLoop::cancel_timer(TimerId id) { return timers_.erase(id) > 0; }
+
+void EventLoop::watch(int fd, std::uint32_t events, WatchCallback fn) {
+    auto [it, added] = watches_.try_emplace(fd);
+    it->second = {events, std::move(fn)};
+    try {
+        backend_->set(fd, events, added);
+    } catch (...) {
+        watches_.erase(fd);
+        throw;
+    }
+}
+
+void EventLoop::unwatch(int fd) {
+    if (watches_.erase(fd)) backend_->remove(fd);
+}
+
+bool EventLoop::alive() const {
+    if (!watches_.empty() || !timers_.empty() || holds_.load(std::memory_order_acquire) > 0) return true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !posted_.empty();
+}
+
+bool EventLoop::run_once(Clock::duration timeout) {
+    // Cancelled timers stay queued until they come up.
+    while (!due_.empty() && !timers_.count(due_.top().id)) due_.pop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!posted_.empty()) timeout = Clock::duration::zero();
+    }
+    if (!due_.empty()) {
+        const Clock::duration until = std::max(due_.top().at - Clock::now(), Clock::duration::zero());
+        if (timeout < Clock::duration::zero() || until < timeout) timeout = until;
+    }
+    // Rounded up, so a timer is never polled for before it is due.
+    int timeout_ms = -1;
+    if (timeout >= Clock::duration::zero()) {
+        timeout_ms = static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+            std::chrono::ceil<std::chrono::milliseconds>(timeout).count(), 1 << 30));
+    }
+
+    ready_.clear();
+    backend_->wait(timeout_ms, ready_);
+    bool ran = false;
+    for (const auto& [fd, events] : ready_) {
+        // An earlier callback may have unwatched it.
+        const auto it = watches_.find(fd);
+        if (it == watches_.end()) continue;
+        const std::uint32_t wanted = events & (it->second.events | kClosed);
+        if (!wanted) continue;
+        const WatchCallback fn = it->second.fn;
+        fn(wanted);
+        ran = true;
+    }
+    ran |= run_timers();
+    ran |= run_posted();
+    return ran;
+}
+
+void EventLoop::run() {
+    while (!stopping_.load(std::memory_order_relaxed) && alive()) run_once();
+    stopping_.store(false, std::memory_order_relaxed);
+}
+
+bool EventLoop::run_timers() {
+    bool ran = false;
+    const Clock::time_point now = Clock::now();
+    while (!due_.empty() && due_.top().at <= now) {
+        const TimerId id = due_.top().id;
+        due_.pop();
+        const auto it = timers_.find(id);
+        if (it == timers_.end()) continue;
+        const Callback fn = std::move(it->second);
+        timers_.erase(it);
+        fn();
+        ran = true;
+    }
+    return ran;
+}
+
+bool EventLoop::run_posted() {
+    std::vector<Callback> posted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted.swap(posted_);
+    }
+    for (const Callback& fn : posted) fn();
+    return !posted.empty();
+}
+
+}  // namespace rebel::core
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rebel::core {
+
+/// Single-threaded event loop: timers, readiness of file descriptors and
+/// callbacks posted from other threads, all run on the thread that calls
+/// run() or run_once(). Waits with epoll on Linux and poll() on other POSIX
+/// systems, woken by an eventfd or a pipe when another thread posts.
+///
+/// Descriptors are watched level-triggered. Work done elsewhere that will
+/// post() its completion, such as a ThreadPool job, holds the loop so that
+/// run() waits for it.
+///
+/// Only post(), hold(), release() and stop() may be called from other
+/// threads.
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+    /// Readiness passed to a watch callback; kClosed is an error or hangup.
+    enum Events : std::uint32_t { kReadable = 1, kWritable = 2, kClosed = 4 };
+    using WatchCallback = std::function<void(std::uint32_t events)>;
+    using TimerId = std::uint64_t;
+
+    /// Throws std::system_error if the OS objects cannot be created.
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /// Runs `fn` on the loop's thread at its next turn.
+    void post(Callback fn);
+
+    /// Runs `fn` once after `delay`.
+    TimerId add_timer(Clock::duration delay, Callback fn);
+    /// Whether the timer was still pending.
+    bool cancel_timer(TimerId id);
+
+    /// Calls `fn` while `fd` is ready for any of `events` (kReadable,
+    /// kWritable), or closed. Watching a watched descriptor replaces its
+    /// events and callback. Throws std::system_error.
+    void watch(int fd, std::uint32_t events, WatchCallback fn);
+    /// Stops watching `fd`; before closing it.
+    void unwatch(int fd);
+
+    /// Keeps run() going until a matching release().
+    void hold() noexcept { holds_.fetch_add(1, std::memory_order_relaxed); }
+    void release() noexcept;
+
+    /// Waits up to `timeout` for something to do, or indefinitely if it is
+    /// negative, and does it. Returns whether any callback ran.
+    bool run_once(Clock::duration timeout = Clock::duration(-1));
+    /// Runs until stop() or until nothing is left: no timers, watches,
+    /// holds or posted callbacks.
+    void run();
+    void stop();
+    /// Whether anything is left for run() to wait for.
+    bool alive() const;
+
+private:
+    class Backend;
+    struct Watch {
+        std::uint32_t events;
+        WatchCallback fn;
+    };
+    struct Due {
+        Clock::time_point at;
+        TimerId id;
+        bool operator>(const Due& other) const noexcept {
+            return at != other.at ? at > other.at : id > other.id;
+        }
+    };
+
+    void wake();
+    bool run_timers();
+    bool run_posted();
+
+    std::unique_ptr<Backend> backend_;
+    std::unordered_map<int, Watch> watches_;
+    std::vector<std::pair<int, std::uint32_t>> ready_;  // from the last wait
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due_;
+    std::unordered_map<TimerId, Callback> timers_;  // pending ones
+    TimerId next_timer_ = 0;
+
+    mutable std::mutex mutex_;  // guards posted_
+    std::vector<Callback> posted_;
+    std::atomic<std::size_t> holds_{0};
+    std::atomic<bool> stopping_{false};
+};
+
+}  // namespace rebel::core
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace rebel::core {
+
+namespace detail {
+
+// 64x64 -> 128 bit multiply, folded by xor.
+inline std::uint64_t mix(std::uint64_t a, std::uint64_t b) noexcept {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 u128;
+    const u128 r = static_cast<u128>(a) * b;
+    return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+#else
+    const std::uint64_t lo = (a & 0xffffffffu) * (b & 0xffffffffu);
+    const std::uint64_t mid1 = (a >> 32) * (b & 0xffffffffu);
+    const std::uint64_t mid2 = (a & 0xffffffffu) * (b >> 32);
+    const std::uint64_t hi = (a >> 32) * (b >> 32);
+    const std::uint64_t carry = ((lo >> 32) + (mid1 & 0xffffffffu) + (mid2 & 0xffffffffu)) >> 32;
+    return (lo + (mid1 << 32) + (mid2 << 32)) ^ (hi + (mid1 >> 32) + (mid2 >> 32) + carry);
+#endif
+}
+
+inline std::uint64_t load64(const unsigned char* p) noexcept {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+}  // namespace detail
+
+/// Fast non-cryptographic 64-bit hash of a byte range, for telling file and
+/// source contents apart (caches, index invalidation). Reads eight bytes at
+/// a time, so it runs at memory speed; the same bytes give the same value
+/// on every run and every little-endian platform, so it may be persisted.
+inline std::uint64_t hash64(const void* data, std::size_t size, std::uint64_t seed = 0) noexcept {
+    constexpr std::uint64_t k0 = 0xa0761d6478bd642full;
+    constexpr std::uint64_t k1 = 0xe7037ed1a0b428dbull;
+    const auto* p = static_cast<const unsigned char*>(data);
+    std::uint64_t h = seed ^ detail::mix(size ^ k0, k1);
+    std::size_t n = size;
+    for (; n >= 16; n -= 16, p += 16) {
+        h = detail::mix(detail::load64(p) ^ k0 ^ h, detail::load64(p + 8) ^ k1);
+    }
+    if (n >= 8) {
+        h = detail::mix(detail::load64(p) ^ k0 ^ h, k1 ^ n);
+        p += 8;
+        n -= 8;
+    }
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, p, n);
+    return detail::mix(h ^ tail ^ k1, k0 ^ size);
+}
+
+inline std::uint64_t hash64(std::string_view text, std::uint64_t seed = 0) noexcept {
+    return hash64(text.data(), text.size(), seed);
+}
+
+}  // namespace rebel::core
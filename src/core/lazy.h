@@ -0,0 +1,62 @@
+#pragma once
+
+#include "core/startup_trace.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace rebel::core {
+
+/// A subsystem built on first use rather than at launch.
+///
+/// get() runs the factory once; concurrent callers wait for that run, and
+/// after it the cost is one acquire load. If the factory throws, the
+/// exception reaches the caller and the next get() tries again. With a
+/// trace the construction is recorded as a phase named "init <name>", on
+/// whichever thread first asked.
+template <typename T>
+class Lazy {
+public:
+    using Factory = std::function<std::unique_ptr<T>()>;
+
+    Lazy(std::string name, Factory factory, StartupTrace* trace = nullptr)
+        : name_(std::move(name)), factory_(std::move(factory)), trace_(trace) {}
+    Lazy(const Lazy&) = delete;
+    Lazy& operator=(const Lazy&) = delete;
+
+    T& get() {
+        if (T* ready = ready_.load(std::memory_order_acquire)) return *ready;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!value_) {
+            if (trace_) {
+                const StartupTrace::Scope phase = trace_->phase("init " + name_);
+                value_ = factory_();
+            } else {
+                value_ = factory_();
+            }
+            ready_.store(value_.get(), std::memory_order_release);
+        }
+        return *value_;
+    }
+    T& operator*() { return get(); }
+    T* operator->() { return &get(); }
+
+    /// Null until the first get() has finished; never builds anything.
+    T* get_if_ready() const noexcept { return ready_.load(std::memory_order_acquire); }
+    bool ready() const noexcept { return get_if_ready() != nullptr; }
+    const std::string& name() const noexcept { return name_; }
+
+private:
+    std::string name_;
+    Factory factory_;
+    StartupTrace* trace_;
+    std::mutex mutex_;
+    std::unique_ptr<T> value_;
+    std::atomic<T*> ready_{nullptr};
+};
+
+}  // namespace rebel::core
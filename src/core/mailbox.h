@@ -0,0 +1,246 @@
+#pragma once
+
+#include "core/ring_buffer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace rebel::core {
+
+/// Latency histogram: four buckets per power of two nanoseconds, so a
+/// percentile read back is at most 25% above the true value.
+class LatencyHistogram {
+public:
+    static constexpr std::size_t kBuckets = 4 * 40;  // up to 2^41 ns, about 36 minutes
+
+    void add(std::uint64_t ns, std::uint64_t count = 1) noexcept { counts_[bucket(ns)] += count; }
+    std::uint64_t count() const noexcept {
+        std::uint64_t total = 0;
+        for (const std::uint64_t n : counts_) total += n;
+        return total;
+    }
+    /// Upper bound of the bucket holding percentile `p` (0-100); 0 if empty.
+    double percentile(double p) const noexcept {
+        const std::uint64_t total = count();
+        if (total == 0) return 0;
+        const auto rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(total - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            seen += counts_[b];
+            if (seen > rank) return upper_bound(b);
+        }
+        return upper_bound(kBuckets - 1);
+    }
+
+    static std::size_t bucket(std::uint64_t ns) noexcept {
+        if (ns < 4) return static_cast<std::size_t>(ns);
+        std::size_t log = 0;
+        while (ns >> (log + 1)) ++log;
+        const std::size_t b = 4 * (log - 1) + static_cast<std::size_t>(ns >> (log - 2) & 3);
+        return std::min(b, kBuckets - 1);
+    }
+    /// The largest value counted in bucket `b`.
+    static double upper_bound(std::size_t b) noexcept {
+        if (b < 4) return static_cast<double>(b);
+        const std::size_t log = b / 4 + 1;
+        return static_cast<double>((std::uint64_t{4} + b % 4 + 1) << (log - 2)) - 1;
+    }
+
+private:
+    std::array<std::uint64_t, kBuckets> counts_{};
+};
+
+/// A thread's inbox: a RingBuffer plus the waiting the ring leaves out.
+///
+/// Any number of threads post; the owner drains, or several consumers do.
+/// Posting never takes a lock. A consumer with nothing to do parks in
+/// wait(), and only then does a producer touch the mutex, once per batch:
+/// the first post after a consumer parks wakes it and the rest see the
+/// wakeup already on its way. A debugger streaming thousands of events
+/// a second into the UI thread therefore costs one wakeup per frame the
+/// UI spends asleep, not one per event.
+///
+/// For diagnostics every message is stamped when posted, and the
+/// consumers record how long each sat in the queue.
+///
+/// `T` must be default-constructible and movable.
+template <typename T>
+class Mailbox {
+public:
+    struct Stats {
+        std::uint64_t posted = 0;
+        std::uint64_t received = 0;
+        std::uint64_t rejected = 0;   // try_post on a full mailbox
+        std::uint64_t full_waits = 0; // post() waited for room
+        std::uint64_t wakeups = 0;    // consumers woken by a post
+        std::size_t depth = 0;
+        std::size_t max_depth = 0;    // seen by drain()
+        LatencyHistogram latency;     // post to drain, in ns
+    };
+
+    explicit Mailbox(std::size_t capacity) : ring_(capacity) {}
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    std::size_t capacity() const noexcept { return ring_.capacity(); }
+
+    /// False if the mailbox is full or closed.
+    bool try_post(T message) {
+        if (closed_.load(std::memory_order_relaxed)) return false;
+        if (!ring_.try_push(Entry{std::move(message), now_ns()})) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        wake(consumers_waiting_, consumer_signalled_, has_messages_);
+        return true;
+    }
+
+    /// Waits for room when full: briefly yielding, then parked until a
+    /// consumer drains. False only if the mailbox is closed.
+    bool post(T message) {
+        Entry entry{std::move(message), 0};
+        for (int attempt = 0;; ++attempt) {
+            if (closed_.load(std::memory_order_relaxed)) return false;
+            entry.posted_ns = now_ns();
+            if (ring_.try_push(std::move(entry))) break;
+            if (attempt == 0) full_waits_.fetch_add(1, std::memory_order_relaxed);
+            if (attempt < kYields) {
+                std::this_thread::yield();
+                continue;
+            }
+            park(producers_waiting_, producer_signalled_, has_room_, [this] { return ring_.size() < ring_.capacity(); },
+                 std::chrono::milliseconds(10));
+        }
+        wake(consumers_waiting_, consumer_signalled_, has_messages_);
+        return true;
+    }
+
+    /// Passes up to `max` queued messages to `handle(T&&)`, oldest first,
+    /// without blocking. Returns how many.
+    template <typename F>
+    std::size_t drain(F&& handle, std::size_t max = std::numeric_limits<std::size_t>::max()) {
+        const std::size_t depth = ring_.size();
+        if (depth > max_depth_.load(std::memory_order_relaxed)) max_depth_.store(depth, std::memory_order_relaxed);
+        std::size_t count = 0;
+        Entry entry{};
+        const std::uint64_t now = now_ns();  // latency is queueing time, up to this pickup
+        while (count < max && ring_.try_pop(entry)) {
+            const std::size_t bucket = LatencyHistogram::bucket(now > entry.posted_ns ? now - entry.posted_ns : 0);
+            latency_[bucket].fetch_add(1, std::memory_order_relaxed);
+            handle(std::move(entry.message));
+            ++count;
+        }
+        if (count > 0) wake(producers_waiting_, producer_signalled_, has_room_);
+        return count;
+    }
+
+    /// Returns as soon as a message is queued (true), or after `timeout` or
+    /// once closed (false) with nothing queued.
+    template <typename Rep, typename Period>
+    bool wait(std::chrono::duration<Rep, Period> timeout) {
+        if (!ring_.empty()) return true;
+        const bool woken = park(consumers_waiting_, consumer_signalled_, has_messages_,
+                                [this] { return !ring_.empty() || closed_.load(); }, timeout);
+        if (woken) wakeups_.fetch_add(1, std::memory_order_relaxed);
+        return !ring_.empty();
+    }
+
+    /// Refuses further posts and wakes every waiter. Queued messages can
+    /// still be drained.
+    void close() {
+        closed_.store(true);
+        std::lock_guard<std::mutex> lock(mutex_);
+        has_messages_.notify_all();
+        has_room_.notify_all();
+    }
+    bool closed() const noexcept { return closed_.load(); }
+
+    Stats stats() const {
+        Stats stats;
+        stats.received = ring_.popped();
+        stats.depth = ring_.size();
+        stats.posted = stats.received + stats.depth;
+        stats.rejected = rejected_.load(std::memory_order_relaxed);
+        stats.full_waits = full_waits_.load(std::memory_order_relaxed);
+        stats.wakeups = wakeups_.load(std::memory_order_relaxed);
+        stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+        for (std::size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+            const std::uint64_t count = latency_[b].load(std::memory_order_relaxed);
+            if (count) stats.latency.add(static_cast<std::uint64_t>(LatencyHistogram::upper_bound(b)), count);
+        }
+        return stats;
+    }
+
+private:
+    struct Entry {
+        T message;
+        std::uint64_t posted_ns;
+    };
+
+    static constexpr int kYields = 64;
+
+    static std::uint64_t now_ns() noexcept {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now().time_since_epoch())
+                                              .count());
+    }
+
+    // A waiter counts itself and clears the signal before checking for
+    // work, and the other side publishes work before reading the count
+    // (all sequentially consistent): either the waiter sees the work or
+    // the other side sees the waiter, and the first to see it after the
+    // clear takes the mutex and notifies while later ones skip it.
+    template <typename Ready, typename Duration>
+    bool park(std::atomic<int>& waiting, std::atomic<bool>& signalled, std::condition_variable& cv, Ready ready,
+              Duration timeout) {
+        waiting.fetch_add(1);
+        signalled.store(false);
+        bool woken;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            woken = cv.wait_for(lock, timeout, ready);
+        }
+        waiting.fetch_sub(1);
+        return woken;
+    }
+
+    void wake(std::atomic<int>& waiting, std::atomic<bool>& signalled, std::condition_variable& cv) {
+        // The ring publishes with release stores, which may otherwise pass
+        // the load below.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load() == 0 || signalled.exchange(true)) return;
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        cv.notify_all();
+    }
+
+    RingBuffer<Entry> ring_;
+    std::atomic<bool> closed_{false};
+
+    // Only parked threads use these.
+    std::mutex mutex_;
+    std::condition_variable has_messages_;
+    std::condition_variable has_room_;
+    alignas(64) std::atomic<int> consumers_waiting_{0};
+    std::atomic<bool> consumer_signalled_{false};
+    alignas(64) std::atomic<int> producers_waiting_{0};
+    std::atomic<bool> producer_signalled_{false};
+
+    // Counters; the latency buckets are written by consumers only.
+    alignas(64) std::atomic<std::uint64_t> rejected_{0};
+    std::atomic<std::uint64_t> full_waits_{0};
+    std::atomic<std::uint64_t> wakeups_{0};
+    std::atomic<std::size_t> max_depth_{0};
+    std::array<std::atomic<std::uint64_t>, LatencyHistogram::kBuckets> latency_{};
+};
+
+}  // namespace rebel::core
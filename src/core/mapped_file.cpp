@@ -0,0 +1,110 @@
+#include "core/mapped_file.h"
+
+#include <cerrno>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rebel::core {
+
+#ifdef _WIN32
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile(path));
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "open " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        const auto error = static_cast<int>(GetLastError());
+        CloseHandle(handle);
+        throw std::system_error(error, std::system_category(), "stat " + path);
+    }
+    file->size_ = static_cast<std::size_t>(size.QuadPart);
+    if (file->size_ > 0) {
+        file->mapping_ = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (file->mapping_) {
+            file->data_ = static_cast<const char*>(MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!file->data_) {
+            const auto error = static_cast<int>(GetLastError());
+            CloseHandle(handle);
+            throw std::system_error(error, std::system_category(), "mmap " + path);
+        }
+    }
+    CloseHandle(handle);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+}
+
+void MappedFile::advise(Access access, std::size_t offset, std::size_t length) const noexcept {
+    if (access != Access::WillNeed || offset >= size_) return;
+    WIN32_MEMORY_RANGE_ENTRY range{const_cast<char*>(data_) + offset,
+                                   length < size_ - offset ? length : size_ - offset};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile(path));
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "stat " + path);
+    }
+    file->size_ = static_cast<std::size_t>(st.st_size);
+    if (file->size_ > 0) {
+        void* addr = ::mmap(nullptr, file->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "mmap " + path);
+        }
+        file->data_ = static_cast<const char*>(addr);
+    }
+    ::close(fd);
+    return file;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+}
+
+void MappedFile::advise(Access access, std::size_t offset, std::size_t length) const noexcept {
+    if (!data_ || offset >= size_) return;
+    // madvise wants a page-aligned start.
+    const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t begin = offset & ~(page - 1);
+    const std::size_t end = length < size_ - offset ? offset + length : size_;
+    int advice = MADV_NORMAL;
+    switch (access) {
+        case Access::Normal: advice = MADV_NORMAL; break;
+        case Access::Sequential: advice = MADV_SEQUENTIAL; break;
+        case Access::Random: advice = MADV_RANDOM; break;
+        case Access::WillNeed: advice = MADV_WILLNEED; break;
+    }
+    ::madvise(const_cast<char*>(data_) + begin, end - begin, advice);
+}
+
+#endif
+
+}  // namespace rebel::core
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace rebel::core {
+
+/// Read-only memory mapping of an entire file.
+///
+/// Pages are faulted in on first touch, so opening is O(1) in the file size.
+/// The mapping reflects later writes to the file by other processes, and
+/// truncating the file underneath a live mapping is undefined behaviour on
+/// POSIX (SIGBUS); callers that need a stable snapshot must copy.
+class MappedFile {
+public:
+    enum class Access { Normal, Sequential, Random, WillNeed };
+
+    /// Maps `path`; throws std::system_error if it cannot be opened or mapped.
+    static std::shared_ptr<const MappedFile> open(const std::string& path);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::string& path() const noexcept { return path_; }
+    const char* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    std::string_view view() const noexcept { return {data_, size_}; }
+
+    /// Paging hint for [offset, offset + length); a no-op where unsupported.
+    void advise(Access access, std::size_t offset = 0,
+                std::size_t length = static_cast<std::size_t>(-1)) const noexcept;
+
+private:
+    explicit MappedFile(std::string path) : path_(std::move(path)) {}
+
+    std::string path_;
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace rebel::core
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rebel::core {
+
+/// Bounded lock-free FIFO for any number of producers and consumers
+/// (Vyukov's array queue), so it serves as the MPSC queue into one thread
+/// and as the SPMC queue out to several.
+///
+/// Each cell carries a sequence number saying whose turn it is: a producer
+/// claims the cell at the tail with one compare-exchange once the
+/// consumers have emptied it, and a consumer likewise at the head once it
+/// is filled. Producers contend only with producers and consumers only
+/// with consumers, on separate cache lines, and nobody waits for a thread
+/// that was preempted halfway unless it is the one holding the very cell
+/// needed next.
+///
+/// `T` must be move-constructible and move-assignable. Messages still
+/// queued when the buffer is destroyed are destroyed with it.
+template <typename T>
+class RingBuffer {
+public:
+    /// `capacity` is rounded up to a power of two, at least 2.
+    explicit RingBuffer(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) size *= 2;
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~RingBuffer() {
+        for (std::size_t pos = head_.load(); pos != tail_.load(); ++pos) cells_[pos & mask_].value()->~T();
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /// False if the buffer is full.
+    template <typename U>
+    bool try_push(U&& value) {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (lag == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (cell.storage) T(std::forward<U>(value));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lag < 0) {
+                return false;  // the cell a lap ahead is still occupied
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// False if the buffer is empty.
+    bool try_pop(T& out) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+            if (lag == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* value = cell.value();
+                    out = std::move(*value);
+                    value->~T();
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lag < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t capacity() const noexcept { return mask_ + 1; }
+    /// Messages ever pushed and popped; their difference is the depth.
+    /// Both are snapshots when other threads are active.
+    std::size_t pushed() const noexcept { return tail_.load(std::memory_order_relaxed); }
+    std::size_t popped() const noexcept { return head_.load(std::memory_order_relaxed); }
+    std::size_t size() const noexcept {
+        const std::size_t head = popped();
+        const std::size_t tail = pushed();
+        return tail > head ? tail - head : 0;
+    }
+    bool empty() const noexcept { return size() == 0; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    static constexpr std::size_t kLine = 64;
+
+    alignas(kLine) std::atomic<std::size_t> tail_{0};
+    alignas(kLine) std::atomic<std::size_t> head_{0};
+    alignas(kLine) std::size_t mask_ = 0;
+    std::unique_ptr<Cell[]> cells_;
+};
+
+}  // namespace rebel::core
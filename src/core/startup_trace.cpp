@@ -0,0 +1,85 @@
+#include "core/startup_trace.h"
+
+#include <cstdio>
+#include <utility>
+
+namespace rebel::core {
+
+void StartupTrace::Scope::end() {
+    if (!trace_) return;
+    trace_->finish(index_);
+    trace_ = nullptr;
+}
+
+StartupTrace::StartupTrace() : origin_(Clock::now()) {
+    threads_.push_back(std::this_thread::get_id());
+    open_.push_back(0);
+}
+
+std::size_t StartupTrace::thread_number() {
+    const std::thread::id self = std::this_thread::get_id();
+    for (std::size_t n = 0; n < threads_.size(); ++n) {
+        if (threads_[n] == self) return n;
+    }
+    threads_.push_back(self);
+    open_.push_back(0);
+    return threads_.size() - 1;
+}
+
+StartupTrace::Scope StartupTrace::phase(std::string name) {
+    const double start = elapsed_ms();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::size_t thread = thread_number();
+    phases_.push_back({std::move(name), open_[thread]++, thread, start, -1});
+    return Scope(this, phases_.size() - 1);
+}
+
+void StartupTrace::finish(std::size_t index) {
+    const double end = elapsed_ms();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Phase& phase = phases_[index];
+    phase.duration_ms = end - phase.start_ms;
+    --open_[phase.thread];
+}
+
+void StartupTrace::mark(std::string name) {
+    const double at = elapsed_ms();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::size_t thread = thread_number();
+    phases_.push_back({std::move(name), open_[thread], thread, at, 0});
+}
+
+std::vector<StartupTrace::Phase> StartupTrace::phases() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return phases_;
+}
+
+double StartupTrace::total_ms(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double total = 0;
+    for (const Phase& phase : phases_) {
+        if (phase.depth == 0 && phase.duration_ms > 0 && phase.name == name) total += phase.duration_ms;
+    }
+    return total;
+}
+
+std::string StartupTrace::report() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    char line[64];
+    for (const Phase& phase : phases_) {
+        if (phase.duration_ms < 0) {
+            std::snprintf(line, sizeof line, "%10.3f %10s  ", phase.start_ms, "...");
+        } else {
+            std::snprintf(line, sizeof line, "%10.3f %10.3f  ", phase.start_ms, phase.duration_ms);
+        }
+        out += line;
+        out.append(2 * phase.depth, ' ');
+        out += phase.name;
+        if (phase.thread != 0) out += " [thread " + std::to_string(phase.thread) + "]";
+        out += '\n';
+    }
+    return out;
+}
+
+}  // namespace rebel::core
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rebel::core {
+
+/// Timeline of what a launch spent its time on: named, nested phases with
+/// their start and duration relative to the trace's creation, for finding
+/// what stands between the user and a usable editor.
+///
+/// Phases may be recorded from any thread; nesting is per thread. Work
+/// started lazily long after launch is recorded too, so the same trace
+/// shows what the first use of each subsystem cost.
+class StartupTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase {
+        std::string name;
+        std::size_t depth = 0;  // phases open on the same thread when it began
+        std::size_t thread = 0; // 0 for the thread that created the trace, then in order of appearance
+        double start_ms = 0;
+        double duration_ms = 0;
+    };
+
+    /// Ends its phase when destroyed.
+    class Scope {
+    public:
+        Scope(Scope&& other) noexcept : trace_(other.trace_), index_(other.index_) { other.trace_ = nullptr; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope& operator=(Scope&&) = delete;
+        ~Scope() { end(); }
+
+        /// Ends the phase early.
+        void end();
+
+    private:
+        friend class StartupTrace;
+        Scope(StartupTrace* trace, std::size_t index) : trace_(trace), index_(index) {}
+
+        StartupTrace* trace_;
+        std::size_t index_;
+    };
+
+    StartupTrace();
+    StartupTrace(const StartupTrace&) = delete;
+    StartupTrace& operator=(const StartupTrace&) = delete;
+
+    /// Begins a phase, ended with the returned scope.
+    [[nodiscard]] Scope phase(std::string name);
+    /// Records an instant, such as "ready", as a phase of no duration.
+    void mark(std::string name);
+
+    /// Milliseconds since the trace was created.
+    double elapsed_ms() const noexcept {
+        return std::chrono::duration<double, std::milli>(Clock::now() - origin_).count();
+    }
+
+    /// Phases in the order they began; unfinished ones have duration -1.
+    std::vector<Phase> phases() const;
+    /// Total of the finished top-level phases named `name`, in ms.
+    double total_ms(const std::string& name) const;
+
+    /// One line per phase, indented by depth:
+    ///
+    ///       0.000     41.210  script.vm
+    ///       0.004      1.920    script.image
+    ///
+    /// start and duration in ms, then the name; phases on other threads
+    /// carry a "[thread n]" suffix.
+    std::string report() const;
+
+private:
+    std::size_t thread_number();  // with mutex_ held
+    void finish(std::size_t index);
+
+    Clock::time_point origin_;
+    mutable std::mutex mutex_;
+    std::vector<Phase> phases_;
+    std::vector<std::size_t> open_;  // per thread number, phases currently open
+    std::vector<std::thread::id> threads_;  // by thread number
+};
+
+}  // namespace rebel::core
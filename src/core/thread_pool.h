@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rebel::core {
+
+/// Fixed-size pool of worker threads draining a shared FIFO queue.
+///
+/// Tasks must not throw; an escaping exception terminates the process.
+class ThreadPool {
+public:
+    /// `threads == 0` uses one thread per hardware core.
+    explicit ThreadPool(std::size_t threads = 0);
+    /// Runs every queued task to completion, then joins the workers.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    /// Blocks until the queue is empty and no task is running.
+    void wait_idle();
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> queue_;
+    std::size_t active_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace rebel::core
@@ -0,0 +1,306 @@
+#include "core/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rebel::core::trace {
+namespace {
+
+constexpr std::size_t kRingEvents = 8192;  // per thread, a power of two
+constexpr std::size_t kRetiredRings = 32;  // kept after their thread exits
+
+// Fields are atomics so that exporting while the owner writes is defined;
+// relaxed stores cost the writer nothing over plain ones.
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<std::uint64_t> start{0};
+    std::atomic<std::uint64_t> duration{0};
+};
+
+struct Ring {
+    std::atomic<std::uint64_t> head{0};   // events ever written
+    std::atomic<std::uint64_t> floor{0};  // none before this are exported, after reset()
+    Event events[kRingEvents];
+    std::size_t thread = 0;  // in order of first span
+    std::string name;        // with the registry's mutex held
+    bool retired = false;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::size_t next_thread = 1;
+};
+
+Registry& registry() {
+    static Registry* registry = new Registry;  // outlives threads ending during exit
+    return *registry;
+}
+
+std::atomic<Probe*> probes{nullptr};
+std::atomic<std::uint64_t> window_ns{10'000'000'000};
+
+// The calling thread's ring, registered on first use and retired when the
+// thread exits.
+class ThreadRing {
+public:
+    ~ThreadRing() {
+        if (!ring_) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        ring_->retired = true;
+        std::size_t retired = 0;
+        for (const auto& ring : r.rings) retired += ring->retired ? 1 : 0;
+        for (auto it = r.rings.begin(); retired > kRetiredRings && it != r.rings.end();) {
+            if ((*it)->retired) {
+                it = r.rings.erase(it);
+                --retired;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    Ring& get() {
+        if (!ring_) {
+            auto ring = std::make_shared<Ring>();
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            ring->thread = r.next_thread++;
+            r.rings.push_back(ring);
+            ring_ = std::move(ring);
+        }
+        return *ring_;
+    }
+
+private:
+    std::shared_ptr<Ring> ring_;
+};
+
+thread_local ThreadRing thread_ring;
+
+int highest_bit(std::uint64_t v) noexcept {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanReverse64(&bit, v);
+    return static_cast<int>(bit);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+std::size_t bucket(std::uint64_t ns) noexcept {
+    if (ns < 16) return static_cast<std::size_t>(ns);
+    const int octave = highest_bit(ns);
+    return 16 + static_cast<std::size_t>(octave - 4) * 8 + static_cast<std::size_t>((ns >> (octave - 3)) & 7);
+}
+
+// The middle of what bucket `b` counts.
+double bucket_value(std::size_t b) noexcept {
+    if (b < 16) return static_cast<double>(b);
+    const std::size_t octave = (b - 16) / 8 + 4;
+    const double width = static_cast<double>(std::uint64_t{1} << (octave - 3));
+    return static_cast<double>(8 + (b - 16) % 8) * width + width / 2;
+}
+
+void append_escaped(std::string& out, const std::string& text) {
+    for (const char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+}
+
+}  // namespace
+
+void set_enabled(bool on) noexcept { detail::enabled.store(on, std::memory_order_relaxed); }
+
+void set_window(std::chrono::milliseconds window) noexcept {
+    const auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(window.count(), 1)) * 1'000'000;
+    window_ns.store(ns, std::memory_order_relaxed);
+}
+
+void set_thread_name(std::string name) {
+    Ring& ring = thread_ring.get();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring.name = std::move(name);
+}
+
+Probe::Probe(const char* name) noexcept : name_(name) {
+    for (Window& window : windows_) clear(window);
+    Probe* head = probes.load(std::memory_order_relaxed);
+    do {
+        next_ = head;
+    } while (!probes.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Probe::clear(Window& window) noexcept {
+    for (auto& count : window.counts) count.store(0, std::memory_order_relaxed);
+    window.max.store(0, std::memory_order_relaxed);
+}
+
+void Probe::record(std::uint64_t start_ns, std::uint64_t end_ns) noexcept {
+    const std::uint64_t duration = end_ns > start_ns ? end_ns - start_ns : 0;
+
+    Ring& ring = thread_ring.get();
+    const std::uint64_t at = ring.head.load(std::memory_order_relaxed);
+    Event& event = ring.events[at & (kRingEvents - 1)];
+    event.name.store(name_, std::memory_order_relaxed);
+    event.start.store(start_ns, std::memory_order_relaxed);
+    event.duration.store(duration, std::memory_order_relaxed);
+    ring.head.store(at + 1, std::memory_order_release);
+
+    // The first span of each window clears the counts of the window two
+    // before it, whose slot it takes over. Spans racing with the clear may
+    // be lost, which percentiles do not notice.
+    const std::uint64_t epoch = end_ns / window_ns.load(std::memory_order_relaxed);
+    Window& window = windows_[epoch & 1];
+    std::uint64_t seen = window.epoch.load(std::memory_order_relaxed);
+    if (seen != epoch) {
+        if (seen > epoch) return;  // ended before another thread moved on
+        if (window.epoch.compare_exchange_strong(seen, epoch, std::memory_order_relaxed)) clear(window);
+    }
+    window.counts[bucket(duration)].fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t max = window.max.load(std::memory_order_relaxed);
+    while (duration > max && !window.max.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {
+    }
+}
+
+void Probe::add_to(Totals& totals) const {
+    const std::uint64_t epoch = now_ns() / window_ns.load(std::memory_order_relaxed);
+    for (const Window& window : windows_) {
+        const std::uint64_t at = window.epoch.load(std::memory_order_relaxed);
+        if (at != epoch && at + 1 != epoch) continue;
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            const std::uint32_t n = window.counts[b].load(std::memory_order_relaxed);
+            totals.counts[b] += n;
+            totals.count += n;
+        }
+        totals.max = std::max(totals.max, window.max.load(std::memory_order_relaxed));
+    }
+}
+
+Latency Probe::summarize(std::string name, const Totals& totals) {
+    Latency latency;
+    latency.name = std::move(name);
+    latency.count = totals.count;
+    latency.max_ns = static_cast<double>(totals.max);
+    if (totals.count == 0) return latency;
+    const auto at_rank = [&](double p) {
+        const auto rank = static_cast<std::uint64_t>(p * static_cast<double>(totals.count - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            seen += totals.counts[b];
+            if (seen > rank) return std::min(bucket_value(b), latency.max_ns);
+        }
+        return latency.max_ns;
+    };
+    latency.p50_ns = at_rank(0.50);
+    latency.p99_ns = at_rank(0.99);
+    return latency;
+}
+
+Latency Probe::latency() const {
+    Totals totals;
+    add_to(totals);
+    return summarize(name_, totals);
+}
+
+std::vector<Latency> latencies() {
+    // Probes at different sites may share a name; their counts add up.
+    std::vector<std::pair<std::string, Probe::Totals>> totals;
+    for (const Probe* p = probes.load(std::memory_order_acquire); p; p = p->next_) {
+        auto it = std::find_if(totals.begin(), totals.end(), [&](const auto& t) { return t.first == p->name_; });
+        if (it == totals.end()) it = totals.insert(totals.end(), {p->name_, Probe::Totals{}});
+        p->add_to(it->second);
+    }
+    std::vector<Latency> out;
+    for (const auto& [name, t] : totals) {
+        if (t.count > 0) out.push_back(Probe::summarize(name, t));
+    }
+    std::sort(out.begin(), out.end(), [](const Latency& a, const Latency& b) { return a.name < b.name; });
+    return out;
+}
+
+std::string chrome_json() {
+    struct Copied {
+        const char* name;
+        std::uint64_t start;
+        std::uint64_t duration;
+        std::size_t thread;
+    };
+    std::vector<Copied> events;
+    std::vector<std::pair<std::size_t, std::string>> names;
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto& ring : r.rings) {
+            if (!ring->name.empty()) names.emplace_back(ring->thread, ring->name);
+            const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+            const std::uint64_t first = std::max(ring->floor.load(std::memory_order_relaxed),
+                                                 head > kRingEvents ? head - kRingEvents : 0);
+            const std::size_t copied_from = events.size();
+            for (std::uint64_t i = first; i < head; ++i) {
+                const Event& e = ring->events[i & (kRingEvents - 1)];
+                events.push_back({e.name.load(std::memory_order_relaxed), e.start.load(std::memory_order_relaxed),
+                                  e.duration.load(std::memory_order_relaxed), ring->thread});
+            }
+            // Events the owner overwrote while they were copied (and the one
+            // it may be writing now) are dropped.
+            const std::uint64_t now = ring->head.load(std::memory_order_acquire);
+            const std::uint64_t valid = now + 1 > kRingEvents ? now + 1 - kRingEvents : 0;
+            if (valid > first) {
+                const auto drop = static_cast<std::size_t>(std::min(valid - first, head - first));
+                events.erase(events.begin() + static_cast<std::ptrdiff_t>(copied_from),
+                             events.begin() + static_cast<std::ptrdiff_t>(copied_from + drop));
+            }
+        }
+    }
+
+    std::uint64_t origin = ~std::uint64_t{0};
+    for (const Copied& e : events) origin = std::min(origin, e.start);
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    char number[96];
+    for (const auto& [thread, name] : names) {
+        out += first ? "\n" : ",\n";
+        first = false;
+        std::snprintf(number, sizeof number, "{\"ph\":\"M\",\"pid\":1,\"tid\":%zu,", thread);
+        out += number;
+        out += "\"name\":\"thread_name\",\"args\":{\"name\":\"";
+        append_escaped(out, name);
+        out += "\"}}";
+    }
+    for (const Copied& e : events) {
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"ph\":\"X\",\"pid\":1,\"name\":\"";
+        append_escaped(out, e.name ? e.name : "?");
+        std::snprintf(number, sizeof number, "\",\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}", e.thread,
+                      static_cast<double>(e.start - origin) / 1e3, static_cast<double>(e.duration) / 1e3);
+        out += number;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+void reset() {
+    for (Probe* p = probes.load(std::memory_order_acquire); p; p = p->next_) {
+        for (Probe::Window& window : p->windows_) {
+            window.epoch.store(0, std::memory_order_relaxed);
+            p->clear(window);
+        }
+    }
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& ring : r.rings) ring->floor.store(ring->head.load(std::memory_order_acquire));
+}
+
+}  // namespace rebel::core::trace
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Editor-wide latency tracing: named spans on the hot paths (frame
+/// building, highlighting, indexing, language server round trips, script
+/// runs, debugger stops), kept two ways.
+///
+/// Each thread writes the spans it ends into a ring of its own, without
+/// locks or allocation, overwriting the oldest; chrome_json() exports what
+/// the rings hold for chrome://tracing or Perfetto. Each probe (one per
+/// span name) also counts its durations in a log-scale histogram over a
+/// rolling window, for p50/p99 that stay meaningful however long the
+/// editor runs; latencies() reads them, and the bench harness appends them
+/// to every benchmark's output.
+///
+/// Spans are placed with the REBEL_TRACE_* macros, which compile to
+/// nothing when the build is configured with -DREBEL_TRACING=OFF. In a
+/// tracing build a span costs two clock reads and a few relaxed stores;
+/// set_enabled(false) leaves one load.
+namespace rebel::core::trace {
+
+/// Nanoseconds on the steady clock; spans are measured in these.
+inline std::uint64_t now_ns() noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+namespace detail {
+inline std::atomic<bool> enabled{true};
+}  // namespace detail
+
+/// Whether spans are recorded; on by default.
+inline bool enabled() noexcept { return detail::enabled.load(std::memory_order_relaxed); }
+void set_enabled(bool on) noexcept;
+
+/// Percentiles of one probe over the rolling window.
+struct Latency {
+    std::string name;
+    std::uint64_t count = 0;
+    double p50_ns = 0;  // to within 1/8 of the value
+    double p99_ns = 0;
+    double max_ns = 0;
+};
+
+/// A span name with its histogram. Probes live for the whole program: the
+/// macros make them function-local or namespace-scope statics.
+class Probe {
+public:
+    explicit Probe(const char* name) noexcept;
+    Probe(const Probe&) = delete;
+    Probe& operator=(const Probe&) = delete;
+
+    const char* name() const noexcept { return name_; }
+    /// Records a span of this probe that ran from `start_ns` to `end_ns` on
+    /// the calling thread.
+    void record(std::uint64_t start_ns, std::uint64_t end_ns) noexcept;
+    Latency latency() const;
+
+private:
+    friend void reset();
+    friend std::vector<Latency> latencies();
+
+    // Eight buckets per power of two: values under 16 ns exactly, then
+    // within 12.5%.
+    static constexpr std::size_t kBuckets = 16 + 60 * 8;
+    struct Window {
+        std::atomic<std::uint64_t> epoch{0};  // which window of time it counts
+        std::atomic<std::uint64_t> max{0};
+        std::array<std::atomic<std::uint32_t>, kBuckets> counts{};
+    };
+
+    // Counts over the rolling window, summed across probes of one name.
+    struct Totals {
+        std::array<std::uint64_t, kBuckets> counts{};
+        std::uint64_t count = 0;
+        std::uint64_t max = 0;
+    };
+
+    void clear(Window& window) noexcept;
+    void add_to(Totals& totals) const;
+    static Latency summarize(std::string name, const Totals& totals);
+
+    const char* name_;
+    Probe* next_ = nullptr;  // in the list of all probes
+    Window windows_[2];      // the current window and the one before
+};
+
+/// Ends a span of `probe` when destroyed.
+class Span {
+public:
+    explicit Span(Probe& probe) noexcept : probe_(enabled() ? &probe : nullptr) {
+        if (probe_) start_ = now_ns();
+    }
+    ~Span() {
+        if (probe_) probe_->record(start_, now_ns());
+    }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Probe* probe_;
+    std::uint64_t start_ = 0;
+};
+
+/// Percentiles cover the last one to two `window`s; 10 s by default.
+void set_window(std::chrono::milliseconds window) noexcept;
+
+/// Names the calling thread in exported traces.
+void set_thread_name(std::string name);
+
+/// Every probe that recorded a span in the window, by name.
+std::vector<Latency> latencies();
+
+/// The spans in every thread's ring as a Chrome trace event file
+/// ({"traceEvents": [...]}), with timestamps in microseconds from the
+/// earliest span.
+std::string chrome_json();
+
+/// Forgets all spans and counts.
+void reset();
+
+}  // namespace rebel::core::trace
+
+#define REBEL_TRACE_CAT2(a, b) a##b
+#define REBEL_TRACE_CAT(a, b) REBEL_TRACE_CAT2(a, b)
+
+#ifdef REBEL_TRACING
+/// Traces the rest of the enclosing scope as a span named `name`, a string
+/// literal.
+#define REBEL_TRACE_SCOPE(name)                                                             \
+    static ::rebel::core::trace::Probe REBEL_TRACE_CAT(rebel_trace_probe_, __LINE__){name}; \
+    const ::rebel::core::trace::Span REBEL_TRACE_CAT(rebel_trace_span_, __LINE__) {         \
+        REBEL_TRACE_CAT(rebel_trace_probe_, __LINE__)                                       \
+    }
+/// Declares probe `var` at namespace scope, for spans that start and end in
+/// different places (REBEL_TRACE_RECORD).
+#define REBEL_TRACE_PROBE(var, name) ::rebel::core::trace::Probe var{name}
+/// The start of a span to end later with REBEL_TRACE_RECORD; 0 when tracing
+/// is off or compiled out.
+#define REBEL_TRACE_NOW() (::rebel::core::trace::enabled() ? ::rebel::core::trace::now_ns() : std::uint64_t{0})
+/// Ends a span of probe `var` that started at `start`, a REBEL_TRACE_NOW().
+#define REBEL_TRACE_RECORD(var, start)                                                           \
+    do {                                                                                         \
+        const std::uint64_t rebel_trace_start = (start);                                         \
+        if (rebel_trace_start != 0) (var).record(rebel_trace_start, ::rebel::core::trace::now_ns()); \
+    } while (0)
+#else
+#define REBEL_TRACE_SCOPE(name) static_cast<void>(0)
+#define REBEL_TRACE_PROBE(var, name) static_assert(true, "")
+#define REBEL_TRACE_NOW() std::uint64_t{0}
+#define REBEL_TRACE_RECORD(var, start) static_cast<void>(start)
+#endif
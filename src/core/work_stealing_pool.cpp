@@ -0,0 +1,98 @@
+#include "core/work_stealing_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace rebel::core {
+namespace {
+
+struct CurrentWorker {
+    const WorkStealingPool* pool = nullptr;
+    std::size_t index = WorkStealingPool::kNotWorker;
+};
+thread_local CurrentWorker current;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(std::size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i <= threads; ++i) queues_.push_back(std::make_unique<Queue>());
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) workers_.emplace_back([this, i] { run(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    const std::size_t index = worker_index();
+    Queue& queue = index == kNotWorker ? *queues_.back() : *queues_[index];
+    // Counted first so that queued_ never drops below the tasks queued.
+    // Sleeping workers count themselves before checking queued_ (both
+    // sequentially consistent), so either they see this task or we see them.
+    queued_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    if (sleepers_.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        wake_.notify_one();
+    }
+}
+
+std::size_t WorkStealingPool::worker_index() const noexcept {
+    return current.pool == this ? current.index : kNotWorker;
+}
+
+void WorkStealingPool::run(std::size_t index) {
+    current = {this, index};
+    std::function<void()> task;
+    for (;;) {
+        if (take(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleepers_.fetch_add(1);
+        wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+        if (stopping_ && queued_.load() == 0) return;  // stopping and drained
+    }
+}
+
+// Own deque newest first, then the oldest task of the shared queue and of
+// the other workers in turn.
+bool WorkStealingPool::take(std::size_t index, std::function<void()>& task) {
+    {
+        Queue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    const std::size_t workers = queues_.size() - 1;
+    for (std::size_t k = 0; k < workers; ++k) {
+        Queue& other = *queues_[k == 0 ? workers : (index + k) % workers];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace rebel::core
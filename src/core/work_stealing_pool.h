@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rebel::core {
+
+/// Worker threads with a task deque each, for fork/join work.
+///
+/// A task submitted from a worker goes on that worker's own deque, which it
+/// drains newest first, so dependent work stays on a warm cache. Tasks from
+/// other threads go on a shared queue. A worker whose deque is empty takes
+/// the oldest task of the shared queue or of another worker. Unlike
+/// ThreadPool, no single lock is taken by every submit.
+///
+/// Tasks must not throw; an escaping exception terminates the process.
+class WorkStealingPool {
+public:
+    static constexpr std::size_t kNotWorker = ~std::size_t{0};
+
+    /// `threads == 0` uses one thread per hardware core.
+    explicit WorkStealingPool(std::size_t threads = 0);
+    /// Runs every queued task to completion, then joins the workers.
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(std::function<void()> task);
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    /// The calling thread's index among this pool's workers, in
+    /// [0, size()), or kNotWorker. Lets tasks use per-worker state.
+    std::size_t worker_index() const noexcept;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void run(std::size_t index);
+    bool take(std::size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;  // one per worker, then the shared queue
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> sleepers_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace rebel::core
@@ -0,0 +1,564 @@
+#include "dap/server.h"
+
+#include "dap/snapshot.h"
+#include "script/error.h"
+#include "script/object.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+namespace rebel::dap {
+namespace {
+
+using lsp::json::Writer;
+using script::Value;
+using script::ValueType;
+
+constexpr std::int64_t kThread = 1;
+constexpr std::size_t kPreviewItems = 5;
+
+std::string base64(std::string_view bytes) {
+    static constexpr char kDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((bytes.size() + 2) / 3 * 4);
+    std::size_t i = 0;
+    for (; i + 3 <= bytes.size(); i += 3) {
+        const std::uint32_t n = static_cast<std::uint8_t>(bytes[i]) << 16 | static_cast<std::uint8_t>(bytes[i + 1]) << 8 |
+                                static_cast<std::uint8_t>(bytes[i + 2]);
+        out += kDigits[n >> 18];
+        out += kDigits[n >> 12 & 63];
+        out += kDigits[n >> 6 & 63];
+        out += kDigits[n & 63];
+    }
+    if (i < bytes.size()) {
+        const bool two = i + 1 < bytes.size();
+        const std::uint32_t n = static_cast<std::uint8_t>(bytes[i]) << 16 |
+                                (two ? static_cast<std::uint8_t>(bytes[i + 1]) << 8 : 0);
+        out += kDigits[n >> 18];
+        out += kDigits[n >> 12 & 63];
+        out += two ? kDigits[n >> 6 & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// "5", ">= 5", "== 5": the number is all that counts.
+std::uint64_t hit_count(std::string_view condition) {
+    const std::size_t digit = condition.find_first_of("0123456789");
+    if (digit == std::string_view::npos) return 0;
+    return std::strtoull(std::string(condition.substr(digit)).c_str(), nullptr, 10);
+}
+
+// A string as a quoted, escaped literal, cut at `limit` bytes.
+void quote(std::string_view text, std::size_t limit, std::string& out) {
+    out += '"';
+    for (const char c : text.substr(0, limit)) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            default: out += c;
+        }
+    }
+    out += '"';
+    if (text.size() > limit) out += "… (" + std::to_string(text.size()) + " bytes)";
+}
+
+const char* state_name(const script::Task& task) {
+    switch (task.state) {
+        case script::Task::State::Pending: return "pending";
+        case script::Task::State::Done: return "done";
+        case script::Task::State::Failed: return "failed";
+    }
+    return "?";
+}
+
+}  // namespace
+
+Server::Server(script::VM& vm, Output output, Input input)
+    : vm_(vm), debugger_(vm), output_(std::move(output)), input_(std::move(input)) {
+    debugger_.set_handler([this](const script::Debugger::Stop& stop) { stopped(stop); });
+    debugger_.set_log_handler([this](int, std::string_view text) {
+        if (!attached_) {
+            vm_.print(text);
+            return;
+        }
+        Writer body;
+        body.begin_object().key("category").value("console").key("output").value(std::string(text) + "\n").end_object();
+        event("output", body.str());
+    });
+}
+
+void Server::handle(std::string_view body) {
+    try {
+        const lsp::json::Document message = lsp::json::Document::parse(std::string(body));
+        if (message.root()["type"].as_string() != "request") return;
+        try {
+            request(message.root());
+        } catch (const std::exception& e) {
+            fail(message.root(), e.what());
+        }
+    } catch (const lsp::json::ParseError&) {
+    }
+}
+
+void Server::request(const lsp::json::Value& message) {
+    const std::string_view command = message["command"].as_string();
+    const lsp::json::Value& args = message["arguments"];
+    Writer body;
+    if (command == "initialize") {
+        body.begin_object()
+            .key("supportsConfigurationDoneRequest").value(true)
+            .key("supportsConditionalBreakpoints").value(true)
+            .key("supportsHitConditionalBreakpoints").value(true)
+            .key("supportsLogPoints").value(true)
+            .key("supportsEvaluateForHovers").value(true)
+            .key("supportsDelayedStackTraceLoading").value(true)
+            .key("supportsInspectRequest").value(true)
+            .key("supportsHeapSnapshotRequest").value(true)
+            .end_object();
+        respond(message, body.str());
+        event("initialized");
+        return;
+    }
+    if (command == "launch" || command == "attach") {
+        attached_ = true;
+        stop_preview_ = args["stopPreview"].as_bool();
+        respond(message);
+        return;
+    }
+    if (command == "configurationDone") {
+        respond(message);
+        return;
+    }
+    if (command == "setBreakpoints") {
+        set_breakpoints(args, body);
+        respond(message, body.str());
+        return;
+    }
+    if (command == "threads") {
+        body.begin_object().key("threads").begin_array();
+        body.begin_object().key("id").value(kThread).key("name").value("script").end_object();
+        body.end_array().end_object();
+        respond(message, body.str());
+        return;
+    }
+    if (command == "disconnect") {
+        detach();
+        respond(message);
+        return;
+    }
+    if (command == "continue") {
+        if (!paused_) throw std::runtime_error("not stopped");
+        paused_ = false;
+        body.begin_object().key("allThreadsContinued").value(true).end_object();
+        respond(message, body.str());
+        return;
+    }
+
+    // Everything else inspects a stop.
+    const bool inspecting = command == "stackTrace" || command == "scopes" || command == "variables" ||
+                            command == "evaluate" || command == "inspect" || command == "heapSnapshot";
+    if (!inspecting) throw std::runtime_error("unsupported request '" + std::string(command) + "'");
+    if (!paused_) throw std::runtime_error("not stopped");
+    if (command == "stackTrace") {
+        const auto start = static_cast<std::size_t>(std::max<std::int64_t>(args["startFrame"].as_int(), 0));
+        const auto levels = static_cast<std::size_t>(std::max<std::int64_t>(args["levels"].as_int(), 0));
+        const std::size_t end = levels ? std::min(depth_, start + levels) : depth_;
+        body.begin_object().key("stackFrames").begin_array();
+        for (std::size_t level = start; level < end; ++level) frame(level, body);
+        body.end_array().key("totalFrames").value(static_cast<std::int64_t>(depth_)).end_object();
+    } else if (command == "scopes") {
+        body.begin_object().key("scopes");
+        scopes(frame_level(args["frameId"]), body, std::nullopt);
+        body.end_object();
+    } else if (command == "variables") {
+        Ref& target = ref(args["variablesReference"].as_int());
+        const std::string_view filter = args["filter"].as_string();
+        Ref::Filter wanted = filter == "indexed" ? Ref::Filter::Indexed
+                             : filter == "named" ? Ref::Filter::Named
+                                                 : target.filter;
+        std::optional<std::size_t> count;
+        if (args["count"].as_int() > 0) count = static_cast<std::size_t>(args["count"].as_int());
+        const auto start = static_cast<std::size_t>(std::max<std::int64_t>(args["start"].as_int(), 0));
+        // A filter narrows a reference for this request only.
+        const Ref::Filter saved = target.filter;
+        target.filter = wanted;
+        body.begin_object().key("variables");
+        variables(target, start, count, body);
+        body.end_object();
+        target.filter = saved;
+    } else if (command == "evaluate") {
+        evaluate(args, body);
+    } else if (command == "inspect") {
+        const std::int64_t levels = args["levels"].as_int(1);
+        const std::int64_t count = args["count"].as_int(static_cast<std::int64_t>(kPageSize));
+        inspect(levels > 0 ? static_cast<std::size_t>(levels) : depth_, static_cast<std::size_t>(std::max<std::int64_t>(count, 0)),
+                body);
+    } else {
+        heap_snapshot(args, body);
+    }
+    respond(message, body.str());
+}
+
+void Server::respond(const lsp::json::Value& request, std::string_view body) {
+    Writer message;
+    message.begin_object()
+        .key("seq").value(++seq_)
+        .key("type").value("response")
+        .key("request_seq").value(request["seq"].as_int())
+        .key("success").value(true)
+        .key("command").value(request["command"].as_string());
+    if (!body.empty()) message.key("body").raw(body);
+    message.end_object();
+    send(message);
+}
+
+void Server::fail(const lsp::json::Value& request, std::string_view error) {
+    Writer message;
+    message.begin_object()
+        .key("seq").value(++seq_)
+        .key("type").value("response")
+        .key("request_seq").value(request["seq"].as_int())
+        .key("success").value(false)
+        .key("command").value(request["command"].as_string())
+        .key("message").value(error)
+        .end_object();
+    send(message);
+}
+
+void Server::event(std::string_view name, std::string_view body) {
+    Writer message;
+    message.begin_object().key("seq").value(++seq_).key("type").value("event").key("event").value(name);
+    if (!body.empty()) message.key("body").raw(body);
+    message.end_object();
+    send(message);
+}
+
+void Server::send(Writer& message) { output_(message.str()); }
+
+void Server::stopped(const script::Debugger::Stop& stop) {
+    if (!attached_) return;
+    paused_ = true;
+    depth_ = debugger_.depth();
+    Writer body;
+    body.begin_object()
+        .key("reason").value("breakpoint")
+        .key("threadId").value(kThread)
+        .key("allThreadsStopped").value(true)
+        .key("hitBreakpointIds").begin_array().value(stop.breakpoint).end_array();
+    if (stop_preview_) {
+        body.key("preview");
+        inspect(1, kPageSize, body);
+    }
+    body.end_object();
+    event("stopped", body.str());
+
+    while (paused_) {
+        std::optional<std::string> message = input_();
+        if (!message) {
+            detach();
+            break;
+        }
+        handle(*message);
+    }
+    refs_.clear();
+    depth_ = 0;
+}
+
+void Server::detach() {
+    debugger_.clear_all();
+    breakpoints_.clear();
+    attached_ = false;
+    paused_ = false;
+}
+
+void Server::set_breakpoints(const lsp::json::Value& args, Writer& body) {
+    // Scripts are run with the source's path as their chunk name.
+    const lsp::json::Value& source = args["source"];
+    const std::string chunk(source["path"].as_string(source["name"].as_string()));
+    std::vector<int>& ids = breakpoints_[chunk];
+    for (const int id : ids) debugger_.clear_breakpoint(id);
+    ids.clear();
+
+    body.begin_object().key("breakpoints").begin_array();
+    for (const lsp::json::Value& wanted : args["breakpoints"]) {
+        const std::int64_t line = wanted["line"].as_int();
+        script::BreakpointOptions options;
+        options.condition = std::string(wanted["condition"].as_string());
+        options.hit_count = hit_count(wanted["hitCondition"].as_string());
+        options.log_message = std::string(wanted["logMessage"].as_string());
+        body.begin_object().key("line").value(line);
+        try {
+            if (line <= 0) throw script::CompileError("no such line");
+            const int id = debugger_.set_breakpoint(chunk, static_cast<std::uint32_t>(line), options);
+            ids.push_back(id);
+            body.key("id").value(id).key("verified").value(true);
+        } catch (const script::CompileError& e) {
+            body.key("verified").value(false).key("message").value(e.what());
+        }
+        body.end_object();
+    }
+    body.end_array().end_object();
+}
+
+void Server::frame(std::size_t level, Writer& out, std::optional<std::size_t> inline_count) {
+    const script::Debugger::Frame f = debugger_.frame(level);
+    const script::Function& fn = *f.function;
+    out.begin_object()
+        .key("id").value(static_cast<std::int64_t>(level + 1))
+        .key("name").value(fn.name == "main" ? std::string_view("main chunk") : std::string_view(fn.name))
+        .key("line").value(static_cast<std::int64_t>(f.line))
+        .key("column").value(1);
+    if (fn.chunk) out.key("source").begin_object().key("path").value(*fn.chunk).end_object();
+    if (inline_count) {
+        out.key("scopes");
+        scopes(level, out, inline_count);
+    }
+    out.end_object();
+}
+
+void Server::scopes(std::size_t level, Writer& out, std::optional<std::size_t> inline_count) {
+    const std::size_t locals = debugger_.frame(level).locals.size();
+    Ref frame_ref(Ref::Kind::Locals);
+    frame_ref.frame = level;
+    const std::int64_t locals_ref = add_ref(std::move(frame_ref));
+    out.begin_array();
+    out.begin_object()
+        .key("name").value("Locals")
+        .key("presentationHint").value("locals")
+        .key("variablesReference").value(locals_ref)
+        .key("namedVariables").value(static_cast<std::int64_t>(locals))
+        .key("expensive").value(false);
+    if (inline_count) {
+        out.key("variables");
+        variables(ref(locals_ref), 0, *inline_count, out);
+    }
+    out.end_object();
+    // Globals include every native, so they are left for the client to ask for.
+    out.begin_object()
+        .key("name").value("Globals")
+        .key("variablesReference").value(add_ref(Ref(Ref::Kind::Globals)))
+        .key("expensive").value(true)
+        .end_object();
+    out.end_array();
+}
+
+void Server::inspect(std::size_t levels, std::size_t count, Writer& body) {
+    body.begin_object().key("stackFrames").begin_array();
+    for (std::size_t level = 0; level < std::min(levels, depth_); ++level) frame(level, body, count);
+    body.end_array().key("totalFrames").value(static_cast<std::int64_t>(depth_)).end_object();
+}
+
+void Server::variables(Ref& target, std::size_t start, std::optional<std::size_t> count, Writer& out) {
+    start += target.offset;
+    const std::size_t limit = count.value_or(kPageSize);
+    bool more = false;
+    out.begin_array();
+    if (target.kind == Ref::Kind::Table) {
+        more = table_children(target, start, limit, [&](std::string_view name, const Value& v) { variable(name, v, out); });
+    } else {
+        std::vector<std::pair<std::string, Value>> all;
+        if (target.kind == Ref::Kind::Locals) {
+            all = debugger_.frame(target.frame).locals;
+        } else {
+            for (const auto& [name, v] : debugger_.globals()) all.emplace_back(std::string(name), v);
+        }
+        for (std::size_t i = start; i < all.size() && i < start + limit; ++i) variable(all[i].first, all[i].second, out);
+        more = start + limit < all.size();
+    }
+    if (more && !count) {
+        // The rest, for clients that do not page.
+        Ref rest(target.kind);
+        rest.frame = target.frame;
+        if (target.kind == Ref::Kind::Table) rest.table = script::VM::Handle(vm_, target.table.get());
+        rest.offset = start + limit;
+        rest.filter = target.filter;
+        rest.fields_seen = target.fields_seen;
+        rest.cursor = target.cursor;
+        out.begin_object()
+            .key("name").value("[more]")
+            .key("value").value("…")
+            .key("variablesReference").value(add_ref(std::move(rest)))
+            .end_object();
+    }
+    out.end_array();
+}
+
+template <typename Emit>
+bool Server::table_children(Ref& target, std::size_t start, std::size_t count, Emit&& emit) {
+    // No script runs while paging, so the table stays where it is.
+    const script::Table& table = *target.table.get().as_table();
+    const std::vector<Value>& array = table.array();
+    std::size_t emitted = 0;
+    if (target.filter != Ref::Filter::Named) {
+        for (std::size_t i = start; i < array.size() && emitted < count; ++i, ++emitted) emit(std::to_string(i), array[i]);
+        if (target.filter == Ref::Filter::Indexed || start + emitted < array.size()) return start + emitted < array.size();
+        start = start > array.size() ? start - array.size() : 0;
+    }
+
+    // Fields, from where the last page left off when that is not past `start`.
+    std::size_t seen = 0;
+    std::size_t cursor = array.size();
+    if (target.fields_seen <= start && target.cursor >= array.size()) {
+        seen = target.fields_seen;
+        cursor = target.cursor;
+    }
+    Value key, item;
+    while (seen < start && table.next(cursor, key, item)) ++seen;
+    std::string name;
+    while (emitted < count && table.next(cursor, key, item)) {
+        ++seen;
+        ++emitted;
+        name.clear();
+        if (key.is_string()) {
+            name = key.as_string()->view();
+        } else {
+            name = "[";
+            preview(key, name, true);
+            name += "]";
+        }
+        emit(name, item);
+    }
+    target.fields_seen = seen;
+    target.cursor = cursor;
+    return table.next(cursor, key, item);
+}
+
+void Server::evaluate(const lsp::json::Value& args, Writer& body) {
+    const std::size_t level = args.find("frameId") ? frame_level(args["frameId"]) : 0;
+    const Value result = debugger_.evaluate(level, args["expression"].as_string());
+    // The expression may have changed any table: page from the start again.
+    for (Ref& r : refs_) {
+        r.fields_seen = 0;
+        r.cursor = 0;
+    }
+    std::string text;
+    preview(result, text, false);
+    body.begin_object().key("result").value(text);
+    value_fields(result, body);
+    body.end_object();
+}
+
+void Server::heap_snapshot(const lsp::json::Value& args, Writer& body) {
+    Value root;
+    if (args.find("expression")) {
+        const std::size_t level = args.find("frameId") ? frame_level(args["frameId"]) : 0;
+        root = debugger_.evaluate(level, args["expression"].as_string());
+    } else {
+        const Ref& target = ref(args["variablesReference"].as_int());
+        if (target.kind != Ref::Kind::Table) throw std::runtime_error("heapSnapshot needs a table's variablesReference");
+        root = target.table.get();
+    }
+    SnapshotOptions options;
+    options.start = static_cast<std::size_t>(std::max<std::int64_t>(args["start"].as_int(), 0));
+    if (args["count"].as_int() > 0) options.count = static_cast<std::size_t>(args["count"].as_int());
+    if (args["maxBytes"].as_int() > 0) options.max_bytes = static_cast<std::size_t>(args["maxBytes"].as_int());
+    const Snapshot snap = snapshot(root, options);
+    body.begin_object()
+        .key("encoding").value("base64")
+        .key("data").value(base64(snap.bytes))
+        .key("bytes").value(static_cast<std::int64_t>(snap.bytes.size()))
+        .key("tables").value(static_cast<std::int64_t>(snap.tables))
+        .key("elided").value(static_cast<std::int64_t>(snap.elided))
+        .key("strings").value(static_cast<std::int64_t>(snap.strings))
+        .end_object();
+}
+
+void Server::variable(std::string_view name, const Value& value, Writer& out) {
+    std::string text;
+    preview(value, text, false);
+    out.begin_object().key("name").value(name).key("value").value(text);
+    value_fields(value, out);
+    out.end_object();
+}
+
+void Server::value_fields(const Value& value, Writer& out) {
+    out.key("type").value(script::type_name(value.type()));
+    if (!value.is_table()) {
+        out.key("variablesReference").value(0);
+        return;
+    }
+    Ref table(Ref::Kind::Table);
+    table.table = script::VM::Handle(vm_, value);
+    out.key("variablesReference").value(add_ref(std::move(table)));
+    if (const std::size_t length = value.as_table()->length()) {
+        out.key("indexedVariables").value(static_cast<std::int64_t>(length));
+    }
+}
+
+void Server::preview(const Value& value, std::string& out, bool nested) const {
+    switch (value.type()) {
+        case ValueType::String: quote(value.as_string()->view(), nested ? 32 : kMaxPreview, out); return;
+        case ValueType::Task: out += std::string("task (") + state_name(*value.as_task()) + ")"; return;
+        case ValueType::Function: out += "function " + value.as_function()->name; return;
+        case ValueType::Native: out += "native " + value.as_native()->name; return;
+        case ValueType::Table: break;
+        default: out += vm_.to_display_string(value); return;
+    }
+    const script::Table& table = *value.as_table();
+    const std::vector<Value>& array = table.array();
+    std::size_t cursor = array.size();
+    Value key, item;
+    const bool has_fields = table.next(cursor, key, item);
+    if (nested) {
+        out += array.empty() && !has_fields ? "{}" : array.empty() ? "{…}" : "[…]";
+        return;
+    }
+    if (!array.empty() || !has_fields) {
+        out += '[';
+        for (std::size_t i = 0; i < array.size() && i < kPreviewItems; ++i) {
+            if (i) out += ", ";
+            preview(array[i], out, true);
+        }
+        if (array.size() > kPreviewItems) out += ", …";
+        out += ']';
+        if (array.size() > kPreviewItems) out += " (" + std::to_string(array.size()) + ")";
+    }
+    if (has_fields) {
+        if (!array.empty()) out += ' ';
+        out += '{';
+        cursor = array.size();
+        for (std::size_t n = 0; table.next(cursor, key, item); ++n) {
+            if (n == kPreviewItems) {
+                out += ", …";
+                break;
+            }
+            if (n) out += ", ";
+            if (key.is_string()) {
+                out += key.as_string()->view();
+            } else {
+                out += '[';
+                preview(key, out, true);
+                out += ']';
+            }
+            out += ": ";
+            preview(item, out, true);
+        }
+        out += '}';
+    }
+}
+
+std::int64_t Server::add_ref(Ref ref) {
+    refs_.push_back(std::move(ref));
+    return static_cast<std::int64_t>(refs_.size());
+}
+
+Server::Ref& Server::ref(std::int64_t reference) {
+    if (reference <= 0 || static_cast<std::size_t>(reference) > refs_.size()) {
+        throw std::runtime_error("unknown variablesReference " + std::to_string(reference));
+    }
+    return refs_[static_cast<std::size_t>(reference - 1)];
+}
+
+std::size_t Server::frame_level(const lsp::json::Value& frame_id) const {
+    const std::int64_t id = frame_id.as_int();
+    if (id <= 0 || static_cast<std::size_t>(id) > depth_) throw std::runtime_error("unknown frameId " + std::to_string(id));
+    return static_cast<std::size_t>(id - 1);
+}
+
+}  // namespace rebel::dap
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "lsp/json.h"
+#include "script/debugger.h"
+#include "script/vm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::dap {
+
+/// Debug Adapter Protocol server for one script VM, built on
+/// script::Debugger. It speaks the protocol's messages; a transport such
+/// as dap::Session carries them.
+///
+/// Inspection is shaped for slow links, where round trips and bytes cost
+/// more than work on either end:
+///
+/// - Tables expand lazily, a page at a time. Array items are indexed
+///   variables and fields named ones, and variables requests honour
+///   `start` and `count`. Paging fields resumes from the previous page's
+///   position, so walking a table with a million fields costs the same per
+///   page at the end as at the start. A request without `count` gets at
+///   most kPageSize variables and, if more remain, a "[more]" entry that
+///   expands to the next page, so clients that never page still do.
+/// - Values are summarized in a line: a few items of a table, strings cut
+///   to kMaxPreview bytes.
+/// - The custom `inspect` request answers the stackTrace, scopes and first
+///   variables page of any number of frames in one response. Clients that
+///   pass `"stopPreview": true` to launch or attach get the same for the
+///   innermost frame inside each stopped event, and need no request at all
+///   to show where a stop happened.
+/// - The custom `heapSnapshot` request returns a table, or a slice of it,
+///   and everything it reaches in the binary form of dap/snapshot.h,
+///   base64-encoded: the whole structure in one response, at a fraction
+///   of the size of the equivalent variables responses.
+///
+/// Breakpoints take conditions, hit counts and log messages. Stepping and
+/// pausing are not supported; those requests fail.
+///
+/// Everything runs on the VM's thread. While the VM runs, the host passes
+/// incoming messages to handle(). At a stop, the debugger's handler reads
+/// them itself from `input`, blocking, until the client continues or
+/// disconnects.
+class Server {
+public:
+    /// Receives each message body to send.
+    using Output = std::function<void(std::string_view body)>;
+    /// The next message body, blocking; nullopt once the client is gone.
+    using Input = std::function<std::optional<std::string>()>;
+
+    static constexpr std::size_t kPageSize = 100;
+    static constexpr std::size_t kMaxPreview = 1024;
+
+    /// Attaches a debugger to `vm`, which must outlive the server.
+    Server(script::VM& vm, Output output, Input input);
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /// Handles one message from the client. Malformed messages are
+    /// dropped; failed requests are answered with an error.
+    void handle(std::string_view body);
+
+    /// Whether the client has attached and not disconnected.
+    bool attached() const noexcept { return attached_; }
+    script::Debugger& debugger() noexcept { return debugger_; }
+
+private:
+    // A variablesReference: what expanding it shows. Valid while stopped.
+    struct Ref {
+        enum class Kind : std::uint8_t { Locals, Globals, Table };
+        enum class Filter : std::uint8_t { All, Indexed, Named };
+        explicit Ref(Kind k) : kind(k) {}
+        Kind kind;
+        std::size_t frame = 0;     // Locals
+        script::VM::Handle table;  // Table
+        // Set for a "[more]" entry: its page starts here, of these children.
+        std::size_t offset = 0;
+        Filter filter = Filter::All;
+        // Where the last page of fields ended, to start the next one there.
+        std::size_t fields_seen = 0;
+        std::size_t cursor = 0;
+    };
+
+    void request(const lsp::json::Value& message);
+    void respond(const lsp::json::Value& request, std::string_view body = {});
+    void fail(const lsp::json::Value& request, std::string_view error);
+    void event(std::string_view name, std::string_view body = {});
+    void send(lsp::json::Writer& message);
+
+    void stopped(const script::Debugger::Stop& stop);
+    void detach();
+    void set_breakpoints(const lsp::json::Value& args, lsp::json::Writer& body);
+    /// A StackFrame; with `inline_count`, also its scopes, each with its
+    /// first page of variables, as the inspect request returns them.
+    void frame(std::size_t level, lsp::json::Writer& out, std::optional<std::size_t> inline_count = std::nullopt);
+    void scopes(std::size_t level, lsp::json::Writer& out, std::optional<std::size_t> inline_count);
+    void inspect(std::size_t levels, std::size_t count, lsp::json::Writer& body);
+    /// The array of a variables response.
+    void variables(Ref& ref, std::size_t start, std::optional<std::size_t> count, lsp::json::Writer& out);
+    /// Calls `emit(name, value)` for up to `count` children of a table
+    /// from `start`; returns whether more follow.
+    template <typename Emit>
+    bool table_children(Ref& ref, std::size_t start, std::size_t count, Emit&& emit);
+    void evaluate(const lsp::json::Value& args, lsp::json::Writer& body);
+    void heap_snapshot(const lsp::json::Value& args, lsp::json::Writer& body);
+
+    void variable(std::string_view name, const script::Value& value, lsp::json::Writer& out);
+    /// The type, variablesReference and child counts of a Variable or an
+    /// evaluate response.
+    void value_fields(const script::Value& value, lsp::json::Writer& out);
+    void preview(const script::Value& value, std::string& out, bool nested) const;
+    std::int64_t add_ref(Ref ref);
+    Ref& ref(std::int64_t reference);
+    std::size_t frame_level(const lsp::json::Value& frame_id) const;
+
+    script::VM& vm_;
+    script::Debugger debugger_;
+    Output output_;
+    Input input_;
+    std::int64_t seq_ = 0;
+    bool attached_ = false;
+    bool stop_preview_ = false;
+    bool paused_ = false;
+    std::size_t depth_ = 0;  // frames when stopped
+    std::deque<Ref> refs_;  // reference n is refs_[n - 1]; cleared on resume
+    // Breakpoint ids by chunk, as the client set them last.
+    std::unordered_map<std::string, std::vector<int>> breakpoints_;
+};
+
+}  // namespace rebel::dap
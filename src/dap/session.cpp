@@ -0,0 +1,124 @@
+#include "dap/session.h"
+
+#include "lsp/transport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+namespace rebel::dap {
+namespace {
+
+[[noreturn]] void fail(const char* what) { throw std::system_error(errno, std::generic_category(), what); }
+
+}  // namespace
+
+Session::Session(int fd) : fd_(fd) {
+    const int one = 1;
+    // Responses are small and each one is waited for.
+    ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    reader_ = std::thread([this] { read_loop(); });
+}
+
+Session::~Session() {
+    ::shutdown(fd_, SHUT_RDWR);
+    reader_.join();
+    ::close(fd_);
+}
+
+void Session::read_loop() {
+    lsp::MessageReader reader([this](char* data, std::size_t size) -> std::size_t {
+        for (;;) {
+            const ssize_t count = ::recv(fd_, data, size, 0);
+            if (count >= 0) return static_cast<std::size_t>(count);
+            if (errno != EINTR) return 0;  // a reset connection ends like a closed one
+        }
+    });
+    try {
+        while (std::optional<std::string> body = reader.next()) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(*body));
+            ready_.notify_one();
+        }
+    } catch (const std::exception&) {
+        // A malformed header: nothing after it can be framed.
+    }
+    const std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    ready_.notify_all();
+}
+
+std::optional<std::string> Session::next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return !queue_.empty() || closed_; });
+    if (queue_.empty()) return std::nullopt;
+    std::string body = std::move(queue_.front());
+    queue_.pop_front();
+    return body;
+}
+
+std::optional<std::string> Session::try_next() {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) return std::nullopt;
+    std::string body = std::move(queue_.front());
+    queue_.pop_front();
+    return body;
+}
+
+void Session::send(std::string_view body) {
+#ifdef MSG_NOSIGNAL
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+    const std::string message = lsp::frame(body);
+    std::string_view rest = message;
+    while (!rest.empty()) {
+        const ssize_t count = ::send(fd_, rest.data(), rest.size(), flags);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            fail("send");
+        }
+        rest.remove_prefix(static_cast<std::size_t>(count));
+    }
+}
+
+Listener::Listener(const std::string& host, std::uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "listen on '" + host + "'");
+    }
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) fail("socket");
+    const int one = 1;
+    ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    socklen_t length = sizeof address;
+    if (::bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0 || ::listen(fd_, 4) != 0 ||
+        ::getsockname(fd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        const int error = errno;
+        ::close(fd_);
+        throw std::system_error(error, std::generic_category(), "listen");
+    }
+    port_ = ntohs(address.sin_port);
+}
+
+Listener::~Listener() { ::close(fd_); }
+
+std::unique_ptr<Session> Listener::accept() {
+    for (;;) {
+        const int fd = ::accept(fd_, nullptr, nullptr);
+        if (fd >= 0) return std::unique_ptr<Session>(new Session(fd));
+        if (errno != EINTR) fail("accept");
+    }
+}
+
+}  // namespace rebel::dap
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace rebel::dap {
+
+/// One debugger client connected over TCP. A reader thread frames incoming
+/// messages (lsp::MessageReader: DAP uses the same headers) and queues
+/// them, so the VM's thread only ever takes whole messages: between script
+/// calls with try_next(), and blocking with next() at a stop. These fit
+/// dap::Server's handle() and Input.
+class Session {
+public:
+    /// Shuts the connection down and joins the reader.
+    ~Session();
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /// The next message body, blocking; nullopt once the client has gone
+    /// and every message it sent has been taken.
+    std::optional<std::string> next();
+    /// The next message body if one has arrived.
+    std::optional<std::string> try_next();
+    /// Frames and sends `body`. Throws std::system_error; a client that has
+    /// gone away raises no signal.
+    void send(std::string_view body);
+
+private:
+    friend class Listener;
+    explicit Session(int fd);
+    void read_loop();
+
+    int fd_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::string> queue_;
+    bool closed_ = false;
+    std::thread reader_;
+};
+
+/// A listening TCP socket for debugger clients.
+class Listener {
+public:
+    /// Listens on `host` (an IPv4 address) and `port`, 0 for any free one.
+    /// Throws std::system_error.
+    Listener(const std::string& host, std::uint16_t port);
+    ~Listener();
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    /// The port listened on.
+    std::uint16_t port() const noexcept { return port_; }
+    /// Blocks for the next client. Throws std::system_error.
+    std::unique_ptr<Session> accept();
+
+private:
+    int fd_ = -1;
+    std::uint16_t port_ = 0;
+};
+
+}  // namespace rebel::dap
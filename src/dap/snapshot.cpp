@@ -0,0 +1,163 @@
+#include "dap/snapshot.h"
+
+#include "script/object.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::dap {
+namespace {
+
+using script::Table;
+using script::Value;
+using script::ValueType;
+
+enum Tag : std::uint8_t {
+    kNil,
+    kFalse,
+    kTrue,
+    kInteger,
+    kNumber,
+    kNewString,
+    kString,
+    kTable,
+    kFunction,
+    kNative,
+    kTask,
+};
+
+constexpr double kMaxExact = 9007199254740992.0;  // 2^53
+
+class Encoder {
+public:
+    explicit Encoder(const SnapshotOptions& options) : options_(options) { out_.bytes = "RHS1"; }
+
+    Snapshot run(const Value& root) {
+        value(root);
+        for (std::size_t i = 0; i < queue_.size(); ++i) {
+            const Table& table = *queue_[i];
+            if (out_.bytes.size() > options_.max_bytes) {
+                u8(1);
+                varint(table.length());
+                varint(fields(table));
+                ++out_.elided;
+            } else if (i == 0 && root.is_table()) {
+                body(table, options_.start, options_.count);
+            } else {
+                body(table, 0, std::numeric_limits<std::size_t>::max());
+            }
+        }
+        out_.tables = queue_.size() - out_.elided;
+        out_.strings = strings_.size();
+        return std::move(out_);
+    }
+
+private:
+    void u8(std::uint8_t v) { out_.bytes.push_back(static_cast<char>(v)); }
+    void varint(std::uint64_t v) {
+        for (; v >= 0x80; v >>= 7) out_.bytes.push_back(static_cast<char>(v | 0x80));
+        out_.bytes.push_back(static_cast<char>(v));
+    }
+
+    static std::size_t fields(const Table& table) {
+        std::size_t n = 0;
+        std::size_t cursor = table.length();
+        Value key, value;
+        while (table.next(cursor, key, value)) ++n;
+        return n;
+    }
+
+    // Entries [start, start + count) of `table`, array items first.
+    void body(const Table& table, std::size_t start, std::size_t count) {
+        const std::vector<Value>& array = table.array();
+        const std::size_t first = std::min(start, array.size());
+        const std::size_t items = std::min(count, array.size() - first);
+        u8(0);
+        varint(first);
+        varint(items);
+        for (std::size_t i = first; i < first + items; ++i) value(array[i]);
+
+        // Fields: skip those before the slice, then count and write the rest.
+        std::size_t skip = start > array.size() ? start - array.size() : 0;
+        const std::size_t wanted = count - items;
+        std::size_t cursor = array.size();
+        Value key, item;
+        while (skip > 0 && table.next(cursor, key, item)) --skip;
+        const std::size_t from = cursor;
+        std::size_t n = 0;
+        while (n < wanted && table.next(cursor, key, item)) ++n;
+        varint(n);
+        cursor = from;
+        for (std::size_t i = 0; i < n && table.next(cursor, key, item); ++i) {
+            value(key);
+            value(item);
+        }
+    }
+
+    void string(std::string_view text) {
+        const auto [it, added] = strings_.try_emplace(text, strings_.size());
+        if (!added) {
+            u8(kString);
+            varint(it->second);
+            return;
+        }
+        u8(kNewString);
+        varint(text.size());
+        out_.bytes.append(text);
+    }
+
+    void value(const Value& v) {
+        switch (v.type()) {
+            case ValueType::Nil: u8(kNil); return;
+            case ValueType::Bool: u8(v.as_bool() ? kTrue : kFalse); return;
+            case ValueType::Number: {
+                const double d = v.as_number();
+                if (d == std::trunc(d) && std::fabs(d) <= kMaxExact && !(d == 0 && std::signbit(d))) {
+                    const auto i = static_cast<std::int64_t>(d);
+                    u8(kInteger);
+                    varint((static_cast<std::uint64_t>(i) << 1) ^ static_cast<std::uint64_t>(i >> 63));
+                } else {
+                    u8(kNumber);
+                    char bytes[sizeof d];
+                    std::memcpy(bytes, &d, sizeof d);
+                    out_.bytes.append(bytes, sizeof bytes);
+                }
+                return;
+            }
+            case ValueType::String: string(v.as_string()->view()); return;
+            case ValueType::Table: {
+                const auto [it, added] = tables_.try_emplace(v.as_table(), queue_.size());
+                if (added) queue_.push_back(v.as_table());
+                u8(kTable);
+                varint(it->second);
+                return;
+            }
+            case ValueType::Function:
+                u8(kFunction);
+                string(v.as_function()->name);
+                return;
+            case ValueType::Native:
+                u8(kNative);
+                string(v.as_native()->name);
+                return;
+            case ValueType::Task: u8(kTask); return;
+        }
+    }
+
+    const SnapshotOptions& options_;
+    Snapshot out_;
+    std::unordered_map<std::string_view, std::size_t> strings_;  // views of live strings
+    std::unordered_map<const Table*, std::size_t> tables_;
+    std::vector<const Table*> queue_;  // by index; bodies are written in this order
+};
+
+}  // namespace
+
+Snapshot snapshot(const script::Value& root, const SnapshotOptions& options) { return Encoder(options).run(root); }
+
+}  // namespace rebel::dap
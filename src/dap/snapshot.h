@@ -0,0 +1,54 @@
+#pragma once
+
+// Heap snapshots: a script value and everything it reaches, in a compact
+// binary form for debuggers to fetch in one response instead of paging
+// through variables requests.
+//
+//   snapshot := "RHS1" root:value body*          one body per table, in order
+//   value    := tag:u8 payload
+//       0 nil | 1 false | 2 true
+//       3 integer    zigzag:varint                whole numbers up to 2^53
+//       4 number     f64
+//       5 string     length:varint bytes          numbered in order of appearance
+//       6 string     index:varint                 one seen before
+//       7 table      index:varint                 numbered in order of first reference
+//       8 function   name:value                   a string (5 or 6)
+//       9 native     name:value
+//      10 task
+//   body     := 0:u8 first:varint array:varint value* hash:varint (key:value value)*
+//             | 1:u8 array:varint hash:varint    elided: over the byte limit
+//
+// Integers are little-endian and varints LEB128. The root, if a table, is
+// table 0; `first` is the index of its first array item written, which is
+// 0 for every other table. Shared and cyclic references are kept.
+
+#include "script/value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace rebel::dap {
+
+struct SnapshotOptions {
+    /// A slice of the root table: its entries [start, start + count), array
+    /// items (nil ones included) first and then fields in iteration order.
+    std::size_t start = 0;
+    std::size_t count = std::numeric_limits<std::size_t>::max();
+    /// Tables reached once the snapshot has grown past this many bytes are
+    /// elided. Checked between tables, so one large table can overshoot it.
+    std::size_t max_bytes = std::size_t{16} << 20;
+};
+
+struct Snapshot {
+    std::string bytes;
+    std::size_t tables = 0;   // written in full
+    std::size_t elided = 0;   // tables past the limit
+    std::size_t strings = 0;  // distinct
+};
+
+/// Encodes `root`. Runs no script code, so values stay put meanwhile.
+Snapshot snapshot(const script::Value& root, const SnapshotOptions& options = {});
+
+}  // namespace rebel::dap
@@ -0,0 +1,301 @@
+#include "index/symbol_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+namespace rebel::index {
+
+static_assert(std::is_trivially_copyable_v<format::Header> && sizeof(format::Header) == 96);
+static_assert(sizeof(format::FileRecord) == 40);
+static_assert(sizeof(format::SymbolRecord) == 16);
+static_assert(sizeof(format::NameRecord) == 24);
+
+namespace {
+
+constexpr std::uint64_t align8(std::uint64_t n) { return (n + 7) & ~std::uint64_t{7}; }
+
+const std::uint32_t* by_name(const format::Header& h, const char* base) {
+    return reinterpret_cast<const std::uint32_t*>(base + h.by_name);
+}
+
+// Whether the file and name records stay inside the sections they point
+// into. Symbols and by_name entries, most of the file, are checked where
+// they are read instead.
+bool records_valid(const format::Header& h, const char* base) {
+    const auto* files = reinterpret_cast<const format::FileRecord*>(base + h.files);
+    for (std::uint64_t i = 0; i < h.file_count; ++i) {
+        const format::FileRecord& f = files[i];
+        if (std::uint64_t{f.path} + f.path_length > h.strings_bytes ||
+            std::uint64_t{f.first} + f.count > h.symbol_count) {
+            return false;
+        }
+    }
+    const auto* names = reinterpret_cast<const format::NameRecord*>(base + h.names);
+    for (std::uint64_t i = 0; i < h.name_count; ++i) {
+        const format::NameRecord& n = names[i];
+        if (std::uint64_t{n.text} + n.length > h.strings_bytes || n.definitions > n.count ||
+            std::uint64_t{n.first} + n.count > h.symbol_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+std::shared_ptr<const SymbolIndex> SymbolIndex::open(const std::string& path) {
+    auto file = core::MappedFile::open(path);
+    if (file->size() < sizeof(format::Header) ||
+        std::memcmp(file->data(), format::kMagic, sizeof format::kMagic) != 0) {
+        throw std::runtime_error(path + " is not a symbol index");
+    }
+    format::Header h;
+    std::memcpy(&h, file->data(), sizeof h);
+    if (h.version != kVersion || h.header_bytes != sizeof h) {
+        throw std::runtime_error(path + ": unsupported symbol index version");
+    }
+    auto within = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t size) {
+        return offset % 8 == 0 && offset <= file->size() && count <= (file->size() - offset) / size;
+    };
+    if (h.total_bytes != file->size() || !within(h.files, h.file_count, sizeof(format::FileRecord)) ||
+        !within(h.symbols, h.symbol_count, sizeof(format::SymbolRecord)) ||
+        !within(h.names, h.name_count, sizeof(format::NameRecord)) ||
+        !within(h.by_name, h.symbol_count, sizeof(std::uint32_t)) || !within(h.strings, h.strings_bytes, 1)) {
+        throw std::runtime_error(path + ": truncated symbol index");
+    }
+    if (!records_valid(h, file->data())) throw std::runtime_error(path + ": corrupt symbol index");
+    return std::shared_ptr<const SymbolIndex>(new SymbolIndex(std::move(file)));
+}
+
+std::optional<std::uint32_t> SymbolIndex::name_id(std::string_view name) const {
+    const format::NameRecord* n = find_name(name);
+    if (!n) return std::nullopt;
+    return static_cast<std::uint32_t>(n - names());
+}
+
+const format::NameRecord* SymbolIndex::find_name(std::string_view name) const {
+    const format::NameRecord* first = names();
+    const format::NameRecord* last = first + name_count();
+    const auto* it = std::lower_bound(first, last, name, [this](const format::NameRecord& n, std::string_view key) {
+        return string(n.text, n.length) < key;
+    });
+    return it != last && string(it->text, it->length) == name ? it : nullptr;
+}
+
+std::vector<Location> SymbolIndex::locations(std::string_view name, bool definitions) const {
+    std::vector<Location> out;
+    const format::NameRecord* n = find_name(name);
+    if (!n) return out;
+    const std::uint32_t* order = by_name(header(), file_->data());
+    const std::uint32_t begin = definitions ? n->first : n->first + n->definitions;
+    const std::uint32_t end = definitions ? n->first + n->definitions : n->first + n->count;
+    out.reserve(end - begin);
+    for (std::uint32_t i = begin; i < end; ++i) {
+        if (order[i] >= symbol_count()) continue;  // corrupt
+        const format::SymbolRecord& s = symbols()[order[i]];
+        if (s.file >= file_count()) continue;
+        out.push_back({path(s.file), s.line, s.column(), s.kind()});
+    }
+    return out;
+}
+
+std::vector<Location> SymbolIndex::definitions(std::string_view name) const { return locations(name, true); }
+
+std::vector<Location> SymbolIndex::references(std::string_view name) const { return locations(name, false); }
+
+std::vector<std::string_view> SymbolIndex::complete(std::string_view prefix, std::size_t limit) const {
+    std::vector<std::string_view> out;
+    const format::NameRecord* first = names();
+    const format::NameRecord* last = first + name_count();
+    auto it = std::lower_bound(first, last, prefix, [this](const format::NameRecord& n, std::string_view key) {
+        return string(n.text, n.length) < key;
+    });
+    for (; it != last && out.size() < limit; ++it) {
+        const std::string_view name = string(it->text, it->length);
+        if (name.compare(0, prefix.size(), prefix) != 0) break;
+        out.push_back(name);
+    }
+    return out;
+}
+
+std::optional<std::size_t> SymbolIndex::find_file(std::string_view path) const {
+    const format::FileRecord* first = files();
+    const format::FileRecord* last = first + file_count();
+    const auto* it = std::lower_bound(first, last, path, [this](const format::FileRecord& f, std::string_view key) {
+        return string(f.path, f.path_length) < key;
+    });
+    if (it == last || string(it->path, it->path_length) != path) return std::nullopt;
+    return static_cast<std::size_t>(it - first);
+}
+
+std::size_t write_index(const std::string& path, std::vector<IndexedFile>& files) {
+    std::sort(files.begin(), files.end(), [](const IndexedFile& a, const IndexedFile& b) { return a.path < b.path; });
+
+    // Name numbers. Names of the index the reused files come from keep
+    // their numbers there, which are already in order, so reused symbols
+    // are copied as they are; other names are numbered after them. The
+    // final order is then a merge rather than a sort of every name.
+    std::shared_ptr<const SymbolIndex> base;
+    for (const IndexedFile& file : files) {
+        if (file.source) {
+            base = file.source;
+            break;
+        }
+    }
+    const std::uint32_t base_names = base ? static_cast<std::uint32_t>(base->name_count()) : 0;
+    std::unordered_map<std::string_view, std::uint32_t> extra_ids;
+    std::vector<std::string_view> extra;
+    auto intern = [&](std::string_view name) {
+        if (base) {
+            if (const auto id = base->name_id(name)) return *id;
+        }
+        const auto [it, fresh] = extra_ids.try_emplace(name, static_cast<std::uint32_t>(base_names + extra.size()));
+        if (fresh) extra.push_back(name);
+        return it->second;
+    };
+    auto name_of = [&](std::uint32_t id) { return id < base_names ? base->name(id) : extra[id - base_names]; };
+    std::unordered_map<const SymbolIndex*, std::vector<std::uint32_t>> remaps;  // other sources
+    constexpr std::uint32_t kUnmapped = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<format::FileRecord> records(files.size());
+    std::vector<format::SymbolRecord> symbols;
+    std::vector<std::uint32_t> local;
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        IndexedFile& file = files[f];
+        format::FileRecord& record = records[f];
+        record = {file.mtime, file.size, file.hash, 0, static_cast<std::uint32_t>(file.path.size()),
+                  static_cast<std::uint32_t>(symbols.size()), 0};
+        if (file.source) {
+            const SymbolIndex& source = *file.source;
+            std::vector<std::uint32_t>* remap = nullptr;
+            if (&source != base.get()) {
+                remap = &remaps[&source];
+                if (remap->empty()) remap->assign(source.name_count(), kUnmapped);
+            }
+            const format::FileRecord& old = source.file(file.source_file);
+            for (std::uint32_t i = 0; i < old.count; ++i) {
+                format::SymbolRecord s = source.symbols()[old.first + i];
+                if (s.name >= source.name_count()) continue;  // corrupt; dropped
+                if (remap) {
+                    if ((*remap)[s.name] == kUnmapped) (*remap)[s.name] = intern(source.name(s.name));
+                    s.name = (*remap)[s.name];
+                }
+                s.file = static_cast<std::uint32_t>(f);
+                symbols.push_back(s);
+            }
+        } else {
+            local.clear();
+            for (const std::string& name : file.names) local.push_back(intern(name));
+            for (format::SymbolRecord s : file.symbols) {
+                s.name = local[s.name];
+                s.file = static_cast<std::uint32_t>(f);
+                symbols.push_back(s);
+            }
+        }
+        record.count = static_cast<std::uint32_t>(symbols.size() - record.first);
+    }
+    if (symbols.size() > std::numeric_limits<std::uint32_t>::max()) throw std::runtime_error("symbol index too large");
+
+    // Names in order, so lookups and completion are binary searches. Names
+    // no file uses any more are dropped here.
+    const std::size_t name_total = base_names + extra.size();
+    std::vector<bool> used(name_total);
+    for (const format::SymbolRecord& s : symbols) used[s.name] = true;
+    std::vector<std::uint32_t> added(extra.size());
+    for (std::uint32_t i = 0; i < added.size(); ++i) added[i] = base_names + i;
+    std::sort(added.begin(), added.end(), [&](std::uint32_t a, std::uint32_t b) { return name_of(a) < name_of(b); });
+    std::vector<std::uint32_t> order;
+    order.reserve(name_total);
+    std::uint32_t next_base = 0;
+    for (std::size_t next_added = 0; next_base < base_names || next_added < added.size();) {
+        const bool take_base = next_added == added.size() ||
+                               (next_base < base_names && name_of(next_base) < name_of(added[next_added]));
+        const std::uint32_t id = take_base ? next_base++ : added[next_added++];
+        if (used[id]) order.push_back(id);
+    }
+    std::vector<std::uint32_t> rank(name_total);
+    for (std::uint32_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+    for (format::SymbolRecord& s : symbols) s.name = rank[s.name];
+
+    std::string strings;
+    std::vector<format::NameRecord> name_records(order.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) {
+        const std::string_view name = name_of(order[i]);
+        name_records[i] = {static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(name.size()), 0, 0, 0, 0};
+        strings.append(name);
+    }
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        records[f].path = static_cast<std::uint32_t>(strings.size());
+        strings.append(files[f].path);
+    }
+    if (strings.size() > std::numeric_limits<std::uint32_t>::max()) throw std::runtime_error("symbol index too large");
+
+    // Group symbols by name with a counting sort: definitions first, and
+    // file order (so file and line order) within each group.
+    for (const format::SymbolRecord& s : symbols) {
+        ++name_records[s.name].count;
+        if (s.kind() != SymbolKind::Reference) ++name_records[s.name].definitions;
+    }
+    std::vector<std::uint32_t> next_definition(order.size());
+    std::vector<std::uint32_t> next_reference(order.size());
+    std::uint32_t offset = 0;
+    for (std::size_t n = 0; n < name_records.size(); ++n) {
+        name_records[n].first = offset;
+        next_definition[n] = offset;
+        next_reference[n] = offset + name_records[n].definitions;
+        offset += name_records[n].count;
+    }
+    std::vector<std::uint32_t> grouped(symbols.size());
+    for (std::uint32_t i = 0; i < symbols.size(); ++i) {
+        const format::SymbolRecord& s = symbols[i];
+        grouped[s.kind() == SymbolKind::Reference ? next_reference[s.name]++ : next_definition[s.name]++] = i;
+    }
+
+    format::Header h{};
+    std::memcpy(h.magic, format::kMagic, sizeof h.magic);
+    h.version = SymbolIndex::kVersion;
+    h.header_bytes = sizeof h;
+    h.file_count = files.size();
+    h.symbol_count = symbols.size();
+    h.name_count = order.size();
+    h.files = align8(sizeof h);
+    h.symbols = align8(h.files + records.size() * sizeof(format::FileRecord));
+    h.names = align8(h.symbols + symbols.size() * sizeof(format::SymbolRecord));
+    h.by_name = align8(h.names + name_records.size() * sizeof(format::NameRecord));
+    h.strings = align8(h.by_name + grouped.size() * sizeof(std::uint32_t));
+    h.strings_bytes = strings.size();
+    h.total_bytes = h.strings + strings.size();
+
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("cannot write symbol index " + temp);
+        std::uint64_t at = 0;
+        auto put = [&](std::uint64_t offset, const void* data, std::size_t bytes) {
+            static const char zeros[8] = {};
+            out.write(zeros, static_cast<std::streamsize>(offset - at));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            at = offset + bytes;
+        };
+        put(0, &h, sizeof h);
+        put(h.files, records.data(), records.size() * sizeof(format::FileRecord));
+        put(h.symbols, symbols.data(), symbols.size() * sizeof(format::SymbolRecord));
+        put(h.names, name_records.data(), name_records.size() * sizeof(format::NameRecord));
+        put(h.by_name, grouped.data(), grouped.size() * sizeof(std::uint32_t));
+        put(h.strings, strings.data(), strings.size());
+        out.flush();
+        if (!out) throw std::runtime_error("cannot write symbol index " + temp);
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    if (error) throw std::runtime_error("cannot replace symbol index " + path + ": " + error.message());
+    return h.total_bytes;
+}
+
+}  // namespace rebel::index
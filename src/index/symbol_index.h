@@ -0,0 +1,167 @@
+#pragma once
+
+// Symbol index files: a workspace's definitions and references, laid out
+// to be searched in place through a memory mapping with no load step.
+//
+//   header   Header
+//   files    FileRecord[file_count]      sorted by path
+//   symbols  SymbolRecord[symbol_count]  grouped by file, in file order
+//   names    NameRecord[name_count]      sorted by name
+//   by_name  u32[symbol_count]           symbol numbers grouped by name:
+//                                        definitions, then references,
+//                                        each by file and line
+//   strings  names and paths, not terminated
+//
+// Sections start on 8-byte boundaries. Integers are little-endian; only
+// little-endian hosts read and write the format. A file written by a
+// different kVersion is rejected, and the indexer rebuilds it.
+
+#include "core/mapped_file.h"
+#include "index/symbols.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::index {
+
+namespace format {
+
+constexpr char kMagic[8] = {'R', 'B', 'L', 'I', 'N', 'D', 'E', 'X'};
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t header_bytes;
+    std::uint64_t file_count;
+    std::uint64_t symbol_count;
+    std::uint64_t name_count;
+    std::uint64_t files;  // section offsets
+    std::uint64_t symbols;
+    std::uint64_t names;
+    std::uint64_t by_name;
+    std::uint64_t strings;
+    std::uint64_t strings_bytes;
+    std::uint64_t total_bytes;  // catches truncated files
+};
+
+struct FileRecord {
+    std::uint64_t mtime;  // nanoseconds, as the file system reports it
+    std::uint64_t size;
+    std::uint64_t hash;   // core::hash64 of the contents
+    std::uint32_t path;   // string offset
+    std::uint32_t path_length;
+    std::uint32_t first;  // first symbol
+    std::uint32_t count;
+};
+
+struct SymbolRecord {
+    std::uint32_t name;
+    std::uint32_t file;
+    std::uint32_t line;
+    std::uint32_t column_kind;  // column << 8 | kind; columns saturate at 2^24 - 1
+
+    std::uint32_t column() const noexcept { return column_kind >> 8; }
+    SymbolKind kind() const noexcept { return static_cast<SymbolKind>(column_kind & 0xff); }
+};
+
+struct NameRecord {
+    std::uint32_t text;  // string offset
+    std::uint32_t length;
+    std::uint32_t first;        // into by_name
+    std::uint32_t definitions;  // the first `definitions` entries are definitions
+    std::uint32_t count;
+    std::uint32_t reserved;
+};
+
+}  // namespace format
+
+/// A place a name occurs; `path` is relative to the workspace root and
+/// points into the index mapping.
+struct Location {
+    std::string_view path;
+    std::uint32_t line = 0;
+    std::uint32_t column = 0;
+    SymbolKind kind = SymbolKind::Reference;
+};
+
+/// A memory-mapped index file (see the format above). Opening validates
+/// the header, the section bounds and where each file and name record
+/// points, so a truncated or corrupt file is rejected rather than read
+/// past its end. Symbols, the bulk of the file, are checked as lookups
+/// reach them, and corrupt ones are skipped. Lookups are binary searches
+/// over the mapping. Immutable and safe to share between threads.
+class SymbolIndex {
+public:
+    static constexpr std::uint32_t kVersion = 1;
+
+    /// Throws std::system_error if the file cannot be mapped and
+    /// std::runtime_error if it is not an intact index of this version.
+    static std::shared_ptr<const SymbolIndex> open(const std::string& path);
+
+    std::size_t file_count() const noexcept { return header().file_count; }
+    std::size_t symbol_count() const noexcept { return header().symbol_count; }
+    std::size_t name_count() const noexcept { return header().name_count; }
+    std::size_t size_bytes() const noexcept { return file_->size(); }
+
+    /// Go-to-definition.
+    std::vector<Location> definitions(std::string_view name) const;
+    /// Find-references: every occurrence that is not a definition.
+    std::vector<Location> references(std::string_view name) const;
+    /// Up to `limit` names starting with `prefix`, in order.
+    std::vector<std::string_view> complete(std::string_view prefix, std::size_t limit = 50) const;
+
+    // Per-file access, for reusing unchanged files when re-indexing.
+    const format::FileRecord& file(std::size_t file) const noexcept { return files()[file]; }
+    std::string_view path(std::size_t file) const noexcept { return string(files()[file].path, files()[file].path_length); }
+    std::optional<std::size_t> find_file(std::string_view path) const;
+    const format::SymbolRecord* symbols() const noexcept { return section<format::SymbolRecord>(header().symbols); }
+    std::optional<std::uint32_t> name_id(std::string_view name) const;
+    std::string_view name(std::uint32_t name) const noexcept {
+        const format::NameRecord& n = names()[name];
+        return string(n.text, n.length);
+    }
+
+private:
+    explicit SymbolIndex(std::shared_ptr<const core::MappedFile> file) : file_(std::move(file)) {}
+
+    const format::Header& header() const noexcept { return *reinterpret_cast<const format::Header*>(file_->data()); }
+    template <typename T>
+    const T* section(std::uint64_t offset) const noexcept {
+        return reinterpret_cast<const T*>(file_->data() + offset);
+    }
+    const format::FileRecord* files() const noexcept { return section<format::FileRecord>(header().files); }
+    const format::NameRecord* names() const noexcept { return section<format::NameRecord>(header().names); }
+    std::string_view string(std::uint32_t offset, std::uint32_t length) const noexcept {
+        return {file_->data() + header().strings + offset, length};
+    }
+    const format::NameRecord* find_name(std::string_view name) const;
+    std::vector<Location> locations(std::string_view name, bool definitions) const;
+
+    std::shared_ptr<const core::MappedFile> file_;
+};
+
+/// Everything the index keeps about one file, for write_index.
+struct IndexedFile {
+    std::string path;
+    std::uint64_t mtime = 0;
+    std::uint64_t size = 0;
+    std::uint64_t hash = 0;
+    /// Reused unchanged from `source`, file `source_file`, when set;
+    /// otherwise `names` and `symbols` hold a fresh extraction.
+    std::shared_ptr<const SymbolIndex> source;
+    std::size_t source_file = 0;
+    std::vector<std::string> names;  // unique within the file
+    std::vector<format::SymbolRecord> symbols;  // `name` indexes `names`; `file` unused
+};
+
+/// Writes `files` as an index at `path`, through a temporary file renamed
+/// into place so readers never see a partial index. Sorts `files` by path.
+/// Returns the bytes written; throws std::runtime_error on I/O failure.
+std::size_t write_index(const std::string& path, std::vector<IndexedFile>& files);
+
+}  // namespace rebel::index
@@ -0,0 +1,162 @@
+#include "index/symbols.h"
+
+#include "syntax/lexer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <unordered_map>
+
+namespace rebel::index {
+namespace {
+
+// Lexers build keyword sets on construction; keep one per language per
+// indexing thread.
+const syntax::Lexer& lexer_for(const syntax::LanguageSpec& spec) {
+    thread_local std::unordered_map<const syntax::LanguageSpec*, std::unique_ptr<syntax::Lexer>> lexers;
+    auto& lexer = lexers[&spec];
+    if (!lexer) lexer = std::make_unique<syntax::Lexer>(spec);
+    return *lexer;
+}
+
+struct Seen {
+    std::string_view text;
+    syntax::TokenKind kind;
+    std::uint32_t line;
+};
+
+bool is_any(std::string_view text, std::initializer_list<std::string_view> words) {
+    return std::find(words.begin(), words.end(), text) != words.end();
+}
+
+// `#define NAME...` -> NAME, else empty.
+std::string_view defined_macro(std::string_view directive) {
+    std::size_t i = 1;
+    auto skip_space = [&] {
+        while (i < directive.size() && (directive[i] == ' ' || directive[i] == '\t')) ++i;
+    };
+    skip_space();
+    if (directive.compare(i, 6, "define") != 0) return {};
+    i += 6;
+    const std::size_t before = i;
+    skip_space();
+    if (i == before) return {};
+    const std::size_t start = i;
+    while (i < directive.size() && (std::isalnum(static_cast<unsigned char>(directive[i])) || directive[i] == '_')) ++i;
+    return directive.substr(start, i - start);
+}
+
+// What the tokens before a C++ name say it is.
+SymbolKind cpp_kind(const std::vector<Seen>& seen, syntax::TokenKind token, std::uint32_t line) {
+    using syntax::TokenKind;
+    if (seen.empty()) return SymbolKind::Reference;
+    const Seen& prev = seen.back();
+    if (prev.kind == TokenKind::Keyword) {
+        if (prev.text == "namespace") return SymbolKind::Namespace;
+        if (is_any(prev.text, {"class", "struct", "union", "enum"})) {
+            // Not a template parameter (`template <class T>`).
+            if (seen.size() >= 2 && is_any(seen[seen.size() - 2].text, {"<", ","})) return SymbolKind::Reference;
+            return SymbolKind::Type;
+        }
+    }
+    if (token != TokenKind::Function) return SymbolKind::Reference;
+
+    // Step back over a qualification: A::B::f(
+    std::size_t i = seen.size();
+    bool qualified = false;
+    while (i >= 2 && is_any(seen[i - 1].text, {"::", "::~"}) && seen[i - 2].kind == TokenKind::Identifier) {
+        i -= 2;
+        qualified = true;
+    }
+    if (i == 0 || seen[i - 1].line != line) {
+        // Nothing before it on the line: `A::A(` defines a constructor,
+        // a bare `f(` is a call statement.
+        if (qualified) return SymbolKind::Function;
+        if (i == 0) return SymbolKind::Reference;
+    }
+    const Seen& before = seen[i - 1];
+    switch (before.kind) {
+        case TokenKind::Type:
+        case TokenKind::Identifier: return SymbolKind::Function;
+        case TokenKind::Keyword:
+            return is_any(before.text, {"auto", "inline", "static", "constexpr", "consteval", "virtual", "explicit"})
+                       ? SymbolKind::Function
+                       : SymbolKind::Reference;
+        case TokenKind::Operator:
+            return is_any(before.text, {"*", "&", "&&", "**", "*&", ">", ">>", "~"}) ? SymbolKind::Function
+                                                                                   : SymbolKind::Reference;
+        default: return SymbolKind::Reference;
+    }
+}
+
+SymbolKind script_kind(const std::vector<Seen>& seen) {
+    if (seen.empty() || seen.back().kind != syntax::TokenKind::Keyword) return SymbolKind::Reference;
+    if (seen.back().text == "fn") return SymbolKind::Function;
+    if (seen.back().text == "let") return SymbolKind::Variable;
+    return SymbolKind::Reference;
+}
+
+}  // namespace
+
+const char* symbol_kind_name(SymbolKind kind) {
+    switch (kind) {
+        case SymbolKind::Reference: return "reference";
+        case SymbolKind::Function: return "function";
+        case SymbolKind::Type: return "type";
+        case SymbolKind::Namespace: return "namespace";
+        case SymbolKind::Macro: return "macro";
+        case SymbolKind::Variable: return "variable";
+    }
+    return "reference";
+}
+
+void extract_symbols(std::string_view text, const syntax::LanguageSpec& spec, std::vector<Occurrence>& out) {
+    using syntax::TokenKind;
+    const syntax::Lexer& lexer = lexer_for(spec);
+    const bool cpp = spec.preprocessor;
+
+    std::vector<syntax::Token> tokens;
+    std::vector<Seen> seen;  // significant tokens of the current statement
+    syntax::LexState state = syntax::LexState::Normal;
+    std::uint32_t line = 0;
+    for (std::size_t start = 0; start <= text.size(); ++line) {
+        std::size_t end = text.find('\n', start);
+        if (end == std::string_view::npos) end = text.size();
+        std::string_view content = text.substr(start, end - start);
+        if (!content.empty() && content.back() == '\r') content.remove_suffix(1);
+
+        tokens.clear();
+        state = lexer.lex_line(content, state, tokens);
+        for (const syntax::Token& token : tokens) {
+            const std::string_view word = content.substr(token.start, token.length);
+            switch (token.kind) {
+                case TokenKind::Comment:
+                case TokenKind::String:
+                case TokenKind::Number: continue;
+                case TokenKind::Preprocessor:
+                    if (const std::string_view macro = defined_macro(word); !macro.empty()) {
+                        out.push_back({macro, line, static_cast<std::uint32_t>(macro.data() - content.data()),
+                                       SymbolKind::Macro});
+                    }
+                    seen.clear();
+                    continue;
+                case TokenKind::Identifier:
+                case TokenKind::Function:
+                    out.push_back({word, line, token.start, cpp ? cpp_kind(seen, token.kind, line) : script_kind(seen)});
+                    break;
+                case TokenKind::Punctuation:
+                    if (word == ";" || word == "{" || word == "}") {
+                        seen.clear();
+                        continue;
+                    }
+                    break;
+                default: break;
+            }
+            if (seen.size() >= 32) seen.erase(seen.begin(), seen.begin() + 16);
+            seen.push_back({word, token.kind, line});
+        }
+        start = end + 1;
+    }
+}
+
+}  // namespace rebel::index
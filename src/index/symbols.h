@@ -0,0 +1,43 @@
+#pragma once
+
+#include "syntax/language.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace rebel::index {
+
+enum class SymbolKind : std::uint8_t {
+    Reference,  ///< A use of a name defined elsewhere (or not at all).
+    Function,
+    Type,       ///< class, struct, union, enum.
+    Namespace,
+    Macro,
+    Variable,   ///< Script `let` bindings.
+};
+
+const char* symbol_kind_name(SymbolKind kind);
+
+/// One occurrence of a name in a file. `name` points into the text passed
+/// to extract_symbols.
+struct Occurrence {
+    std::string_view name;
+    std::uint32_t line = 0;    // zero-based
+    std::uint32_t column = 0;  // bytes from the line start
+    SymbolKind kind = SymbolKind::Reference;
+};
+
+/// Appends the definitions and references in `text` to `out`.
+///
+/// Works from the highlighting lexer's tokens rather than a parser, so it is
+/// fast enough to run over a whole workspace and never fails on code that
+/// does not compile. Definitions are recognised from the tokens just before
+/// a name: `fn` and `let` in scripts; `class`, `struct`, `union`, `enum`,
+/// `namespace` and `#define` in C++, and a call-shaped name after a type or
+/// declarator (`int f(`, `auto A::f(`, `A::A(` at the start of a line).
+/// Every other identifier is a reference. Names inside comments and
+/// strings are skipped.
+void extract_symbols(std::string_view text, const syntax::LanguageSpec& spec, std::vector<Occurrence>& out);
+
+}  // namespace rebel::index
@@ -0,0 +1,250 @@
+#include "index/workspace_indexer.h"
+
+#include "core/hash.h"
+#include "core/mapped_file.h"
+#include "core/trace.h"
+#include "syntax/language.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+
+namespace rebel::index {
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Files a worker claims at a time; small enough to balance big files.
+constexpr std::size_t kBatch = 32;
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+enum class Outcome : std::uint8_t { Pending, Added, Changed, Rehashed, Reused, Vanished };
+
+bool is_source(const std::string& path) {
+    return &syntax::language_for_path(path) != &syntax::plain_language();
+}
+
+std::vector<std::string> list_sources(const fs::path& root) {
+    std::vector<std::string> out;
+    std::error_code error;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, error);
+    for (const fs::recursive_directory_iterator end; !error && it != end; it.increment(error)) {
+        const fs::path& path = it->path();
+        const std::string name = path.filename().string();
+        if (it->is_directory(error)) {
+            if (!name.empty() && name[0] == '.') it.disable_recursion_pending();
+            continue;
+        }
+        if (!it->is_regular_file(error)) continue;
+        if (!is_source(name)) continue;
+        out.push_back(path.lexically_relative(root).generic_string());
+    }
+    return out;
+}
+
+void extract(std::string_view text, const syntax::LanguageSpec& spec, IndexedFile& file,
+             std::vector<Occurrence>& scratch) {
+    scratch.clear();
+    extract_symbols(text, spec, scratch);
+    std::unordered_map<std::string_view, std::uint32_t> local;
+    file.symbols.reserve(scratch.size());
+    for (const Occurrence& o : scratch) {
+        const auto [it, fresh] = local.try_emplace(o.name, static_cast<std::uint32_t>(file.names.size()));
+        if (fresh) file.names.emplace_back(o.name);
+        const std::uint32_t column = std::min<std::uint32_t>(o.column, 0xffffff);
+        file.symbols.push_back({it->second, 0, o.line, column << 8 | static_cast<std::uint32_t>(o.kind)});
+    }
+}
+
+Outcome index_file(const fs::path& root, const std::shared_ptr<const SymbolIndex>& previous, IndexedFile& file,
+                   std::vector<Occurrence>& scratch) {
+    REBEL_TRACE_SCOPE("index.file");
+    std::error_code error;
+    const fs::path full = root / fs::path(file.path);
+    const auto mtime = fs::last_write_time(full, error);
+    if (error) return Outcome::Vanished;
+    file.mtime = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count());
+    file.size = fs::file_size(full, error);
+    if (error) return Outcome::Vanished;
+
+    std::optional<std::size_t> old;
+    if (previous) old = previous->find_file(file.path);
+    if (old) {
+        const format::FileRecord& record = previous->file(*old);
+        file.source = previous;
+        file.source_file = *old;
+        file.hash = record.hash;
+        if (record.mtime == file.mtime && record.size == file.size) return Outcome::Reused;
+    }
+
+    std::shared_ptr<const core::MappedFile> mapped;
+    try {
+        mapped = core::MappedFile::open(full.string());
+    } catch (const std::system_error&) {
+        return Outcome::Vanished;
+    }
+    mapped->advise(core::MappedFile::Access::Sequential);
+    const std::uint64_t hash = core::hash64(mapped->view());
+    if (old && hash == file.hash && mapped->size() == previous->file(*old).size) return Outcome::Rehashed;
+
+    file.source.reset();
+    file.hash = hash;
+    file.size = mapped->size();
+    extract(mapped->view(), syntax::language_for_path(file.path), file, scratch);
+    return old ? Outcome::Changed : Outcome::Added;
+}
+
+// Brings `files` up to date against `previous`: entries whose outcome is
+// still Pending are statted and, if need be, parsed on `pool`; the rest are
+// taken as they are. Writes the index unless nothing changed.
+IndexStats run(const fs::path& base, const std::string& index_path, core::ThreadPool& pool,
+               const std::shared_ptr<const SymbolIndex>& previous, std::vector<IndexedFile>& files,
+               std::vector<Outcome>& outcomes, IndexStats stats) {
+    REBEL_TRACE_SCOPE("index.update");
+    auto start = Clock::now();
+    std::atomic<std::size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t running = std::max<std::size_t>(1, pool.size());
+    for (std::size_t w = 0, workers = running; w < workers; ++w) {
+        pool.submit([&] {
+            std::vector<Occurrence> scratch;
+            for (;;) {
+                const std::size_t first = next.fetch_add(kBatch);
+                if (first >= files.size()) break;
+                const std::size_t last = std::min(files.size(), first + kBatch);
+                for (std::size_t f = first; f < last; ++f) {
+                    if (outcomes[f] == Outcome::Pending) outcomes[f] = index_file(base, previous, files[f], scratch);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--running == 0) finished.notify_one();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return running == 0; });
+    }
+
+    std::size_t kept = 0;
+    std::size_t changed = 0;
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        switch (outcomes[f]) {
+            case Outcome::Changed: ++changed; [[fallthrough]];
+            case Outcome::Added: ++stats.parsed; break;
+            case Outcome::Rehashed: ++stats.rehashed; break;
+            case Outcome::Reused: ++stats.reused; break;
+            case Outcome::Pending:
+            case Outcome::Vanished: continue;
+        }
+        if (kept != f) files[kept] = std::move(files[f]);
+        ++kept;
+    }
+    files.resize(kept);
+    stats.files = kept;
+    if (previous) stats.removed = previous->file_count() - (changed + stats.rehashed + stats.reused);
+    stats.index_ms = ms_since(start);
+
+    start = Clock::now();
+    if (previous && stats.parsed == 0 && stats.rehashed == 0 && stats.removed == 0) {
+        stats.bytes = previous->size_bytes();
+        stats.symbols = previous->symbol_count();
+        return stats;  // the index on disk is already exact
+    }
+    stats.bytes = write_index(index_path, files);
+    for (const IndexedFile& file : files) {
+        stats.symbols += file.source ? file.source->file(file.source_file).count : file.symbols.size();
+    }
+    stats.write_ms = ms_since(start);
+    return stats;
+}
+
+std::shared_ptr<const SymbolIndex> open_previous(const std::string& index_path) {
+    try {
+        return SymbolIndex::open(index_path);
+    } catch (const std::exception&) {
+        return nullptr;  // missing, damaged or from another version: index from scratch
+    }
+}
+
+}  // namespace
+
+IndexStats update_index(const std::string& root, const std::string& index_path, core::ThreadPool& pool) {
+    IndexStats stats;
+    const std::shared_ptr<const SymbolIndex> previous = open_previous(index_path);
+
+    const auto start = Clock::now();
+    const fs::path base(root);
+    std::vector<IndexedFile> files;
+    for (std::string& path : list_sources(base)) {
+        files.emplace_back();
+        files.back().path = std::move(path);
+    }
+    std::vector<Outcome> outcomes(files.size(), Outcome::Pending);
+    stats.scan_ms = ms_since(start);
+    return run(base, index_path, pool, previous, files, outcomes, stats);
+}
+
+IndexStats update_index(const std::string& root, const std::string& index_path, core::ThreadPool& pool,
+                        std::vector<std::string> changed) {
+    IndexStats stats;
+    const std::shared_ptr<const SymbolIndex> previous = open_previous(index_path);
+    if (!previous) return update_index(root, index_path, pool);
+
+    const auto start = Clock::now();
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    auto listed = [&](std::string_view path) { return std::binary_search(changed.begin(), changed.end(), path); };
+    // A file is affected if it is listed itself or lies under a listed
+    // (removed) directory.
+    auto affected = [&](std::string_view path) {
+        if (listed(path)) return true;
+        for (std::size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1)) {
+            if (listed(path.substr(0, slash))) return true;
+        }
+        return false;
+    };
+
+    std::vector<IndexedFile> files;
+    std::vector<Outcome> outcomes;
+    files.reserve(previous->file_count());
+    outcomes.reserve(previous->file_count());
+    for (std::size_t f = 0; f < previous->file_count(); ++f) {
+        files.emplace_back();
+        IndexedFile& file = files.back();
+        file.path = previous->path(f);
+        if (affected(file.path)) {
+            outcomes.push_back(Outcome::Pending);
+            continue;
+        }
+        const format::FileRecord& record = previous->file(f);
+        file.mtime = record.mtime;
+        file.size = record.size;
+        file.hash = record.hash;
+        file.source = previous;
+        file.source_file = f;
+        outcomes.push_back(Outcome::Reused);
+    }
+    // New files; listed paths that are directories or not sources are
+    // dropped by index_file or here.
+    for (const std::string& path : changed) {
+        if (!is_source(path) || previous->find_file(path)) continue;
+        files.emplace_back();
+        files.back().path = path;
+        outcomes.push_back(Outcome::Pending);
+    }
+    stats.scan_ms = ms_since(start);
+    return run(fs::path(root), index_path, pool, previous, files, outcomes, stats);
+}
+
+}  // namespace rebel::index
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "index/symbol_index.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rebel::index {
+
+/// What an indexing run did.
+struct IndexStats {
+    std::size_t files = 0;     // source files in the workspace
+    std::size_t parsed = 0;    // new or changed
+    std::size_t rehashed = 0;  // touched but unchanged: read and hashed, not parsed
+    std::size_t reused = 0;    // same mtime and size: not read at all
+    std::size_t removed = 0;   // in the old index, gone from the workspace
+    std::size_t symbols = 0;
+    std::size_t bytes = 0;     // index file size
+    double scan_ms = 0;        // listing the workspace
+    double index_ms = 0;       // stat, hash and parse on the pool
+    double write_ms = 0;
+};
+
+/// Brings the index at `index_path` up to date with the source files under
+/// `root` (those syntax::language_for_path recognises; directories whose
+/// names start with '.' are skipped) and returns the run's statistics.
+///
+/// A file whose mtime and size match its entry in the previous index keeps
+/// its symbols without being opened. One whose mtime changed is read and
+/// hashed, and parsed only if the hash changed too, so a checkout or build
+/// that merely touches files costs a read, not a parse. Statting, hashing
+/// and parsing run in parallel on `pool`. When nothing changed the index is
+/// left as it is. The previous index is ignored if it is missing,
+/// unreadable or of another format version.
+///
+/// Throws std::runtime_error if the new index cannot be written.
+IndexStats update_index(const std::string& root, const std::string& index_path, core::ThreadPool& pool);
+
+/// Like update_index, for when a file watcher has said what changed:
+/// `changed` lists files, relative to `root` and '/'-separated, that may
+/// have been created, modified or removed, and directories that were
+/// removed. Only those are examined; every other file keeps its entry
+/// without being statted, so the cost follows the change rather than the
+/// workspace. Falls back to a full run when there is no usable previous
+/// index.
+IndexStats update_index(const std::string& root, const std::string& index_path, core::ThreadPool& pool,
+                        std::vector<std::string> changed);
+
+}  // namespace rebel::index
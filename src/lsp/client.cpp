@@ -0,0 +1,266 @@
+#include "lsp/client.h"
+
+#include "core/trace.h"
+
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace rebel::lsp {
+namespace {
+
+// JSON-RPC error codes.
+constexpr int kMethodNotFound = -32601;
+
+// How long the destructor lets the writer flush, e.g. a final "exit".
+constexpr auto kFlushGrace = std::chrono::seconds(1);
+
+// From request() to its response being parsed, before the handler runs.
+REBEL_TRACE_PROBE(round_trip, "lsp.round_trip");
+
+std::string message(std::string_view method, const std::int64_t* id, std::string_view params) {
+    json::Writer out;
+    out.begin_object().key("jsonrpc").value("2.0");
+    if (id) out.key("id").value(*id);
+    out.key("method").value(method);
+    if (!params.empty()) out.key("params").raw(params);
+    out.end_object();
+    return out.take();
+}
+
+}  // namespace
+
+bool Request::done() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_;
+}
+
+bool Request::cancelled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cancelled_;
+}
+
+std::shared_ptr<const Response> Request::wait() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return done_; });
+    return response_;
+}
+
+Client::Client(std::unique_ptr<Channel> channel) : channel_(std::move(channel)) {
+    writer_ = std::thread([this] { write_loop(); });
+    reader_ = std::thread([this] { read_loop(); });
+}
+
+Client::~Client() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        writable_.notify_all();
+        drained_.wait_for(lock, kFlushGrace, [this] { return outbox_.empty() && !writing_; });
+    }
+    // Unblocks both threads: a write to a server that stopped reading fails,
+    // and the reader sees the end of the stream.
+    channel_->shutdown();
+    writer_.join();
+    reader_.join();
+}
+
+std::shared_ptr<Request> Client::request(std::string_view method, std::string_view params, ResponseHandler on_response,
+                                         std::string_view supersede) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::int64_t id = ++next_id_;
+    std::shared_ptr<Request> request(new Request(id, std::string(method)));
+    ++stats_.requests;
+    if (disconnected_) {
+        finish(*request, nullptr, false);
+        return request;
+    }
+    if (!supersede.empty()) {
+        const auto latest = latest_.find(std::string(supersede));
+        if (latest != latest_.end()) {
+            const auto previous = pending_.find(latest->second);
+            if (previous != pending_.end()) cancel_locked(*previous->second.request);
+        }
+        latest_[std::string(supersede)] = id;
+    }
+    pending_.emplace(id, Pending{request, std::move(on_response), std::string(supersede), false, REBEL_TRACE_NOW()});
+    outbox_.push_back(frame(message(method, &id, params)));
+    lock.unlock();
+    writable_.notify_one();
+    return request;
+}
+
+void Client::notify(std::string_view method, std::string_view params) {
+    send(message(method, nullptr, params));
+}
+
+void Client::cancel(Request& request) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancel_locked(request);
+}
+
+void Client::cancel_locked(Request& request) {
+    const auto it = pending_.find(request.id());
+    if (it == pending_.end() || it->second.cancelled) return;
+    Pending& pending = it->second;
+    pending.cancelled = true;
+    pending.handler = nullptr;
+    if (!pending.supersede.empty()) {
+        const auto latest = latest_.find(pending.supersede);
+        if (latest != latest_.end() && latest->second == request.id()) latest_.erase(latest);
+    }
+    ++stats_.cancelled;
+    finish(request, nullptr, true);
+
+    json::Writer params;
+    params.begin_object().key("id").value(request.id()).end_object();
+    outbox_.push_back(frame(message("$/cancelRequest", nullptr, params.str())));
+    writable_.notify_one();
+}
+
+void Client::on_notification(std::string method, NotificationHandler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    notification_handlers_[std::move(method)] = std::move(handler);
+}
+
+Client::Stats Client::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void Client::send(std::string body) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (disconnected_) return;
+        outbox_.push_back(frame(body));
+    }
+    writable_.notify_one();
+}
+
+void Client::finish(Request& request, std::shared_ptr<const Response> response, bool cancelled) {
+    std::lock_guard<std::mutex> lock(request.mutex_);
+    request.done_ = true;
+    request.cancelled_ = cancelled;
+    request.response_ = std::move(response);
+    request.finished_.notify_all();
+}
+
+void Client::write_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        writable_.wait(lock, [this] { return !outbox_.empty() || closing_; });
+        if (outbox_.empty()) return;
+        const std::string data = std::move(outbox_.front());
+        outbox_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        bool written = true;
+        try {
+            channel_->write(data);
+        } catch (const std::system_error&) {
+            written = false;  // the server is gone; the reader will see it
+        }
+        lock.lock();
+        writing_ = false;
+        if (!written) outbox_.clear();
+        if (outbox_.empty()) drained_.notify_all();
+    }
+}
+
+void Client::read_loop() {
+    try {
+        MessageReader reader(*channel_);
+        while (std::optional<std::string> body = reader.next()) dispatch(std::move(*body));
+    } catch (const std::exception&) {
+        // A broken stream ends the conversation like a closed one.
+    }
+    std::unordered_map<std::int64_t, Pending> lost;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        disconnected_ = true;
+        lost.swap(pending_);
+        latest_.clear();
+    }
+    for (auto& [id, pending] : lost) {
+        if (!pending.cancelled) finish(*pending.request, nullptr, false);
+    }
+}
+
+void Client::dispatch(std::string body) {
+    const std::size_t bytes = body.size();
+    const auto start = std::chrono::steady_clock::now();
+    std::optional<json::Document> parsed;
+    try {
+        parsed.emplace(json::Document::parse(std::move(body)));
+    } catch (const json::ParseError&) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_received += bytes;
+        return;  // nothing to route it by
+    }
+    const double parse_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const json::Value& root = parsed->root();
+    const json::Value* id = root.find("id");
+    const json::Value* method = root.find("method");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.bytes_received += bytes;
+    stats_.parse_ms += parse_ms;
+
+    if (method && id) {
+        // A request from the server; none are supported yet.
+        json::Writer reply;
+        reply.begin_object().key("jsonrpc").value("2.0").key("id");
+        if (id->is_string()) {
+            reply.value(id->as_string());
+        } else {
+            reply.value(id->as_int());
+        }
+        reply.key("error")
+            .begin_object()
+            .key("code")
+            .value(kMethodNotFound)
+            .key("message")
+            .value("method not supported")
+            .end_object()
+            .end_object();
+        outbox_.push_back(frame(reply.str()));
+        writable_.notify_one();
+        return;
+    }
+
+    if (method) {
+        const auto handler = notification_handlers_.find(std::string(method->as_string()));
+        ++stats_.notifications;
+        if (handler == notification_handlers_.end()) return;
+        const NotificationHandler notify = handler->second;
+        lock.unlock();
+        notify(root["params"]);
+        return;
+    }
+
+    if (!id) return;
+    const auto it = pending_.find(id->as_int());
+    if (it == pending_.end()) return;
+    Pending pending = std::move(it->second);
+    pending_.erase(it);
+    if (pending.cancelled) {
+        ++stats_.discarded;
+        return;
+    }
+    if (!pending.supersede.empty()) {
+        const auto latest = latest_.find(pending.supersede);
+        if (latest != latest_.end() && latest->second == pending.request->id()) latest_.erase(latest);
+    }
+    ++stats_.responses;
+    lock.unlock();
+    REBEL_TRACE_RECORD(round_trip, pending.sent);
+
+    auto response = std::make_shared<Response>(Response{std::move(*parsed), parse_ms});
+    if (pending.handler) pending.handler(response);
+    finish(*pending.request, std::move(response), false);
+}
+
+}  // namespace rebel::lsp
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "lsp/json.h"
+#include "lsp/transport.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace rebel::lsp {
+
+/// A server's answer to a request, parsed. `result()` and `error()` point
+/// into `message`, which owns the text and the tree.
+struct Response {
+    json::Document message;
+    double parse_ms = 0;  // on the reader thread
+
+    const json::Value& result() const noexcept { return message.root()["result"]; }
+    /// The error object, if the server answered with one.
+    const json::Value* error() const noexcept { return message.root().find("error"); }
+};
+
+/// One request in flight, from Client::request.
+class Request {
+public:
+    std::int64_t id() const noexcept { return id_; }
+    const std::string& method() const noexcept { return method_; }
+
+    /// Whether it was answered, cancelled or lost with the connection.
+    bool done() const;
+    bool cancelled() const;
+    /// Blocks until done; null unless a response arrived.
+    std::shared_ptr<const Response> wait() const;
+
+private:
+    friend class Client;
+
+    Request(std::int64_t id, std::string method) : id_(id), method_(std::move(method)) {}
+
+    const std::int64_t id_;
+    const std::string method_;
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable finished_;
+    bool done_ = false;
+    bool cancelled_ = false;
+    std::shared_ptr<const Response> response_;
+};
+
+/// JSON-RPC client for a language server.
+///
+/// Requests are pipelined: request() queues the message for a writer
+/// thread and returns, so any number can be in flight and the caller never
+/// blocks on the server. A reader thread frames and parses everything the
+/// server sends (see json::Document) and hands responses and notifications
+/// to their handlers there, already parsed, so multi-megabyte completion
+/// lists and diagnostics never cost the UI thread a parse.
+///
+/// A request made with a `supersede` key cancels the previous one still
+/// outstanding under that key: typing another character makes the last
+/// completion request stale, so the server is told with $/cancelRequest
+/// and its response is dropped when it arrives instead of reaching the
+/// handler.
+class Client {
+public:
+    using ResponseHandler = std::function<void(const std::shared_ptr<const Response>&)>;
+    using NotificationHandler = std::function<void(const json::Value& params)>;
+
+    struct Stats {
+        std::uint64_t requests = 0;
+        std::uint64_t responses = 0;       // handed to their requests
+        std::uint64_t cancelled = 0;       // by cancel() or superseded
+        std::uint64_t discarded = 0;       // responses to cancelled requests
+        std::uint64_t notifications = 0;
+        std::uint64_t bytes_received = 0;  // message bodies
+        double parse_ms = 0;
+    };
+
+    /// Starts the reader and writer threads on `channel`.
+    explicit Client(std::unique_ptr<Channel> channel);
+    /// Gives the writer up to a second to flush queued messages, then shuts
+    /// the channel down and joins the threads. Outstanding requests finish
+    /// without a response.
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /// Sends a request; `params` is JSON text, or empty for none.
+    /// `on_response` runs on the reader thread unless the request is
+    /// cancelled first.
+    std::shared_ptr<Request> request(std::string_view method, std::string_view params, ResponseHandler on_response = {},
+                                     std::string_view supersede = {});
+    void notify(std::string_view method, std::string_view params);
+    /// Tells the server to stop working on `request` and drops its response.
+    void cancel(Request& request);
+
+    /// Handles notifications for `method`, such as
+    /// textDocument/publishDiagnostics, on the reader thread. Requests the
+    /// server makes are answered with MethodNotFound.
+    void on_notification(std::string method, NotificationHandler handler);
+
+    Stats stats() const;
+
+private:
+    struct Pending {
+        std::shared_ptr<Request> request;
+        ResponseHandler handler;
+        std::string supersede;
+        bool cancelled = false;  // kept until the server answers anyway
+        std::uint64_t sent = 0;  // for tracing
+    };
+
+    void send(std::string body);
+    void read_loop();
+    void write_loop();
+    void dispatch(std::string body);
+    /// Marks `request` cancelled and queues $/cancelRequest; the caller
+    /// holds mutex_.
+    void cancel_locked(Request& request);
+    static void finish(Request& request, std::shared_ptr<const Response> response, bool cancelled);
+
+    std::unique_ptr<Channel> channel_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable writable_;
+    std::condition_variable drained_;
+    std::deque<std::string> outbox_;  // framed messages for the writer
+    bool writing_ = false;            // the writer holds a message
+    bool closing_ = false;
+    bool disconnected_ = false;       // the server's output ended
+    std::int64_t next_id_ = 0;
+    std::unordered_map<std::int64_t, Pending> pending_;
+    std::unordered_map<std::string, std::int64_t> latest_;  // supersede key -> id
+    std::unordered_map<std::string, NotificationHandler> notification_handlers_;
+    Stats stats_;
+
+    std::thread writer_;
+    std::thread reader_;
+};
+
+}  // namespace rebel::lsp
@@ -0,0 +1,668 @@
+#include "lsp/json.h"
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define REBEL_JSON_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define REBEL_JSON_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rebel::lsp::json {
+namespace {
+
+const Value kNull{};
+
+unsigned lowest_bit(std::uint64_t mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward64(&bit, mask);
+    return static_cast<unsigned>(bit);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// Character classes of one 64-byte block, one bit per byte.
+struct Block {
+    std::uint64_t quote;
+    std::uint64_t backslash;
+    std::uint64_t structural;  // { } [ ] : ,
+    std::uint64_t space;       // space, tab, CR, LF
+};
+
+#if REBEL_JSON_SSE2
+Block classify(const unsigned char* p) noexcept {
+    Block block{};
+    for (int part = 0; part < 4; ++part) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + part * 16));
+        // '[' and ']' are '{' and '}' without the 0x20 bit.
+        const __m128i folded = _mm_or_si128(x, _mm_set1_epi8(0x20));
+        const __m128i structural =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                      _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(':')), _mm_cmpeq_epi8(x, _mm_set1_epi8(','))));
+        const __m128i space =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+        auto bits = [&](__m128i m) {
+            return static_cast<std::uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(m))) << (part * 16);
+        };
+        block.quote |= bits(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')));
+        block.backslash |= bits(_mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+        block.structural |= bits(structural);
+        block.space |= bits(space);
+    }
+    return block;
+}
+#elif REBEL_JSON_NEON
+Block classify(const unsigned char* p) noexcept {
+    Block block{};
+    // Bit i of lane i, summed across each half into one byte.
+    static const uint8_t kWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t weights = vld1q_u8(kWeights);
+    auto bits = [&](uint8x16_t m) {
+        const uint8x16_t w = vandq_u8(m, weights);
+        return static_cast<std::uint64_t>(vaddv_u8(vget_low_u8(w))) |
+               static_cast<std::uint64_t>(vaddv_u8(vget_high_u8(w))) << 8;
+    };
+    for (int part = 0; part < 4; ++part) {
+        const uint8x16_t x = vld1q_u8(p + part * 16);
+        const uint8x16_t folded = vorrq_u8(x, vdupq_n_u8(0x20));
+        const uint8x16_t structural = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')), vceqq_u8(folded, vdupq_n_u8('}'))),
+                                               vorrq_u8(vceqq_u8(x, vdupq_n_u8(':')), vceqq_u8(x, vdupq_n_u8(','))));
+        const uint8x16_t space = vorrq_u8(vorrq_u8(vceqq_u8(x, vdupq_n_u8(' ')), vceqq_u8(x, vdupq_n_u8('\t'))),
+                                          vorrq_u8(vceqq_u8(x, vdupq_n_u8('\n')), vceqq_u8(x, vdupq_n_u8('\r'))));
+        const int shift = part * 16;
+        block.quote |= bits(vceqq_u8(x, vdupq_n_u8('"'))) << shift;
+        block.backslash |= bits(vceqq_u8(x, vdupq_n_u8('\\'))) << shift;
+        block.structural |= bits(structural) << shift;
+        block.space |= bits(space) << shift;
+    }
+    return block;
+}
+#else
+Block classify(const unsigned char* p) noexcept {
+    Block block{};
+    for (int i = 0; i < 64; ++i) {
+        const std::uint64_t bit = std::uint64_t{1} << i;
+        switch (p[i]) {
+            case '"': block.quote |= bit; break;
+            case '\\': block.backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': block.structural |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': block.space |= bit; break;
+            default: break;
+        }
+    }
+    return block;
+}
+#endif
+
+// Bytes escaped by a backslash. `carry` is 1 if the previous block ended
+// in an unescaped backslash, and is updated for the next. Visits one
+// escaping backslash per iteration, which is cheap at the densities
+// protocol messages have.
+std::uint64_t escaped_bytes(std::uint64_t backslash, std::uint64_t& carry) noexcept {
+    std::uint64_t escaped = carry;
+    std::uint64_t pending = backslash & ~carry;
+    carry = 0;
+    while (pending) {
+        const std::uint64_t bit = pending & (~pending + 1);
+        if (bit >> 63) {
+            carry = 1;
+            break;
+        }
+        escaped |= bit << 1;
+        pending &= ~(bit | bit << 1);
+    }
+    return escaped;
+}
+
+// Bit i set if an odd number of bits at or below i are: between an
+// opening quote (included) and its closing one (excluded).
+std::uint64_t prefix_xor(std::uint64_t x) noexcept {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Stage one: offsets of every structural character outside strings, of
+// both quotes of every string and of the first byte of every scalar.
+void index_structure(std::string_view text, std::vector<std::uint32_t>& offsets) {
+    offsets.clear();
+    offsets.reserve(text.size() / 4 + 16);
+    const auto* data = reinterpret_cast<const unsigned char*>(text.data());
+    std::uint64_t escape_carry = 0;
+    std::uint64_t string_carry = 0;  // all ones while inside a string
+    std::uint64_t scalar_carry = 0;
+    for (std::size_t base = 0; base < text.size(); base += 64) {
+        unsigned char tail[64];
+        const unsigned char* p = data + base;
+        if (text.size() - base < 64) {
+            std::memset(tail, ' ', sizeof tail);  // whitespace adds no marks
+            std::memcpy(tail, p, text.size() - base);
+            p = tail;
+        }
+        const Block block = classify(p);
+        const std::uint64_t escaped = block.backslash || escape_carry ? escaped_bytes(block.backslash, escape_carry) : 0;
+        const std::uint64_t quotes = block.quote & ~escaped;
+        const std::uint64_t in_string = prefix_xor(quotes) ^ string_carry;
+        string_carry = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+        const std::uint64_t scalar = ~(block.structural | block.space | block.quote | in_string);
+        const std::uint64_t scalar_starts = scalar & ~(scalar << 1 | scalar_carry);
+        scalar_carry = scalar >> 63;
+        std::uint64_t marks = (block.structural & ~in_string) | quotes | scalar_starts;
+        while (marks) {
+            offsets.push_back(static_cast<std::uint32_t>(base + lowest_bit(marks)));
+            marks &= marks - 1;
+        }
+    }
+    if (string_carry) throw ParseError("unterminated string", text.size());
+}
+
+void append_utf8(std::string& out, std::uint32_t code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xc0 | code >> 6);
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xe0 | code >> 12);
+        out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | code >> 18);
+        out += static_cast<char>(0x80 | (code >> 12 & 0x3f));
+        out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+int hex_digit(char c) noexcept {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Working memory of both stages. Each thread keeps one and reuses it, so
+// a parse does not pay for growing and faulting in fresh buffers, which
+// costs more than the parse itself for megabyte messages.
+struct Scratch {
+    struct Frame {
+        bool object;
+        std::size_t start;  // in members or items
+        std::string_view key;
+    };
+
+    std::vector<std::uint32_t> offsets;
+    std::vector<Frame> frames;
+    std::vector<Value> items;
+    std::vector<Member> members;
+    std::string decoded;
+};
+
+}  // namespace
+
+// Stage two: builds the tree from the offsets without recursion. Children
+// collect on scratch stacks and are copied into the arena, contiguous, when
+// their container closes.
+class Parser {
+public:
+    Parser(std::string_view text, core::Arena& arena, Scratch& scratch)
+        : text_(text),
+          arena_(arena),
+          offsets_(scratch.offsets),
+          frames_(scratch.frames),
+          items_(scratch.items),
+          members_(scratch.members),
+          decoded_(scratch.decoded) {
+        frames_.clear();
+        items_.clear();
+        members_.clear();
+    }
+
+    const Value* parse() {
+        index_structure(text_, offsets_);
+        using Frame = Scratch::Frame;
+        Value value;
+        for (;;) {
+            std::size_t at = next();
+            switch (text_[at]) {
+                case '{':
+                    frames_.push_back({true, members_.size(), {}});
+                    at = next();
+                    if (text_[at] == '}') {
+                        value = close_object(frames_.back().start);
+                        frames_.pop_back();
+                        break;
+                    }
+                    frames_.back().key = key(at);
+                    continue;
+                case '[':
+                    frames_.push_back({false, items_.size(), {}});
+                    if (peek() == ']') {
+                        next();
+                        value = close_array(frames_.back().start);
+                        frames_.pop_back();
+                        break;
+                    }
+                    continue;
+                case '"': value = string(at, next()); break;
+                default: value = scalar(at); break;
+            }
+            // A complete value: hand it to its container, then take any
+            // closers that follow.
+            for (;;) {
+                if (frames_.empty()) {
+                    if (cursor_ != offsets_.size()) throw ParseError("unexpected text after the value", offsets_[cursor_]);
+                    Value* root = arena_.make<Value>(value);
+                    return root;
+                }
+                Frame& frame = frames_.back();
+                if (frame.object) {
+                    members_.push_back({frame.key, value});
+                } else {
+                    items_.push_back(value);
+                }
+                at = next();
+                if (text_[at] == ',') {
+                    if (frame.object) frame.key = key(next());
+                    break;
+                }
+                if (text_[at] != (frame.object ? '}' : ']')) {
+                    throw ParseError(frame.object ? "expected ',' or '}'" : "expected ',' or ']'", at);
+                }
+                value = frame.object ? close_object(frame.start) : close_array(frame.start);
+                frames_.pop_back();
+            }
+        }
+    }
+
+private:
+    std::size_t next() {
+        if (cursor_ == offsets_.size()) throw ParseError("unexpected end of input", text_.size());
+        return offsets_[cursor_++];
+    }
+
+    char peek() const noexcept { return cursor_ < offsets_.size() ? text_[offsets_[cursor_]] : '\0'; }
+
+    // A member name at `at`, and the colon after it.
+    std::string_view key(std::size_t at) {
+        if (text_[at] != '"') throw ParseError("expected a member name", at);
+        const Value name = string(at, next());
+        const std::size_t colon = next();
+        if (text_[colon] != ':') throw ParseError("expected ':'", colon);
+        return name.as_string();
+    }
+
+    Value close_array(std::size_t start) {
+        Value value;
+        value.type_ = Type::Array;
+        value.size_ = static_cast<std::uint32_t>(items_.size() - start);
+        auto* items = static_cast<Value*>(arena_.allocate(sizeof(Value) * value.size_, alignof(Value)));
+        if (value.size_) std::memcpy(static_cast<void*>(items), &items_[start], sizeof(Value) * value.size_);
+        value.items_ = items;
+        items_.resize(start);
+        return value;
+    }
+
+    Value close_object(std::size_t start) {
+        Value value;
+        value.type_ = Type::Object;
+        value.size_ = static_cast<std::uint32_t>(members_.size() - start);
+        auto* members = static_cast<Member*>(arena_.allocate(sizeof(Member) * value.size_, alignof(Member)));
+        if (value.size_) std::memcpy(static_cast<void*>(members), &members_[start], sizeof(Member) * value.size_);
+        value.members_ = members;
+        members_.resize(start);
+        return value;
+    }
+
+    // The string between the quotes at `open` and `close`.
+    Value string(std::size_t open, std::size_t close) {
+        if (close <= open || text_[close] != '"') throw ParseError("unterminated string", open);
+        Value value;
+        value.type_ = Type::String;
+        const std::string_view raw = text_.substr(open + 1, close - open - 1);
+        if (!std::memchr(raw.data(), '\\', raw.size())) {
+            value.string_ = raw.data();
+            value.size_ = static_cast<std::uint32_t>(raw.size());
+            return value;
+        }
+        decoded_.clear();
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] != '\\') {
+                decoded_ += raw[i];
+                continue;
+            }
+            const std::size_t escape = open + 1 + i;
+            switch (raw[++i]) {
+                case '"': decoded_ += '"'; break;
+                case '\\': decoded_ += '\\'; break;
+                case '/': decoded_ += '/'; break;
+                case 'b': decoded_ += '\b'; break;
+                case 'f': decoded_ += '\f'; break;
+                case 'n': decoded_ += '\n'; break;
+                case 'r': decoded_ += '\r'; break;
+                case 't': decoded_ += '\t'; break;
+                case 'u': {
+                    std::uint32_t code = unit(raw, i + 1, escape);
+                    i += 4;
+                    // A high surrogate must pair with a low one.
+                    if (code >= 0xd800 && code < 0xdc00 && i + 6 < raw.size() && raw[i + 1] == '\\' &&
+                        raw[i + 2] == 'u') {
+                        const std::uint32_t low = unit(raw, i + 3, escape);
+                        if (low >= 0xdc00 && low < 0xe000) {
+                            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            i += 6;
+                        }
+                    }
+                    if (code >= 0xd800 && code < 0xe000) code = 0xfffd;  // unpaired surrogate
+                    append_utf8(decoded_, code);
+                    break;
+                }
+                default: throw ParseError("invalid escape", escape);
+            }
+        }
+        auto* copy = static_cast<char*>(arena_.allocate(decoded_.size(), 1));
+        std::memcpy(copy, decoded_.data(), decoded_.size());
+        value.string_ = copy;
+        value.size_ = static_cast<std::uint32_t>(decoded_.size());
+        return value;
+    }
+
+    // The four hex digits of a \u escape starting at raw[at].
+    std::uint32_t unit(std::string_view raw, std::size_t at, std::size_t escape) const {
+        if (at + 4 > raw.size()) throw ParseError("invalid \\u escape", escape);
+        std::uint32_t code = 0;
+        for (std::size_t k = 0; k < 4; ++k) {
+            const int digit = hex_digit(raw[at + k]);
+            if (digit < 0) throw ParseError("invalid \\u escape", escape);
+            code = code << 4 | static_cast<std::uint32_t>(digit);
+        }
+        return code;
+    }
+
+    // true, false, null or a number starting at `at`.
+    Value scalar(std::size_t at) {
+        Value value;
+        // Integers short enough not to overflow, the usual number in a
+        // protocol message, are checked and converted in one pass.
+        const char* const first = text_.data() + at;
+        const char* const last = text_.data() + text_.size();
+        const char* digits = first + (*first == '-' ? 1 : 0);
+        const char* p = digits;
+        std::uint64_t magnitude = 0;
+        while (p != last && *p >= '0' && *p <= '9' && p - digits < 19) magnitude = magnitude * 10 + (*p++ - '0');
+        // -0 is a double: an integer would drop its sign.
+        if (p != digits && p - digits < 19 && (*digits != '0' || p - digits == 1) && (p == last || is_delimiter(*p)) &&
+            (magnitude != 0 || *first != '-')) {
+            value.type_ = Type::Number;
+            value.integral_ = true;
+            value.integer_ = *first == '-' ? -static_cast<std::int64_t>(magnitude) : static_cast<std::int64_t>(magnitude);
+            return value;
+        }
+
+        std::size_t end = at;
+        while (end < text_.size() && !is_delimiter(text_[end])) ++end;
+        const std::string_view word = text_.substr(at, end - at);
+        if (word == "true" || word == "false") {
+            value.type_ = Type::Bool;
+            value.boolean_ = word[0] == 't';
+            return value;
+        }
+        if (word == "null") return value;
+        if (!valid_number(word)) throw ParseError("invalid value", at);
+        value.type_ = Type::Number;
+        if (word.find_first_of(".eE") == std::string_view::npos) {
+            std::int64_t integer = 0;
+            if (std::from_chars(word.data(), word.data() + word.size(), integer).ec == std::errc() &&
+                (integer != 0 || word[0] != '-')) {
+                value.integral_ = true;
+                value.integer_ = integer;
+                return value;
+            }
+        }
+        double real = 0;
+        const auto result = std::from_chars(word.data(), word.data() + word.size(), real);
+        if (result.ec == std::errc::result_out_of_range) {
+            real = overflows(word) ? std::numeric_limits<double>::infinity() : 0.0;
+            if (word[0] == '-') real = -real;
+        }
+        value.real_ = real;
+        return value;
+    }
+
+    static bool is_delimiter(char c) noexcept {
+        switch (c) {
+            case ' ': case '\t': case '\n': case '\r': case ',': case ':': case '[': case ']': case '{': case '}':
+            case '"': return true;
+            default: return false;
+        }
+    }
+
+    // Whether a valid number too far from 1 for a double is too large,
+    // rather than too close to zero: its leading digit's power of ten.
+    static bool overflows(std::string_view s) noexcept {
+        std::size_t i = s[0] == '-' ? 1 : 0;
+        std::int64_t power = -1;
+        for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+            if (power >= 0 || s[i] != '0') ++power;
+        }
+        if (i < s.size() && s[i] == '.') {
+            for (std::int64_t place = -1; ++i < s.size() && s[i] >= '0' && s[i] <= '9'; --place) {
+                if (power < 0 && s[i] != '0') {
+                    power = place;
+                    break;
+                }
+            }
+            while (i < s.size() && s[i] >= '0' && s[i] <= '9') ++i;
+        }
+        std::int64_t exponent = 0;
+        if (i < s.size()) {  // e or E
+            const bool negative = s[++i] == '-';
+            if (s[i] == '-' || s[i] == '+') ++i;
+            // Far past any double's range either way, and no overflow.
+            for (; i < s.size() && exponent < 100000; ++i) exponent = exponent * 10 + (s[i] - '0');
+            if (negative) exponent = -exponent;
+        }
+        return power + exponent > 0;
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    static bool valid_number(std::string_view s) noexcept {
+        std::size_t i = 0;
+        auto digits = [&] {
+            const std::size_t start = i;
+            while (i < s.size() && s[i] >= '0' && s[i] <= '9') ++i;
+            return i > start;
+        };
+        if (i < s.size() && s[i] == '-') ++i;
+        if (i < s.size() && s[i] == '0') {
+            ++i;
+        } else if (!digits()) {
+            return false;
+        }
+        if (i < s.size() && s[i] == '.') {
+            ++i;
+            if (!digits()) return false;
+        }
+        if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+            ++i;
+            if (i < s.size() && (s[i] == '+' || s[i] == '-')) ++i;
+            if (!digits()) return false;
+        }
+        return i == s.size();
+    }
+
+    std::string_view text_;
+    core::Arena& arena_;
+    std::vector<std::uint32_t>& offsets_;
+    std::size_t cursor_ = 0;
+    std::vector<Scratch::Frame>& frames_;
+    std::vector<Value>& items_;
+    std::vector<Member>& members_;
+    std::string& decoded_;
+};
+
+ParseError::ParseError(const std::string& message, std::size_t offset)
+    : std::runtime_error(message + " at byte " + std::to_string(offset)), offset_(offset) {}
+
+std::int64_t Value::as_int(std::int64_t fallback) const noexcept {
+    if (type_ != Type::Number) return fallback;
+    return integral_ ? integer_ : static_cast<std::int64_t>(real_);
+}
+
+double Value::as_double(double fallback) const noexcept {
+    if (type_ != Type::Number) return fallback;
+    return integral_ ? static_cast<double>(integer_) : real_;
+}
+
+const Value& Value::operator[](std::size_t index) const noexcept {
+    return type_ == Type::Array && index < size_ ? items_[index] : kNull;
+}
+
+const Value* Value::find(std::string_view key) const noexcept {
+    for (const Member* m = members_begin(); m != members_end(); ++m) {
+        if (m->key == key) return &m->value;
+    }
+    return nullptr;
+}
+
+const Value& Value::operator[](std::string_view key) const noexcept {
+    const Value* value = find(key);
+    return value ? *value : kNull;
+}
+
+Document Document::parse(std::string text) {
+    if (text.size() > std::numeric_limits<std::uint32_t>::max()) throw ParseError("document too large", 0);
+    Document doc;
+    doc.text_ = std::make_unique<const std::string>(std::move(text));
+    // Nodes take about as many bytes as the text they came from.
+    doc.arena_ = core::Arena(std::max<std::size_t>(64 << 10, doc.text_->size()));
+    static thread_local Scratch scratch;
+    doc.root_ = Parser(*doc.text_, doc.arena_, scratch).parse();
+    return doc;
+}
+
+void append_string(std::string& out, std::string_view text) {
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    std::size_t run = 0;  // start of the bytes not yet copied
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(text, run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += kHex[c >> 4];
+                out += kHex[c & 15];
+        }
+    }
+    out.append(text, run, text.size() - run);
+    out += '"';
+}
+
+void Writer::separate() {
+    if (comma_) out_ += ',';
+}
+
+Writer& Writer::begin_object() {
+    separate();
+    out_ += '{';
+    comma_ = false;
+    return *this;
+}
+
+Writer& Writer::end_object() {
+    out_ += '}';
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::begin_array() {
+    separate();
+    out_ += '[';
+    comma_ = false;
+    return *this;
+}
+
+Writer& Writer::end_array() {
+    out_ += ']';
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::key(std::string_view key) {
+    separate();
+    append_string(out_, key);
+    out_ += ':';
+    comma_ = false;
+    return *this;
+}
+
+Writer& Writer::value(std::string_view text) {
+    separate();
+    append_string(out_, text);
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::value(std::int64_t number) {
+    separate();
+    out_ += std::to_string(number);
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::value(double number) {
+    separate();
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof buffer, number);
+    out_.append(buffer, result.ptr);
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::value(bool flag) {
+    separate();
+    out_ += flag ? "true" : "false";
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::null() {
+    separate();
+    out_ += "null";
+    comma_ = true;
+    return *this;
+}
+
+Writer& Writer::raw(std::string_view json) {
+    separate();
+    out_ += json;
+    comma_ = true;
+    return *this;
+}
+
+}  // namespace rebel::lsp::json
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "core/arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace rebel::lsp::json {
+
+/// Input that is not JSON; `offset` is the byte at which parsing stopped.
+class ParseError : public std::runtime_error {
+public:
+    ParseError(const std::string& message, std::size_t offset);
+
+    std::size_t offset() const noexcept { return offset_; }
+
+private:
+    std::size_t offset_;
+};
+
+enum class Type : std::uint8_t { Null, Bool, Number, String, Array, Object };
+
+struct Member;
+
+/// A node of a parsed Document. Values are small, immutable and owned by
+/// their Document; accessors of the wrong type return the fallback rather
+/// than throwing, so optional fields of a message read as plainly as
+/// required ones: `reply["result"]["items"].size()`.
+class Value {
+public:
+    Value() = default;
+
+    Type type() const noexcept { return type_; }
+    bool is_null() const noexcept { return type_ == Type::Null; }
+    bool is_number() const noexcept { return type_ == Type::Number; }
+    bool is_string() const noexcept { return type_ == Type::String; }
+    bool is_array() const noexcept { return type_ == Type::Array; }
+    bool is_object() const noexcept { return type_ == Type::Object; }
+
+    bool as_bool(bool fallback = false) const noexcept { return type_ == Type::Bool ? boolean_ : fallback; }
+    /// Numbers with a fraction or exponent are truncated.
+    std::int64_t as_int(std::int64_t fallback = 0) const noexcept;
+    double as_double(double fallback = 0) const noexcept;
+    /// Points into the parsed text unless the string had escapes.
+    std::string_view as_string(std::string_view fallback = {}) const noexcept {
+        return type_ == Type::String ? std::string_view(string_, size_) : fallback;
+    }
+
+    /// Items of an array or members of an object; 0 for anything else.
+    std::size_t size() const noexcept { return type_ == Type::Array || type_ == Type::Object ? size_ : 0; }
+    /// Array items; empty for anything else.
+    const Value* begin() const noexcept { return type_ == Type::Array ? items_ : nullptr; }
+    const Value* end() const noexcept { return type_ == Type::Array ? items_ + size_ : nullptr; }
+    /// Array item `index`, or a null value past the end.
+    const Value& operator[](std::size_t index) const noexcept;
+    const Value& operator[](int index) const noexcept { return (*this)[static_cast<std::size_t>(index)]; }
+
+    /// Object members in document order; empty for anything else.
+    const Member* members_begin() const noexcept { return type_ == Type::Object ? members_ : nullptr; }
+    const Member* members_end() const noexcept;
+    /// The member named `key` (the first, if repeated), or null. Linear in
+    /// the member count, which is small for protocol messages.
+    const Value* find(std::string_view key) const noexcept;
+    /// The member named `key`, or a null value.
+    const Value& operator[](std::string_view key) const noexcept;
+    const Value& operator[](const char* key) const noexcept { return (*this)[std::string_view(key)]; }
+
+private:
+    friend class Parser;
+
+    Type type_ = Type::Null;
+    bool integral_ = false;  // Number held in integer_
+    std::uint32_t size_ = 0;
+    union {
+        bool boolean_;
+        std::int64_t integer_;
+        double real_;
+        const char* string_;
+        const Value* items_;
+        const Member* members_;
+    };
+};
+
+struct Member {
+    std::string_view key;
+    Value value;
+};
+
+inline const Member* Value::members_end() const noexcept { return type_ == Type::Object ? members_ + size_ : nullptr; }
+
+/// A parsed JSON text, owning both the text and the nodes, which are
+/// allocated from one arena and freed together.
+///
+/// Parsing runs in two passes, after simdjson. The first classifies the
+/// text 64 bytes at a time with vector compares (quotes, backslashes,
+/// structural characters, whitespace), works out which bytes lie inside
+/// strings with a prefix XOR over the unescaped quotes, and records the
+/// offset of every structural character, string delimiter and scalar.
+/// The second walks those offsets to build the tree, with no per-byte
+/// branching left. Strings without escapes are not copied: their values
+/// point into the text, which is why the Document keeps it.
+///
+/// Bytes are not checked for valid UTF-8 and control characters are
+/// accepted inside strings; everything else the grammar forbids is a
+/// ParseError.
+class Document {
+public:
+    /// Parses `text`, taking ownership of it. Throws ParseError.
+    static Document parse(std::string text);
+
+    Document(Document&&) noexcept = default;
+    Document& operator=(Document&&) noexcept = default;
+
+    const Value& root() const noexcept { return *root_; }
+    std::string_view text() const noexcept { return *text_; }
+    /// Memory held by the tree and decoded strings.
+    std::size_t arena_bytes() const noexcept { return arena_.bytes_used(); }
+
+private:
+    Document() = default;
+
+    std::unique_ptr<const std::string> text_;  // stable address for zero-copy strings
+    core::Arena arena_;
+    const Value* root_ = nullptr;
+};
+
+/// Builds JSON text, inserting commas itself. Strings are escaped; numbers
+/// are written as given. Nothing checks that calls nest properly.
+class Writer {
+public:
+    Writer& begin_object();
+    Writer& end_object();
+    Writer& begin_array();
+    Writer& end_array();
+    Writer& key(std::string_view key);
+
+    Writer& value(std::string_view text);
+    Writer& value(const char* text) { return value(std::string_view(text)); }
+    Writer& value(std::int64_t number);
+    Writer& value(int number) { return value(static_cast<std::int64_t>(number)); }
+    Writer& value(double number);
+    Writer& value(bool flag);
+    Writer& null();
+    /// Inserts `json`, which must be a complete value, as is.
+    Writer& raw(std::string_view json);
+
+    const std::string& str() const noexcept { return out_; }
+    std::string take() { return std::move(out_); }
+
+private:
+    void separate();
+
+    std::string out_;
+    bool comma_ = false;
+};
+
+/// Appends `text` to `out` as a quoted JSON string.
+void append_string(std::string& out, std::string_view text);
+
+}  // namespace rebel::lsp::json
@@ -0,0 +1,283 @@
+#include "lsp/transport.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace rebel::lsp {
+namespace {
+
+constexpr std::size_t kReadChunk = 64 * 1024;
+constexpr auto kExitGrace = std::chrono::seconds(1);
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+#ifdef _WIN32
+// One argument quoted the way the C runtime splits command lines.
+void append_argument(std::string& out, const std::string& arg) {
+    if (!out.empty()) out += ' ';
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+        out += arg;
+        return;
+    }
+    out += '"';
+    std::size_t backslashes = 0;
+    for (const char c : arg) {
+        if (c == '\\') {
+            ++backslashes;
+            continue;
+        }
+        // Backslashes are literal unless they precede a quote.
+        out.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        out += c;
+    }
+    out.append(backslashes * 2, '\\');
+    out += '"';
+}
+#endif
+
+}  // namespace
+
+#ifdef _WIN32
+
+std::unique_ptr<Channel> Channel::spawn(const std::string& program, const std::vector<std::string>& args) {
+    SECURITY_ATTRIBUTES inherit{sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+    HANDLE in_read = nullptr, in_write = nullptr, out_read = nullptr, out_write = nullptr;
+    if (!CreatePipe(&in_read, &in_write, &inherit, 0) || !CreatePipe(&out_read, &out_write, &inherit, 0)) {
+        const auto error = static_cast<int>(GetLastError());
+        if (in_read) CloseHandle(in_read);
+        if (in_write) CloseHandle(in_write);
+        throw std::system_error(error, std::system_category(), "pipe");
+    }
+    // Only the child's ends are inherited.
+    SetHandleInformation(in_write, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(out_read, HANDLE_FLAG_INHERIT, 0);
+
+    std::string command;
+    append_argument(command, program);
+    for (const std::string& arg : args) append_argument(command, arg);
+    STARTUPINFOA startup{};
+    startup.cb = sizeof startup;
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = in_read;
+    startup.hStdOutput = out_write;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION info{};
+    const BOOL started = CreateProcessA(nullptr, command.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr,
+                                        nullptr, &startup, &info);
+    const auto error = static_cast<int>(GetLastError());
+    CloseHandle(in_read);
+    CloseHandle(out_write);
+    if (!started) {
+        CloseHandle(in_write);
+        CloseHandle(out_read);
+        throw std::system_error(error, std::system_category(), "spawn " + program);
+    }
+    CloseHandle(info.hThread);
+    std::unique_ptr<Channel> channel(new Channel);
+    channel->process_ = info.hProcess;
+    channel->input_ = in_write;
+    channel->output_ = out_read;
+    return channel;
+}
+
+Channel::~Channel() {
+    shutdown();
+    if (output_) CloseHandle(output_);
+    if (process_) CloseHandle(process_);
+}
+
+std::size_t Channel::read(char* data, std::size_t size) {
+    DWORD count = 0;
+    if (!ReadFile(output_, data, static_cast<DWORD>(std::min<std::size_t>(size, 1u << 30)), &count, nullptr)) {
+        const DWORD error = GetLastError();
+        if (error == ERROR_BROKEN_PIPE) return 0;
+        throw std::system_error(static_cast<int>(error), std::system_category(), "read");
+    }
+    return count;
+}
+
+void Channel::write(std::string_view data) {
+    while (!data.empty()) {
+        DWORD count = 0;
+        if (!input_ || !WriteFile(input_, data.data(), static_cast<DWORD>(std::min<std::size_t>(data.size(), 1u << 30)),
+                                  &count, nullptr)) {
+            throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "write");
+        }
+        data.remove_prefix(count);
+    }
+}
+
+void Channel::shutdown() noexcept {
+    if (!input_) return;
+    // A pipe read cannot be interrupted from another thread, so the server
+    // is made to close its end: by exiting on end of input, or by force.
+    CloseHandle(input_);
+    input_ = nullptr;
+    const auto grace = static_cast<DWORD>(std::chrono::milliseconds(kExitGrace).count());
+    if (WaitForSingleObject(process_, grace) == WAIT_TIMEOUT) TerminateProcess(process_, 1);
+}
+
+#else
+
+std::unique_ptr<Channel> Channel::spawn(const std::string& program, const std::vector<std::string>& args) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::system_error(errno, std::generic_category(), "socketpair");
+    for (const int fd : fds) ::fcntl(fd, F_SETFD, FD_CLOEXEC);  // dup2 clears it on the child's copies
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid = -1;
+    const int error = ::posix_spawnp(&pid, program.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(fds[1]);
+    if (error != 0) {
+        ::close(fds[0]);
+        throw std::system_error(error, std::generic_category(), "spawn " + program);
+    }
+#ifdef SO_NOSIGPIPE
+    const int one = 1;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+    std::unique_ptr<Channel> channel(new Channel);
+    channel->pid_ = pid;
+    channel->fd_ = fds[0];
+    return channel;
+}
+
+Channel::~Channel() {
+    shutdown();
+    ::close(fd_);
+    const auto deadline = std::chrono::steady_clock::now() + kExitGrace;
+    int status = 0;
+    while (::waitpid(pid_, &status, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            ::kill(pid_, SIGKILL);
+            ::waitpid(pid_, &status, 0);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+std::size_t Channel::read(char* data, std::size_t size) {
+    for (;;) {
+        const ssize_t count = ::read(fd_, data, size);
+        if (count >= 0) return static_cast<std::size_t>(count);
+        if (errno != EINTR) throw std::system_error(errno, std::generic_category(), "read");
+    }
+}
+
+void Channel::write(std::string_view data) {
+#ifdef MSG_NOSIGNAL
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+    while (!data.empty()) {
+        const ssize_t count = ::send(fd_, data.data(), data.size(), flags);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "write");
+        }
+        data.remove_prefix(static_cast<std::size_t>(count));
+    }
+}
+
+void Channel::shutdown() noexcept { ::shutdown(fd_, SHUT_RDWR); }
+
+#endif
+
+std::optional<std::string> MessageReader::next() {
+    // Headers.
+    std::size_t header_end;
+    while ((header_end = buffer_.find("\r\n\r\n", start_)) == std::string::npos) {
+        if (start_ > 0) {
+            buffer_.erase(0, start_);
+            start_ = 0;
+        }
+        const std::size_t old = buffer_.size();
+        buffer_.resize(old + kReadChunk);
+        const std::size_t count = source_(buffer_.data() + old, kReadChunk);
+        buffer_.resize(old + count);
+        if (count == 0) {
+            if (buffer_.empty()) return std::nullopt;
+            throw std::runtime_error("stream ended inside a message header");
+        }
+    }
+    std::optional<std::size_t> length;
+    for (std::size_t line = start_; line < header_end;) {
+        std::size_t eol = buffer_.find("\r\n", line);
+        if (eol == std::string::npos || eol > header_end) eol = header_end;
+        const std::string_view header(buffer_.data() + line, eol - line);
+        const std::size_t colon = header.find(':');
+        if (colon != std::string_view::npos && iequals(header.substr(0, colon), "Content-Length")) {
+            std::size_t value = 0;
+            std::size_t i = colon + 1;
+            while (i < header.size() && header[i] == ' ') ++i;
+            if (i == header.size()) throw std::runtime_error("empty Content-Length");
+            for (; i < header.size(); ++i) {
+                if (header[i] < '0' || header[i] > '9') throw std::runtime_error("invalid Content-Length");
+                value = value * 10 + static_cast<std::size_t>(header[i] - '0');
+            }
+            length = value;
+        }
+        line = eol + 2;
+    }
+    if (!length) throw std::runtime_error("message without Content-Length");
+    start_ = header_end + 4;
+
+    // Body: what is buffered, then the rest read in place.
+    std::string body(*length, '\0');
+    const std::size_t buffered = std::min(*length, buffer_.size() - start_);
+    std::memcpy(body.data(), buffer_.data() + start_, buffered);
+    start_ += buffered;
+    for (std::size_t filled = buffered; filled < body.size();) {
+        const std::size_t count = source_(body.data() + filled, body.size() - filled);
+        if (count == 0) throw std::runtime_error("stream ended inside a message body");
+        filled += count;
+    }
+    if (start_ == buffer_.size()) {
+        buffer_.clear();
+        start_ = 0;
+    }
+    return body;
+}
+
+std::string frame(std::string_view body) {
+    std::string out = "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    out += body;
+    return out;
+}
+
+}  // namespace rebel::lsp
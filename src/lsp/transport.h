@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rebel::lsp {
+
+/// A language server process and the byte stream to it over its standard
+/// input and output. Its standard error is inherited, for its logs.
+///
+/// read() and write() may be called from different threads at once; each
+/// from only one thread at a time.
+class Channel {
+public:
+    /// Starts `program` (looked up in PATH) with `args`. Throws
+    /// std::system_error if it cannot be started.
+    static std::unique_ptr<Channel> spawn(const std::string& program, const std::vector<std::string>& args = {});
+
+    /// Closes the stream and waits for the process, killing it if it has not
+    /// exited a second after losing its input.
+    ~Channel();
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    /// Blocks until at least one byte arrives; returns 0 at end of stream.
+    /// Throws std::system_error.
+    std::size_t read(char* data, std::size_t size);
+    /// Writes all of `data`. Throws std::system_error, also once the server
+    /// has gone away.
+    void write(std::string_view data);
+    /// Ends the conversation in both directions: a read() blocked in
+    /// another thread returns 0.
+    void shutdown() noexcept;
+
+private:
+    Channel() = default;
+
+#ifdef _WIN32
+    void* process_ = nullptr;
+    void* input_ = nullptr;   // the server's standard input
+    void* output_ = nullptr;  // the server's standard output
+#else
+    int pid_ = -1;
+    int fd_ = -1;  // our end of a socket pair: sockets, unlike pipes, can refuse SIGPIPE
+#endif
+};
+
+/// Splits the stream from a Channel into LSP messages: a header block with
+/// Content-Length, a blank line, then that many bytes of JSON. The Debug
+/// Adapter Protocol frames its messages the same way.
+class MessageReader {
+public:
+    /// Reads like Channel::read: blocks for at least one byte, returns 0
+    /// at end of stream.
+    using Source = std::function<std::size_t(char* data, std::size_t size)>;
+
+    explicit MessageReader(Channel& channel)
+        : source_([&channel](char* data, std::size_t size) { return channel.read(data, size); }) {}
+    explicit MessageReader(Source source) : source_(std::move(source)) {}
+
+    /// The next message body, or nullopt at end of stream. Throws
+    /// std::runtime_error for a malformed header and std::system_error if
+    /// reading fails. Large bodies are read straight into the returned
+    /// string, which a json::Document can then take over without a copy.
+    std::optional<std::string> next();
+
+private:
+    Source source_;
+    std::string buffer_;
+    std::size_t start_ = 0;  // unread bytes are buffer_[start_, size)
+};
+
+/// `body` with its header, ready for Channel::write.
+std::string frame(std::string_view body);
+
+}  // namespace rebel::lsp
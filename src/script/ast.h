@@ -0,0 +1,92 @@
+#pragma once
+
+#include "script/lexer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rebel::script::ast {
+
+struct Expr;
+struct Stmt;
+struct FunctionDecl;
+using ExprPtr = std::unique_ptr<Expr>;
+using StmtPtr = std::unique_ptr<Stmt>;
+using Block = std::vector<StmtPtr>;
+
+enum class ExprKind : std::uint8_t {
+    Nil,
+    True,
+    False,
+    Number,    // number
+    String,    // text
+    Name,      // text
+    Index,     // a[b]
+    Field,     // a.text
+    Call,      // a(list...)
+    Unary,     // op a
+    Binary,    // a op b
+    And,       // a and b
+    Or,        // a or b
+    Array,     // [list...]
+    Table,     // {keys[i]: list[i]...}
+    Function,  // [async] fn(...) { ... }
+    Await,     // await a
+};
+
+struct Expr {
+    Expr(ExprKind k, std::uint32_t l) : kind(k), line(l) {}
+
+    ExprKind kind;
+    std::uint32_t line;
+    Tok op = Tok::End;
+    double number = 0;
+    std::string text;
+    ExprPtr a;
+    ExprPtr b;
+    std::vector<ExprPtr> list;
+    std::vector<ExprPtr> keys;  // Table: one key per entry in `list`
+    std::unique_ptr<FunctionDecl> function;
+};
+
+enum class StmtKind : std::uint8_t {
+    Expr,      // a
+    Let,       // let name = a
+    Assign,    // a op b, op being '=' or a compound assignment
+    If,        // if a body else orelse
+    While,     // while a body
+    ForRange,  // for name in a..b body
+    ForIn,     // for name[, value] in a body
+    Block,     // { body }
+    Return,    // return [a]
+    Break,
+    Continue,
+    Function,  // [async] fn name(...) { ... }
+};
+
+struct Stmt {
+    Stmt(StmtKind k, std::uint32_t l) : kind(k), line(l) {}
+
+    StmtKind kind;
+    std::uint32_t line;
+    Tok op = Tok::End;
+    std::string name;
+    std::string value;  // ForIn: second loop variable, may be empty
+    ExprPtr a;
+    ExprPtr b;
+    Block body;
+    Block orelse;
+    std::unique_ptr<FunctionDecl> function;
+};
+
+struct FunctionDecl {
+    std::string name;
+    std::uint32_t line = 0;
+    std::vector<std::string> params;
+    Block body;
+    bool is_async = false;
+};
+
+}  // namespace rebel::script::ast
@@ -0,0 +1,559 @@
+#include "script/async.h"
+
+#include "script/bind.h"
+#include "script/error.h"
+#include "script/object.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace rebel::script {
+
+namespace {
+
+using core::EventLoop;
+
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;  // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+constexpr std::size_t kChunk = 64 * 1024;
+
+std::string os_message(int error) { return std::error_code(error, std::generic_category()).message(); }
+
+bool set_nonblocking(int fd) { return ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) == 0; }
+
+bool make_pipe(int fds[2]) {
+#if defined(__linux__)
+    return ::pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (::pipe(fds) < 0) return false;
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+void close_fd(int& fd) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+// write() to a pipe whose reader is gone, without the SIGPIPE that would
+// end the process.
+ssize_t write_quietly(int fd, const char* data, std::size_t size) {
+#if defined(F_SETNOSIGPIPE)
+    ::fcntl(fd, F_SETNOSIGPIPE, 1);
+    return ::write(fd, data, size);
+#else
+    sigset_t pipe_only, old;
+    sigemptyset(&pipe_only);
+    sigaddset(&pipe_only, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_only, &old);
+    const ssize_t n = ::write(fd, data, size);
+    const int error = errno;
+    // Consume the signal this write raised, unless one was already pending.
+    if (n < 0 && error == EPIPE && !sigismember(&old, SIGPIPE)) {
+        const timespec zero{0, 0};
+        while (::sigtimedwait(&pipe_only, nullptr, &zero) < 0 && errno == EINTR) {
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    errno = error;
+    return n;
+#endif
+}
+
+}  // namespace
+
+struct AsyncIo::Process {
+    pid_t pid = -1;  // until reaped
+    int in = -1;
+    int out = -1;
+    int err = -1;
+    std::string input;
+    std::size_t written = 0;
+    std::string out_text;
+    std::string err_text;
+};
+
+struct AsyncIo::Socket {
+    ~Socket() {
+        if (addresses) ::freeaddrinfo(addresses);
+    }
+
+    std::string where;  // host:port, for messages
+    addrinfo* addresses = nullptr;
+    addrinfo* next = nullptr;  // the address to try after this one
+    int fd = -1;
+    int last_error = 0;
+    bool connected = false;
+    bool sending = true;
+    std::string data;
+    std::size_t sent = 0;
+    std::string received;
+};
+
+struct AsyncIo::Op {
+    std::uint64_t id = 0;
+    VM::Handle task;
+    EventLoop::TimerId timer = 0;
+    std::unique_ptr<Process> process;
+    std::unique_ptr<Socket> socket;
+    std::string text;   // pool work: what it read
+    std::string error;  // pool work: why it failed
+};
+
+AsyncIo::AsyncIo(VM& vm, core::EventLoop& loop, core::ThreadPool& pool)
+    : vm_(vm), loop_(loop), pool_(pool), alive_(std::make_shared<char>()) {
+    vm_.define_native("sleep", native<&AsyncIo::sleep>(), this);
+    vm_.define_native("read_file", native<&AsyncIo::read_file>(), this);
+    vm_.define_native("write_file", native<&AsyncIo::write_file>(), this);
+    vm_.define_native("exec", native<&AsyncIo::exec>(), this);
+    vm_.define_native("tcp_request", native<&AsyncIo::tcp_request>(), this);
+}
+
+AsyncIo::~AsyncIo() {
+    alive_.reset();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        jobs_done_.wait(lock, [this] { return jobs_ == 0; });
+    }
+    for (auto& [id, op] : ops_) close(*op);
+}
+
+Value AsyncIo::run_until(const Value& value) {
+    if (!value.is_task()) return value;
+    value.as_task()->observed = true;
+    const VM::Handle task(vm_, value);
+    for (;;) {
+        vm_.run_tasks();
+        if (task.get().as_task()->state != Task::State::Pending) break;
+        if (!loop_.alive()) throw RuntimeError("run_until: the task is waiting on nothing that can settle it");
+        loop_.run_once();
+    }
+    Task* settled = task.get().as_task();
+    if (settled->state == Task::State::Failed) throw RuntimeError(*settled->error);
+    return settled->result;
+}
+
+void AsyncIo::run() {
+    for (;;) {
+        vm_.run_tasks();
+        if (!loop_.alive()) return;
+        loop_.run_once();
+    }
+}
+
+AsyncIo::Op& AsyncIo::begin(Value& task) {
+    task = vm_.new_task();
+    auto op = std::make_unique<Op>();
+    op->id = ++next_op_;
+    op->task = VM::Handle(vm_, task);
+    Op& ref = *op;
+    ops_.emplace(ref.id, std::move(op));
+    return ref;
+}
+
+void AsyncIo::offload(Op& op, std::function<void(Op&)> work, std::function<void(Op&)> done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++jobs_;
+    }
+    loop_.hold();
+    Op* target = &op;
+    pool_.submit([this, target, id = op.id, alive = std::weak_ptr<char>(alive_), work = std::move(work),
+                  done = std::move(done)] {
+        // Ops are only dropped on the loop thread once their job is done,
+        // or by the destructor after waiting for it.
+        work(*target);
+        loop_.post([this, id, alive, done] {
+            if (alive.expired()) return;
+            const auto it = ops_.find(id);
+            if (it != ops_.end()) done(*it->second);
+        });
+        loop_.release();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--jobs_ == 0) jobs_done_.notify_all();
+    });
+}
+
+void AsyncIo::resolve(Op& op, const Value& result) {
+    const Value task = op.task.get();
+    close(op);
+    ops_.erase(op.id);
+    vm_.resolve(task, result);
+}
+
+void AsyncIo::reject(Op& op, std::string message) {
+    const Value task = op.task.get();
+    close(op);
+    ops_.erase(op.id);
+    vm_.reject(task, std::move(message));
+}
+
+void AsyncIo::close(Op& op) {
+    if (op.timer) loop_.cancel_timer(op.timer);
+    op.timer = 0;
+    if (Process* p = op.process.get()) {
+        for (int* fd : {&p->in, &p->out, &p->err}) {
+            if (*fd >= 0) loop_.unwatch(*fd);
+            close_fd(*fd);
+        }
+        if (p->pid > 0) {
+            ::kill(p->pid, SIGKILL);
+            while (::waitpid(p->pid, nullptr, 0) < 0 && errno == EINTR) {
+            }
+            p->pid = -1;
+        }
+    }
+    if (Socket* s = op.socket.get()) {
+        if (s->fd >= 0) loop_.unwatch(s->fd);
+        close_fd(s->fd);
+    }
+}
+
+Value AsyncIo::sleep(double ms) {
+    Value task;
+    Op& op = begin(task);
+    // NaN and negative delays are none; a trillion milliseconds is forever.
+    const std::chrono::duration<double, std::milli> delay(ms > 0 ? std::min(ms, 1e12) : 0.0);
+    op.timer = loop_.add_timer(std::chrono::duration_cast<EventLoop::Clock::duration>(delay), [this, id = op.id] {
+        const auto it = ops_.find(id);
+        if (it == ops_.end()) return;
+        it->second->timer = 0;
+        resolve(*it->second, Value());
+    });
+    return task;
+}
+
+Value AsyncIo::read_file(std::string path) {
+    Value task;
+    Op& op = begin(task);
+    offload(
+        op,
+        [path = std::move(path)](Op& op) {
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                op.error = "read_file: " + path + ": " + os_message(errno);
+                return;
+            }
+            struct stat info {};
+            if (::fstat(fd, &info) == 0 && info.st_size > 0) op.text.reserve(static_cast<std::size_t>(info.st_size));
+            std::vector<char> buffer(kChunk);
+            for (;;) {
+                const ssize_t n = ::read(fd, buffer.data(), buffer.size());
+                if (n > 0) {
+                    op.text.append(buffer.data(), static_cast<std::size_t>(n));
+                } else if (n == 0) {
+                    break;
+                } else if (errno != EINTR) {
+                    op.error = "read_file: " + path + ": " + os_message(errno);
+                    break;
+                }
+            }
+            ::close(fd);
+        },
+        [this](Op& op) {
+            if (!op.error.empty()) {
+                reject(op, op.error);
+            } else {
+                resolve(op, vm_.new_string(op.text));
+            }
+        });
+    return task;
+}
+
+Value AsyncIo::write_file(std::string path, std::string text) {
+    Value task;
+    Op& op = begin(task);
+    offload(
+        op,
+        [path = std::move(path), text = std::move(text)](Op& op) {
+            const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            if (fd < 0) {
+                op.error = "write_file: " + path + ": " + os_message(errno);
+                return;
+            }
+            std::size_t written = 0;
+            while (written < text.size()) {
+                const ssize_t n = ::write(fd, text.data() + written, text.size() - written);
+                if (n >= 0) {
+                    written += static_cast<std::size_t>(n);
+                } else if (errno != EINTR) {
+                    op.error = "write_file: " + path + ": " + os_message(errno);
+                    break;
+                }
+            }
+            if (::close(fd) < 0 && op.error.empty()) op.error = "write_file: " + path + ": " + os_message(errno);
+        },
+        [this](Op& op) {
+            if (!op.error.empty()) {
+                reject(op, op.error);
+            } else {
+                resolve(op, Value());
+            }
+        });
+    return task;
+}
+
+Value AsyncIo::exec(Table* argv, std::optional<std::string> input) {
+    std::vector<std::string> args;
+    for (const Value& v : argv->array()) {
+        if (!v.is_string()) throw RuntimeError("exec: argv must hold strings, got " + std::string(type_name(v.type())));
+        args.emplace_back(v.as_string()->view());
+    }
+    if (args.empty()) throw RuntimeError("exec: argv is empty");
+    std::vector<char*> pointers;
+    for (std::string& a : args) pointers.push_back(a.data());
+    pointers.push_back(nullptr);
+
+    Value task;
+    Op& op = begin(task);
+    op.process = std::make_unique<Process>();
+    Process& p = *op.process;
+    if (input) p.input = std::move(*input);
+
+    // [0] is the parent's end of each pipe, [1] the child's.
+    int in[2] = {-1, -1};
+    int out[2] = {-1, -1};
+    int err[2] = {-1, -1};
+    int error = 0;
+    if (!make_pipe(in) || !make_pipe(out) || !make_pipe(err)) error = errno;
+    std::swap(in[0], in[1]);  // the parent writes standard input
+    if (!error) {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, in[1], 0);
+        posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+        posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+        error = ::posix_spawnp(&p.pid, pointers[0], &actions, nullptr, pointers.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (error) p.pid = -1;
+    }
+    for (int* fds : {in, out, err}) close_fd(fds[1]);
+    p.in = in[0];
+    p.out = out[0];
+    p.err = err[0];
+    if (error) {
+        reject(op, "exec: " + args[0] + ": " + os_message(error));
+        return task;
+    }
+
+    const std::uint64_t id = op.id;
+    for (const int fd : {p.in, p.out, p.err}) set_nonblocking(fd);
+    if (p.input.empty()) {
+        close_fd(p.in);
+    } else {
+        loop_.watch(p.in, EventLoop::kWritable, [this, id](std::uint32_t) { process_input(id); });
+    }
+    loop_.watch(p.out, EventLoop::kReadable, [this, id](std::uint32_t) { process_output(id, false); });
+    loop_.watch(p.err, EventLoop::kReadable, [this, id](std::uint32_t) { process_output(id, true); });
+    return task;
+}
+
+void AsyncIo::process_input(std::uint64_t id) {
+    const auto it = ops_.find(id);
+    if (it == ops_.end()) return;
+    Process& p = *it->second->process;
+    const ssize_t n = write_quietly(p.in, p.input.data() + p.written, p.input.size() - p.written);
+    if (n > 0) p.written += static_cast<std::size_t>(n);
+    // A process that stops reading (EPIPE) just misses the rest.
+    if (p.written == p.input.size() || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        loop_.unwatch(p.in);
+        close_fd(p.in);
+        p.input = std::string();
+    }
+}
+
+void AsyncIo::process_output(std::uint64_t id, bool err) {
+    const auto it = ops_.find(id);
+    if (it == ops_.end()) return;
+    Process& p = *it->second->process;
+    int& fd = err ? p.err : p.out;
+    std::string& text = err ? p.err_text : p.out_text;
+    char buffer[kChunk];
+    for (;;) {
+        const ssize_t n = ::read(fd, buffer, sizeof buffer);
+        if (n > 0) {
+            text.append(buffer, static_cast<std::size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        // End of file, or an error that ends it the same way.
+        loop_.unwatch(fd);
+        close_fd(fd);
+        break;
+    }
+    if (p.out < 0 && p.err < 0) reap(id, 1);
+}
+
+void AsyncIo::reap(std::uint64_t id, int delay_ms) {
+    const auto it = ops_.find(id);
+    if (it == ops_.end()) return;
+    Op& op = *it->second;
+    Process& p = *op.process;
+    int status = 0;
+    pid_t reaped;
+    do {
+        reaped = ::waitpid(p.pid, &status, WNOHANG);
+    } while (reaped < 0 && errno == EINTR);
+    if (reaped == 0) {
+        // Closed its output but still running: look again, less and less often.
+        op.timer = loop_.add_timer(std::chrono::milliseconds(delay_ms), [this, id, delay_ms] {
+            const auto found = ops_.find(id);
+            if (found == ops_.end()) return;
+            found->second->timer = 0;
+            reap(id, std::min(delay_ms * 2, 64));
+        });
+        return;
+    }
+    if (reaped < 0) {
+        const int error = errno;
+        p.pid = -1;
+        reject(op, "exec: waitpid: " + os_message(error));
+        return;
+    }
+    p.pid = -1;
+    const double code = WIFEXITED(status) ? WEXITSTATUS(status) : WIFSIGNALED(status) ? -WTERMSIG(status) : -1;
+    const Value result = vm_.new_table(0, 3);
+    Table* t = result.as_table();
+    vm_.table_set(t, Value::object(vm_.intern("status")), Value::number(code));
+    vm_.table_set(t, Value::object(vm_.intern("out")), vm_.new_string(p.out_text));
+    vm_.table_set(t, Value::object(vm_.intern("err")), vm_.new_string(p.err_text));
+    resolve(op, result);
+}
+
+Value AsyncIo::tcp_request(std::string host, int port, std::optional<std::string> data) {
+    if (port < 1 || port > 65535) throw RuntimeError("tcp_request: port " + std::to_string(port) + " out of range");
+    Value task;
+    Op& op = begin(task);
+    op.socket = std::make_unique<Socket>();
+    op.socket->where = host + ":" + std::to_string(port);
+    if (data) op.socket->data = std::move(*data);
+    offload(
+        op,
+        [host = std::move(host), port](Op& op) {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_NUMERICSERV;
+            const int error = ::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &op.socket->addresses);
+            if (error) op.error = "tcp_request: " + op.socket->where + ": " + ::gai_strerror(error);
+        },
+        [this](Op& op) {
+            if (!op.error.empty()) {
+                reject(op, op.error);
+                return;
+            }
+            op.socket->next = op.socket->addresses;
+            connect_next(op);
+        });
+    return task;
+}
+
+void AsyncIo::connect_next(Op& op) {
+    Socket& s = *op.socket;
+    if (s.fd >= 0) loop_.unwatch(s.fd);
+    close_fd(s.fd);
+    while (s.next) {
+        const addrinfo* address = s.next;
+        s.next = address->ai_next;
+        s.fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (s.fd < 0) {
+            s.last_error = errno;
+            continue;
+        }
+        ::fcntl(s.fd, F_SETFD, FD_CLOEXEC);
+        set_nonblocking(s.fd);
+#if defined(SO_NOSIGPIPE)
+        const int one = 1;
+        ::setsockopt(s.fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+        if (::connect(s.fd, address->ai_addr, address->ai_addrlen) == 0 || errno == EINPROGRESS) {
+            loop_.watch(s.fd, EventLoop::kWritable, [this, id = op.id](std::uint32_t events) { socket_ready(id, events); });
+            return;
+        }
+        s.last_error = errno;
+        close_fd(s.fd);
+    }
+    reject(op, "tcp_request: connect to " + s.where + ": " + os_message(s.last_error));
+}
+
+void AsyncIo::socket_ready(std::uint64_t id, std::uint32_t) {
+    const auto it = ops_.find(id);
+    if (it == ops_.end()) return;
+    Op& op = *it->second;
+    Socket& s = *op.socket;
+
+    if (!s.connected) {
+        int error = 0;
+        socklen_t size = sizeof error;
+        if (::getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0) error = errno;
+        if (error) {
+            s.last_error = error;
+            connect_next(op);
+            return;
+        }
+        s.connected = true;
+    }
+
+    if (s.sending) {
+        while (s.sent < s.data.size()) {
+            const ssize_t n = ::send(s.fd, s.data.data() + s.sent, s.data.size() - s.sent, kSendFlags);
+            if (n >= 0) {
+                s.sent += static_cast<std::size_t>(n);
+                continue;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            reject(op, "tcp_request: send to " + s.where + ": " + os_message(errno));
+            return;
+        }
+        s.sending = false;
+        s.data = std::string();
+        ::shutdown(s.fd, SHUT_WR);
+        loop_.watch(s.fd, EventLoop::kReadable, [this, id](std::uint32_t events) { socket_ready(id, events); });
+        return;
+    }
+
+    char buffer[kChunk];
+    for (;;) {
+        const ssize_t n = ::recv(s.fd, buffer, sizeof buffer, 0);
+        if (n > 0) {
+            s.received.append(buffer, static_cast<std::size_t>(n));
+            continue;
+        }
+        if (n == 0) {
+            resolve(op, vm_.new_string(s.received));
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        reject(op, "tcp_request: receive from " + s.where + ": " + os_message(errno));
+        return;
+    }
+}
+
+}  // namespace rebel::script
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "core/event_loop.h"
+#include "core/thread_pool.h"
+#include "script/vm.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace rebel::script {
+
+/// File, process and network I/O for async scripts, on an event loop.
+/// Installs natives that start an operation and return a task for it at
+/// once (see VM::run_tasks()):
+///
+///   sleep(ms)                      nil, after `ms` milliseconds
+///   read_file(path)                the file's contents
+///   write_file(path, text)         nil, once written
+///   exec(argv [, input])           {status, out, err} of a process
+///   tcp_request(host, port [, data])  what the peer sent before closing
+///
+/// so that, say, formatting many files takes one thread however many run
+/// at once:
+///
+///   async fn format(path) {
+///       let r = await exec(["clang-format"], await read_file(path))
+///       if r.status == 0 { await write_file(path, r.out) }
+///   }
+///   async fn format_all(paths) {
+///       let tasks = []
+///       for i, p in paths { push(tasks, format(p)) }  // none has run yet
+///       await all(tasks)
+///   }
+///
+/// Processes and sockets are non-blocking descriptors the loop watches, so
+/// any number of them can be in flight with no thread each. Regular files
+/// are always ready as far as epoll and poll() are concerned, so file
+/// reads and writes, and host name lookups, run on the thread pool as in
+/// libuv; pool threads never touch the VM, and the loop thread turns their
+/// results into values. exec() looks argv[0] up on PATH and feeds `input`
+/// to the process's standard input; `status` is its exit code, or minus
+/// the signal that ended it. tcp_request() sends `data`, shuts down its
+/// side and reads until the peer closes. Failures reject the task with a
+/// message naming the operation and the OS error.
+///
+/// The VM, the loop and this object belong to one thread. Scripts run
+/// when the host calls run() or run_until(), or runs the loop and
+/// VM::run_tasks() itself, never from within a loop callback. The object
+/// must outlive every script call that can reach its natives.
+class AsyncIo {
+public:
+    /// Defines the natives in `vm`.
+    AsyncIo(VM& vm, core::EventLoop& loop, core::ThreadPool& pool);
+    /// Kills processes still running, closes sockets and waits for pool
+    /// jobs. Their tasks stay pending.
+    ~AsyncIo();
+    AsyncIo(const AsyncIo&) = delete;
+    AsyncIo& operator=(const AsyncIo&) = delete;
+
+    /// Runs tasks and the loop until `task` settles. Returns its result or
+    /// throws its RuntimeError, which counts as observing it; other values
+    /// are returned as they are. Throws RuntimeError if nothing is left
+    /// that could settle it.
+    Value run_until(const Value& task);
+    /// Runs tasks and the loop until neither has anything left to do.
+    void run();
+
+    /// Operations started and not finished.
+    std::size_t pending() const noexcept { return ops_.size(); }
+
+private:
+    struct Op;
+    struct Process;
+    struct Socket;
+
+    Value sleep(double ms);
+    Value read_file(std::string path);
+    Value write_file(std::string path, std::string text);
+    Value exec(Table* argv, std::optional<std::string> input);
+    Value tcp_request(std::string host, int port, std::optional<std::string> data);
+
+    Op& begin(Value& task);
+    /// Runs `work` on the pool, then `done` on the loop thread.
+    void offload(Op& op, std::function<void(Op&)> work, std::function<void(Op&)> done);
+    void resolve(Op& op, const Value& result);
+    void reject(Op& op, std::string message);
+    void close(Op& op);
+
+    void process_input(std::uint64_t id);
+    void process_output(std::uint64_t id, bool err);
+    void reap(std::uint64_t id, int delay_ms);
+    void connect_next(Op& op);
+    void socket_ready(std::uint64_t id, std::uint32_t events);
+
+    VM& vm_;
+    core::EventLoop& loop_;
+    core::ThreadPool& pool_;
+    std::unordered_map<std::uint64_t, std::unique_ptr<Op>> ops_;
+    std::uint64_t next_op_ = 0;
+    /// Expires with this object; completions posted after that find it so.
+    std::shared_ptr<char> alive_;
+
+    std::mutex mutex_;  // guards jobs_
+    std::condition_variable jobs_done_;
+    std::size_t jobs_ = 0;  // pool jobs not yet finished
+};
+
+}  // namespace rebel::script
@@ -0,0 +1,36 @@
+#include "script/bind.h"
+
+namespace rebel::script {
+namespace {
+
+std::string prefix(const NativeArgs& args, int index) {
+    std::string out = args.name ? *args.name + ": " : std::string();
+    return out + "argument " + std::to_string(index + 1);
+}
+
+// "a number", "a string or nil", ...
+std::string describe(TypeMask accepts) {
+    std::string out;
+    const bool nil = accepts & type_bit(ValueType::Nil);
+    for (unsigned t = static_cast<unsigned>(ValueType::Bool); t <= static_cast<unsigned>(ValueType::Task); ++t) {
+        const auto type = static_cast<ValueType>(t);
+        if (!(accepts & type_bit(type))) continue;
+        out += out.empty() ? "a " : " or a ";
+        out += type_name(type);
+    }
+    if (nil) out += out.empty() ? "nil" : " or nil";
+    return out;
+}
+
+}  // namespace
+
+void argument_error(const NativeArgs& args, int index, TypeMask accepts) {
+    throw RuntimeError(prefix(args, index) + " must be " + describe(accepts) + ", got " +
+                       type_name(args[index].type()));
+}
+
+void integer_error(const NativeArgs& args, int index) {
+    throw RuntimeError(prefix(args, index) + " must be an integer in range");
+}
+
+}  // namespace rebel::script
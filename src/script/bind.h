@@ -0,0 +1,262 @@
+#pragma once
+
+// Compile-time bindings from C++ functions to script natives.
+//
+//   double distance(double x, double y);
+//   vm.define_native("distance", script::native<&distance>());
+//
+//   std::string Document::line(std::size_t n) const;
+//   script::ObjectBinding<Document>(vm, doc).method<&Document::line>("line").define("doc");
+//
+// Marshalling is generated per signature: type checks read a constexpr
+// table of accepted value types, and each argument converts straight from
+// its stack slot. A call costs what a hand-written native would.
+
+#include "script/error.h"
+#include "script/object.h"
+#include "script/value.h"
+#include "script/vm.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace rebel::script {
+
+/// Bit per ValueType that an argument accepts.
+using TypeMask = std::uint8_t;
+
+constexpr TypeMask type_bit(ValueType t) { return static_cast<TypeMask>(1u << static_cast<unsigned>(t)); }
+constexpr TypeMask kAnyType = 0xff;
+
+/// Raises "name: argument N must be <accepted>, got <type>". `index` is 0-based.
+[[noreturn]] void argument_error(const NativeArgs& args, int index, TypeMask accepts);
+/// Same, for a number that is not a representable integer.
+[[noreturn]] void integer_error(const NativeArgs& args, int index);
+
+/// How a C++ type crosses the script boundary. Parameter types need
+/// `kAccepts` and `from()`, return types `to()`; `kArgument` is false for
+/// parameters that take no script argument. Specialize for further types.
+template <typename T, typename = void>
+struct Marshal;
+
+template <>
+struct Marshal<Value> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = kAnyType;
+    static Value from(VM&, const NativeArgs& args, int i) { return args[i]; }
+    static Value to(VM&, const Value& v) { return v; }
+};
+
+/// The calling VM, passed through; takes no script argument.
+template <>
+struct Marshal<VM> {
+    static constexpr bool kArgument = false;
+    static constexpr TypeMask kAccepts = kAnyType;
+    static VM& from(VM& vm, const NativeArgs&, int) { return vm; }
+};
+
+/// Truthiness, as in conditions: any value is accepted.
+template <>
+struct Marshal<bool> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = kAnyType;
+    static bool from(VM&, const NativeArgs& args, int i) { return args[i].truthy(); }
+    static Value to(VM&, bool b) { return Value::boolean(b); }
+};
+
+template <typename T>
+struct Marshal<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = type_bit(ValueType::Number);
+    static T from(VM&, const NativeArgs& args, int i) { return static_cast<T>(args.values[i].as_number()); }
+    static Value to(VM&, T d) { return Value::number(static_cast<double>(d)); }
+};
+
+/// Integers must be whole numbers within the type's range.
+template <typename T>
+struct Marshal<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = type_bit(ValueType::Number);
+    static T from(VM&, const NativeArgs& args, int i) {
+        const double d = args.values[i].as_number();
+        // 2^digits is exact in a double, unlike the type's maximum.
+        const double limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+        const double low = std::is_signed_v<T> ? -limit : 0.0;
+        if (!(d >= low && d < limit) || d != std::trunc(d)) integer_error(args, i);
+        return static_cast<T>(d);
+    }
+    static Value to(VM&, T n) { return Value::number(static_cast<double>(n)); }
+};
+
+/// Views the script string in place; valid for the duration of the call.
+template <>
+struct Marshal<std::string_view> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = type_bit(ValueType::String);
+    static std::string_view from(VM&, const NativeArgs& args, int i) { return args.values[i].as_string()->view(); }
+    static Value to(VM& vm, std::string_view s) { return vm.new_string(s); }
+};
+
+template <>
+struct Marshal<std::string> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = type_bit(ValueType::String);
+    static std::string from(VM&, const NativeArgs& args, int i) {
+        return std::string(args.values[i].as_string()->view());
+    }
+    static Value to(VM& vm, const std::string& s) { return vm.new_string(s); }
+};
+
+template <>
+struct Marshal<String*> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = type_bit(ValueType::String);
+    static String* from(VM&, const NativeArgs& args, int i) { return args.values[i].as_string(); }
+    static Value to(VM&, String* s) { return s ? Value::object(s) : Value(); }
+};
+
+template <>
+struct Marshal<Table*> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = type_bit(ValueType::Table);
+    static Table* from(VM&, const NativeArgs& args, int i) { return args.values[i].as_table(); }
+    static Value to(VM&, Table* t) { return t ? Value::object(t) : Value(); }
+};
+
+/// nil maps to nullopt, both ways.
+template <typename T>
+struct Marshal<std::optional<T>> {
+    static constexpr bool kArgument = true;
+    static constexpr TypeMask kAccepts = Marshal<T>::kAccepts | type_bit(ValueType::Nil);
+    static std::optional<T> from(VM& vm, const NativeArgs& args, int i) {
+        if (args[i].is_nil()) return std::nullopt;
+        return Marshal<T>::from(vm, args, i);
+    }
+    static Value to(VM& vm, const std::optional<T>& v) { return v ? Marshal<T>::to(vm, *v) : Value(); }
+};
+
+namespace bind_detail {
+
+template <typename T>
+using Bare = std::remove_cv_t<std::remove_reference_t<T>>;
+
+// Per-parameter tables for one signature, all computed at compile time.
+template <typename... A>
+struct Params {
+    static constexpr std::size_t kCount = sizeof...(A);
+    static constexpr std::array<bool, kCount> kArgument = {Marshal<Bare<A>>::kArgument...};
+    static constexpr std::array<TypeMask, kCount> kAccepts = {Marshal<Bare<A>>::kAccepts...};
+    // Script argument each parameter reads; parameters such as VM& read none.
+    static constexpr std::array<int, kCount> kIndex = [] {
+        std::array<int, kCount> index{};
+        int next = 0;
+        for (std::size_t p = 0; p < kCount; ++p) index[p] = kArgument[p] ? next++ : -1;
+        return index;
+    }();
+
+    static void check(const NativeArgs& args) {
+        for (std::size_t p = 0; p < kCount; ++p) {
+            if (kAccepts[p] == kAnyType) continue;
+            if (!(kAccepts[p] & type_bit(args[kIndex[p]].type()))) argument_error(args, kIndex[p], kAccepts[p]);
+        }
+    }
+
+    template <typename R, typename Call, std::size_t... I>
+    static Value invoke(VM& vm, const NativeArgs& args, Call&& call, std::index_sequence<I...>) {
+        check(args);
+        if constexpr (std::is_void_v<R>) {
+            call(Marshal<Bare<A>>::from(vm, args, kIndex[I])...);
+            return Value();
+        } else {
+            return Marshal<Bare<R>>::to(vm, call(Marshal<Bare<A>>::from(vm, args, kIndex[I])...));
+        }
+    }
+};
+
+template <typename F>
+struct Signature;
+
+template <typename R, typename... A>
+struct Signature<R (*)(A...)> {
+    using Class = void;
+    using Return = R;
+    using Args = Params<A...>;
+};
+template <typename R, typename... A>
+struct Signature<R (*)(A...) noexcept> : Signature<R (*)(A...)> {};
+
+template <typename R, typename C, typename... A>
+struct Signature<R (C::*)(A...)> {
+    using Class = C;
+    using Return = R;
+    using Args = Params<A...>;
+};
+template <typename R, typename C, typename... A>
+struct Signature<R (C::*)(A...) const> : Signature<R (C::*)(A...)> {};
+template <typename R, typename C, typename... A>
+struct Signature<R (C::*)(A...) noexcept> : Signature<R (C::*)(A...)> {};
+template <typename R, typename C, typename... A>
+struct Signature<R (C::*)(A...) const noexcept> : Signature<R (C::*)(A...)> {};
+
+template <auto F>
+Value thunk(VM& vm, NativeArgs args) {
+    using S = Signature<decltype(F)>;
+    using Return = typename S::Return;
+    using Args = typename S::Args;
+    constexpr auto sequence = std::make_index_sequence<Args::kCount>();
+    if constexpr (std::is_void_v<typename S::Class>) {
+        return Args::template invoke<Return>(
+            vm, args, [](auto&&... a) -> decltype(auto) { return F(std::forward<decltype(a)>(a)...); }, sequence);
+    } else {
+        auto* self = static_cast<typename S::Class*>(args.userdata);
+        return Args::template invoke<Return>(
+            vm, args, [self](auto&&... a) -> decltype(auto) { return (self->*F)(std::forward<decltype(a)>(a)...); },
+            sequence);
+    }
+}
+
+}  // namespace bind_detail
+
+/// A native for the function or member function `F`, marshalled at
+/// compile time. Member functions are called on the native's userdata,
+/// so define them with the object: define_native(name, native<&C::m>(), &obj).
+template <auto F>
+constexpr NativeFn native() {
+    return &bind_detail::thunk<F>;
+}
+
+/// Exposes one C++ object to scripts as a table of bound methods. The
+/// object must outlive every script call that can reach the table.
+template <typename C>
+class ObjectBinding {
+public:
+    ObjectBinding(VM& vm, C& object) : vm_(vm), object_(&object), table_(vm, vm.new_table()) {}
+
+    template <auto M>
+    ObjectBinding& method(std::string_view name) {
+        static_assert(std::is_same_v<typename bind_detail::Signature<decltype(M)>::Class, C>,
+                      "method of another class");
+        const Value fn = Value::object(vm_.heap().make_native(std::string(name), native<M>(), object_));
+        vm_.table_set(table().as_table(), Value::object(vm_.intern(name)), fn);
+        return *this;
+    }
+
+    Value table() const { return table_.get(); }
+    /// Makes the table a global.
+    void define(std::string_view global) { vm_.set_global(global, table()); }
+
+private:
+    VM& vm_;
+    C* object_;
+    VM::Handle table_;
+};
+
+}  // namespace rebel::script
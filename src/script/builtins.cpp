@@ -0,0 +1,211 @@
+#include "script/bind.h"
+#include "script/vm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+namespace rebel::script {
+namespace {
+
+double number_arg(const NativeArgs& args, int i, const char* fn) {
+    const Value v = args[i];
+    if (!v.is_number()) {
+        throw RuntimeError(std::string(fn) + ": argument " + std::to_string(i + 1) + " must be a number, got " +
+                           type_name(v.type()));
+    }
+    return v.as_number();
+}
+
+String* string_arg(const NativeArgs& args, int i, const char* fn) {
+    const Value v = args[i];
+    if (!v.is_string()) {
+        throw RuntimeError(std::string(fn) + ": argument " + std::to_string(i + 1) + " must be a string, got " +
+                           type_name(v.type()));
+    }
+    return v.as_string();
+}
+
+Table* table_arg(const NativeArgs& args, int i, const char* fn) {
+    const Value v = args[i];
+    if (!v.is_table()) {
+        throw RuntimeError(std::string(fn) + ": argument " + std::to_string(i + 1) + " must be a table, got " +
+                           type_name(v.type()));
+    }
+    return v.as_table();
+}
+
+// Clamps a 0-based index argument into [0, size].
+std::size_t index_arg(const NativeArgs& args, int i, std::size_t fallback, std::size_t size, const char* fn) {
+    if (args[i].is_nil()) return fallback;
+    const double d = number_arg(args, i, fn);
+    if (d <= 0) return 0;
+    return std::min(static_cast<std::size_t>(d), size);
+}
+
+Value print(VM& vm, NativeArgs args) {
+    std::string line;
+    for (int i = 0; i < args.count; ++i) {
+        if (i > 0) line.push_back(' ');
+        line += vm.to_display_string(args.values[i]);
+    }
+    vm.print(line);
+    return Value();
+}
+
+Value len(VM&, NativeArgs args) {
+    const Value v = args[0];
+    if (v.is_string()) return Value::number(v.as_string()->length);
+    if (v.is_table()) return Value::number(static_cast<double>(v.as_table()->length()));
+    throw RuntimeError(std::string("len: expected a string or table, got ") + type_name(v.type()));
+}
+
+Value str(VM& vm, NativeArgs args) {
+    if (args[0].is_string()) return args[0];
+    return vm.new_string(vm.to_display_string(args[0]));
+}
+
+Value num(VM&, NativeArgs args) {
+    const Value v = args[0];
+    if (v.is_number()) return v;
+    if (!v.is_string()) return Value();
+    const std::string text(v.as_string()->view());
+    char* end = nullptr;
+    const double d = std::strtod(text.c_str(), &end);
+    if (end == text.c_str()) return Value();
+    while (*end == ' ' || *end == '\t') ++end;
+    return *end == '\0' ? Value::number(d) : Value();
+}
+
+Value type(VM& vm, NativeArgs args) { return vm.new_string(type_name(args[0].type())); }
+
+Value push(VM& vm, NativeArgs args) {
+    Table* t = table_arg(args, 0, "push");
+    vm.table_set(t, Value::number(static_cast<double>(t->length())), args[1]);
+    return Value();
+}
+
+Value pop(VM& vm, NativeArgs args) {
+    Table* t = table_arg(args, 0, "pop");
+    if (t->length() == 0) return Value();
+    const Value key = Value::number(static_cast<double>(t->length() - 1));
+    const Value last = t->get(key);
+    vm.table_set(t, key, Value());
+    return last;
+}
+
+Value join(VM& vm, NativeArgs args) {
+    const Table* t = table_arg(args, 0, "join");
+    const std::string_view sep = args[1].is_nil() ? std::string_view() : string_arg(args, 1, "join")->view();
+    std::string out;
+    bool first = true;
+    for (const Value& v : t->array()) {
+        if (!first) out += sep;
+        first = false;
+        out += vm.to_display_string(v);
+    }
+    return vm.new_string(out);
+}
+
+// sub(s, start[, end]): bytes [start, end) of s.
+Value sub(VM& vm, NativeArgs args) {
+    const String* s = string_arg(args, 0, "sub");
+    const std::size_t start = index_arg(args, 1, 0, s->length, "sub");
+    const std::size_t end = index_arg(args, 2, s->length, s->length, "sub");
+    if (start >= end) return vm.new_string({});
+    return vm.new_string(s->view().substr(start, end - start));
+}
+
+// find(s, needle[, start]): index of the first match, or nil.
+Value find(VM&, NativeArgs args) {
+    const String* s = string_arg(args, 0, "find");
+    const String* needle = string_arg(args, 1, "find");
+    const std::size_t start = index_arg(args, 2, 0, s->length, "find");
+    const std::size_t at = s->view().find(needle->view(), start);
+    return at == std::string_view::npos ? Value() : Value::number(static_cast<double>(at));
+}
+
+double sqrt(double x) { return std::sqrt(x); }
+double floor(double x) { return std::floor(x); }
+double abs(double x) { return std::fabs(x); }
+
+Value min(VM&, NativeArgs args) {
+    double m = number_arg(args, 0, "min");
+    for (int i = 1; i < args.count; ++i) m = std::min(m, number_arg(args, i, "min"));
+    return Value::number(m);
+}
+
+Value max(VM&, NativeArgs args) {
+    double m = number_arg(args, 0, "max");
+    for (int i = 1; i < args.count; ++i) m = std::max(m, number_arg(args, i, "max"));
+    return Value::number(m);
+}
+
+double clock() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+Value error(VM& vm, NativeArgs args) { throw RuntimeError(vm.to_display_string(args[0])); }
+
+// all(tasks): a task that waits for every task in an array, see VM::all().
+Value all(VM& vm, NativeArgs args) {
+    const Table* t = table_arg(args, 0, "all");
+    return vm.all(t->array().data(), t->length());
+}
+
+// gc_collect([major]): collects now; a major collection also compacts the
+// old generation.
+void gc_collect(VM& vm, bool major) { vm.collect_garbage(major); }
+
+// gc_stats(): heap counters as a table; sizes in bytes, pauses in ms.
+Value gc_stats(VM& vm, NativeArgs) {
+    const Heap::Stats s = vm.heap().stats();
+    const Value stats = vm.new_table(0, 16);
+    Table* t = stats.as_table();
+    auto field = [&](const char* name, double value) { vm.table_set(t, vm.new_string(name), Value::number(value)); };
+    field("nursery_capacity", static_cast<double>(s.nursery_capacity));
+    field("nursery_used", static_cast<double>(s.nursery_used));
+    field("old_bytes", static_cast<double>(s.old_bytes));
+    field("large_bytes", static_cast<double>(s.large_bytes));
+    field("minor_collections", static_cast<double>(s.minor_collections));
+    field("major_collections", static_cast<double>(s.major_collections));
+    field("bytes_allocated", static_cast<double>(s.bytes_allocated));
+    field("bytes_promoted", static_cast<double>(s.bytes_promoted));
+    field("survival_rate", s.last_survival_rate);
+    const double allocated = static_cast<double>(s.bytes_allocated);
+    field("mean_survival_rate", allocated > 0 ? static_cast<double>(s.bytes_promoted) / allocated : 0.0);
+    field("last_pause_ms", static_cast<double>(s.last_pause_ns) / 1e6);
+    field("max_pause_ms", static_cast<double>(s.max_pause_ns) / 1e6);
+    field("total_pause_ms", static_cast<double>(s.total_pause_ns) / 1e6);
+    return stats;
+}
+
+}  // namespace
+
+void open_builtins(VM& vm) {
+    vm.define_native("print", print);
+    vm.define_native("len", len);
+    vm.define_native("str", str);
+    vm.define_native("num", num);
+    vm.define_native("type", type);
+    vm.define_native("push", push);
+    vm.define_native("pop", pop);
+    vm.define_native("join", join);
+    vm.define_native("sub", sub);
+    vm.define_native("find", find);
+    vm.define_native("sqrt", native<&sqrt>());
+    vm.define_native("floor", native<&floor>());
+    vm.define_native("abs", native<&abs>());
+    vm.define_native("min", min);
+    vm.define_native("max", max);
+    vm.define_native("clock", native<&clock>(), nullptr, true);
+    vm.define_native("error", error);
+    vm.define_native("all", all);
+    vm.define_native("gc_collect", native<&gc_collect>());
+    vm.define_native("gc_stats", gc_stats);
+}
+
+}  // namespace rebel::script
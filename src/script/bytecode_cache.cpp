@@ -0,0 +1,263 @@
+#include "script/bytecode_cache.h"
+
+#include "core/hash.h"
+#include "core/mapped_file.h"
+#include "script/compiler.h"
+#include "script/debugger.h"
+#include "script/serialize.h"
+#include "script/vm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace rebel::script {
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr char kMagic[6] = {'R', 'B', 'L', 'B', 'C', '\0'};
+constexpr const char* kExtension = ".rbc";
+
+struct Header {
+    char magic[6];
+    std::uint16_t version;
+    std::uint64_t key;
+    std::uint64_t payload_bytes;
+    std::uint64_t payload_hash;
+};
+static_assert(sizeof(Header) == 32, "bytecode cache header layout");
+
+std::int64_t file_time(const fs::path& path, std::error_code& error) {
+    return static_cast<std::int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+}
+
+std::int64_t now() { return static_cast<std::int64_t>(fs::file_time_type::clock::now().time_since_epoch().count()); }
+
+// The key in an entry's file name, or false for other files.
+bool parse_name(const fs::path& path, std::uint64_t& key) {
+    const std::string name = path.filename().string();
+    if (name.size() != 16 + std::strlen(kExtension) || name.compare(16, std::string::npos, kExtension) != 0) {
+        return false;
+    }
+    key = 0;
+    for (std::size_t i = 0; i < 16; ++i) {
+        const char c = name[i];
+        const int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) return false;
+        key = key << 4 | static_cast<std::uint64_t>(digit);
+    }
+    return true;
+}
+
+unsigned long process_id() {
+#ifdef _WIN32
+    return static_cast<unsigned long>(_getpid());
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+}  // namespace
+
+BytecodeCache::BytecodeCache(std::string dir, std::uint64_t max_bytes) : dir_(std::move(dir)), max_bytes_(max_bytes) {
+    std::error_code error;
+    fs::create_directories(dir_, error);
+    for (fs::directory_iterator it(dir_, error), end; !error && it != end; it.increment(error)) {
+        std::uint64_t key;
+        if (!parse_name(it->path(), key)) continue;
+        std::error_code stat_error;
+        const std::uint64_t bytes = it->file_size(stat_error);
+        const std::int64_t used = file_time(it->path(), stat_error);
+        if (stat_error) continue;
+        entries_[key] = {bytes, used};
+        bytes_ += bytes;
+    }
+}
+
+std::uint64_t BytecodeCache::key(std::string_view source) { return key(core::hash64(source), kCompilerVersion); }
+
+std::uint64_t BytecodeCache::key(std::uint64_t content, std::uint32_t compiler) {
+    const std::uint64_t build = core::hash64(&compiler, sizeof compiler, serial::instruction_set_hash() + kVersion);
+    return core::hash64(&content, sizeof content, build);
+}
+
+std::string BytecodeCache::path(std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof name, "%016llx%s", static_cast<unsigned long long>(key), kExtension);
+    return dir_ + "/" + name;
+}
+
+Function* BytecodeCache::compile(VM& vm, std::string_view source, std::string chunk) {
+    const std::uint64_t k = key(source);
+    if (Function* fn = load(vm, k, chunk)) return fn;
+    Function* fn = vm.compile(source, std::move(chunk));
+    store(vm, k, *fn);
+    return fn;
+}
+
+Function* BytecodeCache::load(VM& vm, std::uint64_t key, std::string chunk, std::string* metadata) {
+    // Not found in the scan is no miss yet: another process sharing the
+    // directory may have stored the entry since.
+    const std::string file_path = path(key);
+    Function* fn = nullptr;
+    std::uint64_t bytes = 0;
+    bool damaged = false;
+    try {
+        const std::shared_ptr<const core::MappedFile> file = core::MappedFile::open(file_path);
+        bytes = file->size();
+        Header h;
+        if (file->size() < sizeof h) serial::In::damaged();
+        std::memcpy(&h, file->data(), sizeof h);
+        if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0 || h.version != kVersion || h.key != key ||
+            h.payload_bytes != file->size() - sizeof h) {
+            serial::In::damaged();
+        }
+        const std::string_view payload = file->view().substr(sizeof h);
+        if (core::hash64(payload) != h.payload_hash) serial::In::damaged();
+        serial::In in(payload);
+        const std::string_view stored = in.bytes(in.u32());
+        serial::ObjectReader objects(vm, in, std::make_shared<const std::string>(std::move(chunk)));
+        fn = objects.function(in.u32());
+        if (metadata) *metadata = std::string(stored);
+    } catch (const std::system_error&) {
+        damaged = true;  // not stored, or deleted by another process
+    } catch (const serial::DamagedError&) {
+        damaged = true;
+    } catch (const ImageError&) {
+        // A native this VM lacks; the entry is fine for others.
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (damaged) {
+        std::error_code error;
+        fs::remove(file_path, error);
+        forget(key);
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        it = entries_.emplace(key, Entry{bytes, 0}).first;
+        bytes_ += bytes;
+    }
+    it->second.used = now();
+    std::error_code error;
+    fs::last_write_time(file_path, fs::file_time_type::clock::now(), error);
+
+    vm.chunks_.push_back(fn);
+    if (vm.debugger_) vm.debugger_->loaded(*fn);
+    return fn;
+}
+
+void BytecodeCache::store(VM& vm, std::uint64_t key, const Function& fn, std::string_view metadata) {
+    serial::Out out;
+    out.u32(static_cast<std::uint32_t>(metadata.size()));
+    out.raw(metadata.data(), metadata.size());
+    try {
+        serial::ObjectWriter objects(vm);
+        Function* root = const_cast<Function*>(&fn);
+        objects.add(Value::object(root));
+        objects.write(out);
+        out.u32(objects.index(root));
+    } catch (const ImageError&) {
+        return;  // breakpoints patched into the code
+    }
+    const std::string& payload = out.bytes();
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof kMagic);
+    h.version = kVersion;
+    h.key = key;
+    h.payload_bytes = payload.size();
+    h.payload_hash = core::hash64(payload);
+
+    // Written aside and renamed, so readers in other processes never see
+    // a partial entry.
+    const std::string file_path = path(key);
+    // Named for the process and thread, so no other store shares it.
+    const std::string temp = file_path + ".tmp" + std::to_string(process_id()) + "_" +
+                             std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write(reinterpret_cast<const char*>(&h), sizeof h);
+        file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        file.flush();
+        if (!file) {
+            file.close();
+            std::error_code error;
+            fs::remove(temp, error);
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(temp, file_path, error);
+    if (error) {
+        fs::remove(temp, error);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    forget(key);
+    const std::uint64_t bytes = sizeof h + payload.size();
+    entries_[key] = {bytes, now()};
+    bytes_ += bytes;
+    ++stats_.stores;
+    evict(max_bytes_);
+}
+
+void BytecodeCache::forget(std::uint64_t key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return;
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+}
+
+void BytecodeCache::evict(std::uint64_t max_bytes) {
+    if (bytes_ <= max_bytes) return;
+    std::vector<std::pair<std::int64_t, std::uint64_t>> by_age;
+    by_age.reserve(entries_.size());
+    for (const auto& [key, entry] : entries_) by_age.emplace_back(entry.used, key);
+    std::sort(by_age.begin(), by_age.end());
+    for (const auto& [used, key] : by_age) {
+        if (bytes_ <= max_bytes) break;
+        std::error_code error;
+        fs::remove(path(key), error);
+        forget(key);
+        ++stats_.evictions;
+    }
+}
+
+void BytecodeCache::trim(std::uint64_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict(max_bytes);
+}
+
+void BytecodeCache::clear() { trim(0); }
+
+BytecodeCache::Stats BytecodeCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+}  // namespace rebel::script
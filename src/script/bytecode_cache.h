@@ -0,0 +1,106 @@
+#pragma once
+
+// On-disk cache of compiled chunks, one file per entry named by its key:
+//
+//   file    := header payload
+//   header  := "RBLBC\0" version:u16 key:u64 payload_bytes:u64 payload_hash:u64
+//   payload := metadata:(length:u32 bytes) objects root:u32
+//
+// where objects are the chunk's functions and their constants (see
+// script/serialize.h) and root is the chunk's function.
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace rebel::script {
+
+class VM;
+struct Function;
+
+/// Compiled bytecode kept on disk between runs, so scripts that have not
+/// changed are never lexed, parsed or compiled again.
+///
+/// Entries are keyed by a hash of what they were compiled from (source
+/// text, or a visual graph; see visual::compile_cached) together with the
+/// compiler version and instruction set, so editing a script or upgrading
+/// the editor simply misses. A hit maps the entry and allocates its
+/// functions straight from the mapping; the chunk name is the caller's, so
+/// identical sources loaded under different names share one entry.
+///
+/// The cache holds at most `max_bytes`; storing past that evicts the least
+/// recently used entries. Recency is the file's modification time, which a
+/// hit refreshes, so it survives restarts and is shared by processes using
+/// the same directory: entries another process stored after the scan are
+/// found on loading them, though each one's view of the total is only as
+/// fresh as its last scan, load or store. Damaged or stale entries are
+/// deleted when met.
+///
+/// Thread-safe; entries may be loaded into several VMs at once.
+class BytecodeCache {
+public:
+    static constexpr std::uint16_t kVersion = 1;
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t stores = 0;
+        std::uint64_t evictions = 0;
+        std::size_t entries = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    /// Uses `dir`, created if missing, holding at most `max_bytes`. Scans
+    /// the directory once for existing entries.
+    explicit BytecodeCache(std::string dir, std::uint64_t max_bytes = std::uint64_t{256} << 20);
+    BytecodeCache(const BytecodeCache&) = delete;
+    BytecodeCache& operator=(const BytecodeCache&) = delete;
+
+    /// The key for script source text.
+    static std::uint64_t key(std::string_view source);
+    /// The key for anything else compiled to bytecode: `content` identifies
+    /// it and `compiler` the version of what compiled it.
+    static std::uint64_t key(std::uint64_t content, std::uint32_t compiler);
+
+    /// Compiles `source` like VM::compile(), through the cache.
+    Function* compile(VM& vm, std::string_view source, std::string chunk);
+
+    /// The chunk stored under `key`, loaded into `vm` as a compiled chunk
+    /// named `chunk`, or null if there is none (or it is stale, or it
+    /// refers to a native `vm` lacks). `metadata`, if given, receives what
+    /// was stored with it.
+    Function* load(VM& vm, std::uint64_t key, std::string chunk, std::string* metadata = nullptr);
+    /// Stores the compiled chunk `fn` under `key` and evicts as needed.
+    /// Failing to write is not an error; the entry is just not cached.
+    void store(VM& vm, std::uint64_t key, const Function& fn, std::string_view metadata = {});
+
+    /// Deletes least recently used entries until at most `max_bytes` remain.
+    void trim(std::uint64_t max_bytes);
+    /// Deletes every entry.
+    void clear();
+
+    Stats stats() const;
+    const std::string& dir() const noexcept { return dir_; }
+
+private:
+    struct Entry {
+        std::uint64_t bytes = 0;
+        std::int64_t used = 0;  // ns since the epoch, file time
+    };
+
+    std::string path(std::uint64_t key) const;
+    void forget(std::uint64_t key);  // with mutex_ held
+    void evict(std::uint64_t max_bytes);  // with mutex_ held
+
+    std::string dir_;
+    std::uint64_t max_bytes_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::uint64_t, Entry> entries_;
+    std::uint64_t bytes_ = 0;
+    Stats stats_;
+};
+
+}  // namespace rebel::script
@@ -0,0 +1,774 @@
+#include "script/compiler.h"
+
+#include "script/ast.h"
+#include "script/error.h"
+#include "script/heap.h"
+#include "script/parser.h"
+#include "script/vm.h"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rebel::script {
+
+using namespace ast;
+
+namespace {
+
+constexpr int kMaxRegisters = 250;
+constexpr int kMaxConstants = kMaxBx + 1;
+constexpr int kMaxSmallConstant = 255;  // K operands of ABC instructions are 8 bits
+constexpr std::uint32_t kStillLive = ~std::uint32_t{0};  // end of a local's range while in scope
+
+struct Local {
+    std::string name;
+    int reg;
+};
+
+struct Loop {
+    std::vector<int> breaks;
+    std::vector<int> continues;  // patched once the continue target is known
+};
+
+struct FunctionState {
+    FunctionState* parent = nullptr;
+    Function* fn = nullptr;
+    std::vector<Local> locals;
+    std::vector<Loop> loops;
+    int free_reg = 0;
+    int block_depth = 0;
+    std::unordered_map<std::uint64_t, int> numbers;
+    std::unordered_map<std::string, int> strings;
+};
+
+bool is_comparison(Tok op) {
+    return op == Tok::Eq || op == Tok::Ne || op == Tok::Lt || op == Tok::Le || op == Tok::Gt || op == Tok::Ge;
+}
+
+Op arith_op(Tok op) {
+    switch (op) {
+        case Tok::Plus: case Tok::PlusAssign: return Op::Add;
+        case Tok::Minus: case Tok::MinusAssign: return Op::Sub;
+        case Tok::Star: case Tok::StarAssign: return Op::Mul;
+        case Tok::Slash: case Tok::SlashAssign: return Op::Div;
+        default: return Op::Mod;
+    }
+}
+
+// The constant-operand form of an arithmetic opcode.
+Op with_constant(Op op) {
+    return static_cast<Op>(static_cast<int>(op) - static_cast<int>(Op::Add) + static_cast<int>(Op::AddK));
+}
+
+class Compiler {
+public:
+    Compiler(VM& vm, std::shared_ptr<const std::string> chunk) : vm_(vm), chunk_(std::move(chunk)) {}
+
+    Function* compile_function(const FunctionDecl& decl, FunctionState* parent);
+
+private:
+    // --- emission ---------------------------------------------------------
+    [[noreturn]] void fail(const std::string& message, std::uint32_t line) const {
+        throw CompileError(message, *chunk_, line);
+    }
+    int pc() const { return static_cast<int>(fs_->fn->code.size()); }
+    int emit(Instruction i, std::uint32_t line) {
+        fs_->fn->code.push_back(i);
+        fs_->fn->lines.push_back(line);
+        return pc() - 1;
+    }
+    int emit_jump(std::uint32_t line) { return emit(encode_sj(Op::Jmp, 0), line); }
+    void patch(int at, int target) {
+        Instruction& i = fs_->fn->code[static_cast<std::size_t>(at)];
+        const int offset = target - (at + 1);
+        if (op_format(op_of(i)) == OpFormat::sJ) {
+            if (offset < kMinSJ || offset > kMaxSJ) fail("jump too long", fs_->fn->lines[static_cast<std::size_t>(at)]);
+            i = encode_sj(op_of(i), offset);
+        } else {
+            if (offset < kMinSBx || offset > kMaxSBx) fail("loop body too large", fs_->fn->lines[static_cast<std::size_t>(at)]);
+            i = encode_asbx(op_of(i), arg_a(i), offset);
+        }
+    }
+    void patch_here(const std::vector<int>& jumps) {
+        for (int j : jumps) patch(j, pc());
+    }
+
+    int alloc_reg(std::uint32_t line) {
+        const int r = fs_->free_reg++;
+        if (fs_->free_reg > kMaxRegisters) fail("function needs too many registers", line);
+        if (fs_->free_reg > fs_->fn->registers) fs_->fn->registers = static_cast<std::uint8_t>(fs_->free_reg);
+        return r;
+    }
+    void free_to(int reg) { fs_->free_reg = reg; }
+
+    int add_constant(const Value& v, std::uint32_t line) {
+        auto& constants = fs_->fn->constants;
+        if (constants.size() >= static_cast<std::size_t>(kMaxConstants)) fail("too many constants", line);
+        constants.push_back(v);
+        return static_cast<int>(constants.size() - 1);
+    }
+    int number_constant(double d, std::uint32_t line) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof bits);
+        auto it = fs_->numbers.find(bits);
+        if (it != fs_->numbers.end()) return it->second;
+        const int k = add_constant(Value::number(d), line);
+        fs_->numbers.emplace(bits, k);
+        return k;
+    }
+    int string_constant(const std::string& s, std::uint32_t line) {
+        auto it = fs_->strings.find(s);
+        if (it != fs_->strings.end()) return it->second;
+        const int k = add_constant(Value::object(vm_.intern(s)), line);
+        fs_->strings.emplace(s, k);
+        return k;
+    }
+
+    // --- names ------------------------------------------------------------
+    const Local* find_local(const FunctionState& fs, const std::string& name) const {
+        for (auto it = fs.locals.rbegin(); it != fs.locals.rend(); ++it) {
+            if (it->name == name) return &*it;
+        }
+        return nullptr;
+    }
+    const Local* resolve_local(const std::string& name, std::uint32_t line) const {
+        if (const Local* local = find_local(*fs_, name)) return local;
+        for (const FunctionState* fs = fs_->parent; fs; fs = fs->parent) {
+            if (find_local(*fs, name)) fail("cannot capture local '" + name + "' of an enclosing function", line);
+        }
+        return nullptr;
+    }
+    int global_slot(const std::string& name, std::uint32_t line) {
+        const std::uint32_t slot = vm_.global_slot(name);
+        if (slot > static_cast<std::uint32_t>(kMaxBx)) fail("too many globals", line);
+        return static_cast<int>(slot);
+    }
+    // `let` and `fn` outside every block of the main chunk define globals.
+    bool at_global_scope() const { return fs_->parent == nullptr && fs_->block_depth == 0; }
+    void declare_local(const std::string& name, int reg) {
+        fs_->locals.push_back({name, reg});
+        fs_->fn->locals.push_back({name, static_cast<std::uint8_t>(reg), static_cast<std::uint32_t>(pc()), kStillLive});
+    }
+    // Drops the locals declared after the first `keep`, ending their live
+    // ranges in the debug info at the current pc.
+    void end_locals(std::size_t keep) {
+        std::vector<Function::LocalVar>& info = fs_->fn->locals;
+        for (std::size_t n = fs_->locals.size() - keep, i = info.size(); n > 0 && i-- > 0;) {
+            if (info[i].end == kStillLive) {
+                info[i].end = static_cast<std::uint32_t>(pc());
+                --n;
+            }
+        }
+        fs_->locals.resize(keep);
+    }
+
+    // --- statements -------------------------------------------------------
+    void block(const Block& body);
+    void statement(const Stmt& s);
+    void let(const Stmt& s);
+    void assign(const Stmt& s);
+    void if_statement(const Stmt& s);
+    void while_loop(const Stmt& s);
+    void for_range(const Stmt& s);
+    void for_in(const Stmt& s);
+    void function_statement(const Stmt& s);
+    void finish_loop(int continue_target, int exit_target);
+
+    // --- expressions ------------------------------------------------------
+    void expr_to_reg(const Expr& e, int target);
+    int expr_to_any(const Expr& e);
+    std::vector<int> cond_jump(const Expr& e, bool jump_if);
+    void arith(Op op, int target, int lhs, const Expr& rhs, std::uint32_t line);
+    void compare(const Expr& e, bool jump_if);
+    void call(const Expr& e, int base);
+    void array(const Expr& e, int target);
+    void table(const Expr& e, int target);
+    bool fold(const Expr& e, double& out) const;
+    bool small_number(const Expr& e, int& k);
+    bool small_string(const Expr& e, int& k);
+    bool small_field(const std::string& name, std::uint32_t line, int& k);
+    void load_number(double d, int target, std::uint32_t line);
+
+    VM& vm_;
+    std::shared_ptr<const std::string> chunk_;
+    FunctionState* fs_ = nullptr;
+};
+
+Function* Compiler::compile_function(const FunctionDecl& decl, FunctionState* parent) {
+    FunctionState fs;
+    fs.parent = parent;
+    fs.fn = vm_.heap().make_function();
+    fs.fn->name = decl.name;
+    fs.fn->chunk = chunk_;
+    fs.fn->line_defined = decl.line;
+    fs.fn->params = static_cast<std::uint8_t>(decl.params.size());
+    fs.fn->is_async = decl.is_async;
+    fs_ = &fs;
+
+    for (const std::string& param : decl.params) {
+        for (const Local& other : fs.locals) {
+            if (other.name == param) fail("duplicate parameter '" + param + "'", decl.line);
+        }
+        declare_local(param, alloc_reg(decl.line));
+    }
+    if (parent) ++fs.block_depth;
+    for (const StmtPtr& s : decl.body) statement(*s);
+
+    const std::uint32_t last = fs.fn->lines.empty() ? decl.line : fs.fn->lines.back();
+    emit(encode_abc(Op::Return, 0, 0, 0), last);
+    end_locals(0);
+    fs.fn->code.shrink_to_fit();
+    fs.fn->lines.shrink_to_fit();
+    fs.fn->constants.shrink_to_fit();
+    fs.fn->locals.shrink_to_fit();
+    fs_ = parent;
+    return fs.fn;
+}
+
+void Compiler::block(const Block& body) {
+    const std::size_t locals = fs_->locals.size();
+    const int free = fs_->free_reg;
+    ++fs_->block_depth;
+    for (const StmtPtr& s : body) statement(*s);
+    --fs_->block_depth;
+    end_locals(locals);
+    free_to(free);
+}
+
+void Compiler::statement(const Stmt& s) {
+    switch (s.kind) {
+        case StmtKind::Expr: {
+            const int base = alloc_reg(s.line);
+            if (s.a->kind == ExprKind::Await) {
+                expr_to_reg(*s.a, base);
+            } else {
+                call(*s.a, base);
+            }
+            free_to(base);
+            break;
+        }
+        case StmtKind::Let: let(s); break;
+        case StmtKind::Assign: assign(s); break;
+        case StmtKind::If: if_statement(s); break;
+        case StmtKind::While: while_loop(s); break;
+        case StmtKind::ForRange: for_range(s); break;
+        case StmtKind::ForIn: for_in(s); break;
+        case StmtKind::Block: block(s.body); break;
+        case StmtKind::Return: {
+            if (s.a) {
+                const int save = fs_->free_reg;
+                emit(encode_abc(Op::Return, expr_to_any(*s.a), 1, 0), s.line);
+                free_to(save);
+            } else {
+                emit(encode_abc(Op::Return, 0, 0, 0), s.line);
+            }
+            break;
+        }
+        case StmtKind::Break: fs_->loops.back().breaks.push_back(emit_jump(s.line)); break;
+        case StmtKind::Continue: fs_->loops.back().continues.push_back(emit_jump(s.line)); break;
+        case StmtKind::Function: function_statement(s); break;
+    }
+}
+
+void Compiler::let(const Stmt& s) {
+    if (at_global_scope()) {
+        const int slot = global_slot(s.name, s.line);
+        const int save = fs_->free_reg;
+        int r;
+        if (s.a) {
+            r = expr_to_any(*s.a);
+        } else {
+            r = alloc_reg(s.line);
+            emit(encode_abc(Op::LoadNil, r, 0, 0), s.line);
+        }
+        emit(encode_abx(Op::SetGlobal, r, slot), s.line);
+        free_to(save);
+        return;
+    }
+    const int r = alloc_reg(s.line);
+    if (s.a) {
+        expr_to_reg(*s.a, r);
+    } else {
+        emit(encode_abc(Op::LoadNil, r, 0, 0), s.line);
+    }
+    declare_local(s.name, r);  // after the initialiser, so `let x = x` reads the outer x
+}
+
+void Compiler::assign(const Stmt& s) {
+    const Expr& target = *s.a;
+    const bool compound = s.op != Tok::Assign;
+    const int save = fs_->free_reg;
+
+    if (target.kind == ExprKind::Name) {
+        if (const Local* local = resolve_local(target.text, target.line)) {
+            if (compound) {
+                arith(arith_op(s.op), local->reg, local->reg, *s.b, s.line);
+            } else {
+                expr_to_reg(*s.b, local->reg);
+            }
+        } else {
+            const int slot = global_slot(target.text, target.line);
+            int r;
+            if (compound) {
+                r = alloc_reg(s.line);
+                emit(encode_abx(Op::GetGlobal, r, slot), s.line);
+                arith(arith_op(s.op), r, r, *s.b, s.line);
+            } else {
+                r = expr_to_any(*s.b);
+            }
+            emit(encode_abx(Op::SetGlobal, r, slot), s.line);
+        }
+        free_to(save);
+        return;
+    }
+
+    // Indexed target: the object and key are evaluated once, also for
+    // compound assignment.
+    const int object = expr_to_any(*target.a);
+    int key = -1;
+    int field = -1;
+    if (target.kind == ExprKind::Field) {
+        if (!small_field(target.text, target.line, field)) {
+            key = alloc_reg(target.line);
+            emit(encode_abx(Op::LoadK, key, string_constant(target.text, target.line)), target.line);
+        }
+    } else if (!small_string(*target.b, field)) {
+        key = expr_to_any(*target.b);
+    }
+
+    int value;
+    if (compound) {
+        value = alloc_reg(s.line);
+        if (field >= 0) {
+            emit(encode_abc(Op::GetField, value, object, field), s.line);
+        } else {
+            emit(encode_abc(Op::GetTable, value, object, key), s.line);
+        }
+        arith(arith_op(s.op), value, value, *s.b, s.line);
+    } else {
+        value = expr_to_any(*s.b);
+    }
+    if (field >= 0) {
+        emit(encode_abc(Op::SetField, object, field, value), s.line);
+    } else {
+        emit(encode_abc(Op::SetTable, object, key, value), s.line);
+    }
+    free_to(save);
+}
+
+void Compiler::if_statement(const Stmt& s) {
+    const std::vector<int> skip = cond_jump(*s.a, false);
+    block(s.body);
+    if (s.orelse.empty()) {
+        patch_here(skip);
+        return;
+    }
+    const int exit = emit_jump(s.line);
+    patch_here(skip);
+    block(s.orelse);
+    patch(exit, pc());
+}
+
+void Compiler::finish_loop(int continue_target, int exit_target) {
+    Loop& loop = fs_->loops.back();
+    for (int j : loop.continues) patch(j, continue_target);
+    for (int j : loop.breaks) patch(j, exit_target);
+    fs_->loops.pop_back();
+}
+
+void Compiler::while_loop(const Stmt& s) {
+    const int start = pc();
+    const std::vector<int> exits = cond_jump(*s.a, false);
+    fs_->loops.emplace_back();
+    block(s.body);
+    patch(emit_jump(s.line), start);
+    patch_here(exits);
+    finish_loop(start, pc());
+}
+
+void Compiler::for_range(const Stmt& s) {
+    const int save = fs_->free_reg;
+    const int base = alloc_reg(s.line);
+    expr_to_reg(*s.a, base);
+    expr_to_reg(*s.b, alloc_reg(s.line));
+    load_number(1, alloc_reg(s.line), s.line);
+    const int var = alloc_reg(s.line);
+
+    const int prep = emit(encode_asbx(Op::ForPrep, base, 0), s.line);
+    const int body = pc();
+    fs_->loops.emplace_back();
+    const std::size_t locals = fs_->locals.size();
+    declare_local(s.name, var);
+    block(s.body);
+    end_locals(locals);
+
+    const int next = emit(encode_asbx(Op::ForLoop, base, 0), s.line);
+    patch(next, body);
+    patch(prep, pc());
+    finish_loop(next, pc());
+    free_to(save);
+}
+
+void Compiler::for_in(const Stmt& s) {
+    const int save = fs_->free_reg;
+    const int base = alloc_reg(s.line);
+    expr_to_reg(*s.a, base);
+    alloc_reg(s.line);  // cursor
+    const int key = alloc_reg(s.line);
+    const int value = alloc_reg(s.line);
+
+    const int prep = emit(encode_asbx(Op::TForPrep, base, 0), s.line);
+    const int body = pc();
+    fs_->loops.emplace_back();
+    const std::size_t locals = fs_->locals.size();
+    declare_local(s.name, key);
+    if (!s.value.empty()) declare_local(s.value, value);
+    block(s.body);
+    end_locals(locals);
+
+    const int next = emit(encode_asbx(Op::TForNext, base, 0), s.line);
+    patch(prep, next);
+    patch(next, body);
+    finish_loop(next, pc());
+    free_to(save);
+}
+
+void Compiler::function_statement(const Stmt& s) {
+    const bool global = at_global_scope();
+    const int r = alloc_reg(s.line);
+    // Declared first so a nested function naming itself is reported as a
+    // capture rather than silently resolving to a global.
+    if (!global) declare_local(s.name, r);
+    Function* fn = compile_function(*s.function, fs_);
+    emit(encode_abx(Op::LoadK, r, add_constant(Value::object(fn), s.line)), s.line);
+    if (global) {
+        emit(encode_abx(Op::SetGlobal, r, global_slot(s.name, s.line)), s.line);
+        free_to(r);
+    }
+}
+
+bool Compiler::fold(const Expr& e, double& out) const {
+    if (e.kind == ExprKind::Number) {
+        out = e.number;
+        return true;
+    }
+    if (e.kind == ExprKind::Unary && e.op == Tok::Minus) {
+        if (!fold(*e.a, out)) return false;
+        out = -out;
+        return true;
+    }
+    if (e.kind != ExprKind::Binary) return false;
+    double a, b;
+    if (!fold(*e.a, a) || !fold(*e.b, b)) return false;
+    switch (e.op) {
+        case Tok::Plus: out = a + b; return true;
+        case Tok::Minus: out = a - b; return true;
+        case Tok::Star: out = a * b; return true;
+        case Tok::Slash: out = a / b; return true;
+        case Tok::Percent: out = floor_mod(a, b); return true;
+        default: return false;
+    }
+}
+
+bool Compiler::small_number(const Expr& e, int& k) {
+    double d;
+    if (!fold(e, d)) return false;
+    k = number_constant(d, e.line);
+    return k <= kMaxSmallConstant;
+}
+
+bool Compiler::small_string(const Expr& e, int& k) {
+    if (e.kind != ExprKind::String) return false;
+    return small_field(e.text, e.line, k);
+}
+
+bool Compiler::small_field(const std::string& name, std::uint32_t line, int& k) {
+    k = string_constant(name, line);
+    return k <= kMaxSmallConstant;
+}
+
+void Compiler::load_number(double d, int target, std::uint32_t line) {
+    if (d >= kMinSBx && d <= kMaxSBx && d == std::floor(d) && !(d == 0 && std::signbit(d))) {
+        emit(encode_asbx(Op::LoadI, target, static_cast<int>(d)), line);
+    } else {
+        emit(encode_abx(Op::LoadK, target, number_constant(d, line)), line);
+    }
+}
+
+int Compiler::expr_to_any(const Expr& e) {
+    if (e.kind == ExprKind::Name) {
+        if (const Local* local = resolve_local(e.text, e.line)) return local->reg;
+    }
+    const int r = alloc_reg(e.line);
+    expr_to_reg(e, r);
+    return r;
+}
+
+void Compiler::arith(Op op, int target, int lhs, const Expr& rhs, std::uint32_t line) {
+    const int save = fs_->free_reg;
+    int k;
+    if (small_number(rhs, k)) {
+        emit(encode_abc(with_constant(op), target, lhs, k), line);
+    } else {
+        emit(encode_abc(op, target, lhs, expr_to_any(rhs)), line);
+    }
+    free_to(save);
+}
+
+void Compiler::expr_to_reg(const Expr& e, int target) {
+    // Expressions that write the target before they are done, or need
+    // scratch registers directly above it, only compile in place into the
+    // topmost register; anything else goes through a temporary.
+    const bool needs_top = e.kind == ExprKind::Call || e.kind == ExprKind::And || e.kind == ExprKind::Or ||
+                           e.kind == ExprKind::Array || e.kind == ExprKind::Table;
+    if (needs_top && target != fs_->free_reg - 1) {
+        const int save = fs_->free_reg;
+        const int temp = alloc_reg(e.line);
+        expr_to_reg(e, temp);
+        emit(encode_abc(Op::Move, target, temp, 0), e.line);
+        free_to(save);
+        return;
+    }
+
+    const int save = fs_->free_reg;
+    switch (e.kind) {
+        case ExprKind::Nil: emit(encode_abc(Op::LoadNil, target, 0, 0), e.line); break;
+        case ExprKind::True: emit(encode_abc(Op::LoadTrue, target, 0, 0), e.line); break;
+        case ExprKind::False: emit(encode_abc(Op::LoadFalse, target, 0, 0), e.line); break;
+        case ExprKind::Number: load_number(e.number, target, e.line); break;
+        case ExprKind::String:
+            emit(encode_abx(Op::LoadK, target, string_constant(e.text, e.line)), e.line);
+            break;
+        case ExprKind::Name: {
+            if (const Local* local = resolve_local(e.text, e.line)) {
+                if (local->reg != target) emit(encode_abc(Op::Move, target, local->reg, 0), e.line);
+            } else {
+                emit(encode_abx(Op::GetGlobal, target, global_slot(e.text, e.line)), e.line);
+            }
+            break;
+        }
+        case ExprKind::Index: {
+            const int object = expr_to_any(*e.a);
+            int k;
+            if (small_string(*e.b, k)) {
+                emit(encode_abc(Op::GetField, target, object, k), e.line);
+            } else {
+                emit(encode_abc(Op::GetTable, target, object, expr_to_any(*e.b)), e.line);
+            }
+            break;
+        }
+        case ExprKind::Field: {
+            const int object = expr_to_any(*e.a);
+            int k;
+            if (small_field(e.text, e.line, k)) {
+                emit(encode_abc(Op::GetField, target, object, k), e.line);
+            } else {
+                const int key = alloc_reg(e.line);
+                emit(encode_abx(Op::LoadK, key, k), e.line);
+                emit(encode_abc(Op::GetTable, target, object, key), e.line);
+            }
+            break;
+        }
+        case ExprKind::Call: call(e, target); break;
+        case ExprKind::Unary: {
+            double d;
+            if (fold(e, d)) {
+                load_number(d, target, e.line);
+                break;
+            }
+            const Op op = e.op == Tok::Minus ? Op::Unm : e.op == Tok::Not ? Op::Not : Op::Len;
+            emit(encode_abc(op, target, expr_to_any(*e.a), 0), e.line);
+            break;
+        }
+        case ExprKind::Binary: {
+            double d;
+            if (fold(e, d)) {
+                load_number(d, target, e.line);
+            } else if (is_comparison(e.op)) {
+                const std::vector<int> yes = cond_jump(e, true);
+                emit(encode_abc(Op::LoadFalse, target, 0, 0), e.line);
+                const int done = emit_jump(e.line);
+                patch_here(yes);
+                emit(encode_abc(Op::LoadTrue, target, 0, 0), e.line);
+                patch(done, pc());
+            } else {
+                arith(arith_op(e.op), target, expr_to_any(*e.a), *e.b, e.line);
+            }
+            break;
+        }
+        case ExprKind::And:
+        case ExprKind::Or: {
+            expr_to_reg(*e.a, target);
+            emit(encode_abc(Op::Test, target, 0, e.kind == ExprKind::Or ? 1 : 0), e.line);
+            const int done = emit_jump(e.line);
+            expr_to_reg(*e.b, target);
+            patch(done, pc());
+            break;
+        }
+        case ExprKind::Array: array(e, target); break;
+        case ExprKind::Table: table(e, target); break;
+        case ExprKind::Function: {
+            Function* fn = compile_function(*e.function, fs_);
+            emit(encode_abx(Op::LoadK, target, add_constant(Value::object(fn), e.line)), e.line);
+            break;
+        }
+        case ExprKind::Await:
+            if (!fs_->fn->is_async) fail("'await' outside an async function", e.line);
+            emit(encode_abc(Op::Await, target, expr_to_any(*e.a), 0), e.line);
+            break;
+    }
+    free_to(save);
+}
+
+void Compiler::call(const Expr& e, int base) {
+    if (e.kind != ExprKind::Call) fail("expected a call", e.line);
+    expr_to_reg(*e.a, base);
+    for (const ExprPtr& arg : e.list) expr_to_reg(*arg, alloc_reg(arg->line));
+    emit(encode_abc(Op::Call, base, static_cast<int>(e.list.size()), 0), e.line);
+    free_to(base + 1);
+}
+
+void Compiler::array(const Expr& e, int target) {
+    const int n = static_cast<int>(e.list.size());
+    emit(encode_abc(Op::NewTable, target, n < 255 ? n : 255, 0), e.line);
+    if (n > 256 * kSetListBatch) fail("array literal too long", e.line);
+    for (int first = 0; first < n; first += kSetListBatch) {
+        const int count = n - first < kSetListBatch ? n - first : kSetListBatch;
+        for (int i = 0; i < count; ++i) {
+            const Expr& item = *e.list[static_cast<std::size_t>(first + i)];
+            expr_to_reg(item, alloc_reg(item.line));
+        }
+        emit(encode_abc(Op::SetList, target, count, first / kSetListBatch), e.line);
+        free_to(target + 1);
+    }
+}
+
+void Compiler::table(const Expr& e, int target) {
+    const int n = static_cast<int>(e.list.size());
+    emit(encode_abc(Op::NewTable, target, 0, n < 255 ? n : 255), e.line);
+    for (std::size_t i = 0; i < e.list.size(); ++i) {
+        const Expr& key = *e.keys[i];
+        int k;
+        if (small_string(key, k)) {
+            emit(encode_abc(Op::SetField, target, k, expr_to_any(*e.list[i])), key.line);
+        } else {
+            const int r = expr_to_any(key);
+            emit(encode_abc(Op::SetTable, target, r, expr_to_any(*e.list[i])), key.line);
+        }
+        free_to(target + 1);
+    }
+}
+
+void Compiler::compare(const Expr& e, bool jump_if) {
+    const int c = jump_if ? 1 : 0;
+    int k;
+    if (e.op == Tok::Eq || e.op == Tok::Ne) {
+        const int want = (e.op == Tok::Eq) == jump_if ? 1 : 0;
+        if (small_number(*e.b, k) || small_string(*e.b, k)) {
+            emit(encode_abc(Op::EqK, expr_to_any(*e.a), k, want), e.line);
+        } else if (small_number(*e.a, k) || small_string(*e.a, k)) {
+            emit(encode_abc(Op::EqK, expr_to_any(*e.b), k, want), e.line);
+        } else {
+            const int a = expr_to_any(*e.a);
+            emit(encode_abc(Op::Eq, a, expr_to_any(*e.b), want), e.line);
+        }
+        return;
+    }
+    if (small_number(*e.b, k)) {
+        const Op op = e.op == Tok::Lt ? Op::LtK : e.op == Tok::Le ? Op::LeK : e.op == Tok::Gt ? Op::GtK : Op::GeK;
+        emit(encode_abc(op, expr_to_any(*e.a), k, c), e.line);
+    } else if (small_number(*e.a, k)) {
+        // k < x is x > k, and so on.
+        const Op op = e.op == Tok::Lt ? Op::GtK : e.op == Tok::Le ? Op::GeK : e.op == Tok::Gt ? Op::LtK : Op::LeK;
+        emit(encode_abc(op, expr_to_any(*e.b), k, c), e.line);
+    } else {
+        const int a = expr_to_any(*e.a);
+        const int b = expr_to_any(*e.b);
+        if (e.op == Tok::Lt || e.op == Tok::Le) {
+            emit(encode_abc(e.op == Tok::Lt ? Op::Lt : Op::Le, a, b, c), e.line);
+        } else {
+            emit(encode_abc(e.op == Tok::Gt ? Op::Lt : Op::Le, b, a, c), e.line);
+        }
+    }
+}
+
+std::vector<int> Compiler::cond_jump(const Expr& e, bool jump_if) {
+    const int save = fs_->free_reg;
+    std::vector<int> jumps;
+    switch (e.kind) {
+        case ExprKind::Nil:
+        case ExprKind::False:
+            if (!jump_if) jumps.push_back(emit_jump(e.line));
+            break;
+        case ExprKind::True:
+        case ExprKind::Number:
+        case ExprKind::String:
+            if (jump_if) jumps.push_back(emit_jump(e.line));
+            break;
+        case ExprKind::Unary:
+            if (e.op == Tok::Not) return cond_jump(*e.a, !jump_if);
+            goto value;
+        case ExprKind::And:
+        case ExprKind::Or: {
+            // `a and b` jumps on false if either does; on true only if both
+            // do. `or` is the mirror image.
+            const bool short_on = e.kind == ExprKind::Or;
+            if (jump_if == short_on) {
+                jumps = cond_jump(*e.a, jump_if);
+                std::vector<int> rest = cond_jump(*e.b, jump_if);
+                jumps.insert(jumps.end(), rest.begin(), rest.end());
+            } else {
+                const std::vector<int> skip = cond_jump(*e.a, short_on);
+                jumps = cond_jump(*e.b, jump_if);
+                patch_here(skip);
+            }
+            break;
+        }
+        case ExprKind::Binary:
+            if (is_comparison(e.op)) {
+                compare(e, jump_if);
+                jumps.push_back(emit_jump(e.line));
+                break;
+            }
+            goto value;
+        default:
+        value:
+            emit(encode_abc(Op::Test, expr_to_any(e), 0, jump_if ? 1 : 0), e.line);
+            jumps.push_back(emit_jump(e.line));
+            break;
+    }
+    free_to(save);
+    return jumps;
+}
+
+}  // namespace
+
+Function* compile(VM& vm, std::string_view source, std::string chunk) {
+    Parser parser(source, chunk);
+    const FunctionDecl decl = parser.parse_chunk();
+    Compiler compiler(vm, std::make_shared<const std::string>(std::move(chunk)));
+    return compiler.compile_function(decl, nullptr);
+}
+
+Function* compile(VM& vm, const FunctionDecl& decl, std::string chunk) {
+    Compiler compiler(vm, std::make_shared<const std::string>(std::move(chunk)));
+    return compiler.compile_function(decl, nullptr);
+}
+
+Function* compile_expression(VM& vm, std::string_view expression, const std::vector<std::string>& params,
+                             std::string chunk) {
+    // The newline ends a trailing // comment before the closing parenthesis.
+    const std::string source = "return (" + std::string(expression) + "\n)";
+    Parser parser(source, chunk);
+    FunctionDecl decl = parser.parse_chunk();
+    decl.params = params;
+    Compiler compiler(vm, std::make_shared<const std::string>(std::move(chunk)));
+    return compiler.compile_function(decl, nullptr);
+}
+
+}  // namespace rebel::script
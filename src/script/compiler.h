@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::script {
+
+class VM;
+struct Function;
+
+namespace ast {
+struct FunctionDecl;
+}
+
+/// Changes whenever the code generated for some source changes, so that
+/// stored bytecode (script/bytecode_cache.h) is compiled afresh.
+constexpr std::uint32_t kCompilerVersion = 1;
+
+/// Parses and compiles one chunk of source into a function of no
+/// parameters, allocated on `vm`'s heap. Globals referenced by the chunk
+/// are bound to `vm`'s global slots. Throws CompileError.
+Function* compile(VM& vm, std::string_view source, std::string chunk);
+
+/// Compiles a function built as an AST rather than parsed, for front ends
+/// other than source text (visual graphs). Throws CompileError.
+Function* compile(VM& vm, const ast::FunctionDecl& decl, std::string chunk);
+
+/// Compiles one expression into a function of `params` that returns its
+/// value; other names resolve to globals. Used for debugger conditions.
+/// Throws CompileError.
+Function* compile_expression(VM& vm, std::string_view expression, const std::vector<std::string>& params,
+                             std::string chunk);
+
+}  // namespace rebel::script
@@ -0,0 +1,367 @@
+#include "script/debugger.h"
+
+#include "core/trace.h"
+#include "script/compiler.h"
+#include "script/error.h"
+#include "script/recorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace rebel::script {
+namespace {
+
+bool is_conditional(Op op) {
+    switch (op) {
+        case Op::Eq:
+        case Op::Lt:
+        case Op::Le:
+        case Op::EqK:
+        case Op::LtK:
+        case Op::LeK:
+        case Op::GtK:
+        case Op::GeK:
+        case Op::Test: return true;
+        default: return false;
+    }
+}
+
+// First instruction of `line` that can be replaced: not the Jmp that
+// completes a comparison, which the comparison reads in place.
+std::ptrdiff_t line_start(const Function& fn, std::uint32_t line) {
+    for (std::size_t pc = 0; pc < fn.code.size(); ++pc) {
+        if (fn.line_at(pc) != line) continue;
+        if (pc > 0 && op_of(fn.code[pc]) == Op::Jmp && is_conditional(op_of(fn.code[pc - 1]))) continue;
+        return static_cast<std::ptrdiff_t>(pc);
+    }
+    return -1;
+}
+
+template <typename F>
+void for_each_function(Function& fn, F&& visit) {
+    visit(fn);
+    for (const Value& v : fn.constants) {
+        if (v.is_function()) for_each_function(*v.as_function(), visit);
+    }
+}
+
+// Locals in scope at `pc`, and the register holding each; an inner
+// declaration shadows an outer one of the same name.
+void scope_at(const Function& fn, std::uint32_t pc, std::vector<std::string>& names,
+              std::vector<std::uint8_t>& registers) {
+    for (const Function::LocalVar& local : fn.locals) {
+        if (local.start > pc || pc >= local.end) continue;
+        const auto it = std::find(names.begin(), names.end(), local.name);
+        if (it != names.end()) {
+            registers[static_cast<std::size_t>(it - names.begin())] = local.reg;
+        } else {
+            names.push_back(local.name);
+            registers.push_back(local.reg);
+        }
+    }
+}
+
+// Splits a log message into literal pieces around its `{expr}` parts.
+void split_message(std::string_view text, std::vector<std::string>& pieces, std::vector<std::string>& expressions) {
+    pieces.assign(1, std::string());
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const char c = text[i];
+        if ((c == '{' || c == '}') && i + 1 < text.size() && text[i + 1] == c) {
+            pieces.back() += c;
+            ++i;
+        } else if (c == '}') {
+            throw CompileError("unmatched '}' in log message");
+        } else if (c == '{') {
+            // Braces nest so that table constructors can appear inside.
+            std::size_t end = i + 1;
+            for (int depth = 1; depth > 0; ++end) {
+                if (end == text.size()) throw CompileError("unterminated '{' in log message");
+                if (text[end] == '{') ++depth;
+                if (text[end] == '}') --depth;
+            }
+            expressions.emplace_back(text.substr(i + 1, end - i - 2));
+            pieces.emplace_back();
+            i = end - 1;
+        } else {
+            pieces.back() += c;
+        }
+    }
+}
+
+}  // namespace
+
+Debugger::Debugger(VM& vm) : vm_(vm) {
+    if (vm.debugger_) throw std::logic_error("a debugger is already attached to this VM");
+    vm.debugger_ = this;
+}
+
+Debugger::~Debugger() {
+    clear_all();
+    vm_.debugger_ = nullptr;
+}
+
+int Debugger::set_breakpoint(std::string_view chunk, std::uint32_t line, const BreakpointOptions& options) {
+    // Compiled here without locals only to report errors now rather than
+    // when a chunk loads; each patch compiles its own copy.
+    if (!options.condition.empty()) compile_expression(vm_, options.condition, {}, "<condition>");
+    std::vector<std::string> pieces;
+    std::string expressions;
+    if (!options.log_message.empty()) {
+        std::vector<std::string> parts;
+        split_message(options.log_message, pieces, parts);
+        if (!parts.empty()) {
+            expressions = "[";
+            for (const std::string& part : parts) {
+                if (expressions.size() > 1) expressions += ", ";
+                expressions += "(" + part + "\n)";
+            }
+            expressions += "]";
+            compile_expression(vm_, expressions, {}, "<log>");
+        }
+    }
+
+    auto existing = std::find_if(breakpoints_.begin(), breakpoints_.end(),
+                                 [&](const Breakpoint& bp) { return bp.chunk == chunk && bp.line == line; });
+    const bool fresh = existing == breakpoints_.end();
+    if (fresh) breakpoints_.push_back({next_id_++, std::string(chunk), line, 0, {}, {}, {}, {}});
+    Breakpoint& bp = fresh ? breakpoints_.back() : *existing;
+    bp.options = options;
+    bp.pieces = std::move(pieces);
+    bp.expressions = std::move(expressions);
+    if (!fresh) {
+        for (std::uint32_t index : bp.patches) compile_options(bp, patches_[index]);
+        return bp.id;
+    }
+    for (Function* loaded : vm_.chunks_) {
+        if (loaded->chunk && *loaded->chunk == chunk) {
+            for_each_function(*loaded, [&](Function& fn) { patch_function(bp, fn); });
+        }
+    }
+    return bp.id;
+}
+
+bool Debugger::clear_breakpoint(int id) {
+    auto it = std::find_if(breakpoints_.begin(), breakpoints_.end(), [id](const Breakpoint& bp) { return bp.id == id; });
+    if (it == breakpoints_.end()) return false;
+    for (std::uint32_t index : it->patches) unpatch(index);
+    breakpoints_.erase(it);
+    return true;
+}
+
+void Debugger::clear_all() {
+    while (!breakpoints_.empty()) clear_breakpoint(breakpoints_.back().id);
+}
+
+std::uint64_t Debugger::hits(int id) const {
+    const Breakpoint* bp = find(id);
+    return bp ? bp->hits : 0;
+}
+
+Instruction Debugger::trap(std::uint32_t index) {
+    const Instruction original = patches_[index].original;
+    Breakpoint* bp = find(patches_[index].breakpoint);
+    if (!bp || evaluating_) return original;
+    const int id = bp->id;
+
+    bool failed = false;
+    if (const Value condition = patches_[index].condition.get(); !condition.is_nil()) {
+        try {
+            if (!run_snippet(condition, vm_.frames_.back().base, patches_[index].registers).truthy()) return original;
+        } catch (const RuntimeError& e) {
+            log(id, std::string("condition error: ") + e.what());
+            failed = true;
+        }
+        if (!(bp = find(id))) return original;
+    }
+    if (!failed) {
+        if (++bp->hits < bp->options.hit_count) return original;
+        if (!bp->options.log_message.empty()) {
+            std::string text;
+            if (const Value message = patches_[index].message.get(); message.is_nil()) {
+                text = bp->pieces.front();
+            } else {
+                try {
+                    text = format_message(
+                        *bp, run_snippet(message, vm_.frames_.back().base, patches_[index].registers));
+                } catch (const RuntimeError& e) {
+                    text = std::string("log message error: ") + e.what();
+                }
+            }
+            log(id, text);
+            return original;
+        }
+    }
+
+    if (recorder_ && !recorder_->stop(id, original)) return original;
+    report(id);
+    // The handler may have stepped back: run on from the restored stop,
+    // reporting it again if it is the one asked for.
+    Instruction resume = original;
+    bool landed = false;
+    int stopped = id;
+    while (recorder_ && recorder_->rewind(resume, landed, stopped) && landed) report(stopped);
+    return resume;
+}
+
+void Debugger::loaded(Function& chunk) {
+    if (!chunk.chunk) return;
+    for (Breakpoint& bp : breakpoints_) {
+        if (bp.chunk != *chunk.chunk) continue;
+        for_each_function(chunk, [&](Function& fn) { patch_function(bp, fn); });
+    }
+}
+
+const VM::Frame& Debugger::vm_frame(std::size_t level) const {
+    if (level >= vm_.frames_.size()) throw std::out_of_range("no frame at level " + std::to_string(level));
+    return vm_.frames_[vm_.frames_.size() - 1 - level];
+}
+
+Debugger::Frame Debugger::frame(std::size_t level) const {
+    const VM::Frame& frame = vm_frame(level);
+    // Frames below the innermost saved the pc after their call.
+    const auto pc = static_cast<std::uint32_t>(frame.pc - frame.fn->code.data());
+    Frame out{frame.fn, vm_.current_line(frame), {}};
+    std::vector<std::string> names;
+    std::vector<std::uint8_t> registers;
+    scope_at(*frame.fn, pc > 0 ? pc - 1 : 0, names, registers);
+    out.locals.reserve(names.size());
+    for (std::size_t i = 0; i < names.size(); ++i) out.locals.emplace_back(std::move(names[i]), frame.base[registers[i]]);
+    return out;
+}
+
+Value Debugger::evaluate(std::size_t level, std::string_view expression) {
+    const VM::Frame& frame = vm_frame(level);
+    const auto pc = static_cast<std::uint32_t>(frame.pc - frame.fn->code.data());
+    std::vector<std::string> names;
+    std::vector<std::uint8_t> registers;
+    scope_at(*frame.fn, pc > 0 ? pc - 1 : 0, names, registers);
+    const Value* base = frame.base;  // the stack does not move
+    Function* fn = compile_expression(vm_, expression, names, "<eval>");
+    return run_snippet(Value::object(fn), base, registers);
+}
+
+std::vector<std::pair<std::string_view, Value>> Debugger::globals() const {
+    std::vector<std::pair<std::string_view, Value>> out;
+    for (std::size_t slot = 0; slot < vm_.globals_.size(); ++slot) {
+        if (vm_.defined_[slot]) out.emplace_back(vm_.global_names_[slot], vm_.globals_[slot]);
+    }
+    return out;
+}
+
+Debugger::Breakpoint* Debugger::find(int id) {
+    for (Breakpoint& bp : breakpoints_) {
+        if (bp.id == id) return &bp;
+    }
+    return nullptr;
+}
+
+const Debugger::Breakpoint* Debugger::find(int id) const { return const_cast<Debugger*>(this)->find(id); }
+
+void Debugger::patch_function(Breakpoint& bp, Function& fn) {
+    const std::ptrdiff_t pc = line_start(fn, bp.line);
+    if (pc < 0) return;
+    Instruction& slot = fn.code[static_cast<std::size_t>(pc)];
+    if (op_of(slot) == Op::Trap) return;  // already patched for another breakpoint
+
+    std::uint32_t index;
+    if (!free_patches_.empty()) {
+        index = free_patches_.back();
+        free_patches_.pop_back();
+    } else {
+        if (patches_.size() > static_cast<std::size_t>(kMaxBx)) throw std::length_error("too many breakpoints");
+        index = static_cast<std::uint32_t>(patches_.size());
+        patches_.emplace_back();
+    }
+    Patch& patch = patches_[index];
+    patch.fn = VM::Handle(vm_, Value::object(&fn));
+    patch.pc = static_cast<std::uint32_t>(pc);
+    patch.original = slot;
+    patch.breakpoint = bp.id;
+    compile_options(bp, patch);
+    slot = encode_abx(Op::Trap, 0, static_cast<int>(index));
+    bp.patches.push_back(index);
+    invalidate(fn);
+}
+
+void Debugger::unpatch(std::uint32_t index) {
+    Patch& patch = patches_[index];
+    Function& fn = *patch.fn.get().as_function();
+    fn.code[patch.pc] = patch.original;
+    invalidate(fn);
+    patch.fn = VM::Handle();
+    patch.condition = VM::Handle();
+    patch.message = VM::Handle();
+    patch.breakpoint = -1;
+    free_patches_.push_back(index);
+}
+
+void Debugger::compile_options(const Breakpoint& bp, Patch& patch) {
+    patch.condition = VM::Handle();
+    patch.message = VM::Handle();
+    patch.registers.clear();
+    if (bp.options.condition.empty() && bp.expressions.empty()) return;
+
+    // The locals in scope at the patch become the snippets' parameters.
+    std::vector<std::string> names;
+    scope_at(*patch.fn.get().as_function(), patch.pc, names, patch.registers);
+    if (!bp.options.condition.empty()) {
+        Function* fn = compile_expression(vm_, bp.options.condition, names, "<condition>");
+        patch.condition = VM::Handle(vm_, Value::object(fn));
+    }
+    if (!bp.expressions.empty()) {
+        Function* fn = compile_expression(vm_, bp.expressions, names, "<log>");
+        patch.message = VM::Handle(vm_, Value::object(fn));
+    }
+}
+
+Value Debugger::run_snippet(const Value& fn, const Value* base, const std::vector<std::uint8_t>& registers) {
+    scratch_.clear();
+    for (std::uint8_t reg : registers) scratch_.push_back(base[reg]);
+    struct Reset {
+        bool& flag;
+        ~Reset() { flag = false; }
+    } reset{evaluating_};
+    evaluating_ = true;
+    return vm_.call(fn, scratch_);
+}
+
+std::string Debugger::format_message(const Breakpoint& bp, const Value& values) const {
+    const std::vector<Value>& parts = values.as_table()->array();
+    std::string text = bp.pieces.front();
+    for (std::size_t i = 0; i < parts.size() && i + 1 < bp.pieces.size(); ++i) {
+        text += vm_.to_display_string(parts[i]);
+        text += bp.pieces[i + 1];
+    }
+    return text;
+}
+
+void Debugger::log(int breakpoint, std::string_view text) {
+    if (recorder_ && !recorder_->reporting()) return;  // already logged before the rewind
+    if (log_) {
+        log_(breakpoint, text);
+    } else {
+        vm_.print(text);
+    }
+}
+
+void Debugger::report(int breakpoint) {
+    if (!handler_) return;
+    REBEL_TRACE_SCOPE("debugger.stop");
+    // The stopped instruction precedes the saved pc of the innermost frame.
+    const VM::Frame& frame = vm_.frames_.back();
+    const Function& fn = *frame.fn;
+    const auto pc = static_cast<std::size_t>(frame.pc - fn.code.data()) - 1;
+    // Copies: the handler may run scripts that move or drop `fn`.
+    const std::string chunk = fn.chunk ? *fn.chunk : std::string();
+    const std::string function = fn.name;
+    handler_(Stop{breakpoint, chunk, fn.line_at(pc), function});
+}
+
+void Debugger::invalidate([[maybe_unused]] Function& fn) {
+#ifdef REBEL_SCRIPT_JIT
+    vm_.jit().invalidate(fn);
+#endif
+}
+
+}  // namespace rebel::script
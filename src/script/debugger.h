@@ -0,0 +1,168 @@
+#pragma once
+
+#include "script/object.h"
+#include "script/opcode.h"
+#include "script/vm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rebel::script {
+
+class Recorder;
+
+/// How a breakpoint behaves when reached (see Debugger::set_breakpoint).
+struct BreakpointOptions {
+    /// Expression over the function's locals in scope and globals; the
+    /// breakpoint counts a hit only when it is truthy. Empty: always.
+    std::string condition;
+    /// Stops (or logs) from the n-th counted hit on; 0 and 1 mean every hit.
+    std::uint64_t hit_count = 0;
+    /// Makes a log point, which logs instead of stopping. `{expr}` is
+    /// replaced by the expression's value; `{{` and `}}` are braces.
+    std::string log_message;
+};
+
+/// Source breakpoints for one VM.
+///
+/// A breakpoint replaces the first instruction of its line with a Trap
+/// whose operand indexes a side table of original instructions. The
+/// interpreter reaches the debugger only by executing a Trap, so an
+/// attached debugger with no breakpoints costs nothing, and a breakpoint
+/// costs nothing outside its own line. Breakpoints on chunks compiled later
+/// are patched in when the chunk loads.
+///
+/// Conditions and log-point messages are compiled when the breakpoint is
+/// set, once per patched function, into script functions whose parameters
+/// are the locals in scope at the breakpoint. A hit copies those registers
+/// and calls the function; nothing is parsed or looked up by name.
+///
+/// At most one Debugger is attached to a VM at a time, and it must not
+/// outlive the VM. Destroying it restores the bytecode and detaches.
+class Debugger {
+public:
+    /// Where execution stopped.
+    struct Stop {
+        int breakpoint;
+        const std::string& chunk;
+        std::uint32_t line;
+        const std::string& function;
+    };
+    /// Called with the VM paused before the stopped instruction. May call
+    /// back into the VM.
+    using Handler = std::function<void(const Stop&)>;
+    /// Receives log-point output and condition errors. Defaults to the
+    /// VM's print handler.
+    using LogHandler = std::function<void(int breakpoint, std::string_view text)>;
+
+
+    explicit Debugger(VM& vm);
+    ~Debugger();
+    Debugger(const Debugger&) = delete;
+    Debugger& operator=(const Debugger&) = delete;
+
+    void set_handler(Handler handler) { handler_ = std::move(handler); }
+    void set_log_handler(LogHandler handler) { log_ = std::move(handler); }
+
+    /// Breaks before the first instruction of `line` in every function of
+    /// `chunk`, loaded now or later. Setting the same line again replaces
+    /// its options and returns the existing id. Throws CompileError for a
+    /// malformed condition or message, leaving the breakpoints unchanged.
+    ///
+    /// A condition that raises stops the breakpoint and logs the error.
+    /// Breakpoints reached while a condition or message is evaluated are
+    /// ignored.
+    int set_breakpoint(std::string_view chunk, std::uint32_t line, const BreakpointOptions& options = {});
+    /// Restores the patched instructions; false for an unknown id.
+    bool clear_breakpoint(int id);
+    void clear_all();
+
+    /// A script frame of the paused VM, for a handler to show.
+    struct Frame {
+        const Function* function;
+        std::uint32_t line;
+        /// Locals in scope, in declaration order; a name shadowed by an
+        /// inner declaration appears once, with the inner value. Values are
+        /// valid until the next script call.
+        std::vector<std::pair<std::string, Value>> locals;
+    };
+    /// Script frames on the VM. Levels count from 0, the innermost; from a
+    /// handler, that is the stopped one.
+    std::size_t depth() const noexcept { return vm_.frames_.size(); }
+    /// Throws std::out_of_range for a level past depth().
+    Frame frame(std::size_t level) const;
+    /// Evaluates `expression` over frame `level`'s locals and the globals,
+    /// as a condition would be. Throws CompileError, RuntimeError or
+    /// std::out_of_range; breakpoints are ignored meanwhile.
+    Value evaluate(std::size_t level, std::string_view expression);
+    /// Defined globals, natives included, in slot order; valid until the
+    /// next script call.
+    std::vector<std::pair<std::string_view, Value>> globals() const;
+
+    /// Hits counted (where the condition held); 0 for an unknown id.
+    std::uint64_t hits(int id) const;
+    /// Number of instructions currently patched (a breakpoint may patch
+    /// several functions or none).
+    std::size_t patched() const noexcept { return patches_.size() - free_patches_.size(); }
+
+    /// Called by the interpreter on a Trap; returns the instruction to run.
+    Instruction trap(std::uint32_t patch);
+    /// Called by the VM after compiling a chunk.
+    void loaded(Function& chunk);
+
+private:
+    friend class Recorder;  // saves and restores hit counts with checkpoints
+
+    struct Breakpoint {
+        int id;
+        std::string chunk;
+        std::uint32_t line;
+        std::uint64_t hits = 0;
+        std::vector<std::uint32_t> patches;
+        BreakpointOptions options;
+        // A log point's message split around its expressions: pieces.size()
+        // is one more than the number of expressions.
+        std::vector<std::string> pieces;
+        std::string expressions;  // "[(e1), (e2), ...]", empty without any
+    };
+    struct Patch {
+        VM::Handle fn;  // keeps the function alive and tracks it when it moves
+        std::uint32_t pc = 0;
+        Instruction original = 0;
+        int breakpoint = -1;  // -1: free
+        VM::Handle condition;      // nil: unconditional
+        VM::Handle message;        // returns the array of message values
+        std::vector<std::uint8_t> registers;  // arguments of both, live at pc
+    };
+
+    Breakpoint* find(int id);
+    const Breakpoint* find(int id) const;
+    void patch_function(Breakpoint& bp, Function& fn);
+    void unpatch(std::uint32_t index);
+    void invalidate(Function& fn);
+    void compile_options(const Breakpoint& bp, Patch& patch);
+    const VM::Frame& vm_frame(std::size_t level) const;
+    /// Calls a compiled condition or message with `registers` of `base`.
+    Value run_snippet(const Value& fn, const Value* base, const std::vector<std::uint8_t>& registers);
+    std::string format_message(const Breakpoint& bp, const Value& values) const;
+    void log(int breakpoint, std::string_view text);
+    void report(int breakpoint);
+
+    VM& vm_;
+    Handler handler_;
+    LogHandler log_;
+    std::vector<Breakpoint> breakpoints_;
+    std::vector<Patch> patches_;  // indexed by the Trap operand
+    std::vector<std::uint32_t> free_patches_;
+    std::vector<Value> scratch_;  // arguments of the snippet being called
+    bool evaluating_ = false;
+    Recorder* recorder_ = nullptr;
+    int next_id_ = 1;
+};
+
+}  // namespace rebel::script
@@ -0,0 +1,77 @@
+#include "script/disasm.h"
+
+#include "script/object.h"
+#include "script/vm.h"
+
+#include <cstdio>
+
+namespace rebel::script {
+namespace {
+
+void list(const VM& vm, const Function& fn, std::string& out) {
+    char line[160];
+    std::snprintf(line, sizeof line, "%sfunction %s (%s:%u) params=%u registers=%u constants=%zu\n",
+                  fn.is_async ? "async " : "", fn.name.c_str(), fn.chunk ? fn.chunk->c_str() : "?", fn.line_defined,
+                  fn.params, fn.registers, fn.constants.size());
+    out += line;
+
+    auto constant = [&](int index) { return vm.to_display_string(fn.constants[static_cast<std::size_t>(index)]); };
+    for (std::size_t pc = 0; pc < fn.code.size(); ++pc) {
+        const Instruction i = fn.code[pc];
+        const Op op = op_of(i);
+        std::string operands;
+        std::string comment;
+        switch (op_format(op)) {
+            case OpFormat::ABC:
+                operands = std::to_string(arg_a(i)) + " " + std::to_string(arg_b(i)) + " " + std::to_string(arg_c(i));
+                break;
+            case OpFormat::ABx: operands = std::to_string(arg_a(i)) + " " + std::to_string(arg_bx(i)); break;
+            case OpFormat::AsBx:
+                operands = std::to_string(arg_a(i)) + " " + std::to_string(arg_sbx(i));
+                if (op != Op::LoadI) comment = "to " + std::to_string(static_cast<int>(pc) + 1 + arg_sbx(i));
+                break;
+            case OpFormat::sJ:
+                operands = std::to_string(arg_sj(i));
+                comment = "to " + std::to_string(static_cast<int>(pc) + 1 + arg_sj(i));
+                break;
+        }
+        switch (op) {
+            case Op::LoadK: comment = constant(arg_bx(i)); break;
+            case Op::GetField:
+            case Op::AddK:
+            case Op::SubK:
+            case Op::MulK:
+            case Op::DivK:
+            case Op::ModK: comment = constant(arg_c(i)); break;
+            case Op::SetField:
+            case Op::EqK:
+            case Op::LtK:
+            case Op::LeK:
+            case Op::GtK:
+            case Op::GeK: comment = constant(arg_b(i)); break;
+            default: break;
+        }
+        std::snprintf(line, sizeof line, "  %04zu [%u] %-10s %-12s", pc, fn.line_at(pc), op_name(op),
+                      operands.c_str());
+        out += line;
+        if (!comment.empty()) out += " ; " + comment;
+        while (!out.empty() && out.back() == ' ') out.pop_back();
+        out.push_back('\n');
+    }
+    for (const Value& v : fn.constants) {
+        if (v.is_function()) {
+            out.push_back('\n');
+            list(vm, *v.as_function(), out);
+        }
+    }
+}
+
+}  // namespace
+
+std::string disassemble(const VM& vm, const Function& fn) {
+    std::string out;
+    list(vm, fn, out);
+    return out;
+}
+
+}  // namespace rebel::script
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace rebel::script {
+
+struct Function;
+class VM;
+
+/// Human-readable listing of a function's bytecode, one instruction per
+/// line as `pc [line] Op operands ; comment`, followed by the listings of
+/// the functions it defines.
+std::string disassemble(const VM& vm, const Function& fn);
+
+}  // namespace rebel::script
@@ -0,0 +1,21 @@
+#include "script/error.h"
+
+#include <utility>
+
+namespace rebel::script {
+namespace {
+
+std::string format(const std::string& message, const std::string& chunk, std::uint32_t line) {
+    if (line == 0) return message;
+    return (chunk.empty() ? std::string("?") : chunk) + ":" + std::to_string(line) + ": " + message;
+}
+
+}  // namespace
+
+ScriptError::ScriptError(std::string message, std::string chunk, std::uint32_t line)
+    : std::runtime_error(format(message, chunk, line)),
+      message_(std::move(message)),
+      chunk_(std::move(chunk)),
+      line_(line) {}
+
+}  // namespace rebel::script
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rebel::script {
+
+/// Base of every error raised by the script engine. `what()` carries the
+/// full "chunk:line: message" text; the parts are kept for tooling.
+class ScriptError : public std::runtime_error {
+public:
+    ScriptError(std::string message, std::string chunk = {}, std::uint32_t line = 0);
+
+    const std::string& message() const noexcept { return message_; }
+    const std::string& chunk() const noexcept { return chunk_; }
+    std::uint32_t line() const noexcept { return line_; }
+    bool located() const noexcept { return line_ != 0; }
+
+private:
+    std::string message_;
+    std::string chunk_;
+    std::uint32_t line_;
+};
+
+/// Syntax or semantic error found while compiling source.
+class CompileError : public ScriptError {
+public:
+    using ScriptError::ScriptError;
+};
+
+/// Error raised while executing bytecode. Natives throw it unlocated; the
+/// interpreter fills in the location and call stack as it unwinds.
+class RuntimeError : public ScriptError {
+public:
+    using ScriptError::ScriptError;
+
+    /// Innermost frame first, as "chunk:line in function".
+    const std::vector<std::string>& traceback() const noexcept { return traceback_; }
+
+private:
+    friend class VM;
+    std::vector<std::string> traceback_;
+};
+
+/// Raised at a safepoint when the host stops a script with
+/// VM::preempt(VM::Preempt::Abort).
+class AbortError : public RuntimeError {
+public:
+    using RuntimeError::RuntimeError;
+};
+
+}  // namespace rebel::script
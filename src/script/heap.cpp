@@ -0,0 +1,350 @@
+#include "script/heap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace rebel::script {
+namespace {
+
+constexpr std::size_t kAlign = 8;
+
+std::size_t align_up(std::size_t n) { return (n + kAlign - 1) & ~(kAlign - 1); }
+
+bool has_references(const Object* object) {
+    return object->type == ObjectType::Table || object->type == ObjectType::Function ||
+           object->type == ObjectType::Task;
+}
+
+// Objects are laid out back to back; each header records its size.
+template <typename F>
+void walk(std::byte* data, std::size_t used, F&& visit) {
+    for (std::size_t offset = 0; offset < used;) {
+        auto* object = reinterpret_cast<Object*>(data + offset);
+        offset += object->size;
+        visit(object);
+    }
+}
+
+// Moves a non-trivial object; `to` may overlap `from` from below.
+template <typename T>
+void move_object(Object* from, Object* to) {
+    T* source = static_cast<T*>(from);
+    if (reinterpret_cast<std::byte*>(to) + from->size <= reinterpret_cast<std::byte*>(from)) {
+        new (to) T(std::move(*source));
+        source->~T();
+    } else {
+        T temp(std::move(*source));
+        source->~T();
+        new (to) T(std::move(temp));
+    }
+}
+
+}  // namespace
+
+Heap::Heap() : Heap(Config()) {}
+
+Heap::Heap(const Config& config)
+    : config_(config), nursery_(config.nursery_bytes), major_threshold_(config.major_threshold) {
+    // Anything that would not fit in an old-generation block is large.
+    config_.large_object_bytes = std::min(config_.large_object_bytes, config_.block_bytes);
+}
+
+Heap::~Heap() {
+    nursery_.for_each_chunk([](const std::byte* data, std::size_t used) {
+        walk(const_cast<std::byte*>(data), used, destroy);
+    });
+    for_each_old(destroy);
+    for (Object* object : large_) {
+        destroy(object);
+        ::operator delete(object);
+    }
+}
+
+void* Heap::allocate(std::size_t bytes, std::uint8_t& flags) {
+    stats_.bytes_allocated += bytes;
+    if (bytes >= config_.large_object_bytes) {
+        flags = kOld | kLarge;
+        stats_.large_bytes += bytes;
+        if (requested_ == Request::None) request(Request::Minor);  // lets collect() check the major threshold
+        return ::operator new(bytes);
+    }
+    flags = 0;
+    stats_.nursery_used += bytes;
+    if (stats_.nursery_used > config_.nursery_bytes && requested_ == Request::None) request(Request::Minor);
+    return nursery_.allocate(bytes, kAlign);
+}
+
+template <typename T, typename... Args>
+T* Heap::construct(std::size_t bytes, Args&&... args) {
+    std::uint8_t flags;
+    void* memory = allocate(bytes, flags);
+    T* object = new (memory) T(std::forward<Args>(args)...);
+    object->flags = flags;
+    object->size = static_cast<std::uint32_t>(bytes);
+    object->hash = ++next_hash_ * 2654435761u;
+    object->epoch = epoch_;
+    if (flags & kLarge) large_.push_back(object);
+    return object;
+}
+
+String* Heap::make_string(std::string_view bytes) {
+    String* s = construct<String>(align_up(sizeof(String) + bytes.size() + 1), static_cast<std::uint32_t>(bytes.size()));
+    if (!bytes.empty()) std::memcpy(s->chars(), bytes.data(), bytes.size());
+    s->chars()[bytes.size()] = '\0';
+    s->hash = String::hash_bytes(bytes);
+    return s;
+}
+
+Table* Heap::make_table(std::size_t array_hint, std::size_t hash_hint) {
+    Table* t = construct<Table>(align_up(sizeof(Table)));
+    t->reserve(array_hint, hash_hint);
+    return t;
+}
+
+Function* Heap::make_function() { return construct<Function>(align_up(sizeof(Function))); }
+
+NativeFunction* Heap::make_native(std::string name, NativeFn fn, void* userdata) {
+    return construct<NativeFunction>(align_up(sizeof(NativeFunction)), std::move(name), fn, userdata);
+}
+
+Task* Heap::make_task(Task::Kind kind) { return construct<Task>(align_up(sizeof(Task)), kind); }
+
+void* Heap::allocate_old(std::size_t bytes) {
+    if (blocks_.empty() || blocks_.back().used + bytes > config_.block_bytes) {
+        Block block;
+        block.data.reset(new std::byte[config_.block_bytes]);
+        blocks_.push_back(std::move(block));
+    }
+    Block& block = blocks_.back();
+    void* memory = block.data.get() + block.used;
+    block.used += bytes;
+    return memory;
+}
+
+void Heap::remember(Object* holder) {
+    holder->flags |= kRemembered;
+    remembered_.push_back(holder);
+}
+
+template <typename F>
+void Heap::for_each_old(F&& visit) {
+    for (Block& block : blocks_) walk(block.data.get(), block.used, visit);
+}
+
+void Heap::visit(Value& value) {
+    if (!value.is_object()) return;
+    // Only the pointer changes: during compaction the header at the new
+    // address still belongs to whatever has not been relocated yet.
+    visit_object(value.object_);
+}
+
+void Heap::visit_object(Object*& object) {
+    if (!object) return;
+    switch (phase_) {
+        case Phase::Evacuate:
+            if (!(object->flags & kOld)) object = object->forward ? object->forward : evacuate(object);
+            break;
+        case Phase::Mark:
+            if (!(object->flags & kMarked)) {
+                object->flags |= kMarked;
+                if (has_references(object)) worklist_.push_back(object);
+            }
+            break;
+        case Phase::Update:
+            if ((object->flags & (kOld | kLarge)) == kOld) object = object->forward;
+            break;
+        case Phase::Idle: break;
+    }
+}
+
+void Heap::trace(Object* object) {
+    if (object->type == ObjectType::Table) {
+        static_cast<Table*>(object)->for_each_ref([this](Value& v) { visit(v); });
+    } else if (object->type == ObjectType::Function) {
+        for (Value& v : static_cast<Function*>(object)->constants) visit(v);
+    } else if (object->type == ObjectType::Task) {
+        auto* task = static_cast<Task*>(object);
+        task->for_each_ref([this](Value& v) { visit(v); });
+        visit(task->fn);
+    }
+}
+
+Object* Heap::evacuate(Object* object) {
+    auto* to = static_cast<Object*>(allocate_old(object->size));
+    switch (object->type) {
+        case ObjectType::String: std::memcpy(static_cast<void*>(to), object, object->size); break;
+        case ObjectType::Table: new (to) Table(std::move(*static_cast<Table*>(object))); break;
+        case ObjectType::Function: new (to) Function(std::move(*static_cast<Function*>(object))); break;
+        case ObjectType::Native: new (to) NativeFunction(std::move(*static_cast<NativeFunction*>(object))); break;
+        case ObjectType::Task: new (to) Task(std::move(*static_cast<Task*>(object))); break;
+    }
+    to->flags = kOld;
+    to->forward = nullptr;
+    object->forward = to;
+    stats_.bytes_promoted += object->size;
+    if (has_references(to)) worklist_.push_back(to);
+    return to;
+}
+
+void Heap::collect() {
+    const auto start = std::chrono::steady_clock::now();
+    minor();
+    std::size_t old_bytes = stats_.large_bytes;
+    for (const Block& block : blocks_) old_bytes += block.used;
+    if (requested_ == Request::Major || old_bytes > major_threshold_) major();
+    requested_ = Request::None;
+    safepoint_.fetch_and(static_cast<std::uint8_t>(~kCollect), std::memory_order_relaxed);
+
+    const auto pause = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    stats_.last_pause_ns = pause;
+    stats_.max_pause_ns = std::max(stats_.max_pause_ns, pause);
+    stats_.total_pause_ns += pause;
+}
+
+void Heap::collect_major() {
+    request_major();
+    collect();
+}
+
+void Heap::minor() {
+    const std::uint64_t promoted_before = stats_.bytes_promoted;
+    phase_ = Phase::Evacuate;
+    if (scanner_) scanner_(*this);
+    for (Object* holder : remembered_) {
+        holder->flags &= static_cast<std::uint8_t>(~kRemembered);
+        trace(holder);
+    }
+    remembered_.clear();
+    while (!worklist_.empty()) {
+        Object* object = worklist_.back();
+        worklist_.pop_back();
+        trace(object);
+    }
+    phase_ = Phase::Idle;
+
+    // Everything left in the nursery is garbage or a moved-from shell; run
+    // destructors (freeing table and bytecode storage) and drop the region.
+    nursery_.for_each_chunk([](const std::byte* data, std::size_t used) {
+        walk(const_cast<std::byte*>(data), used, destroy);
+    });
+    nursery_.reset();
+    const std::uint64_t promoted = stats_.bytes_promoted - promoted_before;
+    stats_.last_survival_rate =
+        stats_.nursery_used ? static_cast<double>(promoted) / static_cast<double>(stats_.nursery_used) : 0.0;
+    stats_.nursery_used = 0;
+    ++stats_.minor_collections;
+}
+
+void Heap::major() {
+    // The nursery is empty here, so every live object is in the old
+    // generation or the large object space.
+    phase_ = Phase::Mark;
+    if (scanner_) scanner_(*this);
+    while (!worklist_.empty()) {
+        Object* object = worklist_.back();
+        worklist_.pop_back();
+        trace(object);
+    }
+
+    plan_compaction();
+    phase_ = Phase::Update;
+    if (scanner_) scanner_(*this);
+    for_each_old([this](Object* object) {
+        if (object->flags & kMarked) trace(object);
+    });
+    phase_ = Phase::Idle;
+
+    relocate_blocks();
+    sweep_large();
+
+    std::size_t live = stats_.large_bytes;
+    for (const Block& block : blocks_) live += block.used;
+    major_threshold_ = std::max(config_.major_threshold, live * 2);
+    ++stats_.major_collections;
+}
+
+void Heap::plan_compaction() {
+    // Slide live objects towards the first block, keeping their order. The
+    // destination never passes the source, so relocation can proceed in
+    // address order without overwriting anything not yet moved.
+    planned_used_.assign(blocks_.size(), 0);
+    std::size_t dest_block = 0;
+    for (Block& block : blocks_) {
+        walk(block.data.get(), block.used, [&](Object* object) {
+            if (!(object->flags & kMarked)) {
+                object->forward = nullptr;
+                return;
+            }
+            if (planned_used_[dest_block] + object->size > config_.block_bytes) ++dest_block;
+            object->forward = reinterpret_cast<Object*>(blocks_[dest_block].data.get() + planned_used_[dest_block]);
+            planned_used_[dest_block] += object->size;
+        });
+    }
+}
+
+void Heap::relocate_blocks() {
+    for (Block& block : blocks_) {
+        walk(block.data.get(), block.used, [](Object* object) {
+            if (!(object->flags & kMarked)) {
+                destroy(object);
+                return;
+            }
+            Object* to = object->forward;
+            relocate(object, to);
+            to->flags &= static_cast<std::uint8_t>(~kMarked);
+            to->forward = nullptr;
+        });
+    }
+    for (std::size_t i = 0; i < blocks_.size(); ++i) blocks_[i].used = planned_used_[i];
+    while (!blocks_.empty() && blocks_.back().used == 0) blocks_.pop_back();
+}
+
+void Heap::sweep_large() {
+    auto live = large_.begin();
+    for (Object* object : large_) {
+        if (object->flags & kMarked) {
+            object->flags &= static_cast<std::uint8_t>(~kMarked);
+            *live++ = object;
+        } else {
+            stats_.large_bytes -= object->size;
+            destroy(object);
+            ::operator delete(object);
+        }
+    }
+    large_.erase(live, large_.end());
+}
+
+Heap::Stats Heap::stats() const {
+    Stats s = stats_;
+    s.nursery_capacity = config_.nursery_bytes;
+    s.old_bytes = 0;
+    for (const Block& block : blocks_) s.old_bytes += block.used;
+    return s;
+}
+
+void Heap::destroy(Object* object) {
+    switch (object->type) {
+        case ObjectType::String: break;
+        case ObjectType::Table: static_cast<Table*>(object)->~Table(); break;
+        case ObjectType::Function: static_cast<Function*>(object)->~Function(); break;
+        case ObjectType::Native: static_cast<NativeFunction*>(object)->~NativeFunction(); break;
+        case ObjectType::Task: static_cast<Task*>(object)->~Task(); break;
+    }
+}
+
+void Heap::relocate(Object* from, Object* to) {
+    if (from == to) return;
+    switch (from->type) {
+        case ObjectType::String: std::memmove(static_cast<void*>(to), from, from->size); break;
+        case ObjectType::Table: move_object<Table>(from, to); break;
+        case ObjectType::Function: move_object<Function>(from, to); break;
+        case ObjectType::Native: move_object<NativeFunction>(from, to); break;
+        case ObjectType::Task: move_object<Task>(from, to); break;
+    }
+}
+
+}  // namespace rebel::script
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "core/arena.h"
+#include "script/object.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace rebel::script {
+
+/// Generational, moving heap for script objects.
+///
+/// New objects are bump-allocated in a nursery region. A minor collection
+/// copies the survivors into the old generation and releases the nursery in
+/// one step, so the short-lived strings and tables of a call cost no
+/// per-object free. The old generation is a list of blocks filled by bump
+/// allocation and compacted in place by a major (mark-compact) collection.
+/// Strings above `large_object_bytes` live in a non-moving large object
+/// space.
+///
+/// Objects move, so collections happen only when the owner calls collect()
+/// at a safepoint where every reference is reachable through the root
+/// scanner. Allocation never collects; it sets collection_requested().
+///
+/// Stores of a reference into an old object must go through barrier() so
+/// minor collections find young objects referenced only from old ones.
+class Heap {
+public:
+    enum Flags : std::uint8_t {
+        kMarked = 1 << 0,
+        kOld = 1 << 1,
+        kLarge = 1 << 2,
+        kRemembered = 1 << 3,
+    };
+
+    struct Config {
+        std::size_t nursery_bytes = 4 << 20;
+        std::size_t block_bytes = 1 << 20;
+        std::size_t large_object_bytes = 64 << 10;
+        /// Old-generation size that triggers the first major collection;
+        /// afterwards twice the live size, but never less than this.
+        std::size_t major_threshold = 16 << 20;
+    };
+
+    struct Stats {
+        std::size_t nursery_capacity = 0;
+        std::size_t nursery_used = 0;
+        std::size_t old_bytes = 0;    // both generations' blocks in use
+        std::size_t large_bytes = 0;
+        std::uint64_t minor_collections = 0;
+        std::uint64_t major_collections = 0;
+        std::uint64_t bytes_allocated = 0;  // all time
+        std::uint64_t bytes_promoted = 0;   // all time, nursery to old
+        double last_survival_rate = 0;      // promoted / nursery used, last minor collection
+        std::uint64_t last_pause_ns = 0;
+        std::uint64_t max_pause_ns = 0;
+        std::uint64_t total_pause_ns = 0;
+    };
+
+    /// Called by collect(); must pass every root to visit().
+    using RootScanner = std::function<void(Heap&)>;
+
+    Heap();
+    explicit Heap(const Config& config);
+    ~Heap();
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    void set_root_scanner(RootScanner scanner) { scanner_ = std::move(scanner); }
+
+    String* make_string(std::string_view bytes);
+    Table* make_table(std::size_t array_hint = 0, std::size_t hash_hint = 0);
+    Function* make_function();
+    NativeFunction* make_native(std::string name, NativeFn fn, void* userdata);
+    Task* make_task(Task::Kind kind);
+
+    /// Records that `holder` may now reference `value`.
+    void barrier(Object* holder, const Value& value) {
+        if ((holder->flags & (kOld | kRemembered)) == kOld && value.is_object() &&
+            !(value.as_object()->flags & kOld)) {
+            remember(holder);
+        }
+    }
+
+    /// Checkpoints divide time into epochs. An object stamped with an
+    /// earlier epoch than the heap's has not been written since the last
+    /// checkpoint began; see VM::before_write().
+    std::uint32_t epoch() const noexcept { return epoch_; }
+    void advance_epoch() noexcept { ++epoch_; }
+
+    bool collection_requested() const noexcept { return requested_ != Request::None; }
+    /// Whether the owner should stop at its next safepoint: a collection is
+    /// requested, or another thread called interrupt().
+    bool safepoint_requested() const noexcept { return safepoint_.load(std::memory_order_relaxed) != 0; }
+    /// A byte that is nonzero while safepoint_requested(); polled by
+    /// compiled code at loop back-edges.
+    const void* safepoint_flag() const noexcept { return &safepoint_; }
+    /// Makes safepoint_requested() true without asking for a collection.
+    /// The only member safe to call from other threads; what the caller
+    /// wrote before it is visible to the owner after take_interrupt().
+    void interrupt() noexcept { safepoint_.fetch_or(kInterrupted, std::memory_order_release); }
+    /// Whether interrupt() was called since the last take_interrupt().
+    bool take_interrupt() noexcept {
+        return (safepoint_.fetch_and(static_cast<std::uint8_t>(~kInterrupted), std::memory_order_acq_rel) &
+                kInterrupted) != 0;
+    }
+    /// Makes the next collect() a major collection.
+    void request_major() noexcept { request(Request::Major); }
+    /// Runs the requested collection, or a minor one if none was requested.
+    void collect();
+    /// A minor collection followed by a full mark-compact.
+    void collect_major();
+
+    /// Root and field callback for the scanner; updates `value` if its
+    /// object moved.
+    void visit(Value& value);
+    template <typename T>
+    void visit(T*& object) {
+        Object* o = object;
+        visit_object(o);
+        object = static_cast<T*>(o);
+    }
+
+    Stats stats() const;
+    const Config& config() const noexcept { return config_; }
+
+private:
+    enum class Request : std::uint8_t { None, Minor, Major };
+    static constexpr std::uint8_t kCollect = 1;      // bits of safepoint_
+    static constexpr std::uint8_t kInterrupted = 2;
+    enum class Phase : std::uint8_t { Idle, Evacuate, Mark, Update };
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t used = 0;
+    };
+
+    void request(Request request) noexcept {
+        requested_ = request;
+        safepoint_.fetch_or(kCollect, std::memory_order_relaxed);
+    }
+    void* allocate(std::size_t bytes, std::uint8_t& flags);
+    template <typename T, typename... Args>
+    T* construct(std::size_t bytes, Args&&... args);
+    void* allocate_old(std::size_t bytes);
+    void remember(Object* holder);
+
+    void visit_object(Object*& object);
+    void trace(Object* object);
+    Object* evacuate(Object* object);
+
+    void minor();
+    void major();
+    void plan_compaction();
+    void relocate_blocks();
+    void sweep_large();
+
+    template <typename F>
+    void for_each_old(F&& visit);
+    static void destroy(Object* object);
+    static void relocate(Object* from, Object* to);
+
+    Config config_;
+    core::Arena nursery_;
+    std::vector<Block> blocks_;
+    std::vector<Object*> large_;
+    std::vector<Object*> remembered_;
+    std::vector<Object*> worklist_;
+    std::vector<std::size_t> planned_used_;  // per block, during compaction
+    RootScanner scanner_;
+    Stats stats_;
+    std::size_t major_threshold_;
+    std::uint32_t next_hash_ = 0;
+    std::uint32_t epoch_ = 0;
+    Request requested_ = Request::None;
+    std::atomic<std::uint8_t> safepoint_{0};
+    Phase phase_ = Phase::Idle;
+};
+
+}  // namespace rebel::script
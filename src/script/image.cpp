@@ -0,0 +1,206 @@
+#include "script/image.h"
+
+#include "core/hash.h"
+#include "core/mapped_file.h"
+#include "core/startup_trace.h"
+#include "script/compiler.h"
+#include "script/debugger.h"
+#include "script/serialize.h"
+#include "script/vm.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <system_error>
+
+namespace rebel::script {
+namespace {
+
+constexpr char kMagic[6] = {'R', 'B', 'L', 'I', 'M', 'G'};
+
+struct Header {
+    char magic[6];
+    std::uint16_t version;
+    std::uint64_t key;
+    std::uint32_t strings;
+    std::uint32_t tables;
+    std::uint32_t functions;
+    std::uint32_t globals;
+    std::uint64_t instructions;
+    std::uint64_t payload_bytes;
+    std::uint64_t payload_hash;
+};
+static_assert(sizeof(Header) == 56, "image header layout");
+
+std::uint64_t prelude_key(const std::vector<PreludeChunk>& chunks) {
+    // The compiler, the instruction set and the sources: an image from
+    // another build, or of other chunks, is rebuilt. Natives are checked by
+    // name when restoring.
+    std::uint64_t key = core::hash64(std::string_view(kMagic, sizeof kMagic), serial::instruction_set_hash());
+    key = core::hash64(&kCompilerVersion, sizeof kCompilerVersion, key);
+    for (const PreludeChunk& chunk : chunks) {
+        key = core::hash64(chunk.name, key);
+        key = core::hash64(chunk.source, key);
+    }
+    return key;
+}
+
+}  // namespace
+
+RuntimeImage::~RuntimeImage() = default;
+
+RuntimeImage::Stats RuntimeImage::save(VM& vm, const std::string& path, std::uint64_t key, std::string_view metadata) {
+    serial::ObjectWriter objects(vm);
+    std::uint32_t globals = 0;
+    for (std::size_t slot = 0; slot < vm.globals_.size(); ++slot) {
+        if (!vm.defined_[slot]) continue;
+        objects.string(vm.global_names_[slot]);
+        objects.add(vm.globals_[slot]);
+        ++globals;
+    }
+    for (Function* chunk : vm.chunks_) objects.add(Value::object(chunk));
+    for (const NativeFunction* native : objects.natives()) {
+        const Value found = vm.global(native->name);
+        if (!found.is_native() || found.as_native() != native) {
+            throw ImageError("cannot save native '" + native->name + "': it is no longer the global of that name");
+        }
+    }
+
+    serial::Out out;
+    out.u32(static_cast<std::uint32_t>(metadata.size()));
+    out.raw(metadata.data(), metadata.size());
+    objects.write(out);
+    out.u32(globals);
+    for (std::size_t slot = 0; slot < vm.globals_.size(); ++slot) {
+        if (!vm.defined_[slot]) continue;
+        out.u32(objects.index(vm.global_names_[slot]));
+        objects.value(out, vm.globals_[slot]);
+    }
+    out.u32(static_cast<std::uint32_t>(vm.chunks_.size()));
+    for (const Function* chunk : vm.chunks_) out.u32(objects.index(chunk));
+
+    const std::string& payload = out.bytes();
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof kMagic);
+    h.version = kVersion;
+    h.key = key;
+    h.strings = static_cast<std::uint32_t>(objects.string_count());
+    h.tables = static_cast<std::uint32_t>(objects.table_count());
+    h.functions = static_cast<std::uint32_t>(objects.function_count());
+    h.globals = globals;
+    h.instructions = objects.instruction_count();
+    h.payload_bytes = payload.size();
+    h.payload_hash = core::hash64(payload);
+
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("cannot write runtime image " + temp);
+        file.write(reinterpret_cast<const char*>(&h), sizeof h);
+        file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        file.flush();
+        if (!file) throw std::runtime_error("cannot write runtime image " + temp);
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    if (error) throw std::runtime_error("cannot replace runtime image " + path + ": " + error.message());
+
+    Stats stats;
+    stats.bytes = sizeof h + payload.size();
+    stats.strings = h.strings;
+    stats.tables = h.tables;
+    stats.functions = h.functions;
+    stats.instructions = h.instructions;
+    stats.globals = globals;
+    return stats;
+}
+
+std::unique_ptr<RuntimeImage> RuntimeImage::open(const std::string& path, std::uint64_t key) {
+    std::shared_ptr<const core::MappedFile> file;
+    try {
+        file = core::MappedFile::open(path);
+    } catch (const std::system_error&) {
+        return nullptr;
+    }
+    Header h;
+    if (file->size() < sizeof h) return nullptr;
+    std::memcpy(&h, file->data(), sizeof h);
+    if (std::memcmp(h.magic, kMagic, sizeof kMagic) != 0 || h.version != kVersion || h.key != key) return nullptr;
+    if (h.payload_bytes != file->size() - sizeof h) serial::In::damaged();
+
+    std::unique_ptr<RuntimeImage> image(new RuntimeImage(std::move(file)));
+    image->file_->advise(core::MappedFile::Access::Sequential);
+    image->payload_ = image->file_->view().substr(sizeof h);
+    if (core::hash64(image->payload_) != h.payload_hash) serial::In::damaged();
+    serial::In in(image->payload_);
+    image->metadata_ = in.bytes(in.u32());
+    image->stats_.bytes = image->file_->size();
+    image->stats_.strings = h.strings;
+    image->stats_.tables = h.tables;
+    image->stats_.functions = h.functions;
+    image->stats_.instructions = h.instructions;
+    image->stats_.globals = h.globals;
+    return image;
+}
+
+void RuntimeImage::restore(VM& vm) const {
+    serial::In in(payload_);
+    in.bytes(in.u32());  // metadata
+    serial::ObjectReader objects(vm, in);
+    const std::uint32_t globals = in.count(6);
+    for (std::uint32_t g = 0; g < globals; ++g) {
+        const std::string_view name = objects.text(in.u32());
+        vm.set_global(name, objects.value(in));
+    }
+    const std::uint32_t chunks = in.count(4);
+    for (std::uint32_t c = 0; c < chunks; ++c) {
+        Function* fn = objects.function(in.u32());
+        vm.chunks_.push_back(fn);
+        if (vm.debugger_) vm.debugger_->loaded(*fn);
+    }
+}
+
+bool open_prelude(VM& vm, const std::vector<PreludeChunk>& chunks, const std::string& image_path,
+                  std::string_view metadata, std::string* loaded_metadata, core::StartupTrace* trace) {
+    const std::uint64_t key = prelude_key(chunks);
+    auto phase = [&](const char* name) {
+        return trace ? std::optional<core::StartupTrace::Scope>(trace->phase(name)) : std::nullopt;
+    };
+
+    std::unique_ptr<RuntimeImage> image;
+    {
+        const auto scope = phase("script.image.open");
+        try {
+            image = RuntimeImage::open(image_path, key);
+        } catch (const ImageError&) {  // damaged
+            image = nullptr;
+        }
+    }
+    if (image) {
+        const auto scope = phase("script.image.restore");
+        try {
+            image->restore(vm);
+            if (loaded_metadata) *loaded_metadata = std::string(image->metadata());
+            return true;
+        } catch (const ImageError&) {
+            // Missing natives leave the VM untouched; run the chunks instead.
+        }
+    }
+    {
+        const auto scope = phase("script.prelude.run");
+        for (const PreludeChunk& chunk : chunks) vm.run(chunk.source, chunk.name);
+    }
+    {
+        const auto scope = phase("script.image.save");
+        try {
+            RuntimeImage::save(vm, image_path, key, metadata);
+        } catch (const std::exception&) {
+            // Next launch runs the chunks again.
+        }
+    }
+    if (loaded_metadata) *loaded_metadata = std::string(metadata);
+    return false;
+}
+
+}  // namespace rebel::script
@@ -0,0 +1,124 @@
+#pragma once
+
+// Runtime images: what a VM's globals and loaded chunks hold, saved so a
+// later VM can take them back without compiling or running anything.
+//
+//   file     := header payload
+//   header   := "RBLIMG" version:u16 key:u64 strings:u32 tables:u32 functions:u32
+//               globals:u32 instructions:u64 payload_bytes:u64 payload_hash:u64
+//   payload  := metadata objects globals chunks
+//   metadata := length:u32 bytes
+//   objects  := the strings, tables and functions (see script/serialize.h)
+//   globals  := count:u32 (name:u32 value)*
+//   chunks   := count:u32 function:u32*
+//
+// Integers are little-endian; names and values refer to the objects by
+// index. The payload hash (core::hash64) rejects torn or corrupt files.
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rebel::core {
+class MappedFile;
+class StartupTrace;
+}  // namespace rebel::core
+
+namespace rebel::script {
+
+class VM;
+
+/// A runtime image that cannot be saved or restored.
+class ImageError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// A saved runtime image, mapped from disk.
+///
+/// Launching an editor runs the same initialization every time: compile
+/// the standard library, run it to define its globals, read plugin
+/// manifests. An image records the outcome instead: every defined global
+/// and everything reachable from it (strings, tables, compiled functions
+/// with their bytecode), the chunks the VM loaded, and an opaque metadata
+/// blob for the host. Restoring it allocates the objects straight from the
+/// mapping, in one pass and without the lexer, parser or compiler, and
+/// leaves the VM as if the initialization had just run.
+///
+/// Natives cannot be saved; an image refers to them by name, and they are
+/// looked up among the restoring VM's globals, so the host defines its
+/// natives before restore(). Global slots are renumbered for the restoring
+/// VM, which may therefore have defined other globals first.
+class RuntimeImage {
+public:
+    static constexpr std::uint16_t kVersion = 1;
+
+    /// What a saved image holds.
+    struct Stats {
+        std::size_t bytes = 0;
+        std::size_t strings = 0;
+        std::size_t tables = 0;
+        std::size_t functions = 0;
+        std::size_t instructions = 0;
+        std::size_t globals = 0;
+    };
+
+    /// Writes everything `vm` has defined, through a temporary file renamed
+    /// over `path`. `key` identifies what the image was built from (see
+    /// open()). Throws ImageError if the state cannot be saved (a global
+    /// holds a native defined under another name, or the debugger has
+    /// patched the code) and std::runtime_error if the file cannot be
+    /// written.
+    static Stats save(VM& vm, const std::string& path, std::uint64_t key, std::string_view metadata = {});
+
+    /// Maps the image at `path` if it is one of this version built with
+    /// `key`; otherwise, or if there is no file, returns null. Throws
+    /// ImageError if the file is damaged.
+    static std::unique_ptr<RuntimeImage> open(const std::string& path, std::uint64_t key);
+
+    ~RuntimeImage();
+    RuntimeImage(const RuntimeImage&) = delete;
+    RuntimeImage& operator=(const RuntimeImage&) = delete;
+
+    /// Defines the image's globals in `vm` and adds its chunks to the
+    /// loaded ones (an attached debugger sees them load). Throws ImageError,
+    /// leaving `vm` unchanged, if the image needs a native `vm` lacks.
+    void restore(VM& vm) const;
+
+    std::string_view metadata() const noexcept { return metadata_; }
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    explicit RuntimeImage(std::shared_ptr<const core::MappedFile> file) : file_(std::move(file)) {}
+
+    std::shared_ptr<const core::MappedFile> file_;
+    std::string_view payload_;
+    std::string_view metadata_;
+    Stats stats_;
+};
+
+/// A chunk of the script standard library, or of a plugin.
+struct PreludeChunk {
+    std::string name;
+    std::string source;
+};
+
+/// Brings the standard library into `vm`: restores it from the image at
+/// `image_path` when that was built from the same `chunks` and the same
+/// natives, and otherwise runs the chunks in order and saves a fresh image
+/// there for next time (an image that cannot be saved is not an error).
+/// `metadata` is stored with a fresh image; `loaded_metadata`, if given,
+/// receives the metadata of the image used. Phases go to `trace` when
+/// given. Returns true if the image was used.
+///
+/// Errors in the chunks propagate as with VM::run(); a damaged image is
+/// replaced.
+bool open_prelude(VM& vm, const std::vector<PreludeChunk>& chunks, const std::string& image_path,
+                  std::string_view metadata = {}, std::string* loaded_metadata = nullptr,
+                  core::StartupTrace* trace = nullptr);
+
+}  // namespace rebel::script
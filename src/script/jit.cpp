@@ -0,0 +1,916 @@
+#include "script/jit.h"
+
+#include "script/vm.h"
+#include "script/x64_assembler.h"
+
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace rebel::script {
+namespace {
+
+using namespace x64;
+
+// Value layout, checked in Jit::compile.
+constexpr std::int32_t kTag = 0;
+constexpr std::int32_t kPayload = 8;
+constexpr std::int32_t kValueSize = 16;
+
+constexpr std::uint8_t tag(ValueType t) { return static_cast<std::uint8_t>(t); }
+
+template <typename F>
+std::uint64_t address(F* p) {
+    return reinterpret_cast<std::uint64_t>(p);
+}
+
+// Runtime stubs called from compiled code. None may throw: there is no
+// unwind information for JIT frames. Anything that would raise an error
+// returns false and the instruction is left to the interpreter.
+
+bool stub_arith(Jit::Context* ctx, Value* dst, const Value* a, const Value* b, int op) noexcept {
+    if (a->is_number() && b->is_number()) {
+        const double x = a->as_number();
+        const double y = b->as_number();
+        switch (static_cast<Op>(op)) {
+            case Op::Add: *dst = Value::number(x + y); break;
+            case Op::Sub: *dst = Value::number(x - y); break;
+            case Op::Mul: *dst = Value::number(x * y); break;
+            case Op::Div: *dst = Value::number(x / y); break;
+            default: *dst = Value::number(floor_mod(x, y)); break;
+        }
+        return true;
+    }
+    const auto text = [](const Value* v) { return v->is_string() || v->is_number(); };
+    if (static_cast<Op>(op) == Op::Add && (a->is_string() || b->is_string()) && text(a) && text(b)) {
+        VM& vm = *ctx->vm;
+        *dst = vm.new_string(vm.to_display_string(*a) + vm.to_display_string(*b));
+        return true;
+    }
+    return false;
+}
+
+// 0 or 1, or 2 when the operands cannot be ordered.
+int stub_less(const Value* a, const Value* b, int or_equal) noexcept {
+    if (a->is_number() && b->is_number()) {
+        return or_equal ? a->as_number() <= b->as_number() : a->as_number() < b->as_number();
+    }
+    if (a->is_string() && b->is_string()) {
+        const int c = a->as_string()->view().compare(b->as_string()->view());
+        return or_equal ? c <= 0 : c < 0;
+    }
+    return 2;
+}
+
+bool stub_equal(const Value* a, const Value* b) noexcept { return values_equal(*a, *b); }
+
+bool stub_len(Value* dst, const Value* v) noexcept {
+    if (v->is_string()) {
+        *dst = Value::number(v->as_string()->length);
+    } else if (v->is_table()) {
+        *dst = Value::number(static_cast<double>(v->as_table()->length()));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void stub_new_table(Jit::Context* ctx, Value* dst, int array_hint, int hash_hint) noexcept {
+    *dst = ctx->vm->new_table(static_cast<std::size_t>(array_hint), static_cast<std::size_t>(hash_hint));
+}
+
+void stub_set_list(Jit::Context* ctx, Value* ra, int count, int batch) noexcept {
+    Table* t = ra->as_table();
+    const int first = batch * kSetListBatch;
+    for (int j = 0; j < count; ++j) ctx->vm->table_set(t, Value::number(first + j), ra[1 + j]);
+}
+
+bool stub_get_table(Value* dst, const Value* object, const Value* key) noexcept {
+    if (!object->is_table()) return false;
+    *dst = object->as_table()->get(*key);
+    return true;
+}
+
+bool stub_set_table(Jit::Context* ctx, const Value* object, const Value* key, const Value* value) noexcept {
+    if (!object->is_table() || key->is_nil() || (key->is_number() && key->as_number() != key->as_number())) {
+        return false;
+    }
+    ctx->vm->table_set(object->as_table(), *key, *value);
+    return true;
+}
+
+bool stub_get_field(Value* dst, const Value* object, const Value* key, FieldCache* cache) noexcept {
+    if (!object->is_table()) return false;
+    const Value* slot = object->as_table()->find_field(key->as_string(), cache->slot);
+    *dst = slot ? *slot : Value();
+    return true;
+}
+
+bool stub_set_field(Jit::Context* ctx, const Value* object, const Value* key, const Value* value,
+                    FieldCache* cache) noexcept {
+    if (!object->is_table()) return false;
+    // table_set() with the lookup done once, and cached for next time.
+    Table* t = object->as_table();
+    VM& vm = *ctx->vm;
+    vm.before_write(t);
+    t->set_field(key->as_string(), *value, cache->slot);
+    vm.heap().barrier(t, *key);
+    vm.heap().barrier(t, *value);
+    return true;
+}
+
+bool stub_tfor_next(Value* r) noexcept {
+    auto cursor = static_cast<std::size_t>(r[1].as_number());
+    if (!r[0].as_table()->next(cursor, r[2], r[3])) return false;
+    r[1] = Value::number(static_cast<double>(cursor));
+    return true;
+}
+
+constexpr std::int32_t slot(int reg) { return reg * kValueSize; }
+
+// Whether `fn` has loops, and their bodies (counted once per loop they
+// are in) run kInstructionsPerCall instructions or more per call they make.
+bool worth_compiling(const Function& fn) {
+    constexpr std::size_t kInstructionsPerCall = 8;
+    std::size_t body = 0;
+    std::size_t calls = 0;
+    for (std::size_t pc = 0; pc < fn.code.size(); ++pc) {
+        const Instruction i = fn.code[pc];
+        int back = 0;
+        switch (op_of(i)) {
+            case Op::ForLoop:
+            case Op::TForNext: back = arg_sbx(i); break;
+            case Op::Jmp: back = arg_sj(i); break;
+            default: break;
+        }
+        if (back >= 0 || static_cast<std::size_t>(-back) > pc + 1) continue;
+        for (std::size_t at = pc + 1 - static_cast<std::size_t>(-back); at <= pc; ++at) {
+            ++body;
+            calls += op_of(fn.code[at]) == Op::Call;
+        }
+    }
+    return body > 0 && body >= calls * kInstructionsPerCall;
+}
+
+// Translates one function, instruction by instruction. rbx holds the frame
+// base and r12 the Jit::Context; everything else is scratch between
+// instructions.
+class Emitter {
+public:
+    Emitter(const Function& fn, FieldCache* caches, const void* safepoint_flag, std::int32_t hash_begin,
+            std::int32_t hash_end)
+        : fn_(fn), caches_(caches), safepoint_flag_(safepoint_flag), hash_begin_(hash_begin), hash_end_(hash_end) {}
+
+    bool emit() {
+        const std::vector<Instruction>& code = fn_.code;
+        if (code.empty()) return false;
+        for (std::size_t pc = 0; pc < code.size(); ++pc) labels_.push_back(as_.new_label());
+        exits_.assign(code.size() * 2, Label{});
+
+        // entry(base, context, target): save callee-saved registers (three
+        // pushes keep the stack 16-byte aligned for stub calls) and jump to
+        // the requested instruction.
+        as_.push(rbx);
+        as_.push(r12);
+        as_.push(r13);
+        as_.mov(rbx, rdi);
+        as_.mov(r12, rsi);
+        as_.jmp(rdx);
+        epilogue_ = as_.new_label();
+        as_.bind(epilogue_);
+        as_.pop(r13);
+        as_.pop(r12);
+        as_.pop(rbx);
+        as_.ret();
+
+        std::size_t cache = 0;
+        for (std::size_t pc = 0; pc < code.size(); ++pc) {
+            as_.bind(labels_[pc]);
+            offsets_.push_back(static_cast<std::uint32_t>(as_.size()));
+            if (!instruction(pc, code[pc], cache)) return false;
+        }
+        for (auto& cold : cold_) cold();
+        for (std::size_t e = 0; e < exits_.size(); ++e) {
+            if (exits_[e].id < 0) continue;
+            as_.bind(exits_[e]);
+            // Resume at this instruction; the low bit marks a deoptimization.
+            as_.mov_imm32(rax, static_cast<std::uint32_t>(e));
+            as_.jmp(epilogue_);
+        }
+        as_.finish();
+        return true;
+    }
+
+    const std::vector<std::uint8_t>& code() { return as_.finish(); }
+    std::vector<std::uint32_t>& offsets() { return offsets_; }
+
+private:
+    Label exit(std::size_t pc, bool deopt) {
+        Label& l = exits_[pc * 2 + (deopt ? 1 : 0)];
+        if (l.id < 0) l = as_.new_label();
+        return l;
+    }
+    Label deopt(std::size_t pc) { return exit(pc, true); }
+
+    const Value* constant(int index) const { return &fn_.constants[static_cast<std::size_t>(index)]; }
+    bool number_constant(int index, double& d) const {
+        const Value& k = fn_.constants[static_cast<std::size_t>(index)];
+        if (!k.is_number()) return false;
+        d = k.as_number();
+        return true;
+    }
+
+    template <typename F>
+    void call(F* fn) {
+        as_.mov_imm64(rax, address(fn));
+        as_.call(rax);
+    }
+    void guard_number(int reg, Label fail) {
+        as_.cmp8_imm(rbx, slot(reg) + kTag, tag(ValueType::Number));
+        as_.jcc(Cond::NotEqual, fail);
+    }
+    void store_number(int reg, Xmm x) {
+        as_.store8_imm(rbx, slot(reg) + kTag, tag(ValueType::Number));
+        as_.movsd_store(rbx, slot(reg) + kPayload, x);
+    }
+    void store_tagged(int reg, ValueType t, std::int32_t payload) {
+        as_.store8_imm(rbx, slot(reg) + kTag, tag(t));
+        as_.store64_imm(rbx, slot(reg) + kPayload, payload);
+    }
+    void load_double(Xmm x, double d) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof bits);
+        as_.mov_imm64(rax, bits);
+        as_.movq(x, rax);
+    }
+    // Exits before `pc` if the heap wants to collect or the VM was
+    // interrupted; used on back-edges.
+    void safepoint(std::size_t pc) {
+        as_.mov_imm64(rax, address(safepoint_flag_));
+        as_.cmp8_imm(rax, 0, 0);
+        as_.jcc(Cond::NotEqual, exit(pc, false));
+    }
+    // Jumps to `label` unless the value in `reg` is truthy (nil and false
+    // are falsy), falling through otherwise.
+    void jump_if_falsy(int reg, Label label) {
+        const Label truthy = as_.new_label();
+        as_.cmp8_imm(rbx, slot(reg) + kTag, tag(ValueType::Nil));
+        as_.jcc(Cond::Equal, label);
+        as_.cmp8_imm(rbx, slot(reg) + kTag, tag(ValueType::Bool));
+        as_.jcc(Cond::NotEqual, truthy);
+        as_.cmp8_imm(rbx, slot(reg) + kPayload, 0);
+        as_.jcc(Cond::Equal, label);
+        as_.bind(truthy);
+    }
+    // The Jmp after a comparison is taken when the outcome equals C;
+    // `outcome` is the condition under which the comparison holds.
+    bool cond_jump(std::size_t pc, Instruction i, Cond outcome) {
+        if (pc + 2 >= fn_.code.size() || op_of(fn_.code[pc + 1]) != Op::Jmp) return false;
+        const auto target = static_cast<std::ptrdiff_t>(pc) + 2 + arg_sj(fn_.code[pc + 1]);
+        if (target < 0 || target >= static_cast<std::ptrdiff_t>(fn_.code.size())) return false;
+        as_.jcc(arg_c(i) ? outcome : negate(outcome), labels_[static_cast<std::size_t>(target)]);
+        as_.jmp(labels_[pc + 2]);
+        return true;
+    }
+    // Outcome in al (nonzero when the comparison holds).
+    bool cond_jump_al(std::size_t pc, Instruction i) {
+        as_.test8(rax, rax);
+        return cond_jump(pc, i, Cond::NotEqual);
+    }
+    bool relative(std::size_t pc, int offset, Label& out) const {
+        const auto target = static_cast<std::ptrdiff_t>(pc) + 1 + offset;
+        if (target < 0 || target >= static_cast<std::ptrdiff_t>(fn_.code.size())) return false;
+        out = labels_[static_cast<std::size_t>(target)];
+        return true;
+    }
+
+    // dst = lhs op rhs, inline for numbers; `rhs` is a register or, for the
+    // K forms, a number constant.
+    void arith(std::size_t pc, Op op, int a, int b, int c, bool constant_rhs) {
+        const Label slow = as_.new_label();
+        const Label done = as_.new_label();
+        double k = 0;
+        const bool inline_op = op != Op::Mod && (!constant_rhs || number_constant(c, k));
+        if (inline_op) {
+            guard_number(b, slow);
+            if (!constant_rhs) guard_number(c, slow);
+            as_.movsd_load(xmm0, rbx, slot(b) + kPayload);
+            if (constant_rhs) {
+                load_double(xmm1, k);
+            } else {
+                as_.movsd_load(xmm1, rbx, slot(c) + kPayload);
+            }
+            switch (op) {
+                case Op::Add: as_.addsd(xmm0, xmm1); break;
+                case Op::Sub: as_.subsd(xmm0, xmm1); break;
+                case Op::Mul: as_.mulsd(xmm0, xmm1); break;
+                default: as_.divsd(xmm0, xmm1); break;
+            }
+            store_number(a, xmm0);
+            as_.jmp(done);
+        } else {
+            as_.jmp(slow);
+        }
+        cold_.push_back([=] {
+            as_.bind(slow);
+            as_.mov(rdi, r12);
+            as_.lea(rsi, rbx, slot(a));
+            as_.lea(rdx, rbx, slot(b));
+            if (constant_rhs) {
+                as_.mov_imm64(rcx, address(constant(c)));
+            } else {
+                as_.lea(rcx, rbx, slot(c));
+            }
+            as_.mov_imm32(r8, static_cast<std::uint32_t>(op));
+            call(&stub_arith);
+            as_.test8(rax, rax);
+            as_.jcc(Cond::Equal, deopt(pc));
+            as_.jmp(done);
+        });
+        as_.bind(done);
+    }
+
+    // Ordered comparison of register a with register b or a constant,
+    // leaving the outcome in al. `flip` compares b < a instead.
+    void less(std::size_t pc, int a, int b, bool constant_b, bool or_equal, bool flip) {
+        const Label slow = as_.new_label();
+        const Label done = as_.new_label();
+        guard_number(a, constant_b ? deopt(pc) : slow);
+        if (!constant_b) guard_number(b, slow);
+        as_.movsd_load(xmm0, rbx, slot(a) + kPayload);
+        if (constant_b) {
+            double k = 0;
+            number_constant(b, k);
+            load_double(xmm1, k);
+        } else {
+            as_.movsd_load(xmm1, rbx, slot(b) + kPayload);
+        }
+        // x < y is "y above x"; unordered operands compare false.
+        if (flip) {
+            as_.ucomisd(xmm0, xmm1);
+        } else {
+            as_.ucomisd(xmm1, xmm0);
+        }
+        as_.setcc(or_equal ? Cond::AboveEqual : Cond::Above, rax);
+        if (!constant_b) {
+            as_.jmp(done);
+            cold_.push_back([=] {
+                as_.bind(slow);
+                as_.lea(rdi, rbx, slot(a));
+                as_.lea(rsi, rbx, slot(b));
+                as_.mov_imm32(rdx, or_equal ? 1 : 0);
+                call(&stub_less);
+                as_.cmp32_imm(rax, 2);
+                as_.jcc(Cond::Equal, deopt(pc));
+                as_.jmp(done);
+            });
+        }
+        as_.bind(done);
+    }
+
+    // Inline cache probe: with the Table* in rax, leaves the hash entry at
+    // the cached slot in rdx if it holds `key` (compared by address, which
+    // interning makes the common case), else jumps to `miss`.
+    void cached_entry(FieldCache* site, const Value* key, Label miss) {
+        as_.mov_imm64(rcx, address(site));
+        as_.load32(rcx, rcx, 0);
+        as_.shl64(rcx, 5);  // sizeof(Table::Entry), checked in Jit::compile
+        as_.load64(rdx, rax, hash_begin_);
+        as_.add64(rdx, rcx);
+        as_.cmp64(rdx, rax, hash_end_);
+        as_.jcc(Cond::AboveEqual, miss);
+        as_.cmp8_imm(rdx, kTag, tag(ValueType::String));
+        as_.jcc(Cond::NotEqual, miss);
+        as_.mov_imm64(rcx, address(key));
+        as_.load64(rcx, rcx, kPayload);
+        as_.cmp64(rcx, rdx, kPayload);
+        as_.jcc(Cond::NotEqual, miss);
+    }
+
+    // Calls a bool stub and deoptimizes when it returns false.
+    template <typename F>
+    void checked_call(std::size_t pc, F* fn) {
+        call(fn);
+        as_.test8(rax, rax);
+        as_.jcc(Cond::Equal, deopt(pc));
+    }
+
+    bool instruction(std::size_t pc, Instruction i, std::size_t& cache) {
+        const int a = arg_a(i);
+        const int b = arg_b(i);
+        const int c = arg_c(i);
+        switch (op_of(i)) {
+            case Op::Move:
+                as_.movups_load(xmm0, rbx, slot(b));
+                as_.movups_store(rbx, slot(a), xmm0);
+                return true;
+            case Op::LoadK:
+                as_.mov_imm64(rax, address(constant(arg_bx(i))));
+                as_.movups_load(xmm0, rax, 0);
+                as_.movups_store(rbx, slot(a), xmm0);
+                return true;
+            case Op::LoadI:
+                load_double(xmm0, arg_sbx(i));
+                store_number(a, xmm0);
+                return true;
+            case Op::LoadNil: store_tagged(a, ValueType::Nil, 0); return true;
+            case Op::LoadTrue: store_tagged(a, ValueType::Bool, 1); return true;
+            case Op::LoadFalse: store_tagged(a, ValueType::Bool, 0); return true;
+            case Op::GetGlobal: {
+                const std::int32_t g = arg_bx(i) * kValueSize;
+                const Label ok = as_.new_label();
+                as_.load64(rax, r12, offsetof(Jit::Context, globals));
+                as_.cmp8_imm(rax, g + kTag, tag(ValueType::Nil));
+                as_.jcc(Cond::NotEqual, ok);
+                as_.load64(rcx, r12, offsetof(Jit::Context, defined));
+                as_.cmp8_imm(rcx, arg_bx(i), 0);
+                as_.jcc(Cond::Equal, deopt(pc));
+                as_.bind(ok);
+                as_.movups_load(xmm0, rax, g);
+                as_.movups_store(rbx, slot(a), xmm0);
+                return true;
+            }
+            case Op::SetGlobal:
+                as_.load64(rax, r12, offsetof(Jit::Context, globals));
+                as_.movups_load(xmm0, rbx, slot(a));
+                as_.movups_store(rax, arg_bx(i) * kValueSize, xmm0);
+                as_.load64(rax, r12, offsetof(Jit::Context, defined));
+                as_.store8_imm(rax, arg_bx(i), 1);
+                return true;
+            case Op::NewTable:
+                as_.mov(rdi, r12);
+                as_.lea(rsi, rbx, slot(a));
+                as_.mov_imm32(rdx, static_cast<std::uint32_t>(b));
+                as_.mov_imm32(rcx, static_cast<std::uint32_t>(c));
+                call(&stub_new_table);
+                return true;
+            case Op::SetList:
+                as_.mov(rdi, r12);
+                as_.lea(rsi, rbx, slot(a));
+                as_.mov_imm32(rdx, static_cast<std::uint32_t>(b));
+                as_.mov_imm32(rcx, static_cast<std::uint32_t>(c));
+                call(&stub_set_list);
+                return true;
+            case Op::GetTable:
+                as_.lea(rdi, rbx, slot(a));
+                as_.lea(rsi, rbx, slot(b));
+                as_.lea(rdx, rbx, slot(c));
+                checked_call(pc, &stub_get_table);
+                return true;
+            case Op::SetTable:
+                as_.mov(rdi, r12);
+                as_.lea(rsi, rbx, slot(a));
+                as_.lea(rdx, rbx, slot(b));
+                as_.lea(rcx, rbx, slot(c));
+                checked_call(pc, &stub_set_table);
+                return true;
+            case Op::GetField: {
+                FieldCache* site = &caches_[cache++];
+                const Label slow = as_.new_label();
+                const Label done = as_.new_label();
+                if (hash_begin_ >= 0) {
+                    as_.cmp8_imm(rbx, slot(b) + kTag, tag(ValueType::Table));
+                    as_.jcc(Cond::NotEqual, slow);
+                    as_.load64(rax, rbx, slot(b) + kPayload);
+                    cached_entry(site, constant(c), slow);
+                    as_.movups_load(xmm0, rdx, kValueSize);
+                    as_.movups_store(rbx, slot(a), xmm0);
+                    as_.jmp(done);
+                } else {
+                    as_.jmp(slow);
+                }
+                cold_.push_back([=] {
+                    as_.bind(slow);
+                    as_.lea(rdi, rbx, slot(a));
+                    as_.lea(rsi, rbx, slot(b));
+                    as_.mov_imm64(rdx, address(constant(c)));
+                    as_.mov_imm64(rcx, address(site));
+                    checked_call(pc, &stub_get_field);
+                    as_.jmp(done);
+                });
+                as_.bind(done);
+                return true;
+            }
+            case Op::SetField: {
+                FieldCache* site = &caches_[cache++];
+                const Label slow = as_.new_label();
+                const Label done = as_.new_label();
+                if (hash_begin_ >= 0) {
+                    // Storing an object may need the write barrier: stub.
+                    as_.cmp8_imm(rbx, slot(c) + kTag, tag(ValueType::String));
+                    as_.jcc(Cond::AboveEqual, slow);
+                    as_.cmp8_imm(rbx, slot(a) + kTag, tag(ValueType::Table));
+                    as_.jcc(Cond::NotEqual, slow);
+                    as_.load64(rax, rbx, slot(a) + kPayload);
+                    cached_entry(site, constant(b), slow);
+                    as_.movups_load(xmm0, rbx, slot(c));
+                    as_.movups_store(rdx, kValueSize, xmm0);
+                    as_.jmp(done);
+                } else {
+                    as_.jmp(slow);
+                }
+                cold_.push_back([=] {
+                    as_.bind(slow);
+                    as_.mov(rdi, r12);
+                    as_.lea(rsi, rbx, slot(a));
+                    as_.mov_imm64(rdx, address(constant(b)));
+                    as_.lea(rcx, rbx, slot(c));
+                    as_.mov_imm64(r8, address(site));
+                    checked_call(pc, &stub_set_field);
+                    as_.jmp(done);
+                });
+                as_.bind(done);
+                return true;
+            }
+            case Op::Add:
+            case Op::Sub:
+            case Op::Mul:
+            case Op::Div:
+            case Op::Mod: arith(pc, op_of(i), a, b, c, false); return true;
+            case Op::AddK: arith(pc, Op::Add, a, b, c, true); return true;
+            case Op::SubK: arith(pc, Op::Sub, a, b, c, true); return true;
+            case Op::MulK: arith(pc, Op::Mul, a, b, c, true); return true;
+            case Op::DivK: arith(pc, Op::Div, a, b, c, true); return true;
+            case Op::ModK: arith(pc, Op::Mod, a, b, c, true); return true;
+            case Op::Unm:
+                guard_number(b, deopt(pc));
+                as_.load64(rax, rbx, slot(b) + kPayload);
+                as_.btc64(rax, 63);
+                as_.store8_imm(rbx, slot(a) + kTag, tag(ValueType::Number));
+                as_.store64(rbx, slot(a) + kPayload, rax);
+                return true;
+            case Op::Not: {
+                const Label falsy = as_.new_label();
+                const Label done = as_.new_label();
+                jump_if_falsy(b, falsy);
+                store_tagged(a, ValueType::Bool, 0);
+                as_.jmp(done);
+                as_.bind(falsy);
+                store_tagged(a, ValueType::Bool, 1);
+                as_.bind(done);
+                return true;
+            }
+            case Op::Len:
+                as_.lea(rdi, rbx, slot(a));
+                as_.lea(rsi, rbx, slot(b));
+                checked_call(pc, &stub_len);
+                return true;
+            case Op::Eq: {
+                const Label slow = as_.new_label();
+                const Label done = as_.new_label();
+                guard_number(a, slow);
+                guard_number(b, slow);
+                as_.movsd_load(xmm0, rbx, slot(a) + kPayload);
+                as_.ucomisd(xmm0, rbx, slot(b) + kPayload);
+                as_.setcc(Cond::Equal, rax);
+                as_.setcc(Cond::NoParity, rcx);
+                as_.and8(rax, rcx);
+                as_.jmp(done);
+                cold_.push_back([=] {
+                    as_.bind(slow);
+                    as_.lea(rdi, rbx, slot(a));
+                    as_.lea(rsi, rbx, slot(b));
+                    call(&stub_equal);
+                    as_.jmp(done);
+                });
+                as_.bind(done);
+                return cond_jump_al(pc, i);
+            }
+            case Op::EqK: {
+                double k = 0;
+                if (number_constant(b, k)) {
+                    const Label done = as_.new_label();
+                    as_.xor32(rax, rax);  // a non-number never equals a number
+                    as_.cmp8_imm(rbx, slot(a) + kTag, tag(ValueType::Number));
+                    as_.jcc(Cond::NotEqual, done);
+                    as_.movsd_load(xmm0, rbx, slot(a) + kPayload);
+                    load_double(xmm1, k);
+                    as_.ucomisd(xmm0, xmm1);
+                    as_.setcc(Cond::Equal, rax);
+                    as_.setcc(Cond::NoParity, rcx);
+                    as_.and8(rax, rcx);
+                    as_.bind(done);
+                } else {
+                    as_.lea(rdi, rbx, slot(a));
+                    as_.mov_imm64(rsi, address(constant(b)));
+                    call(&stub_equal);
+                }
+                return cond_jump_al(pc, i);
+            }
+            case Op::Lt: less(pc, a, b, false, false, false); return cond_jump_al(pc, i);
+            case Op::Le: less(pc, a, b, false, true, false); return cond_jump_al(pc, i);
+            case Op::LtK: less(pc, a, b, true, false, false); return cond_jump_al(pc, i);
+            case Op::LeK: less(pc, a, b, true, true, false); return cond_jump_al(pc, i);
+            case Op::GtK: less(pc, a, b, true, false, true); return cond_jump_al(pc, i);
+            case Op::GeK: less(pc, a, b, true, true, true); return cond_jump_al(pc, i);
+            case Op::Test: {
+                const Label falsy = as_.new_label();
+                jump_if_falsy(a, falsy);
+                as_.mov_imm32(rax, 1);
+                const Label done = as_.new_label();
+                as_.jmp(done);
+                as_.bind(falsy);
+                as_.xor32(rax, rax);
+                as_.bind(done);
+                return cond_jump_al(pc, i);
+            }
+            case Op::Jmp: {
+                Label target;
+                if (!relative(pc, arg_sj(i), target)) return false;
+                if (arg_sj(i) < 0) safepoint(pc);
+                as_.jmp(target);
+                return true;
+            }
+            case Op::ForPrep: {
+                Label skip;
+                if (!relative(pc, arg_sbx(i), skip)) return false;
+                const Label up = as_.new_label();
+                const Label enter = as_.new_label();
+                for (int r = 0; r < 3; ++r) guard_number(a + r, deopt(pc));
+                as_.movsd_load(xmm0, rbx, slot(a) + kPayload);
+                as_.movsd_load(xmm1, rbx, slot(a + 1) + kPayload);
+                as_.movsd_load(xmm2, rbx, slot(a + 2) + kPayload);
+                as_.xorpd(xmm3, xmm3);
+                as_.ucomisd(xmm2, xmm3);
+                as_.jcc(Cond::Parity, deopt(pc));  // NaN step
+                as_.jcc(Cond::Equal, deopt(pc));   // zero step is an error
+                as_.jcc(Cond::Above, up);
+                as_.ucomisd(xmm0, xmm1);  // counting down: index > limit
+                as_.jcc(Cond::Above, enter);
+                as_.jmp(skip);
+                as_.bind(up);
+                as_.ucomisd(xmm1, xmm0);  // counting up: index < limit
+                as_.jcc(Cond::BelowEqual, skip);
+                as_.bind(enter);
+                as_.movups_load(xmm4, rbx, slot(a));
+                as_.movups_store(rbx, slot(a + 3), xmm4);
+                return true;
+            }
+            case Op::ForLoop: {
+                Label body;
+                if (!relative(pc, arg_sbx(i), body)) return false;
+                const Label up = as_.new_label();
+                const Label next = as_.new_label();
+                const Label done = as_.new_label();
+                safepoint(pc);
+                as_.movsd_load(xmm0, rbx, slot(a) + kPayload);
+                as_.movsd_load(xmm2, rbx, slot(a + 2) + kPayload);
+                as_.addsd(xmm0, xmm2);
+                as_.movsd_load(xmm1, rbx, slot(a + 1) + kPayload);
+                as_.xorpd(xmm3, xmm3);
+                as_.ucomisd(xmm2, xmm3);
+                as_.jcc(Cond::Above, up);
+                as_.ucomisd(xmm0, xmm1);
+                as_.jcc(Cond::BelowEqual, done);
+                as_.jmp(next);
+                as_.bind(up);
+                as_.ucomisd(xmm1, xmm0);
+                as_.jcc(Cond::BelowEqual, done);
+                as_.bind(next);
+                as_.movsd_store(rbx, slot(a) + kPayload, xmm0);
+                as_.movups_load(xmm4, rbx, slot(a));
+                as_.movups_store(rbx, slot(a + 3), xmm4);
+                as_.jmp(body);
+                as_.bind(done);
+                return true;
+            }
+            case Op::TForPrep: {
+                Label target;
+                if (!relative(pc, arg_sbx(i), target)) return false;
+                as_.cmp8_imm(rbx, slot(a) + kTag, tag(ValueType::Table));
+                as_.jcc(Cond::NotEqual, deopt(pc));
+                store_tagged(a + 1, ValueType::Number, 0);  // 0.0
+                as_.jmp(target);
+                return true;
+            }
+            case Op::TForNext: {
+                Label body;
+                if (!relative(pc, arg_sbx(i), body)) return false;
+                safepoint(pc);
+                as_.lea(rdi, rbx, slot(a));
+                call(&stub_tfor_next);
+                as_.test8(rax, rax);
+                as_.jcc(Cond::NotEqual, body);
+                return true;
+            }
+            case Op::Call: {
+                if (pc + 1 >= fn_.code.size()) return false;
+                const Label not_done = as_.new_label();
+                safepoint(pc);  // the interpreter's Call collects first
+                as_.mov(rdi, r12);
+                as_.lea(rsi, rbx, slot(a));
+                as_.mov_imm32(rdx, static_cast<std::uint32_t>(b));
+                as_.mov_imm32(rcx, static_cast<std::uint32_t>(pc + 1));
+                call(&Jit::call);
+                as_.cmp32_imm(rax, 0);
+                as_.jcc(Cond::NotEqual, not_done);
+                cold_.push_back([=] {
+                    as_.bind(not_done);
+                    as_.cmp32_imm(rax, 1);
+                    as_.jcc(Cond::Equal, exit(pc, false));
+                    as_.jmp(exit(pc + 1, false));  // raised; Jit::enter_slow rethrows
+                });
+                return true;
+            }
+            case Op::Trap:  // breakpoints are handled by the interpreter
+            case Op::Return:
+            case Op::Await:
+                // Frames are the interpreter's business.
+                as_.jmp(exit(pc, false));
+                return true;
+            case Op::Count: break;
+        }
+        return false;
+    }
+
+    const Function& fn_;
+    FieldCache* caches_;
+    const void* safepoint_flag_;
+    std::int32_t hash_begin_;
+    std::int32_t hash_end_;
+    Assembler as_;
+    Label epilogue_;
+    std::vector<Label> labels_;
+    std::vector<Label> exits_;  // two per instruction: plain exit, deoptimization
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::function<void()>> cold_;
+};
+
+}  // namespace
+
+JitCode::JitCode(void* memory, std::size_t mapped, std::size_t code_bytes, std::vector<std::uint32_t> offsets,
+                 std::unique_ptr<FieldCache[]> caches)
+    : memory_(memory),
+      mapped_(mapped),
+      code_bytes_(code_bytes),
+      offsets_(std::move(offsets)),
+      caches_(std::move(caches)) {}
+
+JitCode::~JitCode() { munmap(memory_, mapped_); }
+
+Jit::Jit(VM& vm) : vm_(vm) {
+    // Inline caches read the begin and end pointers of Table's hash part,
+    // which every standard library we build with keeps first in a vector.
+    // Confirm that on a real table instead of assuming it; if it does not
+    // hold, field access goes through the stubs only.
+    Table probe;
+    probe.reserve(0, 4);
+    const Table::Entry* words[2];
+    static_assert(sizeof(probe.hash_) >= sizeof words, "unexpected std::vector layout");
+    std::memcpy(words, &probe.hash_, sizeof words);
+    if (words[0] == probe.hash_.data() && words[1] == probe.hash_.data() + probe.hash_.size()) {
+        hash_begin_ = static_cast<std::int32_t>(reinterpret_cast<const char*>(&probe.hash_) -
+                                                reinterpret_cast<const char*>(&probe));
+        hash_end_ = hash_begin_ + static_cast<std::int32_t>(sizeof words[0]);
+    }
+}
+
+std::unique_ptr<JitCode> Jit::compile(const Function& fn) {
+    static_assert(offsetof(Value, type_) == kTag && offsetof(Value, number_) == kPayload &&
+                      sizeof(Value) == kValueSize,
+                  "compiled code assumes this Value layout");
+    static_assert(sizeof(Table::Entry) == 2 * kValueSize && offsetof(Table::Entry, value) == kValueSize,
+                  "inline caches assume this hash entry layout");
+
+    std::size_t sites = 0;
+    for (Instruction i : fn.code) {
+        if (op_of(i) == Op::GetField || op_of(i) == Op::SetField) ++sites;
+    }
+    auto caches = std::make_unique<FieldCache[]>(sites ? sites : 1);
+
+    Emitter emitter(fn, caches.get(), vm_.heap().safepoint_flag(), hash_begin_, hash_end_);
+    if (!emitter.emit()) return nullptr;
+    const std::vector<std::uint8_t>& code = emitter.code();
+
+    // Written while writable, then flipped to executable: never both.
+    const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t mapped = (code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, mapped);
+        return nullptr;
+    }
+    return std::make_unique<JitCode>(memory, mapped, code.size(), std::move(emitter.offsets()), std::move(caches));
+}
+
+const Instruction* Jit::enter_slow(Function& fn, Value* base, const Instruction* pc, Value* globals,
+                                   std::uint8_t* defined) {
+    if (fn.jit_blocked || (fn.jit && fn.jit->stale)) {
+        // Invalidated while an outer activation was still running it.
+        if (fn.jit && fn.jit->active == 0) release(fn);
+        if (fn.jit_blocked || fn.jit) return pc;
+    }
+    if (!fn.jit) {
+        fn.hotness = 0;
+        fn.jit = worth_compiling(fn) ? compile(fn) : nullptr;
+        if (!fn.jit) {
+            fn.jit_blocked = true;
+            return pc;
+        }
+        ++stats_.compiled;
+        stats_.code_bytes += fn.jit->code_bytes();
+    }
+    // Calls made from the compiled code may collect and move `fn`; its code
+    // and bytecode stay where they are.
+    JitCode& code = *fn.jit;
+    const Instruction* const start = fn.code.data();
+    Context context{globals, defined, &vm_, nullptr};
+    ++code.active;
+    const std::uint32_t exit = code.run(base, &context, static_cast<std::size_t>(pc - start));
+    --code.active;
+    ++code.entries;
+    ++stats_.entries;
+    if (context.error) std::rethrow_exception(context.error);
+    if (exit & 1) {
+        ++stats_.deopts;
+        if (++code.deopts > config_.max_deopts && code.deopts * 4 > code.entries) {
+            Function& current = *vm_.frames_.back().fn;
+            current.jit_blocked = true;
+            ++stats_.invalidated;
+            if (code.active == 0) release(current);
+        }
+    }
+    return start + (exit >> 1);
+}
+
+Value Jit::run_callee(std::size_t depth) {
+    VM::Frame& frame = vm_.frames_.back();
+    const Instruction* pc = frame.pc;
+    if (enabled()) pc = enter(*frame.fn, frame.base, pc, vm_.globals_.data(), vm_.defined_.data());
+    if (op_of(*pc) == Op::Return) {
+        // The usual way out of compiled code: return without the interpreter.
+        const Instruction i = *pc;
+        const Value result = arg_b(i) ? frame.base[arg_a(i)] : Value();
+        vm_.frames_.pop_back();
+        return result;
+    }
+    // Errors propagate with the callee frames still pushed, so the
+    // outermost execute() locates them and builds one traceback, as for a
+    // flat call.
+    frame.pc = pc;
+    return vm_.dispatch(depth);
+}
+
+void Jit::invalidate(Function& fn) {
+    if (!fn.jit) return;
+    if (fn.jit->active == 0) {
+        release(fn);
+        ++stats_.invalidated;
+    } else {
+        fn.jit->stale = true;
+    }
+}
+
+void Jit::release(Function& fn) {
+    stats_.code_bytes -= fn.jit->code_bytes();
+    fn.jit.reset();
+}
+
+std::uint32_t Jit::call(Context* context, Value* callee, int argc, std::uint32_t resume) noexcept {
+    VM& vm = *context->vm;
+    Jit& jit = vm.jit_;
+    const bool native = callee->is_native();
+    if (!native && (!callee->is_function() || callee->as_function()->is_async || jit.nesting_ >= kMaxNesting)) {
+        return 1;
+    }
+
+    // As the interpreter's Call: errors are located at this instruction.
+    VM::Frame& frame = vm.frames_.back();
+    frame.pc = frame.fn->code.data() + resume;
+    Value* const top = vm.top_;
+    std::uint32_t status = 0;
+    try {
+        if (native) {
+            NativeFunction* fn = callee->as_native();
+            *callee = vm.call_native(fn, callee + 1, argc);
+        } else {
+            const std::size_t depth = vm.frames_.size();
+            vm.push_frame(callee->as_function(), callee + 1, argc);
+            ++jit.nesting_;
+            try {
+                *callee = jit.run_callee(depth);
+            } catch (...) {
+                --jit.nesting_;
+                throw;
+            }
+            --jit.nesting_;
+        }
+    } catch (...) {
+        context->error = std::current_exception();
+        status = 2;
+    }
+    vm.top_ = top;
+    // The callee may have defined globals and so moved their storage.
+    context->globals = vm.globals_.data();
+    context->defined = vm.defined_.data();
+    return status;
+}
+
+}  // namespace rebel::script
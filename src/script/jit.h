@@ -0,0 +1,156 @@
+#pragma once
+
+// Baseline JIT tier. Only built when the REBEL_SCRIPT_JIT option is on
+// and the target is x86-64 (System V calling convention).
+
+#include "script/object.h"
+#include "script/opcode.h"
+#include "script/value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace rebel::script {
+
+class VM;
+
+/// Per-site inline cache for GetField/SetField: the hash slot where the
+/// key was last found. Checked against the key before use, so a stale
+/// slot only costs a normal lookup.
+struct FieldCache {
+    std::uint32_t slot = 0;
+};
+
+/// Native code for one Function, owned by it.
+class JitCode {
+public:
+    /// Runs from the instruction at `entry` until the code exits; returns
+    /// (pc index << 1) | deoptimized.
+    using Entry = std::uint32_t (*)(Value* base, void* context, const void* entry);
+
+    JitCode(void* memory, std::size_t mapped, std::size_t code_bytes, std::vector<std::uint32_t> offsets,
+            std::unique_ptr<FieldCache[]> caches);
+    ~JitCode();
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+
+    std::uint32_t run(Value* base, void* context, std::size_t pc) const {
+        return reinterpret_cast<Entry>(memory_)(base, context, static_cast<const std::uint8_t*>(memory_) + offsets_[pc]);
+    }
+    std::size_t code_bytes() const noexcept { return code_bytes_; }
+
+    std::uint64_t entries = 0;
+    std::uint64_t deopts = 0;
+    /// Activations on the C++ stack; the code is not freed while nonzero.
+    std::uint32_t active = 0;
+    /// The bytecode changed since compilation; recompile once inactive.
+    bool stale = false;
+
+private:
+    void* memory_;
+    std::size_t mapped_;
+    std::size_t code_bytes_;
+    std::vector<std::uint32_t> offsets_;  // native offset of each instruction
+    std::unique_ptr<FieldCache[]> caches_;
+};
+
+/// Tiers hot functions up from the interpreter to native code.
+///
+/// The compiled code keeps every register in the VM stack exactly as the
+/// interpreter does, one bytecode instruction at a time, so control can pass
+/// between the tiers at any instruction. Numeric arithmetic, comparisons,
+/// loops and cached field access run inline; other table access goes
+/// through stubs. Calls are made from compiled code by re-entering the
+/// interpreter for the callee, up to kMaxNesting deep; beyond that, and for
+/// returns and pending collections, the code exits to the interpreter,
+/// which re-enters compiled code at the next call, return or back-edge.
+///
+/// Functions without loops, or whose loops mostly set up calls, stay
+/// interpreted once hot: entering compiled code and calling out of it cost
+/// more than the interpreter's flat calls, which only a loop doing work of
+/// its own makes up for.
+///
+/// Fast paths are guarded by type checks. A failing guard deoptimizes: the
+/// code exits before the instruction and the interpreter executes it,
+/// raising any error with the usual location. A function that deoptimizes
+/// on most entries loses its code and stays interpreted.
+class Jit {
+public:
+    struct Config {
+        bool enabled = true;
+        /// Calls plus loop back-edges before a function is compiled.
+        std::uint32_t hot_threshold = 1000;
+        /// Deoptimizations tolerated before a function that deoptimizes on
+        /// more than a quarter of its entries is sent back to the
+        /// interpreter for good.
+        std::uint32_t max_deopts = 1000;
+    };
+
+    struct Stats {
+        std::uint64_t compiled = 0;
+        std::uint64_t invalidated = 0;
+        std::uint64_t entries = 0;
+        std::uint64_t deopts = 0;
+        std::size_t code_bytes = 0;
+    };
+
+    /// Shared with the compiled code; refreshed on every entry and after
+    /// every call out of it. The compiled code reloads `globals` and
+    /// `defined` from here at each access.
+    struct Context {
+        Value* globals;
+        std::uint8_t* defined;
+        VM* vm;
+        /// Raised by a callee; rethrown once the compiled code has exited.
+        std::exception_ptr error;
+    };
+
+    /// Compiled calls nest on the C++ stack; deeper calls exit instead.
+    static constexpr std::uint32_t kMaxNesting = 128;
+
+    explicit Jit(VM& vm);
+
+    void configure(const Config& config) { config_ = config; }
+    const Config& config() const noexcept { return config_; }
+    bool enabled() const noexcept { return config_.enabled; }
+    const Stats& stats() const noexcept { return stats_; }
+
+    /// Called by the interpreter at the start of a frame, after calls
+    /// return and at loop back-edges. Counts toward tier-up, runs compiled
+    /// code if `fn` has any, and returns where to resume interpreting.
+    const Instruction* enter(Function& fn, Value* base, const Instruction* pc, Value* globals, std::uint8_t* defined) {
+        if (!fn.jit && (fn.jit_blocked || ++fn.hotness < config_.hot_threshold)) return pc;
+        return enter_slow(fn, base, pc, globals, defined);
+    }
+
+    /// Call instruction from compiled code. Returns 0 once the callee's
+    /// result is in `callee`, 1 to leave the call to the interpreter and 2
+    /// if the callee raised (the error is in `context`).
+    static std::uint32_t call(Context* context, Value* callee, int argc, std::uint32_t resume) noexcept;
+
+    /// Drops the code for `fn` after its bytecode was patched. Activations
+    /// still running keep the old code until they leave it.
+    void invalidate(Function& fn);
+
+private:
+    const Instruction* enter_slow(Function& fn, Value* base, const Instruction* pc, Value* globals,
+                                  std::uint8_t* defined);
+    std::unique_ptr<JitCode> compile(const Function& fn);
+    void release(Function& fn);
+    /// Runs the frame just pushed above `depth` to completion.
+    Value run_callee(std::size_t depth);
+
+    VM& vm_;
+    Config config_;
+    Stats stats_;
+    std::uint32_t nesting_ = 0;
+    // Offsets of the hash part's begin and end pointers inside Table, for
+    // inline field caches; negative if the layout could not be confirmed.
+    std::int32_t hash_begin_ = -1;
+    std::int32_t hash_end_ = -1;
+};
+
+}  // namespace rebel::script
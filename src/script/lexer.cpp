@@ -0,0 +1,257 @@
+#include "script/lexer.h"
+
+#include "script/error.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace rebel::script {
+namespace {
+
+struct Keyword {
+    const char* text;
+    Tok tok;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"and", Tok::And},     {"async", Tok::Async}, {"await", Tok::Await},       {"break", Tok::Break},
+    {"continue", Tok::Continue}, {"else", Tok::Else}, {"false", Tok::False},   {"fn", Tok::Fn},
+    {"for", Tok::For},     {"if", Tok::If},       {"in", Tok::In},             {"let", Tok::Let},
+    {"nil", Tok::Nil},     {"not", Tok::Not},     {"or", Tok::Or},             {"return", Tok::Return},
+    {"true", Tok::True},   {"while", Tok::While},
+};
+
+bool is_name_start(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_hex(char c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+}  // namespace
+
+const char* tok_name(Tok tok) {
+    switch (tok) {
+        case Tok::End: return "end of input";
+        case Tok::Name: return "name";
+        case Tok::Number: return "number";
+        case Tok::String: return "string";
+        case Tok::LParen: return "'('";
+        case Tok::RParen: return "')'";
+        case Tok::LBrace: return "'{'";
+        case Tok::RBrace: return "'}'";
+        case Tok::LBracket: return "'['";
+        case Tok::RBracket: return "']'";
+        case Tok::Comma: return "','";
+        case Tok::Colon: return "':'";
+        case Tok::Semicolon: return "';'";
+        case Tok::Dot: return "'.'";
+        case Tok::DotDot: return "'..'";
+        case Tok::Plus: return "'+'";
+        case Tok::Minus: return "'-'";
+        case Tok::Star: return "'*'";
+        case Tok::Slash: return "'/'";
+        case Tok::Percent: return "'%'";
+        case Tok::Hash: return "'#'";
+        case Tok::Assign: return "'='";
+        case Tok::PlusAssign: return "'+='";
+        case Tok::MinusAssign: return "'-='";
+        case Tok::StarAssign: return "'*='";
+        case Tok::SlashAssign: return "'/='";
+        case Tok::Eq: return "'=='";
+        case Tok::Ne: return "'!='";
+        case Tok::Lt: return "'<'";
+        case Tok::Le: return "'<='";
+        case Tok::Gt: return "'>'";
+        case Tok::Ge: return "'>='";
+        default: break;
+    }
+    for (const Keyword& k : kKeywords) {
+        if (k.tok == tok) return k.text;
+    }
+    return "?";
+}
+
+Lexer::Lexer(std::string_view source, std::string chunk) : source_(source), chunk_(std::move(chunk)) {}
+
+void Lexer::fail(const std::string& message) const { throw CompileError(message, chunk_, line_); }
+
+void Lexer::skip_space(bool& newline) {
+    while (pos_ < source_.size()) {
+        const char c = source_[pos_];
+        if (c == '\n') {
+            newline = true;
+            ++line_;
+            ++pos_;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            ++pos_;
+        } else if (c == '/' && pos_ + 1 < source_.size() && source_[pos_ + 1] == '/') {
+            while (pos_ < source_.size() && source_[pos_] != '\n') ++pos_;
+        } else if (c == '/' && pos_ + 1 < source_.size() && source_[pos_ + 1] == '*') {
+            const std::uint32_t start = line_;
+            pos_ += 2;
+            for (;;) {
+                if (pos_ + 1 >= source_.size()) {
+                    line_ = start;
+                    fail("unterminated block comment");
+                }
+                if (source_[pos_] == '*' && source_[pos_ + 1] == '/') break;
+                if (source_[pos_] == '\n') {
+                    newline = true;
+                    ++line_;
+                }
+                ++pos_;
+            }
+            pos_ += 2;
+        } else {
+            return;
+        }
+    }
+}
+
+Token Lexer::next() {
+    Token tok;
+    skip_space(tok.newline_before);
+    tok.line = line_;
+    if (pos_ >= source_.size()) return tok;
+
+    const char c = source_[pos_];
+    if (is_digit(c) || (c == '.' && pos_ + 1 < source_.size() && is_digit(source_[pos_ + 1]))) {
+        Token t = lex_number();
+        t.newline_before = tok.newline_before;
+        return t;
+    }
+    if (is_name_start(c)) {
+        Token t = lex_name();
+        t.newline_before = tok.newline_before;
+        return t;
+    }
+    if (c == '"' || c == '\'') {
+        Token t = lex_string(c);
+        t.newline_before = tok.newline_before;
+        return t;
+    }
+
+    const char n = pos_ + 1 < source_.size() ? source_[pos_ + 1] : '\0';
+    auto one = [&](Tok kind) {
+        ++pos_;
+        tok.kind = kind;
+        return tok;
+    };
+    auto two = [&](Tok kind) {
+        pos_ += 2;
+        tok.kind = kind;
+        return tok;
+    };
+    switch (c) {
+        case '(': return one(Tok::LParen);
+        case ')': return one(Tok::RParen);
+        case '{': return one(Tok::LBrace);
+        case '}': return one(Tok::RBrace);
+        case '[': return one(Tok::LBracket);
+        case ']': return one(Tok::RBracket);
+        case ',': return one(Tok::Comma);
+        case ':': return one(Tok::Colon);
+        case ';': return one(Tok::Semicolon);
+        case '%': return one(Tok::Percent);
+        case '#': return one(Tok::Hash);
+        case '.': return n == '.' ? two(Tok::DotDot) : one(Tok::Dot);
+        case '+': return n == '=' ? two(Tok::PlusAssign) : one(Tok::Plus);
+        case '-': return n == '=' ? two(Tok::MinusAssign) : one(Tok::Minus);
+        case '*': return n == '=' ? two(Tok::StarAssign) : one(Tok::Star);
+        case '/': return n == '=' ? two(Tok::SlashAssign) : one(Tok::Slash);
+        case '=': return n == '=' ? two(Tok::Eq) : one(Tok::Assign);
+        case '<': return n == '=' ? two(Tok::Le) : one(Tok::Lt);
+        case '>': return n == '=' ? two(Tok::Ge) : one(Tok::Gt);
+        case '!':
+            if (n == '=') return two(Tok::Ne);
+            break;
+        default: break;
+    }
+    fail(std::string("unexpected character '") + c + "'");
+}
+
+Token Lexer::lex_number() {
+    Token tok;
+    tok.kind = Tok::Number;
+    tok.line = line_;
+    const std::size_t start = pos_;
+    if (source_[pos_] == '0' && pos_ + 1 < source_.size() && (source_[pos_ + 1] == 'x' || source_[pos_ + 1] == 'X')) {
+        pos_ += 2;
+        std::uint64_t value = 0;
+        if (pos_ >= source_.size() || !is_hex(source_[pos_])) fail("malformed hex number");
+        while (pos_ < source_.size() && is_hex(source_[pos_])) {
+            const char h = source_[pos_++];
+            value = value * 16 + static_cast<std::uint64_t>(is_digit(h) ? h - '0' : (h | 0x20) - 'a' + 10);
+        }
+        tok.number = static_cast<double>(value);
+    } else {
+        while (pos_ < source_.size() && is_digit(source_[pos_])) ++pos_;
+        // A '.' followed by another '.' is a range, not a fraction.
+        if (pos_ + 1 < source_.size() && source_[pos_] == '.' && source_[pos_ + 1] != '.') {
+            ++pos_;
+            while (pos_ < source_.size() && is_digit(source_[pos_])) ++pos_;
+        }
+        if (pos_ < source_.size() && (source_[pos_] == 'e' || source_[pos_] == 'E')) {
+            ++pos_;
+            if (pos_ < source_.size() && (source_[pos_] == '+' || source_[pos_] == '-')) ++pos_;
+            if (pos_ >= source_.size() || !is_digit(source_[pos_])) fail("malformed number exponent");
+            while (pos_ < source_.size() && is_digit(source_[pos_])) ++pos_;
+        }
+        const std::string text(source_.substr(start, pos_ - start));
+        tok.number = std::strtod(text.c_str(), nullptr);
+    }
+    if (pos_ < source_.size() && is_name_start(source_[pos_])) fail("malformed number");
+    tok.text.assign(source_.substr(start, pos_ - start));
+    return tok;
+}
+
+Token Lexer::lex_string(char quote) {
+    Token tok;
+    tok.kind = Tok::String;
+    tok.line = line_;
+    ++pos_;
+    for (;;) {
+        if (pos_ >= source_.size() || source_[pos_] == '\n') fail("unterminated string");
+        char c = source_[pos_++];
+        if (c == quote) break;
+        if (c == '\\') {
+            if (pos_ >= source_.size()) fail("unterminated string");
+            const char e = source_[pos_++];
+            switch (e) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                case '\\': case '"': case '\'': c = e; break;
+                case 'x': {
+                    if (pos_ + 1 >= source_.size() || !is_hex(source_[pos_]) || !is_hex(source_[pos_ + 1])) {
+                        fail("malformed \\x escape");
+                    }
+                    c = static_cast<char>(std::strtol(std::string(source_.substr(pos_, 2)).c_str(), nullptr, 16));
+                    pos_ += 2;
+                    break;
+                }
+                default: fail(std::string("unknown escape '\\") + e + "'");
+            }
+        }
+        tok.text.push_back(c);
+    }
+    return tok;
+}
+
+Token Lexer::lex_name() {
+    Token tok;
+    tok.line = line_;
+    const std::size_t start = pos_;
+    while (pos_ < source_.size() && (is_name_start(source_[pos_]) || is_digit(source_[pos_]))) ++pos_;
+    tok.text.assign(source_.substr(start, pos_ - start));
+    tok.kind = Tok::Name;
+    for (const Keyword& k : kKeywords) {
+        if (tok.text == k.text) {
+            tok.kind = k.tok;
+            break;
+        }
+    }
+    return tok;
+}
+
+}  // namespace rebel::script
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace rebel::script {
+
+enum class Tok : std::uint8_t {
+    End,
+    Name,
+    Number,
+    String,
+    // keywords
+    And, Async, Await, Break, Continue, Else, False, Fn, For, If, In, Let, Nil, Not, Or, Return, True, While,
+    // punctuation
+    LParen, RParen, LBrace, RBrace, LBracket, RBracket,
+    Comma, Colon, Semicolon, Dot, DotDot,
+    Plus, Minus, Star, Slash, Percent, Hash,
+    Assign, PlusAssign, MinusAssign, StarAssign, SlashAssign,
+    Eq, Ne, Lt, Le, Gt, Ge,
+};
+
+const char* tok_name(Tok tok);
+
+struct Token {
+    Tok kind = Tok::End;
+    std::uint32_t line = 1;
+    /// The token's source text; for strings, the decoded contents.
+    std::string text;
+    double number = 0;
+    /// A newline separates this token from the previous one.
+    bool newline_before = false;
+};
+
+/// Splits source into tokens on demand. Throws CompileError on malformed
+/// input.
+class Lexer {
+public:
+    Lexer(std::string_view source, std::string chunk);
+
+    Token next();
+    const std::string& chunk() const noexcept { return chunk_; }
+
+private:
+    [[noreturn]] void fail(const std::string& message) const;
+    void skip_space(bool& newline);
+    Token lex_number();
+    Token lex_string(char quote);
+    Token lex_name();
+
+    std::string_view source_;
+    std::string chunk_;
+    std::size_t pos_ = 0;
+    std::uint32_t line_ = 1;
+};
+
+}  // namespace rebel::script
@@ -0,0 +1,246 @@
+#include "script/object.h"
+
+#include "script/error.h"
+#ifdef REBEL_SCRIPT_JIT
+#include "script/jit.h"
+#endif
+
+#include <cmath>
+#include <cstring>
+
+namespace rebel::script {
+namespace {
+
+constexpr double kMaxArrayIndex = 9007199254740992.0;  // 2^53
+
+// Array index for `key` when it is a non-negative integral number.
+bool array_index(const Value& key, std::size_t& index) {
+    if (!key.is_number()) return false;
+    const double d = key.as_number();
+    if (!(d >= 0 && d < kMaxArrayIndex) || d != std::floor(d)) return false;
+    index = static_cast<std::size_t>(d);
+    return true;
+}
+
+std::uint32_t mix(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return static_cast<std::uint32_t>(x);
+}
+
+std::size_t next_power_of_two(std::size_t n) {
+    std::size_t p = 8;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+}  // namespace
+
+const char* type_name(ValueType type) {
+    switch (type) {
+        case ValueType::Nil: return "nil";
+        case ValueType::Bool: return "bool";
+        case ValueType::Number: return "number";
+        case ValueType::String: return "string";
+        case ValueType::Table: return "table";
+        case ValueType::Function: return "function";
+        case ValueType::Native: return "native function";
+        case ValueType::Task: return "task";
+    }
+    return "?";
+}
+
+std::uint32_t String::hash_bytes(std::string_view bytes) noexcept {
+    std::uint32_t h = 2166136261u;
+    for (unsigned char c : bytes) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool values_equal(const Value& a, const Value& b) noexcept {
+    if (a.type() != b.type()) return false;
+    if (!a.is_string()) return a == b;
+    const String* x = a.as_string();
+    const String* y = b.as_string();
+    return x == y || (x->hash == y->hash && x->length == y->length && std::memcmp(x->chars(), y->chars(), x->length) == 0);
+}
+
+std::uint32_t hash_value(const Value& value) noexcept {
+    switch (value.type()) {
+        case ValueType::Nil: return 0;
+        case ValueType::Bool: return value.as_bool() ? 1 : 2;
+        case ValueType::Number: {
+            const double d = value.as_number() == 0 ? 0.0 : value.as_number();  // fold -0.0 into 0.0
+            std::uint64_t bits;
+            std::memcpy(&bits, &d, sizeof bits);
+            return mix(bits);
+        }
+        default: return value.as_object()->hash;
+    }
+}
+
+void Table::reserve(std::size_t array_hint, std::size_t hash_hint) {
+    array_.reserve(array_hint);
+    if (hash_hint > 0 && hash_.empty()) hash_.resize(next_power_of_two(hash_hint * 4 / 3 + 1));
+}
+
+void Table::assign(const Table& other) {
+    array_ = other.array_;
+    hash_ = other.hash_;
+    hash_used_ = other.hash_used_;
+}
+
+const Table::Entry* Table::find(const Value& key, std::uint32_t hash) const {
+    if (hash_.empty()) return nullptr;
+    const std::size_t mask = hash_.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Entry& e = hash_[i];
+        if (e.key.is_nil()) return nullptr;
+        if (values_equal(e.key, key)) return &e;
+    }
+}
+
+Value Table::get(const Value& key) const {
+    std::size_t index;
+    if (array_index(key, index)) {
+        if (index < array_.size()) return array_[index];
+    }
+    const Entry* e = find(key, hash_value(key));
+    return e ? e->value : Value();
+}
+
+Value Table::get_field(const String* key) const {
+    const Entry* e = find(Value::object(const_cast<String*>(key)), key->hash);
+    return e ? e->value : Value();
+}
+
+void Table::set(const Value& key, const Value& value) {
+    std::size_t index;
+    if (array_index(key, index)) {
+        if (index < array_.size()) {
+            array_[index] = value;
+            // Keep the array part free of trailing holes.
+            while (!array_.empty() && array_.back().is_nil()) array_.pop_back();
+            return;
+        }
+        if (index == array_.size() && !value.is_nil()) {
+            array_.push_back(value);
+            if (!hash_.empty()) migrate_from_hash();
+            return;
+        }
+    } else if (key.is_nil()) {
+        throw RuntimeError("table key is nil");
+    } else if (key.is_number() && std::isnan(key.as_number())) {
+        throw RuntimeError("table key is NaN");
+    }
+    const Value normalized = key.is_number() && key.as_number() == 0 ? Value::number(0.0) : key;
+    hash_set(normalized, hash_value(normalized), value);
+}
+
+Table::Entry* Table::hash_set(const Value& key, std::uint32_t hash, const Value& value) {
+    if (Entry* e = const_cast<Entry*>(find(key, hash))) {
+        e->value = value;
+        return e;
+    }
+    if (value.is_nil()) return nullptr;
+    if ((hash_used_ + 1) * 4 > hash_.size() * 3) rehash(1);
+
+    const std::size_t mask = hash_.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        Entry& e = hash_[i];
+        const bool empty = e.key.is_nil();
+        // A removed entry's slot can be reused: `key` is not further along
+        // this probe chain, or find() would have returned it.
+        if (empty || e.value.is_nil()) {
+            if (empty) ++hash_used_;
+            e.key = key;
+            e.value = value;
+            return &e;
+        }
+    }
+}
+
+void Table::rehash(std::size_t extra) {
+    std::vector<Entry> old = std::move(hash_);
+    std::size_t live = extra;
+    for (const Entry& e : old) live += !e.key.is_nil() && !e.value.is_nil();
+    hash_.assign(next_power_of_two(live * 2), Entry{});
+    hash_used_ = 0;
+    const std::size_t mask = hash_.size() - 1;
+    for (const Entry& e : old) {
+        if (e.key.is_nil() || e.value.is_nil()) continue;
+        std::size_t i = hash_value(e.key) & mask;
+        while (!hash_[i].key.is_nil()) i = (i + 1) & mask;
+        hash_[i] = e;
+        ++hash_used_;
+    }
+}
+
+void Table::migrate_from_hash() {
+    for (;;) {
+        const Value key = Value::number(static_cast<double>(array_.size()));
+        Entry* e = const_cast<Entry*>(find(key, hash_value(key)));
+        if (!e || e->value.is_nil()) return;
+        array_.push_back(e->value);
+        e->value = Value();
+    }
+}
+
+bool Table::next(std::size_t& cursor, Value& key, Value& value) const {
+    while (cursor < array_.size()) {
+        const std::size_t i = cursor++;
+        if (!array_[i].is_nil()) {
+            key = Value::number(static_cast<double>(i));
+            value = array_[i];
+            return true;
+        }
+    }
+    while (cursor - array_.size() < hash_.size()) {
+        const Entry& e = hash_[cursor++ - array_.size()];
+        if (!e.key.is_nil() && !e.value.is_nil()) {
+            key = e.key;
+            value = e.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+Value* Table::find_field(const String* key, std::uint32_t& slot) {
+    const Value k = Value::object(const_cast<String*>(key));
+    if (slot < hash_.size()) {
+        Entry& e = hash_[slot];
+        // Literal names are interned; keys built at run time may be distinct
+        // objects with the same text.
+        if (e.key.is_string() && (e.key.as_object() == key || values_equal(e.key, k))) return &e.value;
+    }
+    const Entry* e = find(k, key->hash);
+    if (!e) return nullptr;
+    slot = static_cast<std::uint32_t>(e - hash_.data());
+    return const_cast<Value*>(&e->value);
+}
+
+void Table::set_field(const String* key, const Value& value, std::uint32_t& slot) {
+    const Value k = Value::object(const_cast<String*>(key));
+    if (slot < hash_.size()) {
+        Entry& e = hash_[slot];
+        if (e.key.is_string() && (e.key.as_object() == key || values_equal(e.key, k))) {
+            e.value = value;
+            return;
+        }
+    }
+    if (Entry* e = hash_set(k, key->hash, value)) slot = static_cast<std::uint32_t>(e - hash_.data());
+}
+
+std::size_t Table::memory_bytes() const noexcept {
+    return sizeof(Table) + array_.capacity() * sizeof(Value) + hash_.capacity() * sizeof(Entry);
+}
+
+Function::Function() : Object(ObjectType::Function) {}
+Function::Function(Function&& other) noexcept = default;
+Function::~Function() = default;
+
+}  // namespace rebel::script
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "script/error.h"
+#include "script/opcode.h"
+#include "script/value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rebel::script {
+
+class VM;
+
+enum class ObjectType : std::uint8_t {
+    String = static_cast<std::uint8_t>(ValueType::String),
+    Table = static_cast<std::uint8_t>(ValueType::Table),
+    Function = static_cast<std::uint8_t>(ValueType::Function),
+    Native = static_cast<std::uint8_t>(ValueType::Native),
+    Task = static_cast<std::uint8_t>(ValueType::Task),
+};
+
+/// Header shared by every heap object. Objects move when the collector
+/// promotes or compacts them; see script/heap.h.
+struct Object {
+    explicit Object(ObjectType t) : type(t) {}
+
+    ObjectType type;
+    std::uint8_t flags = 0;     // Heap::k* bits
+    std::uint32_t size = 0;     // bytes of the allocation, set by the Heap
+    std::uint32_t hash = 0;     // content hash for strings, identity hash otherwise
+    std::uint32_t epoch = 0;    // Heap::epoch() at creation or last copy-on-write
+    Object* forward = nullptr;  // new address while a collection moves objects
+};
+
+/// Immutable byte string; the characters follow the header in one allocation.
+struct String final : Object {
+    explicit String(std::uint32_t len) : Object(ObjectType::String), length(len) {}
+
+    std::uint32_t length;
+
+    const char* chars() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+    char* chars() noexcept { return reinterpret_cast<char*>(this + 1); }
+    std::string_view view() const noexcept { return {chars(), length}; }
+
+    static std::uint32_t hash_bytes(std::string_view bytes) noexcept;
+};
+
+/// Array part for keys 0..n-1 plus an open-addressed hash part for
+/// everything else. Assigning nil removes a key.
+class Table final : public Object {
+public:
+    Table() : Object(ObjectType::Table) {}
+
+    /// nil for missing keys.
+    Value get(const Value& key) const;
+    Value get_field(const String* key) const;
+    /// Throws RuntimeError for nil or NaN keys.
+    void set(const Value& key, const Value& value);
+
+    /// Length of the array part.
+    std::size_t length() const noexcept { return array_.size(); }
+    std::vector<Value>& array() noexcept { return array_; }
+    const std::vector<Value>& array() const noexcept { return array_; }
+    void reserve(std::size_t array_hint, std::size_t hash_hint);
+    /// Replaces the contents with a copy of `other`'s; for checkpoints.
+    void assign(const Table& other);
+
+    /// Iteration: array part first, then the hash part in slot order.
+    /// `cursor` starts at 0; returns false when exhausted. Inserting keys
+    /// while iterating may skip or repeat entries.
+    bool next(std::size_t& cursor, Value& key, Value& value) const;
+
+    std::size_t memory_bytes() const noexcept;
+
+    /// Field lookup for inline caches: tries hash slot `slot` first and
+    /// stores where the key was found. Returns the value slot, or null if
+    /// the key is absent (then use get()/set()).
+    Value* find_field(const String* key, std::uint32_t& slot);
+    /// set() for a string key that, like find_field(), tries hash slot
+    /// `slot` first and stores where the key ended up.
+    void set_field(const String* key, const Value& value, std::uint32_t& slot);
+
+    /// Visits every key and value slot, for the collector to update.
+    /// Object keys hash by their header hash, so moving them needs no rehash.
+    template <typename F>
+    void for_each_ref(F&& visit) {
+        for (Value& v : array_) visit(v);
+        for (Entry& e : hash_) {
+            if (!e.key.is_nil()) {
+                visit(e.key);
+                visit(e.value);
+            }
+        }
+    }
+
+private:
+#ifdef REBEL_SCRIPT_JIT
+    friend class Jit;  // inline field caches read the hash part directly
+#endif
+
+    struct Entry {
+        Value key;
+        Value value;
+    };
+
+    const Entry* find(const Value& key, std::uint32_t hash) const;
+    /// The entry now holding `key`, or null if `value` is nil.
+    Entry* hash_set(const Value& key, std::uint32_t hash, const Value& value);
+    void rehash(std::size_t extra);
+    void migrate_from_hash();
+
+    std::vector<Value> array_;
+    std::vector<Entry> hash_;  // power-of-two capacity; nil key marks an empty slot
+    std::size_t hash_used_ = 0;  // slots with a key, including removed (nil-valued) ones
+};
+
+#ifdef REBEL_SCRIPT_JIT
+class JitCode;
+#endif
+
+/// Compiled script function. Functions never capture locals, so a
+/// prototype is directly callable and needs no closure object.
+struct Function final : Object {
+    Function();
+    Function(Function&& other) noexcept;
+    ~Function();
+
+    std::string name;
+    std::shared_ptr<const std::string> chunk;  // source name for messages
+    std::uint32_t line_defined = 0;
+    std::uint8_t params = 0;
+    std::uint8_t registers = 0;  // frame size
+    bool is_async = false;       // calls return a Task, see VM::run_tasks()
+
+    std::vector<Instruction> code;
+    std::vector<std::uint32_t> lines;  // source line of each instruction
+    std::vector<Value> constants;
+
+    /// A local variable in register `reg` for pcs [start, end); for debuggers.
+    struct LocalVar {
+        std::string name;
+        std::uint8_t reg;
+        std::uint32_t start;
+        std::uint32_t end;
+    };
+    std::vector<LocalVar> locals;  // in declaration order, inner scopes after outer
+
+#ifdef REBEL_SCRIPT_JIT
+    // Tier-up state, see script/jit.h.
+    std::uint32_t hotness = 0;
+    bool jit_blocked = false;
+    std::unique_ptr<JitCode> jit;
+#endif
+
+    std::uint32_t line_at(std::size_t pc) const noexcept { return pc < lines.size() ? lines[pc] : line_defined; }
+};
+
+/// Arguments of a native call. Reading past `count` yields nil.
+struct NativeArgs {
+    const Value* values = nullptr;
+    int count = 0;
+    void* userdata = nullptr;
+    const std::string* name = nullptr;  // the native's name, for messages
+
+    Value operator[](int i) const noexcept { return i < count ? values[i] : Value(); }
+};
+
+using NativeFn = Value (*)(VM& vm, NativeArgs args);
+
+struct NativeFunction final : Object {
+    NativeFunction(std::string n, NativeFn f, void* data)
+        : Object(ObjectType::Native), name(std::move(n)), fn(f), userdata(data) {}
+
+    std::string name;
+    NativeFn fn;
+    void* userdata;
+    bool recorded = false;  // result depends on more than the arguments; see script/recorder.h
+};
+
+/// An operation that finishes later: a call of an async function (a
+/// coroutine), one the host completes (VM::new_task()), or one that waits
+/// for several others (VM::all()). See VM::run_tasks().
+struct Task final : Object {
+    enum class Kind : std::uint8_t { Coroutine, Host, All };
+    enum class State : std::uint8_t { Pending, Done, Failed };
+
+    explicit Task(Kind k) : Object(ObjectType::Task), kind(k) {}
+
+    /// A task to tell when this one settles; `index` is its slot in an All.
+    struct Waiter {
+        Value task;
+        std::uint32_t index;
+    };
+
+    Kind kind;
+    State state = State::Pending;
+    bool observed = false;  // its outcome reached an await, an All or the host
+    std::uint32_t remaining = 0;  // All: tasks still pending
+    std::uint32_t pc = 0;         // Coroutine: where it carries on
+    Function* fn = nullptr;       // Coroutine
+    /// Coroutine: the frame's registers while it waits; empty while it runs.
+    std::vector<Value> registers;
+    /// Done: the result. A pending All collects the results here, a table.
+    Value result;
+    std::unique_ptr<RuntimeError> error;  // Failed
+    std::vector<Waiter> waiters;
+
+    /// Visits every value slot, for the collector to update; `fn` is
+    /// visited separately.
+    template <typename F>
+    void for_each_ref(F&& visit) {
+        for (Value& v : registers) visit(v);
+        visit(result);
+        for (Waiter& w : waiters) visit(w.task);
+    }
+};
+
+/// Script-level equality: strings compare by content, other objects by identity.
+bool values_equal(const Value& a, const Value& b) noexcept;
+std::uint32_t hash_value(const Value& value) noexcept;
+
+inline Value Value::object(Object* object) noexcept {
+    Value v;
+    v.type_ = static_cast<ValueType>(object->type);
+    v.object_ = object;
+    return v;
+}
+inline String* Value::as_string() const noexcept { return static_cast<String*>(object_); }
+inline Table* Value::as_table() const noexcept { return static_cast<Table*>(object_); }
+inline Function* Value::as_function() const noexcept { return static_cast<Function*>(object_); }
+inline NativeFunction* Value::as_native() const noexcept { return static_cast<NativeFunction*>(object_); }
+inline Task* Value::as_task() const noexcept { return static_cast<Task*>(object_); }
+
+}  // namespace rebel::script
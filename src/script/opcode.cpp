@@ -0,0 +1,30 @@
+#include "script/opcode.h"
+
+namespace rebel::script {
+namespace {
+
+constexpr const char* kNames[] = {
+#define REBEL_OP_NAME(name, format) #name,
+    REBEL_OPCODES(REBEL_OP_NAME)
+#undef REBEL_OP_NAME
+};
+
+constexpr OpFormat kFormats[] = {
+#define REBEL_OP_FORMAT(name, format) OpFormat::format,
+    REBEL_OPCODES(REBEL_OP_FORMAT)
+#undef REBEL_OP_FORMAT
+};
+
+}  // namespace
+
+const char* op_name(Op op) {
+    const auto i = static_cast<std::size_t>(op);
+    return i < static_cast<std::size_t>(Op::Count) ? kNames[i] : "?";
+}
+
+OpFormat op_format(Op op) {
+    const auto i = static_cast<std::size_t>(op);
+    return i < static_cast<std::size_t>(Op::Count) ? kFormats[i] : OpFormat::ABC;
+}
+
+}  // namespace rebel::script
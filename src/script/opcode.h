@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rebel::script {
+
+/// Instructions are 32 bits wide, opcode in the low byte:
+///
+///   ABC   [ op:8 | A:8 | B:8 | C:8 ]
+///   ABx   [ op:8 | A:8 | Bx:16 ]       AsBx stores Bx - kBiasBx
+///   sJ    [ op:8 | sJ:24 ]             stored as sJ + kBiasJ
+///
+/// R[x] is register x of the current frame, K[x] constant x of the current
+/// function and G[x] global slot x of the VM. Comparisons and Test are
+/// always followed by a Jmp, which is taken when the outcome equals C.
+/// The compiler never emits Trap; see script/debugger.h.
+#define REBEL_OPCODES(X)                                                                 \
+    X(Move, ABC)      /* R[A] = R[B]                                              */     \
+    X(LoadK, ABx)     /* R[A] = K[Bx]                                             */     \
+    X(LoadI, AsBx)    /* R[A] = sBx                                               */     \
+    X(LoadNil, ABC)   /* R[A] = nil                                               */     \
+    X(LoadTrue, ABC)  /* R[A] = true                                              */     \
+    X(LoadFalse, ABC) /* R[A] = false                                             */     \
+    X(GetGlobal, ABx) /* R[A] = G[Bx]                                             */     \
+    X(SetGlobal, ABx) /* G[Bx] = R[A]                                             */     \
+    X(NewTable, ABC)  /* R[A] = {} sized for B array and C hash entries           */     \
+    X(SetList, ABC)   /* R[A][C*kSetListBatch + i - 1] = R[A+i] for i in 1..B     */     \
+    X(GetTable, ABC)  /* R[A] = R[B][R[C]]                                        */     \
+    X(GetField, ABC)  /* R[A] = R[B][K[C]]                                        */     \
+    X(SetTable, ABC)  /* R[A][R[B]] = R[C]                                        */     \
+    X(SetField, ABC)  /* R[A][K[B]] = R[C]                                        */     \
+    X(Add, ABC)       /* R[A] = R[B] + R[C]  (numbers, or concatenation)          */     \
+    X(Sub, ABC)                                                                          \
+    X(Mul, ABC)                                                                          \
+    X(Div, ABC)                                                                          \
+    X(Mod, ABC)                                                                          \
+    X(AddK, ABC)      /* R[A] = R[B] + K[C]                                       */     \
+    X(SubK, ABC)                                                                         \
+    X(MulK, ABC)                                                                         \
+    X(DivK, ABC)                                                                         \
+    X(ModK, ABC)                                                                         \
+    X(Unm, ABC)       /* R[A] = -R[B]                                             */     \
+    X(Not, ABC)       /* R[A] = not R[B]                                          */     \
+    X(Len, ABC)       /* R[A] = length of R[B]                                    */     \
+    X(Eq, ABC)        /* jump if (R[A] == R[B]) == C                              */     \
+    X(Lt, ABC)        /* jump if (R[A] <  R[B]) == C                              */     \
+    X(Le, ABC)        /* jump if (R[A] <= R[B]) == C                              */     \
+    X(EqK, ABC)       /* jump if (R[A] == K[B]) == C                              */     \
+    X(LtK, ABC)       /* jump if (R[A] <  K[B]) == C                              */     \
+    X(LeK, ABC)       /* jump if (R[A] <= K[B]) == C                              */     \
+    X(GtK, ABC)       /* jump if (R[A] >  K[B]) == C                              */     \
+    X(GeK, ABC)       /* jump if (R[A] >= K[B]) == C                              */     \
+    X(Test, ABC)      /* jump if truthy(R[A]) == C                                */     \
+    X(Jmp, sJ)        /* pc += sJ                                                 */     \
+    X(ForPrep, AsBx)  /* R[A..A+2] = index, limit, step; skip loop by sBx if empty */    \
+    X(ForLoop, AsBx)  /* step R[A]; if still in range R[A+3] = R[A], pc += sBx    */     \
+    X(TForPrep, AsBx) /* R[A] = table, R[A+1] = cursor; pc += sBx                 */     \
+    X(TForNext, AsBx) /* R[A+2], R[A+3] = next key, value; if found pc += sBx     */     \
+    X(Call, ABC)      /* R[A] = R[A](R[A+1..A+B])                                 */     \
+    X(Return, ABC)    /* return B ? R[A] : nil                                    */     \
+    X(Await, ABC)     /* R[A] = result of task R[B], suspending until it settles  */     \
+    X(Trap, ABx)      /* breakpoint patched in by a Debugger; Bx is its patch     */
+
+enum class Op : std::uint8_t {
+#define REBEL_OP_ENUM(name, format) name,
+    REBEL_OPCODES(REBEL_OP_ENUM)
+#undef REBEL_OP_ENUM
+    Count
+};
+
+enum class OpFormat : std::uint8_t { ABC, ABx, AsBx, sJ };
+
+using Instruction = std::uint32_t;
+
+constexpr int kSetListBatch = 32;  // array literal items stored per SetList
+constexpr int kBiasBx = 0x7fff;
+constexpr int kBiasJ = 0x7fffff;
+constexpr int kMaxBx = 0xffff;
+constexpr int kMaxSBx = kMaxBx - kBiasBx;
+constexpr int kMinSBx = -kBiasBx;
+constexpr int kMaxSJ = 0xffffff - kBiasJ;
+constexpr int kMinSJ = -kBiasJ;
+
+constexpr Instruction encode_abc(Op op, int a, int b, int c) {
+    return static_cast<Instruction>(op) | static_cast<Instruction>(a) << 8 | static_cast<Instruction>(b) << 16 |
+           static_cast<Instruction>(c) << 24;
+}
+constexpr Instruction encode_abx(Op op, int a, int bx) {
+    return static_cast<Instruction>(op) | static_cast<Instruction>(a) << 8 | static_cast<Instruction>(bx) << 16;
+}
+constexpr Instruction encode_asbx(Op op, int a, int sbx) { return encode_abx(op, a, sbx + kBiasBx); }
+constexpr Instruction encode_sj(Op op, int sj) {
+    return static_cast<Instruction>(op) | static_cast<Instruction>(sj + kBiasJ) << 8;
+}
+
+constexpr Op op_of(Instruction i) { return static_cast<Op>(i & 0xff); }
+constexpr int arg_a(Instruction i) { return static_cast<int>((i >> 8) & 0xff); }
+constexpr int arg_b(Instruction i) { return static_cast<int>((i >> 16) & 0xff); }
+constexpr int arg_c(Instruction i) { return static_cast<int>(i >> 24); }
+constexpr int arg_bx(Instruction i) { return static_cast<int>(i >> 16); }
+constexpr int arg_sbx(Instruction i) { return arg_bx(i) - kBiasBx; }
+constexpr int arg_sj(Instruction i) { return static_cast<int>(i >> 8) - kBiasJ; }
+
+const char* op_name(Op op);
+OpFormat op_format(Op op);
+
+}  // namespace rebel::script
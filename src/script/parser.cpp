@@ -0,0 +1,401 @@
+#include "script/parser.h"
+
+#include "script/error.h"
+
+#include <utility>
+
+namespace rebel::script {
+
+using namespace ast;
+
+namespace {
+
+// Binding power of binary operators; 0 for tokens that are not one.
+int precedence(Tok tok) {
+    switch (tok) {
+        case Tok::Or: return 1;
+        case Tok::And: return 2;
+        case Tok::Eq: case Tok::Ne: case Tok::Lt: case Tok::Le: case Tok::Gt: case Tok::Ge: return 3;
+        case Tok::Plus: case Tok::Minus: return 4;
+        case Tok::Star: case Tok::Slash: case Tok::Percent: return 5;
+        default: return 0;
+    }
+}
+
+constexpr int kUnaryPrecedence = 6;
+
+ExprPtr make_expr(ExprKind kind, std::uint32_t line) { return std::make_unique<Expr>(kind, line); }
+StmtPtr make_stmt(StmtKind kind, std::uint32_t line) { return std::make_unique<Stmt>(kind, line); }
+
+bool is_assignment(Tok tok) {
+    return tok == Tok::Assign || tok == Tok::PlusAssign || tok == Tok::MinusAssign || tok == Tok::StarAssign ||
+           tok == Tok::SlashAssign;
+}
+
+}  // namespace
+
+Parser::Parser(std::string_view source, std::string chunk) : lexer_(source, std::move(chunk)) { advance(); }
+
+void Parser::fail(const std::string& message) const {
+    throw CompileError(message, lexer_.chunk(), current_.line);
+}
+
+void Parser::fail_expected(const char* what) const {
+    std::string near = current_.kind == Tok::Name || current_.kind == Tok::Number ? "'" + current_.text + "'"
+                       : current_.kind == Tok::String                           ? "string"
+                                                                                : tok_name(current_.kind);
+    fail(std::string("expected ") + what + " near " + near);
+}
+
+void Parser::advance() {
+    previous_ = std::move(current_);
+    current_ = lexer_.next();
+}
+
+bool Parser::accept(Tok kind) {
+    if (!check(kind)) return false;
+    advance();
+    return true;
+}
+
+void Parser::expect(Tok kind, const char* context) {
+    if (!check(kind)) fail_expected((std::string(tok_name(kind)) + " " + context).c_str());
+    advance();
+}
+
+std::string Parser::expect_name(const char* context) {
+    if (!check(Tok::Name)) fail_expected((std::string("name ") + context).c_str());
+    advance();
+    return previous_.text;
+}
+
+FunctionDecl Parser::parse_chunk() {
+    FunctionDecl chunk;
+    chunk.name = "main";
+    chunk.line = 1;
+    while (!check(Tok::End)) {
+        if (accept(Tok::Semicolon)) continue;
+        chunk.body.push_back(parse_statement());
+    }
+    return chunk;
+}
+
+Block Parser::parse_block() {
+    expect(Tok::LBrace, "to open block");
+    Block block;
+    while (!check(Tok::RBrace)) {
+        if (check(Tok::End)) fail_expected("'}' to close block");
+        if (accept(Tok::Semicolon)) continue;
+        block.push_back(parse_statement());
+    }
+    advance();
+    return block;
+}
+
+StmtPtr Parser::parse_statement() {
+    const std::uint32_t line = current_.line;
+    switch (current_.kind) {
+        case Tok::Let: return parse_let();
+        case Tok::If: return parse_if();
+        case Tok::While: return parse_while();
+        case Tok::For: return parse_for();
+        case Tok::Return: return parse_return();
+        case Tok::Fn:
+        case Tok::Async: return parse_function_statement();
+        case Tok::LBrace: {
+            auto stmt = make_stmt(StmtKind::Block, line);
+            stmt->body = parse_block();
+            return stmt;
+        }
+        case Tok::Break:
+        case Tok::Continue: {
+            const bool is_break = check(Tok::Break);
+            if (loop_depth_ == 0) fail(std::string("'") + tok_name(current_.kind) + "' outside a loop");
+            advance();
+            return make_stmt(is_break ? StmtKind::Break : StmtKind::Continue, line);
+        }
+        default: return parse_expression_statement();
+    }
+}
+
+StmtPtr Parser::parse_let() {
+    auto stmt = make_stmt(StmtKind::Let, current_.line);
+    advance();
+    stmt->name = expect_name("after 'let'");
+    if (accept(Tok::Assign)) stmt->a = parse_expr();
+    return stmt;
+}
+
+StmtPtr Parser::parse_if() {
+    auto stmt = make_stmt(StmtKind::If, current_.line);
+    advance();
+    stmt->a = parse_expr();
+    stmt->body = parse_block();
+    if (accept(Tok::Else)) {
+        if (check(Tok::If)) {
+            stmt->orelse.push_back(parse_if());
+        } else {
+            stmt->orelse = parse_block();
+        }
+    }
+    return stmt;
+}
+
+StmtPtr Parser::parse_while() {
+    auto stmt = make_stmt(StmtKind::While, current_.line);
+    advance();
+    stmt->a = parse_expr();
+    ++loop_depth_;
+    stmt->body = parse_block();
+    --loop_depth_;
+    return stmt;
+}
+
+StmtPtr Parser::parse_for() {
+    const std::uint32_t line = current_.line;
+    advance();
+    std::string name = expect_name("after 'for'");
+    std::string value;
+    if (accept(Tok::Comma)) value = expect_name("after ','");
+    expect(Tok::In, "in 'for'");
+    ExprPtr subject = parse_expr();
+
+    StmtPtr stmt;
+    if (accept(Tok::DotDot)) {
+        if (!value.empty()) fail("a range loop takes one variable");
+        stmt = make_stmt(StmtKind::ForRange, line);
+        stmt->b = parse_expr();
+    } else {
+        stmt = make_stmt(StmtKind::ForIn, line);
+        stmt->value = std::move(value);
+    }
+    stmt->name = std::move(name);
+    stmt->a = std::move(subject);
+    ++loop_depth_;
+    stmt->body = parse_block();
+    --loop_depth_;
+    return stmt;
+}
+
+StmtPtr Parser::parse_function_statement() {
+    const std::uint32_t line = current_.line;
+    const bool is_async = accept(Tok::Async);
+    expect(Tok::Fn, "after 'async'");
+    auto stmt = make_stmt(StmtKind::Function, line);
+    stmt->name = expect_name("after 'fn'");
+    stmt->function = parse_function_body(stmt->name, line, is_async);
+    return stmt;
+}
+
+std::unique_ptr<FunctionDecl> Parser::parse_function_body(std::string name, std::uint32_t line, bool is_async) {
+    auto decl = std::make_unique<FunctionDecl>();
+    decl->name = std::move(name);
+    decl->line = line;
+    decl->is_async = is_async;
+    expect(Tok::LParen, "after function name");
+    if (!check(Tok::RParen)) {
+        do {
+            decl->params.push_back(expect_name("in parameter list"));
+        } while (accept(Tok::Comma));
+    }
+    expect(Tok::RParen, "to close parameter list");
+    if (decl->params.size() > 200) fail("too many parameters");
+
+    const int saved_loops = loop_depth_;
+    const bool saved_async = in_async_;
+    loop_depth_ = 0;
+    in_async_ = is_async;
+    decl->body = parse_block();
+    loop_depth_ = saved_loops;
+    in_async_ = saved_async;
+    return decl;
+}
+
+StmtPtr Parser::parse_return() {
+    auto stmt = make_stmt(StmtKind::Return, current_.line);
+    advance();
+    // The value must start on the same line as `return`.
+    if (!current_.newline_before && !check(Tok::RBrace) && !check(Tok::Semicolon) && !check(Tok::End)) {
+        stmt->a = parse_expr();
+    }
+    return stmt;
+}
+
+StmtPtr Parser::parse_expression_statement() {
+    const std::uint32_t line = current_.line;
+    ExprPtr target = parse_expr();
+    if (is_assignment(current_.kind)) {
+        if (target->kind != ExprKind::Name && target->kind != ExprKind::Index && target->kind != ExprKind::Field) {
+            fail("cannot assign to this expression");
+        }
+        auto stmt = make_stmt(StmtKind::Assign, line);
+        stmt->op = current_.kind;
+        advance();
+        stmt->a = std::move(target);
+        stmt->b = parse_expr();
+        return stmt;
+    }
+    if (target->kind != ExprKind::Call && target->kind != ExprKind::Await) {
+        fail("expression statement must be a call, an await or an assignment");
+    }
+    auto stmt = make_stmt(StmtKind::Expr, line);
+    stmt->a = std::move(target);
+    return stmt;
+}
+
+ExprPtr Parser::parse_expr() { return parse_binary(1); }
+
+ExprPtr Parser::parse_binary(int min_precedence) {
+    ExprPtr lhs = parse_unary();
+    for (;;) {
+        const Tok op = current_.kind;
+        const int p = precedence(op);
+        if (p == 0 || p < min_precedence) return lhs;
+        const std::uint32_t line = current_.line;
+        advance();
+        ExprPtr rhs = parse_binary(p + 1);  // every binary operator is left-associative
+        auto expr = make_expr(op == Tok::And ? ExprKind::And : op == Tok::Or ? ExprKind::Or : ExprKind::Binary, line);
+        expr->op = op;
+        expr->a = std::move(lhs);
+        expr->b = std::move(rhs);
+        lhs = std::move(expr);
+    }
+}
+
+ExprPtr Parser::parse_unary() {
+    if (check(Tok::Minus) || check(Tok::Not) || check(Tok::Hash)) {
+        auto expr = make_expr(ExprKind::Unary, current_.line);
+        expr->op = current_.kind;
+        advance();
+        expr->a = parse_binary(kUnaryPrecedence);
+        return expr;
+    }
+    if (check(Tok::Await)) {
+        if (!in_async_) fail("'await' outside an async function");
+        auto expr = make_expr(ExprKind::Await, current_.line);
+        advance();
+        expr->a = parse_binary(kUnaryPrecedence);
+        return expr;
+    }
+    return parse_postfix();
+}
+
+ExprPtr Parser::parse_postfix() {
+    ExprPtr expr = parse_primary();
+    for (;;) {
+        const std::uint32_t line = current_.line;
+        // '(' and '[' on a new line start a new statement rather than
+        // continuing this expression.
+        if (check(Tok::LParen) && !current_.newline_before) {
+            advance();
+            auto call = make_expr(ExprKind::Call, line);
+            call->a = std::move(expr);
+            if (!check(Tok::RParen)) {
+                do {
+                    call->list.push_back(parse_expr());
+                } while (accept(Tok::Comma));
+            }
+            expect(Tok::RParen, "to close argument list");
+            if (call->list.size() > 200) fail("too many arguments");
+            expr = std::move(call);
+        } else if (check(Tok::LBracket) && !current_.newline_before) {
+            advance();
+            auto index = make_expr(ExprKind::Index, line);
+            index->a = std::move(expr);
+            index->b = parse_expr();
+            expect(Tok::RBracket, "to close index");
+            expr = std::move(index);
+        } else if (check(Tok::Dot)) {
+            advance();
+            auto field = make_expr(ExprKind::Field, line);
+            field->a = std::move(expr);
+            field->text = expect_name("after '.'");
+            expr = std::move(field);
+        } else {
+            return expr;
+        }
+    }
+}
+
+ExprPtr Parser::parse_primary() {
+    const std::uint32_t line = current_.line;
+    switch (current_.kind) {
+        case Tok::Nil: advance(); return make_expr(ExprKind::Nil, line);
+        case Tok::True: advance(); return make_expr(ExprKind::True, line);
+        case Tok::False: advance(); return make_expr(ExprKind::False, line);
+        case Tok::Number: {
+            auto expr = make_expr(ExprKind::Number, line);
+            expr->number = current_.number;
+            advance();
+            return expr;
+        }
+        case Tok::String: {
+            auto expr = make_expr(ExprKind::String, line);
+            expr->text = std::move(current_.text);
+            advance();
+            return expr;
+        }
+        case Tok::Name: {
+            auto expr = make_expr(ExprKind::Name, line);
+            expr->text = std::move(current_.text);
+            advance();
+            return expr;
+        }
+        case Tok::LParen: {
+            advance();
+            ExprPtr expr = parse_expr();
+            expect(Tok::RParen, "to close parenthesis");
+            return expr;
+        }
+        case Tok::LBracket: return parse_array();
+        case Tok::LBrace: return parse_table();
+        case Tok::Fn:
+        case Tok::Async: {
+            const bool is_async = accept(Tok::Async);
+            expect(Tok::Fn, "after 'async'");
+            auto expr = make_expr(ExprKind::Function, line);
+            expr->function = parse_function_body("anonymous", line, is_async);
+            return expr;
+        }
+        default: fail_expected("expression");
+    }
+}
+
+ExprPtr Parser::parse_array() {
+    auto expr = make_expr(ExprKind::Array, current_.line);
+    advance();
+    while (!check(Tok::RBracket)) {
+        expr->list.push_back(parse_expr());
+        if (!accept(Tok::Comma)) break;
+    }
+    expect(Tok::RBracket, "to close array");
+    return expr;
+}
+
+ExprPtr Parser::parse_table() {
+    auto expr = make_expr(ExprKind::Table, current_.line);
+    advance();
+    while (!check(Tok::RBrace)) {
+        ExprPtr key;
+        if (check(Tok::Name)) {
+            key = make_expr(ExprKind::String, current_.line);
+            key->text = std::move(current_.text);
+            advance();
+        } else if (check(Tok::String)) {
+            key = parse_primary();
+        } else if (accept(Tok::LBracket)) {
+            key = parse_expr();
+            expect(Tok::RBracket, "to close key");
+        } else {
+            fail_expected("table key");
+        }
+        expect(Tok::Colon, "after table key");
+        expr->keys.push_back(std::move(key));
+        expr->list.push_back(parse_expr());
+        if (!accept(Tok::Comma)) break;
+    }
+    expect(Tok::RBrace, "to close table");
+    return expr;
+}
+
+}  // namespace rebel::script
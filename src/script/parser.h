@@ -0,0 +1,55 @@
+#pragma once
+
+#include "script/ast.h"
+#include "script/lexer.h"
+
+#include <string>
+#include <string_view>
+
+namespace rebel::script {
+
+/// Recursive-descent parser producing the AST for one chunk. The chunk is
+/// wrapped in an anonymous function whose body is the top-level block.
+/// Throws CompileError on the first syntax error.
+class Parser {
+public:
+    Parser(std::string_view source, std::string chunk);
+
+    ast::FunctionDecl parse_chunk();
+
+private:
+    [[noreturn]] void fail(const std::string& message) const;
+    [[noreturn]] void fail_expected(const char* what) const;
+    void advance();
+    bool check(Tok kind) const noexcept { return current_.kind == kind; }
+    bool accept(Tok kind);
+    void expect(Tok kind, const char* context);
+    std::string expect_name(const char* context);
+
+    ast::Block parse_block();
+    ast::StmtPtr parse_statement();
+    ast::StmtPtr parse_let();
+    ast::StmtPtr parse_if();
+    ast::StmtPtr parse_while();
+    ast::StmtPtr parse_for();
+    ast::StmtPtr parse_function_statement();
+    ast::StmtPtr parse_return();
+    ast::StmtPtr parse_expression_statement();
+    std::unique_ptr<ast::FunctionDecl> parse_function_body(std::string name, std::uint32_t line, bool is_async);
+
+    ast::ExprPtr parse_expr();
+    ast::ExprPtr parse_binary(int min_precedence);
+    ast::ExprPtr parse_unary();
+    ast::ExprPtr parse_postfix();
+    ast::ExprPtr parse_primary();
+    ast::ExprPtr parse_array();
+    ast::ExprPtr parse_table();
+
+    Lexer lexer_;
+    Token current_;
+    Token previous_;
+    int loop_depth_ = 0;
+    bool in_async_ = false;  // parsing an async function's body
+};
+
+}  // namespace rebel::script
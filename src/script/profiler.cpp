@@ -0,0 +1,293 @@
+#include "script/profiler.h"
+
+#include "core/hash.h"
+#include "script/vm.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace rebel::script {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string frame_label(const Profile::Frame& frame) {
+    std::string label = frame.function + " (" + frame.chunk + ":" + std::to_string(frame.line) + ")";
+    // ';' separates frames in the collapsed format.
+    std::replace(label.begin(), label.end(), ';', ',');
+    return label;
+}
+
+// Just enough of the protobuf wire format for profile.proto.
+class Proto {
+public:
+    void varint(std::uint64_t v) {
+        for (; v >= 0x80; v >>= 7) bytes_.push_back(static_cast<char>(v | 0x80));
+        bytes_.push_back(static_cast<char>(v));
+    }
+    void tag(std::uint32_t field, std::uint32_t wire) { varint(std::uint64_t{field} << 3 | wire); }
+    void integer(std::uint32_t field, std::uint64_t v) {
+        tag(field, 0);
+        varint(v);
+    }
+    void bytes(std::uint32_t field, std::string_view v) {
+        tag(field, 2);
+        varint(v.size());
+        bytes_.append(v);
+    }
+    void packed(std::uint32_t field, const std::vector<std::uint64_t>& values) {
+        Proto body;
+        for (const std::uint64_t v : values) body.varint(v);
+        bytes(field, body.str());
+    }
+    const std::string& str() const { return bytes_; }
+
+private:
+    std::string bytes_;
+};
+
+class StringTable {
+public:
+    StringTable() { index(""); }
+    std::uint64_t index(const std::string& s) {
+        const auto [it, inserted] = index_.try_emplace(s, strings_.size());
+        if (inserted) strings_.push_back(s);
+        return it->second;
+    }
+    const std::vector<std::string>& strings() const { return strings_; }
+
+private:
+    std::unordered_map<std::string, std::uint64_t> index_;
+    std::vector<std::string> strings_;
+};
+
+std::string value_type(StringTable& strings, const std::string& type, const std::string& unit) {
+    Proto p;
+    p.integer(1, strings.index(type));
+    p.integer(2, strings.index(unit));
+    return p.str();
+}
+
+}  // namespace
+
+std::string Profile::collapsed() const {
+    std::vector<std::string> labels;
+    labels.reserve(frames.size());
+    for (const Frame& frame : frames) labels.push_back(frame_label(frame));
+    std::string out;
+    for (const Stack& stack : stacks) {
+        for (std::size_t i = 0; i < stack.frames.size(); ++i) {
+            if (i > 0) out += ';';
+            out += labels[stack.frames[i]];
+        }
+        out += ' ';
+        out += std::to_string(stack.samples);
+        out += '\n';
+    }
+    return out;
+}
+
+std::string Profile::pprof() const {
+    StringTable strings;
+    Proto profile;
+    profile.bytes(1, value_type(strings, "samples", "count"));
+    profile.bytes(1, value_type(strings, "time", "nanoseconds"));
+
+    const auto period_ns = static_cast<std::uint64_t>(period_ms * 1e6);
+    for (const Stack& stack : stacks) {
+        Proto sample;
+        // Location ids are frame indexes + 1, leaf first.
+        std::vector<std::uint64_t> locations(stack.frames.rbegin(), stack.frames.rend());
+        for (std::uint64_t& id : locations) ++id;
+        sample.packed(1, locations);
+        sample.packed(2, {stack.samples, stack.samples * period_ns});
+        profile.bytes(2, sample.str());
+    }
+
+    // One pprof function per (name, chunk, line_defined); locations are
+    // the lines within it.
+    std::map<std::tuple<std::string, std::string, std::uint32_t>, std::uint64_t> functions;
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        const Frame& frame = frames[i];
+        const auto [it, inserted] =
+            functions.try_emplace({frame.function, frame.chunk, frame.line_defined}, functions.size() + 1);
+        Proto line;
+        line.integer(1, it->second);
+        line.integer(2, frame.line);
+        Proto location;
+        location.integer(1, i + 1);
+        location.bytes(4, line.str());
+        profile.bytes(4, location.str());
+    }
+    for (const auto& [key, id] : functions) {
+        const auto& [name, chunk, line_defined] = key;
+        Proto function;
+        function.integer(1, id);
+        function.integer(2, strings.index(name));
+        function.integer(3, strings.index(name));
+        function.integer(4, strings.index(chunk));
+        function.integer(5, line_defined);
+        profile.bytes(5, function.str());
+    }
+
+    const std::string period_type = value_type(strings, "cpu", "nanoseconds");
+    for (const std::string& s : strings.strings()) profile.bytes(6, s);
+    profile.integer(10, static_cast<std::uint64_t>(duration_ms * 1e6));
+    profile.bytes(11, period_type);
+    profile.integer(12, period_ns);
+    return profile.str();
+}
+
+std::vector<Profile::LineCost> Profile::lines() const {
+    std::map<std::pair<std::string, std::uint32_t>, LineCost> costs;
+    std::vector<LineCost*> seen;
+    for (const Stack& stack : stacks) {
+        seen.clear();
+        for (std::size_t i = 0; i < stack.frames.size(); ++i) {
+            const Frame& frame = frames[stack.frames[i]];
+            LineCost& cost = costs[{frame.chunk, frame.line}];
+            if (cost.chunk.empty()) {
+                cost.chunk = frame.chunk;
+                cost.line = frame.line;
+            }
+            if (i + 1 == stack.frames.size()) cost.self += stack.samples;
+            if (std::find(seen.begin(), seen.end(), &cost) == seen.end()) {
+                seen.push_back(&cost);
+                cost.total += stack.samples;
+            }
+        }
+    }
+    std::vector<LineCost> out;
+    out.reserve(costs.size());
+    for (auto& [key, cost] : costs) out.push_back(std::move(cost));
+    std::stable_sort(out.begin(), out.end(), [](const LineCost& a, const LineCost& b) {
+        return a.self != b.self ? a.self > b.self : a.total > b.total;
+    });
+    return out;
+}
+
+Profiler::Profiler(VM& vm, double hz) : vm_(vm), hz_(hz) {
+    if (!(hz > 0)) throw std::invalid_argument("profiler rate must be positive");
+    if (vm.profiler_) throw std::logic_error("a profiler is already attached to this VM");
+    vm.profiler_ = this;
+}
+
+Profiler::~Profiler() {
+    stop();
+    vm_.profiler_ = nullptr;
+}
+
+void Profiler::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_.load()) return;
+    stopping_ = false;
+    started_at_ = Clock::now();
+    started_.store(true);
+    sampler_ = std::thread([this] { run(); });
+}
+
+void Profiler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!started_.load()) return;
+        stopping_ = true;
+        sampled_ms_ += std::chrono::duration<double, std::milli>(Clock::now() - started_at_).count();
+        started_.store(false);
+    }
+    wake_.notify_all();
+    sampler_.join();
+}
+
+void Profiler::run() {
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / hz_));
+    Clock::time_point next = Clock::now() + period;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wake_.wait_until(lock, next, [this] { return stopping_; })) {
+        // Ticks missed while descheduled are dropped, not sent in a burst.
+        next = std::max(next + period, Clock::now());
+        if (!running_.load(std::memory_order_relaxed)) continue;
+        vm_.interrupt();
+        requests_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Profile Profiler::profile() const {
+    Profile profile;
+    profile.frames = frames_;
+    profile.stacks.reserve(stacks_.size());
+    for (const auto& [frames, samples] : stacks_) profile.stacks.push_back({frames, samples});
+    // Sorted, so that the same run gives the same output.
+    std::sort(profile.stacks.begin(), profile.stacks.end(),
+              [](const Profile::Stack& a, const Profile::Stack& b) { return a.frames < b.frames; });
+    profile.samples = samples_;
+    profile.period_ms = 1000 / hz_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    profile.duration_ms = sampled_ms_;
+    if (started_.load()) {
+        profile.duration_ms += std::chrono::duration<double, std::milli>(Clock::now() - started_at_).count();
+    }
+    return profile;
+}
+
+void Profiler::clear() {
+    frames_.clear();
+    frame_index_.clear();
+    stacks_.clear();
+    samples_ = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    sampled_ms_ = 0;
+    started_at_ = Clock::now();
+}
+
+Profiler::Stats Profiler::stats() const {
+    Stats stats;
+    stats.requests = requests_.load(std::memory_order_relaxed);
+    stats.samples = recorded_.load(std::memory_order_relaxed);
+    if (stats.samples > 0) {
+        stats.sample_ns = static_cast<double>(sample_ns_.load(std::memory_order_relaxed)) /
+                          static_cast<double>(stats.samples);
+    }
+    return stats;
+}
+
+std::size_t Profiler::StackHash::operator()(const std::vector<std::uint32_t>& stack) const noexcept {
+    return static_cast<std::size_t>(core::hash64(stack.data(), stack.size() * sizeof(std::uint32_t)));
+}
+
+void Profiler::sample() {
+    const Clock::time_point start = Clock::now();
+    stack_.clear();
+    for (const VM::Frame& f : vm_.frames_) stack_.push_back(frame(*f.fn, vm_.current_line(f)));
+    if (stack_.empty()) return;
+    ++stacks_[stack_];
+    ++samples_;
+    recorded_.fetch_add(1, std::memory_order_relaxed);
+    sample_ns_.fetch_add(
+        static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()),
+        std::memory_order_relaxed);
+}
+
+std::uint32_t Profiler::frame(const Function& fn, std::uint32_t line) {
+    // Functions move with each collection, so frames are found by what
+    // they show rather than by address.
+    static const std::string kNoChunk = "?";
+    const std::string& chunk = fn.chunk ? *fn.chunk : kNoChunk;
+    std::uint64_t key = core::hash64(fn.name, core::hash64(chunk, std::uint64_t{fn.line_defined} << 32 | line));
+    for (;; ++key) {
+        const auto [it, inserted] = frame_index_.try_emplace(key, static_cast<std::uint32_t>(frames_.size()));
+        if (inserted) {
+            frames_.push_back({fn.name, chunk, fn.line_defined, line});
+            return it->second;
+        }
+        const Profile::Frame& found = frames_[it->second];
+        if (found.line == line && found.line_defined == fn.line_defined && found.function == fn.name &&
+            found.chunk == chunk) {
+            return it->second;
+        }
+    }
+}
+
+}  // namespace rebel::script
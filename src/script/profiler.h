@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::script {
+
+class VM;
+struct Function;
+
+/// Call stacks seen by a Profiler, with how many samples saw each.
+struct Profile {
+    /// A source location in a function.
+    struct Frame {
+        std::string function;  // "main" for a chunk's top level
+        std::string chunk;
+        std::uint32_t line_defined = 0;
+        std::uint32_t line = 0;
+    };
+    struct Stack {
+        std::vector<std::uint32_t> frames;  // indexes into `frames`, outermost first
+        std::uint64_t samples = 0;
+    };
+    /// Samples on one line: `self` with it innermost, `total` with it
+    /// anywhere on the stack (once per stack, however deep it recurses).
+    struct LineCost {
+        std::string chunk;
+        std::uint32_t line = 0;
+        std::uint64_t self = 0;
+        std::uint64_t total = 0;
+    };
+
+    std::vector<Frame> frames;
+    std::vector<Stack> stacks;
+    std::uint64_t samples = 0;
+    double period_ms = 0;    // time one sample stands for
+    double duration_ms = 0;  // from start() to stop() or now
+
+    /// One line per stack, "outer;...;inner count", with frames written
+    /// "function (chunk:line)": the input of flamegraph.pl, speedscope and
+    /// most other flame graph viewers.
+    std::string collapsed() const;
+    /// The profile as a pprof protobuf (profile.proto), uncompressed, for
+    /// `pprof` and the viewers that read it. Values are samples and
+    /// nanoseconds.
+    std::string pprof() const;
+    /// Every line seen, most self samples first.
+    std::vector<LineCost> lines() const;
+};
+
+/// Sampling profiler for one VM.
+///
+/// While started, a thread of its own calls VM::interrupt() `hz` times a
+/// second, but only while the VM is running a script. The VM answers at
+/// its next safepoint (a call or loop back-edge, in interpreted and
+/// compiled code alike) by handing over its frames, which are recorded as
+/// a call stack of function, chunk and line. The interpreter does no
+/// extra work between samples, and a sample costs a stack walk: well under
+/// 1% at 1 kHz.
+///
+/// Samples land only on calls and back-edges, so time spent in straight-
+/// line code or in a native is charged to the next call or back-edge in
+/// the same function: the line, not necessarily the instruction.
+/// Compiled visual graphs are profiled like any chunk; see
+/// visual::node_costs to read the lines back as nodes.
+///
+/// At most one Profiler is attached to a VM at a time, and it must not
+/// outlive the VM. profile() and clear() belong to the VM's thread (or to
+/// any thread once stopped); start(), stop() and stats() to any.
+class Profiler {
+public:
+    struct Stats {
+        std::uint64_t requests = 0;  // interrupts sent
+        std::uint64_t samples = 0;   // stacks recorded
+        double sample_ns = 0;        // mean time the VM spent recording one
+    };
+
+    explicit Profiler(VM& vm, double hz = 1000);
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void start();
+    void stop();
+    bool started() const noexcept { return started_.load(); }
+
+    Profile profile() const;
+    /// Forgets the samples so far.
+    void clear();
+    Stats stats() const;
+
+private:
+    friend class VM;  // samples at safepoints and marks when scripts run
+
+    // Marks the VM as running a script for its lifetime, so the sampler
+    // does not interrupt a VM that is idle and charge the wait to the
+    // next script.
+    class Running {
+    public:
+        explicit Running(Profiler& profiler) : profiler_(profiler) { profiler_.running_.store(true); }
+        ~Running() { profiler_.running_.store(false); }
+        Running(const Running&) = delete;
+        Running& operator=(const Running&) = delete;
+
+    private:
+        Profiler& profiler_;
+    };
+
+    struct StackHash {
+        std::size_t operator()(const std::vector<std::uint32_t>& stack) const noexcept;
+    };
+
+    void sample();
+    std::uint32_t frame(const Function& fn, std::uint32_t line);
+    void run();
+
+    VM& vm_;
+    const double hz_;
+    std::vector<Profile::Frame> frames_;
+    std::unordered_map<std::uint64_t, std::uint32_t> frame_index_;  // by hash of the frame
+    std::unordered_map<std::vector<std::uint32_t>, std::uint64_t, StackHash> stacks_;
+    std::vector<std::uint32_t> stack_;  // reused by sample()
+    std::uint64_t samples_ = 0;
+    double sampled_ms_ = 0;  // before the current start()
+    std::chrono::steady_clock::time_point started_at_;
+
+    std::atomic<bool> started_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<std::uint64_t> requests_{0};
+    std::atomic<std::uint64_t> recorded_{0};
+    std::atomic<std::uint64_t> sample_ns_{0};
+    mutable std::mutex mutex_;  // guards the fields below and the times above
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread sampler_;
+};
+
+}  // namespace rebel::script
@@ -0,0 +1,262 @@
+#include "script/recorder.h"
+
+#include "script/debugger.h"
+#include "script/error.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace rebel::script {
+namespace {
+
+RecordedResult to_result(const NativeFunction& native, const Value& v) {
+    RecordedResult r;
+    switch (v.type()) {
+        case ValueType::Nil: r.kind = RecordedResult::Kind::Nil; break;
+        case ValueType::Bool:
+            r.kind = RecordedResult::Kind::Bool;
+            r.number = v.as_bool() ? 1 : 0;
+            break;
+        case ValueType::Number:
+            r.kind = RecordedResult::Kind::Number;
+            r.number = v.as_number();
+            break;
+        case ValueType::String:
+            r.kind = RecordedResult::Kind::String;
+            r.text = std::string(v.as_string()->view());
+            break;
+        default:
+            throw RuntimeError(native.name + ": cannot record a " + type_name(v.type()) + " result");
+    }
+    return r;
+}
+
+}  // namespace
+
+Recorder::Recorder(VM& vm, Debugger& debugger, RecorderOptions options)
+    : vm_(vm), debugger_(debugger), options_(std::move(options)) {
+    if (vm.recorder_) throw std::logic_error("a recorder is already attached to this VM");
+    options_.checkpoint_interval = std::max<std::uint32_t>(options_.checkpoint_interval, 1);
+    options_.max_checkpoints = std::max<std::size_t>(options_.max_checkpoints, 1);
+    if (options_.replay) {
+        reader_ = std::make_unique<RecordingReader>(options_.path);
+        frontier_ = std::numeric_limits<std::uint64_t>::max();
+    } else {
+        writer_ = std::make_unique<RecordingWriter>(options_.path);
+    }
+#ifdef REBEL_SCRIPT_JIT
+    // Compiled code calls scripts through nested host calls, which a
+    // checkpoint cannot be resumed across; record on the interpreter.
+    Jit::Config config = vm.jit().config();
+    jit_enabled_ = config.enabled;
+    config.enabled = false;
+    vm.jit().configure(config);
+#endif
+    vm.recorder_ = this;
+    debugger.recorder_ = this;
+}
+
+Recorder::~Recorder() {
+#ifdef REBEL_SCRIPT_JIT
+    Jit::Config config = vm_.jit().config();
+    config.enabled = jit_enabled_;
+    vm_.jit().configure(config);
+#endif
+    vm_.recorder_ = nullptr;
+    debugger_.recorder_ = nullptr;
+}
+
+bool Recorder::step_back() {
+    if (stops_ < 2) return false;
+    const std::uint64_t target = stops_ - 1;
+    const bool reachable = std::any_of(checkpoints_.begin(), checkpoints_.end(), [&](const Checkpoint& c) {
+        return c.stop <= target && c.activation.id == vm_.activation_.id;
+    });
+    back_requested_ = reachable;
+    return reachable;
+}
+
+Recorder::Stats Recorder::stats() const {
+    Stats s;
+    const RecordingPosition& log = writer_ ? writer_->position() : log_position();
+    s.results = log.results;
+    s.bytes = log.offset;
+    s.stops = stops_;
+    s.checkpoints = checkpoints_taken_;
+    s.tables_copied = tables_copied_;
+    s.live_checkpoints = checkpoints_.size();
+    return s;
+}
+
+void Recorder::flush() {
+    if (writer_) writer_->flush();
+}
+
+Value Recorder::call(NativeFunction& native, const NativeArgs& args) {
+    if (reader_ && reader_->position().results >= frontier_) go_live();
+    if (reader_) {
+        RecordingPosition before;
+        if (writer_) before = reader_->position();
+        if (reader_->next(result_, native_) && native_ == native.name) {
+            if (reader_->position().results >= frontier_) go_live();
+            switch (result_.kind) {
+                case RecordedResult::Kind::Nil: return Value();
+                case RecordedResult::Kind::Bool: return Value::boolean(result_.number != 0);
+                case RecordedResult::Kind::Number: return Value::number(result_.number);
+                case RecordedResult::Kind::String: return vm_.new_string(result_.text);
+                case RecordedResult::Kind::Error: throw RuntimeError(result_.text);
+            }
+        }
+        // The run left the log (the handler changed its state, or the log
+        // ends): what follows in it is no longer this run's future.
+        if (writer_) writer_->truncate(before);
+        go_live();
+    }
+
+    Value result;
+    try {
+        result = native.fn(vm_, args);
+    } catch (const RuntimeError& e) {
+        if (writer_) writer_->append(native.name, {RecordedResult::Kind::Error, 0, e.message()});
+        throw;
+    }
+    if (writer_) writer_->append(native.name, to_result(native, result));
+    return result;
+}
+
+void Recorder::copy_on_write(Table* table) {
+    if (checkpoints_.empty()) return;
+    Table* copy = vm_.heap().make_table();
+    copy->assign(*table);
+    vm_.table_set(checkpoints_.back().copies.get().as_table(), Value::object(table), Value::object(copy));
+    ++tables_copied_;
+}
+
+bool Recorder::stop(int breakpoint, Instruction original) {
+    ++stops_;
+    if (checkpoints_.empty() || stops_ - checkpoints_.back().stop >= options_.checkpoint_interval) {
+        checkpoint(breakpoint, original);
+    }
+    if (target_ != 0) {
+        if (stops_ < target_) return false;
+        target_ = 0;
+    }
+    return true;
+}
+
+bool Recorder::rewind(Instruction& resume, bool& landed, int& breakpoint) {
+    if (!back_requested_) return false;
+    back_requested_ = false;
+    const std::uint64_t target = stops_ - 1;
+    std::size_t index = checkpoints_.size();
+    while (index > 0 && !(checkpoints_[index - 1].stop <= target &&
+                          checkpoints_[index - 1].activation.id == vm_.activation_.id)) {
+        --index;
+    }
+    if (index-- == 0) return false;
+
+    if (writer_) {
+        writer_->flush();
+        frontier_ = writer_->position().results;
+    }
+    restore(index);
+    const Checkpoint& c = checkpoints_[index];
+    reader_ = std::make_unique<RecordingReader>(options_.path, c.log);
+    stops_ = c.stop;
+    resume = c.original;
+    breakpoint = c.breakpoint;
+    landed = c.stop == target;
+    target_ = landed ? 0 : target;
+    return true;
+}
+
+void Recorder::checkpoint(int breakpoint, Instruction original) {
+    if (checkpoints_.size() >= options_.max_checkpoints) checkpoints_.erase(checkpoints_.begin());
+    // Everything now predates the checkpoint and is copied when next written.
+    vm_.heap().advance_epoch();
+
+    Checkpoint c;
+    c.stop = stops_;
+    c.breakpoint = breakpoint;
+    c.original = original;
+    c.activation = vm_.activation_;
+    Value* const stack = vm_.stack_.get();
+    const auto first = vm_.frames_.begin() + static_cast<std::ptrdiff_t>(c.activation.depth);
+    c.stack_begin = static_cast<std::size_t>(first->base - stack);
+    c.stack_end = static_cast<std::size_t>(vm_.top_ - stack);
+    c.defined = vm_.defined_;
+
+    Table* values = vm_.heap().make_table(vm_.globals_.size() + (c.stack_end - c.stack_begin) +
+                                          static_cast<std::size_t>(vm_.frames_.end() - first));
+    std::vector<Value>& saved = values->array();
+    saved.insert(saved.end(), vm_.globals_.begin(), vm_.globals_.end());
+    saved.insert(saved.end(), stack + c.stack_begin, stack + c.stack_end);
+    for (auto frame = first; frame != vm_.frames_.end(); ++frame) {
+        saved.push_back(Value::object(frame->fn));
+        c.pcs.push_back(static_cast<std::uint32_t>(frame->pc - frame->fn->code.data()));
+        c.bases.push_back(static_cast<std::uint32_t>(frame->base - stack));
+    }
+    for (Value& v : saved) vm_.heap().barrier(values, v);
+    c.values = VM::Handle(vm_, Value::object(values));
+    c.copies = VM::Handle(vm_, vm_.new_table());
+
+    for (const Debugger::Breakpoint& bp : debugger_.breakpoints_) c.hits.emplace_back(bp.id, bp.hits);
+    c.log = log_position();
+    checkpoints_.push_back(std::move(c));
+    ++checkpoints_taken_;
+}
+
+void Recorder::restore(std::size_t index) {
+    // Newest first, so each table ends up as it was at the target.
+    for (std::size_t i = checkpoints_.size(); i-- > index;) {
+        const Table* copies = checkpoints_[i].copies.get().as_table();
+        std::size_t cursor = 0;
+        Value original;
+        Value copy;
+        while (copies->next(cursor, original, copy)) {
+            Table* t = original.as_table();
+            t->assign(*copy.as_table());
+            t->for_each_ref([&](Value& v) { vm_.heap().barrier(t, v); });
+        }
+    }
+    checkpoints_.erase(checkpoints_.begin() + static_cast<std::ptrdiff_t>(index) + 1, checkpoints_.end());
+    Checkpoint& c = checkpoints_[index];
+    vm_.heap().advance_epoch();
+    c.copies = VM::Handle(vm_, vm_.new_table());
+
+    const std::vector<Value>& saved = c.values.get().as_table()->array();
+    const std::size_t globals = c.defined.size();
+    for (std::size_t g = 0; g < vm_.globals_.size(); ++g) {
+        vm_.globals_[g] = g < globals ? saved[g] : Value();
+        vm_.defined_[g] = g < globals ? c.defined[g] : 0;
+    }
+    Value* const stack = vm_.stack_.get();
+    const std::size_t registers = c.stack_end - c.stack_begin;
+    std::copy(saved.begin() + static_cast<std::ptrdiff_t>(globals),
+              saved.begin() + static_cast<std::ptrdiff_t>(globals + registers), stack + c.stack_begin);
+    vm_.frames_.resize(c.activation.depth);
+    for (std::size_t f = 0; f < c.pcs.size(); ++f) {
+        Function* fn = saved[globals + registers + f].as_function();
+        vm_.frames_.push_back({fn, fn->code.data() + c.pcs[f], stack + c.bases[f]});
+    }
+    vm_.top_ = stack + c.stack_end;
+    vm_.stack_high_ = std::max(vm_.stack_high_, vm_.top_);
+
+    for (const auto& [id, hits] : c.hits) {
+        if (Debugger::Breakpoint* bp = debugger_.find(id)) bp->hits = hits;
+    }
+}
+
+const RecordingPosition& Recorder::log_position() const {
+    if (reader_) return reader_->position();
+    if (writer_) return writer_->position();
+    return end_;
+}
+
+void Recorder::go_live() {
+    if (!writer_) end_ = reader_->position();
+    reader_.reset();
+}
+
+}  // namespace rebel::script
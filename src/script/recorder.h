@@ -0,0 +1,139 @@
+#pragma once
+
+#include "script/object.h"
+#include "script/opcode.h"
+#include "script/recording.h"
+#include "script/vm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rebel::script {
+
+class Debugger;
+
+struct RecorderOptions {
+    /// The recording file; created, or read with `replay`.
+    std::string path;
+    /// Replays an existing recording from its start instead of writing one.
+    bool replay = false;
+    /// Takes a checkpoint at every n-th stop; stops in between are reached
+    /// by re-running from the checkpoint before them.
+    std::uint32_t checkpoint_interval = 1;
+    /// Drops the oldest checkpoints beyond this many.
+    std::size_t max_checkpoints = 64;
+};
+
+/// Records a debugged run so that it can be stepped backwards.
+///
+/// Re-running a script reproduces everything except the results of
+/// natives defined `recorded` (see VM::define_native), so only those are
+/// logged: streamed to a file, compactly encoded (see script/recording.h).
+/// A 10-minute run costs bytes per recorded call, not per instruction.
+///
+/// At debugger stops the recorder takes checkpoints. The registers and
+/// frames of the running host call and the globals are copied; tables are
+/// copied on write, the first time each is changed after the checkpoint,
+/// so a checkpoint costs what the script modifies rather than the heap.
+///
+/// step_back() from the stop handler returns to the previous stop: the
+/// nearest checkpoint at or before it is restored, bytecode re-runs from
+/// there with recorded natives answered from the log and the handler
+/// muted, and the handler is called again at that stop. Execution then
+/// replays the log until it catches up with where it was and records
+/// from there. Checkpoints only resume within the host call that took
+/// them (VM::call and its callees, not a caller further out), so the JIT
+/// tier, whose calls nest, is paused while a recorder is attached.
+///
+/// Recorded natives may return nil, booleans, numbers or strings, must
+/// not change script state, and are not called while replaying. At most
+/// one Recorder is attached to a VM, and it must not outlive the VM or
+/// the debugger.
+class Recorder {
+public:
+    struct Stats {
+        std::uint64_t results = 0;       // recorded native results in the log
+        std::uint64_t bytes = 0;         // log size
+        std::uint64_t stops = 0;         // position of the current stop
+        std::uint64_t checkpoints = 0;   // taken, all time
+        std::uint64_t tables_copied = 0; // copy-on-write copies, all time
+        std::size_t live_checkpoints = 0;
+    };
+
+    Recorder(VM& vm, Debugger& debugger, RecorderOptions options);
+    ~Recorder();
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    /// From the stop handler: once it returns, go back to the previous
+    /// stop. False, with nothing changed, if that stop predates the oldest
+    /// checkpoint of the current host call.
+    bool step_back();
+    /// True while re-running towards a target stop or through logged results.
+    bool replaying() const noexcept { return reader_ != nullptr; }
+    /// False while stops are muted on the way back to a target.
+    bool reporting() const noexcept { return target_ == 0; }
+
+    Stats stats() const;
+    /// Writes out buffered log data.
+    void flush();
+
+    /// Called by the VM for recorded natives.
+    Value call(NativeFunction& native, const NativeArgs& args);
+    /// Called by the VM before a table first changes in an epoch.
+    void copy_on_write(Table* table);
+
+    /// Called by the debugger at each stop, before reporting it; false
+    /// while the stop is muted.
+    bool stop(int breakpoint, Instruction original);
+    /// Called by the debugger after the handler. If it asked to go back,
+    /// restores the checkpoint and returns true with the instruction the
+    /// restored frame runs next; `landed` tells whether that is the target
+    /// stop itself, which the debugger reports again.
+    bool rewind(Instruction& resume, bool& landed, int& breakpoint);
+
+private:
+    struct Checkpoint {
+        std::uint64_t stop = 0;
+        int breakpoint = -1;
+        Instruction original = 0;  // the stopped instruction
+        VM::Activation activation;
+        std::vector<std::uint32_t> pcs;  // frames from activation.depth up
+        std::vector<std::uint32_t> bases;
+        std::size_t stack_begin = 0;
+        std::size_t stack_end = 0;
+        std::vector<std::uint8_t> defined;
+        VM::Handle values;  // array: globals, then registers, then frame functions
+        VM::Handle copies;  // tables written since, mapped to their contents at the checkpoint
+        std::vector<std::pair<int, std::uint64_t>> hits;
+        RecordingPosition log;
+    };
+
+    void checkpoint(int breakpoint, Instruction original);
+    void restore(std::size_t index);
+    const RecordingPosition& log_position() const;
+    void go_live();
+
+    VM& vm_;
+    Debugger& debugger_;
+    RecorderOptions options_;
+    std::unique_ptr<RecordingWriter> writer_;  // null when replaying a file
+    std::unique_ptr<RecordingReader> reader_;  // while answering from the log
+    std::uint64_t frontier_ = 0;               // results logged before the latest rewind
+    RecordingPosition end_;                    // where a replayed file ran out
+    std::vector<Checkpoint> checkpoints_;      // oldest first
+    std::uint64_t stops_ = 0;
+    std::uint64_t target_ = 0;                 // stop being returned to; 0: none
+    bool back_requested_ = false;
+    std::uint64_t checkpoints_taken_ = 0;
+    std::uint64_t tables_copied_ = 0;
+    RecordedResult result_;
+    std::string native_;
+    bool jit_enabled_ = false;
+};
+
+}  // namespace rebel::script
@@ -0,0 +1,216 @@
+#include "script/recording.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+namespace rebel::script {
+namespace {
+
+constexpr char kMagic[6] = {'R', 'B', 'L', 'R', 'E', 'C'};
+constexpr std::uint8_t kVersion = 1;
+constexpr std::uint64_t kHeaderBytes = sizeof kMagic + 1;
+
+enum Tag : std::uint8_t { kNil, kFalse, kTrue, kInteger, kDouble, kString, kError, kName };
+constexpr int kTagBits = 3;
+
+// Whole numbers whose differences fit comfortably in an int64; -0 is not,
+// since it would come back as 0.
+bool whole(double d) { return std::trunc(d) == d && std::fabs(d) < 0x1p53 && !(d == 0 && std::signbit(d)); }
+
+std::uint64_t bits_of(double d) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    return bits;
+}
+
+double from_bits(std::uint64_t bits) {
+    double d;
+    std::memcpy(&d, &bits, sizeof d);
+    return d;
+}
+
+std::uint64_t zigzag(std::int64_t v) { return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63); }
+std::int64_t unzigzag(std::uint64_t v) { return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1); }
+
+}  // namespace
+
+RecordingWriter::RecordingWriter(std::string path)
+    : path_(std::move(path)), out_(path_, std::ios::binary | std::ios::trunc) {
+    if (!out_) throw std::runtime_error("cannot write recording " + path_);
+    buffer_.reserve(kBufferBytes);
+    buffer_.append(kMagic, sizeof kMagic);
+    buffer_.push_back(static_cast<char>(kVersion));
+    state_.offset = kHeaderBytes;
+}
+
+RecordingWriter::~RecordingWriter() {
+    try {
+        flush();
+    } catch (...) {
+        // Nothing to report to from a destructor; call flush() to see errors.
+    }
+}
+
+void RecordingWriter::append(std::string_view native, const RecordedResult& result) {
+    std::uint64_t id = 0;
+    while (id < state_.natives.size() && state_.natives[id] != native) ++id;
+    if (id == state_.natives.size()) {
+        varint(id << kTagBits | kName);
+        bytes(native);
+        state_.natives.emplace_back(native);
+        state_.previous.push_back(0);
+    }
+    const std::uint64_t head = id << kTagBits;
+    switch (result.kind) {
+        case RecordedResult::Kind::Nil: varint(head | kNil); break;
+        case RecordedResult::Kind::Bool: varint(head | (result.number != 0 ? kTrue : kFalse)); break;
+        case RecordedResult::Kind::Number: {
+            double& previous = state_.previous[id];
+            if (whole(result.number) && whole(previous)) {
+                varint(head | kInteger);
+                varint(zigzag(static_cast<std::int64_t>(result.number) - static_cast<std::int64_t>(previous)));
+            } else {
+                varint(head | kDouble);
+                varint(zigzag(static_cast<std::int64_t>(bits_of(result.number) - bits_of(previous))));
+            }
+            previous = result.number;
+            break;
+        }
+        case RecordedResult::Kind::String:
+            varint(head | kString);
+            bytes(result.text);
+            break;
+        case RecordedResult::Kind::Error:
+            varint(head | kError);
+            bytes(result.text);
+            break;
+    }
+    ++state_.results;
+    if (buffer_.size() >= kBufferBytes) flush();
+}
+
+void RecordingWriter::flush() {
+    if (buffer_.empty()) return;
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    out_.flush();
+    if (!out_) throw std::runtime_error("cannot write recording " + path_);
+    buffer_.clear();
+}
+
+void RecordingWriter::truncate(const RecordingPosition& position) {
+    flush();
+    out_.close();
+    std::filesystem::resize_file(path_, position.offset);
+    out_.open(path_, std::ios::binary | std::ios::app);
+    if (!out_) throw std::runtime_error("cannot write recording " + path_);
+    state_ = position;
+}
+
+void RecordingWriter::varint(std::uint64_t v) {
+    for (; v >= 0x80; v >>= 7) {
+        buffer_.push_back(static_cast<char>(v | 0x80));
+        ++state_.offset;
+    }
+    buffer_.push_back(static_cast<char>(v));
+    ++state_.offset;
+}
+
+void RecordingWriter::bytes(std::string_view text) {
+    varint(text.size());
+    buffer_.append(text);
+    state_.offset += text.size();
+}
+
+RecordingReader::RecordingReader(const std::string& path) : in_(path, std::ios::binary) {
+    char header[kHeaderBytes];
+    if (!in_ || !in_.read(header, sizeof header) || std::memcmp(header, kMagic, sizeof kMagic) != 0) {
+        throw std::runtime_error(path + " is not a recording");
+    }
+    if (static_cast<std::uint8_t>(header[sizeof kMagic]) != kVersion) {
+        throw std::runtime_error(path + ": unsupported recording version");
+    }
+    state_.offset = kHeaderBytes;
+}
+
+RecordingReader::RecordingReader(const std::string& path, RecordingPosition position)
+    : in_(path, std::ios::binary), state_(std::move(position)) {
+    if (!in_ || !in_.seekg(static_cast<std::streamoff>(state_.offset))) {
+        throw std::runtime_error("cannot read recording " + path);
+    }
+}
+
+bool RecordingReader::next(RecordedResult& result, std::string& native) {
+    for (;;) {
+        std::uint64_t head;
+        if (!read_varint(head)) return false;
+        const auto tag = static_cast<Tag>(head & ((1u << kTagBits) - 1));
+        const std::uint64_t id = head >> kTagBits;
+        if (tag == kName) {
+            if (id != state_.natives.size()) throw std::runtime_error("corrupt recording");
+            state_.natives.push_back(read_bytes());
+            state_.previous.push_back(0);
+            continue;
+        }
+        if (id >= state_.natives.size()) throw std::runtime_error("corrupt recording");
+        native = state_.natives[id];
+        result.text.clear();
+        result.number = 0;
+        switch (tag) {
+            case kNil: result.kind = RecordedResult::Kind::Nil; break;
+            case kFalse:
+            case kTrue:
+                result.kind = RecordedResult::Kind::Bool;
+                result.number = tag == kTrue ? 1 : 0;
+                break;
+            case kInteger:
+            case kDouble: {
+                std::uint64_t v;
+                if (!read_varint(v)) throw std::runtime_error("truncated recording");
+                double& previous = state_.previous[id];
+                result.kind = RecordedResult::Kind::Number;
+                result.number = tag == kInteger
+                                    ? static_cast<double>(static_cast<std::int64_t>(previous) + unzigzag(v))
+                                    : from_bits(bits_of(previous) + static_cast<std::uint64_t>(unzigzag(v)));
+                previous = result.number;
+                break;
+            }
+            case kString:
+            case kError:
+                result.kind = tag == kString ? RecordedResult::Kind::String : RecordedResult::Kind::Error;
+                result.text = read_bytes();
+                break;
+            case kName: break;
+        }
+        ++state_.results;
+        return true;
+    }
+}
+
+bool RecordingReader::read_varint(std::uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int c = in_.get();
+        if (c == std::char_traits<char>::eof()) {
+            if (shift == 0) return false;
+            throw std::runtime_error("truncated recording");
+        }
+        ++state_.offset;
+        v |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    throw std::runtime_error("corrupt recording");
+}
+
+std::string RecordingReader::read_bytes() {
+    std::uint64_t n;
+    if (!read_varint(n)) throw std::runtime_error("truncated recording");
+    std::string text(n, '\0');
+    if (!in_.read(text.data(), static_cast<std::streamsize>(n))) throw std::runtime_error("truncated recording");
+    state_.offset += n;
+    return text;
+}
+
+}  // namespace rebel::script
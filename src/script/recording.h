@@ -0,0 +1,93 @@
+#pragma once
+
+// Recording files for script/recorder.h.
+//
+//   file   := "RBLREC" version:u8 event*
+//   event  := head:varint payload       head = native << 3 | tag
+//
+// Natives are numbered in order of first appearance, and a Name event
+// introduces each one before its first result. Numbers are encoded against
+// the same native's previous number: whole numbers as a zigzag varint of
+// the difference, others as a zigzag varint of the difference between their
+// bit patterns, which counts the doubles between two values of the same
+// sign and is short when they are close (a clock, a running sum).
+// Strings and error messages are a varint length and the bytes.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::script {
+
+/// One native result in a recording: a value, or the error it raised.
+struct RecordedResult {
+    enum class Kind : std::uint8_t { Nil, Bool, Number, String, Error };
+    Kind kind = Kind::Nil;
+    double number = 0;  // Bool: 0 or 1
+    std::string text;   // String and Error
+};
+
+/// Everything needed to read or write a recording from some point on.
+struct RecordingPosition {
+    std::uint64_t offset = 0;       // bytes
+    std::uint64_t results = 0;      // results before this point
+    std::vector<std::string> natives;  // by number
+    std::vector<double> previous;      // per native, the last number
+};
+
+/// Appends results to a recording file through a buffer. Throws
+/// std::runtime_error if the file cannot be written.
+class RecordingWriter {
+public:
+    static constexpr std::size_t kBufferBytes = 64 << 10;
+
+    explicit RecordingWriter(std::string path);
+    ~RecordingWriter();
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    void append(std::string_view native, const RecordedResult& result);
+    /// Writes out the buffer.
+    void flush();
+    /// Discards everything after `position`, which must be earlier.
+    void truncate(const RecordingPosition& position);
+
+    const RecordingPosition& position() const noexcept { return state_; }
+    const std::string& path() const noexcept { return path_; }
+
+private:
+    void varint(std::uint64_t v);
+    void bytes(std::string_view text);
+
+    std::string path_;
+    std::ofstream out_;
+    std::string buffer_;
+    RecordingPosition state_;
+};
+
+/// Reads results back. Throws std::runtime_error for a file that is not a
+/// recording or ends inside an event.
+class RecordingReader {
+public:
+    /// From the first event.
+    explicit RecordingReader(const std::string& path);
+    /// From `position`, as returned by a writer or reader of the same file.
+    RecordingReader(const std::string& path, RecordingPosition position);
+
+    /// The next result and the name of its native; false at the end.
+    bool next(RecordedResult& result, std::string& native);
+
+    const RecordingPosition& position() const noexcept { return state_; }
+
+private:
+    bool read_varint(std::uint64_t& v);
+    std::string read_bytes();
+
+    std::ifstream in_;
+    RecordingPosition state_;
+};
+
+}  // namespace rebel::script
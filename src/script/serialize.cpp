@@ -0,0 +1,341 @@
+#include "script/serialize.h"
+
+#include "core/hash.h"
+#include "script/vm.h"
+
+#include <cmath>
+
+namespace rebel::script::serial {
+namespace {
+
+enum Tag : std::uint8_t { kNil, kBool, kNumber, kString, kTable, kFunction, kNative };
+
+constexpr std::uint32_t kFormatVersion = 2;
+
+constexpr std::uint8_t kAsync = 1;  // function flags
+
+void skip_value(In& in) {
+    switch (in.u8()) {
+        case kNil: break;
+        case kBool: in.u8(); break;
+        case kNumber: in.f64(); break;
+        case kString:
+        case kTable:
+        case kFunction:
+        case kNative: in.u32(); break;
+        default: In::damaged();
+    }
+}
+
+bool uses_global(Op op) { return op == Op::GetGlobal || op == Op::SetGlobal; }
+
+}  // namespace
+
+std::uint64_t instruction_set_hash() {
+    std::uint64_t hash = kFormatVersion;
+    for (int op = 0; op < static_cast<int>(Op::Count); ++op) {
+        hash = core::hash64(std::string_view(op_name(static_cast<Op>(op))), hash);
+    }
+    return hash;
+}
+
+void In::damaged() { throw DamagedError("stored bytecode is damaged"); }
+
+ObjectWriter::ObjectWriter(const VM& vm) : global_names_(vm.global_names_) {
+    for (const auto& [text, s] : vm.interned_) interned_.emplace(s, true);
+}
+
+std::uint32_t ObjectWriter::string(std::string_view text) { return string(text, false); }
+
+std::uint32_t ObjectWriter::string(std::string_view text, bool interned) {
+    auto [it, inserted] = strings_index_.try_emplace(std::string(text), static_cast<std::uint32_t>(strings_.size()));
+    if (inserted) strings_.push_back({it->first, interned});
+    if (interned) strings_[it->second].interned = true;
+    return it->second;
+}
+
+void ObjectWriter::add(const Value& root) {
+    note(root);
+    close();
+}
+
+void ObjectWriter::note(const Value& v) {
+    switch (v.type()) {
+        case ValueType::String: string(v.as_string()->view(), interned_.count(v.as_string()) > 0); break;
+        case ValueType::Table: {
+            const Table* t = v.as_table();
+            if (tables_.try_emplace(t, static_cast<std::uint32_t>(table_list_.size())).second) {
+                table_list_.push_back(t);
+                pending_.push_back(v);
+            }
+            break;
+        }
+        case ValueType::Function: {
+            const Function* fn = v.as_function();
+            if (functions_.try_emplace(fn, static_cast<std::uint32_t>(function_list_.size())).second) {
+                function_list_.push_back(fn);
+                pending_.push_back(v);
+            }
+            break;
+        }
+        case ValueType::Native: {
+            const NativeFunction* native = v.as_native();
+            if (natives_.try_emplace(native, static_cast<std::uint32_t>(native_list_.size())).second) {
+                string(native->name);
+                native_list_.push_back(native);
+            }
+            break;
+        }
+        case ValueType::Task: throw ImageError("cannot save a task");
+        default: break;
+    }
+}
+
+void ObjectWriter::close() {
+    while (!pending_.empty()) {
+        const Value v = pending_.back();
+        pending_.pop_back();
+        if (v.is_table()) {
+            std::size_t cursor = 0;
+            Value key;
+            Value value;
+            while (v.as_table()->next(cursor, key, value)) {
+                note(key);
+                note(value);
+            }
+            continue;
+        }
+        const Function* fn = v.as_function();
+        string(fn->name);
+        string(fn->chunk ? *fn->chunk : std::string());
+        for (const Instruction i : fn->code) {
+            if (!uses_global(op_of(i))) continue;
+            const auto slot = static_cast<std::uint32_t>(arg_bx(i));
+            if (names_.try_emplace(slot, static_cast<std::uint32_t>(name_list_.size())).second) {
+                name_list_.push_back(string(global_names_[slot]));
+            }
+        }
+        for (const Value& k : fn->constants) note(k);
+        for (const Function::LocalVar& local : fn->locals) string(local.name);
+    }
+}
+
+void ObjectWriter::value(Out& out, const Value& v) const {
+    switch (v.type()) {
+        case ValueType::Nil: out.u8(kNil); break;
+        case ValueType::Bool:
+            out.u8(kBool);
+            out.u8(v.as_bool() ? 1 : 0);
+            break;
+        case ValueType::Number:
+            out.u8(kNumber);
+            out.f64(v.as_number());
+            break;
+        case ValueType::String:
+            out.u8(kString);
+            out.u32(index(v.as_string()->view()));
+            break;
+        case ValueType::Table:
+            out.u8(kTable);
+            out.u32(tables_.at(v.as_table()));
+            break;
+        case ValueType::Function:
+            out.u8(kFunction);
+            out.u32(functions_.at(v.as_function()));
+            break;
+        case ValueType::Native:
+            out.u8(kNative);
+            out.u32(natives_.at(v.as_native()));
+            break;
+        case ValueType::Task: break;  // note() refused it
+    }
+}
+
+void ObjectWriter::write(Out& out) {
+    out.u32(static_cast<std::uint32_t>(strings_.size()));
+    for (const Text& s : strings_) {
+        out.u8(s.interned ? 1 : 0);
+        out.u32(static_cast<std::uint32_t>(s.text.size()));
+        out.raw(s.text.data(), s.text.size());
+    }
+    out.u32(static_cast<std::uint32_t>(name_list_.size()));
+    for (const std::uint32_t name : name_list_) out.u32(name);
+    out.u32(static_cast<std::uint32_t>(native_list_.size()));
+    for (const NativeFunction* native : native_list_) out.u32(index(native->name));
+
+    out.u32(static_cast<std::uint32_t>(table_list_.size()));
+    std::vector<std::pair<Value, Value>> hash;
+    for (const Table* t : table_list_) {
+        out.u32(static_cast<std::uint32_t>(t->length()));
+        for (const Value& v : t->array()) value(out, v);
+        hash.clear();
+        std::size_t cursor = t->length();
+        Value key;
+        Value v;
+        while (t->next(cursor, key, v)) hash.emplace_back(key, v);
+        out.u32(static_cast<std::uint32_t>(hash.size()));
+        for (const auto& [k, item] : hash) {
+            value(out, k);
+            value(out, item);
+        }
+    }
+
+    out.u32(static_cast<std::uint32_t>(function_list_.size()));
+    instructions_ = 0;
+    for (const Function* fn : function_list_) {
+        out.u32(index(fn->name));
+        out.u32(index(fn->chunk ? *fn->chunk : std::string()));
+        out.u32(fn->line_defined);
+        out.u8(fn->params);
+        out.u8(fn->registers);
+        out.u8(fn->is_async ? kAsync : 0);
+        out.u32(static_cast<std::uint32_t>(fn->code.size()));
+        for (std::size_t pc = 0; pc < fn->code.size(); ++pc) {
+            Instruction i = fn->code[pc];
+            const Op op = op_of(i);
+            if (op == Op::Trap) throw ImageError("cannot save code while breakpoints are set");
+            if (uses_global(op)) i = encode_abx(op, arg_a(i), static_cast<int>(names_.at(arg_bx(i))));
+            out.u32(i);
+            out.u32(fn->line_at(pc));
+        }
+        out.u32(static_cast<std::uint32_t>(fn->constants.size()));
+        for (const Value& k : fn->constants) value(out, k);
+        out.u32(static_cast<std::uint32_t>(fn->locals.size()));
+        for (const Function::LocalVar& local : fn->locals) {
+            out.u32(index(local.name));
+            out.u8(local.reg);
+            out.u32(local.start);
+            out.u32(local.end);
+        }
+        instructions_ += fn->code.size();
+    }
+}
+
+ObjectReader::ObjectReader(VM& vm, In& in, std::shared_ptr<const std::string> chunk) : vm_(vm) {
+    texts_.resize(in.count(5));
+    for (Text& t : texts_) {
+        t.interned = in.u8() != 0;
+        t.text = in.bytes(in.u32());
+    }
+    std::vector<std::uint32_t> names(in.count(4));
+    for (std::uint32_t& name : names) name = in.u32();
+
+    natives_.resize(in.count(4));
+    for (NativeFunction*& native : natives_) {
+        const std::string_view name = text(in.u32());
+        const Value found = vm.global(name);
+        if (!found.is_native()) throw ImageError("stored code needs the native '" + std::string(name) + "'");
+        native = found.as_native();
+    }
+
+    Heap& heap = vm.heap();
+    strings_.assign(texts_.size(), nullptr);
+    tables_.resize(in.count(8));
+    for (Table*& t : tables_) t = heap.make_table();
+    // Tables may refer to functions, which come later: read the table
+    // section again once the functions exist.
+    In tables = in;
+    for (std::size_t t = 0; t < tables_.size(); ++t) {
+        const std::uint32_t array = in.count(1);
+        for (std::uint32_t i = 0; i < array; ++i) skip_value(in);
+        const std::uint32_t hash = in.count(2);
+        for (std::uint32_t i = 0; i < 2 * hash; ++i) skip_value(in);
+    }
+    functions_.resize(in.count(27));
+    for (Function*& fn : functions_) fn = heap.make_function();
+
+    std::unordered_map<std::uint32_t, std::shared_ptr<const std::string>> chunk_names;
+    constexpr std::uint32_t kUnbound = ~std::uint32_t{0};
+    std::vector<std::uint32_t> slots(names.size(), kUnbound);
+    for (Function* fn : functions_) {
+        fn->name = std::string(text(in.u32()));
+        const std::uint32_t chunk_name = in.u32();
+        if (chunk) {
+            fn->chunk = chunk;
+        } else {
+            std::shared_ptr<const std::string>& shared = chunk_names[chunk_name];
+            if (!shared) shared = std::make_shared<const std::string>(text(chunk_name));
+            fn->chunk = shared;
+        }
+        fn->line_defined = in.u32();
+        fn->params = in.u8();
+        fn->registers = in.u8();
+        const std::uint8_t flags = in.u8();
+        if (flags & ~kAsync) In::damaged();
+        fn->is_async = (flags & kAsync) != 0;
+        const std::uint32_t code = in.count(8);
+        fn->code.resize(code);
+        fn->lines.resize(code);
+        for (std::uint32_t pc = 0; pc < code; ++pc) {
+            Instruction i = in.u32();
+            const Op op = op_of(i);
+            if (op >= Op::Count || op == Op::Trap) In::damaged();
+            if (uses_global(op)) {
+                const auto name = static_cast<std::uint32_t>(arg_bx(i));
+                if (name >= names.size()) In::damaged();
+                std::uint32_t& slot = slots[name];
+                if (slot == kUnbound) slot = vm.global_slot(text(names[name]));
+                if (slot > static_cast<std::uint32_t>(kMaxBx)) throw ImageError("too many globals to load code");
+                i = encode_abx(op, arg_a(i), static_cast<int>(slot));
+            }
+            fn->code[pc] = i;
+            fn->lines[pc] = in.u32();
+        }
+        fn->constants.resize(in.count(1));
+        for (Value& k : fn->constants) k = value(in);
+        fn->locals.resize(in.count(13));
+        for (Function::LocalVar& local : fn->locals) {
+            local.name = std::string(text(in.u32()));
+            local.reg = in.u8();
+            local.start = in.u32();
+            local.end = in.u32();
+        }
+    }
+
+    for (Table* t : tables_) {
+        const std::uint32_t array = tables.u32();
+        std::vector<Value>& items = t->array();
+        items.reserve(array);
+        for (std::uint32_t i = 0; i < array; ++i) items.push_back(value(tables));
+        const std::uint32_t hash = tables.u32();
+        t->reserve(0, hash);
+        for (std::uint32_t i = 0; i < hash; ++i) {
+            const Value key = value(tables);
+            const Value v = value(tables);
+            if (key.is_nil() || (key.is_number() && std::isnan(key.as_number()))) In::damaged();
+            vm.table_set(t, key, v);
+        }
+    }
+}
+
+Value ObjectReader::value(In& in) {
+    switch (in.u8()) {
+        case kNil: return Value();
+        case kBool: return Value::boolean(in.u8() != 0);
+        case kNumber: return Value::number(in.f64());
+        case kString: {
+            const std::uint32_t index = in.u32();
+            if (index >= strings_.size()) In::damaged();
+            String*& s = strings_[index];
+            if (!s) {
+                const Text& t = texts_[index];
+                s = t.interned ? vm_.intern(t.text) : vm_.heap().make_string(t.text);
+            }
+            return Value::object(s);
+        }
+        case kTable: {
+            const std::uint32_t index = in.u32();
+            if (index >= tables_.size()) In::damaged();
+            return Value::object(tables_[index]);
+        }
+        case kFunction: return Value::object(function(in.u32()));
+        case kNative: {
+            const std::uint32_t index = in.u32();
+            if (index >= natives_.size()) In::damaged();
+            return Value::object(natives_[index]);
+        }
+        default: In::damaged();
+    }
+}
+
+}  // namespace rebel::script::serial
@@ -0,0 +1,192 @@
+#pragma once
+
+// Compiled code and the objects it reaches, as stored by runtime images
+// (script/image.h) and the bytecode cache (script/bytecode_cache.h):
+//
+//   objects  := strings names natives tables functions
+//   strings  := count:u32 (interned:u8 length:u32 bytes)*
+//   names    := count:u32 string:u32*     globals the code uses, by operand
+//   natives  := count:u32 string:u32*     referred to by name
+//   tables   := count:u32 (array:u32 value* hash:u32 (value value)*)*
+//   functions:= count:u32 function*
+//   function := name:u32 chunk:u32 line:u32 params:u8 registers:u8 flags:u8
+//               code:u32 (instruction line)* constants:u32 value*
+//               locals:u32 (name:u32 reg:u8 start:u32 end:u32)*
+//   value    := tag:u8 (nil | bool:u8 | number:f64 | index:u32)
+//
+// Integers are little-endian. Strings, tables, functions and natives are
+// referred to by their index in these sections, so shared and cyclic
+// references survive. The Bx operand of GetGlobal and SetGlobal indexes
+// `names`, and is bound to the loading VM's slot for that name. The only
+// function flag is 1, async.
+
+#include "script/image.h"
+#include "script/object.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::script {
+
+class VM;
+
+namespace serial {
+
+/// Stored data that is truncated or inconsistent, as opposed to data the
+/// loading VM cannot take (a missing native).
+class DamagedError : public ImageError {
+public:
+    using ImageError::ImageError;
+};
+
+/// Identifies the instruction set: the format version and every opcode's
+/// name in order. Stored code from a build where this differs is rejected.
+std::uint64_t instruction_set_hash();
+
+class Out {
+public:
+    void u8(std::uint8_t v) { bytes_.push_back(static_cast<char>(v)); }
+    void u32(std::uint32_t v) { raw(&v, sizeof v); }
+    void f64(double v) { raw(&v, sizeof v); }
+    void raw(const void* data, std::size_t size) { bytes_.append(static_cast<const char*>(data), size); }
+    std::string& bytes() noexcept { return bytes_; }
+
+private:
+    std::string bytes_;
+};
+
+/// Bounds-checked cursor over stored bytes; throws DamagedError on reading
+/// past the end.
+class In {
+public:
+    explicit In(std::string_view bytes) : bytes_(bytes) {}
+
+    std::uint8_t u8() { return static_cast<std::uint8_t>(*take(1)); }
+    std::uint32_t u32() { return load<std::uint32_t>(); }
+    double f64() { return load<double>(); }
+    std::string_view bytes(std::size_t n) { return {take(n), n}; }
+    /// A count of items at least `item_bytes` long each, checked against
+    /// what is left so a damaged count cannot ask for a huge allocation.
+    std::uint32_t count(std::size_t item_bytes) {
+        const std::uint32_t n = u32();
+        if (static_cast<std::uint64_t>(n) * item_bytes > bytes_.size() - at_) damaged();
+        return n;
+    }
+
+    [[noreturn]] static void damaged();
+
+private:
+    const char* take(std::size_t n) {
+        if (n > bytes_.size() - at_) damaged();
+        const char* p = bytes_.data() + at_;
+        at_ += n;
+        return p;
+    }
+    template <typename T>
+    T load() {
+        T v;
+        std::memcpy(&v, take(sizeof v), sizeof v);
+        return v;
+    }
+
+    std::string_view bytes_;
+    std::size_t at_ = 0;
+};
+
+/// Collects everything reachable from the values added, then writes it.
+class ObjectWriter {
+public:
+    /// Writes objects of `vm`, which must outlive the writer; its interned
+    /// strings are stored as such and its global slots by name.
+    explicit ObjectWriter(const VM& vm);
+
+    void add(const Value& root);
+    /// A string to write, for names the caller stores; returns its index.
+    std::uint32_t string(std::string_view text);
+
+    /// Writes the sections. Throws ImageError if the debugger has patched
+    /// the code.
+    void write(Out& out);
+    /// A value added earlier or reachable from one.
+    void value(Out& out, const Value& v) const;
+    std::uint32_t index(std::string_view text) const { return strings_index_.at(std::string(text)); }
+    std::uint32_t index(const Function* fn) const { return functions_.at(fn); }
+
+    const std::vector<const NativeFunction*>& natives() const noexcept { return native_list_; }
+    std::size_t string_count() const noexcept { return strings_.size(); }
+    std::size_t table_count() const noexcept { return table_list_.size(); }
+    std::size_t function_count() const noexcept { return function_list_.size(); }
+    std::size_t instruction_count() const noexcept { return instructions_; }
+
+private:
+    std::uint32_t string(std::string_view text, bool interned);
+    void note(const Value& v);
+    void close();
+
+    struct Text {
+        std::string_view text;  // a key of strings_index_
+        bool interned;
+    };
+
+    std::unordered_map<const String*, bool> interned_;
+    const std::vector<std::string>& global_names_;
+    std::unordered_map<std::string, std::uint32_t> strings_index_;
+    std::vector<Text> strings_;
+    std::unordered_map<std::uint32_t, std::uint32_t> names_;  // VM slot to index in names
+    std::vector<std::uint32_t> name_list_;                    // strings
+    std::unordered_map<const Table*, std::uint32_t> tables_;
+    std::vector<const Table*> table_list_;
+    std::unordered_map<const Function*, std::uint32_t> functions_;
+    std::vector<const Function*> function_list_;
+    std::unordered_map<const NativeFunction*, std::uint32_t> natives_;
+    std::vector<const NativeFunction*> native_list_;
+    std::vector<Value> pending_;
+    std::size_t instructions_ = 0;
+};
+
+/// Reads the sections written by ObjectWriter into a VM's heap.
+///
+/// Allocation never collects, so the objects stay where they are until
+/// the caller's next safepoint; by then it must have made them reachable
+/// (a global, a loaded chunk, a Handle).
+class ObjectReader {
+public:
+    /// Reads the sections at `in`. Natives are looked up among `vm`'s
+    /// globals first, and a missing one throws ImageError before anything
+    /// is allocated or any global slot created; damaged data throws
+    /// DamagedError. When `chunk` is given, every function takes it as
+    /// its chunk name instead of the stored one.
+    ObjectReader(VM& vm, In& in, std::shared_ptr<const std::string> chunk = nullptr);
+
+    Value value(In& in);
+    std::string_view text(std::uint32_t index) const {
+        if (index >= texts_.size()) In::damaged();
+        return texts_[index].text;
+    }
+    Function* function(std::uint32_t index) const {
+        if (index >= functions_.size()) In::damaged();
+        return functions_[index];
+    }
+
+private:
+    struct Text {
+        std::string_view text;
+        bool interned;
+    };
+
+    VM& vm_;
+    std::vector<Text> texts_;
+    std::vector<String*> strings_;  // created on first use
+    std::vector<NativeFunction*> natives_;
+    std::vector<Table*> tables_;
+    std::vector<Function*> functions_;
+};
+
+}  // namespace serial
+}  // namespace rebel::script
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace rebel::script {
+
+struct Object;
+struct String;
+class Table;
+struct Function;
+struct NativeFunction;
+struct Task;
+
+/// Dynamic type of a Value. Heap-allocated kinds start at String and share
+/// their numbering with ObjectType.
+enum class ValueType : std::uint8_t { Nil, Bool, Number, String, Table, Function, Native, Task };
+
+const char* type_name(ValueType type);
+
+/// A script value: 16 bytes, tag plus payload. Heap objects are referenced,
+/// never owned; their lifetime is managed by the Heap.
+class Value {
+public:
+    constexpr Value() noexcept : type_(ValueType::Nil), number_(0) {}
+
+    static constexpr Value nil() noexcept { return Value(); }
+    static constexpr Value boolean(bool b) noexcept {
+        Value v;
+        v.type_ = ValueType::Bool;
+        v.boolean_ = b;
+        return v;
+    }
+    static constexpr Value number(double n) noexcept {
+        Value v;
+        v.type_ = ValueType::Number;
+        v.number_ = n;
+        return v;
+    }
+    static Value object(Object* object) noexcept;
+
+    constexpr ValueType type() const noexcept { return type_; }
+    constexpr bool is_nil() const noexcept { return type_ == ValueType::Nil; }
+    constexpr bool is_bool() const noexcept { return type_ == ValueType::Bool; }
+    constexpr bool is_number() const noexcept { return type_ == ValueType::Number; }
+    constexpr bool is_string() const noexcept { return type_ == ValueType::String; }
+    constexpr bool is_table() const noexcept { return type_ == ValueType::Table; }
+    constexpr bool is_function() const noexcept { return type_ == ValueType::Function; }
+    constexpr bool is_native() const noexcept { return type_ == ValueType::Native; }
+    constexpr bool is_task() const noexcept { return type_ == ValueType::Task; }
+    constexpr bool is_object() const noexcept { return type_ >= ValueType::String; }
+
+    constexpr bool as_bool() const noexcept { return boolean_; }
+    constexpr double as_number() const noexcept { return number_; }
+    Object* as_object() const noexcept { return object_; }
+    // Defined in script/object.h, where the object types are complete.
+    String* as_string() const noexcept;
+    Table* as_table() const noexcept;
+    Function* as_function() const noexcept;
+    NativeFunction* as_native() const noexcept;
+    Task* as_task() const noexcept;
+
+    /// nil and false are falsy; everything else, including 0 and "", is truthy.
+    constexpr bool truthy() const noexcept {
+        return !(type_ == ValueType::Nil || (type_ == ValueType::Bool && !boolean_));
+    }
+
+    /// Identity for objects, value equality for primitives. Use
+    /// values_equal() for script-level equality, which compares strings by
+    /// content.
+    friend bool operator==(const Value& a, const Value& b) noexcept {
+        if (a.type_ != b.type_) return false;
+        switch (a.type_) {
+            case ValueType::Nil: return true;
+            case ValueType::Bool: return a.boolean_ == b.boolean_;
+            case ValueType::Number: return a.number_ == b.number_;
+            default: return a.object_ == b.object_;
+        }
+    }
+    friend bool operator!=(const Value& a, const Value& b) noexcept { return !(a == b); }
+
+private:
+    friend class Heap;
+    friend class Jit;
+    friend class VM;
+
+    ValueType type_;
+    union {
+        bool boolean_;
+        double number_;
+        Object* object_;
+    };
+};
+
+static_assert(sizeof(Value) == 16, "Value should stay two words");
+
+/// `%` on numbers: the result takes the sign of the divisor.
+inline double floor_mod(double a, double b) noexcept {
+    const double r = std::fmod(a, b);
+    return (r != 0 && (r < 0) != (b < 0)) ? r + b : r;
+}
+
+}  // namespace rebel::script
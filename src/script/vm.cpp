@@ -0,0 +1,1195 @@
+#include "script/vm.h"
+
+#include "core/trace.h"
+#include "script/compiler.h"
+#include "script/debugger.h"
+#include "script/profiler.h"
+#include "script/recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// Threaded dispatch through a table of label addresses where the compiler
+// supports it (GCC and Clang); a plain switch elsewhere, or when
+// REBEL_SCRIPT_SWITCH_DISPATCH is defined.
+#if defined(__GNUC__) && !defined(REBEL_SCRIPT_SWITCH_DISPATCH)
+#define REBEL_SCRIPT_COMPUTED_GOTO 1
+#else
+#define REBEL_SCRIPT_COMPUTED_GOTO 0
+#endif
+
+namespace rebel::script {
+namespace {
+
+std::string number_to_string(double d) {
+    char buffer[32];
+    if (std::isnan(d)) return "nan";
+    if (std::isinf(d)) return d > 0 ? "inf" : "-inf";
+    if (d == std::floor(d) && std::fabs(d) < 1e15) {
+        std::snprintf(buffer, sizeof buffer, "%.0f", d);
+    } else {
+        std::snprintf(buffer, sizeof buffer, "%.14g", d);
+    }
+    return buffer;
+}
+
+std::string describe(const Value& v) { return std::string("a ") + type_name(v.type()) + " value"; }
+
+// Restores the host-visible stack top when a host call returns or throws.
+struct TopGuard {
+    Value*& top;
+    Value* saved;
+    ~TopGuard() { top = saved; }
+};
+
+// A zeroed Value is nil, so the stack can be fresh pages from the OS,
+// which are zero and only touched as deep as scripts call. Writing all
+// 4 MB up front was most of the cost of creating a VM, which batch runs
+// do per file. (calloc would not do: once glibc has freed one such block
+// it serves the next from the heap and clears it by hand.)
+static_assert(static_cast<int>(ValueType::Nil) == 0, "a zeroed Value must be nil");
+static_assert(std::is_trivially_copyable_v<Value> && std::is_trivially_destructible_v<Value>,
+              "the stack is not constructed");
+
+Value* allocate_stack(std::size_t size) {
+#ifdef _WIN32
+    void* stack = std::calloc(size, sizeof(Value));
+    if (!stack) throw std::bad_alloc();
+#else
+    void* stack = mmap(nullptr, size * sizeof(Value), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) throw std::bad_alloc();
+#endif
+    return static_cast<Value*>(stack);
+}
+
+}  // namespace
+
+VM::VM() : VM(Heap::Config()) {}
+
+VM::VM(const Heap::Config& heap_config)
+    : heap_(heap_config),
+      stack_(allocate_stack(kStackSize)),
+      top_(stack_.get()),
+      stack_high_(stack_.get())
+#ifdef REBEL_SCRIPT_JIT
+      ,
+      jit_(*this)
+#endif
+{
+    frames_.reserve(kMaxFrames);
+    heap_.set_root_scanner([this](Heap& heap) { scan_roots(heap); });
+    print_ = [](std::string_view line) {
+        std::fwrite(line.data(), 1, line.size(), stdout);
+        std::fputc('\n', stdout);
+    };
+    task_error_ = [](const RuntimeError& error) { std::fprintf(stderr, "task failed: %s\n", error.what()); };
+    open_builtins(*this);
+}
+
+VM::~VM() = default;
+
+void VM::FreeStack::operator()(Value* stack) const noexcept {
+#ifdef _WIN32
+    std::free(stack);
+#else
+    munmap(stack, kStackSize * sizeof(Value));
+#endif
+}
+
+Function* VM::compile(std::string_view source, std::string chunk) {
+    Function* fn = script::compile(*this, source, std::move(chunk));
+    chunks_.push_back(fn);
+    if (debugger_) debugger_->loaded(*fn);
+    return fn;
+}
+
+Function* VM::compile(const ast::FunctionDecl& decl, std::string chunk) {
+    Function* fn = script::compile(*this, decl, std::move(chunk));
+    chunks_.push_back(fn);
+    if (debugger_) debugger_->loaded(*fn);
+    return fn;
+}
+
+Value VM::run(std::string_view source, std::string chunk) {
+    REBEL_TRACE_SCOPE("script.run");
+    return call(Value::object(compile(source, std::move(chunk))));
+}
+
+Value* VM::push_call(const Value& callee, const Value* args, int count) {
+    Value* slot = top_;
+    if (slot + 1 + count > stack_.get() + kStackSize) runtime_error("stack overflow");
+    slot[0] = callee;
+    for (int i = 0; i < count; ++i) slot[1 + i] = args[i];
+    top_ = slot + 1 + count;
+    if (top_ > stack_high_) stack_high_ = top_;
+    return slot;
+}
+
+Value VM::call(const Value& callee, const Value* args, int count) {
+    if (callee.is_function() && callee.as_function()->is_async) return spawn(callee.as_function(), args, count);
+    TopGuard guard{top_, top_};
+    Value* slot = push_call(callee, args, count);
+
+    if (callee.is_native()) {
+        NativeFunction* native = callee.as_native();
+        return call_native(native, slot + 1, count);
+    }
+    if (!callee.is_function()) runtime_error("attempt to call " + describe(callee));
+    const std::size_t depth = frames_.size();
+    push_frame(callee.as_function(), slot + 1, count);
+    if (depth == 0 && profiler_) {
+        const Profiler::Running running(*profiler_);
+        return execute(depth);
+    }
+    return execute(depth);
+}
+
+std::optional<Value> VM::start(const Value& callee, const Value* args, int count) {
+    if (!frames_.empty()) throw std::logic_error("VM::start() while a call is running or suspended");
+    if (!callee.is_function()) return call(callee, args, count);
+    Value* slot = push_call(callee, args, count);
+    try {
+        push_frame(callee.as_function(), slot + 1, count);
+    } catch (...) {
+        top_ = slot;
+        throw;
+    }
+    return run_resumable();
+}
+
+std::optional<Value> VM::resume() {
+    if (!suspended_ || frames_.size() != suspended_frames_) {
+        throw std::logic_error("VM::resume() without a suspended call, or from within a call");
+    }
+    suspended_ = false;
+    return run_resumable();
+}
+
+std::optional<Value> VM::run_resumable() {
+    // Where the stack top goes back to once the call is over: the callee's
+    // slot, just below its frame.
+    Value* const slot = frames_.front().base - 1;
+    struct Resumable {
+        bool& flag;
+        ~Resumable() { flag = false; }
+    } resumable{resumable_};
+    resumable_ = true;
+    Value result;
+    try {
+        if (profiler_) {
+            const Profiler::Running running(*profiler_);
+            result = execute(0);
+        } else {
+            result = execute(0);
+        }
+    } catch (...) {
+        top_ = slot;
+        throw;
+    }
+    if (suspended_) {
+        suspended_frames_ = frames_.size();
+        return std::nullopt;  // the top stays above the suspended frames
+    }
+    top_ = slot;
+    return result;
+}
+
+void VM::cancel() noexcept {
+    if (!suspended_) return;
+    top_ = frames_.front().base - 1;
+    frames_.clear();
+    suspended_ = false;
+}
+
+void VM::push_frame(Function* fn, Value* base, int argc) {
+    if (frames_.size() >= kMaxFrames || base + fn->registers > stack_.get() + kStackSize) {
+        runtime_error("stack overflow");
+    }
+    for (int i = argc; i < fn->params; ++i) base[i] = Value();
+    frames_.push_back({fn, fn->code.data(), base});
+    top_ = base + fn->registers;
+    if (top_ > stack_high_) stack_high_ = top_;
+}
+
+void VM::scan_roots(Heap& heap) {
+    for (Value* v = stack_.get(); v < top_; ++v) heap.visit(*v);
+    // Whatever lies above the top is dead; clear it so a register that is
+    // later reused within a frame never refers to a moved or freed object.
+    for (Value* v = top_; v < stack_high_; ++v) *v = Value();
+    stack_high_ = top_;
+    for (Frame& frame : frames_) heap.visit(frame.fn);
+    for (Value& v : globals_) heap.visit(v);
+    for (Function*& fn : chunks_) heap.visit(fn);
+    for (Value& v : handles_) heap.visit(v);
+    for (auto& [text, s] : interned_) heap.visit(s);
+    for (Value& v : ready_) heap.visit(v);
+    for (Value& v : unobserved_) heap.visit(v);
+}
+
+bool VM::safepoint(std::size_t entry_depth) {
+    bool suspend = false;
+    if (heap_.take_interrupt()) {
+        if (profiler_) profiler_->sample();
+        // A request that cannot be met here stays; dispatch() interrupts
+        // again as it returns, so the activation below gets to look at it.
+        // One made meanwhile wins the exchange and is seen next time.
+        Preempt what = preempt_.load(std::memory_order_relaxed);
+        if (what == Preempt::Abort && preempt_.compare_exchange_strong(what, Preempt::None)) {
+            const Frame& frame = frames_.back();
+            throw AbortError("aborted by the host", frame.fn->chunk ? *frame.fn->chunk : std::string(),
+                             current_line(frame));
+        }
+        suspend = what == Preempt::Suspend && resumable_ && entry_depth == 0 &&
+                  preempt_.compare_exchange_strong(what, Preempt::None);
+    }
+    if (heap_.collection_requested()) heap_.collect();
+    if (suspend) suspended_ = true;
+    return suspend;
+}
+
+void VM::collect_garbage(bool major) {
+    if (major) {
+        heap_.collect_major();
+    } else {
+        heap_.collect();
+    }
+}
+
+Value VM::spawn(Function* fn, const Value* args, int count) {
+    Task* task = heap_.make_task(Task::Kind::Coroutine);
+    task->fn = fn;
+    task->registers.resize(fn->registers);
+    std::copy(args, args + std::min(count, static_cast<int>(fn->params)), task->registers.begin());
+    const Value value = Value::object(task);
+    ready_.push_back(value);
+    return value;
+}
+
+void VM::resume_task(Value value) {
+    Task* task = value.as_task();
+    auto fail = [this](Task* failed, const RuntimeError& error) {
+        failed->state = Task::State::Failed;
+        failed->error = std::make_unique<RuntimeError>(error);
+        settle(failed);
+    };
+    Function* fn = task->fn;
+    // The frame goes back on top of the stack, with the task in the
+    // callee slot below it, where collections keep it up to date.
+    Value* const slot = top_;
+    if (frames_.size() >= kMaxFrames || slot + 1 + fn->registers > stack_.get() + kStackSize) {
+        fail(task, RuntimeError("stack overflow"));
+        return;
+    }
+    TopGuard guard{top_, slot};
+    slot[0] = value;
+    std::copy(task->registers.begin(), task->registers.end(), slot + 1);
+    task->registers.clear();
+    const std::size_t depth = frames_.size();
+    frames_.push_back({fn, fn->code.data() + task->pc, slot + 1});
+    top_ = slot + 1 + fn->registers;
+    if (top_ > stack_high_) stack_high_ = top_;
+    Value result;
+    try {
+        result = execute(depth);
+    } catch (const AbortError& error) {
+        fail(slot[0].as_task(), error);
+        throw;
+    } catch (const RuntimeError& error) {
+        fail(slot[0].as_task(), error);
+        return;
+    }
+    task = slot[0].as_task();
+    if (parked_) {
+        parked_ = false;
+        return;
+    }
+    task->state = Task::State::Done;
+    task->result = result;
+    heap_.barrier(task, result);
+    settle(task);
+}
+
+void VM::park(Task* task, Task* awaited) {
+    const Frame& frame = frames_.back();
+    // Back to the Await on resumption, which then finds `awaited` settled.
+    task->pc = static_cast<std::uint32_t>(frame.pc - 1 - frame.fn->code.data());
+    task->registers.assign(frame.base, frame.base + frame.fn->registers);
+    for (const Value& v : task->registers) heap_.barrier(task, v);
+    const Value waiter = Value::object(task);
+    awaited->waiters.push_back({waiter, 0});
+    heap_.barrier(awaited, waiter);
+    frames_.pop_back();
+    parked_ = true;
+}
+
+void VM::settle(Task* task) {
+    const std::vector<Task::Waiter> waiters = std::move(task->waiters);
+    task->waiters = {};
+    task->registers = {};
+    const bool failed = task->state == Task::State::Failed;
+    if (failed && waiters.empty() && !task->observed) unobserved_.push_back(Value::object(task));
+    for (const Task::Waiter& w : waiters) {
+        Task* waiter = w.task.as_task();
+        if (waiter->kind == Task::Kind::Coroutine) {
+            ready_.push_back(w.task);  // its Await sees the outcome
+            continue;
+        }
+        task->observed = true;
+        if (waiter->state != Task::State::Pending) continue;  // an All that failed already
+        if (failed) {
+            waiter->state = Task::State::Failed;
+            waiter->error = std::make_unique<RuntimeError>(*task->error);
+            waiter->result = Value();
+            settle(waiter);
+            continue;
+        }
+        table_set(waiter->result.as_table(), Value::number(w.index), task->result);
+        if (--waiter->remaining == 0) {
+            waiter->state = Task::State::Done;
+            settle(waiter);
+        }
+    }
+}
+
+std::size_t VM::run_tasks() {
+    REBEL_TRACE_SCOPE("script.tasks");
+    std::size_t runs = 0;
+    auto drain = [&] {
+        while (!ready_.empty()) {
+            const Value task = ready_.front();
+            ready_.pop_front();
+            ++runs;
+            resume_task(task);
+        }
+    };
+    if (frames_.empty() && profiler_) {
+        const Profiler::Running running(*profiler_);
+        drain();
+    } else {
+        drain();
+    }
+
+    // Failures still unobserved now have nothing left that could look.
+    std::vector<RuntimeError> errors;
+    for (const Value& v : unobserved_) {
+        Task* task = v.as_task();
+        if (task->observed) continue;
+        task->observed = true;
+        errors.push_back(*task->error);
+    }
+    unobserved_.clear();
+    if (task_error_) {
+        for (const RuntimeError& error : errors) task_error_(error);
+    }
+    return runs;
+}
+
+namespace {
+
+Task* pending_host_task(const Value& value, const char* caller) {
+    if (!value.is_task() || value.as_task()->kind != Task::Kind::Host ||
+        value.as_task()->state != Task::State::Pending) {
+        throw std::logic_error(std::string(caller) + " needs a pending task from VM::new_task()");
+    }
+    return value.as_task();
+}
+
+}  // namespace
+
+Value VM::new_task() { return Value::object(heap_.make_task(Task::Kind::Host)); }
+
+void VM::resolve(const Value& value, const Value& result) {
+    Task* task = pending_host_task(value, "VM::resolve()");
+    task->state = Task::State::Done;
+    task->result = result;
+    heap_.barrier(task, result);
+    settle(task);
+}
+
+void VM::reject(const Value& value, std::string message) {
+    Task* task = pending_host_task(value, "VM::reject()");
+    task->state = Task::State::Failed;
+    task->error = std::make_unique<RuntimeError>(std::move(message));
+    settle(task);
+}
+
+Value VM::all(const Value* tasks, std::size_t count) {
+    Task* all = heap_.make_task(Task::Kind::All);
+    const Value value = Value::object(all);
+    all->result = Value::object(heap_.make_table(count, 0));
+    for (std::size_t i = 0; i < count; ++i) {
+        const Value& v = tasks[i];
+        const Value index = Value::number(static_cast<double>(i));
+        if (!v.is_task()) {
+            table_set(all->result.as_table(), index, v);
+            continue;
+        }
+        Task* task = v.as_task();
+        if (task->state == Task::State::Done) {
+            task->observed = true;
+            table_set(all->result.as_table(), index, task->result);
+        } else if (task->state == Task::State::Failed) {
+            task->observed = true;
+            all->state = Task::State::Failed;
+            all->error = std::make_unique<RuntimeError>(*task->error);
+            all->result = Value();
+            unobserved_.push_back(value);
+            return value;
+        } else {
+            task->waiters.push_back({value, static_cast<std::uint32_t>(i)});
+            heap_.barrier(task, value);
+            ++all->remaining;
+        }
+    }
+    if (all->remaining == 0) all->state = Task::State::Done;
+    return value;
+}
+
+void VM::set_task_error_handler(std::function<void(const RuntimeError&)> handler) {
+    task_error_ = std::move(handler);
+}
+
+VM::Handle::Handle(VM& vm, const Value& value) : vm_(&vm) {
+    if (!vm.free_handles_.empty()) {
+        slot_ = vm.free_handles_.back();
+        vm.free_handles_.pop_back();
+        vm.handles_[slot_] = value;
+    } else {
+        slot_ = vm.handles_.size();
+        vm.handles_.push_back(value);
+    }
+}
+
+VM::Handle::~Handle() {
+    if (!vm_) return;
+    vm_->handles_[slot_] = Value();
+    vm_->free_handles_.push_back(slot_);
+}
+
+VM::Handle::Handle(Handle&& other) noexcept : vm_(other.vm_), slot_(other.slot_) { other.vm_ = nullptr; }
+
+VM::Handle& VM::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        this->~Handle();
+        vm_ = other.vm_;
+        slot_ = other.slot_;
+        other.vm_ = nullptr;
+    }
+    return *this;
+}
+
+Value VM::global(std::string_view name) const {
+    auto it = global_index_.find(std::string(name));
+    return it == global_index_.end() ? Value() : globals_[it->second];
+}
+
+void VM::set_global(std::string_view name, const Value& value) {
+    const std::uint32_t slot = global_slot(name);
+    globals_[slot] = value;
+    defined_[slot] = 1;
+}
+
+std::uint32_t VM::global_slot(std::string_view name) {
+    auto [it, inserted] = global_index_.try_emplace(std::string(name), static_cast<std::uint32_t>(globals_.size()));
+    if (inserted) {
+        globals_.emplace_back();
+        defined_.push_back(0);
+        global_names_.emplace_back(name);
+    }
+    return it->second;
+}
+
+String* VM::intern(std::string_view text) {
+    auto [it, inserted] = interned_.try_emplace(std::string(text), nullptr);
+    if (inserted) it->second = heap_.make_string(text);
+    return it->second;
+}
+
+void VM::define_native(std::string_view name, NativeFn fn, void* userdata, bool recorded) {
+    NativeFunction* native = heap_.make_native(std::string(name), fn, userdata);
+    native->recorded = recorded;
+    set_global(name, Value::object(native));
+}
+
+Value VM::call_recorded(NativeFunction& native, const NativeArgs& args) { return recorder_->call(native, args); }
+
+void VM::copy_on_write(Table* table) {
+    if (recorder_) recorder_->copy_on_write(table);
+    table->epoch = heap_.epoch();
+}
+
+void VM::set_print_handler(std::function<void(std::string_view)> handler) { print_ = std::move(handler); }
+
+void VM::print(std::string_view line) const {
+    if (print_) print_(line);
+}
+
+std::string VM::to_display_string(const Value& value) const {
+    char buffer[64];
+    switch (value.type()) {
+        case ValueType::Nil: return "nil";
+        case ValueType::Bool: return value.as_bool() ? "true" : "false";
+        case ValueType::Number: return number_to_string(value.as_number());
+        case ValueType::String: return std::string(value.as_string()->view());
+        case ValueType::Table:
+            std::snprintf(buffer, sizeof buffer, "table: %p", static_cast<void*>(value.as_object()));
+            return buffer;
+        case ValueType::Function: return "function: " + value.as_function()->name;
+        case ValueType::Native: return "native: " + value.as_native()->name;
+        case ValueType::Task:
+            std::snprintf(buffer, sizeof buffer, "task: %p", static_cast<void*>(value.as_object()));
+            return buffer;
+    }
+    return "?";
+}
+
+void VM::runtime_error(const std::string& message) { throw RuntimeError(message); }
+
+std::uint32_t VM::current_line(const Frame& frame) const {
+    const auto pc = static_cast<std::size_t>(frame.pc - frame.fn->code.data());
+    return frame.fn->line_at(pc > 0 ? pc - 1 : 0);
+}
+
+std::vector<std::string> VM::traceback(std::size_t entry_depth) const {
+    // Deep recursion keeps the innermost and outermost frames only.
+    constexpr std::size_t kEnds = 10;
+    std::vector<std::string> lines;
+    const std::size_t count = frames_.size() - entry_depth;
+    for (std::size_t i = frames_.size(); i-- > entry_depth;) {
+        const std::size_t from_top = frames_.size() - 1 - i;
+        if (count > 2 * kEnds + 1 && from_top >= kEnds && i >= entry_depth + kEnds) {
+            if (from_top == kEnds) lines.push_back("... " + std::to_string(count - 2 * kEnds) + " more frames");
+            continue;
+        }
+        const Frame& frame = frames_[i];
+        const Function* fn = frame.fn;
+        std::string line = (fn->chunk ? *fn->chunk : std::string("?")) + ":" + std::to_string(current_line(frame));
+        line += fn->name == "main" ? " in main chunk" : " in function '" + fn->name + "'";
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+Value VM::execute(std::size_t entry_depth) {
+    try {
+        return dispatch(entry_depth);
+    } catch (RuntimeError& error) {
+        std::vector<std::string> trace = traceback(entry_depth);
+        if (error.located()) {
+            // Raised by a nested host call; it already has the inner frames.
+            error.traceback_.insert(error.traceback_.end(), trace.begin(), trace.end());
+            frames_.resize(entry_depth);
+            throw;
+        }
+        const Frame& frame = frames_.back();
+        RuntimeError located(error.message(), frame.fn->chunk ? *frame.fn->chunk : std::string(),
+                             current_line(frame));
+        located.traceback_ = std::move(trace);
+        frames_.resize(entry_depth);
+        throw located;
+    } catch (...) {
+        frames_.resize(entry_depth);
+        throw;
+    }
+}
+
+Value VM::arith_slow(Op op, const Value& a, const Value& b) {
+    if (op == Op::Add && (a.is_string() || b.is_string())) return concat(a, b);
+    if (a.is_number() && b.is_number()) {
+        const double x = a.as_number();
+        const double y = b.as_number();
+        switch (op) {
+            case Op::Add: return Value::number(x + y);
+            case Op::Sub: return Value::number(x - y);
+            case Op::Mul: return Value::number(x * y);
+            case Op::Div: return Value::number(x / y);
+            default: return Value::number(floor_mod(x, y));
+        }
+    }
+    runtime_error("attempt to perform arithmetic on " + describe(a.is_number() ? b : a));
+}
+
+Value VM::concat(const Value& a, const Value& b) {
+    for (const Value* v : {&a, &b}) {
+        if (!v->is_string() && !v->is_number()) runtime_error("attempt to concatenate " + describe(*v));
+    }
+    std::string text = a.is_string() ? std::string(a.as_string()->view()) : number_to_string(a.as_number());
+    if (b.is_string()) {
+        text += b.as_string()->view();
+    } else {
+        text += number_to_string(b.as_number());
+    }
+    return new_string(text);
+}
+
+bool VM::less_slow(const Value& a, const Value& b, bool or_equal) {
+    if (a.is_number() && b.is_number()) {
+        return or_equal ? a.as_number() <= b.as_number() : a.as_number() < b.as_number();
+    }
+    if (a.is_string() && b.is_string()) {
+        const int c = a.as_string()->view().compare(b.as_string()->view());
+        return or_equal ? c <= 0 : c < 0;
+    }
+    runtime_error(std::string("attempt to compare ") + type_name(a.type()) + " with " + type_name(b.type()));
+}
+
+Value VM::index_slow(const Value& object, const Value& key) {
+    if (object.is_table()) return object.as_table()->get(key);
+    runtime_error("attempt to index " + describe(object));
+}
+
+void VM::set_index(const Value& object, const Value& key, const Value& value) {
+    if (!object.is_table()) runtime_error("attempt to index " + describe(object));
+    table_set(object.as_table(), key, value);
+}
+
+Value VM::length(const Value& value) {
+    if (value.is_string()) return Value::number(value.as_string()->length);
+    if (value.is_table()) return Value::number(static_cast<double>(value.as_table()->length()));
+    runtime_error("attempt to get length of " + describe(value));
+}
+
+#if REBEL_SCRIPT_COMPUTED_GOTO
+// Labels as values are a GNU extension.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+Value VM::dispatch(std::size_t entry_depth) {
+    // Identifies this invocation to the recorder, whose checkpoints only
+    // the invocation that took them can resume.
+    // A pending preempt() is passed on to the activation below, or to the
+    // next call.
+    struct Enter {
+        VM& vm;
+        Activation outer;
+        ~Enter() {
+            vm.activation_ = outer;
+            if (vm.preempt_.load(std::memory_order_relaxed) != Preempt::None) vm.heap_.interrupt();
+        }
+    } enter{*this, activation_};
+    activation_ = {++activations_, entry_depth};
+
+    Frame* frame = &frames_.back();
+    const Instruction* pc = frame->pc;
+    Value* base = frame->base;
+    const Value* k = frame->fn->constants.data();
+    Instruction i;
+
+#define RA base[arg_a(i)]
+#define RB base[arg_b(i)]
+#define RC base[arg_c(i)]
+#define KB k[arg_b(i)]
+#define KC k[arg_c(i)]
+// Frames only record their pc when something may throw or call out, which
+// is all error locations and tracebacks need.
+#define SAVE_PC() (frame->pc = pc)
+#define LOAD_FRAME()                         \
+    do {                                     \
+        frame = &frames_.back();             \
+        pc = frame->pc;                      \
+        base = frame->base;                  \
+        k = frame->fn->constants.data();     \
+    } while (0)
+// Comparisons are followed by a Jmp, taken when the outcome equals C.
+#define COND_JUMP(cond)                                  \
+    do {                                                 \
+        if ((cond) == (arg_c(i) != 0)) {                 \
+            pc += arg_sj(*pc) + 1;                       \
+        } else {                                         \
+            ++pc;                                        \
+        }                                                \
+    } while (0)
+// Collections move objects, so they only run where every live reference
+// is in a register, a global or a frame: calls and loop back-edges. The
+// same check serves interrupt() and preempt(); a suspended frame carries on
+// from `resume_pc`.
+#define SAFEPOINT(resume_pc)                   \
+    do {                                       \
+        if (heap_.safepoint_requested()) {     \
+            SAVE_PC();                         \
+            if (safepoint(entry_depth)) {      \
+                frame->pc = (resume_pc);       \
+                return Value();                \
+            }                                  \
+            LOAD_FRAME();                      \
+        }                                      \
+    } while (0)
+// Where control may pass to compiled code: frame entry, after a call
+// returns and at loop back-edges.
+#ifdef REBEL_SCRIPT_JIT
+#define TIER_UP()                                                                               \
+    do {                                                                                        \
+        if (jit_.enabled()) pc = jit_.enter(*frame->fn, base, pc, globals_.data(), defined_.data()); \
+    } while (0)
+#else
+#define TIER_UP() ((void)0)
+#endif
+#define ARITH(op, expr, rhs)                                    \
+    do {                                                        \
+        const Value& lhs_ = RB;                                 \
+        const Value& rhs_ = rhs;                                \
+        if (lhs_.is_number() && rhs_.is_number()) {             \
+            const double x = lhs_.as_number();                  \
+            const double y = rhs_.as_number();                  \
+            RA = Value::number(expr);                           \
+        } else {                                                \
+            SAVE_PC();                                          \
+            RA = arith_slow(op, lhs_, rhs_);                    \
+        }                                                       \
+    } while (0)
+
+#if REBEL_SCRIPT_COMPUTED_GOTO
+    static const void* const kLabels[] = {
+#define REBEL_OP_LABEL(name, format) &&op_##name,
+        REBEL_OPCODES(REBEL_OP_LABEL)
+#undef REBEL_OP_LABEL
+    };
+#define CASE(name) op_##name:
+#define NEXT()                           \
+    do {                                 \
+        i = *pc++;                       \
+        goto* kLabels[i & 0xff];         \
+    } while (0)
+#define REDISPATCH() goto* kLabels[i & 0xff]
+    TIER_UP();
+    NEXT();
+#else
+#define CASE(name) case Op::name:
+#define NEXT() continue
+#define REDISPATCH() goto redispatch
+    TIER_UP();
+    for (;;) {
+        i = *pc++;
+    redispatch:
+        switch (op_of(i)) {
+#endif
+
+    CASE(Move) {
+        RA = RB;
+        NEXT();
+    }
+    CASE(LoadK) {
+        RA = k[arg_bx(i)];
+        NEXT();
+    }
+    CASE(LoadI) {
+        RA = Value::number(arg_sbx(i));
+        NEXT();
+    }
+    CASE(LoadNil) {
+        RA = Value();
+        NEXT();
+    }
+    CASE(LoadTrue) {
+        RA = Value::boolean(true);
+        NEXT();
+    }
+    CASE(LoadFalse) {
+        RA = Value::boolean(false);
+        NEXT();
+    }
+    CASE(GetGlobal) {
+        const int slot = arg_bx(i);
+        const Value& g = globals_[static_cast<std::size_t>(slot)];
+        if (g.is_nil() && !defined_[static_cast<std::size_t>(slot)]) {
+            SAVE_PC();
+            runtime_error("undefined variable '" + global_names_[static_cast<std::size_t>(slot)] + "'");
+        }
+        RA = g;
+        NEXT();
+    }
+    CASE(SetGlobal) {
+        const auto slot = static_cast<std::size_t>(arg_bx(i));
+        globals_[slot] = RA;
+        defined_[slot] = 1;
+        NEXT();
+    }
+    CASE(NewTable) {
+        RA = Value::object(heap_.make_table(static_cast<std::size_t>(arg_b(i)), static_cast<std::size_t>(arg_c(i))));
+        NEXT();
+    }
+    CASE(SetList) {
+        Table* t = RA.as_table();
+        const Value* items = &RA + 1;
+        const int first = arg_c(i) * kSetListBatch;
+        for (int j = 0; j < arg_b(i); ++j) table_set(t, Value::number(first + j), items[j]);
+        NEXT();
+    }
+    CASE(GetTable) {
+        const Value& object = RB;
+        const Value& key = RC;
+        if (object.is_table()) {
+            Table* t = object.as_table();
+            if (key.is_number()) {
+                const double d = key.as_number();
+                const auto& array = t->array();
+                if (d >= 0 && d < static_cast<double>(array.size())) {
+                    const auto n = static_cast<std::size_t>(d);
+                    if (static_cast<double>(n) == d) {
+                        RA = array[n];
+                        NEXT();
+                    }
+                }
+            }
+            RA = t->get(key);
+        } else {
+            SAVE_PC();
+            RA = index_slow(object, key);
+        }
+        NEXT();
+    }
+    CASE(GetField) {
+        const Value& object = RB;
+        if (object.is_table()) {
+            RA = object.as_table()->get_field(KC.as_string());
+        } else {
+            SAVE_PC();
+            RA = index_slow(object, KC);
+        }
+        NEXT();
+    }
+    CASE(SetTable) {
+        const Value& object = RA;
+        const Value& key = RB;
+        const Value& value = RC;
+        if (object.is_table() && key.is_number() && !value.is_nil()) {
+            before_write(object.as_table());
+            auto& array = object.as_table()->array();
+            const double d = key.as_number();
+            if (d >= 0 && d < static_cast<double>(array.size())) {
+                const auto n = static_cast<std::size_t>(d);
+                if (static_cast<double>(n) == d) {
+                    array[n] = value;
+                    heap_.barrier(object.as_object(), value);
+                    NEXT();
+                }
+            }
+        }
+        SAVE_PC();
+        set_index(object, key, value);
+        NEXT();
+    }
+    CASE(SetField) {
+        const Value& object = RA;
+        if (object.is_table()) {
+            table_set(object.as_table(), KB, RC);
+        } else {
+            SAVE_PC();
+            set_index(object, KB, RC);
+        }
+        NEXT();
+    }
+    CASE(Add) {
+        ARITH(Op::Add, x + y, RC);
+        NEXT();
+    }
+    CASE(Sub) {
+        ARITH(Op::Sub, x - y, RC);
+        NEXT();
+    }
+    CASE(Mul) {
+        ARITH(Op::Mul, x * y, RC);
+        NEXT();
+    }
+    CASE(Div) {
+        ARITH(Op::Div, x / y, RC);
+        NEXT();
+    }
+    CASE(Mod) {
+        ARITH(Op::Mod, floor_mod(x, y), RC);
+        NEXT();
+    }
+    CASE(AddK) {
+        ARITH(Op::Add, x + y, KC);
+        NEXT();
+    }
+    CASE(SubK) {
+        ARITH(Op::Sub, x - y, KC);
+        NEXT();
+    }
+    CASE(MulK) {
+        ARITH(Op::Mul, x * y, KC);
+        NEXT();
+    }
+    CASE(DivK) {
+        ARITH(Op::Div, x / y, KC);
+        NEXT();
+    }
+    CASE(ModK) {
+        ARITH(Op::Mod, floor_mod(x, y), KC);
+        NEXT();
+    }
+    CASE(Unm) {
+        const Value& v = RB;
+        if (!v.is_number()) {
+            SAVE_PC();
+            runtime_error("attempt to negate " + describe(v));
+        }
+        RA = Value::number(-v.as_number());
+        NEXT();
+    }
+    CASE(Not) {
+        RA = Value::boolean(!RB.truthy());
+        NEXT();
+    }
+    CASE(Len) {
+        SAVE_PC();
+        RA = length(RB);
+        NEXT();
+    }
+    CASE(Eq) {
+        const Value& a = RA;
+        const Value& b = RB;
+        const bool eq = a.is_number() && b.is_number() ? a.as_number() == b.as_number() : values_equal(a, b);
+        COND_JUMP(eq);
+        NEXT();
+    }
+    CASE(Lt) {
+        const Value& a = RA;
+        const Value& b = RB;
+        bool lt;
+        if (a.is_number() && b.is_number()) {
+            lt = a.as_number() < b.as_number();
+        } else {
+            SAVE_PC();
+            lt = less_slow(a, b, false);
+        }
+        COND_JUMP(lt);
+        NEXT();
+    }
+    CASE(Le) {
+        const Value& a = RA;
+        const Value& b = RB;
+        bool le;
+        if (a.is_number() && b.is_number()) {
+            le = a.as_number() <= b.as_number();
+        } else {
+            SAVE_PC();
+            le = less_slow(a, b, true);
+        }
+        COND_JUMP(le);
+        NEXT();
+    }
+    CASE(EqK) {
+        COND_JUMP(values_equal(RA, KB));
+        NEXT();
+    }
+    CASE(LtK) {
+        const Value& a = RA;
+        bool r;
+        if (a.is_number()) {
+            r = a.as_number() < KB.as_number();
+        } else {
+            SAVE_PC();
+            r = less_slow(a, KB, false);
+        }
+        COND_JUMP(r);
+        NEXT();
+    }
+    CASE(LeK) {
+        const Value& a = RA;
+        bool r;
+        if (a.is_number()) {
+            r = a.as_number() <= KB.as_number();
+        } else {
+            SAVE_PC();
+            r = less_slow(a, KB, true);
+        }
+        COND_JUMP(r);
+        NEXT();
+    }
+    CASE(GtK) {
+        const Value& a = RA;
+        bool r;
+        if (a.is_number()) {
+            r = a.as_number() > KB.as_number();
+        } else {
+            SAVE_PC();
+            r = less_slow(KB, a, false);
+        }
+        COND_JUMP(r);
+        NEXT();
+    }
+    CASE(GeK) {
+        const Value& a = RA;
+        bool r;
+        if (a.is_number()) {
+            r = a.as_number() >= KB.as_number();
+        } else {
+            SAVE_PC();
+            r = less_slow(KB, a, true);
+        }
+        COND_JUMP(r);
+        NEXT();
+    }
+    CASE(Test) {
+        COND_JUMP(RA.truthy());
+        NEXT();
+    }
+    CASE(Jmp) {
+        const int offset = arg_sj(i);
+        pc += offset;
+        if (offset < 0) {
+            SAFEPOINT(pc);
+            TIER_UP();
+        }
+        NEXT();
+    }
+    CASE(ForPrep) {
+        Value* r = &RA;
+        if (!r[0].is_number() || !r[1].is_number() || !r[2].is_number()) {
+            SAVE_PC();
+            runtime_error("'for' range must be numbers");
+        }
+        const double step = r[2].as_number();
+        if (step == 0) {
+            SAVE_PC();
+            runtime_error("'for' step is zero");
+        }
+        const double index = r[0].as_number();
+        const double limit = r[1].as_number();
+        if (step > 0 ? index < limit : index > limit) {
+            r[3] = r[0];
+        } else {
+            pc += arg_sbx(i);
+        }
+        NEXT();
+    }
+    CASE(ForLoop) {
+        Value* r = &RA;
+        const double step = r[2].as_number();
+        const double index = r[0].as_number() + step;
+        const double limit = r[1].as_number();
+        if (step > 0 ? index < limit : index > limit) {
+            r[0] = Value::number(index);
+            r[3] = r[0];
+            pc += arg_sbx(i);
+            SAFEPOINT(pc);
+            TIER_UP();
+        }
+        NEXT();
+    }
+    CASE(TForPrep) {
+        Value* r = &RA;
+        if (!r[0].is_table()) {
+            SAVE_PC();
+            runtime_error("cannot iterate over " + describe(r[0]));
+        }
+        r[1] = Value::number(0);
+        pc += arg_sbx(i);
+        NEXT();
+    }
+    CASE(TForNext) {
+        Value* r = &RA;
+        auto cursor = static_cast<std::size_t>(r[1].as_number());
+        if (r[0].as_table()->next(cursor, r[2], r[3])) {
+            r[1] = Value::number(static_cast<double>(cursor));
+            pc += arg_sbx(i);
+            SAFEPOINT(pc);
+            TIER_UP();
+        }
+        NEXT();
+    }
+    CASE(Call) {
+        SAFEPOINT(pc - 1);  // the call itself is still to make
+        Value* callee = &RA;
+        const int argc = arg_b(i);
+        SAVE_PC();
+        if (callee->is_function()) {
+            if (callee->as_function()->is_async) {
+                *callee = spawn(callee->as_function(), callee + 1, argc);
+                NEXT();
+            }
+            push_frame(callee->as_function(), callee + 1, argc);
+            LOAD_FRAME();
+            TIER_UP();
+            NEXT();
+        }
+        if (callee->is_native()) {
+            NativeFunction* native = callee->as_native();
+            *callee = call_native(native, callee + 1, argc);
+            NEXT();
+        }
+        runtime_error("attempt to call " + describe(*callee));
+    }
+    CASE(Return) {
+        const Value result = arg_b(i) ? RA : Value();
+        frames_.pop_back();
+        if (frames_.size() == entry_depth) return result;
+        base[-1] = result;  // the caller's Call register
+        LOAD_FRAME();
+        top_ = base + frame->fn->registers;
+        TIER_UP();
+        NEXT();
+    }
+    CASE(Await) {
+        const Value& awaited = RB;
+        if (!awaited.is_task()) {
+            RA = awaited;
+            NEXT();
+        }
+        Task* task = awaited.as_task();
+        if (task->state == Task::State::Done) {
+            task->observed = true;
+            RA = task->result;
+            NEXT();
+        }
+        SAVE_PC();
+        if (task->state == Task::State::Failed) {
+            task->observed = true;
+            throw RuntimeError(*task->error);
+        }
+        // Only run_tasks() runs async functions, each at the bottom of a
+        // dispatch() of its own.
+        if (frames_.size() - 1 != entry_depth || !base[-1].is_task()) runtime_error("await outside a task");
+        park(base[-1].as_task(), task);
+        return Value();
+    }
+    CASE(Trap) {
+        // Only reached with a breakpoint set: report it, then run the
+        // instruction it replaced. The handler may call back into scripts.
+        SAVE_PC();
+        i = debugger_->trap(static_cast<std::uint32_t>(arg_bx(i)));
+        LOAD_FRAME();
+        REDISPATCH();
+    }
+
+#if !REBEL_SCRIPT_COMPUTED_GOTO
+            case Op::Count: break;
+        }
+        runtime_error("invalid opcode");
+    }
+#endif
+
+#undef RA
+#undef RB
+#undef RC
+#undef KB
+#undef KC
+#undef SAVE_PC
+#undef LOAD_FRAME
+#undef COND_JUMP
+#undef SAFEPOINT
+#undef TIER_UP
+#undef ARITH
+#undef CASE
+#undef NEXT
+#undef REDISPATCH
+}
+
+#if REBEL_SCRIPT_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
+
+}  // namespace rebel::script
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "script/error.h"
+#include "script/heap.h"
+#ifdef REBEL_SCRIPT_JIT
+#include "script/jit.h"
+#endif
+#include "script/object.h"
+#include "script/value.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::script {
+
+class Debugger;
+class Profiler;
+class Recorder;
+class RuntimeImage;
+class BytecodeCache;
+
+namespace serial {
+class ObjectWriter;
+}
+
+namespace ast {
+struct FunctionDecl;
+}
+
+/// One script interpreter: heap, globals and a value stack. Not
+/// thread-safe; use one VM per thread.
+///
+/// Bytecode runs on a register machine (see script/opcode.h). Script-to-
+/// script calls push a frame without recursing on the C++ stack; natives and
+/// host calls re-enter the interpreter, as do calls made from JIT-compiled
+/// code (see script/jit.h).
+///
+/// The garbage collector moves objects. It runs at safepoints (calls and
+/// loop back-edges) or when collect_garbage() is called, so a Value or
+/// object pointer held by host code is only valid until the next script
+/// call; keep longer-lived values in a Handle.
+class VM {
+public:
+    static constexpr std::size_t kStackSize = std::size_t{1} << 18;
+    static constexpr std::size_t kMaxFrames = 8192;
+
+    /// A GC root owned by the host, updated when its object moves.
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(VM& vm, const Value& value);
+        ~Handle();
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        Value get() const { return vm_ ? vm_->handles_[slot_] : Value(); }
+        void set(const Value& value) { vm_->handles_[slot_] = value; }
+
+    private:
+        VM* vm_ = nullptr;
+        std::size_t slot_ = 0;
+    };
+
+    VM();
+    explicit VM(const Heap::Config& heap_config);
+    ~VM();
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    /// Compiles `source` and runs it. Returns the chunk's return value.
+    Value run(std::string_view source, std::string chunk = "chunk");
+    /// Compiles without running. Compiled chunks stay alive as long as the VM.
+    Function* compile(std::string_view source, std::string chunk = "chunk");
+    /// Compiles a function built as an AST (see script/compiler.h).
+    Function* compile(const ast::FunctionDecl& decl, std::string chunk);
+
+    /// Calls a script or native function from the host.
+    Value call(const Value& callee, const Value* args = nullptr, int count = 0);
+    Value call(const Value& callee, const std::vector<Value>& args) {
+        return call(callee, args.data(), static_cast<int>(args.size()));
+    }
+
+    /// Calls `callee` like call(), but preempt(Preempt::Suspend) may stop
+    /// it part way: then it returns nullopt and leaves the call's frames on
+    /// the VM until resume() or cancel(). The host may make other calls
+    /// meanwhile. Throws std::logic_error unless made from the host with
+    /// no call running or suspended.
+    std::optional<Value> start(const Value& callee, const Value* args = nullptr, int count = 0);
+    /// Carries on with the suspended call, with the same outcomes as
+    /// start(). Throws std::logic_error if there is none, or from a call.
+    std::optional<Value> resume();
+    bool suspended() const noexcept { return suspended_; }
+    /// Drops the suspended call, if any.
+    void cancel() noexcept;
+
+    /// Async functions (`async fn`) run as tasks. Calling one, from a
+    /// script or the host, returns a Task and queues its body to run from
+    /// run_tasks(). A task runs until it returns, fails or reaches an
+    /// `await` of a pending task; then it keeps its one frame in the Task,
+    /// off the stack, and is queued again once that task settles. `await`
+    /// of a settled task, or of any other value, does not stop.
+    ///
+    /// Runs the queued tasks, and those they queue, until none is ready.
+    /// Returns how many runs there were. An AbortError from preempt() fails
+    /// the task it stopped and is rethrown; other errors fail their task.
+    /// Failures that no await, all() or host has looked at by the time the
+    /// queue is empty go to the task error handler.
+    std::size_t run_tasks();
+    bool tasks_ready() const noexcept { return !ready_.empty(); }
+
+    /// A pending task for an operation the host completes later, by
+    /// calling resolve() or reject() from the VM's thread.
+    Value new_task();
+    /// Throw std::logic_error unless `task` is a pending task from new_task().
+    void resolve(const Value& task, const Value& result);
+    void reject(const Value& task, std::string message);
+    /// A task that settles once all of `tasks` have: with a table of their
+    /// results in order, or with the first failure. Values that are not
+    /// tasks count as already done with themselves.
+    Value all(const Value* tasks, std::size_t count);
+    /// Receives failures of tasks nobody observed; see run_tasks().
+    /// Defaults to printing them to stderr.
+    void set_task_error_handler(std::function<void(const RuntimeError&)> handler);
+
+    /// nil if undefined.
+    Value global(std::string_view name) const;
+    void set_global(std::string_view name, const Value& value);
+    /// Slot of a global, created undefined on first use. Used by the compiler.
+    std::uint32_t global_slot(std::string_view name);
+
+    /// `recorded` marks a native whose result re-running the script would
+    /// not reproduce (time, input, host state): an attached Recorder logs
+    /// its results and replays them instead of calling it.
+    void define_native(std::string_view name, NativeFn fn, void* userdata = nullptr, bool recorded = false);
+
+    /// The VM's single copy of a string literal. The compiler interns its
+    /// string constants, so equal literals in different functions are one
+    /// object and field caches can compare keys by address. Interned
+    /// strings live as long as the VM.
+    String* intern(std::string_view text);
+
+    Value new_string(std::string_view bytes) { return Value::object(heap_.make_string(bytes)); }
+    Value new_table(std::size_t array_hint = 0, std::size_t hash_hint = 0) {
+        return Value::object(heap_.make_table(array_hint, hash_hint));
+    }
+
+    /// Table store with the generational write barrier; host code must
+    /// use this (or call heap().barrier()) rather than Table::set().
+    void table_set(Table* table, const Value& key, const Value& value) {
+        before_write(table);
+        table->set(key, value);
+        heap_.barrier(table, key);
+        heap_.barrier(table, value);
+    }
+
+    /// Must precede any other change to a table made outside table_set(),
+    /// so a checkpoint taken before can still restore it.
+    void before_write(Table* table) {
+        if (table->epoch != heap_.epoch()) copy_on_write(table);
+    }
+
+    Heap& heap() noexcept { return heap_; }
+#ifdef REBEL_SCRIPT_JIT
+    /// The baseline JIT tier; configure() it to change thresholds or turn
+    /// it off at run time.
+    Jit& jit() noexcept { return jit_; }
+#endif
+    /// The attached debugger, if any (see script/debugger.h).
+    Debugger* debugger() const noexcept { return debugger_; }
+    /// Collects now. Valid from natives and the host, provided they hold no
+    /// raw object pointers across the call.
+    void collect_garbage(bool major = false);
+    /// Makes the thread running scripts on this VM stop at its next
+    /// safepoint (a call or loop back-edge) for whatever is attached, such
+    /// as a Profiler taking a sample. Callable from any thread; costs the
+    /// interpreter nothing until it is called.
+    void interrupt() noexcept { heap_.interrupt(); }
+
+    /// What preempt() asks of the running script.
+    enum class Preempt : std::uint8_t {
+        None,     // withdraw a request not yet acted on
+        Suspend,  // return from start() or resume() at the next safepoint
+        Abort,    // throw AbortError at the next safepoint
+    };
+    /// Stops the running script at its next safepoint, from any thread;
+    /// the host's watchdog for time budgets. An abort unwinds every frame,
+    /// natives and host calls included. A suspension needs the script's
+    /// frames to be all its own: one made with call(), or running under a
+    /// native, keeps the request pending until it returns to start() or
+    /// resume()'s frames. A request stays until acted on or withdrawn, so
+    /// one arriving after the call returned applies to the next call.
+    void preempt(Preempt what) noexcept {
+        preempt_.store(what, std::memory_order_relaxed);
+        heap_.interrupt();
+    }
+
+    /// What `print` and `str` show for a value.
+    std::string to_display_string(const Value& value) const;
+
+    /// Receives the output of `print`, one call per line without the
+    /// newline. Defaults to stdout.
+    void set_print_handler(std::function<void(std::string_view)> handler);
+    void print(std::string_view line) const;
+
+private:
+#ifdef REBEL_SCRIPT_JIT
+    friend class Jit;  // compiled calls push frames and re-enter dispatch()
+#endif
+    friend class Debugger;  // walks loaded chunks and frames
+    friend class Recorder;  // saves and restores frames, registers and globals
+    friend class Profiler;  // samples frames at safepoints
+    friend class RuntimeImage;  // saves and restores globals, interned strings and chunks
+    friend class BytecodeCache;  // loads chunks
+    friend class serial::ObjectWriter;  // reads interned strings and global names
+
+    struct Frame {
+        Function* fn;
+        const Instruction* pc;  // next instruction; saved only when leaving the frame
+        Value* base;
+    };
+
+    /// A collection or interrupt() is pending; the top frame's pc is saved.
+    /// True if the dispatch() running frames above `entry_depth` should
+    /// suspend.
+    bool safepoint(std::size_t entry_depth);
+    Value* push_call(const Value& callee, const Value* args, int count);
+    std::optional<Value> run_resumable();
+    Value spawn(Function* fn, const Value* args, int count);
+    void resume_task(Value task);
+    /// The running coroutine `task`, at its top frame, waits for `awaited`.
+    void park(Task* task, Task* awaited);
+    /// Tells the waiters of `task`, which has just settled.
+    void settle(Task* task);
+    /// Runs frames above `entry_depth` until the one at `entry_depth`
+    /// returns. On error the frames are unwound and the error located.
+    Value execute(std::size_t entry_depth);
+    Value dispatch(std::size_t entry_depth);
+    /// One dispatch() invocation: frames from `depth` up belong to it.
+    struct Activation {
+        std::uint64_t id = 0;
+        std::size_t depth = 0;
+    };
+
+    Value call_native(NativeFunction* native, Value* args, int count) {
+        const NativeArgs native_args{args, count, native->userdata, &native->name};
+        if (native->recorded && recorder_) return call_recorded(*native, native_args);
+        return native->fn(*this, native_args);
+    }
+    Value call_recorded(NativeFunction& native, const NativeArgs& args);
+    void copy_on_write(Table* table);
+    void push_frame(Function* fn, Value* base, int argc);
+    void scan_roots(Heap& heap);
+
+    [[noreturn]] void runtime_error(const std::string& message);
+    std::uint32_t current_line(const Frame& frame) const;
+    std::vector<std::string> traceback(std::size_t entry_depth) const;
+
+    Value arith_slow(Op op, const Value& a, const Value& b);
+    bool less_slow(const Value& a, const Value& b, bool or_equal);
+    Value concat(const Value& a, const Value& b);
+    Value index_slow(const Value& object, const Value& key);
+    void set_index(const Value& object, const Value& key, const Value& value);
+    Value length(const Value& value);
+
+    struct FreeStack {
+        void operator()(Value* stack) const noexcept;
+    };
+
+    Heap heap_;
+    std::unique_ptr<Value[], FreeStack> stack_;  // zeroed lazily by the OS, see allocate_stack()
+    Value* top_;          // first slot not owned by a frame or host call
+    Value* stack_high_;   // highest top_ since the last collection
+    std::vector<Frame> frames_;
+
+    std::vector<Value> globals_;
+    std::vector<std::uint8_t> defined_;
+    std::vector<std::string> global_names_;
+    std::unordered_map<std::string, std::uint32_t> global_index_;
+    std::unordered_map<std::string, String*> interned_;
+
+    std::vector<Function*> chunks_;
+    std::vector<Value> handles_;
+    std::vector<std::size_t> free_handles_;
+    std::function<void(std::string_view)> print_;
+    Debugger* debugger_ = nullptr;
+    Recorder* recorder_ = nullptr;
+    Profiler* profiler_ = nullptr;
+    Activation activation_;
+    std::uint64_t activations_ = 0;
+    std::atomic<Preempt> preempt_{Preempt::None};
+    std::deque<Value> ready_;      // coroutines to resume
+    std::vector<Value> unobserved_;  // failed with no waiter
+    std::function<void(const RuntimeError&)> task_error_;
+    bool parked_ = false;     // the coroutine dispatch() returned from is waiting
+    bool resumable_ = false;  // running under start() or resume()
+    bool suspended_ = false;
+    std::size_t suspended_frames_ = 0;
+#ifdef REBEL_SCRIPT_JIT
+    Jit jit_;
+#endif
+};
+
+/// Installs print, len, str, num, type, push, pop, join, sub, find, sqrt,
+/// floor, abs, min, max, clock, error, all, gc_collect and gc_stats. Called
+/// by the VM's constructor.
+void open_builtins(VM& vm);
+
+}  // namespace rebel::script
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rebel::script::x64 {
+
+/// General-purpose registers, numbered as in the instruction encoding.
+enum Reg : std::uint8_t { rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15 };
+
+/// SSE registers; only the low double is used.
+enum Xmm : std::uint8_t { xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7 };
+
+/// Condition codes for jcc/setcc.
+enum class Cond : std::uint8_t {
+    Below = 0x2,        // CF=1
+    AboveEqual = 0x3,   // CF=0
+    Equal = 0x4,        // ZF=1
+    NotEqual = 0x5,     // ZF=0
+    BelowEqual = 0x6,   // CF=1 or ZF=1
+    Above = 0x7,        // CF=0 and ZF=0
+    Parity = 0xa,       // PF=1: unordered after ucomisd
+    NoParity = 0xb,
+};
+
+inline Cond negate(Cond c) { return static_cast<Cond>(static_cast<std::uint8_t>(c) ^ 1); }
+
+/// A branch target inside one Assembler, possibly bound after use.
+struct Label {
+    int id = -1;
+};
+
+/// Minimal x86-64 encoder for the baseline JIT: only the forms it emits.
+/// Memory operands are always [base + disp]. Output is position
+/// independent apart from absolute addresses the caller embeds.
+class Assembler {
+public:
+    Label new_label() {
+        labels_.push_back(-1);
+        return Label{static_cast<int>(labels_.size()) - 1};
+    }
+    void bind(Label label) { labels_[static_cast<std::size_t>(label.id)] = static_cast<int>(code_.size()); }
+    bool bound(Label label) const { return labels_[static_cast<std::size_t>(label.id)] >= 0; }
+
+    std::size_t size() const noexcept { return code_.size(); }
+
+    /// Resolves branches. Every used label must be bound.
+    const std::vector<std::uint8_t>& finish() {
+        for (const Fixup& f : fixups_) {
+            const int target = labels_[static_cast<std::size_t>(f.label)];
+            const std::int32_t rel = target - (f.at + 4);
+            std::memcpy(&code_[static_cast<std::size_t>(f.at)], &rel, 4);
+        }
+        fixups_.clear();
+        return code_;
+    }
+
+    void push(Reg r) {
+        if (r >= 8) byte(0x41);
+        byte(static_cast<std::uint8_t>(0x50 + (r & 7)));
+    }
+    void pop(Reg r) {
+        if (r >= 8) byte(0x41);
+        byte(static_cast<std::uint8_t>(0x58 + (r & 7)));
+    }
+    void ret() { byte(0xc3); }
+
+    void mov(Reg dst, Reg src) {  // mov dst, src (64-bit)
+        rex(true, src, dst);
+        byte(0x89);
+        modrm_reg(src, dst);
+    }
+    void mov_imm64(Reg dst, std::uint64_t imm) {
+        rex(true, 0, dst);
+        byte(static_cast<std::uint8_t>(0xb8 + (dst & 7)));
+        bytes(&imm, 8);
+    }
+    void mov_imm32(Reg dst, std::uint32_t imm) {  // zero-extends
+        if (dst >= 8) byte(0x41);
+        byte(static_cast<std::uint8_t>(0xb8 + (dst & 7)));
+        bytes(&imm, 4);
+    }
+    void load64(Reg dst, Reg base, std::int32_t disp) {
+        rex(true, dst, base);
+        byte(0x8b);
+        mem(dst, base, disp);
+    }
+    void load32(Reg dst, Reg base, std::int32_t disp) {  // zero-extends
+        rex(false, dst, base);
+        byte(0x8b);
+        mem(dst, base, disp);
+    }
+    void store64(Reg base, std::int32_t disp, Reg src) {
+        rex(true, src, base);
+        byte(0x89);
+        mem(src, base, disp);
+    }
+    void lea(Reg dst, Reg base, std::int32_t disp) {
+        rex(true, dst, base);
+        byte(0x8d);
+        mem(dst, base, disp);
+    }
+    void store8_imm(Reg base, std::int32_t disp, std::uint8_t imm) {  // mov byte [base+disp], imm
+        rex(false, 0, base);
+        byte(0xc6);
+        mem(0, base, disp);
+        byte(imm);
+    }
+    void store64_imm(Reg base, std::int32_t disp, std::int32_t imm) {  // mov qword [base+disp], simm32
+        rex(true, 0, base);
+        byte(0xc7);
+        mem(0, base, disp);
+        bytes(&imm, 4);
+    }
+    void cmp8_imm(Reg base, std::int32_t disp, std::uint8_t imm) {  // cmp byte [base+disp], imm
+        rex(false, 0, base);
+        byte(0x80);
+        mem(7, base, disp);
+        byte(imm);
+    }
+    void cmp32_imm(Reg r, std::int32_t imm) {  // cmp r32, simm32
+        rex(false, 0, r);
+        byte(0x81);
+        modrm_reg(7, r);
+        bytes(&imm, 4);
+    }
+    void cmp64(Reg a, Reg b) {  // cmp a, b
+        rex(true, b, a);
+        byte(0x39);
+        modrm_reg(b, a);
+    }
+    void cmp64(Reg a, Reg base, std::int32_t disp) {  // cmp a, [base+disp]
+        rex(true, a, base);
+        byte(0x3b);
+        mem(a, base, disp);
+    }
+    void add64(Reg dst, Reg src) {
+        rex(true, src, dst);
+        byte(0x01);
+        modrm_reg(src, dst);
+    }
+    void shl64(Reg r, std::uint8_t bits) {
+        rex(true, 0, r);
+        byte(0xc1);
+        modrm_reg(4, r);
+        byte(bits);
+    }
+    void xor32(Reg dst, Reg src) {
+        rex(false, src, dst);
+        byte(0x31);
+        modrm_reg(src, dst);
+    }
+    void xor64(Reg dst, Reg src) {
+        rex(true, src, dst);
+        byte(0x31);
+        modrm_reg(src, dst);
+    }
+    void btc64(Reg r, std::uint8_t bit) {  // complement one bit
+        rex(true, 0, r);
+        byte(0x0f);
+        byte(0xba);
+        modrm_reg(7, r);
+        byte(bit);
+    }
+    // Byte operations on al/cl/dl/bl only, which need no REX prefix.
+    void test8(Reg a, Reg b) {
+        byte(0x84);
+        modrm_reg(b, a);
+    }
+    void and8(Reg dst, Reg src) {
+        byte(0x20);
+        modrm_reg(src, dst);
+    }
+    void setcc(Cond c, Reg dst) {
+        byte(0x0f);
+        byte(static_cast<std::uint8_t>(0x90 + static_cast<std::uint8_t>(c)));
+        modrm_reg(0, dst);
+    }
+
+    // 16-byte copies of whole Values.
+    void movups_load(Xmm dst, Reg base, std::int32_t disp) { sse(0, 0x10, dst, base, disp); }
+    void movups_store(Reg base, std::int32_t disp, Xmm src) { sse(0, 0x11, src, base, disp); }
+
+    void movsd_load(Xmm dst, Reg base, std::int32_t disp) { sse(0xf2, 0x10, dst, base, disp); }
+    void movsd_store(Reg base, std::int32_t disp, Xmm src) { sse(0xf2, 0x11, src, base, disp); }
+    void addsd(Xmm dst, Reg base, std::int32_t disp) { sse(0xf2, 0x58, dst, base, disp); }
+    void mulsd(Xmm dst, Reg base, std::int32_t disp) { sse(0xf2, 0x59, dst, base, disp); }
+    void subsd(Xmm dst, Reg base, std::int32_t disp) { sse(0xf2, 0x5c, dst, base, disp); }
+    void divsd(Xmm dst, Reg base, std::int32_t disp) { sse(0xf2, 0x5e, dst, base, disp); }
+    void addsd(Xmm dst, Xmm src) { sse_rr(0xf2, 0x58, dst, src); }
+    void mulsd(Xmm dst, Xmm src) { sse_rr(0xf2, 0x59, dst, src); }
+    void subsd(Xmm dst, Xmm src) { sse_rr(0xf2, 0x5c, dst, src); }
+    void divsd(Xmm dst, Xmm src) { sse_rr(0xf2, 0x5e, dst, src); }
+    void ucomisd(Xmm a, Xmm b) { sse_rr(0x66, 0x2e, a, b); }
+    void ucomisd(Xmm a, Reg base, std::int32_t disp) { sse(0x66, 0x2e, a, base, disp); }
+    void xorpd(Xmm dst, Xmm src) { sse_rr(0x66, 0x57, dst, src); }
+    void movq(Xmm dst, Reg src) {  // movq xmm, r64
+        byte(0x66);
+        rex(true, dst, src);
+        byte(0x0f);
+        byte(0x6e);
+        modrm_reg(dst, src);
+    }
+
+    void call(Reg target) {
+        rex(false, 0, target);
+        byte(0xff);
+        modrm_reg(2, target);
+    }
+    void jmp(Reg target) {
+        rex(false, 0, target);
+        byte(0xff);
+        modrm_reg(4, target);
+    }
+    void jmp(Label target) {
+        byte(0xe9);
+        fixup(target);
+    }
+    void jcc(Cond c, Label target) {
+        byte(0x0f);
+        byte(static_cast<std::uint8_t>(0x80 + static_cast<std::uint8_t>(c)));
+        fixup(target);
+    }
+
+private:
+    struct Fixup {
+        int at;
+        int label;
+    };
+
+    void byte(std::uint8_t b) { code_.push_back(b); }
+    void bytes(const void* data, std::size_t n) {
+        const auto* p = static_cast<const std::uint8_t*>(data);
+        code_.insert(code_.end(), p, p + n);
+    }
+    // REX with W, R (extends ModRM.reg) and B (extends ModRM.rm); omitted
+    // when none is needed.
+    void rex(bool w, unsigned reg, unsigned rm) {
+        const std::uint8_t prefix =
+            static_cast<std::uint8_t>(0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0));
+        if (prefix != 0x40) byte(prefix);
+    }
+    void modrm_reg(unsigned reg, unsigned rm) { byte(static_cast<std::uint8_t>(0xc0 | ((reg & 7) << 3) | (rm & 7))); }
+    void mem(unsigned reg, unsigned base, std::int32_t disp) {
+        // mod=01 (disp8) or mod=10 (disp32); never mod=00, so rbp and r13
+        // need no special case. rsp and r12 as base require a SIB byte.
+        const bool small = disp >= -128 && disp <= 127;
+        byte(static_cast<std::uint8_t>((small ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == 4) byte(0x24);
+        if (small) {
+            byte(static_cast<std::uint8_t>(static_cast<std::int8_t>(disp)));
+        } else {
+            bytes(&disp, 4);
+        }
+    }
+    void sse(std::uint8_t prefix, std::uint8_t op, unsigned reg, Reg base, std::int32_t disp) {
+        if (prefix) byte(prefix);
+        rex(false, reg, base);
+        byte(0x0f);
+        byte(op);
+        mem(reg, base, disp);
+    }
+    void sse_rr(std::uint8_t prefix, std::uint8_t op, unsigned dst, unsigned src) {
+        if (prefix) byte(prefix);
+        rex(false, dst, src);
+        byte(0x0f);
+        byte(op);
+        modrm_reg(dst, src);
+    }
+    void fixup(Label target) {
+        fixups_.push_back({static_cast<int>(code_.size()), target.id});
+        bytes("\0\0\0\0", 4);
+    }
+
+    std::vector<std::uint8_t> code_;
+    std::vector<int> labels_;
+    std::vector<Fixup> fixups_;
+};
+
+}  // namespace rebel::script::x64
@@ -0,0 +1,122 @@
+#include "search/query.h"
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace rebel::search {
+namespace {
+
+bool is_word(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+}  // namespace
+
+Query::Query(std::string pattern, QueryOptions options) : pattern_(std::move(pattern)), options_(options) {
+    if (options_.regex) {
+        regex_ = std::make_unique<Regex>(pattern_, options_.ignore_case);
+        if (regex_->is_literal()) {
+            finder_ = LiteralFinder(regex_->required_literal(), options_.ignore_case);
+            regex_.reset();
+            return;
+        }
+        // One-byte literals are too common to be worth the extra pass.
+        prefilter_ = regex_->required_literal().size() >= 2;
+        if (prefilter_) finder_ = LiteralFinder(regex_->required_literal(), options_.ignore_case);
+    } else {
+        const std::size_t newline = pattern_.find('\n');
+        if (newline != std::string::npos) throw PatternError("patterns cannot match line breaks", newline);
+        finder_ = LiteralFinder(pattern_, options_.ignore_case);
+    }
+}
+
+std::optional<Match> Query::find_any(std::string_view text, std::size_t from) const {
+    if (!regex_) {
+        const std::size_t at = finder_.find(text, from);
+        if (at == npos) return std::nullopt;
+        return Match{at, finder_.needle().size()};
+    }
+    if (!prefilter_) return regex_->find(text, from);
+    // Every match contains the literal, so only lines with one can match.
+    for (std::size_t pos = from; pos <= text.size();) {
+        const std::size_t hit = finder_.find(text, pos);
+        if (hit == npos) return std::nullopt;
+        const std::size_t newline = rfind_byte(text, '\n', hit);
+        const std::size_t line = newline == npos ? 0 : newline + 1;
+        std::size_t end = find_byte(text, '\n', hit);
+        if (end == npos) end = text.size();
+        if (auto match = regex_->find(text.substr(0, end), std::max(from, line))) return match;
+        pos = end + 1;
+    }
+    return std::nullopt;
+}
+
+std::optional<Match> Query::find(std::string_view text, std::size_t from) const {
+    for (;;) {
+        auto match = find_any(text, from);
+        if (!match || !options_.whole_word) return match;
+        const std::size_t end = match->offset + match->length;
+        const bool starts = match->offset == 0 || !is_word(text[match->offset - 1]);
+        const bool ends = end == text.size() || !is_word(text[end]);
+        if (starts && ends) return match;
+        from = match->offset + 1;
+    }
+}
+
+std::size_t for_each_match(const text::Rope& rope, const Query& query, const std::function<bool(const Match&)>& fn) {
+    std::size_t count = 0;
+    // Searches whole lines starting at rope offset `base`. An empty match
+    // at the very end belongs to the next line, unless there is none.
+    auto scan = [&](std::string_view lines, std::size_t base, bool last) {
+        for (std::size_t from = 0; from <= lines.size();) {
+            const auto match = query.find(lines, from);
+            if (!match || (match->offset == lines.size() && !last && !lines.empty())) break;
+            ++count;
+            if (!fn(Match{base + match->offset, match->length})) return false;
+            from = match->offset + std::max<std::size_t>(match->length, 1);
+        }
+        return true;
+    };
+
+    // Leaves rarely end on a newline, so the line that straddles two of
+    // them is copied and searched on its own.
+    std::string carry;
+    std::size_t carry_base = 0;
+    std::size_t base = 0;
+    const bool finished = rope.for_each_chunk(0, rope.size(), [&](std::string_view chunk) {
+        const std::size_t chunk_base = base;
+        base += chunk.size();
+        const std::size_t first = find_byte(chunk, '\n');
+        if (first == npos) {
+            if (carry.empty()) carry_base = chunk_base;
+            carry.append(chunk);
+            return true;
+        }
+        std::size_t start = 0;
+        if (!carry.empty()) {
+            carry.append(chunk.substr(0, first + 1));
+            if (!scan(carry, carry_base, false)) return false;
+            carry.clear();
+            start = first + 1;
+        }
+        const std::size_t end = rfind_byte(chunk, '\n', chunk.size()) + 1;
+        if (end > start && !scan(chunk.substr(start, end - start), chunk_base + start, false)) return false;
+        carry_base = chunk_base + end;
+        carry.assign(chunk.substr(end));
+        return true;
+    });
+    if (finished) scan(carry, carry.empty() ? rope.size() : carry_base, true);
+    return count;
+}
+
+std::size_t replace_all(text::Rope& rope, const Query& query, std::string_view replacement) {
+    std::vector<Match> matches;
+    for_each_match(rope, query, [&](const Match& match) {
+        matches.push_back(match);
+        return true;
+    });
+    // Back to front, so earlier offsets stay valid.
+    for (auto it = matches.rbegin(); it != matches.rend(); ++it) rope.replace(it->offset, it->length, replacement);
+    return matches.size();
+}
+
+}  // namespace rebel::search
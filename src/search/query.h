@@ -0,0 +1,61 @@
+#pragma once
+
+#include "search/regex.h"
+#include "search/scan.h"
+#include "text/rope.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace rebel::search {
+
+struct QueryOptions {
+    bool regex = false;
+    bool ignore_case = false;  // ASCII letters only
+    bool whole_word = false;   // matches must not touch a letter, digit or '_'
+};
+
+/// A compiled find query, shared read-only by every thread that searches
+/// with it.
+///
+/// Plain queries, and regexes that are only a literal, run the
+/// LiteralFinder directly. Other regex queries first look for their
+/// required literal, if they have one, and run the Regex only on the lines
+/// containing it, so most of the text is skipped at vector speed.
+/// Like the Regex, queries are line based: no match contains a newline.
+class Query {
+public:
+    /// Throws PatternError for an invalid regex or a plain pattern with a
+    /// newline in it.
+    explicit Query(std::string pattern, QueryOptions options = {});
+
+    const std::string& pattern() const noexcept { return pattern_; }
+    const QueryOptions& options() const noexcept { return options_; }
+
+    /// First match starting at or after `from`.
+    std::optional<Match> find(std::string_view text, std::size_t from = 0) const;
+
+private:
+    std::optional<Match> find_any(std::string_view text, std::size_t from) const;
+
+    std::string pattern_;
+    QueryOptions options_;
+    LiteralFinder finder_;  // the literal, or the regex's required literal
+    bool prefilter_ = false;
+    std::unique_ptr<Regex> regex_;
+};
+
+/// Calls `fn` with each match in `rope` in order, until it returns false.
+/// Matches do not overlap; an empty match moves the next search on by one
+/// byte. Returns the number of matches reported.
+std::size_t for_each_match(const text::Rope& rope, const Query& query, const std::function<bool(const Match&)>& fn);
+
+/// Replaces every match with `replacement`, taken literally. Returns the
+/// number of replacements.
+std::size_t replace_all(text::Rope& rope, const Query& query, std::string_view replacement);
+
+}  // namespace rebel::search
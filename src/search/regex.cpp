@@ -0,0 +1,895 @@
+#include "search/regex.h"
+
+#include "search/scan.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::search {
+namespace {
+
+using ByteSet = std::bitset<256>;
+
+// Instructions a pattern may compile to; compiling `{m,n}` copies its
+// operand, so this bounds what `(...){1000}` can cost.
+constexpr std::size_t kMaxInstructions = 20000;
+constexpr int kMaxRepeat = 1000;
+
+bool is_word(unsigned char c) { return std::isalnum(c) || c == '_'; }
+
+ByteSet bytes_where(bool (*pred)(unsigned char)) {
+    ByteSet set;
+    for (unsigned c = 0; c < 128; ++c) set[c] = pred(static_cast<unsigned char>(c));
+    return set;
+}
+
+ByteSet ascii_complement(const ByteSet& set) {
+    ByteSet out;
+    for (unsigned c = 0; c < 128; ++c) out[c] = !set[c] && c != '\n';
+    return out;
+}
+
+void fold_case(ByteSet& set) {
+    for (unsigned c = 'a'; c <= 'z'; ++c) {
+        if (set[c] || set[c - 32]) set[c] = set[c - 32] = true;
+    }
+}
+
+struct Node {
+    enum class Kind : std::uint8_t { Empty, Literal, Set, Concat, Alternate, Repeat, LineStart, LineEnd };
+
+    Kind kind = Kind::Empty;
+    unsigned char byte = 0;  // Literal
+    ByteSet set;             // Set: single bytes, all ASCII
+    bool multibyte = false;  // Set: also any UTF-8 sequence of two to four bytes
+    int min = 0;             // Repeat; max < 0 is unbounded
+    int max = 0;
+    std::vector<Node> children;
+
+    static Node of(Kind kind) {
+        Node n;
+        n.kind = kind;
+        return n;
+    }
+};
+
+class Parser {
+public:
+    Parser(std::string_view pattern, bool ignore_case) : p_(pattern), ignore_case_(ignore_case) {}
+
+    Node parse() {
+        Node root = alternation();
+        if (pos_ < p_.size()) fail("unmatched )");
+        return root;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& message) const { throw PatternError(message, pos_); }
+    [[noreturn]] void fail_at(const std::string& message, std::size_t at) const { throw PatternError(message, at); }
+
+    bool more() const { return pos_ < p_.size(); }
+    unsigned char peek() const { return static_cast<unsigned char>(p_[pos_]); }
+    bool eat(char c) {
+        if (!more() || p_[pos_] != c) return false;
+        ++pos_;
+        return true;
+    }
+
+    Node alternation() {
+        Node first = concatenation();
+        if (!more() || peek() != '|') return first;
+        Node alt = Node::of(Node::Kind::Alternate);
+        alt.children.push_back(std::move(first));
+        while (eat('|')) alt.children.push_back(concatenation());
+        return alt;
+    }
+
+    Node concatenation() {
+        Node cat = Node::of(Node::Kind::Concat);
+        while (more() && peek() != '|' && peek() != ')') {
+            Node item = repeat();
+            if (item.kind == Node::Kind::Concat) {
+                for (Node& child : item.children) cat.children.push_back(std::move(child));
+            } else if (item.kind != Node::Kind::Empty) {
+                cat.children.push_back(std::move(item));
+            }
+        }
+        if (cat.children.empty()) return Node::of(Node::Kind::Empty);
+        if (cat.children.size() == 1) return std::move(cat.children[0]);
+        return cat;
+    }
+
+    Node repeat() {
+        Node item = atom();
+        for (;;) {
+            const std::size_t at = pos_;
+            int min = 0;
+            int max = 0;
+            if (eat('*')) {
+                max = -1;
+            } else if (eat('+')) {
+                min = 1;
+                max = -1;
+            } else if (eat('?')) {
+                max = 1;
+            } else if (!counted(min, max)) {
+                return item;
+            }
+            if (more() && peek() == '?') fail("lazy quantifiers are not supported");
+            if (item.kind == Node::Kind::Empty) fail_at("nothing to repeat", at);
+            Node rep = Node::of(Node::Kind::Repeat);
+            rep.min = min;
+            rep.max = max;
+            rep.children.push_back(std::move(item));
+            item = std::move(rep);
+        }
+    }
+
+    // `{m}`, `{m,}` or `{m,n}`; anything else leaves `{` to be a literal.
+    bool counted(int& min, int& max) {
+        if (!more() || peek() != '{') return false;
+        const std::size_t start = pos_;
+        std::size_t i = pos_ + 1;
+        auto number = [&](int& out) {
+            const std::size_t begin = i;
+            long value = 0;
+            while (i < p_.size() && std::isdigit(static_cast<unsigned char>(p_[i]))) {
+                value = std::min<long>(value * 10 + (p_[i] - '0'), kMaxRepeat + 1L);
+                ++i;
+            }
+            out = static_cast<int>(value);
+            return i > begin;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (i < p_.size() && p_[i] == ',') {
+            ++i;
+            if (!number(max)) max = -1;
+        }
+        if (i >= p_.size() || p_[i] != '}') return false;
+        pos_ = i + 1;
+        if (min > kMaxRepeat || max > kMaxRepeat) fail_at("repetition count above 1000", start);
+        if (max >= 0 && max < min) fail_at("repetition range is backwards", start);
+        return true;
+    }
+
+    Node atom() {
+        const std::size_t at = pos_;
+        const unsigned char c = peek();
+        ++pos_;
+        switch (c) {
+        case '(': {
+            if (eat('?')) {
+                if (!eat(':')) fail("only (?:...) groups are supported");
+            }
+            Node inner = alternation();
+            if (!eat(')')) fail_at("missing )", at);
+            return inner;
+        }
+        case '[': return bracket(at);
+        case '.': return any();
+        case '^': return Node::of(Node::Kind::LineStart);
+        case '$': return Node::of(Node::Kind::LineEnd);
+        case '*':
+        case '+':
+        case '?': fail_at("nothing to repeat", at);
+        case '\\': return escape(at);
+        case '\n': fail_at("patterns cannot match line breaks", at);
+        default: break;
+        }
+        if (c < 0xc0) return literal(c);
+        // A multi-byte character is one atom, so a quantifier repeats all of it.
+        Node cat = Node::of(Node::Kind::Concat);
+        cat.children.push_back(literal(c));
+        while (more() && (peek() & 0xc0) == 0x80) cat.children.push_back(literal(p_[pos_++]));
+        return cat;
+    }
+
+    Node literal(unsigned char c) const {
+        Node n = Node::of(Node::Kind::Literal);
+        n.byte = c;
+        return n;
+    }
+
+    Node set(ByteSet bytes, bool multibyte) const {
+        Node n = Node::of(Node::Kind::Set);
+        n.set = bytes;
+        n.multibyte = multibyte;
+        return n;
+    }
+
+    Node any() const { return set(ascii_complement(ByteSet()), true); }
+
+    // The class named by `\d \w \s \D \W \S`, if `c` is one of them.
+    bool class_escape(unsigned char c, ByteSet& bytes, bool& negated) const {
+        switch (c) {
+        case 'd':
+        case 'D': bytes = bytes_where([](unsigned char b) { return std::isdigit(b) != 0; }); break;
+        case 'w':
+        case 'W': bytes = bytes_where([](unsigned char b) { return is_word(b); }); break;
+        case 's':
+        case 'S':
+            bytes = bytes_where([](unsigned char b) { return b == ' ' || (b >= '\t' && b <= '\r' && b != '\n'); });
+            break;
+        default: return false;
+        }
+        negated = std::isupper(c) != 0;
+        return true;
+    }
+
+    // A single-byte escape (after the backslash): `\t`, `\xHH`, punctuation.
+    unsigned char byte_escape(std::size_t at) {
+        if (!more()) fail_at("trailing backslash", at);
+        const unsigned char c = peek();
+        ++pos_;
+        switch (c) {
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'n': fail_at("patterns cannot match line breaks", at);
+        case 'x': {
+            auto hex = [&]() -> int {
+                if (!more() || !std::isxdigit(peek())) fail_at("\\x needs two hex digits", at);
+                const char h = static_cast<char>(std::tolower(p_[pos_++]));
+                return h <= '9' ? h - '0' : h - 'a' + 10;
+            };
+            const int high = hex();
+            const int value = high * 16 + hex();
+            if (value == '\n') fail_at("patterns cannot match line breaks", at);
+            return static_cast<unsigned char>(value);
+        }
+        default: break;
+        }
+        if (std::isalnum(c)) fail_at(std::string("unsupported escape \\") + static_cast<char>(c), at);
+        return c;
+    }
+
+    Node escape(std::size_t at) {
+        ByteSet bytes;
+        bool negated = false;
+        if (more() && class_escape(peek(), bytes, negated)) {
+            ++pos_;
+            return negated ? set(ascii_complement(bytes), true) : set(bytes, false);
+        }
+        return literal(byte_escape(at));
+    }
+
+    Node bracket(std::size_t at) {
+        const bool negated = eat('^');
+        ByteSet bytes;
+        bool multibyte = false;
+        for (bool first = true;; first = false) {
+            if (!more()) fail_at("missing ]", at);
+            if (peek() == ']' && !first) {
+                ++pos_;
+                break;
+            }
+            const std::size_t item = pos_;
+            int low = -1;
+            if (peek() == '\\') {
+                ++pos_;
+                ByteSet named;
+                bool named_negated = false;
+                if (more() && class_escape(peek(), named, named_negated)) {
+                    ++pos_;
+                    if (named_negated) {
+                        bytes |= ascii_complement(named);
+                        multibyte = true;
+                    } else {
+                        bytes |= named;
+                    }
+                    continue;
+                }
+                low = byte_escape(item);
+            } else {
+                low = peek();
+                ++pos_;
+            }
+            int high = low;
+            if (pos_ + 1 < p_.size() && p_[pos_] == '-' && p_[pos_ + 1] != ']') {
+                ++pos_;
+                if (peek() == '\\') {
+                    ++pos_;
+                    high = byte_escape(item);
+                } else {
+                    high = peek();
+                    ++pos_;
+                }
+                if (high < low) fail_at("class range is backwards", item);
+            }
+            if (high >= 0x80) fail_at("non-ASCII characters in classes are not supported", item);
+            for (int b = low; b <= high; ++b) bytes[static_cast<std::size_t>(b)] = true;
+        }
+        bytes[static_cast<unsigned char>('\n')] = false;
+        if (ignore_case_) fold_case(bytes);
+        if (negated) return set(ascii_complement(bytes), !multibyte);
+        return set(bytes, multibyte);
+    }
+
+    std::string_view p_;
+    bool ignore_case_;
+    std::size_t pos_ = 0;
+};
+
+struct Inst {
+    enum Op : std::uint8_t { Byte, Split, Jump, Match, LineStart, LineEnd };
+
+    Op op;
+    std::uint32_t x = 0;  // Byte: set; Split and Jump: target
+    std::uint32_t y = 0;  // Split: second target
+};
+
+// Thompson NFA. Byte and assertion instructions continue at the next
+// instruction.
+struct Program {
+    std::vector<Inst> code;
+    std::vector<ByteSet> sets;
+    bool ignore_case = false;
+
+    std::uint32_t emit(Inst inst) {
+        if (code.size() >= kMaxInstructions) throw PatternError("pattern is too large", 0);
+        code.push_back(inst);
+        return static_cast<std::uint32_t>(code.size() - 1);
+    }
+    std::uint32_t pc() const { return static_cast<std::uint32_t>(code.size()); }
+
+    void byte(const ByteSet& set) {
+        std::uint32_t index = 0;
+        while (index < sets.size() && sets[index] != set) ++index;
+        if (index == sets.size()) sets.push_back(set);
+        emit({Inst::Byte, index, 0});
+    }
+
+    void compile(const Node& n) {
+        switch (n.kind) {
+        case Node::Kind::Empty: break;
+        case Node::Kind::Literal: {
+            ByteSet set;
+            set[n.byte] = true;
+            if (ignore_case && std::isalpha(n.byte)) fold_case(set);
+            byte(set);
+            break;
+        }
+        case Node::Kind::Set: compile_set(n); break;
+        case Node::Kind::Concat:
+            for (const Node& child : n.children) compile(child);
+            break;
+        case Node::Kind::Alternate: {
+            std::vector<std::uint32_t> exits;
+            for (std::size_t i = 0; i + 1 < n.children.size(); ++i) {
+                const std::uint32_t split = emit({Inst::Split, pc() + 1, 0});
+                compile(n.children[i]);
+                exits.push_back(emit({Inst::Jump, 0, 0}));
+                code[split].y = pc();
+            }
+            compile(n.children.back());
+            for (std::uint32_t exit : exits) code[exit].x = pc();
+            break;
+        }
+        case Node::Kind::Repeat: {
+            const Node& body = n.children[0];
+            for (int i = 0; i < n.min; ++i) compile(body);
+            if (n.max < 0) {
+                const std::uint32_t loop = emit({Inst::Split, pc() + 1, 0});
+                compile(body);
+                emit({Inst::Jump, loop, 0});
+                code[loop].y = pc();
+            } else {
+                std::vector<std::uint32_t> skips;
+                for (int i = n.min; i < n.max; ++i) {
+                    skips.push_back(emit({Inst::Split, pc() + 1, 0}));
+                    compile(body);
+                }
+                for (std::uint32_t skip : skips) code[skip].y = pc();
+            }
+            break;
+        }
+        case Node::Kind::LineStart: emit({Inst::LineStart, 0, 0}); break;
+        case Node::Kind::LineEnd: emit({Inst::LineEnd, 0, 0}); break;
+        }
+    }
+
+    // One ASCII byte from the set, or a lead byte and its continuations.
+    void compile_set(const Node& n) {
+        if (!n.multibyte) {
+            byte(n.set);
+            return;
+        }
+        ByteSet continuation;
+        for (unsigned b = 0x80; b < 0xc0; ++b) continuation[b] = true;
+        auto range = [](unsigned low, unsigned high) {
+            ByteSet set;
+            for (unsigned b = low; b <= high; ++b) set[b] = true;
+            return set;
+        };
+        const ByteSet leads[3] = {range(0xc0, 0xdf), range(0xe0, 0xef), range(0xf0, 0xf7)};
+        std::vector<std::uint32_t> exits;
+        const std::uint32_t split = emit({Inst::Split, pc() + 1, 0});
+        byte(n.set);
+        exits.push_back(emit({Inst::Jump, 0, 0}));
+        code[split].y = pc();
+        for (int length = 2; length <= 4; ++length) {
+            const std::uint32_t next = length < 4 ? emit({Inst::Split, pc() + 1, 0}) : 0;
+            byte(leads[length - 2]);
+            for (int k = 1; k < length; ++k) byte(continuation);
+            if (length < 4) {
+                exits.push_back(emit({Inst::Jump, 0, 0}));
+                code[next].y = pc();
+            }
+        }
+        for (std::uint32_t exit : exits) code[exit].x = pc();
+    }
+};
+
+// The longest run of adjacent literals at the top level of the pattern:
+// every match has to contain it.
+std::string literal_run(const Node& root) {
+    if (root.kind == Node::Kind::Literal) return std::string(1, static_cast<char>(root.byte));
+    if (root.kind != Node::Kind::Concat) return {};
+    std::string best;
+    std::string run;
+    for (const Node& child : root.children) {
+        if (child.kind == Node::Kind::Literal) {
+            run += static_cast<char>(child.byte);
+            if (run.size() > best.size()) best = run;
+        } else {
+            run.clear();
+        }
+    }
+    return best;
+}
+
+bool at_line_start(std::string_view text, std::size_t pos) { return pos == 0 || text[pos - 1] == '\n'; }
+
+// Reusable buffers for following empty transitions.
+struct Scratch {
+    std::vector<std::uint32_t> stack;
+    std::vector<std::uint32_t> mark;
+    std::uint32_t stamp = 0;
+};
+
+// Adds to `out` (unsorted) the instructions reachable from `seeds` without
+// consuming input: Byte and Match, and LineEnd assertions that `at_end`
+// does not yet satisfy. `out` may already hold a closure, whose
+// instructions are not repeated.
+void closure(const Program& program, Scratch& scratch, const std::vector<std::uint32_t>& seeds, bool at_start,
+             bool at_end, std::vector<std::uint32_t>& out) {
+    if (scratch.mark.size() != program.code.size()) {
+        scratch.mark.assign(program.code.size(), 0);
+        scratch.stamp = 0;
+    }
+    if (++scratch.stamp == 0) {
+        std::fill(scratch.mark.begin(), scratch.mark.end(), 0);
+        scratch.stamp = 1;
+    }
+    for (std::uint32_t pc : out) scratch.mark[pc] = scratch.stamp;
+    scratch.stack.assign(seeds.rbegin(), seeds.rend());
+    while (!scratch.stack.empty()) {
+        const std::uint32_t pc = scratch.stack.back();
+        scratch.stack.pop_back();
+        if (scratch.mark[pc] == scratch.stamp) continue;
+        scratch.mark[pc] = scratch.stamp;
+        const Inst& inst = program.code[pc];
+        switch (inst.op) {
+        case Inst::Byte:
+        case Inst::Match: out.push_back(pc); break;
+        case Inst::Split:
+            scratch.stack.push_back(inst.y);
+            scratch.stack.push_back(inst.x);
+            break;
+        case Inst::Jump: scratch.stack.push_back(inst.x); break;
+        case Inst::LineStart:
+            if (at_start) scratch.stack.push_back(pc + 1);
+            break;
+        case Inst::LineEnd:
+            if (at_end) {
+                scratch.stack.push_back(pc + 1);
+            } else {
+                out.push_back(pc);
+            }
+            break;
+        }
+    }
+}
+
+bool has_match(const Program& program, const std::vector<std::uint32_t>& set) {
+    return std::any_of(set.begin(), set.end(), [&](std::uint32_t pc) { return program.code[pc].op == Inst::Match; });
+}
+
+// Whether `set` matches once the line ends here.
+bool matches_at_end(const Program& program, Scratch& scratch, const std::vector<std::uint32_t>& set, bool at_start) {
+    if (has_match(program, set)) return true;
+    std::vector<std::uint32_t> seeds;
+    for (std::uint32_t pc : set) {
+        if (program.code[pc].op == Inst::LineEnd) seeds.push_back(pc + 1);
+    }
+    if (seeds.empty()) return false;
+    std::vector<std::uint32_t> reached;
+    closure(program, scratch, seeds, at_start, true, reached);
+    return has_match(program, reached);
+}
+
+// Instructions following those in `set` that accept `byte`.
+void advance(const Program& program, const std::vector<std::uint32_t>& set, unsigned char byte,
+          std::vector<std::uint32_t>& out) {
+    out.clear();
+    for (std::uint32_t pc : set) {
+        const Inst& inst = program.code[pc];
+        if (inst.op == Inst::Byte && program.sets[inst.x][byte]) out.push_back(pc + 1);
+    }
+}
+
+// A DFA state is a row of cells: a header pointing at its State, then one
+// transition per byte class. A transition holds the address of the next
+// state's row, so a step is one load. kAttention is set on steps the
+// search loop must look at (into a matching or dead state, or across a
+// newline); kUnknown marks a step not computed yet, and kFull is returned
+// instead of a step once the state cache is exhausted.
+using Cell = std::atomic<std::uintptr_t>;
+constexpr std::uintptr_t kAttention = 1;
+constexpr std::uintptr_t kUnknown = 2;
+constexpr std::uintptr_t kFull = 6;
+constexpr std::uintptr_t kTagBits = 3;
+
+// Subset-construction DFA over a Program, built one transition at a time.
+// An unanchored DFA restarts the pattern at every byte, so it finds where
+// the earliest match ends; an anchored one runs the pattern from one
+// position, to find the longest match there.
+class Dfa {
+public:
+    struct State {
+        std::vector<std::uint32_t> set;  // sorted
+        bool at_start = false;
+        bool match = false;      // a match ends before the next byte
+        bool end_match = false;  // a match ends here if the line does
+        bool dead = false;
+    };
+
+    Dfa(const Program& program, bool anchored) : program_(program), anchored_(anchored) {
+        build_classes();
+        dead_ = intern({}, false);
+        const std::vector<std::uint32_t> entry{0};
+        closure(program_, scratch_, entry, false, false, restart_);
+        std::sort(restart_.begin(), restart_.end());
+        for (bool line_start : {false, true}) {
+            std::vector<std::uint32_t> set;
+            closure(program_, scratch_, entry, line_start, false, set);
+            std::sort(set.begin(), set.end());
+            starts_[line_start] = intern(std::move(set), line_start);
+        }
+    }
+
+    Cell* start(bool line_start) const noexcept { return starts_[line_start]; }
+    std::size_t size() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+    static const State& state(const Cell* row) noexcept {
+        return *reinterpret_cast<const State*>(row[0].load(std::memory_order_relaxed));
+    }
+    static Cell* target(std::uintptr_t step) noexcept { return reinterpret_cast<Cell*>(step & ~kTagBits); }
+
+    // The step out of `row` on `byte`, possibly kUnknown.
+    std::uintptr_t peek(const Cell* row, unsigned char byte) const noexcept {
+        return row[1 + classes_[byte]].load(std::memory_order_acquire);
+    }
+    // The step out of `row` on `byte`, computed if need be.
+    std::uintptr_t next(Cell* row, unsigned char byte) {
+        const std::uintptr_t step = peek(row, byte);
+        return step != kUnknown ? step : compute(row, classes_[byte]);
+    }
+
+private:
+    static constexpr std::size_t kBlockStates = 64;
+
+    struct Block {
+        std::unique_ptr<Cell[]> rows;
+        State states[kBlockStates];
+    };
+
+    // Bytes no set tells apart share a class, and rows have one cell per
+    // class. Newline always has a class of its own.
+    void build_classes() {
+        std::vector<ByteSet> splits = program_.sets;
+        ByteSet newline;
+        newline[static_cast<unsigned char>('\n')] = true;
+        splits.push_back(newline);
+        classes_.fill(0);
+        unsigned count = 1;
+        for (const ByteSet& set : splits) {
+            std::array<int, 512> renumber;
+            renumber.fill(-1);
+            unsigned next = 0;
+            for (unsigned b = 0; b < 256; ++b) {
+                int& id = renumber[classes_[b] * 2 + set[b]];
+                if (id < 0) id = static_cast<int>(next++);
+                classes_[b] = static_cast<std::uint16_t>(id);
+            }
+            count = next;
+        }
+        row_cells_ = 1 + count;
+        representative_.assign(count, 0);
+        for (unsigned b = 256; b-- > 0;) representative_[classes_[b]] = static_cast<unsigned char>(b);
+        newline_class_ = classes_[static_cast<unsigned char>('\n')];
+    }
+
+    std::uintptr_t compute(Cell* row, unsigned cls) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Cell& cell = row[1 + cls];
+        std::uintptr_t step = cell.load(std::memory_order_relaxed);
+        if (step != kUnknown) return step;
+        if (cls == newline_class_) {
+            // Leaving a line: the search loop checks end_match first.
+            step = reinterpret_cast<std::uintptr_t>(anchored_ ? dead_ : starts_[1]) | kAttention;
+        } else {
+            advance(program_, state(row).set, representative_[cls], seeds_);
+            std::vector<std::uint32_t> set;
+            if (!anchored_) set = restart_;
+            closure(program_, scratch_, seeds_, false, false, set);
+            std::sort(set.begin(), set.end());
+            Cell* next = intern(std::move(set), false);
+            if (!next) return kFull;
+            const State& s = state(next);
+            step = reinterpret_cast<std::uintptr_t>(next) | (s.match || s.dead ? kAttention : 0);
+        }
+        cell.store(step, std::memory_order_release);
+        return step;
+    }
+
+    // The row for `set`, created if need be; null when the cache is full.
+    Cell* intern(std::vector<std::uint32_t> set, bool at_start) {
+        std::string key(reinterpret_cast<const char*>(set.data()), set.size() * sizeof(std::uint32_t));
+        key += at_start ? '^' : '-';
+        if (auto it = rows_.find(key); it != rows_.end()) return it->second;
+        const std::size_t n = count_.load(std::memory_order_relaxed);
+        if (n == Regex::kMaxStates) return nullptr;
+        if (n % kBlockStates == 0) {
+            auto block = std::make_unique<Block>();
+            block->rows = std::make_unique<Cell[]>(kBlockStates * row_cells_);
+            for (std::size_t i = 0; i < kBlockStates * row_cells_; ++i) {
+                block->rows[i].store(kUnknown, std::memory_order_relaxed);
+            }
+            blocks_.push_back(std::move(block));
+        }
+        Block& block = *blocks_.back();
+        State& s = block.states[n % kBlockStates];
+        s.at_start = at_start;
+        s.dead = set.empty();
+        s.match = has_match(program_, set);
+        s.end_match = matches_at_end(program_, scratch_, set, at_start);
+        s.set = std::move(set);
+        Cell* row = &block.rows[n % kBlockStates * row_cells_];
+        row[0].store(reinterpret_cast<std::uintptr_t>(&s), std::memory_order_relaxed);
+        rows_.emplace(std::move(key), row);
+        count_.store(n + 1, std::memory_order_relaxed);
+        return row;
+    }
+
+    const Program& program_;
+    const bool anchored_;
+    std::array<std::uint16_t, 256> classes_{};
+    std::vector<unsigned char> representative_;
+    std::size_t row_cells_ = 1;
+    unsigned newline_class_ = 0;
+    std::vector<std::uint32_t> restart_;  // closure of the entry, mid-line
+    Cell* starts_[2] = {nullptr, nullptr};
+    Cell* dead_ = nullptr;
+    std::atomic<std::size_t> count_{0};
+
+    // Guarded by mutex_. Rows never move once created.
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::unordered_map<std::string, Cell*> rows_;
+    Scratch scratch_;
+    std::vector<std::uint32_t> seeds_;
+};
+
+}  // namespace
+
+PatternError::PatternError(const std::string& message, std::size_t offset)
+    : std::runtime_error(message), offset_(offset) {}
+
+struct Regex::Impl {
+    Program program;
+    std::string literal;
+    bool literal_only = false;
+    std::unique_ptr<Dfa> forward;   // unanchored
+    std::unique_ptr<Dfa> anchored;
+
+    // Where the earliest-ending match at or after `from` ends, or npos.
+    // Sets `full` instead when the DFA runs out of states.
+    std::size_t earliest_end(std::string_view text, std::size_t from, bool& full) const;
+    // Length of the longest match starting exactly at `at`, or npos.
+    std::size_t longest(std::string_view text, std::size_t at, bool& full) const;
+
+    // The same two searches by set simulation, without the DFA's cache.
+    std::size_t slow_earliest_end(std::string_view text, std::size_t from) const;
+    std::size_t slow_longest(std::string_view text, std::size_t at) const;
+
+    template <typename Earliest, typename Longest>
+    std::optional<Match> find(std::string_view text, std::size_t from, Earliest earliest, Longest longest) const;
+};
+
+std::size_t Regex::Impl::earliest_end(std::string_view text, std::size_t from, bool& full) const {
+    Dfa& dfa = *forward;
+    Cell* row = dfa.start(at_line_start(text, from));
+    if (Dfa::state(row).match) return from;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    const std::size_t n = text.size();
+    for (std::size_t i = from; i < n; ++i) {
+        std::uintptr_t step = dfa.peek(row, bytes[i]);
+        if ((step & kTagBits) == 0) {
+            row = Dfa::target(step);
+            continue;
+        }
+        if (step == kUnknown) {
+            step = dfa.next(row, bytes[i]);
+            if ((step & kTagBits) == 0) {
+                row = Dfa::target(step);
+                continue;
+            }
+        }
+        if (step == kFull) {
+            full = true;
+            return npos;
+        }
+        if (bytes[i] == '\n') {
+            if (Dfa::state(row).end_match) return i;
+            row = Dfa::target(step);
+            if (Dfa::state(row).match) return i + 1;
+            continue;
+        }
+        row = Dfa::target(step);
+        const Dfa::State& state = Dfa::state(row);
+        if (state.match) return i + 1;
+        if (state.dead) {
+            // Nothing can match before the next line (a `^` pattern mid-line).
+            const std::size_t newline = find_byte(text, '\n', i + 1);
+            if (newline == npos) return npos;
+            i = newline - 1;
+        }
+    }
+    return Dfa::state(row).end_match ? n : npos;
+}
+
+std::size_t Regex::Impl::longest(std::string_view text, std::size_t at, bool& full) const {
+    Dfa& dfa = *anchored;
+    Cell* row = dfa.start(at_line_start(text, at));
+    if (Dfa::state(row).dead) return npos;
+    std::size_t last = Dfa::state(row).match ? at : npos;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    std::size_t i = at;
+    for (; i < text.size(); ++i) {
+        std::uintptr_t step = dfa.peek(row, bytes[i]);
+        if ((step & kTagBits) == 0) {
+            row = Dfa::target(step);
+            continue;
+        }
+        if (step == kUnknown) {
+            step = dfa.next(row, bytes[i]);
+            if ((step & kTagBits) == 0) {
+                row = Dfa::target(step);
+                continue;
+            }
+        }
+        if (step == kFull) {
+            full = true;
+            return npos;
+        }
+        if (bytes[i] == '\n') break;
+        row = Dfa::target(step);
+        if (Dfa::state(row).dead) return last == npos ? npos : last - at;
+        last = i + 1;
+    }
+    if (Dfa::state(row).end_match) last = i;
+    return last == npos ? npos : last - at;
+}
+
+std::size_t Regex::Impl::slow_earliest_end(std::string_view text, std::size_t from) const {
+    Scratch scratch;
+    const std::vector<std::uint32_t> entry{0};
+    std::vector<std::uint32_t> restart;
+    closure(program, scratch, entry, false, false, restart);
+    auto line_entry = [&](bool line_start) {
+        std::vector<std::uint32_t> set;
+        closure(program, scratch, entry, line_start, false, set);
+        return set;
+    };
+    bool line_start = at_line_start(text, from);
+    std::vector<std::uint32_t> set = line_entry(line_start);
+    std::vector<std::uint32_t> seeds;
+    if (has_match(program, set)) return from;
+    for (std::size_t i = from; i < text.size(); ++i) {
+        const auto byte = static_cast<unsigned char>(text[i]);
+        if (byte == '\n') {
+            if (matches_at_end(program, scratch, set, line_start)) return i;
+            line_start = true;
+            set = line_entry(true);
+            if (has_match(program, set)) return i + 1;
+            continue;
+        }
+        advance(program, set, byte, seeds);
+        set = restart;
+        closure(program, scratch, seeds, false, false, set);
+        line_start = false;
+        if (has_match(program, set)) return i + 1;
+    }
+    return matches_at_end(program, scratch, set, line_start) ? text.size() : npos;
+}
+
+std::size_t Regex::Impl::slow_longest(std::string_view text, std::size_t at) const {
+    Scratch scratch;
+    bool line_start = at_line_start(text, at);
+    std::vector<std::uint32_t> set;
+    closure(program, scratch, {0}, line_start, false, set);
+    std::vector<std::uint32_t> seeds;
+    std::size_t last = has_match(program, set) ? at : npos;
+    std::size_t i = at;
+    for (; i < text.size() && text[i] != '\n' && !set.empty(); ++i) {
+        advance(program, set, static_cast<unsigned char>(text[i]), seeds);
+        set.clear();
+        closure(program, scratch, seeds, false, false, set);
+        line_start = false;
+        if (has_match(program, set)) last = i + 1;
+    }
+    if (!set.empty() && matches_at_end(program, scratch, set, line_start)) last = i;
+    return last == npos ? npos : last - at;
+}
+
+template <typename Earliest, typename Longest>
+std::optional<Match> Regex::Impl::find(std::string_view text, std::size_t from, Earliest earliest,
+                                       Longest longest) const {
+    const std::size_t end = earliest(text, from);
+    if (end == npos) return std::nullopt;
+    // The earliest-ending match starts on end's line, no later than end,
+    // so the leftmost match starts in the same range.
+    const std::size_t newline = rfind_byte(text, '\n', end);
+    std::size_t at = std::max(from, newline == npos ? 0 : newline + 1);
+    for (; at <= end; ++at) {
+        const std::size_t length = longest(text, at);
+        if (length != npos) return Match{at, length};
+    }
+    return std::nullopt;
+}
+
+Regex::Regex(std::string_view pattern, bool ignore_case) : impl_(std::make_unique<Impl>()) {
+    const Node root = Parser(pattern, ignore_case).parse();
+    impl_->program.ignore_case = ignore_case;
+    impl_->program.compile(root);
+    impl_->program.emit({Inst::Match, 0, 0});
+    impl_->literal = literal_run(root);
+    impl_->literal_only = root.kind == Node::Kind::Literal ||
+                          (root.kind == Node::Kind::Concat && impl_->literal.size() == root.children.size());
+    impl_->forward = std::make_unique<Dfa>(impl_->program, false);
+    impl_->anchored = std::make_unique<Dfa>(impl_->program, true);
+}
+
+Regex::~Regex() = default;
+
+std::optional<Match> Regex::find(std::string_view text, std::size_t from) const {
+    if (from > text.size()) return std::nullopt;
+    bool full = false;
+    const Impl& impl = *impl_;
+    auto result = impl.find(
+        text, from, [&](std::string_view t, std::size_t f) { return full ? npos : impl.earliest_end(t, f, full); },
+        [&](std::string_view t, std::size_t a) { return full ? npos : impl.longest(t, a, full); });
+    if (!full) return result;
+    return impl.find(
+        text, from, [&](std::string_view t, std::size_t f) { return impl.slow_earliest_end(t, f); },
+        [&](std::string_view t, std::size_t a) { return impl.slow_longest(t, a); });
+}
+
+const std::string& Regex::required_literal() const noexcept { return impl_->literal; }
+
+bool Regex::is_literal() const noexcept { return impl_->literal_only; }
+
+std::size_t Regex::state_count() const noexcept { return impl_->forward->size() + impl_->anchored->size(); }
+
+}  // namespace rebel::search
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace rebel::search {
+
+/// A pattern that does not parse; `offset` is the byte of the pattern at
+/// which parsing stopped, for pointing at it in the search box.
+class PatternError : public std::runtime_error {
+public:
+    PatternError(const std::string& message, std::size_t offset);
+
+    std::size_t offset() const noexcept { return offset_; }
+
+private:
+    std::size_t offset_;
+};
+
+/// A match as a byte range of the searched text.
+struct Match {
+    std::size_t offset = 0;
+    std::size_t length = 0;
+};
+
+/// Regular expression matched by a lazily built DFA, so searching costs a
+/// table lookup per byte however the pattern is written and never
+/// backtracks.
+///
+/// Syntax: literals, `.`, classes (`[a-z_]`, `[^...]`), `\d \w \s` and
+/// their negations, `\t \r \f \v \xHH`, escaped punctuation, `^` and `$`,
+/// alternation, groups (`(...)`, `(?:...)`) and the greedy quantifiers
+/// `* + ? {m} {m,} {m,n}`. Back-references, lookaround, `\b` and lazy
+/// quantifiers are rejected with a PatternError, as are non-ASCII members
+/// of positive classes. `.` and negated classes consume whole UTF-8
+/// sequences.
+///
+/// Matching is line based, as in grep: no match contains a newline, and
+/// `^` and `$` match at line boundaries. Of all matches the leftmost is
+/// reported, and of those the longest.
+///
+/// DFA states are created on first use and shared by every thread
+/// searching with the same Regex: only a step into a state not built yet
+/// takes a lock. Past kMaxStates a search falls back to simulating the
+/// automaton set by set, which is slower but bounded.
+class Regex {
+public:
+    static constexpr std::size_t kMaxStates = 8192;
+
+    /// Throws PatternError.
+    explicit Regex(std::string_view pattern, bool ignore_case = false);
+    ~Regex();
+
+    Regex(const Regex&) = delete;
+    Regex& operator=(const Regex&) = delete;
+
+    /// First match starting at or after `from`. Bytes of `text` before
+    /// `from` only decide whether `from` is at a line start.
+    std::optional<Match> find(std::string_view text, std::size_t from = 0) const;
+
+    /// The longest run of literal bytes every match contains, for skipping
+    /// ahead with a LiteralFinder; empty if there is none. Compare it with
+    /// the same case sensitivity as the Regex.
+    const std::string& required_literal() const noexcept;
+    /// Whether the pattern is nothing but its required literal, so a
+    /// LiteralFinder alone can search for it.
+    bool is_literal() const noexcept;
+
+    /// DFA states built so far, for diagnostics.
+    std::size_t state_count() const noexcept;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace rebel::search
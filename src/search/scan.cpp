@@ -0,0 +1,304 @@
+#include "search/scan.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Vector kernels: SSE2 is part of x86-64, AVX2 is compiled per function
+// with a target attribute and chosen at run time, NEON is part of AArch64.
+#if defined(__x86_64__) || defined(_M_X64)
+#define REBEL_SEARCH_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define REBEL_SEARCH_AVX2 1
+#define REBEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define REBEL_SEARCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rebel::search {
+namespace {
+
+// Both probe bytes of a LiteralFinder, each as the two values it accepts
+// (equal unless the byte is a letter and case is ignored).
+struct Probe {
+    std::size_t first_offset;
+    std::size_t second_offset;
+    unsigned char first[2];
+    unsigned char second[2];
+};
+
+unsigned lowest_bit(std::uint64_t mask) noexcept {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward64(&bit, mask);
+    return static_cast<unsigned>(bit);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+bool probe_matches(const unsigned char* s, std::size_t p, const Probe& probe) noexcept {
+    const unsigned char a = s[p + probe.first_offset];
+    const unsigned char b = s[p + probe.second_offset];
+    return (a == probe.first[0] || a == probe.first[1]) && (b == probe.second[0] || b == probe.second[1]);
+}
+
+// First start position p in [from, last] whose probe bytes match, or npos.
+std::size_t probe_scalar(const unsigned char* s, std::size_t from, std::size_t last, const Probe& probe) noexcept {
+    for (std::size_t p = from; p <= last; ++p) {
+        if (probe_matches(s, p, probe)) return p;
+    }
+    return npos;
+}
+
+std::size_t count_scalar(const unsigned char* s, std::size_t n, unsigned char byte) noexcept {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < n; ++i) total += s[i] == byte;
+    return total;
+}
+
+#if REBEL_SEARCH_X86
+std::size_t probe_sse2(const unsigned char* s, std::size_t from, std::size_t last, const Probe& probe) noexcept {
+    const __m128i a0 = _mm_set1_epi8(static_cast<char>(probe.first[0]));
+    const __m128i a1 = _mm_set1_epi8(static_cast<char>(probe.first[1]));
+    const __m128i b0 = _mm_set1_epi8(static_cast<char>(probe.second[0]));
+    const __m128i b1 = _mm_set1_epi8(static_cast<char>(probe.second[1]));
+    std::size_t p = from;
+    for (; p + 16 <= last + 1; p += 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + p + probe.first_offset));
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + p + probe.second_offset));
+        const __m128i hit = _mm_and_si128(_mm_or_si128(_mm_cmpeq_epi8(x, a0), _mm_cmpeq_epi8(x, a1)),
+                                          _mm_or_si128(_mm_cmpeq_epi8(y, b0), _mm_cmpeq_epi8(y, b1)));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask != 0) return p + lowest_bit(mask);
+    }
+    return probe_scalar(s, p, last, probe);
+}
+
+std::size_t count_sse2(const unsigned char* s, std::size_t n, unsigned char byte) noexcept {
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(byte));
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t total = 0;
+    std::size_t i = 0;
+    while (i + 16 <= n) {
+        // Byte lanes count up to 255 matches before they are summed.
+        const std::size_t rounds = std::min<std::size_t>((n - i) / 16, 255);
+        __m128i counts = zero;
+        for (std::size_t r = 0; r < rounds; ++r, i += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(x, needle));
+        }
+        const __m128i sums = _mm_sad_epu8(counts, zero);
+        total += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) +
+                 static_cast<std::size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+    return total + count_scalar(s + i, n - i, byte);
+}
+#endif
+
+#if REBEL_SEARCH_AVX2
+REBEL_TARGET_AVX2
+std::size_t probe_avx2(const unsigned char* s, std::size_t from, std::size_t last, const Probe& probe) noexcept {
+    const __m256i a0 = _mm256_set1_epi8(static_cast<char>(probe.first[0]));
+    const __m256i a1 = _mm256_set1_epi8(static_cast<char>(probe.first[1]));
+    const __m256i b0 = _mm256_set1_epi8(static_cast<char>(probe.second[0]));
+    const __m256i b1 = _mm256_set1_epi8(static_cast<char>(probe.second[1]));
+    std::size_t p = from;
+    for (; p + 32 <= last + 1; p += 32) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + p + probe.first_offset));
+        const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + p + probe.second_offset));
+        const __m256i hit =
+            _mm256_and_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, a0), _mm256_cmpeq_epi8(x, a1)),
+                             _mm256_or_si256(_mm256_cmpeq_epi8(y, b0), _mm256_cmpeq_epi8(y, b1)));
+        const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hit));
+        if (mask != 0) return p + lowest_bit(mask);
+    }
+    return probe_sse2(s, p, last, probe);
+}
+
+REBEL_TARGET_AVX2
+std::size_t count_avx2(const unsigned char* s, std::size_t n, unsigned char byte) noexcept {
+    const __m256i needle = _mm256_set1_epi8(static_cast<char>(byte));
+    const __m256i zero = _mm256_setzero_si256();
+    std::size_t total = 0;
+    std::size_t i = 0;
+    while (i + 32 <= n) {
+        const std::size_t rounds = std::min<std::size_t>((n - i) / 32, 255);
+        __m256i counts = zero;
+        for (std::size_t r = 0; r < rounds; ++r, i += 32) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(x, needle));
+        }
+        const __m256i sums = _mm256_sad_epu8(counts, zero);
+        total += static_cast<std::size_t>(_mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+                                          _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3));
+    }
+    return total + count_sse2(s + i, n - i, byte);
+}
+#endif
+
+#if REBEL_SEARCH_NEON
+std::size_t probe_neon(const unsigned char* s, std::size_t from, std::size_t last, const Probe& probe) noexcept {
+    const uint8x16_t a0 = vdupq_n_u8(probe.first[0]);
+    const uint8x16_t a1 = vdupq_n_u8(probe.first[1]);
+    const uint8x16_t b0 = vdupq_n_u8(probe.second[0]);
+    const uint8x16_t b1 = vdupq_n_u8(probe.second[1]);
+    std::size_t p = from;
+    for (; p + 16 <= last + 1; p += 16) {
+        const uint8x16_t x = vld1q_u8(s + p + probe.first_offset);
+        const uint8x16_t y = vld1q_u8(s + p + probe.second_offset);
+        const uint8x16_t hit = vandq_u8(vorrq_u8(vceqq_u8(x, a0), vceqq_u8(x, a1)),
+                                        vorrq_u8(vceqq_u8(y, b0), vceqq_u8(y, b1)));
+        // Narrow to four bits per lane: NEON has no movemask.
+        const uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(hit), 4);
+        const std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+        if (mask != 0) return p + lowest_bit(mask) / 4;
+    }
+    return probe_scalar(s, p, last, probe);
+}
+
+std::size_t count_neon(const unsigned char* s, std::size_t n, unsigned char byte) noexcept {
+    const uint8x16_t needle = vdupq_n_u8(byte);
+    std::size_t total = 0;
+    std::size_t i = 0;
+    while (i + 16 <= n) {
+        const std::size_t rounds = std::min<std::size_t>((n - i) / 16, 255);
+        uint8x16_t counts = vdupq_n_u8(0);
+        for (std::size_t r = 0; r < rounds; ++r, i += 16) {
+            counts = vsubq_u8(counts, vceqq_u8(vld1q_u8(s + i), needle));
+        }
+        total += vaddlvq_u8(counts);
+    }
+    return total + count_scalar(s + i, n - i, byte);
+}
+#endif
+
+struct Kernels {
+    Isa isa;
+    std::size_t (*probe)(const unsigned char*, std::size_t, std::size_t, const Probe&) noexcept;
+    std::size_t (*count)(const unsigned char*, std::size_t, unsigned char) noexcept;
+};
+
+Kernels select_kernels() noexcept {
+#if REBEL_SEARCH_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {Isa::Avx2, probe_avx2, count_avx2};
+#endif
+#if REBEL_SEARCH_X86
+    return {Isa::Sse2, probe_sse2, count_sse2};
+#elif REBEL_SEARCH_NEON
+    return {Isa::Neon, probe_neon, count_neon};
+#else
+    return {Isa::Scalar, probe_scalar, count_scalar};
+#endif
+}
+
+const Kernels& kernels() noexcept {
+    static const Kernels selected = select_kernels();
+    return selected;
+}
+
+unsigned char fold(unsigned char c) noexcept { return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + 32) : c; }
+
+unsigned char upper(unsigned char c) noexcept { return c >= 'a' && c <= 'z' ? static_cast<unsigned char>(c - 32) : c; }
+
+// Bytes roughly from most to least frequent in source code and prose; the
+// rest are rarer than all of these.
+constexpr std::string_view kCommonBytes =
+    " etaoinsrlcdu\n(_)p;m.f,h=gb\"y*/-{}v>:w<kx01T2S[]EARNCIL#&'DOFPMjq3BzU45!H+|6789GVWKYJQXZ%$@\\^`~\t";
+
+std::size_t rarity_rank(unsigned char c) noexcept {
+    const std::size_t at = kCommonBytes.find(static_cast<char>(c));
+    return at == std::string_view::npos ? 0 : kCommonBytes.size() - at;
+}
+
+}  // namespace
+
+Isa active_isa() noexcept { return kernels().isa; }
+
+const char* isa_name(Isa isa) noexcept {
+    switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::Sse2: return "sse2";
+    case Isa::Avx2: return "avx2";
+    case Isa::Neon: return "neon";
+    }
+    return "?";
+}
+
+std::size_t find_byte(std::string_view text, char byte, std::size_t from) noexcept {
+    if (from >= text.size()) return npos;
+    const void* at = std::memchr(text.data() + from, byte, text.size() - from);
+    return at ? static_cast<std::size_t>(static_cast<const char*>(at) - text.data()) : npos;
+}
+
+std::size_t rfind_byte(std::string_view text, char byte, std::size_t end) noexcept {
+    for (std::size_t i = std::min(end, text.size()); i > 0; --i) {
+        if (text[i - 1] == byte) return i - 1;
+    }
+    return npos;
+}
+
+std::size_t count_byte(std::string_view text, char byte) noexcept {
+    return kernels().count(reinterpret_cast<const unsigned char*>(text.data()), text.size(),
+                           static_cast<unsigned char>(byte));
+}
+
+LiteralFinder::LiteralFinder(std::string_view needle, bool ignore_case)
+    : needle_(needle), ignore_case_(ignore_case) {
+    if (ignore_case_) {
+        for (char& c : needle_) c = static_cast<char>(fold(static_cast<unsigned char>(c)));
+    }
+    // The two rarest bytes; ties keep the earlier offset.
+    for (std::size_t i = 1; i < needle_.size(); ++i) {
+        const auto rank = [&](std::size_t at) { return rarity_rank(static_cast<unsigned char>(needle_[at])); };
+        if (rank(i) < rank(first_)) {
+            second_ = first_;
+            first_ = i;
+        } else if (first_ == second_ || rank(i) < rank(second_)) {
+            second_ = i;
+        }
+    }
+    if (first_ > second_) std::swap(first_, second_);
+}
+
+bool LiteralFinder::verify(const char* at) const noexcept {
+    if (!ignore_case_) return std::memcmp(at, needle_.data(), needle_.size()) == 0;
+    for (std::size_t i = 0; i < needle_.size(); ++i) {
+        if (fold(static_cast<unsigned char>(at[i])) != static_cast<unsigned char>(needle_[i])) return false;
+    }
+    return true;
+}
+
+std::size_t LiteralFinder::find(std::string_view text, std::size_t from) const noexcept {
+    const std::size_t m = needle_.size();
+    if (from > text.size() || text.size() - from < m) return npos;
+    if (m == 0) return from;
+    if (m == 1 && !ignore_case_) return find_byte(text, needle_[0], from);
+
+    const auto* s = reinterpret_cast<const unsigned char*>(text.data());
+    const auto a = static_cast<unsigned char>(needle_[first_]);
+    const auto b = static_cast<unsigned char>(needle_[second_]);
+    Probe probe{first_, second_, {a, a}, {b, b}};
+    if (ignore_case_) {
+        probe.first[1] = upper(a);
+        probe.second[1] = upper(b);
+    }
+    const std::size_t last = text.size() - m;
+    const auto& k = kernels();
+    for (std::size_t p = from; p <= last; ++p) {
+        p = k.probe(s, p, last, probe);
+        if (p == npos) return npos;
+        if (verify(text.data() + p)) return p;
+    }
+    return npos;
+}
+
+}  // namespace rebel::search
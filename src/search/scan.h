@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace rebel::search {
+
+/// Instruction set the scanners below run on, chosen once per process
+/// from what the CPU reports: AVX2 where available on x86-64 (SSE2
+/// otherwise), NEON on AArch64, and plain loops anywhere else.
+enum class Isa { Scalar, Sse2, Avx2, Neon };
+
+Isa active_isa() noexcept;
+const char* isa_name(Isa isa) noexcept;
+
+constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+/// Offset of the first `byte` at or after `from`, or npos. This is
+/// memchr, which every C library we ship on already vectorizes.
+std::size_t find_byte(std::string_view text, char byte, std::size_t from = 0) noexcept;
+/// Offset of the last `byte` before `end`, or npos.
+std::size_t rfind_byte(std::string_view text, char byte, std::size_t end) noexcept;
+/// Number of `byte` in `text`; used for line numbers.
+std::size_t count_byte(std::string_view text, char byte) noexcept;
+
+/// Substring search that filters candidates 16 or 32 positions at a time.
+///
+/// Two bytes of the needle, picked for being rare in source code, are
+/// compared against the haystack with vector compares at their offsets;
+/// only positions where both agree are checked in full. On text where the
+/// needle is rare this runs at close to memory bandwidth, where a
+/// first-byte memchr loop stalls on every common first letter.
+/// `ignore_case` folds ASCII letters only.
+class LiteralFinder {
+public:
+    LiteralFinder() = default;
+    explicit LiteralFinder(std::string_view needle, bool ignore_case = false);
+
+    const std::string& needle() const noexcept { return needle_; }
+    bool ignore_case() const noexcept { return ignore_case_; }
+
+    /// Offset of the first occurrence at or after `from`, or npos. An empty
+    /// needle matches at `from`.
+    std::size_t find(std::string_view text, std::size_t from = 0) const noexcept;
+
+private:
+    bool verify(const char* at) const noexcept;
+
+    std::string needle_;  // lower-cased when ignoring case
+    bool ignore_case_ = false;
+    std::size_t first_ = 0;   // probe offsets into the needle, first_ <= second_
+    std::size_t second_ = 0;
+};
+
+}  // namespace rebel::search
@@ -0,0 +1,187 @@
+#include "search/workspace_search.h"
+
+#include "core/mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+namespace rebel::search {
+namespace {
+
+namespace fs = std::filesystem;
+
+// Files with a NUL byte this early are treated as binary.
+constexpr std::size_t kBinaryProbeBytes = 8 * 1024;
+
+// Context kept before the match when a long line is cut for its preview.
+constexpr std::size_t kPreviewLead = 40;
+
+}  // namespace
+
+SearchJob::SearchJob(core::ThreadPool& pool, std::string root, std::shared_ptr<const Query> query, Listener listener)
+    : pool_(pool), root_(std::move(root)), query_(std::move(query)), listener_(std::move(listener)) {}
+
+bool SearchJob::done() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_ == 0;
+}
+
+void SearchJob::wait() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return running_ == 0 && notifying_ == 0; });
+}
+
+std::vector<FileMatches> SearchJob::take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::exchange(results_, {});
+}
+
+SearchStats SearchJob::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void SearchJob::walk() {
+    std::vector<std::string> batch;
+    std::error_code error;
+    fs::recursive_directory_iterator it(root_, fs::directory_options::skip_permission_denied, error);
+    for (const fs::recursive_directory_iterator end; !error && it != end && !cancelled(); it.increment(error)) {
+        const fs::path& path = it->path();
+        if (it->is_directory(error)) {
+            const std::string name = path.filename().string();
+            if (!name.empty() && name[0] == '.') it.disable_recursion_pending();
+            continue;
+        }
+        if (!it->is_regular_file(error)) continue;
+        batch.push_back(path.lexically_relative(root_).generic_string());
+        if (batch.size() == kBatch) spawn(std::exchange(batch, {}));
+    }
+    if (!batch.empty() && !cancelled()) spawn(std::move(batch));
+    finish({}, {});
+}
+
+void SearchJob::spawn(std::vector<std::string> paths) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++running_;
+    }
+    pool_.submit([self = shared_from_this(), paths = std::move(paths)] { self->search_batch(paths); });
+}
+
+void SearchJob::search_batch(const std::vector<std::string>& paths) {
+    SearchStats stats;
+    std::vector<FileMatches> found;
+    for (const std::string& path : paths) {
+        if (cancelled()) break;
+        search_file(path, stats, found);
+    }
+    finish(stats, std::move(found));
+}
+
+void SearchJob::search_file(const std::string& path, SearchStats& stats, std::vector<FileMatches>& out) const {
+    std::shared_ptr<const core::MappedFile> file;
+    try {
+        file = core::MappedFile::open((fs::path(root_) / path).string());
+    } catch (const std::system_error&) {
+        return;  // vanished or unreadable since the walk
+    }
+    const std::string_view text = file->view();
+    if (text.empty()) {
+        ++stats.files;
+        return;
+    }
+    if (std::memchr(text.data(), 0, std::min(text.size(), kBinaryProbeBytes))) {
+        ++stats.binary;
+        return;
+    }
+    file->advise(core::MappedFile::Access::Sequential);
+    ++stats.files;
+
+    FileMatches result{path, {}};
+    std::size_t line = 0;
+    std::size_t counted = 0;  // newlines before here are in `line`
+    for (std::size_t begin = 0; begin < text.size() && !cancelled();) {
+        std::size_t end = text.size();
+        if (text.size() - begin > kWindowBytes) {
+            const std::size_t newline = find_byte(text, '\n', begin + kWindowBytes);
+            if (newline != npos) end = newline + 1;
+        }
+        const std::string_view window = text.substr(0, end);
+        for (std::size_t from = begin; from <= end;) {
+            const auto match = query_->find(window, from);
+            if (!match || (match->offset == end && end != text.size())) break;
+            line += count_byte(text.substr(counted, match->offset - counted), '\n');
+            counted = match->offset;
+            const std::size_t newline = rfind_byte(text, '\n', match->offset);
+            const std::size_t line_start = newline == npos ? 0 : newline + 1;
+            std::size_t line_end = find_byte(text, '\n', match->offset);
+            if (line_end == npos) line_end = text.size();
+
+            LineMatch hit;
+            hit.line = static_cast<std::uint32_t>(line);
+            hit.column = static_cast<std::uint32_t>(match->offset - line_start);
+            hit.length = static_cast<std::uint32_t>(match->length);
+            std::size_t cut = line_start;
+            if (line_end - line_start > kPreviewBytes && hit.column > kPreviewLead) {
+                cut = std::min(match->offset - kPreviewLead, line_end - kPreviewBytes);
+            }
+            hit.preview.assign(text.substr(cut, std::min(line_end - cut, kPreviewBytes)));
+            hit.preview_column = static_cast<std::uint32_t>(match->offset - cut);
+            result.matches.push_back(std::move(hit));
+            from = match->offset + std::max<std::size_t>(match->length, 1);
+        }
+        stats.bytes += end - begin;
+        begin = end;
+    }
+    if (!result.matches.empty()) {
+        ++stats.matched;
+        stats.matches += result.matches.size();
+        out.push_back(std::move(result));
+    }
+}
+
+void SearchJob::finish(const SearchStats& stats, std::vector<FileMatches> found) {
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.files += stats.files;
+        stats_.matched += stats.matched;
+        stats_.binary += stats.binary;
+        stats_.matches += stats.matches;
+        stats_.bytes += stats.bytes;
+        notify = listener_ && !found.empty();
+        for (FileMatches& file : found) results_.push_back(std::move(file));
+        if (--running_ == 0) {
+            stats_.elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - started_).count();
+            notify = static_cast<bool>(listener_);
+        }
+        if (notify) ++notifying_;
+        if (running_ == 0 && notifying_ == 0) finished_.notify_all();
+    }
+    if (!notify) return;
+    listener_();
+    // wait() must not return while the listener runs: it may use state the
+    // waiter is about to destroy.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--notifying_ == 0 && running_ == 0) finished_.notify_all();
+}
+
+WorkspaceSearch::~WorkspaceSearch() { cancel(); }
+
+std::shared_ptr<SearchJob> WorkspaceSearch::start(const std::string& root, std::shared_ptr<const Query> query,
+                                                  SearchJob::Listener listener) {
+    cancel();
+    current_ = std::shared_ptr<SearchJob>(new SearchJob(pool_, root, std::move(query), std::move(listener)));
+    pool_.submit([job = current_] { job->walk(); });
+    return current_;
+}
+
+void WorkspaceSearch::cancel() {
+    if (current_) current_->cancel();
+    current_.reset();
+}
+
+}  // namespace rebel::search
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "search/query.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rebel::search {
+
+/// One match in a file, with the line around it for the results list.
+struct LineMatch {
+    std::uint32_t line = 0;    // zero-based
+    std::uint32_t column = 0;  // byte offset into the line
+    std::uint32_t length = 0;
+    /// The line, cut to at most SearchJob::kPreviewBytes around the match,
+    /// which starts at `preview_column`.
+    std::string preview;
+    std::uint32_t preview_column = 0;
+};
+
+struct FileMatches {
+    std::string path;  // relative to the search root, '/'-separated
+    std::vector<LineMatch> matches;
+};
+
+struct SearchStats {
+    std::size_t files = 0;     // searched
+    std::size_t matched = 0;   // with at least one match
+    std::size_t binary = 0;    // skipped for a NUL byte near the start
+    std::size_t matches = 0;
+    std::size_t bytes = 0;     // searched
+    double elapsed_ms = 0;     // start to done; 0 while running
+};
+
+/// One workspace search in flight. Results are published file by file as
+/// workers finish them, so the UI can list the first hits while the rest
+/// of the tree is still being searched.
+class SearchJob : public std::enable_shared_from_this<SearchJob> {
+public:
+    /// Called on a worker thread whenever take() has something new, and
+    /// once more when the job is done.
+    using Listener = std::function<void()>;
+
+    static constexpr std::size_t kPreviewBytes = 200;
+
+    /// Stops the search: workers check between files and every
+    /// kWindowBytes within one, and queued work drains without reading.
+    void cancel() noexcept { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const noexcept { return cancelled_.load(std::memory_order_relaxed); }
+
+    /// Whether every worker has finished, after completing or cancelling.
+    bool done() const;
+    /// Blocks until done() and every listener call has returned.
+    void wait() const;
+
+    /// Files finished since the previous call, in completion order.
+    std::vector<FileMatches> take();
+    SearchStats stats() const;
+
+private:
+    friend class WorkspaceSearch;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t kBatch = 64;                 // files per task
+    static constexpr std::size_t kWindowBytes = 1024 * 1024;  // between cancellation checks
+
+    SearchJob(core::ThreadPool& pool, std::string root, std::shared_ptr<const Query> query, Listener listener);
+
+    void walk();
+    void search_batch(const std::vector<std::string>& paths);
+    void search_file(const std::string& path, SearchStats& stats, std::vector<FileMatches>& out) const;
+    void spawn(std::vector<std::string> paths);
+    void finish(const SearchStats& stats, std::vector<FileMatches> found);
+
+    core::ThreadPool& pool_;
+    const std::string root_;
+    const std::shared_ptr<const Query> query_;
+    const Listener listener_;
+    const Clock::time_point started_ = Clock::now();
+    std::atomic<bool> cancelled_{false};
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable finished_;
+    std::size_t running_ = 1;    // tasks queued or running, the walk included
+    std::size_t notifying_ = 0;  // listener calls in progress
+    std::vector<FileMatches> results_;
+    SearchStats stats_;
+};
+
+/// Searches the files under a root on a shared worker pool, one search at
+/// a time: starting a new one cancels the previous, which stops at its
+/// next check without the caller waiting for it. Directories whose names
+/// start with '.' are skipped, as are files with a NUL byte in their first
+/// 8 KiB.
+class WorkspaceSearch {
+public:
+    explicit WorkspaceSearch(core::ThreadPool& pool) : pool_(pool) {}
+    /// Cancels the running search.
+    ~WorkspaceSearch();
+
+    WorkspaceSearch(const WorkspaceSearch&) = delete;
+    WorkspaceSearch& operator=(const WorkspaceSearch&) = delete;
+
+    std::shared_ptr<SearchJob> start(const std::string& root, std::shared_ptr<const Query> query,
+                                     SearchJob::Listener listener = {});
+    void cancel();
+
+private:
+    core::ThreadPool& pool_;
+    std::shared_ptr<SearchJob> current_;
+};
+
+}  // namespace rebel::search
@@ -0,0 +1,83 @@
+#include "syntax/highlight_session.h"
+
+#include "core/trace.h"
+
+#include <utility>
+
+namespace rebel::syntax {
+
+std::shared_ptr<HighlightSession> HighlightSession::create(core::ThreadPool& pool, const LanguageSpec& spec,
+                                                           text::Rope text) {
+    std::shared_ptr<HighlightSession> session(new HighlightSession(pool, spec, std::move(text)));
+    std::lock_guard<std::mutex> lock(session->mutex_);
+    session->schedule_locked();
+    return session;
+}
+
+HighlightSession::HighlightSession(core::ThreadPool& pool, const LanguageSpec& spec, text::Rope text)
+    : pool_(pool), highlighter_(spec), pending_text_(std::move(text)) {}
+
+std::uint64_t HighlightSession::update(text::Rope text, const LineEdit& edit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_text_ = std::move(text);
+    if (!reset_pending_) pending_edits_.push_back(edit);
+    schedule_locked();
+    return ++next_version_;
+}
+
+std::shared_ptr<const HighlightSnapshot> HighlightSession::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_;
+}
+
+std::shared_ptr<const HighlightSnapshot> HighlightSession::wait_for(std::uint64_t version) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    published_.wait(lock, [&] { return snapshot_ && snapshot_->version() >= version; });
+    return snapshot_;
+}
+
+void HighlightSession::set_listener(Listener listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    listener_ = std::move(listener);
+}
+
+HighlightSession::Stats HighlightSession::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void HighlightSession::schedule_locked() {
+    if (scheduled_) return;
+    scheduled_ = true;
+    pool_.submit([self = shared_from_this()] { self->run_pass(); });
+}
+
+void HighlightSession::run_pass() {
+    REBEL_TRACE_SCOPE("syntax.highlight");
+    std::unique_lock<std::mutex> lock(mutex_);
+    const text::Rope text = pending_text_;
+    const std::vector<LineEdit> edits = std::move(pending_edits_);
+    pending_edits_.clear();
+    const bool reset = reset_pending_;
+    reset_pending_ = false;
+    const std::uint64_t version = next_version_;
+    lock.unlock();
+
+    const std::size_t lexed = reset ? highlighter_.reset(text) : highlighter_.apply(text, edits);
+    auto snapshot = highlighter_.snapshot(version);
+
+    lock.lock();
+    snapshot_ = snapshot;
+    ++stats_.passes;
+    stats_.lines_lexed += lexed;
+    // Anything queued while this pass ran becomes the next pass.
+    scheduled_ = false;
+    if (next_version_ != version) schedule_locked();
+    const Listener listener = listener_;
+    lock.unlock();
+
+    published_.notify_all();
+    if (listener) listener(snapshot);
+}
+
+}  // namespace rebel::syntax
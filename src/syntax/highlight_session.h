@@ -0,0 +1,69 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "syntax/highlighter.h"
+#include "text/rope.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rebel::syntax {
+
+/// Highlights one document on a shared worker pool.
+///
+/// The UI thread calls update() after each edit and reads snapshot() when
+/// painting; neither ever waits for lexing. At most one pass per session is
+/// in flight: edits that arrive meanwhile are coalesced into the next pass,
+/// which lexes only against the newest text.
+class HighlightSession : public std::enable_shared_from_this<HighlightSession> {
+public:
+    using Listener = std::function<void(const std::shared_ptr<const HighlightSnapshot>&)>;
+
+    struct Stats {
+        std::uint64_t passes = 0;
+        std::uint64_t lines_lexed = 0;
+    };
+
+    /// Schedules a full lex of `text` as version 0.
+    static std::shared_ptr<HighlightSession> create(core::ThreadPool& pool, const LanguageSpec& spec,
+                                                    text::Rope text);
+
+    /// Queues `edit`, which turned the previously submitted text into
+    /// `text`. Returns the version its snapshot will carry.
+    std::uint64_t update(text::Rope text, const LineEdit& edit);
+
+    /// Latest published snapshot; null until the initial pass finishes.
+    std::shared_ptr<const HighlightSnapshot> snapshot() const;
+    /// Blocks until a snapshot at `version` or later has been published.
+    std::shared_ptr<const HighlightSnapshot> wait_for(std::uint64_t version) const;
+
+    /// Invoked on a worker thread after every publish.
+    void set_listener(Listener listener);
+    Stats stats() const;
+
+private:
+    HighlightSession(core::ThreadPool& pool, const LanguageSpec& spec, text::Rope text);
+
+    void schedule_locked();
+    void run_pass();
+
+    core::ThreadPool& pool_;
+    Highlighter highlighter_;  // owned by whichever pass is in flight
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable published_;
+    text::Rope pending_text_;
+    std::vector<LineEdit> pending_edits_;
+    bool reset_pending_ = true;
+    bool scheduled_ = false;
+    std::uint64_t next_version_ = 0;
+    std::shared_ptr<const HighlightSnapshot> snapshot_;
+    Listener listener_;
+    Stats stats_;
+};
+
+}  // namespace rebel::syntax
@@ -0,0 +1,208 @@
+#include "syntax/highlighter.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace rebel::syntax {
+namespace {
+
+// Lines still to be re-lexed after a batch of edits, in post-edit numbering.
+struct Region {
+    std::size_t first;
+    std::size_t end;
+};
+
+}  // namespace
+
+LineEdit LineEdit::for_replace(const text::Rope& before, std::size_t offset, std::size_t length,
+                               std::string_view text) {
+    LineEdit edit;
+    edit.first = before.position_of(offset).line;
+    std::size_t removed_newlines = 0;
+    before.for_each_chunk(offset, length, [&](std::string_view chunk) {
+        removed_newlines += static_cast<std::size_t>(std::count(chunk.begin(), chunk.end(), '\n'));
+        return true;
+    });
+    edit.removed = removed_newlines + 1;
+    edit.added = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n')) + 1;
+    return edit;
+}
+
+const LineHighlight& HighlightSnapshot::line(std::size_t line) const {
+    if (line >= line_count_) throw std::out_of_range("highlight line out of range");
+    const auto it = std::upper_bound(starts_.begin(), starts_.end(), line);
+    const auto block = static_cast<std::size_t>(it - starts_.begin()) - 1;
+    return blocks_[block]->lines[line - starts_[block]];
+}
+
+Highlighter::Highlighter(const LanguageSpec& spec) : lexer_(spec) {}
+
+Highlighter::Cursor Highlighter::locate(std::size_t line) const {
+    if (line >= line_count_) return {blocks_.size() - 1, blocks_.back()->lines.size()};
+    const auto it = std::upper_bound(starts_.begin(), starts_.end(), line);
+    const auto block = static_cast<std::size_t>(it - starts_.begin()) - 1;
+    return {block, line - starts_[block]};
+}
+
+detail::LineBlock& Highlighter::writable(std::size_t block) {
+    // Blocks still referenced by a published snapshot are copied first.
+    if (blocks_[block].use_count() > 1) blocks_[block] = std::make_shared<detail::LineBlock>(*blocks_[block]);
+    return *blocks_[block];
+}
+
+void Highlighter::reindex() {
+    starts_.resize(blocks_.size());
+    std::size_t line = 0;
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+        starts_[b] = line;
+        line += blocks_[b]->lines.size();
+    }
+}
+
+void Highlighter::erase_lines(std::size_t first, std::size_t count) {
+    count = std::min(count, line_count_ - std::min(first, line_count_));
+    while (count > 0) {
+        const Cursor at = locate(first);
+        detail::LineBlock& block = writable(at.block);
+        const std::size_t take = std::min(count, block.lines.size() - at.offset);
+        const auto begin = block.lines.begin() + static_cast<std::ptrdiff_t>(at.offset);
+        block.lines.erase(begin, begin + static_cast<std::ptrdiff_t>(take));
+        line_count_ -= take;
+        count -= take;
+
+        if (block.lines.empty()) {
+            blocks_.erase(blocks_.begin() + static_cast<std::ptrdiff_t>(at.block));
+        } else if (block.lines.size() < kBlockLines / 4 && at.block + 1 < blocks_.size() &&
+                   block.lines.size() + blocks_[at.block + 1]->lines.size() <= kBlockLines) {
+            const auto& next = blocks_[at.block + 1]->lines;
+            block.lines.insert(block.lines.end(), next.begin(), next.end());
+            blocks_.erase(blocks_.begin() + static_cast<std::ptrdiff_t>(at.block) + 1);
+        }
+        reindex();
+    }
+}
+
+void Highlighter::insert_lines(std::size_t first, std::size_t count) {
+    if (count == 0) return;
+    if (blocks_.empty()) {
+        blocks_.push_back(std::make_shared<detail::LineBlock>());
+        starts_.assign(1, 0);
+    }
+    const Cursor at = locate(first);
+    detail::LineBlock& block = writable(at.block);
+    block.lines.insert(block.lines.begin() + static_cast<std::ptrdiff_t>(at.offset), count, LineHighlight{});
+    line_count_ += count;
+
+    if (block.lines.size() > 2 * kBlockLines) {
+        std::vector<std::shared_ptr<detail::LineBlock>> pieces;
+        for (std::size_t i = 0; i < block.lines.size(); i += kBlockLines) {
+            auto piece = std::make_shared<detail::LineBlock>();
+            const auto from = block.lines.begin() + static_cast<std::ptrdiff_t>(i);
+            const auto to = block.lines.begin() + static_cast<std::ptrdiff_t>(std::min(i + kBlockLines, block.lines.size()));
+            piece->lines.assign(std::make_move_iterator(from), std::make_move_iterator(to));
+            pieces.push_back(std::move(piece));
+        }
+        const auto pos = blocks_.erase(blocks_.begin() + static_cast<std::ptrdiff_t>(at.block));
+        blocks_.insert(pos, pieces.begin(), pieces.end());
+    }
+    reindex();
+}
+
+// Lexes at least `min_count` lines from `first`, then keeps going until a
+// line's stored start state matches the state flowing into it. Returns the
+// first line that was not lexed.
+std::size_t Highlighter::relex(const text::Rope& text, std::size_t first, std::size_t min_count) {
+    if (first >= line_count_) return first;
+    LexState state = LexState::Normal;
+    if (first > 0) {
+        const Cursor prev = locate(first - 1);
+        state = blocks_[prev.block]->lines[prev.offset].end;
+    }
+
+    Cursor at = locate(first);
+    std::size_t line = first;
+    std::size_t start = text.line_start(first);
+    while (line < line_count_) {
+        if (at.offset == blocks_[at.block]->lines.size()) {
+            ++at.block;
+            at.offset = 0;
+        }
+        if (line >= first + min_count && blocks_[at.block]->lines[at.offset].start == state) break;
+
+        const std::size_t end = text.line_end(line);
+        scratch_.clear();
+        text.for_each_chunk(start, end - start, [this](std::string_view chunk) {
+            scratch_.append(chunk);
+            return true;
+        });
+
+        LineHighlight& highlight = writable(at.block).lines[at.offset];
+        highlight.start = state;
+        highlight.tokens.clear();
+        state = lexer_.lex_line(scratch_, state, highlight.tokens);
+        highlight.end = state;
+
+        start = end + 1;
+        ++line;
+        ++at.offset;
+    }
+    return line;
+}
+
+std::size_t Highlighter::reset(const text::Rope& text) {
+    blocks_.clear();
+    starts_.clear();
+    line_count_ = 0;
+    insert_lines(0, text.line_count());
+    return relex(text, 0, line_count_);
+}
+
+std::size_t Highlighter::apply(const text::Rope& text, const std::vector<LineEdit>& edits) {
+    std::vector<Region> regions;
+    for (const LineEdit& edit : edits) {
+        erase_lines(edit.first, edit.removed);
+        insert_lines(edit.first, edit.added);
+
+        // Renumber earlier regions into post-edit lines, folding any that
+        // overlap the replaced lines into this edit's region.
+        const std::size_t removed_end = edit.first + edit.removed;
+        Region merged{edit.first, edit.first + edit.added};
+        std::vector<Region> kept;
+        kept.reserve(regions.size() + 1);
+        for (const Region& r : regions) {
+            if (r.end <= edit.first) {
+                kept.push_back(r);
+            } else if (r.first >= removed_end) {
+                kept.push_back({r.first - edit.removed + edit.added, r.end - edit.removed + edit.added});
+            } else {
+                merged.first = std::min(merged.first, r.first);
+                if (r.end > removed_end) merged.end = std::max(merged.end, r.end - edit.removed + edit.added);
+            }
+        }
+        kept.push_back(merged);
+        regions = std::move(kept);
+    }
+
+    std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.first < b.first; });
+    std::size_t done = 0;
+    std::size_t lexed = 0;
+    for (const Region& r : regions) {
+        if (r.first < done && r.end <= done) continue;
+        const std::size_t from = std::max(r.first, done);
+        done = relex(text, from, r.end > from ? r.end - from : 0);
+        lexed += done - from;
+    }
+    return lexed;
+}
+
+std::shared_ptr<const HighlightSnapshot> Highlighter::snapshot(std::uint64_t version) const {
+    auto snapshot = std::make_shared<HighlightSnapshot>();
+    snapshot->version_ = version;
+    snapshot->line_count_ = line_count_;
+    snapshot->blocks_.assign(blocks_.begin(), blocks_.end());
+    snapshot->starts_ = starts_;
+    return snapshot;
+}
+
+}  // namespace rebel::syntax
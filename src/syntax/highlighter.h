@@ -0,0 +1,106 @@
+#pragma once
+
+#include "syntax/lexer.h"
+#include "text/rope.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::syntax {
+
+/// Tokens of one line plus the lexer state it was lexed from and ended in.
+struct LineHighlight {
+    LexState start = LexState::Invalid;
+    LexState end = LexState::Invalid;
+    std::vector<Token> tokens;
+};
+
+/// Replacement of `removed` whole lines starting at `first` by `added` lines.
+struct LineEdit {
+    std::size_t first = 0;
+    std::size_t removed = 0;
+    std::size_t added = 0;
+
+    /// The lines touched by `before.replace(offset, length, text)`.
+    static LineEdit for_replace(const text::Rope& before, std::size_t offset, std::size_t length,
+                                std::string_view text);
+};
+
+namespace detail {
+struct LineBlock {
+    std::vector<LineHighlight> lines;
+};
+}  // namespace detail
+
+/// Immutable highlighting of a whole document at one version. Snapshots
+/// share every line block that did not change between them.
+class HighlightSnapshot {
+public:
+    std::uint64_t version() const noexcept { return version_; }
+    std::size_t line_count() const noexcept { return line_count_; }
+    /// Throws std::out_of_range past the last line.
+    const LineHighlight& line(std::size_t line) const;
+
+private:
+    friend class Highlighter;
+
+    std::uint64_t version_ = 0;
+    std::size_t line_count_ = 0;
+    std::vector<std::shared_ptr<const detail::LineBlock>> blocks_;
+    std::vector<std::size_t> starts_;  // first line of each block
+};
+
+/// Line-state incremental highlighter.
+///
+/// Each line remembers the lexer state it started in. After an edit only the
+/// edited lines are lexed, and lexing continues past them just until a line
+/// is reached whose recorded start state matches the freshly computed one;
+/// from there on the old tokens are still correct. Typing inside a line
+/// therefore re-lexes one line, while opening a block comment re-lexes up to
+/// where it closes. Line data lives in copy-on-write blocks so a snapshot
+/// costs O(lines / kBlockLines).
+///
+/// Not thread-safe; see HighlightSession for the threaded wrapper.
+class Highlighter {
+public:
+    static constexpr std::size_t kBlockLines = 256;
+
+    explicit Highlighter(const LanguageSpec& spec);
+
+    /// Lexes all of `text` from scratch; returns the number of lines lexed.
+    std::size_t reset(const text::Rope& text);
+    /// Applies `edits` in order, then re-lexes against `text`, the document
+    /// after the last edit. Returns the number of lines lexed.
+    std::size_t apply(const text::Rope& text, const std::vector<LineEdit>& edits);
+    std::size_t apply(const text::Rope& text, const LineEdit& edit) {
+        return apply(text, std::vector<LineEdit>{edit});
+    }
+
+    std::size_t line_count() const noexcept { return line_count_; }
+    std::shared_ptr<const HighlightSnapshot> snapshot(std::uint64_t version) const;
+
+private:
+    struct Cursor {
+        std::size_t block = 0;
+        std::size_t offset = 0;
+    };
+
+    Cursor locate(std::size_t line) const;
+    detail::LineBlock& writable(std::size_t block);
+    void erase_lines(std::size_t first, std::size_t count);
+    void insert_lines(std::size_t first, std::size_t count);
+    void reindex();
+    std::size_t relex(const text::Rope& text, std::size_t first, std::size_t min_count);
+
+    Lexer lexer_;
+    std::vector<std::shared_ptr<detail::LineBlock>> blocks_;
+    std::vector<std::size_t> starts_;
+    std::size_t line_count_ = 0;
+    std::string scratch_;
+};
+
+}  // namespace rebel::syntax
@@ -0,0 +1,60 @@
+#include "syntax/language.h"
+
+namespace rebel::syntax {
+
+const LanguageSpec& cpp_language() {
+    static const LanguageSpec spec{
+        "cpp",
+        {"alignas",   "alignof",  "auto",      "break",    "case",      "catch",    "class",
+         "co_await",  "co_return", "co_yield", "const",    "consteval", "constexpr", "constinit",
+         "continue",  "decltype", "default",   "delete",   "do",        "else",     "enum",
+         "explicit",  "export",   "extern",    "false",    "final",     "for",      "friend",
+         "goto",      "if",       "inline",    "mutable",  "namespace", "new",      "noexcept",
+         "nullptr",   "operator", "override",  "private",  "protected", "public",   "return",
+         "sizeof",    "static",   "static_assert", "static_cast", "struct", "switch", "template",
+         "this",      "throw",    "true",      "try",      "typedef",   "typename", "union",
+         "using",     "virtual",  "volatile",  "while"},
+        {"bool", "char", "char8_t", "char16_t", "char32_t", "double", "float", "int", "long",
+         "short", "signed", "unsigned", "void", "wchar_t", "size_t", "int8_t", "int16_t",
+         "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t"},
+        "//",
+        "/*",
+        "*/",
+        "\"'",
+        true,
+    };
+    return spec;
+}
+
+const LanguageSpec& script_language() {
+    static const LanguageSpec spec{
+        "rebel",
+        {"and", "break", "continue", "else", "false", "fn", "for", "if", "in", "let", "nil",
+         "not", "or", "return", "true", "while"},
+        {},
+        "//",
+        "/*",
+        "*/",
+        "\"'",
+        false,
+    };
+    return spec;
+}
+
+const LanguageSpec& plain_language() {
+    static const LanguageSpec spec{"plain", {}, {}, "", "", "", "", false};
+    return spec;
+}
+
+const LanguageSpec& language_for_path(const std::string& path) {
+    const auto dot = path.rfind('.');
+    if (dot == std::string::npos) return plain_language();
+    const std::string ext = path.substr(dot + 1);
+    for (const char* cpp : {"c", "cc", "cpp", "cxx", "h", "hh", "hpp", "hxx", "inl"}) {
+        if (ext == cpp) return cpp_language();
+    }
+    if (ext == "rbl") return script_language();
+    return plain_language();
+}
+
+}  // namespace rebel::syntax
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace rebel::syntax {
+
+/// Lexical description of a language, enough to drive the line lexer.
+struct LanguageSpec {
+    std::string name;
+    std::vector<std::string> keywords;
+    std::vector<std::string> types;
+    std::string line_comment;   ///< Empty if the language has none.
+    std::string block_open;     ///< Empty if the language has no block comments.
+    std::string block_close;
+    std::string quotes = "\"'";  ///< Characters that open and close string literals.
+    bool preprocessor = false;  ///< `#` at the start of a line begins a directive.
+};
+
+const LanguageSpec& cpp_language();
+/// The scripting language run by the script engine.
+const LanguageSpec& script_language();
+/// No highlighting beyond splitting words and punctuation.
+const LanguageSpec& plain_language();
+
+/// Picks a language from a file name's extension, falling back to plain.
+const LanguageSpec& language_for_path(const std::string& path);
+
+}  // namespace rebel::syntax
@@ -0,0 +1,189 @@
+#include "syntax/lexer.h"
+
+#include <cstring>
+
+namespace rebel::syntax {
+namespace {
+
+constexpr auto npos = std::string_view::npos;
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Bytes >= 0x80 count as word characters so UTF-8 identifiers stay whole.
+bool is_word_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+           static_cast<unsigned char>(c) >= 0x80;
+}
+
+bool is_word(char c) { return is_word_start(c) || is_digit(c); }
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+
+bool is_operator(char c) { return c != '\0' && std::strchr("+-*/%=<>!&|^~?:@$", c) != nullptr; }
+
+bool is_punctuation(char c) { return c != '\0' && std::strchr("()[]{},;.#\\", c) != nullptr; }
+
+bool starts_with_at(std::string_view text, std::size_t pos, std::string_view prefix) {
+    return !prefix.empty() && text.compare(pos, prefix.size(), prefix) == 0;
+}
+
+// Position just past the closing `quote`, honouring backslash escapes, or
+// npos if the string runs to the end of the line.
+std::size_t scan_string(std::string_view line, std::size_t from, char quote) {
+    for (std::size_t j = from; j < line.size(); ++j) {
+        if (line[j] == '\\') {
+            ++j;
+        } else if (line[j] == quote) {
+            return j + 1;
+        }
+    }
+    return npos;
+}
+
+bool continues(std::string_view line) { return !line.empty() && line.back() == '\\'; }
+
+}  // namespace
+
+const char* token_kind_name(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::Text: return "text";
+        case TokenKind::Keyword: return "keyword";
+        case TokenKind::Type: return "type";
+        case TokenKind::Identifier: return "identifier";
+        case TokenKind::Function: return "function";
+        case TokenKind::Number: return "number";
+        case TokenKind::String: return "string";
+        case TokenKind::Comment: return "comment";
+        case TokenKind::Operator: return "operator";
+        case TokenKind::Punctuation: return "punctuation";
+        case TokenKind::Preprocessor: return "preprocessor";
+    }
+    return "text";
+}
+
+Lexer::Lexer(const LanguageSpec& spec) : spec_(spec) {
+    for (const std::string& word : spec_.keywords) keywords_.insert(word);
+    for (const std::string& word : spec_.types) types_.insert(word);
+}
+
+TokenKind Lexer::classify_word(std::string_view word) const {
+    if (keywords_.count(word)) return TokenKind::Keyword;
+    if (types_.count(word)) return TokenKind::Type;
+    return TokenKind::Identifier;
+}
+
+LexState Lexer::lex_line(std::string_view line, LexState state, std::vector<Token>& out) const {
+    const std::size_t n = line.size();
+    auto emit = [&out](std::size_t start, std::size_t end, TokenKind kind) {
+        if (end > start) {
+            out.push_back({static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(end - start), kind});
+        }
+    };
+
+    std::size_t i = 0;
+    // Finish whatever the previous line left open.
+    if (state == LexState::BlockComment) {
+        const std::size_t close = line.find(spec_.block_close);
+        if (close == npos) {
+            emit(0, n, TokenKind::Comment);
+            return LexState::BlockComment;
+        }
+        i = close + spec_.block_close.size();
+        emit(0, i, TokenKind::Comment);
+    } else if (state == LexState::Preprocessor) {
+        emit(0, n, TokenKind::Preprocessor);
+        return continues(line) ? LexState::Preprocessor : LexState::Normal;
+    } else if (state >= LexState::String && state != LexState::Invalid) {
+        const auto quote_index = static_cast<std::size_t>(state) - static_cast<std::size_t>(LexState::String);
+        const std::size_t end = scan_string(line, 0, spec_.quotes[quote_index]);
+        if (end == npos) {
+            emit(0, n, TokenKind::String);
+            return continues(line) ? state : LexState::Normal;
+        }
+        emit(0, end, TokenKind::String);
+        i = end;
+    } else if (spec_.preprocessor) {
+        std::size_t first = 0;
+        while (first < n && is_space(line[first])) ++first;
+        if (first < n && line[first] == '#') {
+            emit(first, n, TokenKind::Preprocessor);
+            return continues(line) ? LexState::Preprocessor : LexState::Normal;
+        }
+    }
+
+    while (i < n) {
+        const char c = line[i];
+        if (is_space(c)) {
+            ++i;
+            continue;
+        }
+        if (starts_with_at(line, i, spec_.line_comment)) {
+            emit(i, n, TokenKind::Comment);
+            return LexState::Normal;
+        }
+        if (starts_with_at(line, i, spec_.block_open)) {
+            const std::size_t close = line.find(spec_.block_close, i + spec_.block_open.size());
+            if (close == npos) {
+                emit(i, n, TokenKind::Comment);
+                return LexState::BlockComment;
+            }
+            emit(i, close + spec_.block_close.size(), TokenKind::Comment);
+            i = close + spec_.block_close.size();
+            continue;
+        }
+        if (const std::size_t quote = spec_.quotes.find(c); quote != npos) {
+            const std::size_t end = scan_string(line, i + 1, c);
+            if (end == npos) {
+                emit(i, n, TokenKind::String);
+                return continues(line) ? static_cast<LexState>(static_cast<std::size_t>(LexState::String) + quote)
+                                       : LexState::Normal;
+            }
+            emit(i, end, TokenKind::String);
+            i = end;
+            continue;
+        }
+        if (is_digit(c) || (c == '.' && i + 1 < n && is_digit(line[i + 1]))) {
+            std::size_t j = i + 1;
+            while (j < n) {
+                const char d = line[j];
+                const char prev = line[j - 1];
+                if (is_word(d) || d == '.' || ((d == '+' || d == '-') && (prev == 'e' || prev == 'E'))) {
+                    ++j;
+                } else {
+                    break;
+                }
+            }
+            emit(i, j, TokenKind::Number);
+            i = j;
+            continue;
+        }
+        if (is_word_start(c)) {
+            std::size_t j = i + 1;
+            while (j < n && is_word(line[j])) ++j;
+            TokenKind kind = classify_word(line.substr(i, j - i));
+            if (kind == TokenKind::Identifier) {
+                std::size_t k = j;
+                while (k < n && is_space(line[k])) ++k;
+                if (k < n && line[k] == '(') kind = TokenKind::Function;
+            }
+            emit(i, j, kind);
+            i = j;
+            continue;
+        }
+        if (is_operator(c)) {
+            std::size_t j = i + 1;
+            while (j < n && is_operator(line[j]) && !starts_with_at(line, j, spec_.line_comment) &&
+                   !starts_with_at(line, j, spec_.block_open)) {
+                ++j;
+            }
+            emit(i, j, TokenKind::Operator);
+            i = j;
+            continue;
+        }
+        emit(i, i + 1, is_punctuation(c) ? TokenKind::Punctuation : TokenKind::Text);
+        ++i;
+    }
+    return LexState::Normal;
+}
+
+}  // namespace rebel::syntax
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "syntax/language.h"
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace rebel::syntax {
+
+enum class TokenKind : std::uint8_t {
+    Text,
+    Keyword,
+    Type,
+    Identifier,
+    Function,  ///< Identifier directly followed by '('.
+    Number,
+    String,
+    Comment,
+    Operator,
+    Punctuation,
+    Preprocessor,
+};
+
+const char* token_kind_name(TokenKind kind);
+
+/// A highlighted span within one line; offsets are bytes from the line start.
+struct Token {
+    std::uint32_t start = 0;
+    std::uint32_t length = 0;
+    TokenKind kind = TokenKind::Text;
+};
+
+/// Lexer mode carried from the end of one line into the next.
+enum class LexState : std::uint8_t {
+    Normal,
+    BlockComment,
+    Preprocessor,  ///< Directive continued with a trailing backslash.
+    /// String continued with a trailing backslash; the quote is
+    /// LanguageSpec::quotes[state - String].
+    String,
+    /// Never produced by the lexer; marks lines whose state is unknown.
+    Invalid = 0xff,
+};
+
+/// Single-line, restartable lexer. All state that crosses a line boundary
+/// lives in LexState, which is what lets the highlighter re-lex from any
+/// line without looking further back.
+class Lexer {
+public:
+    explicit Lexer(const LanguageSpec& spec);
+
+    // The word sets point into spec_.
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+
+    /// Appends the tokens of `line` (without its newline) to `out` and returns
+    /// the state at the end of the line. Whitespace produces no tokens.
+    LexState lex_line(std::string_view line, LexState state, std::vector<Token>& out) const;
+
+    const LanguageSpec& spec() const noexcept { return spec_; }
+
+private:
+    TokenKind classify_word(std::string_view word) const;
+
+    LanguageSpec spec_;
+    std::unordered_set<std::string_view> keywords_;
+    std::unordered_set<std::string_view> types_;
+};
+
+}  // namespace rebel::syntax
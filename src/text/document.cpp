@@ -0,0 +1,82 @@
+#include "text/document.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace rebel::text {
+
+std::unique_ptr<TextDocument> TextDocument::open(const std::string& path) {
+    std::unique_ptr<TextDocument> doc(new TextDocument());
+    doc->path_ = path;
+    doc->file_ = core::MappedFile::open(path);
+    doc->file_->advise(core::MappedFile::Access::Sequential);
+    doc->index_ = std::make_unique<LineIndex>(doc->file_->view());
+    return doc;
+}
+
+TextDocument::TextDocument(Rope rope) : rope_(std::move(rope)) {}
+
+std::size_t TextDocument::size() const noexcept { return rope_ ? rope_->size() : file_->size(); }
+
+bool TextDocument::index_ready() const noexcept { return rope_ || index_->complete(); }
+
+std::vector<std::string> TextDocument::lines(std::size_t first, std::size_t count) const {
+    std::vector<std::string> out;
+    if (rope_) {
+        const std::size_t last = std::min(rope_->line_count(), first + count);
+        for (std::size_t line = first; line < last; ++line) out.push_back(rope_->line(line));
+        return out;
+    }
+
+    const std::optional<std::size_t> start = index_->line_start(first);
+    if (!start) return out;
+    const char* pos = file_->data() + *start;
+    const char* end = file_->data() + file_->size();
+    while (out.size() < count) {
+        const auto* newline =
+            pos == end ? nullptr
+                       : static_cast<const char*>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+        out.emplace_back(pos, newline ? newline : end);
+        if (!newline) break;
+        pos = newline + 1;
+    }
+    return out;
+}
+
+const Rope& TextDocument::rope() {
+    if (!rope_) rope_ = Rope::from_chunks(file_, index_->chunks());
+    return *rope_;
+}
+
+void TextDocument::replace(std::size_t offset, std::size_t length, std::string_view text) {
+    UndoTree& undo = history();
+    const std::size_t removed = std::min(length, rope_->size() - std::min(offset, rope_->size()));
+    rope_->replace(offset, length, text);
+    undo.record(offset, removed, text.size());
+}
+
+void TextDocument::checkpoint() {
+    if (history_) history_->commit(*rope_);
+}
+
+bool TextDocument::undo() {
+    checkpoint();
+    if (!history().undo()) return false;
+    rope_ = history_->text();
+    return true;
+}
+
+bool TextDocument::redo() {
+    checkpoint();
+    if (!history().redo()) return false;
+    rope_ = history_->text();
+    return true;
+}
+
+UndoTree& TextDocument::history() {
+    if (!history_) history_ = std::make_unique<UndoTree>(rope());
+    return *history_;
+}
+
+}  // namespace rebel::text
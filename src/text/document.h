@@ -0,0 +1,70 @@
+#pragma once
+
+#include "core/mapped_file.h"
+#include "text/line_index.h"
+#include "text/rope.h"
+#include "text/undo.h"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::text {
+
+/// A text buffer opened for editing.
+///
+/// open() maps the file and returns without reading it. The line index is
+/// built on a background thread while lines() serves the first screen
+/// straight from the mapping. The Rope is assembled from the finished index
+/// on first use; its leaves reference the mapped pages until they are edited.
+///
+/// Edits go into an UndoTree started from the text as opened, a step per
+/// checkpoint().
+class TextDocument {
+public:
+    /// Throws std::system_error if the file cannot be mapped.
+    static std::unique_ptr<TextDocument> open(const std::string& path);
+
+    /// In-memory document with no backing file.
+    explicit TextDocument(Rope rope);
+
+    TextDocument(const TextDocument&) = delete;
+    TextDocument& operator=(const TextDocument&) = delete;
+
+    /// Empty for in-memory documents.
+    const std::string& path() const noexcept { return path_; }
+    std::size_t size() const noexcept;
+    bool index_ready() const noexcept;
+
+    /// Up to `count` lines starting at `first`, without their newlines.
+    /// Before the rope exists this only waits for the background index when
+    /// `first` lies beyond the part already scanned.
+    std::vector<std::string> lines(std::size_t first, std::size_t count) const;
+
+    /// The document text; waits for the line index on first call.
+    const Rope& rope();
+    void replace(std::size_t offset, std::size_t length, std::string_view text);
+
+    /// Ends an undo step: the edits since the last one undo together.
+    void checkpoint();
+    /// Checkpoints, then goes back a step; false if there is none.
+    bool undo();
+    /// Goes forward again along the steps undone; false if there is none.
+    bool redo();
+    /// The undo tree, for moving between branches; checkpoint() first.
+    UndoTree& history();
+
+private:
+    TextDocument() = default;
+
+    std::string path_;
+    std::shared_ptr<const core::MappedFile> file_;
+    std::unique_ptr<LineIndex> index_;
+    std::optional<Rope> rope_;
+    std::unique_ptr<UndoTree> history_;
+};
+
+}  // namespace rebel::text
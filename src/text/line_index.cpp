@@ -0,0 +1,98 @@
+#include "text/line_index.h"
+
+#include <algorithm>
+
+namespace rebel::text {
+namespace {
+
+// Scanner wakes waiters once per this many blocks rather than per block.
+constexpr std::size_t kNotifyBlocks = 16;
+
+}  // namespace
+
+LineIndex::LineIndex(std::string_view text)
+    : text_(text), prefix_((text.size() + kBlockBytes - 1) / kBlockBytes + 1, 0) {
+    if (block_count() > 0) worker_ = std::thread([this] { scan(); });
+}
+
+LineIndex::~LineIndex() {
+    cancelled_.store(true, std::memory_order_relaxed);
+    if (worker_.joinable()) worker_.join();
+}
+
+void LineIndex::scan() {
+    const std::size_t blocks = block_count();
+    for (std::size_t b = 0; b < blocks; ++b) {
+        if (cancelled_.load(std::memory_order_relaxed)) break;
+        const std::string_view block = text_.substr(b * kBlockBytes, kBlockBytes);
+        prefix_[b + 1] = prefix_[b] + static_cast<std::size_t>(std::count(block.begin(), block.end(), '\n'));
+        blocks_done_.store(b + 1, std::memory_order_release);
+        if ((b + 1) % kNotifyBlocks == 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            progress_.notify_all();
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A cancelled scan still counts as finished to anyone waiting on it.
+    blocks_done_.store(blocks, std::memory_order_release);
+    progress_.notify_all();
+}
+
+bool LineIndex::complete() const noexcept {
+    return blocks_done_.load(std::memory_order_acquire) == block_count();
+}
+
+std::size_t LineIndex::scanned_bytes() const noexcept {
+    return std::min(blocks_done_.load(std::memory_order_acquire) * kBlockBytes, text_.size());
+}
+
+void LineIndex::wait() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    progress_.wait(lock, [this] { return complete(); });
+}
+
+std::size_t LineIndex::newline_count() const {
+    wait();
+    return prefix_.back();
+}
+
+std::optional<std::size_t> LineIndex::try_line_start(std::size_t line) const {
+    if (line == 0) return 0;
+    const std::size_t done = blocks_done_.load(std::memory_order_acquire);
+    // First block whose end has seen at least `line` newlines.
+    const auto begin = prefix_.begin() + 1;
+    const auto it = std::lower_bound(begin, begin + static_cast<std::ptrdiff_t>(done), line);
+    if (it == begin + static_cast<std::ptrdiff_t>(done)) return std::nullopt;
+
+    const auto block = static_cast<std::size_t>(it - begin);
+    std::size_t remaining = line - prefix_[block];
+    std::size_t pos = block * kBlockBytes;
+    for (;;) {
+        pos = text_.find('\n', pos);
+        if (--remaining == 0) return pos + 1;
+        ++pos;
+    }
+}
+
+std::optional<std::size_t> LineIndex::line_start(std::size_t line) const {
+    if (auto start = try_line_start(line)) return start;
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::optional<std::size_t> start;
+    progress_.wait(lock, [&] {
+        start = try_line_start(line);
+        return start || complete();
+    });
+    return start;
+}
+
+std::vector<Rope::Chunk> LineIndex::chunks() const {
+    wait();
+    std::vector<Rope::Chunk> chunks;
+    chunks.reserve(block_count());
+    for (std::size_t b = 0; b < block_count(); ++b) {
+        chunks.push_back({text_.substr(b * kBlockBytes, kBlockBytes), prefix_[b + 1] - prefix_[b]});
+    }
+    return chunks;
+}
+
+}  // namespace rebel::text
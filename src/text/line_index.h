@@ -0,0 +1,69 @@
+#pragma once
+
+#include "text/rope.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace rebel::text {
+
+/// Newline index over an immutable byte range, built on a background thread.
+///
+/// The text is scanned front to back in kBlockBytes blocks. Lookups that fall
+/// inside the scanned prefix are answered while the scan is still running, so
+/// the start of a huge file can be shown before the rest has been read. Once
+/// complete, the per-block counts become the chunk list for
+/// Rope::from_chunks, so the rope never has to rescan the text.
+class LineIndex {
+public:
+    static constexpr std::size_t kBlockBytes = 64 * 1024;
+
+    /// Starts scanning `text`, which must stay alive and unchanged for the
+    /// lifetime of the index.
+    explicit LineIndex(std::string_view text);
+    /// Stops the scan early if it is still running.
+    ~LineIndex();
+
+    LineIndex(const LineIndex&) = delete;
+    LineIndex& operator=(const LineIndex&) = delete;
+
+    std::string_view text() const noexcept { return text_; }
+    bool complete() const noexcept;
+    std::size_t scanned_bytes() const noexcept;
+    void wait() const;
+
+    /// Total newline count; waits for the scan to complete.
+    std::size_t newline_count() const;
+
+    /// Offset of the first byte of `line`, or nullopt if the scan has not
+    /// reached it yet (or the text has fewer lines). Never blocks.
+    std::optional<std::size_t> try_line_start(std::size_t line) const;
+    /// Like try_line_start, but waits for the scan to reach `line`. Returns
+    /// nullopt only when the text has fewer lines.
+    std::optional<std::size_t> line_start(std::size_t line) const;
+
+    /// One chunk per block, for Rope::from_chunks; waits for the scan.
+    std::vector<Rope::Chunk> chunks() const;
+
+private:
+    void scan();
+    std::size_t block_count() const noexcept { return prefix_.size() - 1; }
+
+    std::string_view text_;
+    // prefix_[b] is the number of newlines before block b; written by the
+    // scanner before blocks_done_ is published past b.
+    std::vector<std::size_t> prefix_;
+    std::atomic<std::size_t> blocks_done_{0};
+    std::atomic<bool> cancelled_{false};
+    mutable std::mutex mutex_;
+    mutable std::condition_variable progress_;
+    std::thread worker_;
+};
+
+}  // namespace rebel::text
@@ -0,0 +1,469 @@
+#include "text/rope.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace rebel::text {
+namespace detail {
+
+struct Node {
+    std::uint32_t height = 0;  // 0 for leaves
+    std::size_t bytes = 0;
+    std::size_t newlines = 0;
+};
+
+}  // namespace detail
+
+namespace {
+
+using detail::Node;
+using detail::NodePtr;
+
+constexpr std::size_t kMaxLeaf = Rope::kMaxLeafBytes;
+constexpr std::size_t kMinLeaf = Rope::kMinLeafBytes;
+constexpr std::size_t kMaxChildren = Rope::kMaxChildren;
+// Leaves built from fresh text keep a quarter free so that typing into them
+// stays on the in-place path instead of splitting straight away.
+constexpr std::size_t kBuildLeaf = kMaxLeaf * 3 / 4;
+
+struct Leaf : Node {
+    std::uint32_t length = 0;
+    bool is_view = false;
+    const char* data = nullptr;
+
+    std::string_view text() const { return {data, length}; }
+};
+
+// Leaves produced by edits own their bytes inline.
+struct OwnedLeaf final : Leaf {
+    alignas(64) char storage[kMaxLeaf];
+
+    OwnedLeaf() { data = storage; }
+    OwnedLeaf(const OwnedLeaf&) = delete;
+    OwnedLeaf& operator=(const OwnedLeaf&) = delete;
+};
+
+// Leaves adopted through Rope::from_chunks point into memory kept alive by
+// `owner` and may exceed kMaxLeaf; splitting one yields two more views, so
+// its bytes are never copied until a region of it is actually rewritten.
+struct SharedLeaf final : Leaf {
+    std::shared_ptr<const void> owner;
+};
+
+struct Branch final : Node {
+    std::uint32_t count = 0;
+    std::array<std::size_t, kMaxChildren> child_bytes{};
+    std::array<std::size_t, kMaxChildren> child_newlines{};
+    std::array<NodePtr, kMaxChildren> children;
+};
+
+struct Merged {
+    NodePtr first;
+    NodePtr second;  // null when the merge produced a single node
+};
+
+const Leaf& as_leaf(const Node& node) { return static_cast<const Leaf&>(node); }
+const Branch& as_branch(const Node& node) { return static_cast<const Branch&>(node); }
+
+std::size_t count_newlines(std::string_view text) {
+    return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+}
+
+bool is_continuation(char c) { return (static_cast<unsigned char>(c) & 0xC0) == 0x80; }
+
+// Moves `pos` back onto the start of a UTF-8 sequence. Invalid input (more
+// than three continuation bytes in a row) is split where requested.
+std::size_t char_boundary(std::string_view text, std::size_t pos) {
+    std::size_t p = pos;
+    while (p > 0 && p < text.size() && is_continuation(text[p]) && pos - p < 3) --p;
+    return p > 0 && !is_continuation(text[p]) ? p : pos;
+}
+
+NodePtr make_leaf(std::initializer_list<std::string_view> parts) {
+    auto leaf = std::make_shared<OwnedLeaf>();
+    std::size_t length = 0;
+    for (std::string_view part : parts) {
+        if (part.empty()) continue;
+        std::memcpy(leaf->storage + length, part.data(), part.size());
+        length += part.size();
+    }
+    leaf->length = static_cast<std::uint32_t>(length);
+    leaf->bytes = length;
+    leaf->newlines = count_newlines(leaf->text());
+    return leaf;
+}
+
+NodePtr make_shared_leaf(const std::shared_ptr<const void>& owner, std::string_view text,
+                         std::size_t newlines) {
+    auto leaf = std::make_shared<SharedLeaf>();
+    leaf->owner = owner;
+    leaf->is_view = true;
+    leaf->data = text.data();
+    leaf->length = static_cast<std::uint32_t>(text.size());
+    leaf->bytes = text.size();
+    leaf->newlines = newlines;
+    return leaf;
+}
+
+// Splits `leaf` at `offset`; views stay views and owned text is copied.
+std::pair<NodePtr, NodePtr> split_leaf(const Leaf& leaf, std::size_t offset) {
+    const std::string_view text = leaf.text();
+    if (leaf.is_view) {
+        const auto& owner = static_cast<const SharedLeaf&>(leaf).owner;
+        const std::size_t head_newlines = count_newlines(text.substr(0, offset));
+        return {make_shared_leaf(owner, text.substr(0, offset), head_newlines),
+                make_shared_leaf(owner, text.substr(offset), leaf.newlines - head_newlines)};
+    }
+    return {make_leaf({text.substr(0, offset)}), make_leaf({text.substr(offset)})};
+}
+
+NodePtr make_branch(const NodePtr* kids, std::size_t count) {
+    auto branch = std::make_shared<Branch>();
+    branch->height = kids[0]->height + 1;
+    branch->count = static_cast<std::uint32_t>(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        branch->children[i] = kids[i];
+        branch->child_bytes[i] = kids[i]->bytes;
+        branch->child_newlines[i] = kids[i]->newlines;
+        branch->bytes += kids[i]->bytes;
+        branch->newlines += kids[i]->newlines;
+    }
+    return branch;
+}
+
+// Stacks a row of same-height nodes into a tree, grouping evenly so no
+// branch on the right edge ends up underfull.
+NodePtr build_tree(std::vector<NodePtr> level) {
+    if (level.empty()) return nullptr;
+    while (level.size() > 1) {
+        const std::size_t groups = (level.size() + kMaxChildren - 1) / kMaxChildren;
+        std::vector<NodePtr> next;
+        next.reserve(groups);
+        std::size_t begin = 0;
+        for (std::size_t g = 0; g < groups; ++g) {
+            const std::size_t end = level.size() * (g + 1) / groups;
+            next.push_back(make_branch(&level[begin], end - begin));
+            begin = end;
+        }
+        level = std::move(next);
+    }
+    return level.front();
+}
+
+NodePtr build(std::string_view text) {
+    std::vector<NodePtr> level;
+    level.reserve(text.size() / kBuildLeaf + 1);
+    while (!text.empty()) {
+        std::size_t take = text.size();
+        if (take > kMaxLeaf) {
+            // Split the tail evenly rather than leaving a runt leaf behind.
+            take = text.size() - kBuildLeaf < kMinLeaf ? text.size() / 2 : kBuildLeaf;
+            take = char_boundary(text, take);
+        }
+        level.push_back(make_leaf({text.substr(0, take)}));
+        text.remove_prefix(take);
+    }
+    return build_tree(std::move(level));
+}
+
+NodePtr collapse(NodePtr node) {
+    while (node && node->height > 0 && as_branch(*node).count == 1) {
+        node = as_branch(*node).children[0];
+    }
+    return node;
+}
+
+Merged pack(const NodePtr* kids, std::size_t count) {
+    if (count <= kMaxChildren) return {make_branch(kids, count), nullptr};
+    const std::size_t half = count / 2;
+    return {make_branch(kids, half), make_branch(kids + half, count - half)};
+}
+
+Merged merge_leaves(const NodePtr& a, const NodePtr& b) {
+    const Leaf& la = as_leaf(*a);
+    const Leaf& lb = as_leaf(*b);
+    const std::size_t total = la.length + lb.length;
+    if (total <= kMaxLeaf) return {make_leaf({la.text(), lb.text()}), nullptr};
+    // Large views are left alone; an underfull neighbour is cheaper than a copy.
+    if (la.length >= kMinLeaf && lb.length >= kMinLeaf) return {a, b};
+    if (total > 2 * kMaxLeaf) return {a, b};
+
+    char joined[2 * kMaxLeaf];
+    std::memcpy(joined, la.data, la.length);
+    std::memcpy(joined + la.length, lb.data, lb.length);
+    const std::string_view text(joined, total);
+    const std::size_t mid = char_boundary(text, total / 2);
+    return {make_leaf({text.substr(0, mid)}), make_leaf({text.substr(mid)})};
+}
+
+// Joins two non-empty trees into one or two nodes of height
+// max(a.height, b.height). Only the nodes along the seam are rebuilt, which
+// is also where splits leave underfull nodes behind.
+Merged merge(const NodePtr& a, const NodePtr& b) {
+    std::array<NodePtr, 2 * kMaxChildren> kids;
+    std::size_t n = 0;
+
+    if (a->height == b->height) {
+        if (a->height == 0) return merge_leaves(a, b);
+        const Branch& ba = as_branch(*a);
+        const Branch& bb = as_branch(*b);
+        Merged seam = merge(ba.children[ba.count - 1], bb.children[0]);
+        for (std::size_t i = 0; i + 1 < ba.count; ++i) kids[n++] = ba.children[i];
+        kids[n++] = std::move(seam.first);
+        if (seam.second) kids[n++] = std::move(seam.second);
+        for (std::size_t i = 1; i < bb.count; ++i) kids[n++] = bb.children[i];
+    } else if (a->height > b->height) {
+        const Branch& ba = as_branch(*a);
+        Merged seam = merge(ba.children[ba.count - 1], b);
+        for (std::size_t i = 0; i + 1 < ba.count; ++i) kids[n++] = ba.children[i];
+        kids[n++] = std::move(seam.first);
+        if (seam.second) kids[n++] = std::move(seam.second);
+    } else {
+        const Branch& bb = as_branch(*b);
+        Merged seam = merge(a, bb.children[0]);
+        kids[n++] = std::move(seam.first);
+        if (seam.second) kids[n++] = std::move(seam.second);
+        for (std::size_t i = 1; i < bb.count; ++i) kids[n++] = bb.children[i];
+    }
+    return pack(kids.data(), n);
+}
+
+NodePtr concat_nodes(const NodePtr& a, const NodePtr& b) {
+    if (!a) return b;
+    if (!b) return a;
+    Merged merged = merge(a, b);
+    if (!merged.second) return std::move(merged.first);
+    const NodePtr pair[2] = {std::move(merged.first), std::move(merged.second)};
+    return make_branch(pair, 2);
+}
+
+std::pair<NodePtr, NodePtr> split(const NodePtr& node, std::size_t offset) {
+    if (!node) return {};
+    if (offset == 0) return {nullptr, node};
+    if (offset >= node->bytes) return {node, nullptr};
+    if (node->height == 0) return split_leaf(as_leaf(*node), offset);
+
+    const Branch& b = as_branch(*node);
+    std::size_t i = 0;
+    while (offset >= b.child_bytes[i]) offset -= b.child_bytes[i++];
+
+    NodePtr left = i > 0 ? make_branch(b.children.data(), i) : nullptr;
+    if (offset == 0) return {left, make_branch(b.children.data() + i, b.count - i)};
+
+    NodePtr right = i + 1 < b.count ? make_branch(b.children.data() + i + 1, b.count - i - 1) : nullptr;
+    auto [l, r] = split(b.children[i], offset);
+    return {concat_nodes(left, l), concat_nodes(r, right)};
+}
+
+// Rewrites the one leaf that holds [offset, offset + length) when the edited
+// text still fits in it, copying only the root-to-leaf path. Returns null when
+// the edit straddles leaves or would overflow or underfill the leaf.
+NodePtr edit_in_place(const Node& node, std::size_t offset, std::size_t length,
+                      std::string_view text, bool is_root) {
+    if (node.height == 0) {
+        const Leaf& leaf = as_leaf(node);
+        const std::size_t new_length = leaf.length - length + text.size();
+        if (new_length == 0 || new_length > kMaxLeaf) return nullptr;
+        if (!is_root && new_length < kMinLeaf) return nullptr;
+        const std::string_view old = leaf.text();
+        return make_leaf({old.substr(0, offset), text, old.substr(offset + length)});
+    }
+
+    const Branch& b = as_branch(node);
+    std::size_t i = 0;
+    // Pure inserts at a seam go to the end of the left leaf; removals must
+    // start inside the leaf they remove from.
+    while (i + 1 < b.count &&
+           (length == 0 ? offset > b.child_bytes[i] : offset >= b.child_bytes[i])) {
+        offset -= b.child_bytes[i++];
+    }
+    if (offset + length > b.child_bytes[i]) return nullptr;
+
+    NodePtr child = edit_in_place(*b.children[i], offset, length, text, false);
+    if (!child) return nullptr;
+
+    auto copy = std::make_shared<Branch>(b);
+    copy->bytes = copy->bytes - b.child_bytes[i] + child->bytes;
+    copy->newlines = copy->newlines - b.child_newlines[i] + child->newlines;
+    copy->child_bytes[i] = child->bytes;
+    copy->child_newlines[i] = child->newlines;
+    copy->children[i] = std::move(child);
+    return copy;
+}
+
+bool visit_chunks(const Node& node, std::size_t begin, std::size_t end,
+                  const std::function<bool(std::string_view)>& fn) {
+    if (node.height == 0) return fn(as_leaf(node).text().substr(begin, end - begin));
+
+    const Branch& b = as_branch(node);
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < b.count && start < end; ++i) {
+        const std::size_t child_end = start + b.child_bytes[i];
+        if (child_end > begin) {
+            const std::size_t from = std::max(begin, start) - start;
+            const std::size_t to = std::min(end, child_end) - start;
+            if (!visit_chunks(*b.children[i], from, to, fn)) return false;
+        }
+        start = child_end;
+    }
+    return true;
+}
+
+// Byte offset of the `n`-th newline (1-based); `n` must not exceed the total.
+std::size_t nth_newline(const Node* node, std::size_t n) {
+    std::size_t base = 0;
+    while (node->height > 0) {
+        const Branch& b = as_branch(*node);
+        std::size_t i = 0;
+        while (n > b.child_newlines[i]) {
+            n -= b.child_newlines[i];
+            base += b.child_bytes[i++];
+        }
+        node = b.children[i].get();
+    }
+    const std::string_view text = as_leaf(*node).text();
+    std::size_t pos = 0;
+    for (;;) {
+        pos = text.find('\n', pos);
+        if (--n == 0) return base + pos;
+        ++pos;
+    }
+}
+
+std::size_t newlines_before(const Node* node, std::size_t offset) {
+    std::size_t count = 0;
+    while (node->height > 0) {
+        const Branch& b = as_branch(*node);
+        std::size_t i = 0;
+        while (i + 1 < b.count && offset >= b.child_bytes[i]) {
+            offset -= b.child_bytes[i];
+            count += b.child_newlines[i++];
+        }
+        node = b.children[i].get();
+    }
+    return count + count_newlines(as_leaf(*node).text().substr(0, offset));
+}
+
+}  // namespace
+
+Rope::Rope(std::string_view text) : root_(build(text)) {}
+
+Rope Rope::from_chunks(std::shared_ptr<const void> owner, const std::vector<Chunk>& chunks) {
+    std::vector<NodePtr> level;
+    level.reserve(chunks.size());
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.text.empty()) level.push_back(make_shared_leaf(owner, chunk.text, chunk.newlines));
+    }
+    return Rope(build_tree(std::move(level)));
+}
+
+Rope::Rope(detail::NodePtr root) : root_(collapse(std::move(root))) {}
+
+std::size_t Rope::size() const noexcept { return root_ ? root_->bytes : 0; }
+
+std::size_t Rope::newline_count() const noexcept { return root_ ? root_->newlines : 0; }
+
+std::size_t Rope::height() const noexcept { return root_ ? root_->height : 0; }
+
+void Rope::check_offset(std::size_t offset) const {
+    if (offset > size()) throw std::out_of_range("rope offset out of range");
+}
+
+void Rope::insert(std::size_t offset, std::string_view text) { replace(offset, 0, text); }
+
+void Rope::erase(std::size_t offset, std::size_t length) { replace(offset, length, {}); }
+
+void Rope::replace(std::size_t offset, std::size_t length, std::string_view text) {
+    check_offset(offset);
+    length = std::min(length, size() - offset);
+    if (length == 0 && text.empty()) return;
+
+    if (root_) {
+        if (NodePtr edited = edit_in_place(*root_, offset, length, text, true)) {
+            root_ = std::move(edited);
+            return;
+        }
+    }
+
+    auto [left, rest] = split(root_, offset);
+    auto [removed, right] = split(rest, length);
+    root_ = collapse(concat_nodes(concat_nodes(left, build(text)), right));
+}
+
+char Rope::at(std::size_t offset) const {
+    if (offset >= size()) throw std::out_of_range("rope offset out of range");
+    const Node* node = root_.get();
+    while (node->height > 0) {
+        const Branch& b = as_branch(*node);
+        std::size_t i = 0;
+        while (offset >= b.child_bytes[i]) offset -= b.child_bytes[i++];
+        node = b.children[i].get();
+    }
+    return as_leaf(*node).data[offset];
+}
+
+std::string Rope::substr(std::size_t offset, std::size_t length) const {
+    check_offset(offset);
+    length = std::min(length, size() - offset);
+    std::string out;
+    out.reserve(length);
+    for_each_chunk(offset, length, [&out](std::string_view chunk) {
+        out.append(chunk);
+        return true;
+    });
+    return out;
+}
+
+Rope Rope::slice(std::size_t offset, std::size_t length) const {
+    check_offset(offset);
+    length = std::min(length, size() - offset);
+    auto [left, rest] = split(root_, offset);
+    return Rope(split(rest, length).first);
+}
+
+bool Rope::for_each_chunk(std::size_t offset, std::size_t length,
+                          const std::function<bool(std::string_view)>& fn) const {
+    check_offset(offset);
+    length = std::min(length, size() - offset);
+    if (length == 0) return true;
+    return visit_chunks(*root_, offset, offset + length, fn);
+}
+
+std::size_t Rope::line_start(std::size_t line) const {
+    if (line > newline_count()) throw std::out_of_range("rope line out of range");
+    return line == 0 ? 0 : nth_newline(root_.get(), line) + 1;
+}
+
+std::size_t Rope::line_end(std::size_t line) const {
+    if (line > newline_count()) throw std::out_of_range("rope line out of range");
+    return line == newline_count() ? size() : nth_newline(root_.get(), line + 1);
+}
+
+std::string Rope::line(std::size_t line) const {
+    const std::size_t start = line_start(line);
+    return substr(start, line_end(line) - start);
+}
+
+Position Rope::position_of(std::size_t offset) const {
+    check_offset(offset);
+    if (!root_) return {};
+    const std::size_t line = newlines_before(root_.get(), offset);
+    return {line, offset - line_start(line)};
+}
+
+std::size_t Rope::offset_of(Position position) const {
+    const std::size_t start = line_start(position.line);
+    const std::size_t end = line_end(position.line);
+    return position.column >= end - start ? end : start + position.column;
+}
+
+Rope Rope::concat(const Rope& left, const Rope& right) {
+    return Rope(concat_nodes(left.root_, right.root_));
+}
+
+}  // namespace rebel::text
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::text {
+
+/// Zero-based line/column pair. Columns are byte offsets from the start of
+/// the line.
+struct Position {
+    std::size_t line = 0;
+    std::size_t column = 0;
+
+    friend bool operator==(const Position& a, const Position& b) {
+        return a.line == b.line && a.column == b.column;
+    }
+    friend bool operator!=(const Position& a, const Position& b) { return !(a == b); }
+};
+
+namespace detail {
+struct Node;
+using NodePtr = std::shared_ptr<const Node>;
+}  // namespace detail
+
+/// Text buffer stored as a B-tree of immutable leaves holding up to
+/// kMaxLeafBytes each (adopted chunks, see from_chunks, may be larger).
+///
+/// Every branch keeps the byte and newline totals of its children inline, so
+/// offset, line and position lookups walk a single root-to-leaf path without
+/// touching sibling nodes. Edits copy only that path; the remaining nodes are
+/// shared, which makes copying a Rope O(1) and keeps old copies valid.
+///
+/// Inserts, deletes and lookups are O(log n). Offsets are byte offsets; leaf
+/// boundaries are kept on UTF-8 sequence starts when text is split.
+/// Out-of-range offsets throw std::out_of_range.
+class Rope {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    /// Leaf payload capacity: sixteen cache lines.
+    static constexpr std::size_t kMaxLeafBytes = 1024;
+    static constexpr std::size_t kMinLeafBytes = kMaxLeafBytes / 2;
+    static constexpr std::size_t kMaxChildren = 16;
+    static constexpr std::size_t kMinChildren = kMaxChildren / 2;
+
+    /// Externally owned text adopted by from_chunks.
+    struct Chunk {
+        std::string_view text;
+        std::size_t newlines = 0;  ///< Number of '\n' bytes in `text`.
+    };
+
+    Rope() = default;
+    explicit Rope(std::string_view text);
+
+    /// Builds a rope whose leaves point into `chunks` without copying them.
+    /// `owner` is retained by every such leaf and must keep the chunk memory
+    /// alive and unchanged. Edits copy only the bytes they rewrite; the rest
+    /// of each chunk stays shared.
+    static Rope from_chunks(std::shared_ptr<const void> owner, const std::vector<Chunk>& chunks);
+
+    std::size_t size() const noexcept;
+    bool empty() const noexcept { return size() == 0; }
+    std::size_t newline_count() const noexcept;
+    /// Number of lines; a rope always has at least one (possibly empty) line.
+    std::size_t line_count() const noexcept { return newline_count() + 1; }
+
+    void insert(std::size_t offset, std::string_view text);
+    void erase(std::size_t offset, std::size_t length);
+    void replace(std::size_t offset, std::size_t length, std::string_view text);
+    void append(std::string_view text) { insert(size(), text); }
+    void clear() noexcept { root_.reset(); }
+
+    char at(std::size_t offset) const;
+    std::string substr(std::size_t offset, std::size_t length = npos) const;
+    std::string to_string() const { return substr(0); }
+    /// Shares nodes with this rope; O(log n) regardless of the slice length.
+    Rope slice(std::size_t offset, std::size_t length = npos) const;
+
+    /// Byte offset of the first character of `line`.
+    std::size_t line_start(std::size_t line) const;
+    /// Byte offset of the newline ending `line`, or size() for the last line.
+    std::size_t line_end(std::size_t line) const;
+    /// Contents of `line` without its terminating newline.
+    std::string line(std::size_t line) const;
+    Position position_of(std::size_t offset) const;
+    /// Columns past the end of the line are clamped to the line end.
+    std::size_t offset_of(Position position) const;
+
+    /// Calls `fn` with consecutive leaf views covering [offset, offset+length).
+    /// Stops early and returns false once `fn` returns false.
+    bool for_each_chunk(std::size_t offset, std::size_t length,
+                        const std::function<bool(std::string_view)>& fn) const;
+
+    static Rope concat(const Rope& left, const Rope& right);
+
+    /// Tree height (0 for an empty or single-leaf rope); for diagnostics.
+    std::size_t height() const noexcept;
+
+private:
+    explicit Rope(detail::NodePtr root);
+
+    void check_offset(std::size_t offset) const;
+
+    detail::NodePtr root_;
+};
+
+}  // namespace rebel::text
@@ -0,0 +1,344 @@
+#include "text/undo.h"
+
+#include "core/compress.h"
+#include "core/hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace rebel::text {
+namespace {
+
+namespace fs = std::filesystem;
+
+// What an edit copies, for the memory estimate: an owned leaf per
+// kMaxLeafBytes changed, and a path of branches above them.
+constexpr std::size_t kLeafBytes = Rope::kMaxLeafBytes + 64;
+constexpr std::size_t kPathBytes = 4 * Rope::kMaxChildren * 32;
+
+struct RecordHeader {
+    std::uint64_t raw_bytes;
+    std::uint64_t stored_bytes;
+    std::uint64_t hash;
+};
+
+void varint(std::string& out, std::uint64_t v) {
+    for (; v >= 0x80; v >>= 7) out.push_back(static_cast<char>(v | 0x80));
+    out.push_back(static_cast<char>(v));
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view bytes) : bytes_(bytes) {}
+
+    bool done() const noexcept { return pos_ == bytes_.size(); }
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64 && pos_ < bytes_.size(); shift += 7) {
+            const auto byte = static_cast<std::uint8_t>(bytes_[pos_++]);
+            v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        throw UndoLogError("undo log delta damaged");
+    }
+    std::string_view bytes(std::uint64_t n) {
+        if (bytes_.size() - pos_ < n) throw UndoLogError("undo log delta damaged");
+        const std::string_view v = bytes_.substr(pos_, n);
+        pos_ += n;
+        return v;
+    }
+
+private:
+    std::string_view bytes_;
+    std::size_t pos_ = 0;
+};
+
+std::size_t estimate(std::size_t length, std::size_t spans) {
+    return (length / Rope::kMaxLeafBytes + spans) * kLeafBytes + spans * kPathBytes;
+}
+
+// Makes the edits of `delta` to `text`; returns the memory they took.
+std::size_t apply_delta(Rope& text, std::string_view delta) {
+    Reader in(delta);
+    const std::uint64_t spans = in.varint();
+    std::size_t length = 0;
+    for (std::uint64_t n = 0; n < spans; ++n) {
+        const std::uint64_t offset = in.varint();
+        const std::uint64_t removed = in.varint();
+        const std::string_view bytes = in.bytes(in.varint());
+        if (offset > text.size() || removed > text.size() - offset) throw UndoLogError("undo log delta damaged");
+        text.replace(offset, removed, bytes);
+        length += bytes.size();
+    }
+    if (!in.done()) throw UndoLogError("undo log delta damaged");
+    return estimate(length, spans);
+}
+
+}  // namespace
+
+UndoTree::UndoTree(Rope text) : UndoTree(std::move(text), Options{}) {}
+
+UndoTree::UndoTree(Rope text, Options options) : options_(std::move(options)) {
+    revisions_.emplace_back();
+    revisions_.back().text = std::move(text);
+}
+
+UndoTree::~UndoTree() {
+    if (!log_.is_open()) return;
+    log_.close();
+    std::error_code error;
+    fs::remove(log_path_, error);
+}
+
+void UndoTree::record(std::size_t offset, std::size_t removed, std::size_t inserted) {
+    if (removed == 0 && inserted == 0) return;
+    // Spans the edit overlaps or touches become one, with the unchanged
+    // bytes between them.
+    const auto first = std::lower_bound(pending_.begin(), pending_.end(), offset,
+                                        [](const Span& s, std::size_t at) { return s.offset + s.length < at; });
+    auto last = first;
+    Span merged{offset, offset + removed, 0};  // `length` holding the end for now
+    std::size_t changed = 0;
+    for (; last != pending_.end() && last->offset <= offset + removed; ++last) {
+        merged.offset = std::min(merged.offset, last->offset);
+        merged.length = std::max(merged.length, last->offset + last->length);
+        changed += last->length;
+        merged.removed += last->removed;
+    }
+    const std::size_t covered = merged.length - merged.offset;
+    merged.removed += covered - changed;
+    merged.length = covered - removed + inserted;
+    const auto at = pending_.erase(first, last);
+    for (auto it = at; it != pending_.end(); ++it) it->offset = it->offset + inserted - removed;
+    if (merged.length > 0 || merged.removed > 0) pending_.insert(at, merged);
+
+    if (pending_.size() <= kMaxSpans) return;
+    const auto gap = [this](std::size_t i) { return pending_[i + 1].offset - pending_[i].offset - pending_[i].length; };
+    std::size_t closest = 0;
+    for (std::size_t i = 1; i + 1 < pending_.size(); ++i) {
+        if (gap(i) < gap(closest)) closest = i;
+    }
+    const std::size_t between = gap(closest);
+    Span& a = pending_[closest];
+    const Span& b = pending_[closest + 1];
+    a.removed += between + b.removed;
+    a.length += between + b.length;
+    pending_.erase(pending_.begin() + static_cast<std::ptrdiff_t>(closest) + 1);
+}
+
+UndoTree::Revision UndoTree::commit(const Rope& text) {
+    if (pending_.empty()) return current_;
+    std::size_t expected = this->text().size();
+    std::size_t length = 0;
+    for (const Span& span : pending_) {
+        expected = expected - span.removed + span.length;
+        length += span.length;
+    }
+    if (expected != text.size()) throw std::invalid_argument("undo commit does not match the recorded edits");
+
+    const Revision id = revisions_.size();
+    revisions_[current_].children.push_back(id);
+    revisions_[current_].redo = id;
+    Node node;
+    node.parent = current_;
+    node.text = text;
+    node.bytes = estimate(length, pending_.size());
+    node.spans = std::move(pending_);
+    pending_.clear();
+    resident_bytes_ += node.bytes;
+    revisions_.push_back(std::move(node));
+    current_ = id;
+    touch(id);
+    trim();
+    return id;
+}
+
+void UndoTree::check_pending() const {
+    if (!pending_.empty()) throw std::logic_error("undo tree has uncommitted edits");
+}
+
+bool UndoTree::undo() {
+    check_pending();
+    if (current_ == kRoot) return false;
+    const Revision from = current_;
+    visit(revisions_[from].parent);
+    revisions_[current_].redo = from;
+    return true;
+}
+
+bool UndoTree::redo() {
+    check_pending();
+    const Revision to = revisions_[current_].redo;
+    if (to == kNone) return false;
+    visit(to);
+    return true;
+}
+
+void UndoTree::go_to(Revision revision) {
+    check_pending();
+    if (revision >= revisions_.size()) throw std::out_of_range("no such undo revision");
+    visit(revision);
+    for (Revision at = revision; at != kRoot; at = revisions_[at].parent) revisions_[revisions_[at].parent].redo = at;
+}
+
+void UndoTree::visit(Revision revision) {
+    if (!revisions_[revision].text) restore(revision);
+    current_ = revision;
+    touch(revision);
+    trim();
+}
+
+void UndoTree::touch(Revision revision) {
+    if (revision == kRoot) return;
+    Node& node = revisions_[revision];
+    resident_.erase({node.used, revision});
+    node.used = ++clock_;
+    resident_.insert({node.used, revision});
+}
+
+void UndoTree::restore(Revision revision) {
+    // Back to a revision in memory or a whole text, then forward again.
+    std::vector<Revision> deltas;
+    Revision base = revision;
+    for (; !revisions_[base].text && !revisions_[base].keyframe; base = revisions_[base].parent) deltas.push_back(base);
+    Rope text;
+    std::size_t bytes = 0;
+    if (revisions_[base].text) {
+        text = *revisions_[base].text;
+    } else {
+        const std::string whole = read(revisions_[base]);
+        text = Rope(whole);
+        bytes = estimate(whole.size(), 1);
+    }
+    for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) bytes += apply_delta(text, read(revisions_[*it]));
+
+    Node& node = revisions_[revision];
+    node.text = std::move(text);
+    node.bytes = bytes;
+    resident_bytes_ += bytes;
+}
+
+void UndoTree::trim() {
+    while (!log_failed_ && (resident_.size() > options_.max_resident || resident_bytes_ > options_.max_resident_bytes)) {
+        auto victim = resident_.begin();
+        if (victim->second == current_ && ++victim == resident_.end()) return;
+        if (!spill(victim->second)) return;
+    }
+}
+
+bool UndoTree::spill(Revision revision) {
+    Node& node = revisions_[revision];
+    if (node.log_offset == kNotLogged && !log(revision)) return false;
+    resident_.erase({node.used, revision});
+    resident_bytes_ -= node.bytes;
+    node.bytes = 0;
+    node.text.reset();
+    return true;
+}
+
+bool UndoTree::log(Revision revision) {
+    // Unlogged revisions are all in memory, and a delta's chain is only
+    // known once its parent's is.
+    std::vector<Revision> unlogged;
+    for (Revision at = revision; at != kRoot && revisions_[at].log_offset == kNotLogged; at = revisions_[at].parent) {
+        unlogged.push_back(at);
+    }
+    for (auto it = unlogged.rbegin(); it != unlogged.rend(); ++it) {
+        Node& node = revisions_[*it];
+        const Node& parent = revisions_[node.parent];
+        std::string payload;
+        varint(payload, node.spans.size());
+        for (const Span& span : node.spans) {
+            varint(payload, span.offset);
+            varint(payload, span.removed);
+            varint(payload, span.length);
+            node.text->for_each_chunk(span.offset, span.length, [&payload](std::string_view chunk) {
+                payload.append(chunk);
+                return true;
+            });
+        }
+        node.chain = parent.chain + payload.size();
+        node.depth = parent.depth + 1;
+        if (node.chain > node.text->size() || node.depth > kMaxChain) {
+            payload = node.text->to_string();
+            node.keyframe = true;
+            node.chain = 0;
+            node.depth = 0;
+        }
+        if (!append(node, payload)) return false;
+        node.spans = {};
+    }
+    return true;
+}
+
+bool UndoTree::append(Node& node, const std::string& payload) {
+    if (log_failed_) return false;
+    if (!log_.is_open()) {
+        log_path_ = options_.log_path;
+        if (log_path_.empty()) {
+            std::error_code error;
+            const fs::path dir = fs::temp_directory_path(error);
+            const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+            log_path_ = (dir / ("rebel-undo-" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "-" +
+                                std::to_string(stamp)))
+                            .string();
+        }
+        log_.open(log_path_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!log_) {
+            log_failed_ = true;
+            return false;
+        }
+    }
+    const std::string stored = core::compress(payload);
+    const RecordHeader header{payload.size(), stored.size(), core::hash64(stored)};
+    log_.seekp(static_cast<std::streamoff>(log_end_));
+    log_.write(reinterpret_cast<const char*>(&header), sizeof header);
+    log_.write(stored.data(), static_cast<std::streamsize>(stored.size()));
+    log_.flush();
+    if (!log_) {
+        log_failed_ = true;
+        return false;
+    }
+    node.log_offset = log_end_;
+    log_end_ += sizeof header + stored.size();
+    log_raw_bytes_ += payload.size();
+    return true;
+}
+
+std::string UndoTree::read(const Node& node) {
+    RecordHeader header;
+    log_.clear();
+    log_.seekg(static_cast<std::streamoff>(node.log_offset));
+    log_.read(reinterpret_cast<char*>(&header), sizeof header);
+    if (!log_ || header.stored_bytes > log_end_ - node.log_offset - sizeof header) {
+        throw UndoLogError("undo log truncated");
+    }
+    std::string stored(header.stored_bytes, '\0');
+    log_.read(stored.data(), static_cast<std::streamsize>(stored.size()));
+    if (!log_ || core::hash64(stored) != header.hash) throw UndoLogError("undo log damaged");
+    try {
+        std::string payload = core::decompress(stored);
+        if (payload.size() != header.raw_bytes) throw UndoLogError("undo log damaged");
+        return payload;
+    } catch (const core::CompressError&) {
+        throw UndoLogError("undo log damaged");
+    }
+}
+
+UndoTree::Stats UndoTree::stats() const {
+    Stats stats;
+    stats.revisions = revisions_.size();
+    stats.resident = resident_.size() + 1;
+    stats.resident_bytes = resident_bytes_;
+    for (const Node& node : revisions_) {
+        if (!node.text) ++stats.spilled;
+        if (node.keyframe) ++stats.keyframes;
+    }
+    stats.log_bytes = log_end_;
+    stats.log_raw_bytes = log_raw_bytes_;
+    return stats;
+}
+
+}  // namespace rebel::text
@@ -0,0 +1,178 @@
+#pragma once
+
+// Spilled revisions go to an append-only log file of records
+//
+//   record := raw_bytes:u64 stored_bytes:u64 hash:u64 stored:bytes
+//
+// where `stored` is the payload compressed with core::compress and `hash`
+// is core::hash64 of it. A payload is either a revision's whole text
+// (a keyframe) or the edits that make it from its parent's text:
+//
+//   delta := spans:varint (offset:varint removed:varint length:varint
+//            bytes)*
+//
+// applied in order, each replacing `removed` bytes at `offset` with the
+// `length` bytes that follow.
+
+#include "text/rope.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rebel::text {
+
+/// Thrown when spilled history cannot be read back from the undo log.
+class UndoLogError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// A document's undo history as a tree of revisions: undoing and then
+/// editing starts a branch, and the undone revisions stay reachable.
+///
+/// Each revision is a Rope snapshot. Ropes share every node an edit did
+/// not copy, so a revision costs about the leaves its edits rewrote, and
+/// moving between revisions in memory is O(1) whatever the edit was.
+///
+/// Past a budget of revisions or estimated bytes, the least recently
+/// visited ones are spilled to a compressed log file (see above) and
+/// dropped from memory. A revision is logged as its edits from its parent,
+/// or as its whole text once the chain of deltas back to a whole text
+/// would outgrow the text itself, which bounds reading one back to
+/// O(text). Visiting a spilled revision reads it back and keeps it in
+/// memory again. The root, the text the tree started from, always stays;
+/// so does everything once the log cannot be written.
+///
+/// The edits between revisions are tracked as at most kMaxSpans changed
+/// ranges, merging the closest when there are more, so a bulk edit that
+/// touches every line costs a few words to track and one range to log.
+///
+/// Not thread-safe.
+class UndoTree {
+public:
+    using Revision = std::uint64_t;
+    static constexpr Revision kRoot = 0;
+    static constexpr Revision kNone = std::numeric_limits<Revision>::max();
+    static constexpr std::size_t kMaxSpans = 64;
+    /// Longest chain of deltas logged before a whole text.
+    static constexpr std::uint32_t kMaxChain = 1024;
+
+    struct Options {
+        std::size_t max_resident = 1024;               // revisions in memory, not counting the root
+        std::size_t max_resident_bytes = 64u << 20;   // their estimated size
+        /// Empty for a file in the temporary directory. Created on the
+        /// first spill and removed with the tree.
+        std::string log_path;
+    };
+
+    struct Stats {
+        std::size_t revisions = 0;
+        std::size_t resident = 0;
+        std::size_t resident_bytes = 0;  // estimated, as the budget counts them
+        std::size_t spilled = 0;
+        std::size_t keyframes = 0;       // logged revisions stored whole
+        std::uint64_t log_bytes = 0;
+        std::uint64_t log_raw_bytes = 0;  // the same before compression
+    };
+
+    /// A tree whose root is `text`.
+    explicit UndoTree(Rope text);
+    UndoTree(Rope text, Options options);
+    ~UndoTree();
+    UndoTree(const UndoTree&) = delete;
+    UndoTree& operator=(const UndoTree&) = delete;
+
+    Revision current() const noexcept { return current_; }
+    /// The current revision's text.
+    const Rope& text() const noexcept { return *revisions_[current_].text; }
+
+    /// Notes an edit made since the last commit: `removed` bytes at
+    /// `offset` of the text as it was replaced by `inserted` bytes.
+    void record(std::size_t offset, std::size_t removed, std::size_t inserted);
+    bool has_changes() const noexcept { return !pending_.empty(); }
+    /// Adds `text`, the current text with the recorded edits made, as a
+    /// child of the current revision and moves to it; stays put if nothing
+    /// was recorded. Throws std::invalid_argument if the sizes disagree.
+    Revision commit(const Rope& text);
+    /// Forgets the recorded edits, for a caller that went back to text().
+    void discard() noexcept { pending_.clear(); }
+
+    // Moving between revisions throws std::logic_error while edits are
+    // recorded, and UndoLogError if a spilled revision cannot be read.
+
+    /// Moves to the parent revision; false at the root.
+    bool undo();
+    /// Moves to the child last moved from or created; false if none.
+    bool redo();
+    /// Moves to any revision; redo() then leads back down towards it.
+    /// Throws std::out_of_range.
+    void go_to(Revision revision);
+
+    std::size_t size() const noexcept { return revisions_.size(); }
+    Revision parent(Revision revision) const { return revisions_.at(revision).parent; }
+    const std::vector<Revision>& children(Revision revision) const { return revisions_.at(revision).children; }
+
+    Stats stats() const;
+
+private:
+    static constexpr std::uint64_t kNotLogged = std::numeric_limits<std::uint64_t>::max();
+
+    // Changed bytes [offset, offset + length) of a revision's text, which
+    // were `removed` bytes of its parent's.
+    struct Span {
+        std::size_t offset;
+        std::size_t length;
+        std::size_t removed;
+    };
+    struct Node {
+        Revision parent = kNone;
+        Revision redo = kNone;
+        std::vector<Revision> children;
+        std::optional<Rope> text;  // while resident
+        std::vector<Span> spans;   // from the parent, until logged
+        std::size_t bytes = 0;     // estimated, while resident
+        std::uint64_t used = 0;    // when last visited
+        std::uint64_t log_offset = kNotLogged;
+        std::uint64_t chain = 0;   // delta bytes back to a whole text, once logged
+        std::uint32_t depth = 0;   // and how many deltas
+        bool keyframe = false;
+    };
+
+    void visit(Revision revision);
+    void touch(Revision revision);
+    void restore(Revision revision);
+    /// Spills least recently visited revisions until within budget.
+    void trim();
+    bool spill(Revision revision);
+    /// Logs `revision` and any unlogged ancestors; false if the log
+    /// cannot be written.
+    bool log(Revision revision);
+    bool append(Node& node, const std::string& payload);
+    std::string read(const Node& node);
+    void check_pending() const;
+
+    Options options_;
+    std::vector<Node> revisions_;
+    Revision current_ = kRoot;
+    std::vector<Span> pending_;  // in the text as edited
+    // Resident revisions besides the root, least recently visited first.
+    std::set<std::pair<std::uint64_t, Revision>> resident_;
+    std::size_t resident_bytes_ = 0;
+    std::uint64_t clock_ = 0;
+
+    std::string log_path_;
+    std::fstream log_;
+    bool log_failed_ = false;
+    std::uint64_t log_end_ = 0;
+    std::uint64_t log_raw_bytes_ = 0;
+};
+
+}  // namespace rebel::text
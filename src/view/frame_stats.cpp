@@ -0,0 +1,50 @@
+#include "view/frame_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace rebel::view {
+namespace {
+
+double percentile(std::vector<float>& values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[static_cast<std::size_t>(p / 100.0 * static_cast<double>(values.size() - 1))];
+}
+
+}  // namespace
+
+std::uint64_t FrameStats::add_cpu(double ms) noexcept {
+    const std::uint64_t frame = next_++;
+    cpu_[frame % kHistory] = static_cast<float>(ms);
+    gpu_[frame % kHistory] = 0;
+    return frame;
+}
+
+void FrameStats::add_gpu(std::uint64_t frame, double ms) noexcept {
+    if (frame >= next_ || next_ - frame > kHistory) return;
+    gpu_[frame % kHistory] = static_cast<float>(ms);
+}
+
+FrameStats::Summary FrameStats::summary() const {
+    Summary s;
+    s.frames = static_cast<std::size_t>(std::min<std::uint64_t>(next_, kHistory));
+    if (s.frames == 0) return s;
+    s.cpu_last = cpu(0);
+
+    std::vector<float> cpu_times;
+    std::vector<float> gpu_times;
+    for (std::size_t age = 0; age < s.frames; ++age) {
+        cpu_times.push_back(static_cast<float>(cpu(age)));
+        if (gpu(age) <= 0) continue;
+        if (gpu_times.empty()) s.gpu_last = gpu(age);
+        gpu_times.push_back(static_cast<float>(gpu(age)));
+    }
+    s.cpu_p50 = percentile(cpu_times, 50);
+    s.cpu_p99 = percentile(cpu_times, 99);
+    s.gpu_p50 = percentile(gpu_times, 50);
+    s.gpu_p99 = percentile(gpu_times, 99);
+    return s;
+}
+
+}  // namespace rebel::view
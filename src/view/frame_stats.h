@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rebel::view {
+
+/// Rolling CPU and GPU frame times for the frame-time overlay.
+///
+/// The CPU side is recorded when a frame is built. GPU timer queries
+/// resolve a few frames later, so the backend reports them afterwards
+/// against the frame number they belong to; frames that fell out of the
+/// history by then are dropped.
+class FrameStats {
+public:
+    static constexpr std::size_t kHistory = 128;  // frames
+
+    struct Summary {
+        double cpu_last = 0;  // milliseconds
+        double cpu_p50 = 0;
+        double cpu_p99 = 0;
+        double gpu_last = 0;  // latest frame the backend has reported
+        double gpu_p50 = 0;
+        double gpu_p99 = 0;
+        std::size_t frames = 0;  // in the history
+    };
+
+    /// Records a built frame and returns its number.
+    std::uint64_t add_cpu(double ms) noexcept;
+    void add_gpu(std::uint64_t frame, double ms) noexcept;
+
+    Summary summary() const;
+    /// CPU and GPU time of the frame `age` frames ago (0 is the latest),
+    /// for the overlay's bar graph. Zero if not known.
+    double cpu(std::size_t age) const noexcept { return at(cpu_, age); }
+    double gpu(std::size_t age) const noexcept { return at(gpu_, age); }
+    std::uint64_t frames() const noexcept { return next_; }
+
+private:
+    double at(const float (&ring)[kHistory], std::size_t age) const noexcept {
+        return age < kHistory && age < next_ ? ring[(next_ - 1 - age) % kHistory] : 0;
+    }
+
+    float cpu_[kHistory] = {};
+    float gpu_[kHistory] = {};
+    std::uint64_t next_ = 0;
+};
+
+}  // namespace rebel::view
@@ -0,0 +1,100 @@
+#include "view/glyph_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rebel::view {
+namespace {
+
+// Empty texels around every glyph so linear filtering never bleeds a
+// neighbour in.
+constexpr std::uint16_t kPadding = 1;
+
+}  // namespace
+
+GlyphAtlas::GlyphAtlas(Rasterizer& rasterizer, std::uint16_t width, std::uint16_t height)
+    : rasterizer_(rasterizer), width_(width), height_(height),
+      pixels_(static_cast<std::size_t>(width) * height) {
+    clear();
+}
+
+void GlyphAtlas::clear() {
+    std::fill(pixels_.begin(), pixels_.end(), std::uint8_t{0});
+    glyphs_.clear();
+    shelves_.clear();
+    others_.clear();
+    for (auto& table : ascii_) std::fill(std::begin(table), std::end(table), kNone);
+    dirty_ = {0, 0, width_, height_};
+    ++generation_;
+}
+
+AtlasRect GlyphAtlas::take_dirty() noexcept {
+    const AtlasRect rect = dirty_;
+    dirty_ = {};
+    return rect;
+}
+
+std::uint32_t GlyphAtlas::insert(char32_t codepoint, FontStyle style) {
+    const std::uint64_t key = static_cast<std::uint64_t>(style) << 32 | codepoint;
+    if (codepoint >= 128) {
+        const auto it = others_.find(key);
+        if (it != others_.end()) return it->second;
+    }
+
+    const GlyphBitmap bitmap = rasterizer_.rasterize(codepoint, style);
+    AtlasGlyph glyph;
+    glyph.width = bitmap.width;
+    glyph.height = bitmap.height;
+    glyph.left = bitmap.left;
+    glyph.top = bitmap.top;
+    glyph.advance = bitmap.advance;
+    // Blank glyphs (spaces) take no texels.
+    if (bitmap.width > 0 && bitmap.height > 0) {
+        if (!pack(bitmap.width, bitmap.height, glyph.u, glyph.v)) return kNone;
+        for (std::uint16_t row = 0; row < bitmap.height; ++row) {
+            std::memcpy(&pixels_[static_cast<std::size_t>(glyph.v + row) * width_ + glyph.u],
+                        &bitmap.coverage[static_cast<std::size_t>(row) * bitmap.width], bitmap.width);
+        }
+        const AtlasRect touched{glyph.u, glyph.v, static_cast<std::uint16_t>(glyph.u + glyph.width),
+                                static_cast<std::uint16_t>(glyph.v + glyph.height)};
+        if (dirty_.empty()) {
+            dirty_ = touched;
+        } else {
+            dirty_ = {std::min(dirty_.x0, touched.x0), std::min(dirty_.y0, touched.y0),
+                      std::max(dirty_.x1, touched.x1), std::max(dirty_.y1, touched.y1)};
+        }
+    }
+
+    const auto slot = static_cast<std::uint32_t>(glyphs_.size());
+    glyphs_.push_back(glyph);
+    if (codepoint < 128) {
+        ascii_[static_cast<std::size_t>(style)][codepoint] = slot;
+    } else {
+        others_.emplace(key, slot);
+    }
+    return slot;
+}
+
+// Best-fit over the open shelves: the shortest one tall enough, so small
+// glyphs do not take up rows sized for tall ones.
+bool GlyphAtlas::pack(std::uint16_t width, std::uint16_t height, std::uint16_t& x, std::uint16_t& y) {
+    const std::uint32_t w = width + kPadding;
+    const std::uint32_t h = height + kPadding;
+    Shelf* best = nullptr;
+    for (Shelf& shelf : shelves_) {
+        if (shelf.height < h || shelf.used + w > width_) continue;
+        if (!best || shelf.height < best->height) best = &shelf;
+    }
+    if (!best) {
+        const std::uint32_t top = shelves_.empty() ? 0 : shelves_.back().y + shelves_.back().height;
+        if (top + h > height_ || w > width_) return false;
+        shelves_.push_back({static_cast<std::uint16_t>(top), static_cast<std::uint16_t>(h), 0});
+        best = &shelves_.back();
+    }
+    x = best->used;
+    y = best->y;
+    best->used = static_cast<std::uint16_t>(best->used + w);
+    return true;
+}
+
+}  // namespace rebel::view
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace rebel::view {
+
+enum class FontStyle : std::uint8_t { Regular, Bold, Italic, BoldItalic };
+
+/// A rasterized glyph as the font backend hands it over: an 8-bit coverage
+/// bitmap plus where it sits relative to the pen on the baseline.
+struct GlyphBitmap {
+    std::uint16_t width = 0;
+    std::uint16_t height = 0;
+    std::int16_t left = 0;  // pen to the bitmap's left edge
+    std::int16_t top = 0;   // baseline up to the bitmap's top edge
+    float advance = 0;      // pixels to the next pen position
+    std::vector<std::uint8_t> coverage;  // width * height, row-major
+};
+
+/// The font side of text rendering: FreeType, Core Text or DirectWrite in
+/// an application, something synthetic in benchmarks. Called only when a
+/// glyph is first needed, never per frame.
+class Rasterizer {
+public:
+    virtual ~Rasterizer() = default;
+
+    virtual GlyphBitmap rasterize(char32_t codepoint, FontStyle style) = 0;
+    /// Baseline to baseline, in pixels.
+    virtual float line_height() const = 0;
+    /// Top of the line box down to the baseline.
+    virtual float ascent() const = 0;
+};
+
+/// Texel rectangle [x0, x1) x [y0, y1) of the atlas page.
+struct AtlasRect {
+    std::uint16_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool empty() const noexcept { return x0 >= x1 || y0 >= y1; }
+};
+
+/// Where a glyph lives in the atlas and how to place it.
+struct AtlasGlyph {
+    std::uint16_t u = 0, v = 0, width = 0, height = 0;  // texels
+    std::int16_t left = 0;
+    std::int16_t top = 0;
+    float advance = 0;
+};
+
+/// A single-channel texture page holding every glyph the view has drawn.
+///
+/// Glyphs are rasterized once, on first use, and packed into shelves: rows
+/// as tall as the first glyph placed in them, filled left to right, with a
+/// new shelf opened below when a glyph does not fit any open one. Code
+/// text is mostly one size, so shelves waste little.
+///
+/// The page is never repacked. When it fills up, find() returns kNone and
+/// the owner calls clear(), which bumps generation() so that anything
+/// holding glyph slots knows to look them up again. dirty() is the part of
+/// the page written since the last take_dirty(), for the backend to upload
+/// as one sub-image.
+class GlyphAtlas {
+public:
+    static constexpr std::uint32_t kNone = 0xffffffffu;
+
+    GlyphAtlas(Rasterizer& rasterizer, std::uint16_t width = 2048, std::uint16_t height = 2048);
+
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    /// The slot holding `codepoint` in `style`, rasterizing and packing it if
+    /// it is new; kNone if the page is full.
+    std::uint32_t find(char32_t codepoint, FontStyle style) {
+        if (codepoint < 128) {
+            const std::uint32_t slot = ascii_[static_cast<std::size_t>(style)][codepoint];
+            if (slot != kNone) return slot;
+        }
+        return insert(codepoint, style);
+    }
+    const AtlasGlyph& glyph(std::uint32_t slot) const { return glyphs_[slot]; }
+
+    /// Forgets every glyph and starts the page over.
+    void clear();
+    std::uint64_t generation() const noexcept { return generation_; }
+
+    std::uint16_t width() const noexcept { return width_; }
+    std::uint16_t height() const noexcept { return height_; }
+    /// width() * height() coverage texels, row-major.
+    const std::uint8_t* pixels() const noexcept { return pixels_.data(); }
+    /// The region written since the last call; empty if none.
+    AtlasRect take_dirty() noexcept;
+
+    std::size_t size() const noexcept { return glyphs_.size(); }
+    Rasterizer& rasterizer() noexcept { return rasterizer_; }
+
+private:
+    struct Shelf {
+        std::uint16_t y;
+        std::uint16_t height;
+        std::uint16_t used;  // width
+    };
+
+    std::uint32_t insert(char32_t codepoint, FontStyle style);
+    bool pack(std::uint16_t width, std::uint16_t height, std::uint16_t& x, std::uint16_t& y);
+
+    Rasterizer& rasterizer_;
+    std::uint16_t width_;
+    std::uint16_t height_;
+    std::vector<std::uint8_t> pixels_;
+    std::vector<AtlasGlyph> glyphs_;
+    std::vector<Shelf> shelves_;
+    std::uint32_t ascii_[4][128];
+    std::unordered_map<std::uint64_t, std::uint32_t> others_;  // (style << 32 | codepoint)
+    AtlasRect dirty_;
+    std::uint64_t generation_ = 0;
+};
+
+}  // namespace rebel::view
@@ -0,0 +1,425 @@
+#include "view/text_view.h"
+
+#include "core/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace rebel::view {
+namespace {
+
+constexpr std::size_t kToEnd = std::numeric_limits<std::size_t>::max();
+
+// From an edit to the end of the first frame that shows it: the editor's
+// share of keystroke-to-paint.
+REBEL_TRACE_PROBE(edit_to_frame, "view.edit_to_frame");
+
+// Frame-time overlay layout, in pixels.
+constexpr float kMargin = 8;
+constexpr float kPadding = 8;
+constexpr float kPanelWidth = 300;
+constexpr float kGraphHeight = 40;
+constexpr double kGraphScale = 1000.0 / 30;  // ms at the top of the graph
+
+bool same_tokens(const std::vector<syntax::Token>& a, const std::vector<syntax::Token>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const syntax::Token& x, const syntax::Token& y) {
+        return x.start == y.start && x.length == y.length && x.kind == y.kind;
+    });
+}
+
+// Decodes the UTF-8 sequence at s[i] and moves i past it. Malformed input
+// decodes one byte at a time as U+FFFD.
+char32_t decode(std::string_view s, std::size_t& i) {
+    const auto lead = static_cast<unsigned char>(s[i]);
+    if (lead < 0x80) {
+        ++i;
+        return lead;
+    }
+    const std::size_t extra = lead >= 0xf0 ? 3 : lead >= 0xe0 ? 2 : lead >= 0xc0 ? 1 : 0;
+    if (extra == 0 || i + extra >= s.size()) {
+        ++i;
+        return 0xfffd;
+    }
+    char32_t cp = lead & (0x3f >> extra);
+    for (std::size_t k = 1; k <= extra; ++k) {
+        const auto next = static_cast<unsigned char>(s[i + k]);
+        if ((next & 0xc0) != 0x80) {
+            ++i;
+            return 0xfffd;
+        }
+        cp = cp << 6 | (next & 0x3f);
+    }
+    i += extra + 1;
+    return cp;
+}
+
+}  // namespace
+
+TextView::TextView(GlyphAtlas& atlas, Theme theme)
+    : atlas_(atlas), theme_(theme), line_height_(atlas.rasterizer().line_height()),
+      ascent_(atlas.rasterizer().ascent()), atlas_generation_(atlas.generation()) {
+    const std::uint32_t space = atlas_.find(' ', FontStyle::Regular);
+    const float advance = space == GlyphAtlas::kNone ? line_height_ / 2 : atlas_.glyph(space).advance;
+    tab_ = advance * static_cast<float>(std::max(1u, theme_.tab_width));
+}
+
+void TextView::set_text(text::Rope text) {
+    text_ = std::move(text);
+    lines_.clear();
+    damaged_.clear();
+    full_ = true;
+}
+
+void TextView::edit(text::Rope text, const syntax::LineEdit& edit) {
+    text_ = std::move(text);
+    if (edit.removed == 0 && edit.added == 0) return;
+    if (edit_started_ == 0) edit_started_ = REBEL_TRACE_NOW();
+
+    // Lines past the edit keep their shaping under their new numbers.
+    std::unordered_map<std::size_t, Line> moved;
+    moved.reserve(lines_.size());
+    for (auto& [number, line] : lines_) {
+        if (number < edit.first) {
+            moved.emplace(number, std::move(line));
+        } else if (number >= edit.first + edit.removed) {
+            moved.emplace(number - edit.removed + edit.added, std::move(line));
+        }
+    }
+    lines_ = std::move(moved);
+
+    if (edit.removed == edit.added) {
+        damage_lines(edit.first, edit.first + edit.added - 1);
+    } else {
+        damage_lines(edit.first, kToEnd);
+    }
+}
+
+void TextView::set_highlight(std::shared_ptr<const syntax::HighlightSnapshot> snapshot) {
+    highlight_ = std::move(snapshot);
+    const std::uint64_t version = highlight_ ? highlight_->version() + 1 : 0;
+
+    // Only what is on screen is checked now; other cached lines are checked
+    // when they next scroll in.
+    const auto [first, last] = visible_rows();
+    for (std::size_t n = first; n <= last; ++n) {
+        const auto it = lines_.find(n);
+        if (it == lines_.end() || it->second.highlight == version) continue;
+        if (same_tokens(it->second.tokens, tokens_for(n))) {
+            it->second.highlight = version;
+        } else {
+            lines_.erase(it);
+            damage_lines(n, n);
+        }
+    }
+}
+
+void TextView::resize(float width, float height) {
+    if (width == width_ && height == height_) return;
+    width_ = width;
+    height_ = height;
+    full_ = true;
+}
+
+void TextView::scroll_to(double x, double y) {
+    if (x != scroll_x_) full_ = true;
+    scroll_x_ = x;
+    scroll_y_ = y;
+}
+
+void TextView::set_overlay(bool on) {
+    overlay_ = on;
+    if (on) overlay_bottom_ = kMargin + 2 * line_height_ + kGraphHeight + 3 * kPadding;
+}
+
+const TextFrame& TextView::frame() {
+    REBEL_TRACE_SCOPE("view.frame");
+    const auto start = std::chrono::steady_clock::now();
+    build();
+    if (atlas_full_) {
+        // Start the page over and draw everything against it. A screen that
+        // still does not fit is drawn with the glyphs that did.
+        atlas_.clear();
+        ++stats_.atlas_resets;
+        atlas_full_ = false;
+        build();
+        atlas_full_ = false;
+    }
+    damaged_.clear();
+    full_ = false;
+    drawn_scroll_y_ = scroll_y_;
+    overlay_bottom_ = overlay_ ? overlay_bottom_ : 0;
+    evict();
+
+    ++stats_.frames;
+    if (frame_.full) ++stats_.full_frames;
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    frame_.number = frame_stats_.add_cpu(ms);
+    REBEL_TRACE_RECORD(edit_to_frame, edit_started_);
+    edit_started_ = 0;
+    return frame_;
+}
+
+void TextView::build() {
+    frame_.clear();
+    if (atlas_.generation() != atlas_generation_) {
+        atlas_generation_ = atlas_.generation();
+        lines_.clear();
+        full_ = true;
+    }
+    const double scrolled = scroll_y_ - drawn_scroll_y_;
+    if (std::abs(scrolled) >= height_) full_ = true;
+    const auto dy = static_cast<float>(scrolled);
+    frame_.full = full_;
+
+    std::vector<DamageBand>& bands = frame_.damage;
+    if (full_) {
+        bands.push_back({0, height_});
+    } else {
+        frame_.shift = dy;
+        if (dy > 0) bands.push_back({height_ - dy, height_});
+        if (dy < 0) bands.push_back({0, -dy});
+        for (const auto& [first, last] : damaged_) {
+            const float y0 = row_y(static_cast<double>(first));
+            const float y1 = last == kToEnd ? height_ : row_y(static_cast<double>(last) + 1);
+            bands.push_back({y0, y1});
+        }
+        // The shifted image carries last frame's panel along with it.
+        if (overlay_bottom_ > 0) bands.push_back({0, overlay_bottom_ + std::max(0.f, -dy)});
+    }
+
+    // Whole rows only, so a row is never drawn over its own old pixels.
+    for (DamageBand& band : bands) {
+        const double top = std::floor((std::max(band.y0, 0.f) + scroll_y_) / line_height_);
+        const double bottom = std::ceil((std::min(band.y1, height_) + scroll_y_) / line_height_);
+        band.y0 = std::max(0.f, row_y(top));
+        band.y1 = std::min(height_, row_y(bottom));
+    }
+    bands.erase(std::remove_if(bands.begin(), bands.end(), [](const DamageBand& b) { return b.y1 <= b.y0; }),
+                bands.end());
+    std::sort(bands.begin(), bands.end(), [](const DamageBand& a, const DamageBand& b) { return a.y0 < b.y0; });
+    std::size_t merged = 0;
+    for (const DamageBand& band : bands) {
+        if (merged > 0 && band.y0 <= bands[merged - 1].y1) {
+            bands[merged - 1].y1 = std::max(bands[merged - 1].y1, band.y1);
+        } else {
+            bands[merged++] = band;
+        }
+    }
+    bands.resize(merged);
+
+    for (const DamageBand& band : bands) {
+        frame_.rects.push_back({0, band.y0, width_, band.y1 - band.y0, theme_.background});
+    }
+    if (!frame_.rects.empty()) {
+        frame_.batches.push_back({TextBatch::Layer::Backgrounds, 0, static_cast<std::uint32_t>(frame_.rects.size())});
+    }
+
+    for (const DamageBand& band : bands) {
+        const double top = std::floor((band.y0 + scroll_y_) / line_height_ + 1e-3);
+        const double bottom = std::ceil((band.y1 + scroll_y_) / line_height_ - 1e-3);
+        for (double row = std::max(top, 0.0); row < bottom; ++row) {
+            emit_row(static_cast<std::size_t>(row), row_y(row));
+            if (atlas_full_) return;
+        }
+    }
+    if (!frame_.glyphs.empty()) {
+        frame_.batches.push_back({TextBatch::Layer::Text, 0, static_cast<std::uint32_t>(frame_.glyphs.size())});
+    }
+
+    if (overlay_) draw_overlay();
+    frame_.atlas_upload = atlas_.take_dirty();
+}
+
+void TextView::damage_lines(std::size_t first, std::size_t last) {
+    damaged_.emplace_back(first, last);
+    if (damaged_.size() > 256) full_ = true;  // cheaper than merging them all
+}
+
+const std::vector<syntax::Token>& TextView::tokens_for(std::size_t line) const {
+    static const std::vector<syntax::Token> none;
+    if (!highlight_ || line >= highlight_->line_count()) return none;
+    return highlight_->line(line).tokens;
+}
+
+TextView::Line& TextView::shaped(std::size_t number, double right) {
+    const std::uint64_t version = highlight_ ? highlight_->version() + 1 : 0;
+    auto [it, fresh] = lines_.try_emplace(number);
+    Line& line = it->second;
+    if (!fresh && line.highlight != version) {
+        if (same_tokens(line.tokens, tokens_for(number))) {
+            line.highlight = version;
+        } else {
+            line = Line{};
+            fresh = true;
+        }
+    }
+    if (fresh) {
+        line.length = text_.line_end(number) - text_.line_start(number);
+        line.tokens = tokens_for(number);
+        line.highlight = version;
+        ++stats_.lines_shaped;
+    } else {
+        ++stats_.rows_cached;
+    }
+
+    auto end = [&] { return line.segments.empty() ? 0 : line.segments.back().end; };
+    auto pen = [&] { return line.segments.empty() ? 0.0 : line.segments.back().pen; };
+    while (end() < line.length && pen() < right) {
+        if (!shape_segment(number, line)) break;
+    }
+    return line;
+}
+
+bool TextView::shape_segment(std::size_t number, Line& line) {
+    const std::size_t begin = line.segments.empty() ? 0 : line.segments.back().end;
+    std::size_t end = std::min(line.length, begin + kSegmentBytes);
+    const std::size_t base = text_.line_start(number);
+    // Cut on a UTF-8 sequence start so no character straddles two segments.
+    if (end < line.length) {
+        while (end > begin + 1 && (static_cast<unsigned char>(text_.at(base + end)) & 0xc0) == 0x80) --end;
+    }
+    scratch_.clear();
+    text_.for_each_chunk(base + begin, end - begin, [this](std::string_view chunk) {
+        scratch_.append(chunk);
+        return true;
+    });
+
+    const std::vector<syntax::Token>& tokens = line.tokens;
+    std::size_t token = static_cast<std::size_t>(
+        std::lower_bound(tokens.begin(), tokens.end(), begin,
+                         [](const syntax::Token& t, std::size_t at) { return t.start + t.length <= at; }) -
+        tokens.begin());
+    const double origin = line.segments.empty() ? 0 : line.segments.back().pen;
+    double pen = origin;
+    const std::size_t glyphs = line.glyphs.size();
+    for (std::size_t i = 0; i < scratch_.size();) {
+        const std::size_t at = begin + i;
+        while (token < tokens.size() && tokens[token].start + tokens[token].length <= at) ++token;
+        const Theme::Style& style = token < tokens.size() && tokens[token].start <= at
+                                        ? theme_.style(tokens[token].kind)
+                                        : theme_.style(syntax::TokenKind::Text);
+        const char32_t cp = decode(scratch_, i);
+        if (cp == '\t') {
+            pen = (std::floor(pen / tab_) + 1) * tab_;
+            continue;
+        }
+        if (cp < 0x20 || cp == 0x7f) continue;  // '\r' and other controls draw nothing
+
+        const std::uint32_t slot = atlas_.find(cp, style.font);
+        if (slot == GlyphAtlas::kNone) {
+            line.glyphs.resize(glyphs);
+            atlas_full_ = true;
+            return false;
+        }
+        const AtlasGlyph& g = atlas_.glyph(slot);
+        if (g.width > 0) {
+            line.glyphs.push_back({static_cast<float>(pen - origin) + g.left, ascent_ - g.top, g.u, g.v, g.width,
+                                   g.height, style.rgba});
+        }
+        pen += g.advance;
+    }
+    line.segments.push_back({end, static_cast<std::uint32_t>(line.glyphs.size()), pen});
+    ++stats_.segments_shaped;
+    return true;
+}
+
+void TextView::emit_row(std::size_t number, float y) {
+    if (number >= text_.line_count()) return;
+    const Line& line = shaped(number, scroll_x_ + width_);
+    if (atlas_full_) return;
+    ++stats_.rows_drawn;
+
+    // Skip the segments that end left of the view; a glyph's overhang is
+    // well under a line height.
+    auto segment = std::lower_bound(line.segments.begin(), line.segments.end(), scroll_x_ - 2 * line_height_,
+                                    [](const Segment& s, double x) { return s.pen < x; });
+    for (; segment != line.segments.end(); ++segment) {
+        const bool first = segment == line.segments.begin();
+        const auto origin = static_cast<float>((first ? 0 : std::prev(segment)->pen) - scroll_x_);
+        if (origin >= width_) break;
+        for (std::size_t i = first ? 0 : std::prev(segment)->glyphs; i < segment->glyphs; ++i) {
+            const GlyphInstance& g = line.glyphs[i];
+            const float x = origin + g.x;
+            if (x >= width_) return;
+            if (x + g.width <= 0) continue;
+            frame_.glyphs.push_back({x, g.y + y, g.u, g.v, g.width, g.height, g.rgba});
+        }
+    }
+}
+
+void TextView::draw_overlay() {
+    const FrameStats::Summary s = frame_stats_.summary();
+    const float x = width_ - kPanelWidth - kMargin;
+    const float y = kMargin;
+    const float height = 2 * line_height_ + kGraphHeight + 3 * kPadding;
+    overlay_bottom_ = y + height;
+
+    const auto first_rect = static_cast<std::uint32_t>(frame_.rects.size());
+    frame_.rects.push_back({x, y, kPanelWidth, height, theme_.overlay_panel});
+    // Newest frame on the right; CPU and GPU side by side in each slot.
+    const float graph_top = y + 2 * line_height_ + 2 * kPadding;
+    const float slot = (kPanelWidth - 2 * kPadding) / static_cast<float>(FrameStats::kHistory);
+    auto bar = [&](double ms, float bx, std::uint32_t rgba) {
+        const float h = static_cast<float>(std::min(1.0, ms / kGraphScale)) * kGraphHeight;
+        if (h > 0) frame_.rects.push_back({bx, graph_top + kGraphHeight - h, slot / 2, h, rgba});
+    };
+    for (std::size_t age = 0; age < FrameStats::kHistory; ++age) {
+        const float bx = x + kPanelWidth - kPadding - static_cast<float>(age + 1) * slot;
+        bar(frame_stats_.cpu(age), bx, theme_.overlay_cpu);
+        bar(frame_stats_.gpu(age), bx + slot / 2, theme_.overlay_gpu);
+    }
+    // A 60 Hz frame budget line.
+    const float budget = graph_top + kGraphHeight - static_cast<float>(1000.0 / 60 / kGraphScale) * kGraphHeight;
+    frame_.rects.push_back({x + kPadding, budget, kPanelWidth - 2 * kPadding, 1, theme_.overlay_text});
+    frame_.batches.push_back({TextBatch::Layer::OverlayPanel, first_rect,
+                              static_cast<std::uint32_t>(frame_.rects.size()) - first_rect});
+
+    char cpu[64];
+    char gpu[64];
+    std::snprintf(cpu, sizeof cpu, "CPU %6.2f ms  p50 %6.2f  p99 %6.2f", s.cpu_last, s.cpu_p50, s.cpu_p99);
+    if (s.gpu_last > 0) {
+        std::snprintf(gpu, sizeof gpu, "GPU %6.2f ms  p50 %6.2f  p99 %6.2f", s.gpu_last, s.gpu_p50, s.gpu_p99);
+    } else {
+        std::snprintf(gpu, sizeof gpu, "GPU     -- ms");
+    }
+    const auto first_glyph = static_cast<std::uint32_t>(frame_.glyphs.size());
+    place_text(cpu, x + kPadding, y + kPadding, theme_.overlay_text);
+    place_text(gpu, x + kPadding, y + kPadding + line_height_, theme_.overlay_text);
+    frame_.batches.push_back({TextBatch::Layer::OverlayText, first_glyph,
+                              static_cast<std::uint32_t>(frame_.glyphs.size()) - first_glyph});
+}
+
+void TextView::place_text(const std::string& s, float x, float y, std::uint32_t rgba) {
+    for (const char c : s) {
+        const std::uint32_t slot = atlas_.find(static_cast<unsigned char>(c), FontStyle::Regular);
+        if (slot == GlyphAtlas::kNone) {
+            atlas_full_ = true;
+            return;
+        }
+        const AtlasGlyph& g = atlas_.glyph(slot);
+        if (g.width > 0) frame_.glyphs.push_back({x + g.left, y + ascent_ - g.top, g.u, g.v, g.width, g.height, rgba});
+        x += g.advance;
+    }
+}
+
+std::pair<std::size_t, std::size_t> TextView::visible_rows() const noexcept {
+    const double top = std::max(0.0, scroll_y_);
+    const double bottom = std::max(0.0, scroll_y_ + height_);
+    return {static_cast<std::size_t>(top / line_height_), static_cast<std::size_t>(bottom / line_height_)};
+}
+
+// Drops the shaped lines farthest from the screen once there are too many.
+void TextView::evict() {
+    const auto [first, last] = visible_rows();
+    if (lines_.size() <= kCacheLines + (last - first + 1)) return;
+    const std::size_t reach = kCacheLines / 2;
+    for (auto it = lines_.begin(); it != lines_.end();) {
+        const bool far = it->first + reach < first || it->first > last + reach;
+        it = far ? lines_.erase(it) : std::next(it);
+    }
+}
+
+}  // namespace rebel::view
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "syntax/highlighter.h"
+#include "text/rope.h"
+#include "view/frame_stats.h"
+#include "view/glyph_atlas.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rebel::view {
+
+/// One textured quad of a TextFrame, sampling the glyph atlas.
+struct GlyphInstance {
+    float x, y;  // screen pixels, top-left
+    std::uint16_t u, v, width, height;  // atlas texels
+    std::uint32_t rgba;
+};
+
+/// A solid rectangle of a TextFrame: a band's background or part of the
+/// frame-time overlay.
+struct RectInstance {
+    float x, y, width, height;  // screen pixels
+    std::uint32_t rgba;
+};
+
+/// One instanced draw: `count` instances from `first` of the rects (for the
+/// backgrounds and the overlay panel) or of the glyphs.
+struct TextBatch {
+    enum class Layer : std::uint8_t { Backgrounds, Text, OverlayPanel, OverlayText };
+    Layer layer;
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+/// Rows [y0, y1) of the screen a frame repaints.
+struct DamageBand {
+    float y0, y1;
+};
+
+/// What changed on screen since the previous frame.
+///
+/// A backend keeps the previous frame's image. Unless `full` is set it first
+/// moves that image up by `shift` pixels (down if negative), then repaints
+/// only the `damage` bands: each starts with its background rect, so drawing
+/// the batches in order over the bands is enough. The atlas region to upload
+/// first is `atlas_upload`.
+struct TextFrame {
+    std::uint64_t number = 0;  // for FrameStats::add_gpu
+    bool full = true;
+    float shift = 0;
+    std::vector<DamageBand> damage;
+    std::vector<RectInstance> rects;
+    std::vector<GlyphInstance> glyphs;
+    std::vector<TextBatch> batches;
+    AtlasRect atlas_upload;
+
+    void clear() noexcept {
+        full = false;
+        shift = 0;
+        damage.clear();
+        rects.clear();
+        glyphs.clear();
+        batches.clear();
+        atlas_upload = {};
+    }
+};
+
+/// Colours and font styles for the view, by token kind.
+struct Theme {
+    struct Style {
+        std::uint32_t rgba;
+        FontStyle font;
+    };
+    static constexpr std::size_t kTokenKinds = static_cast<std::size_t>(syntax::TokenKind::Preprocessor) + 1;
+
+    std::uint32_t background = 0x1e2127ff;
+    Style tokens[kTokenKinds] = {
+        {0xabb2bfff, FontStyle::Regular},  // Text
+        {0xc678ddff, FontStyle::Bold},     // Keyword
+        {0xe5c07bff, FontStyle::Regular},  // Type
+        {0xabb2bfff, FontStyle::Regular},  // Identifier
+        {0x61afefff, FontStyle::Regular},  // Function
+        {0xd19a66ff, FontStyle::Regular},  // Number
+        {0x98c379ff, FontStyle::Regular},  // String
+        {0x7f848eff, FontStyle::Italic},   // Comment
+        {0x56b6c2ff, FontStyle::Regular},  // Operator
+        {0xabb2bfff, FontStyle::Regular},  // Punctuation
+        {0xe06c75ff, FontStyle::Regular},  // Preprocessor
+    };
+    std::uint32_t overlay_panel = 0x000000c0;
+    std::uint32_t overlay_text = 0xffffffff;
+    std::uint32_t overlay_cpu = 0x61afefff;
+    std::uint32_t overlay_gpu = 0xe5c07bff;
+    unsigned tab_width = 4;  // in spaces
+
+    const Style& style(syntax::TokenKind kind) const { return tokens[static_cast<std::size_t>(kind)]; }
+};
+
+/// The editor's text area, drawn as instanced glyph quads from a GlyphAtlas.
+///
+/// Lines are shaped once (decoded, laid out, coloured from the highlight
+/// snapshot, with their atlas slots looked up) and the result is kept per
+/// line, so a frame is mostly copying cached quads. Long lines are shaped in
+/// kSegmentBytes segments only as far right as the view has shown, so a
+/// minified file's one huge line costs no more than the screen it fills.
+///
+/// Frames are incremental. Edits damage the lines they touch, a new
+/// highlight snapshot damages the visible lines whose tokens changed, and
+/// vertical scrolling shifts the previous image and damages only the rows
+/// scrolled in. A frame holds instances for the damaged bands alone.
+/// Horizontal scrolling, resizing and atlas resets repaint everything.
+///
+/// With the overlay on, a panel in the top-right corner shows CPU and GPU
+/// frame times (see frame_stats()) and a bar graph of recent frames.
+///
+/// Not thread-safe; the UI thread owns it.
+class TextView {
+public:
+    static constexpr std::size_t kSegmentBytes = 4096;
+    /// Shaped lines kept off screen before the farthest are dropped.
+    static constexpr std::size_t kCacheLines = 2048;
+
+    struct Stats {
+        std::uint64_t frames = 0;
+        std::uint64_t full_frames = 0;
+        std::uint64_t lines_shaped = 0;
+        std::uint64_t segments_shaped = 0;
+        std::uint64_t rows_drawn = 0;
+        std::uint64_t rows_cached = 0;  // drawn from an already shaped line
+        std::uint64_t atlas_resets = 0;
+    };
+
+    explicit TextView(GlyphAtlas& atlas, Theme theme = {});
+
+    TextView(const TextView&) = delete;
+    TextView& operator=(const TextView&) = delete;
+
+    /// Shows a different document; repaints everything.
+    void set_text(text::Rope text);
+    /// `edit` turned the previously shown text into `text`.
+    void edit(text::Rope text, const syntax::LineEdit& edit);
+    /// Colours lines from `snapshot`. Until one arrives, or for lines it does
+    /// not cover yet, text is drawn in the Text style.
+    void set_highlight(std::shared_ptr<const syntax::HighlightSnapshot> snapshot);
+
+    void resize(float width, float height);
+    /// Places the view's top-left corner at document pixel (x, y).
+    void scroll_to(double x, double y);
+    void set_overlay(bool on);
+    void damage_all() noexcept { full_ = true; }
+
+    float line_height() const noexcept { return line_height_; }
+    double scroll_x() const noexcept { return scroll_x_; }
+    double scroll_y() const noexcept { return scroll_y_; }
+    std::size_t line_count() const noexcept { return text_.line_count(); }
+
+    /// Builds the next frame. The reference stays valid until the next call.
+    const TextFrame& frame();
+
+    FrameStats& frame_stats() noexcept { return frame_stats_; }
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Segment {
+        std::size_t end = 0;        // byte offset in the line
+        std::uint32_t glyphs = 0;   // glyph count up to `end`
+        double pen = 0;             // pen position at `end`
+    };
+    struct Line {
+        std::vector<GlyphInstance> glyphs;  // x from their segment's start, y from the line top
+        std::vector<Segment> segments;
+        std::size_t length = 0;  // bytes
+        std::uint64_t highlight = 0;  // snapshot version it was checked against
+        std::vector<syntax::Token> tokens;
+    };
+
+    void damage_lines(std::size_t first, std::size_t last);
+    const std::vector<syntax::Token>& tokens_for(std::size_t line) const;
+    Line& shaped(std::size_t line, double right);
+    bool shape_segment(std::size_t line, Line& out);
+    void emit_row(std::size_t line, float y);
+    float row_y(double row) const noexcept { return static_cast<float>(row * line_height_ - scroll_y_); }
+    void build();
+    void draw_overlay();
+    void place_text(const std::string& s, float x, float y, std::uint32_t rgba);
+    std::pair<std::size_t, std::size_t> visible_rows() const noexcept;
+    void evict();
+
+    GlyphAtlas& atlas_;
+    Theme theme_;
+    float line_height_;
+    float ascent_;
+    float tab_;  // tab stop spacing, pixels
+
+    text::Rope text_;
+    std::shared_ptr<const syntax::HighlightSnapshot> highlight_;
+    std::unordered_map<std::size_t, Line> lines_;
+    std::uint64_t atlas_generation_;
+    bool atlas_full_ = false;
+
+    float width_ = 1920;
+    float height_ = 1080;
+    // Document pixels; a float would lose whole pixels a million lines in.
+    double scroll_x_ = 0;
+    double scroll_y_ = 0;
+    double drawn_scroll_y_ = 0;  // scroll_y_ of the previous frame
+    bool overlay_ = false;
+    float overlay_bottom_ = 0;  // rows the overlay covered last frame
+
+    bool full_ = true;
+    std::vector<std::pair<std::size_t, std::size_t>> damaged_;  // line ranges, inclusive
+
+    TextFrame frame_;
+    FrameStats frame_stats_;
+    Stats stats_;
+    std::uint64_t edit_started_ = 0;  // of the first edit no frame shows yet, for tracing
+    std::string scratch_;
+};
+
+}  // namespace rebel::view
@@ -0,0 +1,147 @@
+#include "visual/canvas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace rebel::visual {
+namespace {
+
+constexpr std::uint32_t kBodyColour = 0x2b2f36ff;
+constexpr std::uint32_t kPortColour = 0xc8ccd4ff;
+constexpr std::uint32_t kEdgeColour = 0x8a93a3ff;
+
+std::uint32_t header_colour(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Constant:
+        case NodeKind::Input:
+        case NodeKind::Output: return 0x3f7f5fff;
+        case NodeKind::Call: return 0x3f5f9fff;
+        case NodeKind::Subgraph: return 0x7f5f9fff;
+        case NodeKind::Select: return 0x9f7f3fff;
+        default: return 0x5f6f7fff;  // operators
+    }
+}
+
+}  // namespace
+
+Canvas::Canvas(const Graph& graph, const Rect& bounds) : nodes_(bounds), wires_(bounds) {
+    layout_.resize(graph.size());
+    for (NodeId n = 0; n < graph.size(); ++n) {
+        const Node& node = graph.node(n);
+        Layout& layout = layout_[n];
+        layout.ports = static_cast<std::uint32_t>(node.inputs.size());
+        layout.output = node.kind != NodeKind::Output;
+        layout.rgba = header_colour(node.kind);
+        for (std::uint32_t port = 0; port < node.inputs.size(); ++port) {
+            const NodeId from = node.inputs[port];
+            if (from == Graph::kUnconnected) continue;
+            layout_[from].edges.push_back(static_cast<std::uint32_t>(edges_.size()));
+            layout.edges.push_back(static_cast<std::uint32_t>(edges_.size()));
+            edges_.push_back({from, n, port});
+        }
+    }
+    for (NodeId n = 0; n < layout_.size(); ++n) nodes_.insert(n, node_rect(layout_[n]));
+    for (std::uint32_t e = 0; e < edges_.size(); ++e) wires_.insert(e, curve_rect(curve(edges_[e])));
+}
+
+void Canvas::move(NodeId node, float x, float y) {
+    if (node >= layout_.size()) throw std::out_of_range("no such node");
+    Layout& layout = layout_[node];
+    layout.x = x;
+    layout.y = y;
+    nodes_.insert(node, node_rect(layout));
+    for (std::uint32_t e : layout.edges) wires_.insert(e, curve_rect(curve(edges_[e])));
+}
+
+NodeId Canvas::node_at(float x, float y) const {
+    NodeId top = Graph::kUnconnected;
+    nodes_.query({x, y, x, y}, [&](std::uint32_t n) {
+        if (top == Graph::kUnconnected || n > top) top = n;
+    });
+    return top;
+}
+
+std::size_t Canvas::draw(const Viewport& view, DrawList& out) const {
+    out.clear();
+    const Rect area = view.visible();
+    const bool detail = view.zoom >= kDetailZoom;
+
+    // Later nodes draw over earlier ones. When most of the graph is on
+    // screen, a sweep in node order is cheaper than sorting what the
+    // query found.
+    visible_.clear();
+    nodes_.query(area, [&](std::uint32_t n) { visible_.push_back(n); });
+    if (visible_.size() * 8 > layout_.size()) {
+        visible_.clear();
+        for (NodeId n = 0; n < layout_.size(); ++n) {
+            if (nodes_.rect(n).intersects(area)) visible_.push_back(n);
+        }
+    } else {
+        std::sort(visible_.begin(), visible_.end());
+    }
+
+    wires_.query(area, [&](std::uint32_t e) { out.edges.push_back(curve(edges_[e])); });
+    if (!out.edges.empty()) {
+        out.batches.push_back({DrawBatch::Layer::Edges, 0, static_cast<std::uint32_t>(out.edges.size())});
+    }
+    if (visible_.empty()) return 0;
+
+    auto batch = [&](DrawBatch::Layer layer, std::size_t first) {
+        const auto count = static_cast<std::uint32_t>(out.quads.size() - first);
+        if (count > 0) out.batches.push_back({layer, static_cast<std::uint32_t>(first), count});
+    };
+    out.quads.reserve(visible_.size() * (detail ? 4 : 1));
+    for (NodeId n : visible_) {
+        const Rect r = nodes_.rect(n);
+        out.quads.push_back({r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, detail ? kBodyColour : layout_[n].rgba});
+    }
+    batch(DrawBatch::Layer::Bodies, 0);
+    if (!detail) return visible_.size();
+
+    std::size_t first = out.quads.size();
+    for (NodeId n : visible_) {
+        const Rect r = nodes_.rect(n);
+        out.quads.push_back({r.x0, r.y0, r.x1 - r.x0, kHeaderHeight, layout_[n].rgba});
+    }
+    batch(DrawBatch::Layer::Headers, first);
+
+    first = out.quads.size();
+    constexpr float half = kPortSize / 2;
+    for (NodeId n : visible_) {
+        const Layout& layout = layout_[n];
+        const float row = layout.y + kHeaderHeight + kPortPitch / 2 - half;
+        for (std::uint32_t port = 0; port < layout.ports; ++port) {
+            out.quads.push_back({layout.x - half, row + port * kPortPitch, kPortSize, kPortSize, kPortColour});
+        }
+        if (layout.output) out.quads.push_back({layout.x + kNodeWidth - half, row, kPortSize, kPortSize, kPortColour});
+    }
+    batch(DrawBatch::Layer::Ports, first);
+    return visible_.size();
+}
+
+Rect Canvas::node_rect(const Layout& layout) const noexcept {
+    const float rows = static_cast<float>(std::max<std::uint32_t>(layout.ports, 1));
+    return {layout.x, layout.y, layout.x + kNodeWidth, layout.y + kHeaderHeight + rows * kPortPitch};
+}
+
+// From the source's output port to the target's input port, leaving and
+// entering horizontally.
+EdgeInstance Canvas::curve(const Edge& edge) const noexcept {
+    const Layout& from = layout_[edge.from];
+    const Layout& to = layout_[edge.to];
+    const float x0 = from.x + kNodeWidth;
+    const float y0 = from.y + kHeaderHeight + kPortPitch / 2;
+    const float x3 = to.x;
+    const float y3 = to.y + kHeaderHeight + kPortPitch / 2 + static_cast<float>(edge.port) * kPortPitch;
+    const float reach = std::max(40.f, std::abs(x3 - x0) / 2);
+    return {x0, y0, x0 + reach, y0, x3 - reach, y3, x3, y3, kEdgeColour};
+}
+
+// A bezier lies inside the hull of its control points.
+Rect Canvas::curve_rect(const EdgeInstance& c) noexcept {
+    return {std::min({c.x0, c.x1, c.x2, c.x3}), std::min({c.y0, c.y1, c.y2, c.y3}),
+            std::max({c.x0, c.x1, c.x2, c.x3}), std::max({c.y0, c.y1, c.y2, c.y3})};
+}
+
+}  // namespace rebel::visual
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "visual/graph.h"
+#include "visual/quadtree.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rebel::visual {
+
+/// A rectangle of a DrawList: a node body, header or port.
+struct QuadInstance {
+    float x, y, w, h;    // canvas units
+    std::uint32_t rgba;
+};
+
+/// A cubic bezier of a DrawList, for the vertex shader to tessellate.
+struct EdgeInstance {
+    float x0, y0, x1, y1, x2, y2, x3, y3;  // canvas units
+    std::uint32_t rgba;
+};
+
+/// One instanced draw: `count` instances from `first` of the edges (for
+/// Edges) or of the quads (for the others).
+struct DrawBatch {
+    enum class Layer : std::uint8_t { Edges, Bodies, Headers, Ports };
+    Layer layer;
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+/// What a frame draws, in back-to-front batches. A backend uploads the two
+/// instance arrays once per frame and issues one instanced draw per batch,
+/// with the view transform as a uniform, so the number of draw calls does
+/// not grow with the graph.
+struct DrawList {
+    std::vector<QuadInstance> quads;
+    std::vector<EdgeInstance> edges;
+    std::vector<DrawBatch> batches;
+
+    void clear() noexcept {
+        quads.clear();
+        edges.clear();
+        batches.clear();
+    }
+};
+
+/// The part of the canvas on screen: `zoom` screen pixels per canvas unit,
+/// centred on (x, y).
+struct Viewport {
+    float x = 0;
+    float y = 0;
+    float zoom = 1;
+    float width = 1920;  // pixels
+    float height = 1080;
+
+    Rect visible() const noexcept {
+        const float hw = width / 2 / zoom;
+        const float hh = height / 2 / zoom;
+        return {x - hw, y - hh, x + hw, y + hh};
+    }
+};
+
+/// Where a graph's nodes sit on the editing canvas, and what a viewport of
+/// it draws.
+///
+/// Nodes and edges are kept in quadtrees (see visual/quadtree.h), so a
+/// frame costs in proportion to what is on screen rather than to the graph,
+/// and moving a node updates only it and its edges. Zoomed out below
+/// kDetailZoom, nodes are drawn as plain bodies without headers or ports.
+///
+/// The canvas copies the graph's wiring when it is built; rebuild it after
+/// adding nodes or edges.
+class Canvas {
+public:
+    static constexpr float kNodeWidth = 160;
+    static constexpr float kHeaderHeight = 24;
+    static constexpr float kPortPitch = 18;  // vertical distance between ports
+    static constexpr float kPortSize = 8;
+    static constexpr float kDetailZoom = 0.35f;
+
+    /// Every node starts at the origin; place them with move().
+    explicit Canvas(const Graph& graph, const Rect& bounds = {-65536, -65536, 65536, 65536});
+
+    void move(NodeId node, float x, float y);
+    /// The node's rectangle, header included.
+    const Rect& bounds(NodeId node) const { return nodes_.rect(node); }
+    std::size_t size() const noexcept { return layout_.size(); }
+
+    /// The topmost node at a point, for hit testing, or Graph::kUnconnected.
+    NodeId node_at(float x, float y) const;
+
+    /// Replaces `out` with what `view` shows. Returns the number of nodes
+    /// drawn.
+    std::size_t draw(const Viewport& view, DrawList& out) const;
+
+private:
+    struct Layout {
+        float x = 0;
+        float y = 0;
+        std::uint32_t ports = 0;  // input ports, down the left side
+        bool output = false;      // an output port on the right side
+        std::uint32_t rgba = 0;   // header colour
+        std::vector<std::uint32_t> edges;  // in and out
+    };
+    struct Edge {
+        NodeId from;
+        NodeId to;
+        std::uint32_t port;
+    };
+
+    Rect node_rect(const Layout& layout) const noexcept;
+    EdgeInstance curve(const Edge& edge) const noexcept;
+    static Rect curve_rect(const EdgeInstance& c) noexcept;
+
+    std::vector<Layout> layout_;  // by node
+    std::vector<Edge> edges_;
+    QuadTree nodes_;
+    QuadTree wires_;  // edges
+
+    // Per-draw scratch; draw() is const but not reentrant.
+    mutable std::vector<NodeId> visible_;
+};
+
+}  // namespace rebel::visual
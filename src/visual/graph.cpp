@@ -0,0 +1,157 @@
+#include "visual/graph.h"
+
+#include "core/hash.h"
+
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace rebel::visual {
+namespace {
+
+constexpr int kMaxSubgraphDepth = 64;
+
+bool makes_calls(const Graph& graph, bool impure_only, int depth) {
+    if (depth > kMaxSubgraphDepth) return true;
+    for (const Node& node : graph.nodes()) {
+        if (node.kind == NodeKind::Call && !(impure_only && node.pure)) return true;
+        if (node.kind == NodeKind::Subgraph && node.graph && makes_calls(*node.graph, impure_only, depth + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+using Hashes = std::unordered_map<const Graph*, std::uint64_t>;
+
+std::uint64_t mix(std::uint64_t hash, std::uint64_t v) { return core::hash64(&v, sizeof v, hash); }
+
+std::uint64_t content_hash(const Graph& graph, Hashes& subgraphs, int depth) {
+    std::uint64_t hash = mix(0, graph.size());
+    for (const Node& node : graph.nodes()) {
+        hash = mix(hash, static_cast<std::uint64_t>(node.kind) | static_cast<std::uint64_t>(node.pure) << 8 |
+                             static_cast<std::uint64_t>(node.value.index()) << 16);
+        hash = core::hash64(node.name, hash);
+        if (const bool* b = std::get_if<bool>(&node.value)) hash = mix(hash, *b);
+        if (const double* d = std::get_if<double>(&node.value)) hash = core::hash64(d, sizeof *d, hash);
+        if (const std::string* text = std::get_if<std::string>(&node.value)) hash = core::hash64(*text, hash);
+        hash = mix(hash, node.inputs.size());
+        for (NodeId input : node.inputs) hash = mix(hash, input);
+        hash = mix(hash, node.after.size());
+        for (NodeId before : node.after) hash = mix(hash, before);
+        if (node.kind != NodeKind::Subgraph || !node.graph) continue;
+        // Deeper than compile() accepts: any value will do.
+        if (depth > kMaxSubgraphDepth) continue;
+        auto it = subgraphs.find(node.graph.get());
+        if (it == subgraphs.end()) {
+            const std::uint64_t sub = content_hash(*node.graph, subgraphs, depth + 1);
+            it = subgraphs.emplace(node.graph.get(), sub).first;
+        }
+        hash = mix(hash, it->second);
+    }
+    return hash;
+}
+
+}  // namespace
+
+const char* node_kind_name(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Constant: return "constant";
+        case NodeKind::Input: return "input";
+        case NodeKind::Output: return "output";
+        case NodeKind::Add: return "add";
+        case NodeKind::Subtract: return "subtract";
+        case NodeKind::Multiply: return "multiply";
+        case NodeKind::Divide: return "divide";
+        case NodeKind::Modulo: return "modulo";
+        case NodeKind::Negate: return "negate";
+        case NodeKind::Equal: return "equal";
+        case NodeKind::NotEqual: return "not-equal";
+        case NodeKind::Less: return "less";
+        case NodeKind::LessEqual: return "less-equal";
+        case NodeKind::Greater: return "greater";
+        case NodeKind::GreaterEqual: return "greater-equal";
+        case NodeKind::And: return "and";
+        case NodeKind::Or: return "or";
+        case NodeKind::Not: return "not";
+        case NodeKind::Select: return "select";
+        case NodeKind::Call: return "call";
+        case NodeKind::Subgraph: return "subgraph";
+    }
+    return "?";
+}
+
+NodeId Graph::constant(Constant value) {
+    Node node;
+    node.kind = NodeKind::Constant;
+    node.value = std::move(value);
+    return add(std::move(node));
+}
+
+NodeId Graph::input(std::string name) {
+    Node node;
+    node.kind = NodeKind::Input;
+    node.name = std::move(name);
+    return add(std::move(node));
+}
+
+NodeId Graph::output(std::string name, NodeId value) {
+    Node node;
+    node.kind = NodeKind::Output;
+    node.name = std::move(name);
+    node.inputs = {value};
+    return add(std::move(node));
+}
+
+NodeId Graph::op(NodeKind kind, std::vector<NodeId> inputs) {
+    Node node;
+    node.kind = kind;
+    node.inputs = std::move(inputs);
+    return add(std::move(node));
+}
+
+NodeId Graph::call(std::string function, std::vector<NodeId> args, bool pure) {
+    Node node;
+    node.kind = NodeKind::Call;
+    node.name = std::move(function);
+    node.inputs = std::move(args);
+    node.pure = pure;
+    return add(std::move(node));
+}
+
+NodeId Graph::subgraph(std::shared_ptr<const Graph> graph, std::vector<NodeId> args) {
+    Node node;
+    node.kind = NodeKind::Subgraph;
+    node.graph = std::move(graph);
+    node.inputs = std::move(args);
+    return add(std::move(node));
+}
+
+void Graph::connect(NodeId from, NodeId to, std::size_t port) {
+    if (from >= nodes_.size() || to >= nodes_.size()) throw std::out_of_range("no such node");
+    std::vector<NodeId>& inputs = nodes_[to].inputs;
+    if (port >= inputs.size()) inputs.resize(port + 1, kUnconnected);
+    inputs[port] = from;
+}
+
+void Graph::order(NodeId before, NodeId node) {
+    if (before >= nodes_.size() || node >= nodes_.size()) throw std::out_of_range("no such node");
+    nodes_[node].after.push_back(before);
+}
+
+NodeId Graph::add(Node node) {
+    for (NodeId input : node.inputs) {
+        if (input != kUnconnected && input >= nodes_.size()) throw std::out_of_range("no such node");
+    }
+    nodes_.push_back(std::move(node));
+    return static_cast<NodeId>(nodes_.size() - 1);
+}
+
+bool makes_calls(const Graph& graph, bool impure_only) { return makes_calls(graph, impure_only, 0); }
+
+std::uint64_t content_hash(const Graph& graph) {
+    Hashes subgraphs;
+    return content_hash(graph, subgraphs, 0);
+}
+
+}  // namespace rebel::visual
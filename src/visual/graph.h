@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace rebel::visual {
+
+/// What a node computes. Operators behave like the script operator of the
+/// same name (`+` also concatenates strings), taking their operands on
+/// ports 0 and 1.
+enum class NodeKind : std::uint8_t {
+    Constant,  // value
+    Input,     // name: a parameter of the compiled function
+    Output,    // name; port 0: the value
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Negate,  // port 0
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    And,     // yields an operand and skips port 1 when port 0 decides, as in scripts
+    Or,
+    Not,     // port 0
+    Select,  // port 0 truthy ? port 1 : port 2
+    Call,    // name: a global function; ports: its arguments
+    Subgraph,  // graph, with its Input nodes bound to the ports in order
+};
+
+const char* node_kind_name(NodeKind kind);
+
+using NodeId = std::uint32_t;
+/// nil, a boolean, a number or a string.
+using Constant = std::variant<std::monostate, bool, double, std::string>;
+
+class Graph;
+
+struct Node {
+    NodeKind kind = NodeKind::Constant;
+    std::string name;             // Input, Output, Call
+    Constant value;               // Constant
+    std::vector<NodeId> inputs;   // by port; Graph::kUnconnected until connected
+    bool pure = false;            // Call: no side effects, so it may be dropped, moved or shared
+    std::vector<NodeId> after;    // nodes that must run first (Graph::order)
+    std::shared_ptr<const Graph> graph;  // Subgraph
+};
+
+/// A visual script: nodes whose inputs are wired to other nodes' values.
+///
+/// Data flows along edges and nothing else orders execution: operators,
+/// pure calls and subgraphs run when their value is needed, or not at all,
+/// and calls that are not pure run after their inputs. Compiled serially
+/// they run in node order; run in parallel (visual/parallel_graph.h),
+/// independent ones may run in any order or at once, so side effects that
+/// must happen in order declare it with order(). Run a graph by compiling
+/// it (see visual/graph_compiler.h).
+///
+/// Edges may be added in any order and may form cycles while a graph is
+/// being edited; compiling rejects cycles and unconnected ports.
+class Graph {
+public:
+    static constexpr NodeId kUnconnected = ~NodeId{0};
+
+    NodeId constant(Constant value);
+    NodeId input(std::string name);
+    NodeId output(std::string name, NodeId value = kUnconnected);
+    /// An operator or Select; `inputs` may be left kUnconnected.
+    NodeId op(NodeKind kind, std::vector<NodeId> inputs);
+    NodeId call(std::string function, std::vector<NodeId> args, bool pure = false);
+    /// `graph` must outlive compilation; it is shared, not copied.
+    NodeId subgraph(std::shared_ptr<const Graph> graph, std::vector<NodeId> args);
+
+    /// Wires `from`'s value into `to`'s input `port`, adding ports up to it.
+    /// Throws std::out_of_range for an unknown node.
+    void connect(NodeId from, NodeId to, std::size_t port);
+    /// Makes `node` run after `before` although no value flows between
+    /// them, for calls whose side effects must not be reordered. Throws
+    /// std::out_of_range for an unknown node.
+    void order(NodeId before, NodeId node);
+
+    const Node& node(NodeId id) const { return nodes_.at(id); }
+    const std::vector<Node>& nodes() const noexcept { return nodes_; }
+    std::size_t size() const noexcept { return nodes_.size(); }
+
+private:
+    NodeId add(Node node);
+
+    std::vector<Node> nodes_;
+};
+
+/// Whether running `graph` calls a function: any call, or with
+/// `impure_only` only calls that are not pure. Looks into subgraphs.
+bool makes_calls(const Graph& graph, bool impure_only = false);
+
+/// A hash of everything compiling `graph` depends on: each node's kind,
+/// name, constant, wiring, purity and ordering, and its subgraphs' content
+/// (not their identity), so equal graphs built separately hash alike.
+std::uint64_t content_hash(const Graph& graph);
+
+}  // namespace rebel::visual
@@ -0,0 +1,634 @@
+#include "visual/graph_compiler.h"
+
+#include "script/ast.h"
+#include "script/bytecode_cache.h"
+#include "script/compiler.h"
+#include "script/error.h"
+#include "script/profiler.h"
+#include "script/value.h"
+#include "script/vm.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rebel::visual {
+namespace {
+
+namespace ast = script::ast;
+using script::CompileError;
+using script::Tok;
+
+constexpr std::uint32_t kNone = ~std::uint32_t{0};
+constexpr int kMaxSubgraphDepth = 64;
+// Deeper expressions are split into locals, which bounds the temporaries
+// (and the compiler's recursion) an expression needs.
+constexpr int kMaxInlineDepth = 16;
+// Registers for locals, leaving the rest of a function's 250 to
+// expression temporaries and call arguments.
+constexpr std::size_t kMaxSlots = 192;
+
+// A node of the graph with its subgraphs inlined.
+struct Work {
+    NodeKind kind = NodeKind::Constant;
+    std::string name;
+    Constant value;
+    std::vector<std::uint32_t> inputs;
+    std::vector<std::uint32_t> after;
+    bool pure = true;
+    std::uint32_t line = 0;
+    std::uint32_t forward = kNone;  // stands for another node's value
+};
+
+// How a live node is emitted.
+enum class Emit : std::uint8_t {
+    Leaf,       // constant or parameter, written where used
+    Inline,     // part of the one expression that uses it
+    Local,      // computed once into a register
+    Statement,  // an impure call whose value nothing uses
+    Output,
+};
+
+int arity(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Constant:
+        case NodeKind::Input: return 0;
+        case NodeKind::Output:
+        case NodeKind::Negate:
+        case NodeKind::Not: return 1;
+        case NodeKind::Select: return 3;
+        case NodeKind::Call:
+        case NodeKind::Subgraph: return -1;
+        default: return 2;
+    }
+}
+
+Tok binary_token(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Add: return Tok::Plus;
+        case NodeKind::Subtract: return Tok::Minus;
+        case NodeKind::Multiply: return Tok::Star;
+        case NodeKind::Divide: return Tok::Slash;
+        case NodeKind::Modulo: return Tok::Percent;
+        case NodeKind::Equal: return Tok::Eq;
+        case NodeKind::NotEqual: return Tok::Ne;
+        case NodeKind::Less: return Tok::Lt;
+        case NodeKind::LessEqual: return Tok::Le;
+        case NodeKind::Greater: return Tok::Gt;
+        default: return Tok::Ge;
+    }
+}
+
+bool truthy(const Constant& c) {
+    if (std::holds_alternative<std::monostate>(c)) return false;
+    if (const bool* b = std::get_if<bool>(&c)) return *b;
+    return true;
+}
+
+// The script operator applied to constants, or false where it would raise
+// an error (which is left to happen at run time) or depends on formatting.
+bool evaluate(NodeKind kind, const Constant& a, const Constant& b, Constant& out) {
+    const double* x = std::get_if<double>(&a);
+    const double* y = std::get_if<double>(&b);
+    const std::string* s = std::get_if<std::string>(&a);
+    const std::string* t = std::get_if<std::string>(&b);
+    switch (kind) {
+        case NodeKind::Equal: out = a == b; return true;
+        case NodeKind::NotEqual: out = a != b; return true;
+        case NodeKind::Less:
+        case NodeKind::LessEqual:
+        case NodeKind::Greater:
+        case NodeKind::GreaterEqual: {
+            int c;
+            if (x && y) {
+                if (*x != *x || *y != *y) {
+                    out = false;  // NaN compares false either way
+                    return true;
+                }
+                c = *x < *y ? -1 : *x > *y ? 1 : 0;
+            } else if (s && t) {
+                c = s->compare(*t);
+            } else {
+                return false;
+            }
+            out = kind == NodeKind::Less        ? c < 0
+                  : kind == NodeKind::LessEqual ? c <= 0
+                  : kind == NodeKind::Greater   ? c > 0
+                                                : c >= 0;
+            return true;
+        }
+        case NodeKind::Add:
+            if (s && t) {
+                out = *s + *t;
+                return true;
+            }
+            break;
+        default: break;
+    }
+    if (!x || !y) return false;
+    switch (kind) {
+        case NodeKind::Add: out = *x + *y; return true;
+        case NodeKind::Subtract: out = *x - *y; return true;
+        case NodeKind::Multiply: out = *x * *y; return true;
+        case NodeKind::Divide: out = *x / *y; return true;
+        case NodeKind::Modulo: out = script::floor_mod(*x, *y); return true;
+        default: return false;
+    }
+}
+
+class GraphCompiler {
+public:
+    explicit GraphCompiler(std::string chunk) : chunk_(std::move(chunk)) {}
+
+    script::Function* compile(script::VM& vm, const Graph& graph, GraphStats* stats);
+
+private:
+    [[noreturn]] void fail(const std::string& message, std::uint32_t line) const {
+        throw CompileError(message, chunk_, line);
+    }
+
+    void flatten(const Graph& graph, const std::vector<std::uint32_t>* args, std::uint32_t line, int depth,
+                 std::uint32_t* output);
+    std::uint32_t resolve(std::uint32_t n) const;
+    void order();
+    bool fold(Work& w);
+    void plan();
+
+    ast::ExprPtr make(ast::ExprKind kind, std::uint32_t line) const {
+        return std::make_unique<ast::Expr>(kind, line);
+    }
+    ast::ExprPtr name(const std::string& text, std::uint32_t line) const;
+    ast::ExprPtr expr(std::uint32_t n) const;
+    ast::ExprPtr node_expr(std::uint32_t n) const;
+    ast::StmtPtr store(std::uint32_t n, ast::ExprPtr value);
+    const std::string& slot_name(std::uint32_t n) const { return slot_names_[slot_[n]]; }
+
+    std::string chunk_;
+    std::vector<Work> work_;
+    std::vector<std::uint32_t> params_;   // top-level Input nodes
+    std::vector<std::uint32_t> effects_;  // impure calls
+    std::vector<std::uint32_t> outputs_;  // top-level Output nodes
+    std::vector<std::uint32_t> order_;    // live nodes, inputs first
+    std::vector<Emit> emit_;
+    std::vector<std::uint32_t> slot_;
+    std::vector<std::string> slot_names_;
+    std::vector<bool> declared_;
+};
+
+script::Function* GraphCompiler::compile(script::VM& vm, const Graph& graph, GraphStats* stats) {
+    flatten(graph, nullptr, 0, 0, nullptr);
+
+    // Effects run in the order of the nodes that contain them.
+    std::stable_sort(effects_.begin(), effects_.end(),
+                     [&](std::uint32_t a, std::uint32_t b) { return work_[a].line < work_[b].line; });
+    order();
+    std::size_t folded = 0;
+    for (std::uint32_t n : order_) folded += fold(work_[n]) ? 1 : 0;
+    order();  // again: folding a Select cuts off the side not taken
+    plan();
+
+    ast::Block body;
+    for (std::uint32_t n : order_) {
+        const Work& w = work_[n];
+        if (emit_[n] == Emit::Statement) {
+            auto s = std::make_unique<ast::Stmt>(ast::StmtKind::Expr, w.line);
+            s->a = node_expr(n);
+            body.push_back(std::move(s));
+        } else if (emit_[n] == Emit::Local && w.kind == NodeKind::Select) {
+            if (!declared_[slot_[n]]) body.push_back(store(n, nullptr));
+            auto s = std::make_unique<ast::Stmt>(ast::StmtKind::If, w.line);
+            s->a = expr(w.inputs[0]);
+            s->body.push_back(store(n, expr(w.inputs[1])));
+            s->orelse.push_back(store(n, expr(w.inputs[2])));
+            body.push_back(std::move(s));
+        } else if (emit_[n] == Emit::Local) {
+            body.push_back(store(n, node_expr(n)));
+        }
+    }
+    if (!outputs_.empty()) {
+        const std::uint32_t line = work_[outputs_.back()].line;
+        auto s = std::make_unique<ast::Stmt>(ast::StmtKind::Return, line);
+        if (outputs_.size() == 1) {
+            s->a = expr(work_[outputs_[0]].inputs[0]);
+        } else {
+            s->a = make(ast::ExprKind::Table, line);
+            for (std::uint32_t n : outputs_) {
+                for (std::uint32_t other : outputs_) {
+                    if (other < n && work_[other].name == work_[n].name) {
+                        fail("duplicate output '" + work_[n].name + "'", work_[n].line);
+                    }
+                }
+                auto key = make(ast::ExprKind::String, work_[n].line);
+                key->text = work_[n].name;
+                s->a->keys.push_back(std::move(key));
+                s->a->list.push_back(expr(work_[n].inputs[0]));
+            }
+        }
+        body.push_back(std::move(s));
+    }
+
+    // A block, so that the locals are locals and not globals.
+    ast::FunctionDecl decl;
+    decl.name = chunk_;
+    decl.line = 1;
+    for (std::uint32_t n : params_) decl.params.push_back(work_[n].name);
+    auto block = std::make_unique<ast::Stmt>(ast::StmtKind::Block, 1);
+    block->body = std::move(body);
+    decl.body.push_back(std::move(block));
+    script::Function* fn = vm.compile(decl, chunk_);
+
+    if (stats) {
+        *stats = {};
+        stats->nodes = work_.size();
+        stats->folded = folded;
+        stats->registers = slot_names_.size();
+        std::vector<bool> live(work_.size());
+        for (std::uint32_t n : order_) {
+            live[n] = true;
+            stats->inlined += emit_[n] == Emit::Inline ? 1 : 0;
+            stats->locals += emit_[n] == Emit::Local ? 1 : 0;
+        }
+        for (std::uint32_t n = 0; n < work_.size(); ++n) {
+            // Forwarding nodes (subgraph plumbing, a folded Select) are gone
+            // rather than dead; inputs stay as parameters.
+            const Work& w = work_[n];
+            if (!live[n] && w.forward == kNone && w.kind != NodeKind::Input) ++stats->dead;
+        }
+    }
+    return fn;
+}
+
+// Appends a graph's nodes; a subgraph's Inputs forward to `args` and its
+// Output is returned through `output`.
+void GraphCompiler::flatten(const Graph& graph, const std::vector<std::uint32_t>* args, std::uint32_t line,
+                            int depth, std::uint32_t* output) {
+    const auto base = static_cast<std::uint32_t>(work_.size());
+    work_.resize(work_.size() + graph.size());
+    std::size_t next_arg = 0;
+    for (NodeId id = 0; id < graph.size(); ++id) {
+        const Node& node = graph.node(id);
+        const std::uint32_t n = base + id;
+        const std::uint32_t at = args ? line : id + 1;
+        const char* kind = node_kind_name(node.kind);
+        {
+            Work& w = work_[n];
+            w.kind = node.kind;
+            w.name = node.name;
+            w.value = node.value;
+            w.pure = node.kind != NodeKind::Call || node.pure;
+            w.line = at;
+            for (NodeId before : node.after) w.after.push_back(base + before);
+        }
+        const int expected = arity(node.kind);
+        if (expected >= 0 && node.inputs.size() > static_cast<std::size_t>(expected)) {
+            fail(std::string(kind) + " node has " + std::to_string(node.inputs.size()) + " inputs", at);
+        }
+        std::vector<std::uint32_t> inputs;
+        for (std::size_t port = 0; port < std::max<std::size_t>(node.inputs.size(), std::max(expected, 0)); ++port) {
+            if (port >= node.inputs.size() || node.inputs[port] == Graph::kUnconnected) {
+                fail("input " + std::to_string(port) + " of " + kind + " node is not connected", at);
+            }
+            if (graph.node(node.inputs[port]).kind == NodeKind::Output) {
+                fail("input " + std::to_string(port) + " of " + kind + " node is an output", at);
+            }
+            inputs.push_back(base + node.inputs[port]);
+        }
+
+        switch (node.kind) {
+            case NodeKind::Input:
+                if (!args) {
+                    params_.push_back(n);
+                } else if (next_arg < args->size()) {
+                    work_[n].forward = (*args)[next_arg++];
+                } else {
+                    fail("subgraph has more inputs than its node has ports", at);
+                }
+                break;
+            case NodeKind::Output:
+                if (!args) {
+                    outputs_.push_back(n);
+                } else if (*output != kNone) {
+                    fail("subgraph has more than one output", at);
+                } else {
+                    *output = inputs[0];
+                    work_[n].forward = inputs[0];
+                }
+                break;
+            case NodeKind::Call:
+                if (!node.pure) effects_.push_back(n);
+                break;
+            case NodeKind::Subgraph: {
+                if (!node.graph) fail("subgraph node has no graph", at);
+                if (depth >= kMaxSubgraphDepth) fail("subgraphs nest too deeply", at);
+                std::uint32_t result = kNone;
+                flatten(*node.graph, &inputs, at, depth + 1, &result);
+                if (result == kNone) fail("subgraph has no output", at);
+                work_[n].forward = result;
+                inputs.clear();
+                break;
+            }
+            default: break;
+        }
+        work_[n].inputs = std::move(inputs);
+    }
+    if (args && next_arg != args->size()) fail("subgraph node has more ports than its graph has inputs", line);
+}
+
+std::uint32_t GraphCompiler::resolve(std::uint32_t n) const {
+    for (std::size_t steps = 0; work_[n].forward != kNone; ++steps) {
+        if (steps > work_.size()) fail("graph has a cycle through this node", work_[n].line);
+        n = work_[n].forward;
+    }
+    return n;
+}
+
+// Depth-first from the effects and outputs: every node needed, after the
+// nodes it needs and those it is ordered after. Iterative, since a chain of
+// nodes can be long.
+void GraphCompiler::order() {
+    enum : std::uint8_t { kNew, kActive, kDone };
+    std::vector<std::uint8_t> state(work_.size(), kNew);
+    std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+    order_.clear();
+    auto visit = [&](std::uint32_t root) {
+        state[root] = kActive;
+        stack.emplace_back(root, 0);
+        while (!stack.empty()) {
+            const std::uint32_t n = stack.back().first;
+            const std::size_t port = stack.back().second++;
+            Work& w = work_[n];
+            if (port == w.inputs.size() + w.after.size()) {
+                state[n] = kDone;
+                order_.push_back(n);
+                stack.pop_back();
+                continue;
+            }
+            std::uint32_t input;
+            if (port < w.inputs.size()) {
+                input = w.inputs[port] = resolve(w.inputs[port]);
+            } else {
+                input = resolve(w.after[port - w.inputs.size()]);
+            }
+            if (state[input] == kActive) fail("graph has a cycle through this node", work_[input].line);
+            if (state[input] == kNew) {
+                state[input] = kActive;
+                stack.emplace_back(input, 0);
+            }
+        }
+    };
+    for (std::uint32_t n : effects_) {
+        if (state[n] == kNew) visit(n);
+    }
+    for (std::uint32_t n : outputs_) visit(n);
+}
+
+// Replaces a node whose inputs are constant by its value, or by the input
+// that a constant condition picks. Inputs are folded first.
+bool GraphCompiler::fold(Work& w) {
+    for (std::uint32_t& input : w.inputs) input = resolve(input);
+    auto constant = [&](std::size_t port) -> const Constant* {
+        const Work& input = work_[w.inputs[port]];
+        return input.kind == NodeKind::Constant ? &input.value : nullptr;
+    };
+    auto become = [&](Constant value) {
+        w.kind = NodeKind::Constant;
+        w.value = std::move(value);
+        w.inputs.clear();
+        return true;
+    };
+    switch (w.kind) {
+        case NodeKind::Constant:
+        case NodeKind::Input:
+        case NodeKind::Output:
+        case NodeKind::Call:
+        case NodeKind::Subgraph: return false;
+        case NodeKind::Select:
+            if (const Constant* c = constant(0)) {
+                w.forward = w.inputs[truthy(*c) ? 1 : 2];
+                return true;
+            }
+            return false;
+        case NodeKind::And:
+        case NodeKind::Or:
+            if (const Constant* c = constant(0)) {
+                w.forward = w.inputs[truthy(*c) == (w.kind == NodeKind::And) ? 1 : 0];
+                return true;
+            }
+            return false;
+        case NodeKind::Not:
+            if (const Constant* c = constant(0)) return become(!truthy(*c));
+            return false;
+        case NodeKind::Negate:
+            if (const Constant* c = constant(0)) {
+                if (const double* d = std::get_if<double>(c)) return become(-*d);
+            }
+            return false;
+        default: {
+            const Constant* a = constant(0);
+            const Constant* b = constant(1);
+            Constant result;
+            return a && b && evaluate(w.kind, *a, *b, result) && become(std::move(result));
+        }
+    }
+}
+
+// Decides how each live node is emitted and shares registers between
+// locals whose uses do not overlap (linear scan over the order).
+void GraphCompiler::plan() {
+    const std::size_t count = work_.size();
+    std::vector<std::uint32_t> uses(count, 0);
+    for (std::uint32_t n : order_) {
+        for (std::uint32_t input : work_[n].inputs) ++uses[input];
+    }
+    emit_.assign(count, Emit::Leaf);
+    std::vector<int> depth(count, 0);
+    for (std::uint32_t n : order_) {
+        const Work& w = work_[n];
+        int d = 0;
+        for (std::uint32_t input : w.inputs) {
+            if (emit_[input] == Emit::Inline) d = std::max(d, depth[input]);
+        }
+        depth[n] = d + 1;
+        if (w.kind == NodeKind::Constant || w.kind == NodeKind::Input) {
+            emit_[n] = Emit::Leaf;
+        } else if (w.kind == NodeKind::Output) {
+            emit_[n] = Emit::Output;
+        } else if (!w.pure) {
+            emit_[n] = uses[n] > 0 ? Emit::Local : Emit::Statement;
+        } else if (w.kind == NodeKind::Select || uses[n] > 1 || depth[n] > kMaxInlineDepth) {
+            emit_[n] = Emit::Local;
+        } else {
+            emit_[n] = Emit::Inline;
+        }
+    }
+
+    // Where each node's code ends up: an inlined node goes with its user.
+    std::vector<std::size_t> position(count, 0);
+    std::vector<std::size_t> last_use(count, 0);
+    for (std::size_t i = order_.size(); i-- > 0;) {
+        const std::uint32_t n = order_[i];
+        if (emit_[n] == Emit::Output) {
+            position[n] = order_.size();
+        } else if (emit_[n] != Emit::Inline) {
+            position[n] = i;
+        }
+        for (std::uint32_t input : work_[n].inputs) {
+            if (emit_[input] == Emit::Inline) position[input] = position[n];
+            last_use[input] = std::max(last_use[input], position[n]);
+        }
+    }
+
+    slot_.assign(count, kNone);
+    std::vector<std::uint32_t> spare;  // slots, highest first
+    std::vector<std::uint32_t> active;
+    for (std::size_t i = 0; i < order_.size(); ++i) {
+        const std::uint32_t n = order_[i];
+        if (emit_[n] != Emit::Local) continue;
+        for (std::size_t a = 0; a < active.size();) {
+            if (last_use[active[a]] < i) {
+                spare.push_back(slot_[active[a]]);
+                active[a] = active.back();
+                active.pop_back();
+            } else {
+                ++a;
+            }
+        }
+        std::sort(spare.begin(), spare.end(), std::greater<>());
+        if (spare.empty()) {
+            if (slot_names_.size() == kMaxSlots) fail("graph keeps too many values at once", work_[n].line);
+            slot_names_.push_back("#" + std::to_string(slot_names_.size()));
+            spare.push_back(static_cast<std::uint32_t>(slot_names_.size() - 1));
+        }
+        slot_[n] = spare.back();
+        spare.pop_back();
+        active.push_back(n);
+    }
+    declared_.assign(slot_names_.size(), false);
+}
+
+ast::ExprPtr GraphCompiler::name(const std::string& text, std::uint32_t line) const {
+    auto e = make(ast::ExprKind::Name, line);
+    e->text = text;
+    return e;
+}
+
+ast::ExprPtr GraphCompiler::expr(std::uint32_t n) const {
+    const Work& w = work_[n];
+    if (emit_[n] == Emit::Local) return name(slot_name(n), w.line);
+    if (w.kind == NodeKind::Input) return name(w.name, w.line);
+    if (w.kind != NodeKind::Constant) return node_expr(n);
+    if (std::holds_alternative<std::monostate>(w.value)) return make(ast::ExprKind::Nil, w.line);
+    if (const bool* b = std::get_if<bool>(&w.value)) return make(*b ? ast::ExprKind::True : ast::ExprKind::False, w.line);
+    if (const double* d = std::get_if<double>(&w.value)) {
+        auto e = make(ast::ExprKind::Number, w.line);
+        e->number = *d;
+        return e;
+    }
+    auto e = make(ast::ExprKind::String, w.line);
+    e->text = std::get<std::string>(w.value);
+    return e;
+}
+
+// The node's own operation over its inputs' expressions.
+ast::ExprPtr GraphCompiler::node_expr(std::uint32_t n) const {
+    const Work& w = work_[n];
+    switch (w.kind) {
+        case NodeKind::Call: {
+            auto e = make(ast::ExprKind::Call, w.line);
+            e->a = name(w.name, w.line);
+            for (std::uint32_t input : w.inputs) e->list.push_back(expr(input));
+            return e;
+        }
+        case NodeKind::Negate:
+        case NodeKind::Not: {
+            auto e = make(ast::ExprKind::Unary, w.line);
+            e->op = w.kind == NodeKind::Negate ? Tok::Minus : Tok::Not;
+            e->a = expr(w.inputs[0]);
+            return e;
+        }
+        case NodeKind::And:
+        case NodeKind::Or: {
+            auto e = make(w.kind == NodeKind::And ? ast::ExprKind::And : ast::ExprKind::Or, w.line);
+            e->a = expr(w.inputs[0]);
+            e->b = expr(w.inputs[1]);
+            return e;
+        }
+        default: {
+            auto e = make(ast::ExprKind::Binary, w.line);
+            e->op = binary_token(w.kind);
+            e->a = expr(w.inputs[0]);
+            e->b = expr(w.inputs[1]);
+            return e;
+        }
+    }
+}
+
+// `let` on a register's first use, assignment after; a null value declares
+// it nil.
+ast::StmtPtr GraphCompiler::store(std::uint32_t n, ast::ExprPtr value) {
+    const std::uint32_t line = work_[n].line;
+    if (!declared_[slot_[n]]) {
+        declared_[slot_[n]] = true;
+        auto s = std::make_unique<ast::Stmt>(ast::StmtKind::Let, line);
+        s->name = slot_name(n);
+        s->a = std::move(value);
+        return s;
+    }
+    auto s = std::make_unique<ast::Stmt>(ast::StmtKind::Assign, line);
+    s->op = Tok::Assign;
+    s->a = name(slot_name(n), line);
+    s->b = std::move(value);
+    return s;
+}
+
+}  // namespace
+
+script::Function* compile(script::VM& vm, const Graph& graph, std::string chunk, GraphStats* stats) {
+    return GraphCompiler(std::move(chunk)).compile(vm, graph, stats);
+}
+
+script::Function* compile_cached(script::BytecodeCache& cache, script::VM& vm, const Graph& graph, std::string chunk,
+                                 GraphStats* stats) {
+    static_assert(std::is_trivially_copyable_v<GraphStats>, "GraphStats is stored as bytes");
+    // Graphs are lowered to the script compiler's AST, so both versions
+    // matter.
+    const std::uint64_t key =
+        script::BytecodeCache::key(content_hash(graph), kGraphCompilerVersion << 16 | script::kCompilerVersion);
+    std::string metadata;
+    if (script::Function* fn = cache.load(vm, key, chunk, &metadata)) {
+        if (stats && metadata.size() == sizeof *stats) std::memcpy(stats, metadata.data(), sizeof *stats);
+        return fn;
+    }
+    GraphStats compiled;
+    script::Function* fn = compile(vm, graph, std::move(chunk), &compiled);
+    cache.store(vm, key, *fn, std::string_view(reinterpret_cast<const char*>(&compiled), sizeof compiled));
+    if (stats) *stats = compiled;
+    return fn;
+}
+
+std::vector<NodeCost> node_costs(const script::Profile& profile, const std::string& chunk, const Graph& graph) {
+    std::vector<NodeCost> costs(graph.size());
+    std::vector<bool> seen(graph.size());
+    for (const script::Profile::Stack& stack : profile.stacks) {
+        std::fill(seen.begin(), seen.end(), false);
+        for (std::size_t i = 0; i < stack.frames.size(); ++i) {
+            const script::Profile::Frame& frame = profile.frames[stack.frames[i]];
+            // Line n is node n - 1.
+            if (frame.chunk != chunk || frame.line == 0 || frame.line > graph.size()) continue;
+            const std::size_t node = frame.line - 1;
+            if (i + 1 == stack.frames.size()) costs[node].self += stack.samples;
+            if (!seen[node]) {
+                seen[node] = true;
+                costs[node].total += stack.samples;
+            }
+        }
+    }
+    return costs;
+}
+
+}  // namespace rebel::visual
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "visual/graph.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rebel::script {
+class BytecodeCache;
+class VM;
+struct Function;
+struct Profile;
+}  // namespace rebel::script
+
+namespace rebel::visual {
+
+/// Changes whenever the code compile() generates for some graph changes,
+/// like script::kCompilerVersion for source.
+constexpr std::uint32_t kGraphCompilerVersion = 1;
+
+/// What compile() did to a graph.
+struct GraphStats {
+    std::size_t nodes = 0;     // after inlining subgraphs
+    std::size_t dead = 0;      // removed: nothing that runs needs their value
+    std::size_t folded = 0;    // computed at compile time
+    std::size_t inlined = 0;   // emitted as part of the expression using them
+    std::size_t locals = 0;    // values kept in a register for several uses
+    std::size_t registers = 0; // registers those locals share
+};
+
+/// Compiles `graph` into the same bytecode as a text script: a function
+/// whose parameters are the graph's Input nodes in node order and which
+/// returns the value of its Output node, a table of them keyed by name if
+/// there are several, or nothing if there are none.
+///
+/// Subgraphs are inlined, the nodes are ordered by their dependencies,
+/// nodes that no output or impure call needs are dropped, constant
+/// subexpressions (and Select on a constant) are evaluated, and a value
+/// used once becomes part of the expression using it instead of a local.
+/// A pure value used only by one side of a Select is only computed on that
+/// side. Line n of the chunk is node n - 1 of `graph`, so runtime errors
+/// and breakpoints name nodes; nodes inlined from a subgraph share its
+/// node's line.
+///
+/// Throws script::CompileError for a cycle, an unconnected or extra port,
+/// or a graph too large for one function.
+script::Function* compile(script::VM& vm, const Graph& graph, std::string chunk = "graph",
+                          GraphStats* stats = nullptr);
+
+/// compile() through `cache`, keyed by content_hash(graph): a graph that
+/// has not changed since it was last compiled is loaded instead, with the
+/// GraphStats of that compilation.
+script::Function* compile_cached(script::BytecodeCache& cache, script::VM& vm, const Graph& graph,
+                                 std::string chunk = "graph", GraphStats* stats = nullptr);
+
+/// Samples a script::Profiler took in a compiled graph, for one node.
+struct NodeCost {
+    std::uint64_t self = 0;   // while running the node itself
+    std::uint64_t total = 0;  // while the node was anywhere on the stack
+};
+
+/// The samples in `profile` on lines of `chunk`, one entry per node of
+/// `graph` (the graph compile() turned into that chunk). Time in an
+/// inlined subgraph goes to its node; time in a callee outside the chunk
+/// counts toward the calling node's total.
+std::vector<NodeCost> node_costs(const script::Profile& profile, const std::string& chunk, const Graph& graph);
+
+}  // namespace rebel::visual
@@ -0,0 +1,244 @@
+#include "visual/live_graph.h"
+
+#include "script/object.h"
+#include "visual/graph_compiler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+namespace rebel::visual {
+namespace {
+
+using script::Value;
+
+constexpr NodeId kNone = ~NodeId{0};
+
+bool same(const Value& a, const Value& b) { return a.type() == b.type() && script::values_equal(a, b); }
+
+}  // namespace
+
+LiveGraph::LiveGraph(script::VM& vm, const Graph& graph, std::string chunk, std::size_t memo)
+    : vm_(vm), memo_(memo) {
+    {
+        // Reports errors against the whole graph; the parts are then well
+        // formed.
+        script::VM check;
+        compile(check, graph, chunk);
+    }
+
+    const std::size_t count = graph.size();
+    std::vector<std::size_t> input_slot(count, kNotCached);
+    std::vector<bool> cached(count);
+    std::vector<NodeId> roots;
+    for (NodeId n = 0; n < count; ++n) {
+        const Node& node = graph.node(n);
+        if (node.kind == NodeKind::Input) {
+            input_slot[n] = inputs_.size();
+            inputs_.push_back(node.name);
+        }
+        cached[n] = node.kind == NodeKind::Call || node.kind == NodeKind::Output ||
+                    (node.kind == NodeKind::Subgraph && makes_calls(*node.graph));
+        const bool effect = (node.kind == NodeKind::Call && !node.pure) ||
+                            (node.kind == NodeKind::Subgraph && makes_calls(*node.graph, true));
+        if (effect || node.kind == NodeKind::Output) roots.push_back(n);
+    }
+
+    // Cached nodes that run, each after what it reads and what it is
+    // ordered after.
+    cached_of_.assign(count, kNotCached);
+    std::vector<bool> seen(count);
+    std::vector<std::pair<NodeId, std::size_t>> stack;
+    for (NodeId root : roots) {
+        if (seen[root]) continue;
+        seen[root] = true;
+        stack.emplace_back(root, 0);
+        while (!stack.empty()) {
+            const NodeId n = stack.back().first;
+            const std::size_t port = stack.back().second++;
+            const Node& node = graph.node(n);
+            if (port == node.inputs.size() + node.after.size()) {
+                stack.pop_back();
+                if (!cached[n]) continue;
+                cached_of_[n] = cached_.size();
+                cached_.emplace_back();
+                cached_.back().node = n;
+                continue;
+            }
+            const NodeId next = port < node.inputs.size() ? node.inputs[port] : node.after[port - node.inputs.size()];
+            if (!seen[next]) {
+                seen[next] = true;
+                stack.emplace_back(next, 0);
+            }
+        }
+    }
+
+    const std::size_t slots = inputs_.size() + cached_.size();
+    values_.reserve(slots);
+    for (std::size_t s = 0; s < slots; ++s) values_.emplace_back(vm, Value());
+    readers_.resize(slots);
+
+    // Each cached node becomes a function of the values it reads, with
+    // the cheap nodes in between copied in.
+    for (std::size_t c = 0; c < cached_.size(); ++c) {
+        Cached& entry = cached_[c];
+        const Node& root = graph.node(entry.node);
+        Graph part;
+        std::vector<NodeId> copied(count, kNone);
+        auto copy = [&](NodeId from) {
+            std::vector<std::pair<NodeId, std::size_t>> work{{from, 0}};
+            while (!work.empty()) {
+                const NodeId n = work.back().first;
+                const Node& node = graph.node(n);
+                if (copied[n] != kNone) {
+                    work.pop_back();
+                    continue;
+                }
+                const bool read = node.kind == NodeKind::Input || cached[n];
+                if (!read && node.kind != NodeKind::Constant) {
+                    const std::size_t port = work.back().second++;
+                    if (port < node.inputs.size()) {
+                        work.emplace_back(node.inputs[port], 0);
+                        continue;
+                    }
+                }
+                work.pop_back();
+                if (read) {
+                    copied[n] = part.input("#" + std::to_string(n));
+                    const std::size_t slot =
+                        node.kind == NodeKind::Input ? input_slot[n] : inputs_.size() + cached_of_[n];
+                    entry.sources.push_back(slot);
+                    readers_[slot].push_back(c);
+                } else if (node.kind == NodeKind::Constant) {
+                    copied[n] = part.constant(node.value);
+                } else {
+                    std::vector<NodeId> inputs;
+                    for (NodeId input : node.inputs) inputs.push_back(copied[input]);
+                    copied[n] = node.kind == NodeKind::Subgraph ? part.subgraph(node.graph, std::move(inputs))
+                                                                : part.op(node.kind, std::move(inputs));
+                }
+            }
+        };
+        std::vector<NodeId> args;
+        for (NodeId input : root.inputs) {
+            copy(input);
+            args.push_back(copied[input]);
+        }
+        NodeId value = kNone;
+        if (root.kind == NodeKind::Output) {
+            value = args[0];
+            entry.pure = true;
+            output_slots_.push_back(inputs_.size() + c);
+        } else if (root.kind == NodeKind::Call) {
+            value = part.call(root.name, std::move(args), root.pure);
+            entry.pure = root.pure;
+        } else {
+            value = part.subgraph(root.graph, std::move(args));
+            entry.pure = !makes_calls(*root.graph, true);
+        }
+        part.output("value", value);
+        script::Function* fn = compile(vm, part, chunk + "#" + std::to_string(entry.node));
+        entry.function = script::VM::Handle(vm, Value::object(fn));
+    }
+
+    // Outputs by node order, as visual::compile names them.
+    std::vector<std::pair<NodeId, std::size_t>> outputs;
+    for (std::size_t slot : output_slots_) outputs.emplace_back(cached_[slot - inputs_.size()].node, slot);
+    std::sort(outputs.begin(), outputs.end());
+    output_slots_.clear();
+    for (const auto& [node, slot] : outputs) {
+        outputs_.push_back(graph.node(node).name);
+        output_slots_.push_back(slot);
+    }
+}
+
+void LiveGraph::set_input(std::size_t index, const Value& value) {
+    if (index >= inputs_.size()) throw std::out_of_range("no such input");
+    if (same(values_[index].get(), value)) return;
+    values_[index].set(value);
+    invalidate(index);
+}
+
+void LiveGraph::set_input(std::string_view name, const Value& value) {
+    for (std::size_t i = 0; i < inputs_.size(); ++i) {
+        if (inputs_[i] == name) return set_input(i, value);
+    }
+    throw std::out_of_range("no input named " + std::string(name));
+}
+
+std::size_t LiveGraph::evaluate() {
+    std::size_t executed = 0;
+    std::vector<Value> args;
+    for (std::size_t c = 0; c < cached_.size(); ++c) {
+        Cached& entry = cached_[c];
+        if (!entry.dirty) continue;
+
+        args.clear();
+        for (std::size_t slot : entry.sources) args.push_back(values_[slot].get());
+        Value value;
+        bool hit = false;
+        if (entry.pure) {
+            for (std::size_t m = 0; m < entry.memo.size() && !hit; ++m) {
+                const Memo& memo = entry.memo[m];
+                hit = true;
+                for (std::size_t a = 0; a < args.size() && hit; ++a) hit = same(memo.args[a].get(), args[a]);
+                if (hit) {
+                    value = memo.value.get();
+                    std::rotate(entry.memo.begin(), entry.memo.begin() + static_cast<std::ptrdiff_t>(m),
+                                entry.memo.begin() + static_cast<std::ptrdiff_t>(m) + 1);
+                }
+            }
+        }
+        if (hit) {
+            ++entry.stats.hits;
+        } else {
+            // The arguments are rooted by their slots during the call.
+            value = vm_.call(entry.function.get(), args);
+            ++entry.stats.misses;
+            ++executed;
+            if (entry.pure && memo_ > 0) {
+                if (entry.memo.size() == memo_) entry.memo.pop_back();
+                Memo memo;
+                for (const Value& arg : args) memo.args.emplace_back(vm_, arg);
+                memo.value = script::VM::Handle(vm_, value);
+                entry.memo.insert(entry.memo.begin(), std::move(memo));
+            }
+        }
+        entry.dirty = false;
+
+        const std::size_t slot = inputs_.size() + c;
+        if (entry.valid && same(values_[slot].get(), value)) continue;
+        values_[slot].set(value);
+        entry.valid = true;
+        invalidate(slot);
+    }
+    return executed;
+}
+
+Value LiveGraph::output(std::size_t index) const {
+    if (index >= output_slots_.size()) throw std::out_of_range("no such output");
+    return values_[output_slots_[index]].get();
+}
+
+Value LiveGraph::output(std::string_view name) const {
+    for (std::size_t i = 0; i < outputs_.size(); ++i) {
+        if (outputs_[i] == name) return output(i);
+    }
+    throw std::out_of_range("no output named " + std::string(name));
+}
+
+NodeCacheStats LiveGraph::stats(NodeId node) const {
+    if (node >= cached_of_.size() || cached_of_[node] == kNotCached) return {};
+    return cached_[cached_of_[node]].stats;
+}
+
+void LiveGraph::reset_stats() {
+    for (Cached& entry : cached_) entry.stats = {};
+}
+
+void LiveGraph::invalidate(std::size_t slot) {
+    for (std::size_t reader : readers_[slot]) cached_[reader].dirty = true;
+}
+
+}  // namespace rebel::visual
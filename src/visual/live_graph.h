@@ -0,0 +1,93 @@
+#pragma once
+
+#include "script/vm.h"
+#include "visual/graph.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::visual {
+
+/// How one node of a LiveGraph has been served, for the graph view.
+struct NodeCacheStats {
+    std::size_t hits = 0;    // value reused: the inputs matched a cached run
+    std::size_t misses = 0;  // executed
+};
+
+/// A graph that stays evaluated while its inputs change, for live
+/// previews: evaluate() re-executes only what a changed input reaches.
+///
+/// Calls, subgraphs that make calls and outputs are the nodes that cache
+/// their values; each compiles to its own function, computing the cheap
+/// nodes between it and the cached nodes it reads. A cached node runs again
+/// only when one of those values changed since it last ran, and a pure one
+/// first looks its inputs up among its last `memo` runs, so switching back
+/// to an earlier file or setting is a cache hit. A node that recomputes the
+/// value it had leaves the nodes after it clean. Calls that are not pure
+/// run whenever their inputs change, in an order Graph::order() respects.
+///
+/// Values are compared as scripts compare them, so tables are compared by
+/// identity: a call that mutates a table it was passed should not be pure.
+class LiveGraph {
+public:
+    /// Throws script::CompileError as visual::compile does. Inputs start as
+    /// nil and nothing has run; the first evaluate() runs every live node.
+    /// Runtime errors come from chunk "<chunk>#<node>".
+    LiveGraph(script::VM& vm, const Graph& graph, std::string chunk = "graph", std::size_t memo = 4);
+    LiveGraph(const LiveGraph&) = delete;
+    LiveGraph& operator=(const LiveGraph&) = delete;
+
+    /// Sets an Input node's value, by position among the graph's inputs or
+    /// by name. Throws std::out_of_range for an unknown input.
+    void set_input(std::size_t index, const script::Value& value);
+    void set_input(std::string_view name, const script::Value& value);
+
+    /// Brings the outputs up to date and returns how many nodes executed.
+    /// A runtime error propagates and leaves the failed node, and what it
+    /// feeds, to run again at the next call.
+    std::size_t evaluate();
+
+    /// An Output node's value as of the last evaluate(), by position
+    /// among the graph's outputs or by name.
+    script::Value output(std::size_t index) const;
+    script::Value output(std::string_view name) const;
+
+    /// Zeroes for nodes evaluated as part of a cached node.
+    NodeCacheStats stats(NodeId node) const;
+    /// Nodes that cache their value and count in stats().
+    std::size_t cached() const noexcept { return cached_.size(); }
+    void reset_stats();
+
+private:
+    struct Memo {
+        std::vector<script::VM::Handle> args;
+        script::VM::Handle value;
+    };
+    struct Cached {
+        NodeId node = 0;
+        script::VM::Handle function;
+        std::vector<std::size_t> sources;  // slots of the values it reads
+        bool pure = false;
+        bool dirty = true;
+        bool valid = false;      // its slot holds its value
+        std::vector<Memo> memo;  // most recent first
+        NodeCacheStats stats;
+    };
+    static constexpr std::size_t kNotCached = ~std::size_t{0};
+
+    void invalidate(std::size_t slot);
+
+    script::VM& vm_;
+    std::size_t memo_;
+    std::vector<Cached> cached_;                      // each after what it reads
+    std::vector<script::VM::Handle> values_;          // by slot: the inputs, then cached_
+    std::vector<std::vector<std::size_t>> readers_;   // by slot, the cached_ reading it
+    std::vector<std::string> inputs_;                 // names, by slot
+    std::vector<std::string> outputs_;                // names
+    std::vector<std::size_t> output_slots_;
+    std::vector<std::size_t> cached_of_;              // by node, or kNotCached
+};
+
+}  // namespace rebel::visual
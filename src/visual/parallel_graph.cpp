@@ -0,0 +1,296 @@
+#include "visual/parallel_graph.h"
+
+#include "script/error.h"
+#include "visual/graph_compiler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace rebel::visual {
+namespace {
+
+using script::Value;
+
+constexpr NodeId kNone = ~NodeId{0};
+
+Value to_value(script::VM& vm, const Constant& c) {
+    if (const bool* b = std::get_if<bool>(&c)) return Value::boolean(*b);
+    if (const double* d = std::get_if<double>(&c)) return Value::number(*d);
+    if (const std::string* s = std::get_if<std::string>(&c)) return vm.new_string(*s);
+    return Value();
+}
+
+Constant to_constant(const Value& v) {
+    switch (v.type()) {
+        case script::ValueType::Nil: return {};
+        case script::ValueType::Bool: return v.as_bool();
+        case script::ValueType::Number: return v.as_number();
+        case script::ValueType::String: return std::string(v.as_string()->view());
+        default:
+            throw script::RuntimeError(std::string("cannot pass a ") + script::type_name(v.type()) +
+                                       " between parallel tasks");
+    }
+}
+
+void merge(std::vector<NodeId>& into, const std::vector<NodeId>& from) {
+    std::vector<NodeId> merged;
+    std::set_union(into.begin(), into.end(), from.begin(), from.end(), std::back_inserter(merged));
+    into = std::move(merged);
+}
+
+}  // namespace
+
+ParallelGraph::ParallelGraph(const Graph& graph, core::WorkStealingPool& pool, const Setup& setup) : pool_(pool) {
+    {
+        // Reports cycles, unconnected ports and the like against the
+        // graph's own node numbers; the tasks are then well formed.
+        script::VM check;
+        compile(check, graph, "graph");
+    }
+    split(graph);
+    pending_ = std::make_unique<std::atomic<std::size_t>[]>(tasks_.size());
+    workers_.resize(pool.size());
+    for (Worker& worker : workers_) {
+        worker.vm = std::make_unique<script::VM>();
+        if (setup) setup(*worker.vm);
+        for (std::size_t t = 0; t < tasks_.size(); ++t) {
+            script::Function* fn = compile(*worker.vm, tasks_[t].graph, "graph/task" + std::to_string(t));
+            worker.functions.emplace_back(*worker.vm, Value::object(fn));
+        }
+    }
+}
+
+ParallelGraph::~ParallelGraph() = default;
+
+// Tasks are chains of calls: a call joins its producer's task when it is
+// the producer's only consumer and the producer its only producer. Other
+// nodes are copied into each task using them.
+void ParallelGraph::split(const Graph& graph) {
+    const std::size_t count = graph.size();
+    std::vector<bool> unit(count);
+    std::vector<NodeId> roots;
+    std::vector<NodeId> outputs;
+    std::vector<std::size_t> argument(count, kArgument);
+    std::size_t arguments = 0;
+    for (NodeId n = 0; n < count; ++n) {
+        const Node& node = graph.node(n);
+        unit[n] = node.kind == NodeKind::Call || (node.kind == NodeKind::Subgraph && makes_calls(*node.graph));
+        const bool effect = (node.kind == NodeKind::Call && !node.pure) ||
+                            (node.kind == NodeKind::Subgraph && makes_calls(*node.graph, true));
+        if (effect) roots.push_back(n);
+        if (node.kind == NodeKind::Output) outputs.push_back(n);
+        if (node.kind == NodeKind::Input) argument[n] = arguments++;
+    }
+    roots.insert(roots.end(), outputs.begin(), outputs.end());
+
+    // Live nodes, each after what it needs (the graph compiled, so there
+    // are no cycles).
+    std::vector<NodeId> order;
+    std::vector<bool> seen(count);
+    std::vector<std::pair<NodeId, std::size_t>> stack;
+    for (NodeId root : roots) {
+        if (seen[root]) continue;
+        seen[root] = true;
+        stack.emplace_back(root, 0);
+        while (!stack.empty()) {
+            const NodeId n = stack.back().first;
+            const std::size_t port = stack.back().second++;
+            const Node& node = graph.node(n);
+            if (port == node.inputs.size() + node.after.size()) {
+                order.push_back(n);
+                stack.pop_back();
+                continue;
+            }
+            const NodeId next = port < node.inputs.size() ? node.inputs[port] : node.after[port - node.inputs.size()];
+            if (!seen[next]) {
+                seen[next] = true;
+                stack.emplace_back(next, 0);
+            }
+        }
+    }
+
+    // The calls each node's value depends on directly (through cheap nodes
+    // only), and each call's producers and consumers.
+    std::vector<std::vector<NodeId>> frontier(count);
+    std::vector<std::vector<NodeId>> producers(count);
+    std::vector<std::vector<NodeId>> consumers(count);
+    std::vector<bool> to_final(count);
+    std::vector<NodeId> units;
+    for (NodeId n : order) {
+        const Node& node = graph.node(n);
+        std::vector<NodeId> needs;
+        for (NodeId input : node.inputs) merge(needs, frontier[input]);
+        for (NodeId before : node.after) merge(needs, unit[before] ? std::vector<NodeId>{before} : frontier[before]);
+        if (node.kind == NodeKind::Output) {
+            for (NodeId p : needs) to_final[p] = true;
+        } else if (unit[n]) {
+            for (NodeId p : needs) consumers[p].push_back(n);
+            producers[n] = std::move(needs);
+            frontier[n] = {n};
+            units.push_back(n);
+        } else {
+            frontier[n] = std::move(needs);
+        }
+    }
+
+    std::vector<std::size_t> task_of(count, kArgument);
+    std::vector<std::vector<NodeId>> members;
+    for (NodeId u : units) {
+        const std::vector<NodeId>& p = producers[u];
+        if (p.size() == 1 && consumers[p[0]].size() == 1 && !to_final[p[0]]) {
+            task_of[u] = task_of[p[0]];
+        } else {
+            task_of[u] = members.size();
+            members.emplace_back();
+        }
+        members[task_of[u]].push_back(u);
+    }
+    const std::size_t final_task = members.size();
+    tasks_.resize(members.size() + 1);
+
+    std::vector<std::size_t> export_index(count, kArgument);
+    for (std::size_t t = 0; t <= final_task; ++t) {
+        Task& task = tasks_[t];
+        std::vector<NodeId> copied(count, kNone);
+        std::vector<std::size_t> depends;
+
+        // Depth-first, so that a node's inputs exist before it.
+        auto copy = [&](NodeId root) {
+            std::vector<std::pair<NodeId, std::size_t>> work{{root, 0}};
+            while (!work.empty()) {
+                const NodeId n = work.back().first;
+                const Node& node = graph.node(n);
+                if (copied[n] != kNone) {
+                    work.pop_back();
+                    continue;
+                }
+                const bool imported = node.kind == NodeKind::Input || (unit[n] && task_of[n] != t);
+                if (!imported && node.kind != NodeKind::Constant) {
+                    const std::size_t port = work.back().second++;
+                    if (port < node.inputs.size()) {
+                        work.emplace_back(node.inputs[port], 0);
+                        continue;
+                    }
+                }
+                work.pop_back();
+                if (node.kind == NodeKind::Input) {
+                    copied[n] = task.graph.input(node.name);
+                    task.inputs.push_back({kArgument, argument[n]});
+                } else if (imported) {
+                    copied[n] = task.graph.input("#" + std::to_string(n));
+                    task.inputs.push_back({task_of[n], export_index[n]});
+                    depends.push_back(task_of[n]);
+                } else if (node.kind == NodeKind::Constant) {
+                    copied[n] = task.graph.constant(node.value);
+                } else {
+                    std::vector<NodeId> inputs;
+                    for (NodeId input : node.inputs) inputs.push_back(copied[input]);
+                    if (node.kind == NodeKind::Call) {
+                        copied[n] = task.graph.call(node.name, std::move(inputs), node.pure);
+                    } else if (node.kind == NodeKind::Subgraph) {
+                        copied[n] = task.graph.subgraph(node.graph, std::move(inputs));
+                    } else {
+                        copied[n] = task.graph.op(node.kind, std::move(inputs));
+                    }
+                }
+            }
+        };
+
+        if (t < final_task) {
+            for (NodeId u : members[t]) {
+                copy(u);
+                for (NodeId p : producers[u]) {
+                    if (task_of[p] != t) depends.push_back(task_of[p]);
+                }
+                for (NodeId before : graph.node(u).after) {
+                    if (unit[before] && task_of[before] == t) task.graph.order(copied[before], copied[u]);
+                }
+            }
+            for (NodeId u : members[t]) {
+                const bool needed = to_final[u] || std::any_of(consumers[u].begin(), consumers[u].end(),
+                                                               [&](NodeId c) { return task_of[c] != t; });
+                if (!needed) continue;
+                export_index[u] = task.exports.size();
+                task.exports.push_back("#" + std::to_string(u));
+                task.graph.output(task.exports.back(), copied[u]);
+            }
+        } else {
+            for (NodeId o : outputs) {
+                copy(graph.node(o).inputs[0]);
+                task.exports.push_back(graph.node(o).name);
+                task.graph.output(task.exports.back(), copied[graph.node(o).inputs[0]]);
+            }
+            for (NodeId u : units) {
+                if (to_final[u]) depends.push_back(task_of[u]);
+            }
+        }
+
+        std::sort(depends.begin(), depends.end());
+        depends.erase(std::unique(depends.begin(), depends.end()), depends.end());
+        task.producers = depends.size();
+        for (std::size_t d : depends) tasks_[d].dependents.push_back(t);
+    }
+}
+
+std::vector<Constant> ParallelGraph::run(const std::vector<Constant>& args) {
+    args_ = &args;
+    values_.assign(tasks_.size(), {});
+    failed_ = false;
+    error_ = nullptr;
+    remaining_ = tasks_.size();
+    for (std::size_t t = 0; t < tasks_.size(); ++t) pending_[t] = tasks_[t].producers;
+    for (std::size_t t = 0; t < tasks_.size(); ++t) {
+        if (tasks_[t].producers == 0) schedule(t);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_ == 0; });
+    if (error_) std::rethrow_exception(error_);
+    return std::move(values_.back());
+}
+
+void ParallelGraph::schedule(std::size_t task) {
+    pool_.submit([this, task] { execute(task); });
+}
+
+void ParallelGraph::execute(std::size_t t) {
+    const Task& task = tasks_[t];
+    if (!failed_) {
+        try {
+            Worker& worker = workers_[pool_.worker_index()];
+            script::VM& vm = *worker.vm;
+            std::vector<Value> args;
+            args.reserve(task.inputs.size());
+            for (const Source& source : task.inputs) {
+                if (source.task != kArgument) {
+                    args.push_back(to_value(vm, values_[source.task][source.index]));
+                } else if (source.index < args_->size()) {
+                    args.push_back(to_value(vm, (*args_)[source.index]));
+                } else {
+                    args.emplace_back();
+                }
+            }
+            const Value result = vm.call(worker.functions[t].get(), args);
+            std::vector<Constant>& values = values_[t];
+            if (task.exports.size() == 1) {
+                values.push_back(to_constant(result));
+            } else if (task.exports.size() > 1) {
+                for (const std::string& name : task.exports) {
+                    values.push_back(to_constant(result.as_table()->get_field(vm.intern(name))));
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+            failed_ = true;
+        }
+    }
+    // Dependents of a failed task are still released, to skip themselves,
+    // so that every run ends.
+    for (std::size_t d : task.dependents) {
+        if (pending_[d].fetch_sub(1) == 1) schedule(d);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--remaining_ == 0) done_.notify_all();
+}
+
+}  // namespace rebel::visual
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "core/work_stealing_pool.h"
+#include "script/vm.h"
+#include "visual/graph.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rebel::visual {
+
+/// Runs a graph's independent calls in parallel on a work-stealing pool.
+///
+/// The graph is split into tasks at its calls and at subgraphs that make
+/// calls; other nodes are cheap and are copied into every task that needs
+/// them. A chain of calls, each needed only by the next, stays one task.
+/// Each task compiles to bytecode (see visual/graph_compiler.h) in one VM
+/// per worker, which `setup` prepares with the functions the graph calls.
+/// A value needed by another task is handed over through a slot that the
+/// consumer reads once all its producers are done: a future on that edge.
+/// A final task computes the outputs from them.
+///
+/// Only values that can be copied between VMs (nil, booleans, numbers,
+/// strings) may cross between tasks; calls that are not pure run in any
+/// order unless Graph::order() says otherwise. Natives the graph calls
+/// must be thread-safe. One run() at a time.
+class ParallelGraph {
+public:
+    using Setup = std::function<void(script::VM&)>;
+
+    /// Throws script::CompileError as visual::compile does, and whatever
+    /// `setup` throws.
+    ParallelGraph(const Graph& graph, core::WorkStealingPool& pool, const Setup& setup = {});
+    ~ParallelGraph();
+    ParallelGraph(const ParallelGraph&) = delete;
+    ParallelGraph& operator=(const ParallelGraph&) = delete;
+
+    /// Runs the graph with `args` for its Input nodes in node order and
+    /// returns the values of its Output nodes in node order. Rethrows the
+    /// first error a task raised, once the tasks already started finish.
+    std::vector<Constant> run(const std::vector<Constant>& args);
+
+    /// Tasks, including the final one.
+    std::size_t tasks() const noexcept { return tasks_.size(); }
+
+private:
+    // Where a task input comes from: an argument, or a value exported by
+    // an earlier task.
+    struct Source {
+        std::size_t task;  // kArgument for an argument
+        std::size_t index;
+    };
+    struct Task {
+        Graph graph;
+        std::vector<Source> inputs;
+        std::vector<std::string> exports;  // output names, in the order read back
+        std::vector<std::size_t> dependents;
+        std::size_t producers = 0;
+    };
+    struct Worker {
+        std::unique_ptr<script::VM> vm;
+        std::vector<script::VM::Handle> functions;  // by task
+    };
+    static constexpr std::size_t kArgument = ~std::size_t{0};
+
+    void split(const Graph& graph);
+    void schedule(std::size_t task);
+    void execute(std::size_t task);
+
+    core::WorkStealingPool& pool_;
+    std::vector<Task> tasks_;
+    std::vector<Worker> workers_;
+
+    // State of the current run.
+    const std::vector<Constant>* args_ = nullptr;
+    std::vector<std::vector<Constant>> values_;  // by task, its exports
+    std::unique_ptr<std::atomic<std::size_t>[]> pending_;  // by task, producers not done
+    std::atomic<bool> failed_{false};
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::size_t remaining_ = 0;  // guarded by mutex_
+    std::exception_ptr error_;   // guarded by mutex_
+};
+
+}  // namespace rebel::visual
@@ -0,0 +1,81 @@
+#include "visual/quadtree.h"
+
+#include <stdexcept>
+
+namespace rebel::visual {
+
+QuadTree::QuadTree(const Rect& bounds) {
+    quads_.emplace_back();
+    quads_[0].bounds = bounds;
+}
+
+void QuadTree::insert(std::uint32_t item, const Rect& rect) {
+    if (item == kNone) throw std::out_of_range("item id out of range");
+    if (item >= items_.size()) items_.resize(item + 1);
+    if (items_[item].quad != kNone) remove(item);
+    items_[item].rect = rect;
+    ++size_;
+
+    std::uint32_t at = 0;
+    for (;;) {
+        const std::uint32_t children = quads_[at].children;
+        if (children == kNone) break;
+        std::uint32_t next = kNone;
+        for (std::uint32_t c = children; c < children + 4; ++c) {
+            if (quads_[c].bounds.contains(rect)) next = c;
+        }
+        if (next == kNone) break;
+        at = next;
+    }
+    place(item, at);
+    if (quads_[at].children == kNone && quads_[at].items.size() > kSplit && quads_[at].depth < kMaxDepth) split(at);
+}
+
+void QuadTree::remove(std::uint32_t item) {
+    if (!contains(item)) return;
+    Entry& entry = items_[item];
+    std::vector<std::uint32_t>& items = quads_[entry.quad].items;
+    const std::uint32_t last = items.back();
+    items[entry.slot] = last;
+    items_[last].slot = entry.slot;
+    items.pop_back();
+    entry.quad = kNone;
+    --size_;
+}
+
+void QuadTree::place(std::uint32_t item, std::uint32_t quad) {
+    items_[item].quad = quad;
+    items_[item].slot = static_cast<std::uint32_t>(quads_[quad].items.size());
+    quads_[quad].items.push_back(item);
+}
+
+// Items that fit a child move down; the rest (those crossing the centre
+// lines) stay. Children that end up over the limit split in turn.
+void QuadTree::split(std::uint32_t quad) {
+    const Rect b = quads_[quad].bounds;
+    const float mx = b.x0 + (b.x1 - b.x0) / 2;
+    const float my = b.y0 + (b.y1 - b.y0) / 2;
+    const auto children = static_cast<std::uint32_t>(quads_.size());
+    const Rect parts[4] = {{b.x0, b.y0, mx, my}, {mx, b.y0, b.x1, my}, {b.x0, my, mx, b.y1}, {mx, my, b.x1, b.y1}};
+    for (const Rect& part : parts) {
+        quads_.emplace_back();
+        quads_.back().bounds = part;
+        quads_.back().depth = quads_[quad].depth + 1;
+    }
+    quads_[quad].children = children;
+
+    std::vector<std::uint32_t> items;
+    items.swap(quads_[quad].items);
+    for (std::uint32_t item : items) {
+        std::uint32_t at = quad;
+        for (std::uint32_t c = children; c < children + 4; ++c) {
+            if (quads_[c].bounds.contains(items_[item].rect)) at = c;
+        }
+        place(item, at);
+    }
+    for (std::uint32_t c = children; c < children + 4; ++c) {
+        if (quads_[c].items.size() > kSplit && quads_[c].depth < kMaxDepth) split(c);
+    }
+}
+
+}  // namespace rebel::visual
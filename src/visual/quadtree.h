@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rebel::visual {
+
+/// Axis-aligned rectangle in canvas units, x0 <= x1 and y0 <= y1.
+struct Rect {
+    float x0 = 0;
+    float y0 = 0;
+    float x1 = 0;
+    float y1 = 0;
+
+    bool intersects(const Rect& r) const noexcept { return x0 <= r.x1 && r.x0 <= x1 && y0 <= r.y1 && r.y0 <= y1; }
+    bool contains(const Rect& r) const noexcept { return x0 <= r.x0 && r.x1 <= x1 && y0 <= r.y0 && r.y1 <= y1; }
+};
+
+/// Spatial index of rectangles, for finding what a viewport shows.
+///
+/// Items are dense ids, each stored once in the smallest quad that holds
+/// its whole rectangle, so a large item (a long edge) sits high in the tree
+/// and a small one deep. A quad splits when it holds more than kSplit items
+/// that fit a child. Items outside the bounds stay in the root, so the
+/// bounds only matter for speed. Moving an item is a remove and an insert,
+/// O(depth).
+class QuadTree {
+public:
+    static constexpr std::size_t kSplit = 8;
+    static constexpr int kMaxDepth = 14;
+
+    explicit QuadTree(const Rect& bounds);
+
+    /// Adds or moves `item`.
+    void insert(std::uint32_t item, const Rect& rect);
+    void remove(std::uint32_t item);
+    bool contains(std::uint32_t item) const noexcept {
+        return item < items_.size() && items_[item].quad != kNone;
+    }
+    std::size_t size() const noexcept { return size_; }
+    const Rect& rect(std::uint32_t item) const { return items_.at(item).rect; }
+
+    /// Calls `visit(item)` once for each item whose rectangle intersects
+    /// `area`, in no particular order.
+    template <typename Visit>
+    void query(const Rect& area, Visit&& visit) const {
+        std::uint32_t stack[kMaxDepth * 3 + 4];
+        std::size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Quad& quad = quads_[stack[--top]];
+            for (std::uint32_t item : quad.items) {
+                if (items_[item].rect.intersects(area)) visit(item);
+            }
+            if (quad.children == kNone) continue;
+            for (std::uint32_t c = quad.children; c < quad.children + 4; ++c) {
+                if (quads_[c].bounds.intersects(area)) stack[top++] = c;
+            }
+        }
+    }
+
+private:
+    static constexpr std::uint32_t kNone = ~std::uint32_t{0};
+
+    struct Quad {
+        Rect bounds;
+        std::uint32_t children = kNone;  // the first of four: NW, NE, SW, SE
+        int depth = 0;
+        std::vector<std::uint32_t> items;
+    };
+    struct Entry {
+        Rect rect;
+        std::uint32_t quad = kNone;
+        std::uint32_t slot = 0;  // in its quad's items
+    };
+
+    void place(std::uint32_t item, std::uint32_t quad);
+    void split(std::uint32_t quad);
+
+    std::vector<Quad> quads_;
+    std::vector<Entry> items_;  // by item
+    std::size_t size_ = 0;
+};
+
+}  // namespace rebel::visual
@@ -0,0 +1,87 @@
+#include "watch/coalescer.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace rebel::watch {
+namespace {
+
+// What `prev` followed by `next` amounts to. A file created and then
+// removed is still reported as removed: the create may have replaced a
+// file that existed before, and removing an unknown path costs a
+// consumer nothing.
+ChangeKind merge(ChangeKind prev, ChangeKind next) {
+    if (next == ChangeKind::Removed) return ChangeKind::Removed;
+    switch (prev) {
+        case ChangeKind::Created: return ChangeKind::Created;
+        case ChangeKind::Modified: return ChangeKind::Modified;
+        case ChangeKind::Removed: return ChangeKind::Modified;
+    }
+    return next;
+}
+
+}  // namespace
+
+bool ChangeBatch::affects(std::string_view path) const {
+    auto by_path = [](const FileChange& change, std::string_view p) { return change.path < p; };
+    auto it = std::lower_bound(changes.begin(), changes.end(), path, by_path);
+    if (it != changes.end() && it->path == path) return true;
+    // Any removed ancestor directory.
+    for (std::size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1)) {
+        const std::string_view dir = path.substr(0, slash);
+        it = std::lower_bound(changes.begin(), changes.end(), dir, by_path);
+        if (it != changes.end() && it->path == dir && it->kind == ChangeKind::Removed) return true;
+    }
+    return false;
+}
+
+void Coalescer::touch(Clock::time_point now) {
+    if (events_++ == 0) first_ = now;
+    last_ = now;
+}
+
+void Coalescer::add(std::string_view path, ChangeKind kind, Clock::time_point now) {
+    touch(now);
+    if (rescan_) return;
+    auto it = pending_.find(path);
+    if (it != pending_.end()) {
+        it->second = merge(it->second, kind);
+    } else {
+        it = pending_.emplace(std::string(path), kind).first;
+    }
+    if (kind != ChangeKind::Removed) return;
+    // A removed directory takes everything pending beneath it with it.
+    const std::string prefix = it->first + '/';
+    const auto below = pending_.lower_bound(prefix);
+    auto end = below;
+    while (end != pending_.end() && end->first.compare(0, prefix.size(), prefix) == 0) ++end;
+    pending_.erase(below, end);
+}
+
+void Coalescer::lost(Clock::time_point now) {
+    touch(now);
+    rescan_ = true;
+    pending_.clear();
+}
+
+Coalescer::Clock::time_point Coalescer::due() const noexcept {
+    if (events_ == 0) return Clock::time_point::max();
+    return std::min(last_ + options_.quiet, first_ + options_.max_delay);
+}
+
+ChangeBatch Coalescer::take() {
+    ChangeBatch batch;
+    batch.sequence = ++sequence_;
+    batch.rescan = rescan_;
+    batch.events = events_;
+    batch.changes.reserve(pending_.size());
+    while (!pending_.empty()) {
+        auto node = pending_.extract(pending_.begin());
+        batch.changes.push_back({std::move(node.key()), node.mapped()});
+    }
+    events_ = 0;
+    rescan_ = false;
+    return batch;
+}
+
+}  // namespace rebel::watch
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebel::watch {
+
+enum class ChangeKind : std::uint8_t {
+    Created,   // a file that did not exist before the batch
+    Modified,  // a file whose contents may have changed, or that was replaced
+    Removed,   // a file, or a directory and everything below it
+};
+
+struct FileChange {
+    std::string path;  // relative to the watched root, '/'-separated
+    ChangeKind kind = ChangeKind::Modified;
+};
+
+/// The net effect of a burst of file system events: one entry per path,
+/// however many events it received.
+struct ChangeBatch {
+    std::uint64_t sequence = 0;  // 1, 2, ... per watcher
+    /// Sorted by path, so a removed directory comes before anything
+    /// created beneath it again and the batch can be applied in order.
+    std::vector<FileChange> changes;
+    /// Events were lost (a kernel queue overflowed, the root went away):
+    /// the batch does not say what changed and consumers must rescan the
+    /// whole tree. `changes` is empty then.
+    bool rescan = false;
+    std::size_t events = 0;  // raw events folded into the batch
+
+    /// Whether `path` changed: it is listed, or lies under a removed
+    /// directory.
+    bool affects(std::string_view path) const;
+};
+
+/// Folds raw file system events into ChangeBatches.
+///
+/// Events for a path are merged as they arrive (a delete followed by a
+/// create, as a checkout writes files, is one Modified), so memory grows
+/// with the paths touched rather than the events. A batch is due once no
+/// event has arrived for `quiet`, or `max_delay` after its first event if
+/// the storm does not let up. Time is passed in rather than read, so a
+/// recorded storm replays the same way every time.
+class Coalescer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        Clock::duration quiet = std::chrono::milliseconds(50);
+        Clock::duration max_delay = std::chrono::seconds(2);
+    };
+
+    Coalescer() : Coalescer(Options{}) {}
+    explicit Coalescer(Options options) : options_(options) {}
+
+    void add(std::string_view path, ChangeKind kind, Clock::time_point now);
+    /// Events were dropped: the pending batch becomes a rescan.
+    void lost(Clock::time_point now);
+
+    bool empty() const noexcept { return events_ == 0; }
+    /// When the pending batch is due; Clock::time_point::max() if there is
+    /// none.
+    Clock::time_point due() const noexcept;
+    /// Takes the pending batch, leaving the coalescer empty.
+    ChangeBatch take();
+
+private:
+    void touch(Clock::time_point now);
+
+    Options options_;
+    std::map<std::string, ChangeKind, std::less<>> pending_;
+    std::size_t events_ = 0;
+    bool rescan_ = false;
+    Clock::time_point first_;
+    Clock::time_point last_;
+    std::uint64_t sequence_ = 0;
+};
+
+}  // namespace rebel::watch
@@ -0,0 +1,505 @@
+#include "watch/file_watcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <system_error>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#include <sys/stat.h>
+
+#include <condition_variable>
+#else
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <map>
+#include <unordered_map>
+#endif
+
+namespace rebel::watch {
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = Coalescer::Clock;
+
+bool hidden(std::string_view name) { return !name.empty() && name[0] == '.'; }
+
+#if defined(_WIN32) || defined(__APPLE__)
+// Whether a directory on the way to `path` is one we do not watch. Backends
+// that watch the whole tree at once see events from those too.
+bool under_hidden(std::string_view path) {
+    for (std::size_t start = 0, slash; (slash = path.find('/', start)) != std::string_view::npos; start = slash + 1) {
+        if (hidden(path.substr(start, slash - start))) return true;
+    }
+    return false;
+}
+#endif
+
+// Reports every file under the new directory `dir` as created, calling
+// `on_dir` for it and each directory below it first, so a watch added there
+// cannot miss a file: one created meanwhile is simply reported twice.
+template <typename OnDir>
+void walk_new(const fs::path& root, const std::string& dir, Coalescer* sink, Clock::time_point now, OnDir&& on_dir) {
+    on_dir(dir);
+    std::error_code error;
+    fs::recursive_directory_iterator it(root / fs::u8path(dir), fs::directory_options::skip_permission_denied, error);
+    for (const fs::recursive_directory_iterator end; !error && it != end; it.increment(error)) {
+        const std::string path = it->path().lexically_relative(root).generic_u8string();
+        if (it->is_directory(error)) {
+            if (hidden(it->path().filename().u8string())) {
+                it.disable_recursion_pending();
+            } else {
+                on_dir(path);
+            }
+            continue;
+        }
+        if (sink && it->is_regular_file(error)) sink->add(path, ChangeKind::Created, now);
+    }
+}
+
+int timeout_ms(Clock::time_point due) {
+    if (due == Clock::time_point::max()) return -1;
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(due - Clock::now()).count();
+    return static_cast<int>(std::clamp<decltype(left)>(left, 0, 60'000));
+}
+
+}  // namespace
+
+#if defined(_WIN32)
+
+// One overlapped ReadDirectoryChangesW over the whole tree, re-armed after
+// every completion.
+class FileWatcher::Backend {
+public:
+    explicit Backend(const std::string& root) : root_(fs::u8path(root)) {
+        dir_ = CreateFileW(root_.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (dir_ == INVALID_HANDLE_VALUE) {
+            throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "watch " + root);
+        }
+        event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        wake_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        if (!event_ || !wake_ || !arm()) {
+            const auto error = static_cast<int>(GetLastError());
+            close();
+            throw std::system_error(error, std::system_category(), "watch " + root);
+        }
+    }
+
+    ~Backend() {
+        CancelIoEx(dir_, &overlapped_);
+        DWORD bytes = 0;
+        GetOverlappedResult(dir_, &overlapped_, &bytes, TRUE);
+        close();
+    }
+
+    void read(Clock::time_point due, Coalescer& sink) {
+        const int timeout = timeout_ms(due);
+        HANDLE handles[] = {event_, wake_};
+        if (WaitForMultipleObjects(2, handles, FALSE, timeout < 0 ? INFINITE : static_cast<DWORD>(timeout)) !=
+            WAIT_OBJECT_0) {
+            return;
+        }
+        const auto now = Clock::now();
+        DWORD bytes = 0;
+        // No bytes means the kernel buffer overflowed.
+        if (!GetOverlappedResult(dir_, &overlapped_, &bytes, FALSE) || bytes == 0) {
+            sink.lost(now);
+        } else {
+            parse(bytes, sink, now);
+        }
+        if (!arm()) sink.lost(now);
+    }
+
+    void wake() { SetEvent(wake_); }
+
+private:
+    bool arm() {
+        ResetEvent(event_);
+        overlapped_ = {};
+        overlapped_.hEvent = event_;
+        constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                 FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+        return ReadDirectoryChangesW(dir_, buffer_, sizeof buffer_, TRUE, filter, nullptr, &overlapped_, nullptr);
+    }
+
+    void parse(DWORD bytes, Coalescer& sink, Clock::time_point now) {
+        for (DWORD offset = 0; offset < bytes;) {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer_ + offset);
+            const fs::path relative(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+            const std::string path = relative.generic_u8string();
+            if (!under_hidden(path)) event(path, info->Action, sink, now);
+            if (info->NextEntryOffset == 0) break;
+            offset += info->NextEntryOffset;
+        }
+    }
+
+    void event(const std::string& path, DWORD action, Coalescer& sink, Clock::time_point now) {
+        switch (action) {
+            case FILE_ACTION_REMOVED:
+            case FILE_ACTION_RENAMED_OLD_NAME: sink.add(path, ChangeKind::Removed, now); return;
+            case FILE_ACTION_ADDED:
+            case FILE_ACTION_RENAMED_NEW_NAME:
+            case FILE_ACTION_MODIFIED: break;
+            default: return;
+        }
+        // Directories report their own modification whenever an entry in
+        // them changes; only a new one matters, for the files it brings.
+        const DWORD attributes = GetFileAttributesW((root_ / fs::u8path(path)).c_str());
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            if (action != FILE_ACTION_MODIFIED && !hidden(fs::u8path(path).filename().u8string())) {
+                walk_new(root_, path, &sink, now, [](const std::string&) {});
+            }
+            return;
+        }
+        sink.add(path, action == FILE_ACTION_MODIFIED ? ChangeKind::Modified : ChangeKind::Created, now);
+    }
+
+    void close() {
+        if (dir_ != INVALID_HANDLE_VALUE) CloseHandle(dir_);
+        if (event_) CloseHandle(event_);
+        if (wake_) CloseHandle(wake_);
+    }
+
+    const fs::path root_;
+    HANDLE dir_ = INVALID_HANDLE_VALUE;
+    HANDLE event_ = nullptr;
+    HANDLE wake_ = nullptr;
+    OVERLAPPED overlapped_{};
+    // 64 KiB is the most ReadDirectoryChangesW accepts for network shares.
+    alignas(DWORD) char buffer_[64 * 1024];
+};
+
+#elif defined(__APPLE__)
+
+// An FSEvents stream with file-level events and no latency of its own (the
+// Coalescer provides that), delivering on a private dispatch queue into a
+// list the watcher thread drains.
+class FileWatcher::Backend {
+public:
+    explicit Backend(const std::string& root) {
+        std::error_code error;
+        // FSEvents reports resolved paths (/private/tmp, not /tmp).
+        root_ = fs::canonical(fs::u8path(root), error);
+        if (error) throw std::system_error(error, "watch " + root);
+        prefix_ = root_.u8string() + '/';
+
+        CFStringRef path = CFStringCreateWithCString(nullptr, root_.u8string().c_str(), kCFStringEncodingUTF8);
+        CFArrayRef paths = CFArrayCreate(nullptr, reinterpret_cast<const void**>(&path), 1, &kCFTypeArrayCallBacks);
+        FSEventStreamContext context{0, this, nullptr, nullptr, nullptr};
+        stream_ = FSEventStreamCreate(nullptr, &Backend::callback, &context, paths, kFSEventStreamEventIdSinceNow, 0.0,
+                                      kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer |
+                                          kFSEventStreamCreateFlagWatchRoot);
+        CFRelease(paths);
+        CFRelease(path);
+        if (!stream_) throw std::system_error(std::make_error_code(std::errc::io_error), "watch " + root);
+        queue_ = dispatch_queue_create("rebel.watch", DISPATCH_QUEUE_SERIAL);
+        FSEventStreamSetDispatchQueue(stream_, queue_);
+        if (!FSEventStreamStart(stream_)) {
+            FSEventStreamInvalidate(stream_);
+            FSEventStreamRelease(stream_);
+            dispatch_release(queue_);
+            throw std::system_error(std::make_error_code(std::errc::io_error), "watch " + root);
+        }
+    }
+
+    ~Backend() {
+        FSEventStreamStop(stream_);
+        FSEventStreamInvalidate(stream_);
+        FSEventStreamRelease(stream_);
+        dispatch_release(queue_);
+    }
+
+    void read(Clock::time_point due, Coalescer& sink) {
+        std::vector<std::pair<std::string, FSEventStreamEventFlags>> events;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready = [&] { return !events_.empty() || woken_; };
+            const int timeout = timeout_ms(due);
+            if (timeout < 0) {
+                arrived_.wait(lock, ready);
+            } else {
+                arrived_.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+            }
+            woken_ = false;
+            events.swap(events_);
+        }
+        const auto now = Clock::now();
+        for (const auto& [path, flags] : events) event(path, flags, sink, now);
+    }
+
+    void wake() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        woken_ = true;
+        arrived_.notify_one();
+    }
+
+private:
+    static void callback(ConstFSEventStreamRef, void* info, std::size_t count, void* paths,
+                         const FSEventStreamEventFlags flags[], const FSEventStreamEventId[]) {
+        auto* self = static_cast<Backend*>(info);
+        char** names = static_cast<char**>(paths);
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        for (std::size_t i = 0; i < count; ++i) self->events_.emplace_back(names[i], flags[i]);
+        self->arrived_.notify_one();
+    }
+
+    void event(const std::string& full, FSEventStreamEventFlags flags, Coalescer& sink, Clock::time_point now) {
+        constexpr FSEventStreamEventFlags lost = kFSEventStreamEventFlagMustScanSubDirs |
+                                                 kFSEventStreamEventFlagUserDropped |
+                                                 kFSEventStreamEventFlagKernelDropped |
+                                                 kFSEventStreamEventFlagRootChanged;
+        if (flags & lost) {
+            sink.lost(now);
+            return;
+        }
+        if (full.compare(0, prefix_.size(), prefix_) != 0) return;
+        const std::string path = full.substr(prefix_.size());
+        if (under_hidden(path)) return;
+        // One event can carry several flags for the same path (created,
+        // modified and removed in quick succession), so what exists now
+        // decides.
+        struct stat st {};
+        if (::lstat(full.c_str(), &st) != 0) {
+            sink.add(path, ChangeKind::Removed, now);
+            return;
+        }
+        const bool fresh = flags & (kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemRenamed);
+        if (S_ISDIR(st.st_mode)) {
+            if (fresh && !hidden(fs::u8path(path).filename().u8string())) {
+                walk_new(root_, path, &sink, now, [](const std::string&) {});
+            }
+            return;
+        }
+        sink.add(path, fresh ? ChangeKind::Created : ChangeKind::Modified, now);
+    }
+
+    fs::path root_;
+    std::string prefix_;
+    FSEventStreamRef stream_ = nullptr;
+    dispatch_queue_t queue_ = nullptr;
+
+    std::mutex mutex_;
+    std::condition_variable arrived_;
+    std::vector<std::pair<std::string, FSEventStreamEventFlags>> events_;
+    bool woken_ = false;
+};
+
+#else
+
+namespace {
+
+std::string join(const std::string& dir, std::string_view name) {
+    return dir.empty() ? std::string(name) : dir + '/' + std::string(name);
+}
+
+}  // namespace
+
+// inotify, which watches single directories: one watch per directory in
+// the tree, added as directories appear. An eventfd wakes poll() for
+// shutdown.
+class FileWatcher::Backend {
+public:
+    explicit Backend(const std::string& root) : root_(root) {
+        fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "inotify_init1");
+        wake_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        // The root itself may be a symlink; nothing below it is followed.
+        if (wake_ >= 0) root_watch_ = ::inotify_add_watch(fd_, root_.c_str(), kMask & ~IN_DONT_FOLLOW);
+        if (root_watch_ < 0) {
+            const int error = errno;
+            close();
+            throw std::system_error(error, std::generic_category(), "watch " + root);
+        }
+        dirs_.emplace(root_watch_, std::string());
+        wds_.emplace(std::string(), root_watch_);
+        if (!walk("", nullptr, {})) {
+            close();
+            throw std::system_error(ENOSPC, std::generic_category(), "watch " + root);
+        }
+    }
+
+    ~Backend() { close(); }
+
+    void read(Clock::time_point due, Coalescer& sink) {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_, POLLIN, 0}};
+        if (::poll(fds, 2, timeout_ms(due)) <= 0) return;
+        if (fds[1].revents & POLLIN) {
+            std::uint64_t count = 0;
+            [[maybe_unused]] const auto ignored = ::read(wake_, &count, sizeof count);
+        }
+        if (!(fds[0].revents & POLLIN)) return;
+        // One buffer per call, so a storm that never pauses still lets the
+        // thread deliver at max_delay.
+        const ssize_t length = ::read(fd_, buffer_, sizeof buffer_);
+        if (length <= 0) return;
+        const auto now = Clock::now();
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* ev = reinterpret_cast<const inotify_event*>(buffer_ + offset);
+            event(*ev, sink, now);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+        }
+    }
+
+    void wake() {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const auto ignored = ::write(wake_, &one, sizeof one);
+    }
+
+private:
+    static constexpr std::uint32_t kMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                           IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW |
+                                           IN_EXCL_UNLINK;
+
+    bool add_watch(const std::string& dir) {
+        if (dir.empty()) return true;  // the root, watched first
+        const int wd = ::inotify_add_watch(fd_, (root_ / fs::u8path(dir)).c_str(), kMask);
+        // A directory already gone is reported by its parent.
+        if (wd < 0) return errno == ENOENT || errno == ENOTDIR;
+        const auto [it, fresh] = dirs_.try_emplace(wd, dir);
+        if (!fresh) {
+            // The same directory under a new name: moved within the tree.
+            wds_.erase(it->second);
+            it->second = dir;
+        }
+        wds_[dir] = wd;
+        return true;
+    }
+
+    // Watches `dir` and the directories below it, reporting their files to
+    // `sink` if given. False if a watch could not be added, when changes
+    // there would go unseen.
+    bool walk(const std::string& dir, Coalescer* sink, Clock::time_point now) {
+        bool ok = true;
+        walk_new(root_, dir, sink, now, [&](const std::string& path) { ok = add_watch(path) && ok; });
+        return ok;
+    }
+
+    void unwatch(const std::string& dir) {
+        const std::string prefix = dir + '/';
+        auto it = wds_.lower_bound(dir);
+        while (it != wds_.end() && (it->first == dir || it->first.compare(0, prefix.size(), prefix) == 0)) {
+            // Fails harmlessly for a deleted directory, whose watch is
+            // already gone.
+            ::inotify_rm_watch(fd_, it->second);
+            dirs_.erase(it->second);
+            it = wds_.erase(it);
+        }
+    }
+
+    void event(const inotify_event& ev, Coalescer& sink, Clock::time_point now) {
+        if (ev.mask & IN_Q_OVERFLOW) {
+            sink.lost(now);
+            return;
+        }
+        const auto dir = dirs_.find(ev.wd);
+        if (dir == dirs_.end()) return;
+        if (ev.mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+            // Subdirectories are reported by their parents; the root going
+            // away leaves nothing to watch.
+            if (ev.wd == root_watch_) {
+                sink.lost(now);
+            } else if (ev.mask & IN_IGNORED) {
+                wds_.erase(dir->second);
+                dirs_.erase(dir);
+            }
+            return;
+        }
+        const std::string_view name(ev.len ? ev.name : "");
+        const std::string path = join(dir->second, name);
+        if (ev.mask & IN_ISDIR) {
+            if (hidden(name)) return;
+            if (ev.mask & (IN_CREATE | IN_MOVED_TO)) {
+                if (!walk(path, &sink, now)) sink.lost(now);
+            } else if (ev.mask & (IN_DELETE | IN_MOVED_FROM)) {
+                unwatch(path);
+                sink.add(path, ChangeKind::Removed, now);
+            }
+            return;
+        }
+        if (ev.mask & (IN_CREATE | IN_MOVED_TO)) {
+            sink.add(path, ChangeKind::Created, now);
+        } else if (ev.mask & (IN_DELETE | IN_MOVED_FROM)) {
+            sink.add(path, ChangeKind::Removed, now);
+        } else if (ev.mask & IN_CLOSE_WRITE) {
+            sink.add(path, ChangeKind::Modified, now);
+        }
+    }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        if (wake_ >= 0) ::close(wake_);
+    }
+
+    const fs::path root_;
+    int fd_ = -1;
+    int wake_ = -1;
+    int root_watch_ = -1;
+    std::unordered_map<int, std::string> dirs_;  // watch -> directory, relative to the root
+    std::map<std::string, int> wds_;             // the reverse, ordered for removing subtrees
+    alignas(inotify_event) char buffer_[256 * 1024];
+};
+
+#endif
+
+FileWatcher::FileWatcher(std::string root, Coalescer::Options options)
+    : root_(std::move(root)), coalescer_(options), backend_(std::make_unique<Backend>(root_)) {
+    thread_ = std::thread([this] { run(); });
+}
+
+FileWatcher::~FileWatcher() {
+    stopping_.store(true);
+    backend_->wake();
+    thread_.join();
+}
+
+std::uint64_t FileWatcher::subscribe(Listener listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    listeners_.emplace_back(++next_id_, std::move(listener));
+    return next_id_;
+}
+
+void FileWatcher::unsubscribe(std::uint64_t id) {
+    std::lock_guard<std::mutex> delivering(delivering_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    listeners_.erase(std::remove_if(listeners_.begin(), listeners_.end(), [&](const auto& l) { return l.first == id; }),
+                     listeners_.end());
+}
+
+FileWatcher::Stats FileWatcher::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void FileWatcher::run() {
+    while (!stopping_.load()) {
+        backend_->read(coalescer_.due(), coalescer_);
+        if (!coalescer_.empty() && Clock::now() >= coalescer_.due()) deliver(coalescer_.take());
+    }
+}
+
+void FileWatcher::deliver(ChangeBatch batch) {
+    const auto shared = std::make_shared<const ChangeBatch>(std::move(batch));
+    std::lock_guard<std::mutex> delivering(delivering_);
+    std::vector<Listener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.events += shared->events;
+        stats_.batches += 1;
+        stats_.changes += shared->changes.size();
+        stats_.rescans += shared->rescan ? 1 : 0;
+        for (const auto& entry : listeners_) listeners.push_back(entry.second);
+    }
+    for (const Listener& listener : listeners) listener(shared);
+}
+
+}  // namespace rebel::watch
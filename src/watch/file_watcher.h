@@ -0,0 +1,84 @@
+#pragma once
+
+#include "watch/coalescer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rebel::watch {
+
+/// Watches every file under a root directory and delivers what changed as
+/// coalesced ChangeBatches, so a branch switch that rewrites 30,000 files
+/// reaches each subscriber as one or two batches rather than 100,000
+/// callbacks.
+///
+/// The platform backend is inotify on Linux. FSEvents (macOS) and
+/// ReadDirectoryChangesW (Windows) backends are written but have never
+/// been compiled, so the library is only built on Linux unless
+/// REBEL_WATCH_UNTESTED_BACKENDS is set. Directories whose names start with
+/// '.' are not watched, as the indexer and workspace search skip them too;
+/// that keeps a checkout's writes under .git out of the event stream. On
+/// Linux files are reported when closed after writing, not on every write.
+///
+/// One thread reads the events, folds them into a Coalescer and calls
+/// every subscriber with each batch, in subscription order. The batch is
+/// shared, not copied, and listeners run on that thread: anything slow
+/// belongs on a worker pool.
+class FileWatcher {
+public:
+    using Listener = std::function<void(const std::shared_ptr<const ChangeBatch>&)>;
+
+    struct Stats {
+        std::uint64_t events = 0;   // raw events read from the backend
+        std::uint64_t batches = 0;  // delivered
+        std::uint64_t changes = 0;  // entries across the delivered batches
+        std::uint64_t rescans = 0;  // batches that lost events
+    };
+
+    /// Starts watching `root`; throws std::system_error if it cannot.
+    explicit FileWatcher(std::string root, Coalescer::Options options = {});
+    /// Stops the thread; changes not yet delivered are dropped.
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    const std::string& root() const noexcept { return root_; }
+
+    /// Returns an id for unsubscribe().
+    std::uint64_t subscribe(Listener listener);
+    /// Once this returns the listener is not running and will not be
+    /// called again. Must not be called from a listener.
+    void unsubscribe(std::uint64_t id);
+
+    Stats stats() const;
+
+private:
+    class Backend;
+
+    void run();
+    void deliver(ChangeBatch batch);
+
+    const std::string root_;
+    Coalescer coalescer_;  // owned by the thread
+    std::unique_ptr<Backend> backend_;
+
+    mutable std::mutex mutex_;
+    std::mutex delivering_;  // held while listeners run
+    std::vector<std::pair<std::uint64_t, Listener>> listeners_;
+    std::uint64_t next_id_ = 0;
+    Stats stats_;
+
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
+
+}  // namespace rebel::watch